@@ -46,6 +46,7 @@ message(STATUS " ")
 message(STATUS "Experimental Features: ${EXPERIMENTAL}")
 message(STATUS "Snapshot build:        ${SNAPSHOT}")
 message(STATUS "WASM build:            ${WASM}")
+message(STATUS "WASM threads:          ${WASM_THREADS}")
 message(STATUS "Headless build:        ${HEADLESS}")
 message(STATUS "NULLGL build:          ${NULLGL}")
 if (USE_GLAD)
@@ -47,6 +47,19 @@ do_test() {
 	fi
 }
 
+do_startup() {
+	echo "do_startup()"
+
+	(
+		cd "$BUILDDIR"
+		ctest -C Perf -L startup --output-on-failure
+	)
+	if [[ $? != 0 ]]; then
+		echo "Startup time over budget"
+		exit 1
+	fi
+}
+
 do_coverage() {
 	echo "do_coverage()"
 
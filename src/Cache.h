@@ -44,77 +44,105 @@
 
 #pragma once
 
+#include <cstdint>
+#include <set>
+#include <tuple>
 #include <unordered_map>
 #include "printutils.h"
 
+/*!
+   Cache bounded by the total cost (usually bytes) of its objects.
+
+   Objects are evicted using the GreedyDual-Size policy: each object has a
+   priority of L + benefit / cost, which is refreshed on every hit, and the
+   object with the lowest priority goes first. L is the priority of the last
+   evicted object, so objects which aren't used age relative to newer ones.
+   The benefit is what it would take to recreate the object, e.g. its compute
+   time, so a small result that took long to compute outlives a large one
+   that is quick to recreate. If no benefits are given, all priorities equal
+   L and the policy is plain least recently used.
+ */
 template <class Key, class T>
 class Cache
 {
   struct Node {
-    inline Node() : keyPtr(nullptr), t(nullptr), c(0), p(nullptr), n(nullptr) {
+    inline Node() : keyPtr(nullptr), t(nullptr), c(0), b(0), h(0), seq(0) {
     }
-    inline Node(T * data, size_t cost) : keyPtr(nullptr), t(data), c(cost), p(nullptr), n(nullptr) {
+    inline Node(T * data, size_t cost, double benefit) : keyPtr(nullptr), t(data), c(cost), b(benefit), h(0), seq(0) {
     }
-    const Key *keyPtr; T *t; size_t c; Node *p, *n;
+    const Key *keyPtr; T *t; size_t c; double b; double h; uint64_t seq;
   };
   using map_type = typename std::unordered_map<Key, Node>;
   using iterator_type = typename map_type::iterator;
   using value_type = typename map_type::value_type;
+  // Eviction order, lowest priority first and least recently used among equal priorities
+  using order_type = std::set<std::tuple<double, uint64_t, Node *>>;
 
   std::unordered_map<Key, Node> hash;
-  Node *f, *l;
-  void *unused{nullptr};
+  order_type order;
   size_t mx, total{0};
+  double inflation{0}; // L
+  uint64_t clock{0};
+  double benefits{0};
+  size_t numevictions{0};
+  double evictedbenefits{0};
 
+  inline void prioritize(Node& n) {
+    n.h = inflation + (n.c > 0 ? n.b / n.c : n.b);
+    n.seq = ++clock;
+    order.emplace(n.h, n.seq, &n);
+  }
   inline void unlink(Node& n) {
-    if (n.p) n.p->n = n.n;
-    if (n.n) n.n->p = n.p;
-    if (l == &n) l = n.p;
-    if (f == &n) f = n.n;
+    order.erase(std::make_tuple(n.h, n.seq, &n));
     total -= n.c;
+    benefits -= n.b;
     T *obj = n.t;
     hash.erase(*n.keyPtr);
     delete obj;
   }
+  inline void evicted(Node& n) {
+    inflation = n.h;
+    numevictions++;
+    evictedbenefits += n.b;
+    unlink(n);
+  }
   inline T *relink(const Key& key) {
     auto i = hash.find(key);
     if (i == hash.end()) return nullptr;
 
     Node& n = i->second;
-    if (f != &n) {
-      if (n.p) n.p->n = n.n;
-      if (n.n) n.n->p = n.p;
-      if (l == &n) l = n.p;
-      n.p = nullptr;
-      n.n = f;
-      f->p = &n;
-      f = &n;
-    }
+    order.erase(std::make_tuple(n.h, n.seq, &n));
+    prioritize(n);
     return n.t;
   }
 
 public:
   inline explicit Cache(size_t maxCost = 100)
-    : f(nullptr), l(nullptr), mx(maxCost) { }
+    : mx(maxCost) { }
   inline ~Cache() { clear(); }
 
   [[nodiscard]] inline size_t maxCost() const { return mx; }
   void setMaxCost(size_t m) { mx = m; trim(mx); }
   [[nodiscard]] inline size_t totalCost() const { return total; }
+  // Sum of the benefits of the objects in the cache
+  [[nodiscard]] inline double totalBenefit() const { return benefits; }
+  // Objects evicted to make room, and the sum of their benefits
+  [[nodiscard]] inline size_t evictions() const { return numevictions; }
+  [[nodiscard]] inline double evictedBenefit() const { return evictedbenefits; }
 
   [[nodiscard]] inline size_t size() const { return hash.size(); }
   [[nodiscard]] inline bool empty() const { return hash.empty(); }
 
   void clear() {
-    while (f) {
-      delete f->t; f = f->n;
-    }
+    for (auto& item : hash) delete item.second.t;
     hash.clear();
-    l = nullptr;
+    order.clear();
     total = 0;
+    benefits = 0;
+    inflation = 0;
   }
 
-  bool insert(const Key& key, T *object, size_t cost);
+  bool insert(const Key& key, T *object, size_t cost, double benefit = 0);
   T *object(const Key& key) const { return const_cast<Cache<Key, T> *>(this)->relink(key); }
   inline bool contains(const Key& key) const { return hash.find(key) != hash.end(); }
   T *operator[](const Key& key) const { return object(key); }
@@ -122,6 +150,18 @@ public:
   bool remove(const Key& key);
   T *take(const Key& key);
 
+  // Total cost of the objects for which pred(key, object) is true
+  template <class Pred>
+  size_t costIf(Pred pred) const;
+  // Removes objects for which keep(key, object) is false, in eviction order,
+  // until at least amount of cost was removed. Returns the cost removed.
+  template <class Pred>
+  size_t evict(size_t amount, Pred keep);
+  // Removes all objects for which pred(key, object) is true, without counting
+  // them as evictions. Returns the cost removed.
+  template <class Pred>
+  size_t removeIf(Pred pred);
+
 private:
   void trim(size_t m);
 };
@@ -144,7 +184,7 @@ inline T *Cache<Key, T>::take(const Key& key)
   iterator_type i = hash.find(key);
   if (i == hash.end()) return 0;
 
-  Node& n = *i;
+  Node& n = i->second;
   T *t = n.t;
   n.t = 0;
   unlink(n);
@@ -152,7 +192,7 @@ inline T *Cache<Key, T>::take(const Key& key)
 }
 
 template <class Key, class T>
-bool Cache<Key, T>::insert(const Key& akey, T *aobject, size_t acost)
+bool Cache<Key, T>::insert(const Key& akey, T *aobject, size_t acost, double abenefit)
 {
   remove(akey);
   if (acost > mx) {
@@ -160,29 +200,67 @@ bool Cache<Key, T>::insert(const Key& akey, T *aobject, size_t acost)
     return false;
   }
   trim(mx - acost);
-  Node node(aobject, acost);
-  hash[akey] = node;
+  hash[akey] = Node(aobject, acost, abenefit);
   auto i = hash.find(akey);
   total += acost;
+  benefits += abenefit;
   Node *n = &i->second;
   n->keyPtr = &i->first;
-  if (f) f->p = n;
-  n->n = f;
-  f = n;
-  if (!l) l = f;
+  prioritize(*n);
   return true;
 }
 
+template <class Key, class T>
+template <class Pred>
+size_t Cache<Key, T>::costIf(Pred pred) const
+{
+  size_t cost = 0;
+  for (const auto& item : hash) {
+    if (pred(item.first, *item.second.t)) cost += item.second.c;
+  }
+  return cost;
+}
+
+template <class Key, class T>
+template <class Pred>
+size_t Cache<Key, T>::evict(size_t amount, Pred keep)
+{
+  size_t removed = 0;
+  auto it = order.begin();
+  while (it != order.end() && removed < amount) {
+    Node *u = std::get<2>(*it);
+    ++it;
+    if (keep(*u->keyPtr, *u->t)) continue;
+    removed += u->c;
+    evicted(*u);
+  }
+  return removed;
+}
+
+template <class Key, class T>
+template <class Pred>
+size_t Cache<Key, T>::removeIf(Pred pred)
+{
+  size_t removed = 0;
+  auto it = order.begin();
+  while (it != order.end()) {
+    Node *u = std::get<2>(*it);
+    ++it;
+    if (!pred(*u->keyPtr, *u->t)) continue;
+    removed += u->c;
+    unlink(*u);
+  }
+  return removed;
+}
+
 template <class Key, class T>
 void Cache<Key, T>::trim(size_t m)
 {
-  Node *n = l;
-  while (n && total > m) {
-    Node *u = n;
-    n = n->p;
+  while (!order.empty() && total > m) {
+    Node *u = std::get<2>(*order.begin());
 #ifdef DEBUG
-    LOG("Trimming cache: %1$s (%2$d bytes)", u->keyPtr->substr(0, 40), u->c);
+    LOG("Trimming cache: %1$s (%2$d bytes)", *u->keyPtr, u->c);
 #endif
-    unlink(*u);
+    evicted(*u);
   }
 }
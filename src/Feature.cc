@@ -38,16 +38,34 @@ const Feature Feature::ExperimentalManifold("manifold", "Use the Manifold librar
 const Feature Feature::ExperimentalRoof("roof", "Enable <code>roof</code>");
 const Feature Feature::ExperimentalInputDriverDBus("input-driver-dbus", "Enable DBus input drivers (requires restart)");
 const Feature Feature::ExperimentalLazyUnion("lazy-union", "Enable lazy unions.");
-const Feature Feature::ExperimentalVxORenderers("vertex-object-renderers", "Enable vertex object renderers");
+const Feature Feature::ExperimentalDisjointUnion("disjoint-union", "Union objects with disjoint bounding boxes by combining their meshes, without a boolean operation.");
+const Feature Feature::ExperimentalBytecode("bytecode", "Compile function bodies to bytecode for faster evaluation of arithmetic heavy functions.");
+const Feature Feature::ExperimentalMemoize("memoize", "Cache results of functions without side effects, so repeated calls with the same arguments are evaluated only once.");
+const Feature Feature::ExperimentalModuleCache("module-cache", "Share the nodes of user module calls with identical arguments, so repeated calls are instantiated only once.");
+const Feature Feature::ExperimentalIncrementalEval("incremental-eval", "Reuse the parts of the design that don't depend on changed customizer parameters instead of evaluating everything again.");
+const Feature Feature::ExperimentalSpeculativeEval("speculative-eval", "Evaluate the design in the background while typing, so the geometry is cached when the preview is requested.");
+const Feature Feature::ExperimentalAnimationPrefetch("animation-prefetch", "Prepare the upcoming frames of a playing animation in the background, so they can be shown at the requested frame rate.");
+const Feature Feature::ExperimentalVxORenderers("vertex-object-renderers", "Enable vertex object renderers in the preview");
 const Feature Feature::ExperimentalVxORenderersIndexing("vertex-object-renderers-indexing", "Enable indexing in vertex object renderers");
 const Feature Feature::ExperimentalVxORenderersDirect("vertex-object-renderers-direct", "Enable direct buffer writes in vertex object renderers");
 const Feature Feature::ExperimentalVxORenderersPrealloc("vertex-object-renderers-prealloc", "Enable preallocating buffers in vertex object renderers");
+const Feature Feature::ExperimentalVxORenderersInstancing("vertex-object-renderers-instancing", "Enable sharing vertex data of repeated geometry in vertex object renderers");
 const Feature Feature::ExperimentalTextMetricsFunctions("textmetrics", "Enable the <code>textmetrics()</code> and <code>fontmetrics()</code> functions.");
 const Feature Feature::ExperimentalImportFunction("import-function", "Enable import function returning data instead of geometry.");
 const Feature Feature::ExperimentalPredictibleOutput("predictible-output", "Attempt to produce predictible, diffable outputs (e.g. sorting the STL, or remeshing in a determined order)");
 #ifdef ENABLE_PYTHON
 const Feature Feature::ExperimentalPythonEngine("python-engine", "Enable experimental Python Engine (implies risk of malicious scripts downloaded).");
 #endif
+#ifdef ENABLE_TBB
+const Feature Feature::ExperimentalParallelEval("parallel-eval", "Evaluate independent subtrees concurrently. Requires <code>manifold</code>; subtrees needing exact CGAL numerics are still evaluated serially. The primitives of previews are created concurrently.");
+#endif
+const Feature Feature::ExperimentalGeometryDedup("geometry-dedup", "Share identical meshes produced by different parts of the design in the geometry cache, storing them only once.");
+const Feature Feature::ExperimentalGlbQuantization("glb-quantization", "Store vertex positions in GLB exports as 16 bit integers (KHR_mesh_quantization), for smaller files.");
+const Feature Feature::ExperimentalPngFast("png-fast", "Compress PNG exports faster, for somewhat larger files.");
+const Feature Feature::ExperimentalSvgCompact("svg-compact", "Write SVG paths with relative coordinates and without points on straight lines, for smaller files.");
+const Feature Feature::ExperimentalPreviewDecimation("preview-decimation", "Show meshes with more than 100000 faces, e.g. imported scans, decimated to about that many faces in previews.");
+const Feature Feature::ExperimentalRoundExact("round-exact", "Round the coordinates of CGAL boolean results to doubles once their exact numbers grow large, so long chains of operations stay fast.");
+const Feature Feature::ExperimentalOcclusionCulling("occlusion-culling", "Skip the CSG passes of preview objects hidden behind others, found with GPU occlusion queries. Doesn't apply to transparent designs.");
 
 Feature::Feature(const std::string& name, std::string description)
   : name(name), description(std::move(description))
@@ -21,16 +21,34 @@ public:
   static const Feature ExperimentalRoof;
   static const Feature ExperimentalInputDriverDBus;
   static const Feature ExperimentalLazyUnion;
+  static const Feature ExperimentalDisjointUnion;
+  static const Feature ExperimentalBytecode;
+  static const Feature ExperimentalMemoize;
+  static const Feature ExperimentalModuleCache;
+  static const Feature ExperimentalIncrementalEval;
+  static const Feature ExperimentalSpeculativeEval;
+  static const Feature ExperimentalAnimationPrefetch;
   static const Feature ExperimentalVxORenderers;
   static const Feature ExperimentalVxORenderersIndexing;
   static const Feature ExperimentalVxORenderersDirect;
   static const Feature ExperimentalVxORenderersPrealloc;
+  static const Feature ExperimentalVxORenderersInstancing;
   static const Feature ExperimentalTextMetricsFunctions;
   static const Feature ExperimentalImportFunction;
   static const Feature ExperimentalPredictibleOutput;
 #ifdef ENABLE_PYTHON
   static const Feature ExperimentalPythonEngine;
 #endif
+#ifdef ENABLE_TBB
+  static const Feature ExperimentalParallelEval;
+#endif
+  static const Feature ExperimentalGeometryDedup;
+  static const Feature ExperimentalGlbQuantization;
+  static const Feature ExperimentalPngFast;
+  static const Feature ExperimentalSvgCompact;
+  static const Feature ExperimentalPreviewDecimation;
+  static const Feature ExperimentalRoundExact;
+  static const Feature ExperimentalOcclusionCulling;
 
   [[nodiscard]] const std::string& get_name() const;
   [[nodiscard]] const std::string& get_description() const;
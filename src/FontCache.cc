@@ -28,12 +28,16 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
+#include <fstream>
 #include <utility>
+#include <json.hpp>
 
 #include "FontCache.h"
 #include "PlatformUtils.h"
 #include "printutils.h"
 #include "version_helper.h"
+#include "version.h"
 
 extern std::vector<std::string> librarypath;
 
@@ -65,6 +69,13 @@ const std::string get_freetype_version()
   return FontCache::instance()->get_freetype_version();
 }
 
+// The font path is only known once fontconfig is initialized
+const std::vector<std::string>& get_fontpath()
+{
+  FontCache::instance()->init_fontconfig();
+  return fontpath;
+}
+
 FontInfo::FontInfo(std::string family, std::string style, std::string file) : family(std::move(family)), style(std::move(style)), file(std::move(file))
 {
 }
@@ -98,6 +109,7 @@ const std::string& FontInfo::get_file() const
 FontCache *FontCache::self = nullptr;
 FontCache::InitHandlerFunc *FontCache::cb_handler = FontCache::defaultInitHandler;
 void *FontCache::cb_userdata = nullptr;
+std::string FontCache::index_dir;
 const std::string FontCache::DEFAULT_FONT("Liberation Sans:style=Regular");
 
 /**
@@ -115,6 +127,21 @@ FontCache::FontCache()
   this->init_ok = false;
   this->library = nullptr;
 
+  const FT_Error error = FT_Init_FreeType(&this->library);
+  if (error) {
+    LOG(message_group::Font_Warning, "Can't initialize freetype library, text() objects will not be rendered");
+    return;
+  }
+
+  this->init_ok = true;
+}
+
+bool FontCache::init_fontconfig()
+{
+  std::lock_guard<std::recursive_mutex> lock(this->mutex);
+  if (this->config_loaded) return this->config != nullptr;
+  this->config_loaded = true;
+
   // If we've got a bundled fonts.conf, initialize fontconfig with our own config
   // by overriding the built-in fontconfig path.
   // For system installs and dev environments, we leave this alone
@@ -127,7 +154,7 @@ FontCache::FontCache()
   this->config = FcInitLoadConfig();
   if (!this->config) {
     LOG(message_group::Font_Warning, "Can't initialize fontconfig library, text() objects will not be rendered");
-    return;
+    return false;
   }
 
   // Add the built-in fonts & config
@@ -169,13 +196,12 @@ FontCache::FontCache()
   }
   FcStrListDone(dirs);
 
-  const FT_Error error = FT_Init_FreeType(&this->library);
-  if (error) {
-    LOG(message_group::Font_Warning, "Can't initialize freetype library, text() objects will not be rendered");
-    return;
+  for (const auto& path : this->app_fonts) {
+    if (!FcConfigAppFontAddFile(this->config, reinterpret_cast<const FcChar8 *>(path.c_str()))) {
+      LOG("Can't register font '%1$s'", path);
+    }
   }
-
-  this->init_ok = true;
+  return true;
 }
 
 FontCache *FontCache::instance()
@@ -206,13 +232,83 @@ void FontCache::registerProgressHandler(InitHandlerFunc *handler, void *userdata
   FontCache::cb_userdata = userdata;
 }
 
+void FontCache::setIndexDirectory(const std::string& dir)
+{
+  FontCache::index_dir = dir;
+}
+
+/*!
+   Fonts registered before fontconfig is initialized are added once it is.
+ */
 void FontCache::register_font_file(const std::string& path)
 {
-  if (!FcConfigAppFontAddFile(this->config, reinterpret_cast<const FcChar8 *>(path.c_str()))) {
+  std::lock_guard<std::recursive_mutex> lock(this->mutex);
+  if (std::find(this->app_fonts.begin(), this->app_fonts.end(), path) != this->app_fonts.end()) return;
+  this->app_fonts.push_back(path);
+  if (this->config && !FcConfigAppFontAddFile(this->config, reinterpret_cast<const FcChar8 *>(path.c_str()))) {
     LOG("Can't register font '%1$s'", path);
   }
 }
 
+/*!
+   Identifies what the index was built for, as the configured font paths
+   decide which file fontconfig finds for a name.
+ */
+std::string FontCache::index_config() const
+{
+  const char *home = getenv("HOME");
+  const char *env_font_path = getenv("OPENSCAD_FONT_PATH");
+  return openscad_versionnumber + "\n" + PlatformUtils::resourcePath("fonts").string() + "\n" +
+         (home ? home : "") + "\n" + (env_font_path ? env_font_path : "");
+}
+
+/*!
+   The index maps font names to the file and face index fontconfig found for
+   them. An entry is only used while its file keeps its modification time, and
+   the whole index is dropped if the font paths changed. A font installed later
+   which would match better is only seen once the index is removed.
+ */
+void FontCache::load_index()
+{
+  this->index_loaded = true;
+  if (FontCache::index_dir.empty()) return;
+  std::ifstream in((fs::path(FontCache::index_dir) / "fonts.json").string());
+  if (!in.is_open()) return;
+  try {
+    const auto json = nlohmann::json::parse(in);
+    if (json.value("config", "") != index_config()) return;
+    for (const auto& item : json["fonts"].items()) {
+      const auto& entry = item.value();
+      this->font_index[item.key()] = {entry["file"].get<std::string>(), entry["index"].get<int>(), entry["mtime"].get<std::time_t>()};
+    }
+  } catch (const nlohmann::json::exception&) {
+    this->font_index.clear();
+  }
+}
+
+// Written to a temporary file first, so concurrent runs never read a partial index
+void FontCache::save_index() const
+{
+  if (FontCache::index_dir.empty()) return;
+  nlohmann::json fonts;
+  for (const auto& entry : this->font_index) {
+    fonts[entry.first] = {{"file", entry.second.file}, {"index", entry.second.index}, {"mtime", entry.second.mtime}};
+  }
+  const nlohmann::json json{{"config", index_config()}, {"fonts", fonts}};
+  try {
+    fs::create_directories(FontCache::index_dir);
+    const auto tmppath = fs::path(FontCache::index_dir) / fs::unique_path("fonts-%%%%-%%%%.tmp");
+    {
+      std::ofstream out(tmppath.string());
+      if (!out.good()) return;
+      out << json.dump();
+    }
+    fs::rename(tmppath, fs::path(FontCache::index_dir) / "fonts.json");
+  } catch (const fs::filesystem_error& e) {
+    LOG(message_group::Font_Warning, "Can't write font index: %1$s", e.what());
+  }
+}
+
 void FontCache::add_font_dir(const std::string& path)
 {
   if (!fs::is_directory(path)) {
@@ -223,8 +319,10 @@ void FontCache::add_font_dir(const std::string& path)
   }
 }
 
-FontInfoList *FontCache::list_fonts() const
+FontInfoList *FontCache::list_fonts()
 {
+  std::lock_guard<std::recursive_mutex> lock(this->mutex);
+  if (!init_fontconfig()) return new FontInfoList();
   FcObjectSet *object_set = FcObjectSetBuild(FC_FAMILY, FC_STYLE, FC_FILE, nullptr);
   FcPattern *pattern = FcPatternCreate();
   init_pattern(pattern);
@@ -291,6 +389,7 @@ void FontCache::check_cleanup()
 
 FT_Face FontCache::get_font(const std::string& font)
 {
+  std::lock_guard<std::recursive_mutex> lock(this->mutex);
   FT_Face face;
   auto it = this->cache.find(font);
   if (it == this->cache.end()) {
@@ -306,14 +405,40 @@ FT_Face FontCache::get_font(const std::string& font)
   return face;
 }
 
-FT_Face FontCache::find_face(const std::string& font) const
+FT_Face FontCache::find_face(const std::string& font)
 {
   std::string trimmed(font);
   boost::algorithm::trim(trimmed);
 
   const std::string lookup = trimmed.empty() ? DEFAULT_FONT : trimmed;
   PRINTDB("font = \"%s\", lookup = \"%s\"", font % lookup);
-  FT_Face face = find_face_fontconfig(lookup);
+
+  // Fonts registered by use<> are unknown to the index, so they need fontconfig
+  const bool use_index = !FontCache::index_dir.empty() && this->app_fonts.empty();
+  if (use_index && !this->index_loaded) load_index();
+
+  FT_Face face = nullptr;
+  const auto entry = use_index ? this->font_index.find(lookup) : this->font_index.end();
+  if (entry != this->font_index.end()) {
+    boost::system::error_code ec;
+    const std::time_t mtime = fs::last_write_time(entry->second.file, ec);
+    if (!ec && mtime == entry->second.mtime) face = open_face(entry->second.file, entry->second.index);
+    if (!face) this->font_index.erase(entry);
+  }
+  if (!face && init_fontconfig()) {
+    std::string file;
+    int index;
+    if (match_fontconfig(lookup, file, index)) {
+      face = open_face(file, index);
+      boost::system::error_code ec;
+      const std::time_t mtime = fs::last_write_time(file, ec);
+      if (face && use_index && !ec) {
+        this->font_index[lookup] = {file, index, mtime};
+        save_index();
+      }
+    }
+  }
+
   if (face) {
     PRINTDB("result = \"%s\", style = \"%s\"", face->family_name % face->style_name);
   } else {
@@ -332,7 +457,7 @@ void FontCache::init_pattern(FcPattern *pattern) const
   FcPatternAdd(pattern, FC_SCALABLE, true_value, true);
 }
 
-FT_Face FontCache::find_face_fontconfig(const std::string& font) const
+bool FontCache::match_fontconfig(const std::string& font, std::string& file, int& index) const
 {
   FcResult result;
 
@@ -345,20 +470,26 @@ FT_Face FontCache::find_face_fontconfig(const std::string& font) const
   FcPattern *match = FcFontMatch(this->config, pattern, &result);
 
   FcValue file_value;
-  if (FcPatternGet(match, FC_FILE, 0, &file_value) != FcResultMatch) {
-    return nullptr;
-  }
-
   FcValue font_index;
-  if (FcPatternGet(match, FC_INDEX, 0, &font_index)) {
-    return nullptr;
+  const bool found = match &&
+                     FcPatternGet(match, FC_FILE, 0, &file_value) == FcResultMatch &&
+                     FcPatternGet(match, FC_INDEX, 0, &font_index) == FcResultMatch;
+  if (found) {
+    file = (const char *) file_value.u.s;
+    index = font_index.u.i;
   }
 
-  FT_Face face;
-  FT_Error error = FT_New_Face(this->library, (const char *) file_value.u.s, font_index.u.i, &face);
-
   FcPatternDestroy(pattern);
-  FcPatternDestroy(match);
+  if (match) FcPatternDestroy(match);
+  return found;
+}
+
+FT_Face FontCache::open_face(const std::string& file, int index) const
+{
+  FT_Face face;
+  if (FT_New_Face(this->library, file.c_str(), index, &face)) {
+    return nullptr;
+  }
 
   for (int a = 0; a < face->num_charmaps; ++a) {
     FT_CharMap charmap = face->charmaps[a];
@@ -379,7 +510,7 @@ FT_Face FontCache::find_face_fontconfig(const std::string& font) const
     if (!charmap_set) LOG(message_group::Font_Warning, "Could not select a char map for font %1$s/%2$s'", face->family_name, face->style_name);
   }
 
-  return error ? nullptr : face;
+  return face;
 }
 
 bool FontCache::try_charmap(FT_Face face, int platform_id, int encoding_id) const
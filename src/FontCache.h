@@ -25,8 +25,11 @@
  */
 #pragma once
 
+#include <ctime>
 #include <map>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <iostream>
 
 #include <ctime>
@@ -74,6 +77,14 @@ private:
   FcConfig *config;
 };
 
+/*!
+   Looks up fonts with fontconfig and keeps the recently used faces open.
+
+   Fontconfig is only initialized on the first lookup, as building its font set
+   takes seconds on systems with many fonts. With an index directory set, the
+   files found for each font name are also kept in an index there, and later
+   runs open them directly without initializing fontconfig at all.
+ */
 class FontCache
 {
 public:
@@ -88,10 +99,14 @@ public:
   [[nodiscard]] bool is_windows_symbol_font(const FT_Face& face) const;
   void register_font_file(const std::string& path);
   void clear();
-  [[nodiscard]] FontInfoList *list_fonts() const;
+  [[nodiscard]] FontInfoList *list_fonts();
   [[nodiscard]] const std::string get_freetype_version() const;
+  // Loads the fontconfig configuration and builds the font set, if not done yet
+  bool init_fontconfig();
 
   static FontCache *instance();
+  // Directory of the persistent font index, disabled if empty
+  static void setIndexDirectory(const std::string& dir);
 
   using InitHandlerFunc = void (FontCacheInitializer *, void *);
   static void registerProgressHandler(InitHandlerFunc *handler, void *userdata = nullptr);
@@ -103,13 +118,31 @@ private:
   static FontCache *self;
   static InitHandlerFunc *cb_handler;
   static void *cb_userdata;
+  static std::string index_dir;
 
   static void defaultInitHandler(FontCacheInitializer *delegate, void *userdata);
 
   bool init_ok;
   cache_t cache;
-  FcConfig *config;
+  FcConfig *config{nullptr};
+  bool config_loaded{false};
   FT_Library library;
+  std::recursive_mutex mutex;
+
+  // Font name -> file and face index, see load_index()
+  struct index_entry_t {
+    std::string file;
+    int index;
+    std::time_t mtime;
+  };
+  std::map<std::string, index_entry_t> font_index;
+  bool index_loaded{false};
+  // Font files registered by use<>, these can take part in any lookup
+  std::vector<std::string> app_fonts;
+
+  void load_index();
+  void save_index() const;
+  [[nodiscard]] std::string index_config() const;
 
   void check_cleanup();
   void dump_cache(const std::string& info);
@@ -117,8 +150,9 @@ private:
   void add_font_dir(const std::string& path);
   void init_pattern(FcPattern *pattern) const;
 
-  [[nodiscard]] FT_Face find_face(const std::string& font) const;
-  [[nodiscard]] FT_Face find_face_fontconfig(const std::string& font) const;
+  [[nodiscard]] FT_Face find_face(const std::string& font);
+  bool match_fontconfig(const std::string& font, std::string& file, int& index) const;
+  [[nodiscard]] FT_Face open_face(const std::string& file, int index) const;
   bool try_charmap(FT_Face face, int platform_id, int encoding_id) const;
 };
 
@@ -43,7 +43,7 @@
 #endif
 
 extern std::vector<std::string> librarypath;
-extern std::vector<std::string> fontpath;
+extern const std::vector<std::string>& get_fontpath();
 extern const std::string get_cairo_version();
 extern const std::string get_lib3mf_version();
 extern const std::string get_fontconfig_version();
@@ -158,7 +158,7 @@ std::string LibraryInfo::info()
   s << "\nOPENSCAD_FONT_PATH: " << (env_font_path == nullptr ? "<not set>" : env_font_path)
     << "\nOpenSCAD font path:\n";
 
-  for (const auto& path : fontpath) {
+  for (const auto& path : get_fontpath()) {
     s << "  " << path << "\n";
   }
 
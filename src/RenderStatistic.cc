@@ -27,7 +27,20 @@
 
 #include "printutils.h"
 #include "GeometryCache.h"
+#include "GeometryDiskCache.h"
+#include "SourceFileDiskCache.h"
+#include "NodeProfiler.h"
+#include "CacheMissRecorder.h"
 #include "CGALCache.h"
+#include "FunctionCache.h"
+#include "ModuleCache.h"
+#include "GlyphCache.h"
+#include "ImportCache.h"
+#include "ContextMemoryManager.h"
+#include "Feature.h"
+#include "PlatformUtils.h"
+#include "openscad_mimalloc.h"
+#include "TimingCounters.h"
 #include "PolySet.h"
 #include "Polygon2d.h"
 #ifdef ENABLE_CGAL
@@ -55,6 +68,10 @@ struct StatisticVisitor : public GeometryVisitor
   virtual void printCamera(const Camera& camera) = 0;
   virtual void printCacheStatistic() = 0;
   virtual void printRenderingTime(std::chrono::milliseconds) = 0;
+  virtual void printProfile() = 0;
+  virtual void printCacheMisses() = 0;
+  virtual void printGarbageCollection() = 0;
+  virtual void printMemory() = 0;
   virtual void finish() = 0;
 protected:
   bool is_enabled(const std::string& name) {
@@ -81,6 +98,10 @@ struct LogVisitor : public StatisticVisitor
   void printCamera(const Camera& camera) override;
   void printCacheStatistic() override;
   void printRenderingTime(std::chrono::milliseconds) override;
+  void printProfile() override;
+  void printCacheMisses() override;
+  void printGarbageCollection() override;
+  void printMemory() override;
   void finish() override;
 private:
   void printBoundingBox3(const BoundingBox& bb);
@@ -106,6 +127,10 @@ struct StreamVisitor : public StatisticVisitor
   void printCamera(const Camera& camera) override;
   void printCacheStatistic() override;
   void printRenderingTime(std::chrono::milliseconds) override;
+  void printProfile() override;
+  void printCacheMisses() override;
+  void printGarbageCollection() override;
+  void printMemory() override;
   void finish() override;
 private:
   nlohmann::json json;
@@ -155,11 +180,15 @@ static nlohmann::json getCache(C cache)
 
 RenderStatistic::RenderStatistic() : begin(std::chrono::steady_clock::now())
 {
+  NodeProfiler::instance()->clear();
+  CacheMissRecorder::instance()->clear();
 }
 
 void RenderStatistic::start()
 {
   begin = std::chrono::steady_clock::now();
+  NodeProfiler::instance()->clear();
+  CacheMissRecorder::instance()->clear();
 }
 
 std::chrono::milliseconds RenderStatistic::ms()
@@ -196,6 +225,10 @@ void RenderStatistic::printAll(const shared_ptr<const Geometry>& geom, const Cam
 
   visitor->printCacheStatistic();
   visitor->printRenderingTime(ms());
+  visitor->printProfile();
+  visitor->printCacheMisses();
+  visitor->printGarbageCollection();
+  visitor->printMemory();
   if (geom && !geom->isEmpty()) {
     geom->accept(*visitor);
   }
@@ -243,6 +276,10 @@ void LogVisitor::visit(const PolySet& ps)
   LOG("Top level object is a 3D object:");
   LOG("   Facets:     %1$6d", ps.numFacets());
   printBoundingBox3(ps.getBoundingBox());
+  if (is_enabled(RenderStatistic::AREA) && ps.isManifold()) {
+    LOG("Measurements:");
+    LOG("   Volume: %1$.2f", ps.volume());
+  }
 }
 
 #ifdef ENABLE_CGAL
@@ -312,6 +349,12 @@ void LogVisitor::printCacheStatistic()
 #ifdef ENABLE_CGAL
   CGALCache::instance()->print();
 #endif
+  GeometryDiskCache::instance()->print();
+  SourceFileDiskCache::instance()->print();
+  FunctionCache::instance()->print();
+  ModuleCache::instance()->print();
+  GlyphCache::instance()->print();
+  ImportCache::instance()->print();
 }
 
 void LogVisitor::printRenderingTime(const std::chrono::milliseconds ms)
@@ -322,6 +365,66 @@ void LogVisitor::printRenderingTime(const std::chrono::milliseconds ms)
       (ms.count() / 1000 / 60 % 60),
       (ms.count() / 1000 % 60),
       (ms.count() % 1000));
+  if (is_enabled(RenderStatistic::TIME)) {
+    for (int i = 0; i < TimingCounters::NUM_COUNTERS; ++i) {
+      const auto counter = static_cast<TimingCounters::Counter>(i);
+      if (!TimingCounters::calls(counter)) continue;
+      LOG("   %1$-8s %2$-16s %3$10.3f s %4$8d calls",
+          TimingCounters::isStage(counter) ? "stage" : "kernel", TimingCounters::name(counter),
+          TimingCounters::nanoseconds(counter) / 1e9, TimingCounters::calls(counter));
+    }
+#ifdef ENABLE_CGAL
+    for (const auto& fallback : CGALHybridPolyhedron::fallbackCounts()) {
+      LOG("   fast-csg nef fallbacks: %1$d, %2$s", fallback.second, fallback.first);
+    }
+#endif
+  }
+}
+
+void LogVisitor::printProfile()
+{
+  if (is_enabled(RenderStatistic::PROFILE)) {
+    NodeProfiler::instance()->print();
+  }
+}
+
+void LogVisitor::printCacheMisses()
+{
+  if (is_enabled(RenderStatistic::CACHE_MISSES)) {
+    CacheMissRecorder::instance()->print();
+  }
+}
+
+void LogVisitor::printGarbageCollection()
+{
+  if (is_enabled(RenderStatistic::GC)) {
+    ContextMemoryManager::statistics().print();
+  }
+}
+
+void LogVisitor::printMemory()
+{
+  if (is_enabled(RenderStatistic::MEMORY)) {
+    LOG("Peak memory usage: %1$s", PlatformUtils::toMemorySizeString(PlatformUtils::peakMemoryUsage(), 2));
+    NodeProfiler::instance()->printMemory();
+    LOG("Memory in caches:");
+    LOG("   Geometry cache: %1$s", PlatformUtils::toMemorySizeString(GeometryCache::instance()->totalCost(), 2));
+#ifdef ENABLE_CGAL
+    LOG("   CGAL cache:     %1$s", PlatformUtils::toMemorySizeString(CGALCache::instance()->totalCost(), 2));
+#endif
+    LOG("   Function cache: %1$s (peak)", PlatformUtils::toMemorySizeString(FunctionCache::instance()->peakCost(), 2));
+    LOG("   Glyph cache:    %1$s", PlatformUtils::toMemorySizeString(GlyphCache::instance()->totalCost(), 2));
+    LOG("   Import cache:   %1$s", PlatformUtils::toMemorySizeString(ImportCache::instance()->totalCost(), 2));
+    const auto& statistics = ContextMemoryManager::statistics();
+    LOG("Evaluation heap: %1$d contexts, variables and vector elements at the peak, %2$d allocated",
+        statistics.peakHeapSize, statistics.allocations);
+    AllocatorStatistics allocator;
+    if (get_allocator_statistics(allocator)) {
+      LOG("Allocator: %1$s committed, %2$s at the peak, %3$d page faults",
+          PlatformUtils::toMemorySizeString(allocator.committed, 2), PlatformUtils::toMemorySizeString(allocator.peak_committed, 2),
+          allocator.page_faults);
+    }
+  }
 }
 
 void LogVisitor::finish()
@@ -433,6 +536,41 @@ void StreamVisitor::printCacheStatistic()
 #ifdef ENABLE_CGAL
     cacheJson["cgal_cache"] = getCache(CGALCache::instance());
 #endif // ENABLE_CGAL
+    if (GeometryDiskCache::instance()->isEnabled()) {
+      auto diskCacheJson = getCache(GeometryDiskCache::instance());
+      diskCacheJson["hits"] = GeometryDiskCache::instance()->hits();
+      cacheJson["disk_cache"] = diskCacheJson;
+    }
+    if (SourceFileDiskCache::instance()->isEnabled()) {
+      nlohmann::json libraryCacheJson;
+      libraryCacheJson["hits"] = SourceFileDiskCache::instance()->hits();
+      cacheJson["library_cache"] = libraryCacheJson;
+    }
+    if (Feature::ExperimentalMemoize.is_enabled()) {
+      // The function cache is emptied with the evaluation session, report its peak usage
+      nlohmann::json functionCacheJson;
+      functionCacheJson["entries"] = FunctionCache::instance()->peakSize();
+      functionCacheJson["bytes"] = FunctionCache::instance()->peakCost();
+      functionCacheJson["max_size"] = FunctionCache::instance()->maxSizeMB() * 1024 * 1024;
+      functionCacheJson["hits"] = FunctionCache::instance()->hits();
+      cacheJson["function_cache"] = functionCacheJson;
+    }
+    if (Feature::ExperimentalModuleCache.is_enabled()) {
+      nlohmann::json moduleCacheJson;
+      moduleCacheJson["bytes"] = ModuleCache::instance()->peakCost();
+      moduleCacheJson["hits"] = ModuleCache::instance()->hits();
+      cacheJson["module_cache"] = moduleCacheJson;
+    }
+    if (GlyphCache::instance()->size() > 0 || GlyphCache::instance()->hits() > 0) {
+      auto glyphCacheJson = getCache(GlyphCache::instance());
+      glyphCacheJson["hits"] = GlyphCache::instance()->hits();
+      cacheJson["glyph_cache"] = glyphCacheJson;
+    }
+    if (ImportCache::instance()->size() > 0 || ImportCache::instance()->hits() > 0) {
+      auto importCacheJson = getCache(ImportCache::instance());
+      importCacheJson["hits"] = ImportCache::instance()->hits();
+      cacheJson["import_cache"] = importCacheJson;
+    }
     json["cache"] = cacheJson;
   }
 }
@@ -451,10 +589,85 @@ void StreamVisitor::printRenderingTime(const std::chrono::milliseconds ms)
     timeJson["seconds"] = ms.count() / 1000 % 60;
     timeJson["minutes"] = ms.count() / 1000 / 60 % 60;
     timeJson["hours"] = ms.count() / 1000 / 60 / 60;
+    // Totals since the start of the process, in milliseconds
+    nlohmann::json stagesJson = nlohmann::json::object(), kernelsJson = nlohmann::json::object();
+    for (int i = 0; i < TimingCounters::NUM_COUNTERS; ++i) {
+      const auto counter = static_cast<TimingCounters::Counter>(i);
+      nlohmann::json counterJson;
+      counterJson["milliseconds"] = TimingCounters::nanoseconds(counter) / 1e6;
+      counterJson["calls"] = TimingCounters::calls(counter);
+      (TimingCounters::isStage(counter) ? stagesJson : kernelsJson)[TimingCounters::name(counter)] = counterJson;
+    }
+    timeJson["stages"] = stagesJson;
+    timeJson["kernels"] = kernelsJson;
+#ifdef ENABLE_CGAL
+    // Boolean operations fast-csg did with nef polyhedra, by reason
+    nlohmann::json fallbacksJson = nlohmann::json::object();
+    for (const auto& fallback : CGALHybridPolyhedron::fallbackCounts()) fallbacksJson[fallback.first] = fallback.second;
+    timeJson["fast_csg_fallbacks"] = fallbacksJson;
+#endif
     json["time"] = timeJson;
   }
 }
 
+void StreamVisitor::printProfile()
+{
+  if (is_enabled(RenderStatistic::PROFILE)) {
+    json["profile"] = NodeProfiler::instance()->summaryJson();
+  }
+}
+
+void StreamVisitor::printCacheMisses()
+{
+  if (is_enabled(RenderStatistic::CACHE_MISSES)) {
+    json["cache_misses"] = CacheMissRecorder::instance()->summaryJson();
+  }
+}
+
+void StreamVisitor::printGarbageCollection()
+{
+  if (is_enabled(RenderStatistic::GC)) {
+    const auto& statistics = ContextMemoryManager::statistics();
+    nlohmann::json gcJson;
+    gcJson["minor_collections"] = statistics.minorCollections;
+    gcJson["major_collections"] = statistics.majorCollections;
+    gcJson["collected_contexts"] = statistics.collectedContexts;
+    gcJson["milliseconds"] = std::chrono::duration_cast<std::chrono::milliseconds>(statistics.time).count();
+    json["gc"] = gcJson;
+  }
+}
+
+void StreamVisitor::printMemory()
+{
+  if (is_enabled(RenderStatistic::MEMORY)) {
+    nlohmann::json memoryJson = NodeProfiler::instance()->memoryJson();
+    memoryJson["peak_rss"] = PlatformUtils::peakMemoryUsage();
+    nlohmann::json cachesJson;
+    cachesJson["geometry_cache"] = GeometryCache::instance()->totalCost();
+#ifdef ENABLE_CGAL
+    cachesJson["cgal_cache"] = CGALCache::instance()->totalCost();
+#endif // ENABLE_CGAL
+    cachesJson["function_cache"] = FunctionCache::instance()->peakCost();
+    cachesJson["glyph_cache"] = GlyphCache::instance()->totalCost();
+    cachesJson["import_cache"] = ImportCache::instance()->totalCost();
+    memoryJson["caches"] = cachesJson;
+    const auto& statistics = ContextMemoryManager::statistics();
+    nlohmann::json heapJson;
+    heapJson["peak_values"] = statistics.peakHeapSize;
+    heapJson["allocated_values"] = statistics.allocations;
+    memoryJson["evaluation_heap"] = heapJson;
+    AllocatorStatistics allocator;
+    if (get_allocator_statistics(allocator)) {
+      nlohmann::json allocatorJson;
+      allocatorJson["committed"] = allocator.committed;
+      allocatorJson["peak_committed"] = allocator.peak_committed;
+      allocatorJson["page_faults"] = allocator.page_faults;
+      memoryJson["allocator"] = allocatorJson;
+    }
+    json["memory"] = memoryJson;
+  }
+}
+
 void StreamVisitor::finish()
 {
   stream << json;
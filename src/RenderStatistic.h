@@ -42,6 +42,10 @@ public:
   constexpr static auto GEOMETRY = "geometry";
   constexpr static auto BOUNDING_BOX = "bounding-box";
   constexpr static auto AREA = "area";
+  constexpr static auto PROFILE = "profile";
+  constexpr static auto GC = "gc";
+  constexpr static auto MEMORY = "memory";
+  constexpr static auto CACHE_MISSES = "cache-misses";
 
   /**
    * Construct a statistic printer for the given geometry with current
@@ -51,6 +55,7 @@ public:
 
   /**
    * Set start time when reusing a RenderStatistic instance.
+   * This also resets the node profile and cache misses of the previous render.
    */
   void start();
 
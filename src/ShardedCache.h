@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include "Cache.h"
+
+/*!
+   Cache<Key, T> split into shards with a lock each, so threads using
+   different keys don't contend for one lock.
+
+   The cost limit applies to all shards together. Their total is kept in an
+   atomic, and when an insertion exceeds the limit, objects are evicted from
+   one shard after another until it fits again. The eviction order is thus
+   kept per shard only.
+
+   Objects are used under the lock of their shard with access(), so e.g. a
+   shared_ptr can be copied out before another thread evicts the object.
+ */
+template <class Key, class T, size_t N = 16>
+class ShardedCache
+{
+public:
+  using cache_type = Cache<Key, T>;
+
+  explicit ShardedCache(size_t maxCost) : mx(maxCost) {}
+
+  // Calls f(cache) with the shard for key locked, and returns its result
+  template <class F>
+  auto access(const Key& key, F f) const -> decltype(f(std::declval<cache_type&>())) {
+    auto& shard = this->shards[shardIndex(key)];
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    const size_t before = shard.cache.totalCost();
+    auto result = f(shard.cache);
+    const size_t after = shard.cache.totalCost();
+    lock.unlock();
+    if (after > before) {
+      this->total += after - before;
+      trim();
+    } else {
+      this->total -= before - after;
+    }
+    return result;
+  }
+
+  bool insert(const Key& key, T *object, size_t cost, double benefit = 0) {
+    if (cost > this->mx) {
+      delete object;
+      return false;
+    }
+    return access(key, [&](cache_type& cache) { return cache.insert(key, object, cost, benefit); });
+  }
+  bool contains(const Key& key) const {
+    return access(key, [&](cache_type& cache) { return cache.contains(key); });
+  }
+  bool remove(const Key& key) {
+    return access(key, [&](cache_type& cache) { return cache.remove(key); });
+  }
+
+  [[nodiscard]] size_t maxCost() const { return this->mx; }
+  void setMaxCost(size_t m) { this->mx = m; trim(); }
+  [[nodiscard]] size_t totalCost() const { return this->total; }
+  [[nodiscard]] size_t size() const { return sum([](const cache_type& cache) { return cache.size(); }); }
+  [[nodiscard]] double totalBenefit() const { return sum([](const cache_type& cache) { return cache.totalBenefit(); }); }
+  [[nodiscard]] size_t evictions() const { return sum([](const cache_type& cache) { return cache.evictions(); }); }
+  [[nodiscard]] double evictedBenefit() const { return sum([](const cache_type& cache) { return cache.evictedBenefit(); }); }
+
+  void clear() {
+    for (auto& shard : this->shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      this->total -= shard.cache.totalCost();
+      shard.cache.clear();
+    }
+  }
+
+  // See Cache::costIf(), Cache::evict() and Cache::removeIf(), over all shards
+  template <class Pred>
+  size_t costIf(Pred pred) const {
+    return sum([&pred](const cache_type& cache) { return cache.costIf(pred); });
+  }
+  template <class Pred>
+  size_t evict(size_t amount, Pred keep) {
+    size_t removed = 0;
+    const size_t start = this->next_shard++;
+    for (size_t i = 0; i < N && removed < amount; ++i) {
+      auto& shard = this->shards[(start + i) % N];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      const size_t freed = shard.cache.evict(amount - removed, keep);
+      this->total -= freed;
+      removed += freed;
+    }
+    return removed;
+  }
+  template <class Pred>
+  size_t removeIf(Pred pred) {
+    size_t removed = 0;
+    for (auto& shard : this->shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      const size_t freed = shard.cache.removeIf(pred);
+      this->total -= freed;
+      removed += freed;
+    }
+    return removed;
+  }
+
+private:
+  struct Shard {
+    cache_type cache{std::numeric_limits<size_t>::max()};
+    std::mutex mutex;
+  };
+
+  static size_t shardIndex(const Key& key) {
+    // Mix the bits, std::hash may be an identity or an aligned address
+    uint64_t h = std::hash<Key>{}(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return static_cast<size_t>(h % N);
+  }
+
+  template <class F>
+  auto sum(F f) const -> decltype(f(std::declval<const cache_type&>())) {
+    decltype(f(std::declval<const cache_type&>())) result{};
+    for (auto& shard : this->shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      result += f(shard.cache);
+    }
+    return result;
+  }
+
+  // Evicts from one shard after another until the total fits the limit
+  void trim() const {
+    const size_t start = this->next_shard++;
+    for (size_t i = 0; i < N; ++i) {
+      const size_t total = this->total, limit = this->mx;
+      if (total <= limit) return;
+      auto& shard = this->shards[(start + i) % N];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      this->total -= shard.cache.evict(total - limit, [](const Key&, const T&) { return false; });
+    }
+  }
+
+  mutable std::array<Shard, N> shards;
+  std::atomic<size_t> mx;
+  mutable std::atomic<size_t> total{0};
+  mutable std::atomic<size_t> next_shard{0};
+};
@@ -1,16 +1,64 @@
 #include "AST.h"
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 #include "boost-utils.h"
 
+namespace {
+
+// Paths are never removed, so references to them stay valid
+struct FileTable {
+  FileTable() { paths.push_back(std::make_unique<const fs::path>()); ids.emplace(std::string(), 0); }
+  std::mutex mutex;
+  std::vector<std::unique_ptr<const fs::path>> paths;
+  std::unordered_map<std::string, uint32_t> ids;
+};
+
+FileTable& fileTable()
+{
+  static FileTable table;
+  return table;
+}
+
+} // namespace
+
 const Location Location::NONE(0, 0, 0, 0, std::make_shared<fs::path>(fs::path{}));
 
+uint32_t Location::fileId(const std::shared_ptr<fs::path>& path)
+{
+  if (!path) return 0;
+  // The parser creates all locations of a file in a row
+  thread_local const fs::path *last_path = nullptr;
+  thread_local uint32_t last_id = 0;
+  if (last_path && *last_path == *path) return last_id;
+
+  auto& table = fileTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  auto it = table.ids.find(path->string());
+  if (it == table.ids.end()) {
+    it = table.ids.emplace(path->string(), table.paths.size()).first;
+    table.paths.push_back(std::make_unique<const fs::path>(*path));
+  }
+  last_path = table.paths[it->second].get();
+  last_id = it->second;
+  return last_id;
+}
+
+const fs::path& Location::filePath() const
+{
+  auto& table = fileTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  return *table.paths[this->file];
+}
+
 bool operator==(Location const& lhs, Location const& rhs){
   return
     lhs.firstLine() == rhs.firstLine() &&
     lhs.firstColumn() == rhs.firstColumn() &&
     lhs.lastLine() == rhs.lastLine() &&
     lhs.lastColumn() == rhs.lastColumn() &&
-    lhs.filePath() == rhs.filePath();
+    &lhs.filePath() == &rhs.filePath();
 }
 
 bool operator!=(Location const& lhs, Location const& rhs)
@@ -24,7 +72,7 @@ bool Location::isNone() const {
 
 std::string Location::toRelativeString(const std::string& docPath) const {
   if (this->isNone()) return "location unknown";
-  return "in file " + boostfs_uncomplete((*path), docPath).generic_string() + ", " + "line " + std::to_string(this->firstLine());
+  return "in file " + boostfs_uncomplete(filePath(), docPath).generic_string() + ", " + "line " + std::to_string(this->firstLine());
 }
 
 std::ostream& operator<<(std::ostream& stream, const ASTNode& ast)
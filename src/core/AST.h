@@ -6,20 +6,25 @@
 #include <utility>
 namespace fs = boost::filesystem;
 
+#include <cstdint>
 #include <string>
 
+/*!
+   Every AST node has a location, so it is kept small and trivially copyable:
+   the file is an index into a process wide table of source paths.
+ */
 class Location
 {
 
 public:
   Location(int firstLine, int firstCol, int lastLine, int lastCol,
-           std::shared_ptr<fs::path> path)
+           const std::shared_ptr<fs::path>& path)
     : first_line(firstLine), first_col(firstCol), last_line(lastLine),
-    last_col(lastCol), path(std::move(path)) {
+    last_col(lastCol), file(fileId(path)) {
   }
 
-  [[nodiscard]] std::string fileName() const { return path ? path->generic_string() : ""; }
-  [[nodiscard]] const fs::path& filePath() const { return *path; }
+  [[nodiscard]] std::string fileName() const { return filePath().generic_string(); }
+  [[nodiscard]] const fs::path& filePath() const;
   [[nodiscard]] int firstLine() const { return first_line; }
   [[nodiscard]] int firstColumn() const { return first_col; }
   [[nodiscard]] int lastLine() const { return last_line; }
@@ -33,11 +38,13 @@ public:
 
   static const Location NONE;
 private:
+  static uint32_t fileId(const std::shared_ptr<fs::path>& path);
+
   int first_line;
   int first_col;
   int last_line;
   int last_col;
-  std::shared_ptr<fs::path> path;
+  uint32_t file; // 0 is the empty path
 };
 
 class ASTNode
@@ -28,7 +28,8 @@
 #include "Expression.h"
 
 Arguments::Arguments(const AssignmentList& argument_expressions, const std::shared_ptr<const Context>& context) :
-  evaluation_session(context->session())
+  evaluation_session(context->session()),
+  call_site(&argument_expressions)
 {
   for (const auto& argument_expression : argument_expressions) {
     emplace_back(
@@ -40,7 +41,7 @@ Arguments::Arguments(const AssignmentList& argument_expressions, const std::shar
 
 Arguments Arguments::clone() const
 {
-  Arguments output(evaluation_session);
+  Arguments output(evaluation_session, call_site);
   for (const Argument& argument : *this) {
     output.emplace_back(argument.name, argument.value.clone());
   }
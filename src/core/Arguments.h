@@ -35,16 +35,19 @@ public:
   ~Arguments() = default;
 
 private:
-  Arguments(EvaluationSession *session) : evaluation_session(session) {}
+  Arguments(EvaluationSession *session, const AssignmentList *call_site) : evaluation_session(session), call_site(call_site) {}
 
 public:
   [[nodiscard]] Arguments clone() const;
 
   [[nodiscard]] EvaluationSession *session() const { return evaluation_session; }
   [[nodiscard]] const std::string& documentRoot() const { return evaluation_session->documentRoot(); }
+  // The argument expressions evaluated, which identify the call site
+  [[nodiscard]] const AssignmentList *callSite() const { return call_site; }
 
 private:
   EvaluationSession *evaluation_session;
+  const AssignmentList *call_site;
 };
 
 std::ostream& operator<<(std::ostream& stream, const Argument& argument);
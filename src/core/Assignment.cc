@@ -58,7 +58,7 @@ void Assignment::print(std::ostream& stream, const std::string& indent) const
     const Annotation *parameter = this->annotation("Parameter");
     if (parameter) parameter->print(stream, indent);
   }
-  stream << indent << this->name << " = " << *this->expr << ";\n";
+  stream << indent << this->name.getName() << " = " << *this->expr << ";\n";
 }
 
 std::ostream& operator<<(std::ostream& stream, const AssignmentList& assignments)
@@ -9,8 +9,8 @@ class BuiltinContext : public Context
 {
 public:
   void init() override;
-  boost::optional<CallableFunction> lookup_local_function(const std::string& name, const Location& loc) const override;
-  boost::optional<InstantiableModule> lookup_local_module(const std::string& name, const Location& loc) const override;
+  boost::optional<CallableFunction> lookup_local_function(const Identifier& name, const Location& loc) const override;
+  boost::optional<InstantiableModule> lookup_local_module(const Identifier& name, const Location& loc) const override;
 
 protected:
   BuiltinContext(EvaluationSession *session);
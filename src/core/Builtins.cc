@@ -5,9 +5,26 @@
 
 std::unordered_map<std::string, const std::vector<std::string>> Builtins::keywordList;
 
+namespace {
+
+// The instance being created, which the register functions add to
+Builtins *registering = nullptr;
+
+} // namespace
+
+Builtins *Builtins::create()
+{
+  auto *builtins = new Builtins;
+  registering = builtins;
+  builtins->initialize();
+  registering = nullptr;
+  return builtins;
+}
+
 Builtins *Builtins::instance(bool erase)
 {
-  static auto *builtins = new Builtins;
+  // Thread safe, in case the first use is from a background evaluation
+  static auto *builtins = create();
   if (erase) {
     delete builtins;
     builtins = nullptr;
@@ -20,7 +37,7 @@ void Builtins::init(const std::string& name, class AbstractModule *module)
 #ifndef ENABLE_EXPERIMENTAL
   if (module->is_experimental()) return;
 #endif
-  Builtins::instance()->modules.emplace(name, module);
+  (registering ? registering : Builtins::instance())->modules.emplace(name, module);
 }
 
 void Builtins::init(const std::string& name, AbstractModule *module, const std::vector<std::string>& calltipList)
@@ -28,7 +45,7 @@ void Builtins::init(const std::string& name, AbstractModule *module, const std::
 #ifndef ENABLE_EXPERIMENTAL
   if (module->is_experimental()) return;
 #endif
-  Builtins::instance()->modules.emplace(name, module);
+  (registering ? registering : Builtins::instance())->modules.emplace(name, module);
   Builtins::keywordList.insert({name, calltipList});
 }
 
@@ -37,7 +54,7 @@ void Builtins::init(const std::string& name, BuiltinFunction *function, const st
 #ifndef ENABLE_EXPERIMENTAL
   if (function->is_experimental()) return;
 #endif
-  Builtins::instance()->functions.emplace(name, function);
+  (registering ? registering : Builtins::instance())->functions.emplace(name, function);
   Builtins::keywordList.insert({name, calltipList});
 }
 
@@ -62,7 +79,7 @@ extern void initialize_builtin_dxf_dim();
 
 /*!
    Registers all builtin functions.
-   Call once for the whole app.
+   Called once for the whole app, by instance().
  */
 void Builtins::initialize()
 {
@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include "module.h"
 #include "Assignment.h"
+#include "Identifier.h"
 
 class AbstractModule;
 class BuiltinFunction;
@@ -11,28 +12,33 @@ class BuiltinFunction;
 class Builtins
 {
 public:
+  // Registers the builtins on first use, so runs which evaluate nothing don't pay for it
   static Builtins *instance(bool erase = false);
   static void init(const std::string& name, AbstractModule *module);
   static void init(const std::string& name, AbstractModule *module, const std::vector<std::string>& calltipList);
   static void init(const std::string& name, BuiltinFunction *function, const std::vector<std::string>& calltipList);
-  void initialize();
   std::string isDeprecated(const std::string& name) const;
 
   const auto& getAssignments() const { return this->assignments; }
   const auto& getFunctions() const { return this->functions; }
   const auto& getModules() const { return this->modules; }
 
-  static std::unordered_map<std::string, const std::vector<std::string>> keywordList;
+  // The keywords and builtins with their calltips, for the editor
+  static const auto& keywords() { instance(); return keywordList; }
 
 private:
   Builtins();
   virtual ~Builtins() = default;
 
+  static Builtins *create();
+  void initialize();
   static void initKeywordList();
 
+  static std::unordered_map<std::string, const std::vector<std::string>> keywordList;
+
   AssignmentList assignments;
-  std::unordered_map<std::string, BuiltinFunction *> functions;
-  std::unordered_map<std::string, AbstractModule *> modules;
+  std::unordered_map<Identifier, BuiltinFunction *> functions;
+  std::unordered_map<Identifier, AbstractModule *> modules;
 
   std::unordered_map<std::string, std::string> deprecations;
 };
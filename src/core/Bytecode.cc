@@ -0,0 +1,217 @@
+#include "Bytecode.h"
+#include "Context.h"
+#include "Feature.h"
+#include "exceptions.h"
+
+#include <algorithm>
+#include <cassert>
+#include <typeinfo>
+
+/*!
+   The evaluator runs the tail positions of function bodies in a loop to allow
+   deep tail recursion, so bodies with calls in tail position stay on the tree
+   walker.
+ */
+static bool hasTailCall(const Expression& expr)
+{
+  const auto& type = typeid(expr);
+  if (type == typeid(FunctionCall) || type == typeid(Let) || type == typeid(Assert) || type == typeid(Echo)) {
+    return true;
+  }
+  if (type == typeid(TernaryOp)) {
+    const auto& ternary = static_cast<const TernaryOp&>(expr);
+    return hasTailCall(*ternary.getIfExpr()) || hasTailCall(*ternary.getElseExpr());
+  }
+  return false;
+}
+
+// List comprehensions append to the vector being built, so such vectors are left to the tree walker
+static bool hasListComprehension(const Vector& vector)
+{
+  const auto& children = vector.getChildren();
+  return std::any_of(children.begin(), children.end(), [](const auto& child) {
+    return dynamic_cast<const ListComprehension *>(child.get()) != nullptr;
+  });
+}
+
+/*!
+   Returns nullptr if expr can't be compiled to something faster than the tree walker.
+ */
+std::shared_ptr<const Bytecode> Bytecode::compile(const Expression& expr)
+{
+  if (hasTailCall(expr)) return nullptr;
+  auto bytecode = std::make_shared<Bytecode>();
+  bytecode->compileExpression(expr);
+  if (bytecode->code.size() == 1 && bytecode->code.front().opcode == OpCode::Evaluate) return nullptr;
+  return bytecode;
+}
+
+size_t Bytecode::emit(OpCode opcode, uint32_t arg, const Expression *source, int stack_effect, BinaryOp::Op op)
+{
+  this->code.push_back({opcode, op, arg, source});
+  this->stack_depth += stack_effect;
+  this->max_stack_depth = std::max(this->max_stack_depth, this->stack_depth);
+  return this->code.size() - 1;
+}
+
+void Bytecode::compileExpression(const Expression& expr)
+{
+  const auto& type = typeid(expr);
+  if (type == typeid(Literal)) {
+    this->constants.push_back(expr.evaluate(nullptr));
+    emit(OpCode::Constant, this->constants.size() - 1, &expr, 1);
+  } else if (expr.isConstant()) {
+    // Folded by the tree walker, so evaluating it only copies the value
+    this->expressions.push_back(&expr);
+    emit(OpCode::Evaluate, this->expressions.size() - 1, &expr, 1);
+  } else if (type == typeid(Lookup)) {
+    this->lookups.push_back(static_cast<const Lookup *>(&expr));
+    emit(OpCode::Load, this->lookups.size() - 1, &expr, 1);
+  } else if (type == typeid(UnaryOp)) {
+    const auto& unary = static_cast<const UnaryOp&>(expr);
+    compileExpression(*unary.getExpr());
+    emit(unary.getOp() == UnaryOp::Op::Not ? OpCode::Not : OpCode::Negate, 0, &expr, 0);
+  } else if (type == typeid(BinaryOp)) {
+    const auto& binary = static_cast<const BinaryOp&>(expr);
+    if (binary.getOp() == BinaryOp::Op::LogicalAnd || binary.getOp() == BinaryOp::Op::LogicalOr) {
+      // The right operand is only evaluated if the left one doesn't decide the result
+      const bool isAnd = binary.getOp() == BinaryOp::Op::LogicalAnd;
+      compileExpression(*binary.getLeft());
+      const size_t shortcut = emit(isAnd ? OpCode::JumpIfFalse : OpCode::JumpIfTrue, 0, &expr, -1);
+      compileExpression(*binary.getRight());
+      emit(OpCode::ToBool, 0, &expr, 0);
+      const size_t done = emit(OpCode::Jump, 0, &expr, -1);
+      this->code[shortcut].arg = this->code.size();
+      this->constants.emplace_back(!isAnd);
+      emit(OpCode::Constant, this->constants.size() - 1, &expr, 1);
+      this->code[done].arg = this->code.size();
+    } else {
+      compileExpression(*binary.getLeft());
+      compileExpression(*binary.getRight());
+      emit(OpCode::Binary, 0, &expr, -1, binary.getOp());
+    }
+  } else if (type == typeid(TernaryOp)) {
+    const auto& ternary = static_cast<const TernaryOp&>(expr);
+    compileExpression(*ternary.getCond());
+    const size_t otherwise = emit(OpCode::JumpIfFalse, 0, &expr, -1);
+    compileExpression(*ternary.getIfExpr());
+    const size_t done = emit(OpCode::Jump, 0, &expr, -1);
+    this->code[otherwise].arg = this->code.size();
+    compileExpression(*ternary.getElseExpr());
+    this->code[done].arg = this->code.size();
+  } else if (type == typeid(ArrayLookup)) {
+    const auto& lookup = static_cast<const ArrayLookup&>(expr);
+    compileExpression(*lookup.getArray());
+    compileExpression(*lookup.getIndex());
+    emit(OpCode::Index, 0, &expr, -1);
+  } else if (type == typeid(Vector) && !hasListComprehension(static_cast<const Vector&>(expr))) {
+    const auto& children = static_cast<const Vector&>(expr).getChildren();
+    for (const auto& child : children) compileExpression(*child);
+    emit(OpCode::MakeVector, children.size(), &expr, 1 - static_cast<int>(children.size()));
+  } else {
+    this->expressions.push_back(&expr);
+    emit(OpCode::Evaluate, this->expressions.size() - 1, &expr, 1);
+  }
+}
+
+static Value applyBinaryOp(BinaryOp::Op op, const Value& left, const Value& right)
+{
+  switch (op) {
+  case BinaryOp::Op::Exponent:     return left ^ right;
+  case BinaryOp::Op::Multiply:     return left * right;
+  case BinaryOp::Op::Divide:       return left / right;
+  case BinaryOp::Op::Modulo:       return left % right;
+  case BinaryOp::Op::Plus:         return left + right;
+  case BinaryOp::Op::Minus:        return left - right;
+  case BinaryOp::Op::Less:         return left < right;
+  case BinaryOp::Op::LessEqual:    return left <= right;
+  case BinaryOp::Op::Greater:      return left > right;
+  case BinaryOp::Op::GreaterEqual: return left >= right;
+  case BinaryOp::Op::Equal:        return left == right;
+  case BinaryOp::Op::NotEqual:     return left != right;
+  default:
+    assert(false && "Logical operators are compiled to jumps");
+    throw EvaluationException("Non-existent binary operator!");
+  }
+}
+
+Value Bytecode::execute(const std::shared_ptr<const Context>& context) const
+{
+  std::vector<Value> stack;
+  stack.reserve(this->max_stack_depth);
+  size_t pc = 0;
+  while (pc < this->code.size()) {
+    const Instruction& instruction = this->code[pc++];
+    switch (instruction.opcode) {
+    case OpCode::Constant:
+      stack.push_back(this->constants[instruction.arg].clone());
+      break;
+    case OpCode::Load: {
+      const Lookup *lookup = this->lookups[instruction.arg];
+      stack.push_back(context->lookup_variable(lookup->get_identifier(), lookup->location()).clone());
+      break;
+    }
+    case OpCode::Evaluate:
+      stack.push_back(this->expressions[instruction.arg]->evaluate(context));
+      break;
+    case OpCode::Not:
+      stack.back() = !stack.back().toBool();
+      break;
+    case OpCode::Negate:
+      stack.back() = instruction.source->checkUndef(-stack.back(), context);
+      break;
+    case OpCode::Binary: {
+      Value right = std::move(stack.back());
+      stack.pop_back();
+      stack.back() = instruction.source->checkUndef(applyBinaryOp(instruction.op, stack.back(), right), context);
+      break;
+    }
+    case OpCode::Index: {
+      Value index = std::move(stack.back());
+      stack.pop_back();
+      stack.back() = stack.back()[index];
+      break;
+    }
+    case OpCode::MakeVector: {
+      const size_t first = stack.size() - instruction.arg;
+      if (instruction.arg == 1 && stack.back().type() == Value::Type::EMBEDDED_VECTOR) {
+        // Same as Vector::evaluate(), a single embedded vector becomes a plain vector
+        stack.back() = VectorType(std::move(stack.back().toEmbeddedVectorNonConst()));
+        break;
+      }
+      VectorType vec(context->session());
+      vec.reserve(instruction.arg);
+      for (size_t i = first; i < stack.size(); ++i) vec.emplace_back(std::move(stack[i]));
+      stack.erase(stack.begin() + first, stack.end());
+      stack.emplace_back(std::move(vec));
+      break;
+    }
+    case OpCode::ToBool:
+      stack.back() = stack.back().toBool();
+      break;
+    case OpCode::Jump:
+      pc = instruction.arg;
+      break;
+    case OpCode::JumpIfFalse:
+    case OpCode::JumpIfTrue: {
+      const bool condition = stack.back().toBool();
+      stack.pop_back();
+      if (condition == (instruction.opcode == OpCode::JumpIfTrue)) pc = instruction.arg;
+      break;
+    }
+    }
+  }
+  assert(stack.size() == 1);
+  return std::move(stack.back());
+}
+
+const std::shared_ptr<const Bytecode>& BytecodeCache::get(const Expression& expr) const
+{
+  static const std::shared_ptr<const Bytecode> none;
+  if (!Feature::ExperimentalBytecode.is_enabled()) return none;
+  if (!this->compiled) {
+    this->bytecode = Bytecode::compile(expr);
+    this->compiled = true;
+  }
+  return this->bytecode;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Expression.h"
+
+/*!
+   Compiled form of a function body.
+
+   compile() lowers an expression tree to a flat list of stack machine
+   instructions, which execute() runs in a single dispatch loop instead of a
+   virtual evaluate() call and a temporary Value per node. Subexpressions the
+   compiler doesn't handle (function calls, let, list comprehensions, ...) are
+   embedded as instructions evaluating them with the tree walker.
+
+   Enabled by the bytecode feature.
+ */
+class Bytecode
+{
+public:
+  static std::shared_ptr<const Bytecode> compile(const Expression& expr);
+  [[nodiscard]] Value execute(const std::shared_ptr<const Context>& context) const;
+
+private:
+  enum class OpCode : uint8_t {
+    Constant,    // Push constants[arg]
+    Load,        // Push the value of variable lookups[arg]
+    Evaluate,    // Push the value of expressions[arg], using the tree walker
+    Not,
+    Negate,
+    Binary,      // Pop right and left, push left op right
+    Index,       // Pop index and array, push array[index]
+    MakeVector,  // Pop arg values, push them as a vector
+    ToBool,
+    Jump,        // Continue at arg
+    JumpIfFalse, // Pop the condition, continue at arg if it is false
+    JumpIfTrue   // Pop the condition, continue at arg if it is true
+  };
+
+  struct Instruction {
+    OpCode opcode;
+    BinaryOp::Op op;
+    uint32_t arg;
+    const Expression *source; // For warnings about undefined results
+  };
+
+  void compileExpression(const Expression& expr);
+  size_t emit(OpCode opcode, uint32_t arg, const Expression *source, int stack_effect, BinaryOp::Op op = BinaryOp::Op::Plus);
+
+  std::vector<Instruction> code;
+  std::vector<Value> constants;
+  std::vector<const Lookup *> lookups;
+  std::vector<const Expression *> expressions;
+  size_t stack_depth{0};
+  size_t max_stack_depth{0};
+};
@@ -8,12 +8,19 @@
 #include "RenderNode.h"
 #include "CgalAdvNode.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 #include "GeometryEvaluator.h"
 #include "PolySet.h"
+#include "IndexedMesh.h"
+#include "MeshDecimation.h"
+#include "GeometryCache.h"
+#include "Feature.h"
+#include "parallel.h"
 
 #include <string>
 #include <map>
 #include <list>
+#include <unordered_set>
 #include <cassert>
 #include <cstddef>
 
@@ -26,7 +33,11 @@
 
 shared_ptr<CSGNode> CSGTreeEvaluator::buildCSGTree(const AbstractNode& node)
 {
+  TimingCounters::Scope timer(TimingCounters::CSG_TREE);
+  if (this->geomevaluator) evaluateLeavesInParallel(node);
   this->traverse(node);
+  this->leafgeometries.clear();
+  this->plainsubtrees.clear();
 
   shared_ptr<CSGNode> t(this->stored_term[node.index()]);
   if (t) {
@@ -40,6 +51,85 @@ shared_ptr<CSGNode> CSGTreeEvaluator::buildCSGTree(const AbstractNode& node)
   return this->rootNode = t;
 }
 
+#ifdef ENABLE_TBB
+// The leaves the traversal will evaluate, skipping the subtrees it prunes
+static void collectLeaves(const AbstractNode& node, std::unordered_set<int>& seen, std::vector<const AbstractNode *>& leaves)
+{
+  if (const auto *transform = dynamic_cast<const TransformNode *>(&node)) {
+    if (matrix_contains_infinity(transform->matrix) || matrix_contains_nan(transform->matrix)) return;
+  }
+  if (dynamic_cast<const LeafNode *>(&node)) {
+    if (GeometryEvaluator::isThreadSafeLeaf(node) && seen.insert(node.index()).second) leaves.push_back(&node);
+    return;
+  }
+  for (const auto& child : node.getChildren()) collectLeaves(*child, seen, leaves);
+}
+#endif
+
+/*!
+   Primitives, imports and surfaces don't depend on other geometry, so they
+   are created concurrently, each on its own GeometryEvaluator, before the
+   tree is traversed.
+ */
+void CSGTreeEvaluator::evaluateLeavesInParallel(const AbstractNode& node)
+{
+#ifdef ENABLE_TBB
+  if (!Feature::ExperimentalParallelEval.is_enabled()) return;
+  std::unordered_set<int> seen;
+  std::vector<const AbstractNode *> leaves;
+  collectLeaves(node, seen, leaves);
+  if (leaves.size() < 2) return;
+
+  std::vector<shared_ptr<const Geometry>> geometries(leaves.size());
+  const auto precision = this->geomevaluator->getPrecision();
+  parallelizable_transform(leaves.begin(), leaves.end(), geometries.begin(), [this, precision](const AbstractNode *leaf) {
+    GeometryEvaluator evaluator(this->tree, precision);
+    return evaluator.evaluateGeometry(*leaf, false);
+  });
+  for (size_t i = 0; i < leaves.size(); ++i) {
+    this->leafgeometries.emplace(leaves[i]->index(), std::move(geometries[i]));
+  }
+#endif
+}
+
+shared_ptr<const Geometry> CSGTreeEvaluator::evaluateGeometry(const AbstractNode& node)
+{
+  auto it = this->leafgeometries.find(node.index());
+  if (it != this->leafgeometries.end()) return it->second;
+  return this->geomevaluator->evaluateGeometry(node, false);
+}
+
+// Subtrees without highlight, background or color look like their rendered result
+bool CSGTreeEvaluator::isPlainSubtree(const AbstractNode& node)
+{
+  auto it = this->plainsubtrees.find(node.index());
+  if (it != this->plainsubtrees.end()) return it->second;
+  bool plain = !dynamic_cast<const ColorNode *>(&node);
+  for (const auto& child : node.getChildren()) {
+    plain = plain && !child->modinst->isHighlight() && !child->modinst->isBackground() && isPlainSubtree(*child);
+  }
+  this->plainsubtrees.emplace(node.index(), plain);
+  return plain;
+}
+
+/*!
+   If the node's final result is already cached, e.g. after a render, the
+   subtree becomes a single leaf instead of expanding its CSG operations.
+   Called in prefix, so the subtree can be pruned. Postfix then only adds
+   the node to its parent.
+ */
+bool CSGTreeEvaluator::useCachedResult(State& state, const AbstractNode& node)
+{
+  if (!this->geomevaluator || node.getChildren().empty()) return false;
+  if (!isPlainSubtree(node) || !this->geomevaluator->hasCachedResult(node)) return false;
+
+  auto geom = this->geomevaluator->evaluateGeometry(node, false);
+  this->stored_term[node.index()] = geom ? evaluateCSGNodeFromGeometry(state, geom, node.modinst, node) : CSGNode::createEmptySet();
+  node.progress_report();
+  this->substituted.insert(node.index());
+  return true;
+}
+
 void CSGTreeEvaluator::applyBackgroundAndHighlight(State& /*state*/, const AbstractNode& node)
 {
   for (const auto& chnode : this->visitedchildren[node.index()]) {
@@ -132,8 +222,9 @@ void CSGTreeEvaluator::applyToChildren(State& state, const AbstractNode& node, O
 
 Response CSGTreeEvaluator::visit(State& state, const AbstractNode& node)
 {
+  if (state.isPrefix() && useCachedResult(state, node)) return Response::PruneTraversal;
   if (state.isPostfix()) {
-    applyToChildren(state, node, OpenSCADOperator::UNION);
+    if (!this->substituted.erase(node.index())) applyToChildren(state, node, OpenSCADOperator::UNION);
     addToParent(state, node);
   }
   return Response::ContinueTraversal;
@@ -141,8 +232,9 @@ Response CSGTreeEvaluator::visit(State& state, const AbstractNode& node)
 
 Response CSGTreeEvaluator::visit(State& state, const AbstractIntersectionNode& node)
 {
+  if (state.isPrefix() && useCachedResult(state, node)) return Response::PruneTraversal;
   if (state.isPostfix()) {
-    applyToChildren(state, node, OpenSCADOperator::INTERSECTION);
+    if (!this->substituted.erase(node.index())) applyToChildren(state, node, OpenSCADOperator::INTERSECTION);
     addToParent(state, node);
   }
   return Response::ContinueTraversal;
@@ -168,6 +260,27 @@ Response CSGTreeEvaluator::visit(State& state, const class ListNode& node)
 
 }
 
+// Meshes with more faces are decimated to about as many in previews
+static constexpr size_t previewLODFaces = 100000;
+
+/*!
+   Returns the 3D mesh decimated for previews if it's large, cached as long
+   as the mesh is alive.
+ */
+static shared_ptr<const Geometry> previewLOD(const shared_ptr<const Geometry>& geom)
+{
+  const auto ps = dynamic_pointer_cast<const PolySet>(geom);
+  if (!ps || ps->getDimension() != 3 || ps->numFacets() <= previewLODFaces) return geom;
+  auto cache = GeometryCache::instance();
+  if (auto lod = cache->getConversion(geom, GeometryCache::Conversion::PreviewLOD)) return lod;
+  DecimationOptions options;
+  options.targetFaces = previewLODFaces;
+  auto lod = MeshDecimation::decimate(*ps->getIndexedMesh(), options);
+  lod->setConvexity(ps->getConvexity());
+  cache->insertConversion(geom, GeometryCache::Conversion::PreviewLOD, lod);
+  return lod;
+}
+
 shared_ptr<CSGNode> CSGTreeEvaluator::evaluateCSGNodeFromGeometry(
   State& state, const shared_ptr<const Geometry>& geom,
   const ModuleInstantiation *modinst, const AbstractNode& node)
@@ -182,6 +295,8 @@ shared_ptr<CSGNode> CSGTreeEvaluator::evaluateCSGNodeFromGeometry(
     // 3D PolySets are tessellated before inserting into Geometry cache, inside GeometryEvaluator::evaluateGeometry
   }
 
+  if (Feature::ExperimentalPreviewDecimation.is_enabled()) g = previewLOD(g);
+
   shared_ptr<CSGNode> t(new CSGLeaf(g, state.matrix(), state.color(), STR(node.name(), node.index()), node.index()));
   if (modinst->isHighlight() || state.isHighlight()) t->setHighlight(true);
   if (modinst->isBackground() || state.isBackground()) t->setBackground(true);
@@ -193,7 +308,7 @@ Response CSGTreeEvaluator::visit(State& state, const AbstractPolyNode& node)
   if (state.isPostfix()) {
     shared_ptr<CSGNode> t1;
     if (this->geomevaluator) {
-      auto geom = this->geomevaluator->evaluateGeometry(node, false);
+      auto geom = evaluateGeometry(node);
       if (geom) {
         t1 = evaluateCSGNodeFromGeometry(state, geom, node.modinst, node);
       } else {
@@ -209,8 +324,9 @@ Response CSGTreeEvaluator::visit(State& state, const AbstractPolyNode& node)
 
 Response CSGTreeEvaluator::visit(State& state, const CsgOpNode& node)
 {
+  if (state.isPrefix() && useCachedResult(state, node)) return Response::PruneTraversal;
   if (state.isPostfix()) {
-    applyToChildren(state, node, node.type);
+    if (!this->substituted.erase(node.index())) applyToChildren(state, node, node.type);
     addToParent(state, node);
   }
   return Response::ContinueTraversal;
@@ -223,10 +339,12 @@ Response CSGTreeEvaluator::visit(State& state, const TransformNode& node)
       LOG(message_group::Warning, "Transformation matrix contains Not-a-Number and/or Infinity - removing object.");
       return Response::PruneTraversal;
     }
+    // The cached result already includes our own transformation
+    if (useCachedResult(state, node)) return Response::PruneTraversal;
     state.setMatrix(state.matrix() * node.matrix);
   }
   if (state.isPostfix()) {
-    applyToChildren(state, node, OpenSCADOperator::UNION);
+    if (!this->substituted.erase(node.index())) applyToChildren(state, node, OpenSCADOperator::UNION);
     addToParent(state, node);
   }
   return Response::ContinueTraversal;
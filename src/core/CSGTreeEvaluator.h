@@ -2,6 +2,8 @@
 
 #include <map>
 #include <list>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <cstddef>
 #include "NodeVisitor.h"
@@ -49,9 +51,19 @@ private:
                                                   const ModuleInstantiation *modinst,
                                                   const AbstractNode& node);
   void applyBackgroundAndHighlight(State& state, const AbstractNode& node);
+  void evaluateLeavesInParallel(const AbstractNode& node);
+  shared_ptr<const Geometry> evaluateGeometry(const AbstractNode& node);
+  bool isPlainSubtree(const AbstractNode& node);
+  bool useCachedResult(State& state, const AbstractNode& node);
 
   using ChildList = std::list<std::shared_ptr<const AbstractNode>>;
   std::map<int, ChildList> visitedchildren;
+  // Leaf geometries created before the traversal, by node index
+  std::unordered_map<int, shared_ptr<const Geometry>> leafgeometries;
+  // Subtrees without modifiers and colors, by node index
+  std::unordered_map<int, bool> plainsubtrees;
+  // Nodes replaced by their cached result in prefix
+  std::unordered_set<int> substituted;
 
 protected:
   const Tree& tree;
@@ -25,16 +25,85 @@
  */
 
 #include "Children.h"
+#include "EvaluationSession.h"
+#include "Feature.h"
+#include "FunctionCache.h"
+#include "InstantiationCache.h"
 #include "ScopeContext.h"
+#include "UserModule.h"
+#include "node.h"
+#include "printutils.h"
+
+#include <algorithm>
+
+namespace {
+
+// Calls seeing other $-variables each time only fill the list
+constexpr size_t maxSharedInstantiations = 8;
+
+} // namespace
 
 std::shared_ptr<AbstractNode> Children::instantiate(const std::shared_ptr<AbstractNode> &target) const
 {
-  return children_scope->instantiateModules(*scopeContext(), target);
+  return instantiateShared(target, nullptr);
 }
 
 std::shared_ptr<AbstractNode> Children::instantiate(const std::shared_ptr<AbstractNode> &target, const std::vector<size_t>& indices) const
 {
-  return children_scope->instantiateModules(*scopeContext(), target, indices);
+  return instantiateShared(target, &indices);
+}
+
+std::shared_ptr<AbstractNode> Children::instantiateShared(const std::shared_ptr<AbstractNode>& target, const std::vector<size_t> *indices) const
+{
+  const auto instantiate = [&]() {
+    return indices ? children_scope->instantiateModules(*scopeContext(), target, *indices) :
+           children_scope->instantiateModules(*scopeContext(), target);
+  };
+  if (!Feature::ExperimentalModuleCache.is_enabled()) return instantiate();
+
+  EvaluationSession *session = context->session();
+  std::vector<std::string> modules;
+  modules.reserve(StaticModuleNameStack::size());
+  for (int i = 0; i < StaticModuleNameStack::size(); ++i) modules.push_back(StaticModuleNameStack::at(i));
+
+  if (!this->shared) this->shared = std::make_shared<std::vector<SharedInstantiation>>();
+  for (const auto& entry : *this->shared) {
+    if (entry.all != !indices || (indices && entry.indices != *indices) || entry.modules != modules) continue;
+    const bool unchanged = std::all_of(entry.specials.begin(), entry.specials.end(), [session](const auto& special) {
+      auto value = session->try_lookup_special_variable(special.first);
+      return value && FunctionCache::identical(*value, special.second);
+    });
+    if (!unchanged) continue;
+    if (auto recorder = session->dependencyRecorder()) {
+      for (const auto& lookup : entry.lookups) recorder->lookup(lookup.first, lookup.second.first, lookup.second.second);
+    }
+    target->children.insert(target->children.end(), entry.nodes.begin(), entry.nodes.end());
+    return target;
+  }
+
+  // Lookups from frames existing before the call decide if its nodes can be reused
+  DependencyRecorder recorder;
+  recorder.frames.insert(session->frames().begin(), session->frames().end());
+  const size_t messages = print_message_count;
+  const size_t first = target->children.size();
+  std::shared_ptr<AbstractNode> result;
+  {
+    RecordingScope recording(session, &recorder);
+    result = instantiate();
+  }
+  if (recorder.external_input || print_message_count != messages || this->shared->size() >= maxSharedInstantiations) {
+    return result;
+  }
+
+  SharedInstantiation entry{!indices, indices ? *indices : std::vector<size_t>(), std::move(modules), {}, {},
+                            {target->children.begin() + first, target->children.end()}};
+  for (size_t i = 0; i < recorder.lookups.size(); ++i) {
+    auto& lookup = recorder.lookups[i];
+    if (!lookup.first.empty() && lookup.first[0] == '$') entry.specials.push_back(std::move(lookup));
+    else entry.lookups.emplace_back(recorder.sources[i], std::move(lookup));
+  }
+  this->shared->push_back(std::move(entry));
+  return result;
 }
 
 ContextHandle<ScopeContext> Children::scopeContext() const
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "Context.h"
 #include "LocalScope.h"
 
 class AbstractNode;
+class ContextFrame;
 class ScopeContext;
 
 class Children
@@ -33,8 +37,26 @@ public:
   [[nodiscard]] const std::shared_ptr<const Context>& getContext() const { return context; }
 
 private:
+  /*!
+     With the module-cache feature, calls of children() that instantiate the
+     same children while seeing the same $-variables and calling modules, e.g.
+     from the iterations of a pattern module's loop, share their nodes.
+   */
+  struct SharedInstantiation {
+    bool all;
+    std::vector<size_t> indices;
+    std::vector<std::string> modules;
+    std::vector<std::pair<std::string, Value>> specials;
+    // Other lookups from outside, reported to enclosing recorders on reuse
+    std::vector<std::pair<const ContextFrame *, std::pair<std::string, Value>>> lookups;
+    std::vector<std::shared_ptr<AbstractNode>> nodes;
+  };
+
   const LocalScope *children_scope;
   std::shared_ptr<const Context> context;
+  // Shared by copies, which instantiate the same children in the same context
+  mutable std::shared_ptr<std::vector<SharedInstantiation>> shared;
 
   [[nodiscard]] ContextHandle<ScopeContext> scopeContext() const;
+  std::shared_ptr<AbstractNode> instantiateShared(const std::shared_ptr<AbstractNode>& target, const std::vector<size_t> *indices) const;
 };
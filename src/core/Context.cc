@@ -26,6 +26,7 @@
 
 #include "Context.h"
 #include "function.h"
+#include "InstantiationCache.h"
 #include "printutils.h"
 
 Context::Context(EvaluationSession *session) :
@@ -71,6 +72,7 @@ boost::optional<const Value&> Context::try_lookup_variable(const std::string& na
   for (const Context *context = this; context != nullptr; context = context->getParent().get()) {
     boost::optional<const Value&> result = context->lookup_local_variable(name);
     if (result) {
+      if (auto recorder = session()->dependencyRecorder()) recorder->lookup(context, name, *result);
       return result;
     }
   }
@@ -87,24 +89,53 @@ const Value& Context::lookup_variable(const std::string& name, const Location& l
   return *result;
 }
 
-boost::optional<CallableFunction> Context::lookup_function(const std::string& name, const Location& loc) const
+boost::optional<const Value&> Context::try_lookup_variable(const Identifier& name) const
 {
-  if (is_config_variable(name)) {
+  if (name.isConfigVariable()) {
+    return session()->try_lookup_special_variable(name);
+  }
+  for (const Context *context = this; context != nullptr; context = context->getParent().get()) {
+    boost::optional<const Value&> result = context->lookup_local_variable(name);
+    if (result) {
+      if (auto recorder = session()->dependencyRecorder()) recorder->lookup(context, name.getName(), *result);
+      return result;
+    }
+  }
+  return boost::none;
+}
+
+const Value& Context::lookup_variable(const Identifier& name, const Location& loc) const
+{
+  boost::optional<const Value&> result = try_lookup_variable(name);
+  if (!result) {
+    LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown variable '%1$s'", name.getName());
+    return Value::undefined;
+  }
+  return *result;
+}
+
+boost::optional<CallableFunction> Context::lookup_function(const Identifier& name, const Location& loc) const
+{
+  if (name.isConfigVariable()) {
     return session()->lookup_special_function(name, loc);
   }
   for (const Context *context = this; context != nullptr; context = context->getParent().get()) {
     boost::optional<CallableFunction> result = context->lookup_local_function(name, loc);
     if (result) {
+      if (auto recorder = session()->dependencyRecorder()) {
+        // Function literals assigned to variables, functions defined in the scope are part of the AST
+        if (auto value = context->lookup_local_variable(name)) recorder->lookup(context, name.getName(), *value);
+      }
       return result;
     }
   }
-  LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown function '%1$s'", name);
+  LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown function '%1$s'", name.getName());
   return boost::none;
 }
 
-boost::optional<InstantiableModule> Context::lookup_module(const std::string& name, const Location& loc) const
+boost::optional<InstantiableModule> Context::lookup_module(const Identifier& name, const Location& loc) const
 {
-  if (is_config_variable(name)) {
+  if (name.isConfigVariable()) {
     return session()->lookup_special_module(name, loc);
   }
   for (const Context *context = this; context != nullptr; context = context->getParent().get()) {
@@ -113,11 +144,11 @@ boost::optional<InstantiableModule> Context::lookup_module(const std::string& na
       return result;
     }
   }
-  LOG(message_group::Warning, loc, this->documentRoot(), "Ignoring unknown module '%1$s'", name);
+  LOG(message_group::Warning, loc, this->documentRoot(), "Ignoring unknown module '%1$s'", name.getName());
   return boost::none;
 }
 
-bool Context::set_variable(const std::string& name, Value&& value)
+bool Context::set_variable(const Identifier& name, Value&& value)
 {
   bool new_variable = ContextFrame::set_variable(name, std::move(value));
   if (new_variable) {
@@ -133,6 +164,14 @@ size_t Context::clear()
   return removed;
 }
 
+size_t Context::clear_lexical_variables()
+{
+  size_t removed = lexical_variables.size();
+  lexical_variables.clear();
+  session()->accounting().removeContextVariable(removed);
+  return removed;
+}
+
 #ifdef DEBUG
 std::string Context::dump() const
 {
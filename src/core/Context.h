@@ -51,6 +51,7 @@ public:
     return *this;
   }
 
+  long use_count() const { return context.use_count(); }
   const T *operator->() const { return context.get(); }
   T *operator->() { return context.get(); }
   std::shared_ptr<const T> operator*() const { return context; }
@@ -65,12 +66,26 @@ protected:
   Context(EvaluationSession *session);
   Context(const std::shared_ptr<const Context>& parent);
 
+private:
+  static EvaluationSession *sessionOf(EvaluationSession *session) { return session; }
+  static EvaluationSession *sessionOf(const std::shared_ptr<const Context>& parent) { return parent->session(); }
+
 public:
   ~Context() override;
 
-  template <typename C, typename ... T>
-  static ContextHandle<C> create(T&& ... t) {
-    return ContextHandle<C>{std::shared_ptr<C>(new C(std::forward<T>(t)...))};
+  // Contexts are allocated from the pool of the session given by the first argument
+  template <typename C, typename S, typename ... T>
+  static ContextHandle<C> create(S&& first, T&& ... t) {
+    ContextPool& pool = sessionOf(first)->contextMemoryManager().pool();
+    void *storage = pool.allocate(sizeof(C));
+    C *context;
+    try {
+      context = new (storage) C(std::forward<S>(first), std::forward<T>(t)...);
+    } catch (...) {
+      pool.deallocate(storage, sizeof(C));
+      throw;
+    }
+    return ContextHandle<C>{std::shared_ptr<C>(context, ContextPool::Deleter{&pool}, ContextPool::Allocator<C>(&pool))};
   }
 
   virtual void init() { }
@@ -81,10 +96,15 @@ public:
 
   boost::optional<const Value&> try_lookup_variable(const std::string& name) const;
   const Value& lookup_variable(const std::string& name, const Location& loc) const;
-  boost::optional<CallableFunction> lookup_function(const std::string& name, const Location& loc) const;
-  boost::optional<InstantiableModule> lookup_module(const std::string& name, const Location& loc) const;
-  bool set_variable(const std::string& name, Value&& value) override;
+  boost::optional<const Value&> try_lookup_variable(const Identifier& name) const;
+  const Value& lookup_variable(const Identifier& name, const Location& loc) const;
+  boost::optional<CallableFunction> lookup_function(const Identifier& name, const Location& loc) const;
+  boost::optional<InstantiableModule> lookup_module(const Identifier& name, const Location& loc) const;
+  using ContextFrame::set_variable;
+  bool set_variable(const Identifier& name, Value&& value) override;
   size_t clear() override;
+  // Keeps the $-variables, e.g. to bind new parameters for a self tail call
+  size_t clear_lexical_variables();
 
   const std::shared_ptr<const Context>& getParent() const { return this->parent; }
   // This modifies the semantics of the context in an error-prone way. Use with caution.
@@ -32,21 +32,22 @@ ContextFrame::ContextFrame(EvaluationSession *session) :
 
 boost::optional<const Value&> ContextFrame::lookup_local_variable(const std::string& name) const
 {
-  if (is_config_variable(name)) {
-    auto result = config_variables.find(name);
-    if (result != config_variables.end()) {
-      return result->second;
-    }
-  } else {
-    auto result = lexical_variables.find(name);
-    if (result != lexical_variables.end()) {
-      return result->second;
-    }
+  const auto identifier = Identifier::find(name);
+  if (!identifier) return boost::none;
+  return lookup_local_variable(*identifier);
+}
+
+boost::optional<const Value&> ContextFrame::lookup_local_variable(const Identifier& name) const
+{
+  const ValueMap& variables = name.isConfigVariable() ? config_variables : lexical_variables;
+  auto result = variables.find(name);
+  if (result != variables.end()) {
+    return result->second;
   }
   return boost::none;
 }
 
-boost::optional<CallableFunction> ContextFrame::lookup_local_function(const std::string& name, const Location& /*loc*/) const
+boost::optional<CallableFunction> ContextFrame::lookup_local_function(const Identifier& name, const Location& /*loc*/) const
 {
   boost::optional<const Value&> value = lookup_local_variable(name);
   if (value && value->type() == Value::Type::FUNCTION) {
@@ -55,7 +56,7 @@ boost::optional<CallableFunction> ContextFrame::lookup_local_function(const std:
   return boost::none;
 }
 
-boost::optional<InstantiableModule> ContextFrame::lookup_local_module(const std::string& /*name*/, const Location& /*loc*/) const
+boost::optional<InstantiableModule> ContextFrame::lookup_local_module(const Identifier& /*name*/, const Location& /*loc*/) const
 {
   return boost::none;
 }
@@ -80,9 +81,9 @@ size_t ContextFrame::clear()
   return removed;
 }
 
-bool ContextFrame::set_variable(const std::string& name, Value&& value)
+bool ContextFrame::set_variable(const Identifier& name, Value&& value)
 {
-  if (is_config_variable(name)) {
+  if (name.isConfigVariable()) {
     return config_variables.insert_or_assign(name, std::move(value)).second;
   } else {
     return lexical_variables.insert_or_assign(name, std::move(value)).second;
@@ -132,7 +133,7 @@ void ContextFrame::apply_variables(ContextFrame&& other)
 
 bool ContextFrame::is_config_variable(const std::string& name)
 {
-  return name[0] == '$' && name != "$children";
+  return Identifier::is_config_variable(name);
 }
 
 #ifdef DEBUG
@@ -141,10 +142,10 @@ std::string ContextFrame::dumpFrame() const
   std::ostringstream s;
   s << boost::format("ContextFrame %p:\n") % this;
   for (const auto& v : lexical_variables) {
-    s << boost::format("    %s = %s\n") % v.first % v.second.toEchoString();
+    s << boost::format("    %s = %s\n") % v.first.getName() % v.second.toEchoString();
   }
   for (const auto& v : config_variables) {
-    s << boost::format("    %s = %s\n") % v.first % v.second.toEchoString();
+    s << boost::format("    %s = %s\n") % v.first.getName() % v.second.toEchoString();
   }
   return s.str();
 }
@@ -12,13 +12,15 @@ public:
   ContextFrame(ContextFrame&& other) = default;
 
   virtual boost::optional<const Value&> lookup_local_variable(const std::string& name) const;
-  virtual boost::optional<CallableFunction> lookup_local_function(const std::string& name, const Location& loc) const;
-  virtual boost::optional<InstantiableModule> lookup_local_module(const std::string& name, const Location& loc) const;
+  boost::optional<const Value&> lookup_local_variable(const Identifier& name) const;
+  virtual boost::optional<CallableFunction> lookup_local_function(const Identifier& name, const Location& loc) const;
+  virtual boost::optional<InstantiableModule> lookup_local_module(const Identifier& name, const Location& loc) const;
 
   virtual std::vector<const Value *> list_embedded_values() const;
   virtual size_t clear();
 
-  virtual bool set_variable(const std::string& name, Value&& value);
+  virtual bool set_variable(const Identifier& name, Value&& value);
+  bool set_variable(const std::string& name, Value&& value) { return set_variable(Identifier(name), std::move(value)); }
 
   void apply_variables(const ValueMap& variables);
   void apply_lexical_variables(const ContextFrame& other);
@@ -34,6 +36,8 @@ public:
   void apply_variables(ContextFrame&& other);
 
   static bool is_config_variable(const std::string& name);
+  // Most frames set no $-variables, so special variable lookups skip them
+  bool has_config_variables() const { return config_variables.size() != 0; }
 
   EvaluationSession *session() const { return evaluation_session; }
   const std::string& documentRoot() const { return evaluation_session->documentRoot(); }
@@ -24,12 +24,14 @@
  *
  */
 
+#include <algorithm>
 #include <deque>
 #include <map>
 #include <unordered_set>
 
 #include "Context.h"
 #include "ContextMemoryManager.h"
+#include "printutils.h"
 #include "Value.h"
 
 /*
@@ -201,11 +203,14 @@ static std::vector<Context *> findRootContexts(const std::vector<std::shared_ptr
 
 
 /*
- * Finds all contexts reachable from a set of root contexts.
+ * Finds all contexts reachable from a set of root contexts. If collected is
+ * given, the search doesn't continue into contexts outside of it: contexts
+ * referenced from there are roots themselves.
  *
  * Implemented as a breadth first search to save on stack space.
  */
-static std::unordered_set<const Context *> findReachableContexts(const std::vector<Context *>& rootContexts)
+static std::unordered_set<const Context *> findReachableContexts(const std::vector<Context *>& rootContexts,
+                                                                 const std::unordered_set<const Context *> *collected)
 {
   std::unordered_set<ValueIdentifier> valuesSeen;
   std::unordered_set<const Context *> contextsSeen;
@@ -224,6 +229,9 @@ static std::unordered_set<const Context *> findReachableContexts(const std::vect
       }
     };
   auto visitContext = [&](const Context *context) {
+      if (collected && !collected->count(context)) {
+        return;
+      }
       if (!contextsSeen.count(context)) {
         contextsSeen.insert(context);
         contextQueue.push_back(context);
@@ -271,9 +279,12 @@ static std::unordered_set<const Context *> findReachableContexts(const std::vect
 
 
 /*
- * Clean up all unreachable contexts.
+ * Clean up all unreachable contexts among managedContexts, which is left
+ * holding the survivors. References from contexts that are not part of
+ * managedContexts keep their targets alive. Returns the number of contexts
+ * removed.
  */
-static void collectGarbage(std::vector<std::weak_ptr<Context>>& managedContexts)
+static size_t collectGarbage(std::vector<std::weak_ptr<Context>>& managedContexts, bool minor)
 {
   /*
    * Garbage collection consists of three phases.
@@ -306,18 +317,26 @@ static void collectGarbage(std::vector<std::weak_ptr<Context>>& managedContexts)
 
   std::vector<Context *> rootContexts = findRootContexts(allContexts);
 
-  std::unordered_set<const Context *> reachableContexts = findReachableContexts(rootContexts);
+  std::unordered_set<const Context *> collectedContexts;
+  if (minor) {
+    for (const std::shared_ptr<Context>& context : allContexts) {
+      collectedContexts.insert(context.get());
+    }
+  }
+  std::unordered_set<const Context *> reachableContexts = findReachableContexts(rootContexts, minor ? &collectedContexts : nullptr);
 
 #ifdef DEBUG
   std::vector<std::weak_ptr<Context>> removedContexts;
 #endif
 
+  size_t removed = 0;
   managedContexts.clear();
   for (std::shared_ptr<Context>& context : allContexts) {
     if (reachableContexts.count(context.get())) {
       managedContexts.emplace_back(context);
     } else {
       context->clear();
+      ++removed;
 #ifdef DEBUG
       removedContexts.emplace_back(context);
 #endif
@@ -343,15 +362,59 @@ static void collectGarbage(std::vector<std::weak_ptr<Context>>& managedContexts)
     assert(context.expired());
   }
 #endif
+  return removed;
 }
 
 
 
+GarbageCollectionStatistics ContextMemoryManager::gcStatistics;
+
+void GarbageCollectionStatistics::print() const
+{
+  LOG("Garbage collection: %1$d minor, %2$d major runs, %3$d contexts freed in %4$d ms",
+      minorCollections, majorCollections, collectedContexts,
+      std::chrono::duration_cast<std::chrono::milliseconds>(time).count());
+}
+
+ContextMemoryManager::ContextMemoryManager()
+{
+  gcStatistics = GarbageCollectionStatistics();
+}
+
 ContextMemoryManager::~ContextMemoryManager()
 {
-  collectGarbage(managedContexts);
-  assert(managedContexts.empty());
+  gcStatistics.peakHeapSize = std::max(gcStatistics.peakHeapSize, heapSizeAccounting.size());
+  oldContexts.insert(oldContexts.end(), youngContexts.begin(), youngContexts.end());
+  youngContexts.clear();
+  ::collectGarbage(oldContexts, false);
+  assert(oldContexts.empty());
   assert(heapSizeAccounting.size() == 0);
+  gcStatistics.allocations = heapSizeAccounting.allocations();
+}
+
+void ContextMemoryManager::collectGarbage()
+{
+  const auto start = std::chrono::steady_clock::now();
+  gcStatistics.peakHeapSize = std::max(gcStatistics.peakHeapSize, heapSizeAccounting.size());
+
+  gcStatistics.collectedContexts += ::collectGarbage(youngContexts, true);
+  gcStatistics.minorCollections++;
+  oldContexts.insert(oldContexts.end(), youngContexts.begin(), youngContexts.end());
+  youngContexts.clear();
+
+  /*
+   * What remains of the heap now is mostly old contexts. Scanning those is
+   * only worth it once they make up twice as much as after the last major
+   * collection, which keeps the total time spent in major collections
+   * proportional to the heap size accumulated during the session.
+   */
+  if (heapSizeAccounting.size() >= nextMajorCollectSize) {
+    gcStatistics.collectedContexts += ::collectGarbage(oldContexts, false);
+    gcStatistics.majorCollections++;
+    nextMajorCollectSize = heapSizeAccounting.size() * 2;
+  }
+
+  gcStatistics.time += std::chrono::steady_clock::now() - start;
 }
 
 void ContextMemoryManager::addContext(const std::shared_ptr<Context>& context)
@@ -365,20 +428,62 @@ void ContextMemoryManager::addContext(const std::shared_ptr<Context>& context)
    * right away.
    */
   if (context.use_count() > 1) {
-    managedContexts.emplace_back(context);
+    youngContexts.emplace_back(context);
 
     if (heapSizeAccounting.size() >= nextGarbageCollectSize) {
-      collectGarbage(managedContexts);
+      collectGarbage();
       /*
-       * The cost of a garbage collection run is proportional to the heap
-       * size. By scheduling the next run at twice the *remaining* heap size,
-       * the total processing time of garbage collection throughout an
-       * evaluation session is at most proportional to the total heap size
-       * accumulated during the session, while keeping the maximum memory
-       * used at any point at most twice the amount of necessary memory usage
-       * (i.e. waste is at most a factor 2 overhead).
+       * A minor collection run scans the young contexts, and the values
+       * reachable from them, which are at most the heap size. By scheduling
+       * the next run after the heap grows by a quarter of the *remaining*
+       * heap size, the total processing time of garbage collection
+       * throughout an evaluation session stays proportional to the total
+       * heap size accumulated during the session, while young garbage
+       * can't make up more than a fraction of the memory used.
        */
-      nextGarbageCollectSize = heapSizeAccounting.size() * 2;
+      nextGarbageCollectSize = heapSizeAccounting.size() + std::max(minimumYoungHeapSize, heapSizeAccounting.size() / 4);
     }
   }
 }
+
+ContextPool::~ContextPool()
+{
+  for (void *chunk : chunks) {
+    ::operator delete(chunk);
+  }
+}
+
+void *ContextPool::allocate(size_t size)
+{
+  if (size == 0 || size > max_block_size) {
+    return ::operator new(size);
+  }
+  const size_t index = (size - 1) / granularity;
+  if (FreeBlock *block = free_lists[index]) {
+    free_lists[index] = block->next;
+    return block;
+  }
+  const size_t block_size = (index + 1) * granularity;
+  if (chunk_left < block_size) {
+    // The remainder of the previous chunk is too small for this size and is left unused
+    chunk_pos = static_cast<char *>(::operator new(chunk_size));
+    chunks.push_back(chunk_pos);
+    chunk_left = chunk_size;
+  }
+  void *result = chunk_pos;
+  chunk_pos += block_size;
+  chunk_left -= block_size;
+  return result;
+}
+
+void ContextPool::deallocate(void *ptr, size_t size)
+{
+  if (size == 0 || size > max_block_size) {
+    ::operator delete(ptr);
+    return;
+  }
+  auto *block = static_cast<FreeBlock *>(ptr);
+  const size_t index = (size - 1) / granularity;
+  block->next = free_lists[index];
+  free_lists[index] = block;
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -17,31 +20,138 @@ class Context;
 class HeapSizeAccounting
 {
 public:
-  void addContext(size_t number = 1) { count += number; }
+  void addContext(size_t number = 1) { count += number; allocated += number; }
   void removeContext(size_t number = 1) { count -= number; }
-  void addContextVariable(size_t number = 1) { count += number; }
+  void addContextVariable(size_t number = 1) { count += number; allocated += number; }
   void removeContextVariable(size_t number = 1) { count -= number; }
-  void addVectorElement(size_t number = 1) { count += number; }
+  void addVectorElement(size_t number = 1) { count += number; allocated += number; }
   void removeVectorElement(size_t number = 1) { count -= number; }
 
   [[nodiscard]] size_t size() const { return count; }
+  // Total of the points added, which never decreases
+  [[nodiscard]] size_t allocations() const { return allocated; }
 
 private:
   size_t count = 0;
+  size_t allocated = 0;
 };
 
+/*
+ * Allocates the contexts of an EvaluationSession, and the shared_ptr control
+ * blocks referring to them. Small blocks are cut from large chunks and put on
+ * a free list per size when released, so the many short-lived contexts of
+ * module and function calls are recycled without going through malloc. The
+ * chunks are all freed at once when the session ends.
+ */
+class ContextPool
+{
+public:
+  ContextPool() = default;
+  ~ContextPool();
+  ContextPool(const ContextPool&) = delete;
+  ContextPool& operator=(const ContextPool&) = delete;
+
+  void *allocate(size_t size);
+  void deallocate(void *ptr, size_t size);
+
+  // Standard allocator, e.g. for the control block of a shared_ptr
+  template <typename T>
+  class Allocator
+  {
+  public:
+    using value_type = T;
+
+    Allocator(ContextPool *pool) : pool(pool) {}
+    template <typename U>
+    Allocator(const Allocator<U>& other) : pool(other.pool) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(pool->allocate(n * sizeof(T))); }
+    void deallocate(T *ptr, size_t n) { pool->deallocate(ptr, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const Allocator<U>& other) const { return pool == other.pool; }
+    template <typename U>
+    bool operator!=(const Allocator<U>& other) const { return pool != other.pool; }
+
+  private:
+    template <typename U> friend class Allocator;
+    ContextPool *pool;
+  };
+
+  // Destroys an object created in storage from allocate(sizeof(T))
+  struct Deleter {
+    ContextPool *pool;
+    template <typename T>
+    void operator()(T *ptr) const {
+      ptr->~T();
+      pool->deallocate(ptr, sizeof(T));
+    }
+  };
+
+private:
+  static constexpr size_t granularity = alignof(std::max_align_t);
+  static constexpr size_t max_block_size = 512;
+  static constexpr size_t chunk_size = 64 * 1024;
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+  std::array<FreeBlock *, max_block_size / granularity> free_lists{};
+  std::vector<void *> chunks;
+  char *chunk_pos = nullptr;
+  size_t chunk_left = 0;
+};
+
+/*
+ * Garbage collection runs of the most recent evaluation session. These are
+ * kept after the session ends, so they can be reported by --summary.
+ */
+struct GarbageCollectionStatistics
+{
+  size_t minorCollections = 0;
+  size_t majorCollections = 0;
+  size_t collectedContexts = 0;
+  std::chrono::steady_clock::duration time{};
+  // Heap size as counted by HeapSizeAccounting, sampled before each collection
+  size_t peakHeapSize = 0;
+  size_t allocations = 0;
+
+  void print() const;
+};
+
+/*
+ * Contexts are collected in two generations. Contexts added since the last
+ * collection are young. A minor collection only scans the young contexts,
+ * and treats any reference from an old context as a root. The survivors
+ * become old. Old contexts are only scanned by a major collection, which
+ * runs once the heap remaining after a minor collection has doubled.
+ */
 class ContextMemoryManager
 {
 public:
+  ContextMemoryManager();
   ~ContextMemoryManager();
 
   void addContext(const std::shared_ptr<Context>& context);
   void releaseContext() { heapSizeAccounting.removeContext(); }
 
   HeapSizeAccounting& accounting() { return heapSizeAccounting; }
+  ContextPool& pool() { return contextPool; }
+
+  static const GarbageCollectionStatistics& statistics() { return gcStatistics; }
 
 private:
-  std::vector<std::weak_ptr<Context>> managedContexts;
+  void collectGarbage();
+
+  static GarbageCollectionStatistics gcStatistics;
+  // Lower bound on the heap growth between two collections
+  static constexpr size_t minimumYoungHeapSize = 1024;
+
+  // Declared first, so it outlives the contexts released by the other members
+  ContextPool contextPool;
+  std::vector<std::weak_ptr<Context>> youngContexts;
+  std::vector<std::weak_ptr<Context>> oldContexts;
   HeapSizeAccounting heapSizeAccounting;
   size_t nextGarbageCollectSize = 0;
+  size_t nextMajorCollectSize = 0;
 };
@@ -0,0 +1,139 @@
+#include "EvalProfiler.h"
+#include "AST.h"
+#include "ContextMemoryManager.h"
+#include "printutils.h"
+#include "version.h"
+
+#include <chrono>
+#include <fstream>
+#include <json.hpp>
+
+EvalProfiler *EvalProfiler::inst = nullptr;
+
+namespace {
+
+// Innermost call being recorded on this thread
+thread_local EvalProfiler::Call *current_call = nullptr;
+
+}
+
+void EvalProfiler::clear()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->frames.clear();
+  this->frame_index.clear();
+  this->nodes.assign(1, Node{-1, -1});
+}
+
+int64_t EvalProfiler::now() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void EvalProfiler::enter(Call& call, const char *kind, const std::string& name, const Location& loc, HeapSizeAccounting& accounting)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    const std::string file = loc.isNone() ? "" : loc.fileName();
+    const std::string key = std::string(kind) + '\0' + name + '\0' + file + ':' +
+                            std::to_string(loc.firstLine()) + ':' + std::to_string(loc.firstColumn());
+    const auto frame = this->frame_index.emplace(key, this->frames.size());
+    if (frame.second) {
+      this->frames.push_back({std::string(kind) + " " + name, file, loc.firstLine(), loc.firstColumn()});
+    }
+    const int parent = current_call ? current_call->node : 0;
+    const auto child = this->nodes[parent].children.emplace(frame.first->second, this->nodes.size());
+    if (child.second) this->nodes.push_back(Node{frame.first->second, parent});
+    call.node = child.first->second;
+  }
+  call.accounting = &accounting;
+  call.caller = current_call;
+  current_call = &call;
+  call.start_allocations = accounting.allocations();
+  call.start = now();
+}
+
+void EvalProfiler::leave(Call& call)
+{
+  const int64_t time = now() - call.start;
+  const size_t allocations = call.accounting->allocations() - call.start_allocations;
+  current_call = call.caller;
+  if (call.caller) {
+    call.caller->nested_time += time;
+    call.caller->nested_allocations += allocations;
+  }
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto& node = this->nodes[call.node];
+  node.calls++;
+  node.total_time += time;
+  node.self_time += time - call.nested_time;
+  node.total_allocations += allocations;
+  node.self_allocations += allocations - call.nested_allocations;
+}
+
+/*!
+   Writes the call tree in the speedscope file format, as one sampled profile
+   per metric: each tree node is a sample of its stack, weighted by the time,
+   allocations or calls of the node itself.
+ */
+bool EvalProfiler::writeSpeedscope(const std::string& filename) const
+{
+  nlohmann::json json;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    nlohmann::json frames = nlohmann::json::array();
+    for (const auto& frame : this->frames) {
+      nlohmann::json frameJson{{"name", frame.name}};
+      if (!frame.file.empty()) {
+        frameJson["file"] = frame.file;
+        frameJson["line"] = frame.line;
+        frameJson["col"] = frame.column;
+      }
+      frames.push_back(frameJson);
+    }
+
+    nlohmann::json samples = nlohmann::json::array();
+    nlohmann::json time = nlohmann::json::array();
+    nlohmann::json allocations = nlohmann::json::array();
+    nlohmann::json calls = nlohmann::json::array();
+    int64_t total_time = 0;
+    size_t total_allocations = 0, total_calls = 0;
+    for (size_t i = 1; i < this->nodes.size(); ++i) {
+      const auto& node = this->nodes[i];
+      std::vector<int> stack;
+      for (int n = i; n > 0; n = this->nodes[n].parent) stack.push_back(this->nodes[n].frame);
+      samples.push_back(nlohmann::json(std::vector<int>(stack.rbegin(), stack.rend())));
+      time.push_back(node.self_time);
+      allocations.push_back(node.self_allocations);
+      calls.push_back(node.calls);
+      total_time += node.self_time;
+      total_allocations += node.self_allocations;
+      total_calls += node.calls;
+    }
+
+    auto profile = [&samples](const std::string& name, const std::string& unit, const nlohmann::json& weights, double total) {
+      return nlohmann::json{
+        {"type", "sampled"}, {"name", name}, {"unit", unit}, {"startValue", 0}, {"endValue", total},
+        {"samples", samples}, {"weights", weights},
+      };
+    };
+    json["$schema"] = "https://www.speedscope.app/file-format-schema.json";
+    json["shared"] = {{"frames", frames}};
+    json["profiles"] = {
+      profile("Evaluation time", "nanoseconds", time, total_time),
+      profile("Allocated values", "none", allocations, total_allocations),
+      profile("Calls", "none", calls, total_calls),
+    };
+    json["name"] = "OpenSCAD evaluation";
+    json["exporter"] = "OpenSCAD " + openscad_versionnumber;
+  }
+
+  std::ofstream stream(filename);
+  if (!stream.is_open()) {
+    LOG(message_group::Error, "Can't write evaluation profile '%1$s'", filename);
+    return false;
+  }
+  stream << json;
+  return stream.good();
+}
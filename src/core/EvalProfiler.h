@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class HeapSizeAccounting;
+class Location;
+
+/*!
+   Collects the time spent evaluating function calls and user module
+   instantiations.
+
+   Calls are recorded in a call tree keyed by the callee name and the source
+   location of the call, with the number of calls, the time including and
+   excluding nested calls, and the values allocated meanwhile (contexts,
+   variables and vector elements, as counted by HeapSizeAccounting). The tree
+   can be written as a speedscope profile (--profile-eval), which shows it as
+   a flame graph per metric on https://www.speedscope.app.
+ */
+class EvalProfiler
+{
+public:
+  static EvalProfiler *instance() { if (!inst) inst = new EvalProfiler; return inst; }
+
+  void setEnabled(bool on) { this->enabled = on; }
+  bool isEnabled() const { return this->enabled; }
+  void clear();
+
+  bool writeSpeedscope(const std::string& filename) const;
+
+  // Records one call for as long as it is in scope
+  class Call
+  {
+  public:
+    Call(const char *kind, const std::string& name, const Location& loc, HeapSizeAccounting& accounting) {
+      if (EvalProfiler::instance()->isEnabled()) EvalProfiler::instance()->enter(*this, kind, name, loc, accounting);
+    }
+    ~Call() { if (this->accounting) EvalProfiler::instance()->leave(*this); }
+    Call(const Call&) = delete;
+    Call& operator=(const Call&) = delete;
+
+  private:
+    friend class EvalProfiler;
+    HeapSizeAccounting *accounting{nullptr}; // Only set while profiling
+    Call *caller{nullptr};
+    int node{0};
+    int64_t start{0};
+    size_t start_allocations{0};
+    int64_t nested_time{0};
+    size_t nested_allocations{0};
+  };
+
+private:
+  static EvalProfiler *inst;
+
+  struct Frame {
+    std::string name;
+    std::string file;
+    int line;
+    int column;
+  };
+  struct Node {
+    int frame;  // -1 for the root
+    int parent;
+    size_t calls{0};
+    int64_t total_time{0}; // Nanoseconds
+    int64_t self_time{0};
+    size_t total_allocations{0};
+    size_t self_allocations{0};
+    std::map<int, int> children; // Node index by frame
+  };
+
+  EvalProfiler() : nodes{Node{-1, -1}} {}
+
+  void enter(Call& call, const char *kind, const std::string& name, const Location& loc, HeapSizeAccounting& accounting);
+  void leave(Call& call);
+  int64_t now() const;
+
+  bool enabled{false};
+  mutable std::mutex mutex;
+  std::vector<Frame> frames;
+  std::map<std::string, int> frame_index;
+  std::vector<Node> nodes;
+};
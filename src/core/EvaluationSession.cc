@@ -26,8 +26,27 @@
 
 #include "ContextFrame.h"
 #include "EvaluationSession.h"
+#include "FunctionCache.h"
+#include "InstantiationCache.h"
+#include "ModuleCache.h"
 #include "printutils.h"
 
+EvaluationSession::EvaluationSession(std::string documentRoot) :
+  document_root(std::move(documentRoot))
+{
+  FunctionCache::instance()->clear();
+  FunctionCache::instance()->resetStatistics();
+  ModuleCache::instance()->clear();
+  ModuleCache::instance()->resetStatistics();
+}
+
+EvaluationSession::~EvaluationSession()
+{
+  // Cached results refer to contexts of this session
+  FunctionCache::instance()->clear();
+  ModuleCache::instance()->clear();
+}
+
 size_t EvaluationSession::push_frame(ContextFrame *frame)
 {
   size_t index = stack.size();
@@ -49,9 +68,20 @@ void EvaluationSession::pop_frame(size_t index)
 
 boost::optional<const Value&> EvaluationSession::try_lookup_special_variable(const std::string& name) const
 {
+  const auto identifier = Identifier::find(name);
+  if (!identifier) return boost::none;
+  return try_lookup_special_variable(*identifier);
+}
+
+boost::optional<const Value&> EvaluationSession::try_lookup_special_variable(const Identifier& name) const
+{
+  // $-variables are dynamically scoped, so results depending on them can't be memoized
+  FunctionCache::instance()->addSideEffect();
   for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
+    if (!(*it)->has_config_variables()) continue;
     boost::optional<const Value&> result = (*it)->lookup_local_variable(name);
     if (result) {
+      if (dependency_recorder) dependency_recorder->lookup(*it, name.getName(), *result);
       return result;
     }
   }
@@ -68,19 +98,35 @@ const Value& EvaluationSession::lookup_special_variable(const std::string& name,
   return *result;
 }
 
-boost::optional<CallableFunction> EvaluationSession::lookup_special_function(const std::string& name, const Location& loc) const
+boost::optional<CallableFunction> EvaluationSession::lookup_special_function(const Identifier& name, const Location& loc) const
 {
+  FunctionCache::instance()->addSideEffect();
   for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
     boost::optional<CallableFunction> result = (*it)->lookup_local_function(name, loc);
     if (result) {
+      if (dependency_recorder) {
+        if (auto value = (*it)->lookup_local_variable(name)) dependency_recorder->lookup(*it, name.getName(), *value);
+      }
       return result;
     }
   }
-  LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown function '%1$s'", name);
+  LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown function '%1$s'", name.getName());
   return boost::none;
 }
 
-boost::optional<InstantiableModule> EvaluationSession::lookup_special_module(const std::string& name, const Location& loc) const
+void EvaluationSession::addExternalInput() const
+{
+  for (auto recorder = dependency_recorder; recorder; recorder = recorder->outer) recorder->external_input = true;
+}
+
+boost::optional<const Value&> EvaluationSession::try_lookup_import(const std::string& key) const
+{
+  const auto it = imported_values.find(key);
+  if (it == imported_values.end()) return boost::none;
+  return it->second;
+}
+
+boost::optional<InstantiableModule> EvaluationSession::lookup_special_module(const Identifier& name, const Location& loc) const
 {
   for (auto it = stack.crbegin(); it != stack.crend(); ++it) {
     boost::optional<InstantiableModule> result = (*it)->lookup_local_module(name, loc);
@@ -88,6 +134,6 @@ boost::optional<InstantiableModule> EvaluationSession::lookup_special_module(con
       return result;
     }
   }
-  LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown module '%1$s'", name);
+  LOG(message_group::Warning, loc, documentRoot(), "Ignoring unknown module '%1$s'", name.getName());
   return boost::none;
 }
@@ -1,39 +1,56 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include <boost/optional.hpp>
 
 #include "ContextMemoryManager.h"
+#include "Identifier.h"
 #include "function.h"
 #include "module.h"
 #include "Value.h"
 
 class ContextFrame;
+struct DependencyRecorder;
 
 class EvaluationSession
 {
 public:
-  EvaluationSession(std::string documentRoot) :
-    document_root(std::move(documentRoot))
-  {}
+  EvaluationSession(std::string documentRoot);
+  ~EvaluationSession();
 
   size_t push_frame(ContextFrame *frame);
   void replace_frame(size_t index, ContextFrame *frame);
   void pop_frame(size_t index);
 
   [[nodiscard]] boost::optional<const Value&> try_lookup_special_variable(const std::string& name) const;
+  [[nodiscard]] boost::optional<const Value&> try_lookup_special_variable(const Identifier& name) const;
   [[nodiscard]] const Value& lookup_special_variable(const std::string& name, const Location& loc) const;
-  [[nodiscard]] boost::optional<CallableFunction> lookup_special_function(const std::string& name, const Location& loc) const;
-  [[nodiscard]] boost::optional<InstantiableModule> lookup_special_module(const std::string& name, const Location& loc) const;
+  [[nodiscard]] boost::optional<CallableFunction> lookup_special_function(const Identifier& name, const Location& loc) const;
+  [[nodiscard]] boost::optional<InstantiableModule> lookup_special_module(const Identifier& name, const Location& loc) const;
 
   [[nodiscard]] const std::string& documentRoot() const { return document_root; }
+  // The frames of all live contexts, innermost last
+  [[nodiscard]] const std::vector<ContextFrame *>& frames() const { return stack; }
   ContextMemoryManager& contextMemoryManager() { return context_memory_manager; }
   HeapSizeAccounting& accounting() { return context_memory_manager.accounting(); }
 
+  // Receives lookups while top-level instantiations are recorded, see InstantiationCache
+  [[nodiscard]] DependencyRecorder *dependencyRecorder() const { return dependency_recorder; }
+  void setDependencyRecorder(DependencyRecorder *recorder) { dependency_recorder = recorder; }
+  // Marks the recorded instantiation as depending on files or other state outside the design
+  void addExternalInput() const;
+
+  // Values imported from files, by ImportCache::key, kept for the session
+  [[nodiscard]] boost::optional<const Value&> try_lookup_import(const std::string& key) const;
+  void insert_import(const std::string& key, Value&& value) { imported_values.insert_or_assign(key, std::move(value)); }
+
 private:
   std::string document_root;
   std::vector<ContextFrame *> stack;
   ContextMemoryManager context_memory_manager;
+  DependencyRecorder *dependency_recorder{nullptr};
+  std::unordered_map<std::string, Value> imported_values;
 };
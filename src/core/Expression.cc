@@ -41,6 +41,10 @@
 #include "Context.h"
 #include "exceptions.h"
 #include "Parameters.h"
+#include "Bytecode.h"
+#include "FunctionCache.h"
+#include "EvalProfiler.h"
+#include "EvaluationSession.h"
 #include "printutils.h"
 #include "boost-utils.h"
 #include <boost/regex.hpp>
@@ -62,6 +66,12 @@ UnaryOp::UnaryOp(UnaryOp::Op op, Expression *expr, const Location& loc) : Expres
 }
 
 Value UnaryOp::evaluate(const std::shared_ptr<const Context>& context) const
+{
+  if (isConstant()) return this->folded.get([&]() { return evaluateOp(context); });
+  return evaluateOp(context);
+}
+
+Value UnaryOp::evaluateOp(const std::shared_ptr<const Context>& context) const
 {
   switch (this->op) {
   case (Op::Not):    return !this->expr->evaluate(context).toBool();
@@ -87,6 +97,10 @@ bool UnaryOp::isLiteral() const {
   return this->expr->isLiteral();
 }
 
+bool UnaryOp::isConstant() const {
+  return this->folded.isConstant([this]() { return this->expr->isConstant(); });
+}
+
 void UnaryOp::print(std::ostream& stream, const std::string&) const
 {
   stream << opString() << *this->expr;
@@ -97,7 +111,18 @@ BinaryOp::BinaryOp(Expression *left, BinaryOp::Op op, Expression *right, const L
 {
 }
 
+bool BinaryOp::isConstant() const
+{
+  return this->folded.isConstant([this]() { return this->left->isConstant() && this->right->isConstant(); });
+}
+
 Value BinaryOp::evaluate(const std::shared_ptr<const Context>& context) const
+{
+  if (isConstant()) return this->folded.get([&]() { return evaluateOp(context); });
+  return evaluateOp(context);
+}
+
+Value BinaryOp::evaluateOp(const std::shared_ptr<const Context>& context) const
 {
   switch (this->op) {
   case Op::LogicalAnd:
@@ -187,7 +212,12 @@ ArrayLookup::ArrayLookup(Expression *array, Expression *index, const Location& l
 {
 }
 
+bool ArrayLookup::isConstant() const {
+  return this->folded.isConstant([this]() { return this->array->isConstant() && this->index->isConstant(); });
+}
+
 Value ArrayLookup::evaluate(const std::shared_ptr<const Context>& context) const {
+  if (isConstant()) return this->folded.get([&]() { return this->array->evaluate(context)[this->index->evaluate(context)]; });
   return this->array->evaluate(context)[this->index->evaluate(context)];
 }
 
@@ -280,6 +310,12 @@ bool Range::isLiteral() const {
          begin->isLiteral() && end->isLiteral();
 }
 
+bool Range::isConstant() const {
+  return this->step ?
+         begin->isConstant() && end->isConstant() && step->isConstant() :
+         begin->isConstant() && end->isConstant();
+}
+
 Vector::Vector(const Location& loc) : Expression(loc), literal_flag(unknown)
 {
 }
@@ -299,27 +335,64 @@ bool Vector::isLiteral() const {
   }
 }
 
+bool Vector::isConstant() const {
+  return this->folded.isConstant([this]() {
+    return std::all_of(this->children.begin(), this->children.end(), [](const auto& e) { return e->isConstant(); });
+  });
+}
+
 void Vector::emplace_back(Expression *expr)
 {
   this->children.emplace_back(expr);
 }
 
+/*!
+   Machine generated files can have literal vectors of millions of numbers.
+   Packed, they take a Value per number instead of a literal expression with
+   its location, and the whole vector evaluates to a copy of one shared value.
+ */
+Expression *Vector::pack(Expression *expr)
+{
+  const auto *vector = dynamic_cast<const Vector *>(expr);
+  if (!vector) return expr;
+  for (const auto& child : vector->children) {
+    const auto *literal = dynamic_cast<const Literal *>(child.get());
+    if (!literal || !(literal->isDouble() || literal->isVector())) return expr;
+  }
+  VectorType value(nullptr);
+  value.reserve(vector->children.size());
+  for (const auto& child : vector->children) {
+    value.emplace_back(static_cast<const Literal *>(child.get())->getValue().clone());
+  }
+  auto *packed = new Literal(std::move(value), vector->location());
+  delete expr;
+  return packed;
+}
+
 Value Vector::evaluate(const std::shared_ptr<const Context>& context) const
 {
-  if (children.size() == 1) {
+  if (isConstant()) return this->folded.get([&]() { return evaluateVector(context); });
+  return evaluateVector(context);
+}
+
+Value Vector::evaluateVector(const std::shared_ptr<const Context>& context) const
+{
+  // Folded vectors outlive the session, but can't hold anything the session must account for
+  EvaluationSession *session = isConstant() ? nullptr : context->session();
+  if (children.size() == 1 && !dynamic_cast<const ListComprehension *>(children.front().get())) {
     Value val = children.front()->evaluate(context);
     // If only 1 EmbeddedVectorType, convert to plain VectorType
     if (val.type() == Value::Type::EMBEDDED_VECTOR) {
       return VectorType(std::move(val.toEmbeddedVectorNonConst()));
     } else {
-      VectorType vec(context->session());
+      VectorType vec(session);
       vec.emplace_back(std::move(val));
       return std::move(vec);
     }
   } else {
-    VectorType vec(context->session());
+    VectorType vec(session);
     vec.reserve(this->children.size());
-    for (const auto& e : this->children) vec.emplace_back(e->evaluate(context));
+    for (const auto& e : this->children) ListComprehension::appendElement(*e, context, vec);
     return std::move(vec);
   }
 }
@@ -345,7 +418,7 @@ Value Lookup::evaluate(const std::shared_ptr<const Context>& context) const
 
 void Lookup::print(std::ostream& stream, const std::string&) const
 {
-  stream << this->name;
+  stream << this->name.getName();
 }
 
 MemberLookup::MemberLookup(Expression *expr, std::string member, const Location& loc)
@@ -386,8 +459,17 @@ Value MemberLookup::evaluate(const std::shared_ptr<const Context>& context) cons
     if (this->member == "step") return v[1];
     if (this->member == "end") return v[2];
     break;
-  case Value::Type::OBJECT:
-    return v[this->member];
+  case Value::Type::OBJECT: {
+    const auto& object = v.toObject();
+    const auto& shape = object.shape();
+    if (shape != this->cachedShape) {
+      const size_t slot = shape->find(this->member);
+      if (slot == ObjectShape::npos) return Value::undefined.clone();
+      this->cachedShape = shape;
+      this->cachedSlot = slot;
+    }
+    return object.slot(this->cachedSlot).clone();
+  }
   default:
     break;
   }
@@ -406,7 +488,7 @@ FunctionDefinition::FunctionDefinition(Expression *expr, AssignmentList paramete
 
 Value FunctionDefinition::evaluate(const std::shared_ptr<const Context>& context) const
 {
-  return FunctionPtr{FunctionType{context, expr, std::make_unique<AssignmentList>(parameters)}};
+  return FunctionPtr{FunctionType{context, expr, std::make_unique<AssignmentList>(parameters), bytecode.get(*expr)}};
 }
 
 void FunctionDefinition::print(std::ostream& stream, const std::string& indent) const
@@ -465,7 +547,7 @@ FunctionCall::FunctionCall(Expression *expr, AssignmentList args, const Location
 boost::optional<CallableFunction> FunctionCall::evaluate_function_expression(const std::shared_ptr<const Context>& context) const
 {
   if (isLookup) {
-    return context->lookup_function(name, location());
+    return context->lookup_function(static_cast<const Lookup *>(expr.get())->get_identifier(), location());
   } else {
     auto v = expr->evaluate(context);
     if (v.type() == Value::Type::FUNCTION) {
@@ -481,6 +563,11 @@ struct SimplifiedExpression {
   const Expression *expression;
   boost::optional<ContextHandle<Context>> new_context = boost::none;
   boost::optional<const FunctionCall *> new_active_function_call = boost::none;
+  // For a call to a user function, its parameters, to be bound in a context below defining_context
+  boost::optional<ContextFrame> parameters = boost::none;
+  std::shared_ptr<const Context> defining_context = nullptr;
+  const Bytecode *bytecode = nullptr; // Compiled form of expression, if available
+  boost::optional<FunctionCache::Call> memo_call = boost::none;
 };
 using SimplificationResult = std::variant<SimplifiedExpression, Value>;
 
@@ -510,6 +597,7 @@ static SimplificationResult simplify_function_body(const Expression *expression,
       const Expression *function_body;
       const AssignmentList *required_parameters;
       std::shared_ptr<const Context> defining_context;
+      const Bytecode *bytecode;
 
       auto f = call->evaluate_function_expression(context);
       if (!f) {
@@ -523,6 +611,7 @@ static SimplificationResult simplify_function_body(const Expression *expression,
           function_body = callable.function->expr.get();
           required_parameters = &callable.function->parameters;
           defining_context = callable.defining_context;
+          bytecode = callable.function->getBytecode().get();
         } else {
           const FunctionType *function;
           if (index == 2) {
@@ -535,15 +624,22 @@ static SimplificationResult simplify_function_body(const Expression *expression,
           function_body = function->getExpr().get();
           required_parameters = function->getParameters().get();
           defining_context = function->getContext();
+          bytecode = function->getBytecode().get();
         }
       }
-      ContextHandle<Context> body_context{Context::create<Context>(defining_context)};
-      body_context->apply_config_variables(*context);
       Arguments arguments{call->arguments, context};
       Parameters parameters = Parameters::parse(std::move(arguments), call->location(), *required_parameters, defining_context);
-      body_context->apply_variables(std::move(parameters).to_context_frame());
 
-      return SimplifiedExpression{function_body, std::move(body_context), call};
+      std::vector<Value> parameter_values;
+      parameter_values.reserve(required_parameters->size());
+      for (const auto& parameter : *required_parameters) {
+        auto value = parameters.lookup(parameter->getName());
+        parameter_values.push_back(value ? value->clone() : Value::undefined.clone());
+      }
+      auto memo_call = FunctionCache::instance()->makeCall(function_body, defining_context, std::move(parameter_values));
+
+      return SimplifiedExpression{function_body, boost::none, call, std::move(parameters).to_context_frame(),
+                                  std::move(defining_context), bytecode, std::move(memo_call)};
     } else {
       return expression->evaluate(context);
     }
@@ -557,6 +653,7 @@ Value FunctionCall::evaluate(const std::shared_ptr<const Context>& context) cons
     print_err(name.c_str(), loc, context);
     throw RecursionException::create("function", name, this->loc);
   }
+  EvalProfiler::Call profile{"function", name, this->loc, context->session()->accounting()};
 
   // Repeatedly simplify expr until it reduces to either a tail call,
   // or an expression that cannot be simplified in-place. If the latter,
@@ -567,19 +664,51 @@ Value FunctionCall::evaluate(const std::shared_ptr<const Context>& context) cons
 
   ContextHandle<Context> expression_context{Context::create<Context>(context)};
   const Expression *expression = this;
+  // Function body for which expression_context holds the parameters, if it is such a context
+  const Expression *context_body = nullptr;
+  // The memoizable call this evaluation started with, tail calls are covered by its result
+  boost::optional<FunctionCache::Call> memo_call;
+  size_t memo_mark = 0;
+  auto finish = [&](Value&& value) -> Value {
+    if (memo_call) FunctionCache::instance()->insert(std::move(*memo_call), memo_mark, value);
+    return std::move(value);
+  };
   while (true) {
     try {
       auto result = simplify_function_body(expression, *expression_context);
       if (Value *value = std::get_if<Value>(&result)) {
-        return std::move(*value);
+        return finish(std::move(*value));
       }
 
       SimplifiedExpression *simplified_expression = std::get_if<SimplifiedExpression>(&result);
       assert(simplified_expression);
 
+      if (simplified_expression->memo_call && recursion_depth == 0) {
+        if (auto cached = FunctionCache::instance()->get(*simplified_expression->memo_call)) {
+          return std::move(*cached);
+        }
+        memo_call = std::move(simplified_expression->memo_call);
+        memo_mark = FunctionCache::instance()->sideEffects();
+      }
+
       expression = simplified_expression->expression;
       if (simplified_expression->new_context) {
         expression_context = std::move(*simplified_expression->new_context);
+        context_body = nullptr;
+      }
+      if (simplified_expression->parameters) {
+        // A self tail call rebinds the parameters in place, unless something
+        // like a function literal still refers to the current ones.
+        if (expression == context_body && expression_context.use_count() == 1 &&
+            expression_context->getParent() == simplified_expression->defining_context) {
+          expression_context->clear_lexical_variables();
+        } else {
+          ContextHandle<Context> body_context{Context::create<Context>(simplified_expression->defining_context)};
+          body_context->apply_config_variables(**expression_context);
+          expression_context = std::move(body_context);
+          context_body = expression;
+        }
+        expression_context->apply_variables(std::move(*simplified_expression->parameters));
       }
       if (simplified_expression->new_active_function_call) {
         current_call = *simplified_expression->new_active_function_call;
@@ -588,6 +717,9 @@ Value FunctionCall::evaluate(const std::shared_ptr<const Context>& context) cons
           throw RecursionException::create("function", current_call->name, current_call->location());
         }
       }
+      if (simplified_expression->bytecode) {
+        return finish(simplified_expression->bytecode->execute(*expression_context));
+      }
     } catch (EvaluationException& e) {
       if (e.traceDepth > 0) {
         print_trace(current_call, *expression_context);
@@ -700,7 +832,7 @@ void Let::doSequentialAssignment(const AssignmentList& assignments, const Locati
     } else if (seen.find(assignment->getName()) != seen.end()) {
       LOG(message_group::Warning, location, targetContext->documentRoot(), "Ignoring duplicate variable assignment %1$s = %2$s", assignment->getName(), value.toEchoStringNoThrow());
     } else {
-      targetContext->set_variable(assignment->getName(), std::move(value));
+      targetContext->set_variable(assignment->getIdentifier(), std::move(value));
       seen.insert(assignment->getName());
     }
   }
@@ -734,19 +866,73 @@ ListComprehension::ListComprehension(const Location& loc) : Expression(loc)
 {
 }
 
+Value ListComprehension::evaluate(const std::shared_ptr<const Context>& context) const
+{
+  EmbeddedVectorType vec(context->session());
+  evaluateInto(context, vec, nullptr);
+  return {std::move(vec)};
+}
+
+void ListComprehension::appendElement(const Expression& expr, const std::shared_ptr<const Context>& context, VectorType& output, const Each *each)
+{
+  if (const auto *lc = dynamic_cast<const ListComprehension *>(&expr)) {
+    lc->evaluateInto(context, output, each);
+  } else {
+    appendValue(expr.evaluate(context), context, output, each);
+  }
+}
+
+// Applies the pending each elements to value, recurring into already embedded vectors.
+//    Context is only passed along for the possible use in Range warning.
+void ListComprehension::appendValue(Value&& value, const std::shared_ptr<const Context>& context, VectorType& output, const Each *each)
+{
+  if (!each) {
+    output.emplace_back(std::move(value));
+  } else if (value.type() == Value::Type::RANGE) {
+    const RangeType& range = value.toRange();
+    uint32_t steps = range.numValues();
+    if (steps >= 1000000) {
+      LOG(message_group::Warning, each->loc, context->documentRoot(), "Bad range parameter in for statement: too many elements (%1$lu)", steps);
+    } else if (!each->outer) {
+      // A zero step yields no values, whatever numValues() says
+      auto it = range.begin();
+      if (it != range.end()) {
+        output.emplace_numbers(steps, [&it]() {
+          const double d = *it;
+          ++it;
+          return d;
+        });
+      }
+    } else {
+      for (double d : range) appendValue(Value(d), context, output, each->outer);
+    }
+  } else if (value.type() == Value::Type::VECTOR) {
+    if (!each->outer) {
+      // Safe to move the overall vector ptr since we have a temporary value (could be a copy, or constructed just for us, doesn't matter)
+      output.emplace_back(EmbeddedVectorType(std::move(value.toVectorNonConst())));
+    } else {
+      // Not safe to move values out of a vector, since it's shared_ptr maye be shared with another Value,
+      // which should remain constant
+      for (const auto& element : value.toVector()) appendValue(element.clone(), context, output, each->outer);
+    }
+  } else if (value.type() == Value::Type::EMBEDDED_VECTOR) {
+    for (const auto& element : value.toEmbeddedVector()) appendValue(element.clone(), context, output, each);
+  } else if (value.type() == Value::Type::STRING) {
+    for (auto ch : value.toStrUtf8Wrapper()) appendValue(Value(std::move(ch)), context, output, each->outer);
+  } else if (value.type() != Value::Type::UNDEFINED) {
+    output.emplace_back(std::move(value));
+  }
+}
+
 LcIf::LcIf(Expression *cond, Expression *ifexpr, Expression *elseexpr, const Location& loc)
   : ListComprehension(loc), cond(cond), ifexpr(ifexpr), elseexpr(elseexpr)
 {
 }
 
-Value LcIf::evaluate(const std::shared_ptr<const Context>& context) const
+void LcIf::evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const
 {
   const shared_ptr<Expression>& expr = this->cond->evaluate(context).toBool() ? this->ifexpr : this->elseexpr;
-  if (expr) {
-    return expr->evaluate(context);
-  } else {
-    return EmbeddedVectorType::Empty();
-  }
+  if (expr) appendElement(*expr, context, output, each);
 }
 
 void LcIf::print(std::ostream& stream, const std::string&) const
@@ -761,47 +947,16 @@ LcEach::LcEach(Expression *expr, const Location& loc) : ListComprehension(loc),
 {
 }
 
-// Need this for recurring into already embedded vectors, and performing "each" on their elements
-//    Context is only passed along for the possible use in Range warning.
-Value LcEach::evalRecur(Value&& v, const std::shared_ptr<const Context>& context) const
+void LcEach::evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const
 {
-  if (v.type() == Value::Type::RANGE) {
-    const RangeType& range = v.toRange();
-    uint32_t steps = range.numValues();
-    if (steps >= 1000000) {
-      LOG(message_group::Warning, loc, context->documentRoot(), "Bad range parameter in for statement: too many elements (%1$lu)", steps);
-    } else {
-      EmbeddedVectorType vec(context->session());
-      vec.reserve(range.numValues());
-      for (double d : range) vec.emplace_back(d);
-      return {std::move(vec)};
-    }
-  } else if (v.type() == Value::Type::VECTOR) {
-    // Safe to move the overall vector ptr since we have a temporary value (could be a copy, or constructed just for us, doesn't matter)
-    auto vec = EmbeddedVectorType(std::move(v.toVectorNonConst()));
-    return {std::move(vec)};
-  } else if (v.type() == Value::Type::EMBEDDED_VECTOR) {
-    EmbeddedVectorType vec(context->session());
-    vec.reserve(v.toEmbeddedVector().size());
-    // Not safe to move values out of a vector, since it's shared_ptr maye be shared with another Value,
-    // which should remain constant
-    for (const auto& val : v.toEmbeddedVector()) vec.emplace_back(evalRecur(val.clone(), context) );
-    return {std::move(vec)};
-  } else if (v.type() == Value::Type::STRING) {
-    EmbeddedVectorType vec(context->session());
-    auto &wrapper = v.toStrUtf8Wrapper();
-    vec.reserve(wrapper.size());
-    for (auto ch : wrapper) vec.emplace_back(std::move(ch));
-    return {std::move(vec)};
-  } else if (v.type() != Value::Type::UNDEFINED) {
-    return std::move(v);
+  const Each inner{this->loc, each};
+  const auto *vector = dynamic_cast<const Vector *>(this->expr.get());
+  if (vector && !vector->isConstant()) {
+    // each [a, b, ...] appends a, b, ... without building the vector
+    for (const auto& element : vector->getChildren()) appendElement(*element, context, output, each);
+  } else {
+    appendElement(*this->expr, context, output, &inner);
   }
-  return EmbeddedVectorType::Empty();
-}
-
-Value LcEach::evaluate(const std::shared_ptr<const Context>& context) const
-{
-  return evalRecur(this->expr->evaluate(context), context);
 }
 
 void LcEach::print(std::ostream& stream, const std::string&) const
@@ -895,17 +1050,16 @@ void LcFor::forEach(const AssignmentList& assignments, const Location& loc, cons
   doForEach(assignments, loc, operation, 0, context, pReserve);
 }
 
-Value LcFor::evaluate(const std::shared_ptr<const Context>& context) const
+void LcFor::evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const
 {
-  EmbeddedVectorType vec(context->session());
-  std::function<void(size_t)> reserve = [&vec](size_t capacity) {
-    vec.reserve(capacity);
+  // Only reserve for a vector of our own, repeated exact reserves by nested loops would defeat its growth
+  std::function<void(size_t)> reserve = [&output](size_t capacity) {
+    if (output.empty()) output.reserve(capacity);
   };
   forEach(this->arguments, this->loc, context,
-          [&vec, expression = expr.get()] (const std::shared_ptr<const Context>& iterationContext) {
-    vec.emplace_back(expression->evaluate(iterationContext));
-  }, &reserve);
-  return {std::move(vec)};
+          [&output, each, expression = expr.get()] (const std::shared_ptr<const Context>& iterationContext) {
+    appendElement(*expression, iterationContext, output, each);
+  }, each ? nullptr : &reserve);
 }
 
 void LcFor::print(std::ostream& stream, const std::string&) const
@@ -918,16 +1072,14 @@ LcForC::LcForC(AssignmentList args, AssignmentList incrargs, Expression *cond, E
 {
 }
 
-Value LcForC::evaluate(const std::shared_ptr<const Context>& context) const
+void LcForC::evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const
 {
-  EmbeddedVectorType output(context->session());
-
   ContextHandle<Context> initialContext{Let::sequentialAssignmentContext(this->arguments, this->location(), context)};
   ContextHandle<Context> currentContext{Context::create<Context>(*initialContext)};
 
   unsigned int counter = 0;
   while (this->cond->evaluate(*currentContext).toBool()) {
-    output.emplace_back(this->expr->evaluate(*currentContext));
+    appendElement(*this->expr, *currentContext, output, each);
 
     if (counter++ == 1000000) {
       LOG(message_group::Error, loc, context->documentRoot(), "For loop counter exceeded limit");
@@ -949,7 +1101,6 @@ Value LcForC::evaluate(const std::shared_ptr<const Context>& context) const
     currentContext = std::move(nextContext);
     currentContext->setParent(*initialContext);
   }
-  return {std::move(output)};
 }
 
 void LcForC::print(std::ostream& stream, const std::string&) const
@@ -966,9 +1117,9 @@ LcLet::LcLet(AssignmentList args, Expression *expr, const Location& loc)
 {
 }
 
-Value LcLet::evaluate(const std::shared_ptr<const Context>& context) const
+void LcLet::evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const
 {
-  return this->expr->evaluate(*Let::sequentialAssignmentContext(this->arguments, this->location(), context));
+  appendElement(*this->expr, *Let::sequentialAssignmentContext(this->arguments, this->location(), context), output, each);
 }
 
 void LcLet::print(std::ostream& stream, const std::string&) const
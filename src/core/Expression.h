@@ -6,8 +6,10 @@
 #include <vector>
 #include <boost/logic/tribool.hpp>
 #include "Assignment.h"
+#include "Identifier.h"
 #include "function.h"
 #include "memory.h"
+#include "printutils.h"
 #include "Value.h"
 
 template <class T> class ContextHandle;
@@ -17,10 +19,40 @@ class Expression : public ASTNode
 public:
   Expression(const Location& loc) : ASTNode(loc) {}
   [[nodiscard]] virtual bool isLiteral() const;
+  // True if the value doesn't depend on any context, unlike isLiteral() this includes operators
+  [[nodiscard]] virtual bool isConstant() const { return isLiteral(); }
   [[nodiscard]] virtual Value evaluate(const std::shared_ptr<const Context>& context) const = 0;
   Value checkUndef(Value&& val, const std::shared_ptr<const Context>& context) const;
 };
 
+/*!
+   Folds a constant subexpression: its value is computed at the first
+   evaluation and shared by later ones. Results of evaluations which printed
+   a message, e.g. a warning about an undefined operation inside a vector,
+   and undefined results aren't kept, so their warnings are still given at
+   every evaluation.
+ */
+class ConstantValue
+{
+public:
+  template <typename IsConstant>
+  bool isConstant(IsConstant isConstant) const {
+    if (boost::logic::indeterminate(this->constant)) this->constant = isConstant();
+    return bool(this->constant);
+  }
+  template <typename Evaluate>
+  Value get(Evaluate evaluate) const {
+    if (this->value) return this->value->clone();
+    const size_t messages = print_message_count;
+    Value result = evaluate();
+    if (result.type() != Value::Type::UNDEFINED && print_message_count == messages) this->value = std::make_shared<const Value>(result.clone());
+    return result;
+  }
+private:
+  mutable boost::tribool constant{boost::logic::indeterminate};
+  mutable std::shared_ptr<const Value> value;
+};
+
 class UnaryOp : public Expression
 {
 public:
@@ -29,15 +61,20 @@ public:
     Negate
   };
   [[nodiscard]] bool isLiteral() const override;
+  [[nodiscard]] bool isConstant() const override;
   UnaryOp(Op op, Expression *expr, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] Op getOp() const { return op; }
+  [[nodiscard]] const Expression *getExpr() const { return expr.get(); }
 
 private:
   [[nodiscard]] const char *opString() const;
+  [[nodiscard]] Value evaluateOp(const std::shared_ptr<const Context>& context) const;
 
   Op op;
   shared_ptr<Expression> expr;
+  ConstantValue folded;
 };
 
 class BinaryOp : public Expression
@@ -61,15 +98,21 @@ public:
   };
 
   BinaryOp(Expression *left, Op op, Expression *right, const Location& loc);
+  [[nodiscard]] bool isConstant() const override;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] Op getOp() const { return op; }
+  [[nodiscard]] const Expression *getLeft() const { return left.get(); }
+  [[nodiscard]] const Expression *getRight() const { return right.get(); }
 
 private:
   [[nodiscard]] const char *opString() const;
+  [[nodiscard]] Value evaluateOp(const std::shared_ptr<const Context>& context) const;
 
   Op op;
   shared_ptr<Expression> left;
   shared_ptr<Expression> right;
+  ConstantValue folded;
 };
 
 class TernaryOp : public Expression
@@ -79,6 +122,9 @@ public:
   [[nodiscard]] const Expression *evaluateStep(const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const Expression *getCond() const { return cond.get(); }
+  [[nodiscard]] const Expression *getIfExpr() const { return ifexpr.get(); }
+  [[nodiscard]] const Expression *getElseExpr() const { return elseexpr.get(); }
 private:
   shared_ptr<Expression> cond;
   shared_ptr<Expression> ifexpr;
@@ -89,11 +135,15 @@ class ArrayLookup : public Expression
 {
 public:
   ArrayLookup(Expression *array, Expression *index, const Location& loc);
+  [[nodiscard]] bool isConstant() const override;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const Expression *getArray() const { return array.get(); }
+  [[nodiscard]] const Expression *getIndex() const { return index.get(); }
 private:
   shared_ptr<Expression> array;
   shared_ptr<Expression> index;
+  ConstantValue folded;
 };
 
 class Literal : public Expression
@@ -108,6 +158,8 @@ public:
   [[nodiscard]] bool isString() const { return value.type() == Value::Type::STRING; }
   [[nodiscard]] const std::string& toString() const { return value.toStrUtf8Wrapper().toString(); }
   [[nodiscard]] bool isUndefined() const { return value.type() == Value::Type::UNDEFINED; }
+  [[nodiscard]] bool isVector() const { return value.type() == Value::Type::VECTOR; }
+  [[nodiscard]] const Value& getValue() const { return value; }
 
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
@@ -127,6 +179,7 @@ public:
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
   [[nodiscard]] bool isLiteral() const override;
+  [[nodiscard]] bool isConstant() const override;
 private:
   shared_ptr<Expression> begin;
   shared_ptr<Expression> step;
@@ -141,10 +194,16 @@ public:
   Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
   void emplace_back(Expression *expr);
+  // Replaces a vector of numbers (or of such vectors) by one literal of its value, and deletes it
+  static Expression *pack(Expression *expr);
   bool isLiteral() const override;
+  bool isConstant() const override;
 private:
+  Value evaluateVector(const std::shared_ptr<const Context>& context) const;
+
   std::vector<shared_ptr<Expression>> children;
   mutable boost::tribool literal_flag; // cache if already computed
+  ConstantValue folded;
 };
 
 class Lookup : public Expression
@@ -153,9 +212,10 @@ public:
   Lookup(std::string name, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
-  [[nodiscard]] const std::string& get_name() const { return name; }
+  [[nodiscard]] const std::string& get_name() const { return name.getName(); }
+  [[nodiscard]] const Identifier& get_identifier() const { return name; }
 private:
-  std::string name;
+  Identifier name;
 };
 
 class MemberLookup : public Expression
@@ -164,9 +224,14 @@ public:
   MemberLookup(Expression *expr, std::string member, const Location& loc);
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const Expression *getExpr() const { return expr.get(); }
+  [[nodiscard]] const std::string& getMember() const { return member; }
 private:
   shared_ptr<Expression> expr;
   std::string member;
+  // The slot of the member in the shape of the last object looked up
+  mutable shared_ptr<const ObjectShape> cachedShape;
+  mutable size_t cachedSlot{0};
 };
 
 class FunctionCall : public Expression
@@ -195,6 +260,8 @@ public:
   shared_ptr<const Context> context;
   AssignmentList parameters;
   shared_ptr<Expression> expr;
+private:
+  BytecodeCache bytecode;
 };
 
 class Assert : public Expression
@@ -205,6 +272,8 @@ public:
   [[nodiscard]] const Expression *evaluateStep(const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const AssignmentList& getArguments() const { return arguments; }
+  [[nodiscard]] const Expression *getExpr() const { return expr.get(); }
 private:
   AssignmentList arguments;
   shared_ptr<Expression> expr;
@@ -217,6 +286,8 @@ public:
   [[nodiscard]] const Expression *evaluateStep(const std::shared_ptr<const Context>& context) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const AssignmentList& getArguments() const { return arguments; }
+  [[nodiscard]] const Expression *getExpr() const { return expr.get(); }
 private:
   AssignmentList arguments;
   shared_ptr<Expression> expr;
@@ -231,23 +302,44 @@ public:
   const Expression *evaluateStep(ContextHandle<Context>& targetContext) const;
   [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const AssignmentList& getArguments() const { return arguments; }
+  [[nodiscard]] const Expression *getExpr() const { return expr.get(); }
 private:
   AssignmentList arguments;
   shared_ptr<Expression> expr;
 };
 
+/*!
+   List comprehension elements don't build vectors of their own, they append
+   their elements to the vector being built by the outermost one, so chains of
+   each, if, for and let are evaluated without intermediate vectors.
+ */
 class ListComprehension : public Expression
 {
 public:
   ListComprehension(const Location& loc);
+  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+
+  // The enclosing each elements, innermost first, which still have to be applied to a value
+  struct Each {
+    const Location& loc;
+    const Each *outer;
+  };
+  virtual void evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const = 0;
+  // Appends the value of expr, evaluating list comprehensions in place
+  static void appendElement(const Expression& expr, const std::shared_ptr<const Context>& context, VectorType& output, const Each *each = nullptr);
+  static void appendValue(Value&& value, const std::shared_ptr<const Context>& context, VectorType& output, const Each *each);
 };
 
 class LcIf : public ListComprehension
 {
 public:
   LcIf(Expression *cond, Expression *ifexpr, Expression *elseexpr, const Location& loc);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const Expression *getCond() const { return cond.get(); }
+  [[nodiscard]] const Expression *getIfExpr() const { return ifexpr.get(); }
+  [[nodiscard]] const Expression *getElseExpr() const { return elseexpr.get(); }
 private:
   shared_ptr<Expression> cond;
   shared_ptr<Expression> ifexpr;
@@ -259,8 +351,10 @@ class LcFor : public ListComprehension
 public:
   LcFor(AssignmentList args, Expression *expr, const Location& loc);
   static void forEach(const AssignmentList& assignments, const Location& loc, const std::shared_ptr<const Context>& context, const std::function<void(const std::shared_ptr<const Context>&)>& operation, const std::function<void(size_t)>* pReserve = nullptr);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const AssignmentList& getArguments() const { return arguments; }
+  [[nodiscard]] const Expression *getExpr() const { return expr.get(); }
 private:
   AssignmentList arguments;
   shared_ptr<Expression> expr;
@@ -270,8 +364,12 @@ class LcForC : public ListComprehension
 {
 public:
   LcForC(AssignmentList args, AssignmentList incrargs, Expression *cond, Expression *expr, const Location& loc);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const AssignmentList& getArguments() const { return arguments; }
+  [[nodiscard]] const AssignmentList& getIncrArguments() const { return incr_arguments; }
+  [[nodiscard]] const Expression *getCond() const { return cond.get(); }
+  [[nodiscard]] const Expression *getExpr() const { return expr.get(); }
 private:
   AssignmentList arguments;
   AssignmentList incr_arguments;
@@ -283,10 +381,10 @@ class LcEach : public ListComprehension
 {
 public:
   LcEach(Expression *expr, const Location& loc);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const Expression *getExpr() const { return expr.get(); }
 private:
-  Value evalRecur(Value&& v, const std::shared_ptr<const Context>& context) const;
   shared_ptr<Expression> expr;
 };
 
@@ -294,8 +392,10 @@ class LcLet : public ListComprehension
 {
 public:
   LcLet(AssignmentList args, Expression *expr, const Location& loc);
-  [[nodiscard]] Value evaluate(const std::shared_ptr<const Context>& context) const override;
+  void evaluateInto(const std::shared_ptr<const Context>& context, VectorType& output, const Each *each) const override;
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const AssignmentList& getArguments() const { return arguments; }
+  [[nodiscard]] const Expression *getExpr() const { return expr.get(); }
 private:
   AssignmentList arguments;
   shared_ptr<Expression> expr;
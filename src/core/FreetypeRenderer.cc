@@ -27,6 +27,7 @@
 #include <cstdio>
 
 #include <iostream>
+#include <sstream>
 
 #include <fontconfig/fontconfig.h>
 
@@ -36,6 +37,7 @@
 #include "DrawingCallback.h"
 #include "FreetypeRenderer.h"
 #include "calc.h"
+#include "parallel.h"
 
 #include FT_OUTLINE_H
 // NOLINTNEXTLINE(bugprone-macro-parentheses)
@@ -313,20 +315,33 @@ void FreetypeRenderer::Params::set(Parameters& parameters)
 }
 
 
-FreetypeRenderer::ShapeResults::ShapeResults(
+/*!
+   Shapes the text with HarfBuzz. The result is only cached if all glyphs
+   could be loaded, so warnings about missing glyphs are repeated.
+ */
+shared_ptr<const GlyphCache::Shaping> FreetypeRenderer::ShapeResults::shape(
   const FreetypeRenderer::Params& params)
 {
+  const char sep = '\x1f';
+  std::ostringstream keystream;
+  keystream.precision(17);
+  keystream << params.text << sep << params.font << sep << params.direction << sep
+            << params.language << sep << params.script << sep << params.spacing;
+  const std::string key = keystream.str();
+  if (auto shaping = GlyphCache::instance()->getShaping(key)) return shaping;
+
   FT_Face face = params.get_font_face();
   if (face == nullptr) {
-    return;
+    return nullptr;
   }
 
-  hb_ft_font = hb_ft_font_create(face, nullptr);
+  hb_font_t *hb_ft_font = hb_ft_font_create(face, nullptr);
 
-  hb_buf = hb_buffer_create();
+  hb_buffer_t *hb_buf = hb_buffer_create();
   hb_buffer_set_direction(hb_buf, hb_direction_from_string(params.direction.c_str(), -1));
   hb_buffer_set_script(hb_buf, hb_script_from_string(params.script.c_str(), -1));
   hb_buffer_set_language(hb_buf, hb_language_from_string(params.language.c_str(), -1));
+  bool complete = true;
   if (FontCache::instance()->is_windows_symbol_font(face)) {
     // Special handling for symbol fonts like Webdings.
     // see http://www.microsoft.com/typography/otspec/recom.htm
@@ -348,6 +363,7 @@ FreetypeRenderer::ShapeResults::ShapeResults(
       LOG(message_group::Warning, params.loc, params.documentPath,
           "Ignoring text with invalid UTF-8 encoding: \"%1$s\"",
           params.text.c_str());
+      complete = false;
     }
   } else {
     hb_buffer_add_utf8(hb_buf, params.text.c_str(), strlen(params.text.c_str()), 0, strlen(params.text.c_str()));
@@ -358,7 +374,18 @@ FreetypeRenderer::ShapeResults::ShapeResults(
   hb_glyph_info_t *glyph_info = hb_buffer_get_glyph_infos(hb_buf, &glyph_count);
   hb_glyph_position_t *glyph_pos = hb_buffer_get_glyph_positions(hb_buf, &glyph_count);
 
-  glyph_array.reserve(glyph_count);
+  auto shaping = std::make_shared<GlyphCache::Shaping>();
+  auto& glyphs = shaping->glyphs;
+  glyphs.reserve(glyph_count);
+  double ascent = std::numeric_limits<double>::lowest();
+  double descent = std::numeric_limits<double>::max();
+  double advance_x = 0;
+  double advance_y = 0;
+  double left = std::numeric_limits<double>::max();
+  double right = std::numeric_limits<double>::lowest();
+  double bottom = std::numeric_limits<double>::max();
+  double top = std::numeric_limits<double>::lowest();
+
   for (unsigned int idx = 0; idx < glyph_count; ++idx) {
     FT_Error error;
     FT_UInt glyph_index = glyph_info[idx].codepoint;
@@ -368,6 +395,7 @@ FreetypeRenderer::ShapeResults::ShapeResults(
           "Could not load glyph %1$u"
           " for char at index %2$u in text '%3$s'",
           glyph_index, idx, params.text);
+      complete = false;
       continue;
     }
 
@@ -378,24 +406,18 @@ FreetypeRenderer::ShapeResults::ShapeResults(
           "Could not get glyph %1$u"
           " for char at index %2$u in text '%3$s'",
           glyph_index, idx, params.text);
+      complete = false;
       continue;
     }
 
-    glyph_array.emplace_back(glyph, idx, &glyph_pos[idx]);
-  }
-
-  ascent = std::numeric_limits<double>::lowest();
-  descent = std::numeric_limits<double>::max();
-  advance_x = 0;
-  advance_y = 0;
-  left = std::numeric_limits<double>::max();
-  right = std::numeric_limits<double>::lowest();
-  bottom = std::numeric_limits<double>::max();
-  top = std::numeric_limits<double>::lowest();
+    const GlyphCache::ShapedGlyph shaped{glyph_index,
+                                         glyph_pos[idx].x_offset / scale, glyph_pos[idx].y_offset / scale,
+                                         glyph_pos[idx].x_advance / scale, glyph_pos[idx].y_advance / scale};
+    glyphs.push_back(shaped);
 
-  for (const auto& glyph : glyph_array) {
     FT_BBox bbox;
-    FT_Glyph_Get_CBox(glyph.get_glyph(), FT_GLYPH_BBOX_GRIDFIT, &bbox);
+    FT_Glyph_Get_CBox(glyph, FT_GLYPH_BBOX_GRIDFIT, &bbox);
+    FT_Done_Glyph(glyph);
 
     // Note that glyphs can extend left of their origin
     // and right of their advance-width, into the next
@@ -410,8 +432,8 @@ FreetypeRenderer::ShapeResults::ShapeResults(
       ascent = std::max(ascent, bbox.yMax / scale);
       descent = std::min(descent, bbox.yMin / scale);
 
-      const double gxoff = glyph.get_x_offset();
-      const double gyoff = glyph.get_y_offset();
+      const double gxoff = shaped.x_offset;
+      const double gyoff = shaped.y_offset;
 
       left = std::min(left,
                       advance_x + gxoff + bbox.xMin / scale);
@@ -424,16 +446,49 @@ FreetypeRenderer::ShapeResults::ShapeResults(
                         advance_y + gyoff + bbox.yMin / scale);
     }
 
-    advance_x += glyph.get_x_advance() * params.spacing;
-    advance_y += glyph.get_y_advance() * params.spacing;
+    advance_x += shaped.x_advance * params.spacing;
+    advance_y += shaped.y_advance * params.spacing;
+  }
+
+  shaping->horizontal = HB_DIRECTION_IS_HORIZONTAL(hb_buffer_get_direction(hb_buf));
+  shaping->left = left;
+  shaping->right = right;
+  shaping->top = top;
+  shaping->bottom = bottom;
+  shaping->advance_x = advance_x;
+  shaping->advance_y = advance_y;
+  shaping->ascent = ascent;
+  shaping->descent = descent;
+
+  hb_buffer_destroy(hb_buf);
+  hb_font_destroy(hb_ft_font);
+
+  if (complete) GlyphCache::instance()->insertShaping(key, shaping);
+  return shaping;
+}
+
+FreetypeRenderer::ShapeResults::ShapeResults(
+  const FreetypeRenderer::Params& params)
+{
+  shaping = shape(params);
+  if (!shaping) {
+    return;
   }
 
+  left = shaping->left;
+  right = shaping->right;
+  top = shaping->top;
+  bottom = shaping->bottom;
+  advance_x = shaping->advance_x;
+  advance_y = shaping->advance_y;
+  ascent = shaping->ascent;
+  descent = shaping->descent;
+
   // Right and left start out reversed.  If any ink is ever
   // contributed they will flip.  If they're still reversed,
   // there was no ink.
   if (right >= left) {
-    if (HB_DIRECTION_IS_HORIZONTAL(
-          hb_buffer_get_direction(hb_buf))) {
+    if (shaping->horizontal) {
       calc_offsets_horiz(params);
     } else {
       calc_offsets_vert(params);
@@ -452,18 +507,6 @@ FreetypeRenderer::ShapeResults::ShapeResults(
   ok = true;
 }
 
-FreetypeRenderer::ShapeResults::~ShapeResults()
-{
-  if (hb_buf != nullptr) {
-    hb_buffer_destroy(hb_buf);
-    hb_buf = nullptr;
-  }
-  if (hb_ft_font != nullptr) {
-    hb_font_destroy(hb_ft_font);
-    hb_ft_font = nullptr;
-  }
-}
-
 FreetypeRenderer::FontMetrics::FontMetrics(
   const FreetypeRenderer::Params& params)
 {
@@ -542,6 +585,43 @@ FreetypeRenderer::TextMetrics::TextMetrics(
   ok = true;
 }
 
+shared_ptr<const GlyphCache::Outlines> FreetypeRenderer::get_outlines(const FreetypeRenderer::Params& params, unsigned int index) const
+{
+  const std::string key = params.font + '\x1f' + std::to_string(index) + '\x1f' + std::to_string(params.segments);
+  if (auto outlines = GlyphCache::instance()->getOutlines(key)) return outlines;
+
+  FT_Face face = params.get_font_face();
+  if (face == nullptr) {
+    return nullptr;
+  }
+
+  FT_Error error = FT_Load_Glyph(face, index, FT_LOAD_DEFAULT);
+  if (error) {
+    return nullptr;
+  }
+  FT_Glyph glyph;
+  error = FT_Get_Glyph(face->glyph, &glyph);
+  if (error) {
+    return nullptr;
+  }
+
+  DrawingCallback callback(params.segments, 1.0);
+  callback.start_glyph();
+  FT_Outline outline = reinterpret_cast<FT_OutlineGlyph>(glyph)->outline;
+  FT_Outline_Decompose(&outline, &funcs, &callback);
+  callback.finish_glyph();
+  FT_Done_Glyph(glyph);
+
+  auto outlines = std::make_shared<GlyphCache::Outlines>();
+  for (const auto *geom : callback.get_result()) {
+    const auto *poly = static_cast<const Polygon2d *>(geom);
+    outlines->insert(outlines->end(), poly->outlines().begin(), poly->outlines().end());
+    delete poly;
+  }
+  GlyphCache::instance()->insertOutlines(key, outlines);
+  return outlines;
+}
+
 std::vector<const Geometry *> FreetypeRenderer::render(const FreetypeRenderer::Params& params) const
 {
   ShapeResults sr(params);
@@ -550,20 +630,39 @@ std::vector<const Geometry *> FreetypeRenderer::render(const FreetypeRenderer::P
     return {};
   }
 
-  DrawingCallback callback(params.segments, params.size);
-  for (const auto& glyph : sr.glyph_array) {
-    callback.start_glyph();
-    callback.set_glyph_offset(
-      sr.x_offset + glyph.get_x_offset(),
-      sr.y_offset + glyph.get_y_offset());
-    FT_Outline outline = reinterpret_cast<FT_OutlineGlyph>(glyph.get_glyph())->outline;
-    FT_Outline_Decompose(&outline, &funcs, &callback);
-
-    double adv_x = glyph.get_x_advance() * params.spacing;
-    double adv_y = glyph.get_y_advance() * params.spacing;
-    callback.add_glyph_advance(adv_x, adv_y);
-    callback.finish_glyph();
+  // The outlines are looked up in order, as the font face can't be shared
+  // between threads, and only their placement happens in parallel
+  struct PlacedGlyph {
+    shared_ptr<const GlyphCache::Outlines> outlines;
+    Vector2d position;
+  };
+  std::vector<PlacedGlyph> glyphs;
+  Vector2d advance(0, 0);
+  for (const auto& glyph : sr.shaping->glyphs) {
+    auto outlines = get_outlines(params, glyph.index);
+    if (outlines && !outlines->empty()) {
+      const Vector2d offset(sr.x_offset + glyph.x_offset, sr.y_offset + glyph.y_offset);
+      glyphs.push_back({std::move(outlines), offset + advance});
+    }
+
+    advance += Vector2d(glyph.x_advance * params.spacing, glyph.y_advance * params.spacing);
   }
 
-  return callback.get_result();
+  // Places the unit size outlines of each glyph like DrawingCallback does
+  std::vector<const Geometry *> result(glyphs.size());
+  parallelizable_transform(glyphs.begin(), glyphs.end(), result.begin(), [&params](const PlacedGlyph& glyph) {
+    auto *polygon = new Polygon2d();
+    polygon->setSanitized(true);
+    for (const auto& unit_outline : *glyph.outlines) {
+      Outline2d outline;
+      outline.vertices.reserve(unit_outline.vertices.size());
+      for (const auto& v : unit_outline.vertices) {
+        outline.vertices.push_back(params.size * (v + glyph.position));
+      }
+      polygon->addOutline(std::move(outline));
+    }
+    return static_cast<const Geometry *>(polygon);
+  });
+
+  return result;
 }
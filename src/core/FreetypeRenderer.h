@@ -30,6 +30,7 @@
 #include <ostream>
 
 #include "Parameters.h"
+#include "GlyphCache.h"
 #include <hb.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
@@ -161,27 +162,6 @@ private:
   const static double scale;
   FT_Outline_Funcs funcs;
 
-  // The GlyphData assumes responsibility for "glyph" and will ensure
-  // that it is freed when the GlyphData is destroyed.
-  // However, glyph_pos points to data that the caller must ensure
-  // remains valid until the GlyphData is destroyed.
-  class GlyphData
-  {
-public:
-    GlyphData(FT_Glyph glyph, unsigned int idx, hb_glyph_position_t *glyph_pos) : glyph(glyph), idx(idx), glyph_pos(glyph_pos) {}
-    [[nodiscard]] unsigned int get_idx() const { return idx; }
-    [[nodiscard]] FT_Glyph get_glyph() const { return glyph; }
-    [[nodiscard]] double get_x_offset() const { return glyph_pos->x_offset / scale; }
-    [[nodiscard]] double get_y_offset() const { return glyph_pos->y_offset / scale; }
-    [[nodiscard]] double get_x_advance() const { return glyph_pos->x_advance / scale; }
-    [[nodiscard]] double get_y_advance() const { return glyph_pos->y_advance / scale; }
-    ~GlyphData() { FT_Done_Glyph(glyph); }
-private:
-    FT_Glyph glyph;
-    unsigned int idx;
-    hb_glyph_position_t *glyph_pos;
-  };
-
   class ShapeResults
   {
 public:
@@ -190,7 +170,7 @@ public:
     // They have been downscaled from the 1e+5 unit size used for
     // when rendering from Freetype, and have not yet been scaled
     // back up to the desired font size.
-    std::vector<GlyphData> glyph_array;
+    shared_ptr<const GlyphCache::Shaping> shaping;
     double x_offset;
     double y_offset;
     double left;
@@ -202,14 +182,15 @@ public:
     double ascent;
     double descent;
     ShapeResults(const FreetypeRenderer::Params& params);
-    virtual ~ShapeResults();
 private:
+    static shared_ptr<const GlyphCache::Shaping> shape(const FreetypeRenderer::Params& params);
     void calc_offsets_horiz(const FreetypeRenderer::Params& params);
     void calc_offsets_vert(const FreetypeRenderer::Params& params);
-    hb_font_t *hb_ft_font{nullptr};
-    hb_buffer_t *hb_buf{nullptr};
   };
 
+  // Flattened outlines of a glyph at unit size, from the glyph cache if possible
+  [[nodiscard]] shared_ptr<const GlyphCache::Outlines> get_outlines(const FreetypeRenderer::Params& params, unsigned int index) const;
+
   static int outline_move_to_func(const FT_Vector *to, void *user);
   static int outline_line_to_func(const FT_Vector *to, void *user);
   static int outline_conic_to_func(const FT_Vector *c1, const FT_Vector *to, void *user);
@@ -0,0 +1,158 @@
+#include "FunctionCache.h"
+#include "Context.h"
+#include "Feature.h"
+#include "printutils.h"
+
+#include <cstdint>
+#include <cstring>
+#include <boost/functional/hash.hpp>
+
+FunctionCache *FunctionCache::inst = nullptr;
+
+static uint64_t doubleBits(double d)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &d, sizeof(bits));
+  return bits;
+}
+
+/*!
+   Hashes value into seed. Returns false for values which can't be
+   compared cheaply (functions, objects), calls with those aren't memoized.
+ */
+bool FunctionCache::hashValue(const Value& value, size_t& seed)
+{
+  boost::hash_combine(seed, static_cast<int>(value.type()));
+  switch (value.type()) {
+  case Value::Type::UNDEFINED:
+    return true;
+  case Value::Type::BOOL:
+    boost::hash_combine(seed, value.toBool());
+    return true;
+  case Value::Type::NUMBER:
+    boost::hash_combine(seed, doubleBits(value.toDouble()));
+    return true;
+  case Value::Type::STRING:
+    boost::hash_combine(seed, value.toStrUtf8Wrapper().toString());
+    return true;
+  case Value::Type::VECTOR:
+    for (const auto& element : value.toVector()) {
+      if (!hashValue(element, seed)) return false;
+    }
+    return true;
+  case Value::Type::RANGE: {
+    const auto& range = value.toRange();
+    boost::hash_combine(seed, doubleBits(range.begin_value()));
+    boost::hash_combine(seed, doubleBits(range.step_value()));
+    boost::hash_combine(seed, doubleBits(range.end_value()));
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+// Exact comparison, unlike Value::operator== 0 and -0 differ and NaN equals itself
+bool FunctionCache::identical(const Value& a, const Value& b)
+{
+  if (a.type() != b.type()) return false;
+  switch (a.type()) {
+  case Value::Type::UNDEFINED:
+    return true;
+  case Value::Type::BOOL:
+    return a.toBool() == b.toBool();
+  case Value::Type::NUMBER:
+    return doubleBits(a.toDouble()) == doubleBits(b.toDouble());
+  case Value::Type::STRING:
+    return a.toStrUtf8Wrapper().toString() == b.toStrUtf8Wrapper().toString();
+  case Value::Type::VECTOR: {
+    const auto& va = a.toVector();
+    const auto& vb = b.toVector();
+    if (va.size() != vb.size()) return false;
+    for (size_t i = 0; i < va.size(); ++i) {
+      if (!identical(va[i], vb[i])) return false;
+    }
+    return true;
+  }
+  case Value::Type::RANGE: {
+    const auto& ra = a.toRange();
+    const auto& rb = b.toRange();
+    return doubleBits(ra.begin_value()) == doubleBits(rb.begin_value()) &&
+           doubleBits(ra.step_value()) == doubleBits(rb.step_value()) &&
+           doubleBits(ra.end_value()) == doubleBits(rb.end_value());
+  }
+  default:
+    return false;
+  }
+}
+
+// Rough memory footprint of value
+size_t FunctionCache::valueCost(const Value& value)
+{
+  size_t cost = sizeof(Value);
+  if (value.type() == Value::Type::STRING) {
+    cost += value.toStrUtf8Wrapper().toString().size();
+  } else if (value.type() == Value::Type::VECTOR) {
+    for (const auto& element : value.toVector()) cost += valueCost(element);
+  }
+  return cost;
+}
+
+boost::optional<FunctionCache::Call> FunctionCache::makeCall(const Expression *function, std::shared_ptr<const Context> context, std::vector<Value> arguments) const
+{
+  if (!Feature::ExperimentalMemoize.is_enabled() || this->impure_functions.count(function)) return boost::none;
+  size_t hash = 0;
+  boost::hash_combine(hash, function);
+  boost::hash_combine(hash, context.get());
+  for (const auto& argument : arguments) {
+    if (!hashValue(argument, hash)) return boost::none;
+  }
+  return Call{function, std::move(context), std::move(arguments), hash};
+}
+
+boost::optional<Value> FunctionCache::get(const Call& call)
+{
+  const cache_entry *entry = this->cache[call.hash];
+  if (!entry || entry->call.function != call.function || entry->call.context != call.context ||
+      entry->call.arguments.size() != call.arguments.size()) {
+    return boost::none;
+  }
+  for (size_t i = 0; i < call.arguments.size(); ++i) {
+    if (!identical(entry->call.arguments[i], call.arguments[i])) return boost::none;
+  }
+  this->numhits++;
+  return entry->result.clone();
+}
+
+void FunctionCache::insert(Call&& call, size_t mark, const Value& result)
+{
+  if (sideEffects() != mark) {
+    this->impure_functions.insert(call.function);
+    return;
+  }
+  size_t cost = sizeof(cache_entry) + valueCost(result);
+  for (const auto& argument : call.arguments) cost += valueCost(argument);
+  const size_t hash = call.hash;
+  this->cache.insert(hash, new cache_entry{std::move(call), result.clone()}, cost);
+  this->peak_entries = std::max(this->peak_entries, this->cache.size());
+  this->peak_cost = std::max(this->peak_cost, this->cache.totalCost());
+}
+
+size_t FunctionCache::sideEffects() const
+{
+  return this->side_effects + print_message_count;
+}
+
+void FunctionCache::clear()
+{
+  this->cache.clear();
+  this->impure_functions.clear();
+}
+
+void FunctionCache::print()
+{
+  if (!Feature::ExperimentalMemoize.is_enabled()) return;
+  LOG("Function results in cache: %1$d", this->peak_entries);
+  LOG("Function cache size in bytes: %1$d", this->peak_cost);
+  LOG("Function cache hits: %1$d", this->numhits);
+}
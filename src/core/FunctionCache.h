@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include <boost/optional.hpp>
+#include "Cache.h"
+#include "Value.h"
+
+class Context;
+class Expression;
+
+/*!
+   Memoizes results of user-defined functions and function literals.
+
+   A call is identified by the function body, the context the function was
+   defined in and its parameter values. Results are only stored if the call
+   had no side effects and didn't read anything not covered by that key: no
+   $-variable was looked up, nothing was printed (echo, warnings) and no
+   nondeterministic builtin like rands() was called. A function seen having
+   such side effects once isn't memoized anymore.
+
+   Entries hold on to the defining context, so the cache is emptied when the
+   evaluation session ends. Enabled by the memoize feature.
+ */
+class FunctionCache
+{
+public:
+  struct Call {
+    const Expression *function;
+    std::shared_ptr<const Context> context;
+    std::vector<Value> arguments;
+    size_t hash;
+  };
+
+  FunctionCache(size_t memorylimit = 32ul * 1024ul * 1024ul) : cache(memorylimit) {}
+
+  static FunctionCache *instance() { if (!inst) inst = new FunctionCache; return inst; }
+
+  // Returns boost::none if function isn't memoized or an argument can't be hashed
+  boost::optional<Call> makeCall(const Expression *function, std::shared_ptr<const Context> context, std::vector<Value> arguments) const;
+  boost::optional<Value> get(const Call& call);
+  // Stores the result of call, if there were no side effects since sideEffects() returned mark
+  void insert(Call&& call, size_t mark, const Value& result);
+
+  // Increasing count of side effects which prevent memoization of running calls
+  size_t sideEffects() const;
+  void addSideEffect() { ++this->side_effects; }
+
+  size_t size() const { return this->cache.size(); }
+  size_t totalCost() const { return this->cache.totalCost(); }
+  size_t maxSizeMB() const { return this->cache.maxCost() / (1024ul * 1024ul); }
+  void setMaxSizeMB(size_t limit) { this->cache.setMaxCost(limit * 1024ul * 1024ul); }
+  size_t hits() const { return this->numhits; }
+  size_t peakSize() const { return this->peak_entries; }
+  size_t peakCost() const { return this->peak_cost; }
+  void clear();
+  void resetStatistics() { this->numhits = this->peak_entries = this->peak_cost = 0; }
+  void print();
+
+  // Helpers for keys made of values, also used by ModuleCache
+  static bool hashValue(const Value& value, size_t& seed);
+  static bool identical(const Value& a, const Value& b);
+  static size_t valueCost(const Value& value);
+
+private:
+  static FunctionCache *inst;
+
+  struct cache_entry {
+    Call call;
+    Value result;
+  };
+
+  Cache<size_t, cache_entry> cache;
+  std::unordered_set<const Expression *> impure_functions;
+  size_t side_effects{0};
+  size_t numhits{0};
+  size_t peak_entries{0};
+  size_t peak_cost{0};
+};
@@ -5,6 +5,7 @@
 
 #include "Assignment.h"
 
+class Bytecode;
 class Context;
 class Expression;
 class Value;
@@ -12,8 +13,9 @@ class Value;
 class FunctionType
 {
 public:
-  FunctionType(std::shared_ptr<const Context> context, std::shared_ptr<Expression> expr, std::shared_ptr<AssignmentList> parameters)
-    : context(std::move(context)), expr(std::move(expr)), parameters(std::move(parameters)) { }
+  FunctionType(std::shared_ptr<const Context> context, std::shared_ptr<Expression> expr, std::shared_ptr<AssignmentList> parameters,
+               std::shared_ptr<const Bytecode> bytecode = nullptr)
+    : context(std::move(context)), expr(std::move(expr)), parameters(std::move(parameters)), bytecode(std::move(bytecode)) { }
   Value operator==(const FunctionType& other) const;
   Value operator!=(const FunctionType& other) const;
   Value operator<(const FunctionType& other) const;
@@ -24,10 +26,12 @@ public:
   [[nodiscard]] const std::shared_ptr<const Context>& getContext() const { return context; }
   [[nodiscard]] const std::shared_ptr<Expression>& getExpr() const { return expr; }
   [[nodiscard]] const std::shared_ptr<AssignmentList>& getParameters() const { return parameters; }
+  [[nodiscard]] const std::shared_ptr<const Bytecode>& getBytecode() const { return bytecode; }
 private:
   std::shared_ptr<const Context> context;
   std::shared_ptr<Expression> expr;
   std::shared_ptr<AssignmentList> parameters;
+  std::shared_ptr<const Bytecode> bytecode; // Compiled expr, if available
 };
 
 std::ostream& operator<<(std::ostream& stream, const FunctionType& f);
@@ -0,0 +1,72 @@
+#include "GlyphCache.h"
+#include "printutils.h"
+
+GlyphCache *GlyphCache::inst = nullptr;
+
+shared_ptr<const GlyphCache::Shaping> GlyphCache::getShaping(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  const auto entry = this->shapings[key];
+  if (!entry) return nullptr;
+  ++this->numhits;
+  return entry->value;
+}
+
+void GlyphCache::insertShaping(const std::string& key, const shared_ptr<const Shaping>& shaping)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  const size_t cost = key.size() + sizeof(Shaping) + shaping->glyphs.size() * sizeof(ShapedGlyph);
+  this->shapings.insert(key, new cache_entry<Shaping>(shaping), cost);
+}
+
+shared_ptr<const GlyphCache::Outlines> GlyphCache::getOutlines(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  const auto entry = this->outlines[key];
+  if (!entry) return nullptr;
+  ++this->numhits;
+  return entry->value;
+}
+
+void GlyphCache::insertOutlines(const std::string& key, const shared_ptr<const Outlines>& glyph)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  size_t cost = key.size() + sizeof(Outlines);
+  for (const auto& outline : *glyph) cost += sizeof(Outline2d) + outline.vertices.size() * sizeof(Vector2d);
+  this->outlines.insert(key, new cache_entry<Outlines>(glyph), cost);
+}
+
+size_t GlyphCache::size() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->shapings.size() + this->outlines.size();
+}
+
+size_t GlyphCache::totalCost() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->shapings.totalCost() + this->outlines.totalCost();
+}
+
+size_t GlyphCache::maxSizeMB() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return (this->shapings.maxCost() + this->outlines.maxCost()) / (1024ul * 1024ul);
+}
+
+void GlyphCache::clear()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->shapings.clear();
+  this->outlines.clear();
+}
+
+void GlyphCache::print()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  // Only of interest for designs using text()
+  if (this->shapings.empty() && this->numhits == 0) return;
+  LOG("Glyphs and shaped texts in cache: %1$d", this->shapings.size() + this->outlines.size());
+  LOG("Glyph cache size in bytes: %1$d", this->shapings.totalCost() + this->outlines.totalCost());
+  LOG("Glyph cache hits: %1$d", this->numhits);
+}
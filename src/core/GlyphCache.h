@@ -0,0 +1,78 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Cache.h"
+#include "memory.h"
+#include "Polygon2d.h"
+
+/*!
+   Caches the results of text() rendering which only depend on the font and a
+   few parameters, so repeated text doesn't go through FreeType and HarfBuzz.
+
+   Shapings hold the glyphs and metrics HarfBuzz found for a string, keyed by
+   the text, font and the layout parameters. Outlines hold the flattened
+   outline of one glyph at unit size, keyed by font, glyph index and the
+   number of curve segments. As FreeType works at a fixed size, the text size
+   only scales the outlines and isn't part of either key.
+ */
+class GlyphCache
+{
+public:
+  // Shaped glyph, with positions in fractions of the text size
+  struct ShapedGlyph {
+    unsigned int index;
+    double x_offset;
+    double y_offset;
+    double x_advance;
+    double y_advance;
+  };
+
+  // Metrics in fractions of the text size, before applying halign/valign
+  struct Shaping {
+    std::vector<ShapedGlyph> glyphs;
+    bool horizontal;
+    double left;
+    double right;
+    double top;
+    double bottom;
+    double advance_x;
+    double advance_y;
+    double ascent;
+    double descent;
+  };
+
+  using Outlines = std::vector<Outline2d>;
+
+  GlyphCache(size_t memorylimit = 16ul * 1024ul * 1024ul) : shapings(memorylimit / 4), outlines(memorylimit) {}
+
+  static GlyphCache *instance() { if (!inst) inst = new GlyphCache; return inst; }
+
+  shared_ptr<const Shaping> getShaping(const std::string& key);
+  void insertShaping(const std::string& key, const shared_ptr<const Shaping>& shaping);
+  shared_ptr<const Outlines> getOutlines(const std::string& key);
+  void insertOutlines(const std::string& key, const shared_ptr<const Outlines>& glyph);
+
+  size_t size() const;
+  size_t totalCost() const;
+  size_t maxSizeMB() const;
+  size_t hits() const { std::lock_guard<std::mutex> lock(this->mutex); return this->numhits; }
+  void clear();
+  void print();
+
+private:
+  static GlyphCache *inst;
+
+  template <typename T>
+  struct cache_entry {
+    shared_ptr<const T> value;
+    cache_entry(const shared_ptr<const T>& value) : value(value) {}
+  };
+
+  Cache<std::string, cache_entry<Shaping>> shapings;
+  Cache<std::string, cache_entry<Outlines>> outlines;
+  size_t numhits{0};
+  // Guards the caches, text() may be rendered from several evaluation threads
+  mutable std::mutex mutex;
+};
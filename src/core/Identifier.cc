@@ -0,0 +1,92 @@
+#include "Identifier.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace {
+
+/*!
+   Names are never removed, so their strings keep their addresses. Each thread
+   remembers the names it has seen, so looking them up again takes no lock.
+   Other names go to a shard of the table chosen by their hash, each with a
+   lock of its own, so concurrent parsers and evaluations rarely wait for
+   each other.
+ */
+class SymbolTable
+{
+public:
+  using Symbol = std::pair<const std::string *, unsigned>;
+
+  Symbol intern(const std::string& name) {
+    auto& known = seen();
+    const auto memo = known.find(name);
+    if (memo != known.end()) return memo->second;
+    auto& shard = shards[std::hash<std::string>{}(name) % shards.size()];
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto [it, inserted] = shard.ids.emplace(name, 0);
+    if (inserted) it->second = next_id.fetch_add(1, std::memory_order_relaxed);
+    const Symbol symbol{&it->first, it->second};
+    lock.unlock();
+    known.emplace(name, symbol);
+    return symbol;
+  }
+
+  boost::optional<Symbol> find(const std::string& name) {
+    auto& known = seen();
+    const auto memo = known.find(name);
+    if (memo != known.end()) return memo->second;
+    auto& shard = shards[std::hash<std::string>{}(name) % shards.size()];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    const auto it = shard.ids.find(name);
+    if (it == shard.ids.end()) return boost::none;
+    const Symbol symbol{&it->first, it->second};
+    lock.unlock();
+    known.emplace(name, symbol);
+    return symbol;
+  }
+
+private:
+  // What a thread has seen stays valid, as names are never removed
+  static std::unordered_map<std::string, Symbol>& seen() {
+    thread_local std::unordered_map<std::string, Symbol> known;
+    return known;
+  }
+
+  struct Shard {
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, unsigned> ids;
+  };
+  std::array<Shard, 64> shards;
+  std::atomic<unsigned> next_id{0};
+};
+
+SymbolTable& symbols()
+{
+  static SymbolTable table;
+  return table;
+}
+
+} // namespace
+
+Identifier::Identifier(const std::string *name, unsigned id) :
+  name(name), id(id), config_variable(is_config_variable(*name))
+{
+}
+
+Identifier::Identifier(const std::string& name)
+{
+  const auto symbol = symbols().intern(name);
+  this->name = symbol.first;
+  this->id = symbol.second;
+  this->config_variable = is_config_variable(name);
+}
+
+boost::optional<Identifier> Identifier::find(const std::string& name)
+{
+  const auto symbol = symbols().find(name);
+  if (!symbol) return boost::none;
+  return Identifier(symbol->first, symbol->second);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <boost/optional.hpp>
+
+/*!
+   A name interned into the global symbol table when it is parsed, or when
+   builtins and variables are registered. Identifiers of the same name share
+   the interned string and compare, hash and index frames by their integer id.
+ */
+class Identifier
+{
+public:
+  Identifier(const std::string& name);
+
+  const std::string& getName() const { return *name; }
+  unsigned getId() const { return id; }
+  // $-variables are looked up dynamically on the special variable stack
+  bool isConfigVariable() const { return config_variable; }
+
+  bool operator==(const Identifier& other) const { return id == other.id; }
+  bool operator!=(const Identifier& other) const { return id != other.id; }
+
+  // The identifier of a name if it was interned, without interning it; names
+  // which never were can't be defined anywhere
+  static boost::optional<Identifier> find(const std::string& name);
+
+  static bool is_config_variable(const std::string& name) {
+    return name[0] == '$' && name != "$children";
+  }
+
+private:
+  Identifier(const std::string *name, unsigned id);
+
+  const std::string *name;
+  unsigned id;
+  bool config_variable;
+};
+
+template <>
+struct std::hash<Identifier> {
+  size_t operator()(const Identifier& identifier) const { return identifier.getId(); }
+};
@@ -0,0 +1,72 @@
+#include "ImportCache.h"
+#include "StatCache.h"
+#include "boost-utils.h"
+#include "printutils.h"
+
+#include <ctime>
+
+ImportCache *ImportCache::inst = nullptr;
+
+std::string ImportCache::key(const std::string& filename, const std::string& parameters)
+{
+  boost::system::error_code ec;
+  const fs::path path = fs::absolute(filename, ec);
+  if (ec) return {};
+  struct stat st;
+  if (StatCache::stat(path.string(), st) != 0 || !S_ISREG(st.st_mode)) return {};
+  const auto size = st.st_size;
+  const std::time_t mtime = st.st_mtime;
+  // The modification time has a resolution of seconds, so a file changed
+  // less than two seconds ago may still change without a new time.
+  if (std::time(nullptr) - mtime < 2) return {};
+  return path.generic_string() + "\n" + std::to_string(size) + "\n" + std::to_string(mtime) + "\n" + parameters;
+}
+
+shared_ptr<const Geometry> ImportCache::get(const std::string& key)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  const auto entry = this->cache[key];
+  if (!entry) return nullptr;
+  ++this->numhits;
+  return entry->geom;
+}
+
+void ImportCache::insert(const std::string& key, const shared_ptr<const Geometry>& geom)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->cache.insert(key, new cache_entry(geom), key.size() + geom->memsize());
+}
+
+size_t ImportCache::size() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->cache.size();
+}
+
+size_t ImportCache::totalCost() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->cache.totalCost();
+}
+
+size_t ImportCache::maxSizeMB() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->cache.maxCost() / (1024ul * 1024ul);
+}
+
+void ImportCache::clear()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->cache.clear();
+}
+
+void ImportCache::print()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  // Only of interest for designs importing files
+  if (this->cache.empty() && this->numhits == 0) return;
+  LOG("Imported files in cache: %1$d", this->cache.size());
+  LOG("Import cache size in bytes: %1$d", this->cache.totalCost());
+  LOG("Import cache hits: %1$d", this->numhits);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include "Cache.h"
+#include "memory.h"
+#include "Geometry.h"
+
+/*!
+   Caches the geometry parsed from imported files, so a file imported several
+   times, e.g. under different transformations, is read once. Entries are
+   keyed by the absolute path, the size and modification time of the file,
+   and the import parameters affecting the result. They are independent of
+   the node tree, so they are reused across recompiles until the file changes.
+ */
+class ImportCache
+{
+public:
+  ImportCache(size_t memorylimit = 100ul * 1024ul * 1024ul) : cache(memorylimit) {}
+
+  static ImportCache *instance() { if (!inst) inst = new ImportCache; return inst; }
+
+  // The key for importing filename, empty if the file can't be cached (yet)
+  static std::string key(const std::string& filename, const std::string& parameters);
+
+  shared_ptr<const Geometry> get(const std::string& key);
+  void insert(const std::string& key, const shared_ptr<const Geometry>& geom);
+
+  size_t size() const;
+  size_t totalCost() const;
+  size_t maxSizeMB() const;
+  size_t hits() const { std::lock_guard<std::mutex> lock(this->mutex); return this->numhits; }
+  void clear();
+  void print();
+
+private:
+  static ImportCache *inst;
+
+  struct cache_entry {
+    shared_ptr<const Geometry> geom;
+    cache_entry(const shared_ptr<const Geometry>& geom) : geom(geom) {}
+  };
+
+  Cache<std::string, cache_entry> cache;
+  size_t numhits{0};
+  // Guards the cache, imports may be evaluated from several threads
+  mutable std::mutex mutex;
+};
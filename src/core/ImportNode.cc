@@ -26,6 +26,8 @@
 
 #include "io/import.h"
 #include "ImportNode.h"
+#include "ImportCache.h"
+#include "StatCache.h"
 
 #include "module.h"
 #include "ModuleInstantiation.h"
@@ -80,6 +82,7 @@ static std::shared_ptr<AbstractNode> do_import(const ModuleInstantiation *inst,
     filename = lookup_file(filename_val.isUndefined() ? "" : filename_val.toString(), inst->location().filePath().parent_path().string(), parameters.documentRoot());
   }
   if (!filename.empty()) handle_dep(filename);
+  parameters.session()->addExternalInput();
   ImportType actualtype = type;
   if (actualtype == ImportType::UNKNOWN) {
     std::string extraw = fs::path(filename).extension().generic_string();
@@ -92,6 +95,7 @@ static std::shared_ptr<AbstractNode> do_import(const ModuleInstantiation *inst,
     else if (ext == ".amf") actualtype = ImportType::AMF;
     else if (ext == ".svg") actualtype = ImportType::SVG;
     else if (ext == ".obj") actualtype = ImportType::OBJ;
+    else if (ext == ".geom") actualtype = ImportType::GEOM;
   }
 
   auto node = std::make_shared<ImportNode>(inst, actualtype);
@@ -168,6 +172,28 @@ static std::shared_ptr<AbstractNode> builtin_import_dxf(const ModuleInstantiatio
 
 
 
+/*!
+   The import parameters the parsed geometry depends on, which excludes
+   convexity as it is set on the result.
+ */
+static std::string cache_parameters(const ImportNode& node)
+{
+  std::ostringstream stream;
+  stream.precision(17);
+  stream << static_cast<int>(node.type);
+  if (node.type == ImportType::SVG || node.type == ImportType::DXF) {
+    stream << " " << node.id.value_or("") << " " << node.layer.value_or("")
+           << " " << node.fn << " " << node.fs << " " << node.fa;
+  }
+  if (node.type == ImportType::SVG) {
+    stream << " " << node.dpi << " " << node.center;
+  }
+  if (node.type == ImportType::DXF) {
+    stream << " " << node.origin_x << " " << node.origin_y << " " << node.scale;
+  }
+  return stream.str();
+}
+
 /*!
    Will return an empty geometry if the import failed, but not nullptr
  */
@@ -176,6 +202,15 @@ const Geometry *ImportNode::createGeometry() const
   Geometry *g = nullptr;
   auto loc = this->modinst->location();
 
+  const std::string key = ImportCache::key(this->filename, cache_parameters(*this));
+  if (!key.empty()) {
+    if (const auto cached = ImportCache::instance()->get(key)) {
+      g = cached->copy();
+      g->setConvexity(this->convexity);
+      return g;
+    }
+  }
+
   switch (this->type) {
   case ImportType::STL: {
     g = import_stl(this->filename, loc);
@@ -197,13 +232,16 @@ const Geometry *ImportNode::createGeometry() const
     g = import_obj(this->filename, loc);
     break;
   }
+  case ImportType::GEOM: {
+    g = import_geom(this->filename, loc);
+    break;
+  }
   case ImportType::SVG: {
     g = import_svg(this->fn, this->fs, this->fa, this->filename, this->id, this->layer, this->dpi, this->center, loc);
     break;
   }
   case ImportType::DXF: {
-    DxfData dd(this->fn, this->fs, this->fa, this->filename, this->layer.value_or(""), this->origin_x, this->origin_y, this->scale);
-    g = dd.toPolygon2d();
+    g = DxfData::load(this->fn, this->fs, this->fa, this->filename, this->layer.value_or(""), this->origin_x, this->origin_y, this->scale)->toPolygon2d();
     break;
   }
 #ifdef ENABLE_CGAL
@@ -217,6 +255,8 @@ const Geometry *ImportNode::createGeometry() const
     g = new PolySet(3);
   }
 
+  // Failed imports aren't kept, so their errors are reported again
+  if (g && !key.empty() && !g->isEmpty()) ImportCache::instance()->insert(key, shared_ptr<const Geometry>(g->copy()));
   if (g) g->setConvexity(this->convexity);
   return g;
 }
@@ -242,7 +282,7 @@ std::string ImportNode::toString() const
   stream << ", scale = " << this->scale
          << ", convexity = " << this->convexity
          << ", $fn = " << this->fn << ", $fa = " << this->fa << ", $fs = " << this->fs
-         << ", timestamp = " << (fs::exists(path) ? fs::last_write_time(path) : 0)
+         << ", timestamp = " << StatCache::mtime(path.string())
          << ")";
 
   return stream.str();
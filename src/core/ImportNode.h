@@ -15,6 +15,7 @@ enum class ImportType {
   DXF,
   NEF3,
   OBJ,
+  GEOM,
 };
 
 class ImportNode : public LeafNode
@@ -0,0 +1,122 @@
+#include "InstantiationCache.h"
+#include "Context.h"
+#include "EvaluationSession.h"
+#include "LocalScope.h"
+#include "ModuleInstantiation.h"
+#include "node.h"
+#include "printutils.h"
+
+#include <algorithm>
+
+namespace {
+
+/*!
+   Copies value without references to the evaluation session, so it can be
+   kept for later evaluations. Returns false for functions and objects, which
+   hold on to contexts and can't be compared across sessions.
+ */
+bool detach(const Value& value, Value& result)
+{
+  switch (value.type()) {
+  case Value::Type::VECTOR: {
+    VectorType vec(nullptr);
+    for (const auto& element : value.toVector()) {
+      Value copy = Value::undefined.clone();
+      if (!detach(element, copy)) return false;
+      vec.emplace_back(std::move(copy));
+    }
+    result = std::move(vec);
+    return true;
+  }
+  case Value::Type::FUNCTION:
+  case Value::Type::OBJECT:
+    return false;
+  default:
+    result = value.clone();
+    return true;
+  }
+}
+
+size_t maxIndex(const AbstractNode& node)
+{
+  size_t result = node.index();
+  for (const auto& child : node.children) result = std::max(result, maxIndex(*child));
+  return result;
+}
+
+} // namespace
+
+void DependencyRecorder::lookup(const ContextFrame *frame, const std::string& name, const Value& value)
+{
+  if (this->outer) this->outer->lookup(frame, name, value);
+  if (!this->frames.count(frame)) return;
+  if (!this->names.insert(name).second) return;
+  Value copy = Value::undefined.clone();
+  if (detach(value, copy)) {
+    this->lookups.emplace_back(name, std::move(copy));
+    this->sources.push_back(frame);
+  } else {
+    this->external_input = true;
+  }
+}
+
+RecordingScope::RecordingScope(EvaluationSession *session, DependencyRecorder *recorder) :
+  session(session), previous(session->dependencyRecorder())
+{
+  recorder->outer = this->previous;
+  session->setDependencyRecorder(recorder);
+}
+
+RecordingScope::~RecordingScope()
+{
+  session->setDependencyRecorder(previous);
+}
+
+bool InstantiationCache::unchanged(const Entry& entry, const Context& context) const
+{
+  for (const auto& lookup : entry.lookups) {
+    auto value = context.try_lookup_variable(lookup.first);
+    if (!value || value->type() != lookup.second.type() || !(*value == lookup.second).toBool()) return false;
+  }
+  return true;
+}
+
+void InstantiationCache::instantiateModules(const LocalScope& scope, const std::shared_ptr<const Context>& context, const std::shared_ptr<AbstractNode>& target)
+{
+  size_t reused = 0;
+  this->entries.resize(scope.moduleInstantiations.size());
+  // Reused nodes may still be part of the previous tree, e.g. one being exported
+  // concurrently, so they keep their indices and new nodes are numbered after them
+  size_t end = 0;
+  for (const auto& entry : this->entries) {
+    if (entry.valid && entry.node) end = std::max(end, maxIndex(*entry.node) + 1);
+  }
+  AbstractNode::reserveIndicesBelow(end);
+  for (size_t i = 0; i < scope.moduleInstantiations.size(); ++i) {
+    auto& entry = this->entries[i];
+    std::shared_ptr<AbstractNode> node;
+    if (entry.valid && unchanged(entry, *context)) {
+      node = entry.node;
+      ++reused;
+    } else {
+      entry = Entry();
+      DependencyRecorder recorder;
+      for (const Context *frame = context.get(); frame; frame = frame->getParent().get()) {
+        recorder.frames.insert(frame);
+      }
+      const size_t messages = print_message_count;
+      {
+        RecordingScope recording(context->session(), &recorder);
+        node = scope.moduleInstantiations[i]->evaluate(context);
+      }
+      if (!recorder.external_input && print_message_count == messages) {
+        entry.valid = true;
+        entry.node = node;
+        entry.lookups = std::move(recorder.lookups);
+      }
+    }
+    if (node) target->children.push_back(node);
+  }
+  this->numhits += reused;
+  PRINTDB("Reused %d of %d top-level instantiations", reused % scope.moduleInstantiations.size());
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "Value.h"
+
+class AbstractNode;
+class Context;
+class ContextFrame;
+class EvaluationSession;
+class LocalScope;
+
+/*!
+   Collects the values an instantiation read from frames outside of its own
+   subtree, i.e. the top-level variables and the builtin context.
+ */
+struct DependencyRecorder
+{
+  std::unordered_set<const ContextFrame *> frames;
+  std::vector<std::pair<std::string, Value>> lookups;
+  std::vector<const ContextFrame *> sources; // The frame of each lookup
+  std::unordered_set<std::string> names;
+  // Files or random numbers were read, which aren't covered by lookups
+  bool external_input{false};
+  // Recorder of an enclosing instantiation, which receives all lookups too
+  DependencyRecorder *outer{nullptr};
+
+  void lookup(const ContextFrame *frame, const std::string& name, const Value& value);
+};
+
+// Installs a recorder in the session for the lifetime of this object
+class RecordingScope
+{
+public:
+  RecordingScope(EvaluationSession *session, DependencyRecorder *recorder);
+  ~RecordingScope();
+  RecordingScope(const RecordingScope&) = delete;
+  RecordingScope& operator=(const RecordingScope&) = delete;
+
+private:
+  EvaluationSession *session;
+  DependencyRecorder *previous;
+};
+
+/*!
+   Reuses the nodes of top-level module instantiations between evaluations of
+   the same AST, e.g. while only customizer parameters change.
+
+   A top-level instantiation is evaluated again only if one of the top-level
+   or builtin variables it looked up now has a different value. Instantiations
+   which printed messages or read external input are never reused, as their
+   results can't be reproduced from the recorded lookups.
+
+   The owner must clear the cache when used libraries change. Enabled by the
+   incremental-eval feature.
+ */
+class InstantiationCache
+{
+public:
+  // Like LocalScope::instantiateModules(), reusing nodes whose dependencies are unchanged
+  void instantiateModules(const LocalScope& scope, const std::shared_ptr<const Context>& context, const std::shared_ptr<AbstractNode>& target);
+  void clear() { this->entries.clear(); }
+  size_t hits() const { return this->numhits; }
+
+private:
+  struct Entry {
+    bool valid{false};
+    std::shared_ptr<AbstractNode> node;
+    std::vector<std::pair<std::string, Value>> lookups;
+  };
+
+  bool unchanged(const Entry& entry, const Context& context) const;
+
+  std::vector<Entry> entries; // by index of the module instantiation
+  size_t numhits{0};
+};
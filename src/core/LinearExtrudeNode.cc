@@ -34,6 +34,7 @@
 #include "io/fileutils.h"
 #include "Builtins.h"
 #include "handle_dep.h"
+#include "StatCache.h"
 
 #include <cmath>
 #include <sstream>
@@ -86,6 +87,7 @@ static std::shared_ptr<AbstractNode> builtin_linear_extrude(const ModuleInstanti
     auto filename = lookup_file(parameters["file"].toString(), inst->location().filePath().parent_path().string(), parameters.documentRoot());
     node->filename = filename;
     handle_dep(filename);
+    parameters.session()->addExternalInput();
   }
 
   if (parameters["height"].isDefined()) {
@@ -146,7 +148,7 @@ std::string LinearExtrudeNode::toString() const
       "file = " << this->filename << ", "
       "layer = " << QuotedString(this->layername) << ", "
       "origin = [" << this->origin_x << ", " << this->origin_y << "], "
-           << "timestamp = " << (fs::exists(path) ? fs::last_write_time(path) : 0) << ", "
+           << "timestamp = " << StatCache::mtime(path.string()) << ", "
     ;
   }
   stream << "height = " << std::dec << this->height;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Assignment.h"
+#include "Identifier.h"
 #include <unordered_map>
 
 class AbstractNode;
@@ -24,9 +25,9 @@ public:
 
   // Modules and functions are stored twice; once for lookup and once for AST serialization
   // FIXME: Should we split this class into an ASTNode and a run-time support class?
-  std::unordered_map<std::string, shared_ptr<UserFunction>> functions;
+  std::unordered_map<Identifier, shared_ptr<UserFunction>> functions;
   std::vector<std::pair<std::string, shared_ptr<UserFunction>>> astFunctions;
 
-  std::unordered_map<std::string, shared_ptr<UserModule>> modules;
+  std::unordered_map<Identifier, shared_ptr<UserModule>> modules;
   std::vector<std::pair<std::string, shared_ptr<UserModule>>> astModules;
 };
@@ -0,0 +1,216 @@
+#include "MicroBenchmark.h"
+#include "BuiltinContext.h"
+#include "Context.h"
+#include "EvaluationSession.h"
+#include "Expression.h"
+#include "ScopeContext.h"
+#include "SourceFile.h"
+#include "openscad.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+#include <boost/format.hpp>
+
+namespace {
+
+std::atomic<size_t> allocations{0};
+
+void *counted_malloc(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+} // namespace
+
+// Counts heap allocations, which are reported per operation
+void *operator new(size_t size) { return counted_malloc(size); }
+void *operator new[](size_t size) { return counted_malloc(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+// Keeps the compiler from optimizing away a result
+const volatile void *sink;
+template <typename T> void keep(const T& value) { sink = &value; }
+
+struct Benchmark {
+  std::string name;
+  // Performs the given number of operations
+  std::function<void (size_t)> run;
+};
+
+void measure(const Benchmark& benchmark)
+{
+  const double min_ns = 2e8;
+  size_t n = 1;
+  while (true) {
+    const size_t start_allocations = allocations.load(std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    benchmark.run(n);
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    const size_t n_allocations = allocations.load(std::memory_order_relaxed) - start_allocations;
+    if (ns >= min_ns || n >= (size_t(1) << 30)) {
+      std::cout << boost::format("%-32s %12d %12.1f %12.2f\n")
+        % benchmark.name % n % (ns / n) % (static_cast<double>(n_allocations) / n);
+      return;
+    }
+    // Aim a bit above the minimum time, growing by at most 10x per round
+    const double factor = ns > 0 ? 1.2 * min_ns / ns : 10;
+    n = static_cast<size_t>(n * std::min(10.0, std::max(2.0, factor)));
+  }
+}
+
+Value number_vector(EvaluationSession *session, size_t size)
+{
+  VectorType vec(session);
+  vec.reserve(size);
+  for (size_t i = 0; i < size; ++i) vec.emplace_back(static_cast<double>(i));
+  return std::move(vec);
+}
+
+// Definitions for the expression benchmarks, each bench_<name> is evaluated as one operation
+const char *source = R"(
+table = [for (i = [0:99]) [i, i * i]];
+words = [for (i = [0:99]) str("w", i)];
+function add(a, b) = a + b;
+function fact(n) = n <= 1 ? 1 : n * fact(n - 1);
+function sum(v, i = 0) = i >= len(v) ? 0 : v[i] + sum(v, i + 1);
+
+bench_search = search(57, table);
+bench_search_strings = search(["w42", "w97"], words);
+bench_lookup = lookup(42.5, table);
+bench_comprehension = [for (i = [0:99]) if (i % 2 == 0) i * 2];
+bench_concat = concat(table, table);
+bench_let = let(a = 1, b = a + 1, c = b * 2) a + b + c;
+bench_call = add(1, 2);
+bench_recursion = fact(20);
+bench_sum = sum([for (i = [0:99]) i]);
+)";
+
+} // namespace
+
+namespace MicroBenchmark {
+
+int run(const std::string& filter)
+{
+  SourceFile *file = nullptr;
+  if (!parse(file, source, "<microbenchmark>", "<microbenchmark>", false) || !file) {
+    std::cerr << "Could not parse the benchmark definitions" << std::endl;
+    return 1;
+  }
+  std::unique_ptr<SourceFile> file_owner(file);
+
+  EvaluationSession session{"."};
+  ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
+  std::shared_ptr<const FileContext> file_context;
+  file->instantiate(*builtin_context, &file_context);
+  if (!file_context) {
+    std::cerr << "Could not evaluate the benchmark definitions" << std::endl;
+    return 1;
+  }
+
+  std::vector<Benchmark> benchmarks;
+
+  benchmarks.push_back({"value/number-arithmetic", [](size_t n) {
+    Value a(1.5), b(2.5);
+    for (size_t i = 0; i < n; ++i) {
+      Value c = a * b + a - b / a;
+      keep(c);
+    }
+  }});
+  benchmarks.push_back({"value/vector-construct-100", [&session](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      Value v = number_vector(&session, 100);
+      keep(v);
+    }
+  }});
+  benchmarks.push_back({"value/vector-arithmetic-3", [&session](size_t n) {
+    Value a = VectorType(&session, 1, 2, 3), b = VectorType(&session, 4, 5, 6);
+    for (size_t i = 0; i < n; ++i) {
+      Value c = a + b * Value(2.0);
+      keep(c);
+    }
+  }});
+  benchmarks.push_back({"value/vector-dot-100", [&session](size_t n) {
+    Value a = number_vector(&session, 100), b = number_vector(&session, 100);
+    for (size_t i = 0; i < n; ++i) {
+      Value c = a * b;
+      keep(c);
+    }
+  }});
+  // Concatenation by embedding, as done by concat() and list comprehensions
+  benchmarks.push_back({"value/vector-embed-10x10", [&session](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      VectorType vec(&session);
+      for (int j = 0; j < 10; ++j) vec.emplace_back(EmbeddedVectorType(number_vector(&session, 10).toVector().clone()));
+      Value v(std::move(vec));
+      keep(v);
+    }
+  }});
+  benchmarks.push_back({"value/vector-embed-iterate", [&session](size_t n) {
+    VectorType vec(&session);
+    for (int j = 0; j < 10; ++j) vec.emplace_back(EmbeddedVectorType(number_vector(&session, 10).toVector().clone()));
+    const Value v(std::move(vec));
+    for (size_t i = 0; i < n; ++i) {
+      double sum = 0;
+      for (const auto& element : v.toVector()) sum += element.toDouble();
+      keep(sum);
+    }
+  }});
+  benchmarks.push_back({"value/vector-embed-flatten", [&session](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      VectorType vec(&session);
+      for (int j = 0; j < 10; ++j) vec.emplace_back(EmbeddedVectorType(number_vector(&session, 10).toVector().clone()));
+      const Value v(std::move(vec));
+      keep(v.toVector()[50]); // indexing flattens
+    }
+  }});
+
+  for (int depth : {1, 8, 32}) {
+    benchmarks.push_back({"context/lookup-depth-" + std::to_string(depth), [&builtin_context, depth](size_t n) {
+      std::vector<ContextHandle<Context>> chain;
+      chain.reserve(depth);
+      chain.push_back(Context::create<Context>(*builtin_context));
+      chain.back()->set_variable("x0", Value(1.0));
+      for (int i = 1; i < depth; ++i) {
+        chain.push_back(Context::create<Context>(*chain.back()));
+        chain.back()->set_variable("x" + std::to_string(i), Value(1.0));
+      }
+      const auto& context = chain.back();
+      for (size_t i = 0; i < n; ++i) keep(context->lookup_variable("x0", Location::NONE));
+      while (!chain.empty()) chain.pop_back(); // Contexts are released in stack order
+    }});
+  }
+
+  for (const auto& assignment : file->scope.assignments) {
+    const std::string& name = assignment->getName();
+    if (name.compare(0, 6, "bench_") != 0) continue;
+    const auto expr = assignment->getExpr();
+    benchmarks.push_back({"eval/" + name.substr(6), [expr, &file_context](size_t n) {
+      for (size_t i = 0; i < n; ++i) {
+        Value v = expr->evaluate(file_context);
+        keep(v);
+      }
+    }});
+  }
+
+  std::cout << boost::format("%-32s %12s %12s %12s\n") % "Benchmark" % "Iterations" % "ns/op" % "allocs/op";
+  for (const auto& benchmark : benchmarks) {
+    if (filter.empty() || benchmark.name.find(filter) != std::string::npos) measure(benchmark);
+  }
+  return 0;
+}
+
+} // namespace MicroBenchmark
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+/*!
+   Times core evaluator operations in isolation: Value construction and
+   arithmetic, context lookups, builtin functions and the evaluation of
+   expressions. Each benchmark is repeated until it ran long enough for a
+   stable measurement, and is reported in nanoseconds and heap allocations
+   per operation.
+
+   Only built with -DENABLE_MICROBENCHMARKS=ON, as counting allocations
+   replaces the global operator new.
+ */
+namespace MicroBenchmark {
+
+// Runs the benchmarks whose name contains filter, all if it is empty
+int run(const std::string& filter);
+
+}
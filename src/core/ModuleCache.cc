@@ -0,0 +1,92 @@
+#include "ModuleCache.h"
+#include "Arguments.h"
+#include "EvaluationSession.h"
+#include "Feature.h"
+#include "FunctionCache.h"
+#include "InstantiationCache.h"
+#include "UserModule.h"
+#include "node.h"
+#include "printutils.h"
+
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+
+ModuleCache *ModuleCache::inst = nullptr;
+
+namespace {
+
+size_t nodeCost(const AbstractNode& node)
+{
+  size_t cost = sizeof(AbstractNode);
+  for (const auto& child : node.children) cost += nodeCost(*child);
+  return cost;
+}
+
+} // namespace
+
+boost::optional<ModuleCache::Call> ModuleCache::makeCall(const UserModule *module, std::shared_ptr<const Context> context, const Arguments& arguments) const
+{
+  if (!Feature::ExperimentalModuleCache.is_enabled()) return boost::none;
+  size_t hash = 0;
+  boost::hash_combine(hash, module);
+  boost::hash_combine(hash, context.get());
+  // parent_module() and $parent_modules see the calling modules
+  for (int i = 0; i < StaticModuleNameStack::size(); ++i) boost::hash_combine(hash, StaticModuleNameStack::at(i));
+  Call call{module, std::move(context), {}, 0};
+  call.arguments.reserve(arguments.size());
+  for (const auto& argument : arguments) {
+    boost::hash_combine(hash, argument.name.get_value_or(std::string()));
+    if (!FunctionCache::hashValue(argument.value, hash)) return boost::none;
+    call.arguments.emplace_back(argument.name, argument.value.clone());
+  }
+  call.hash = hash;
+  return call;
+}
+
+boost::optional<std::vector<std::shared_ptr<AbstractNode>>> ModuleCache::get(const Call& call, const EvaluationSession& session)
+{
+  const cache_entry *entry = this->cache[call.hash];
+  if (!entry || entry->call.module != call.module || entry->call.context != call.context ||
+      entry->call.arguments.size() != call.arguments.size()) {
+    return boost::none;
+  }
+  for (size_t i = 0; i < call.arguments.size(); ++i) {
+    if (entry->call.arguments[i].first != call.arguments[i].first ||
+        !FunctionCache::identical(entry->call.arguments[i].second, call.arguments[i].second)) {
+      return boost::none;
+    }
+  }
+  for (const auto& special : entry->specials) {
+    auto value = session.try_lookup_special_variable(special.first);
+    if (!value || !FunctionCache::identical(*value, special.second)) return boost::none;
+  }
+  if (auto recorder = session.dependencyRecorder()) {
+    for (const auto& lookup : entry->lookups) recorder->lookup(lookup.first, lookup.second.first, lookup.second.second);
+  }
+  this->numhits++;
+  return entry->children;
+}
+
+void ModuleCache::insert(Call&& call, DependencyRecorder&& recorder, const std::shared_ptr<AbstractNode>& node)
+{
+  if (recorder.external_input || !node) return;
+  auto entry = new cache_entry{std::move(call), {}, {}, node->children};
+  size_t cost = sizeof(cache_entry) + nodeCost(*node);
+  for (const auto& argument : entry->call.arguments) cost += FunctionCache::valueCost(argument.second);
+  for (size_t i = 0; i < recorder.lookups.size(); ++i) {
+    auto& lookup = recorder.lookups[i];
+    cost += FunctionCache::valueCost(lookup.second);
+    if (!lookup.first.empty() && lookup.first[0] == '$') entry->specials.push_back(std::move(lookup));
+    else entry->lookups.emplace_back(recorder.sources[i], std::move(lookup));
+  }
+  const size_t hash = entry->call.hash;
+  this->cache.insert(hash, entry, cost);
+  this->peak_cost = std::max(this->peak_cost, this->cache.totalCost());
+}
+
+void ModuleCache::print()
+{
+  if (!Feature::ExperimentalModuleCache.is_enabled()) return;
+  LOG("Module cache size in bytes: %1$d", this->peak_cost);
+  LOG("Module cache hits: %1$d", this->numhits);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/optional.hpp>
+#include "Cache.h"
+#include "Value.h"
+
+class AbstractNode;
+class Arguments;
+class Context;
+class ContextFrame;
+class EvaluationSession;
+class UserModule;
+struct DependencyRecorder;
+
+/*!
+   Shares the instantiated bodies of user module calls with identical
+   arguments, e.g. the same screw hole placed many times.
+
+   A call is identified by the module, the context it was defined in, the
+   names of the calling modules and its argument values. An entry is only
+   reused while the $-variables its body looked up from outside of the call
+   still have the same values. Calls with children, which are instantiated
+   in the caller's context, and calls which printed messages or read
+   external input aren't cached. Each call gets its own group node holding
+   the shared children, transforms are applied by the caller's nodes.
+
+   Entries hold on to the defining context, so the cache is emptied when the
+   evaluation session ends. Enabled by the module-cache feature.
+ */
+class ModuleCache
+{
+public:
+  struct Call {
+    const UserModule *module;
+    std::shared_ptr<const Context> context;
+    std::vector<std::pair<boost::optional<std::string>, Value>> arguments;
+    size_t hash;
+  };
+
+  ModuleCache(size_t memorylimit = 64ul * 1024ul * 1024ul) : cache(memorylimit) {}
+
+  static ModuleCache *instance() { if (!inst) inst = new ModuleCache; return inst; }
+
+  // Returns boost::none if the cache is disabled or an argument can't be hashed
+  boost::optional<Call> makeCall(const UserModule *module, std::shared_ptr<const Context> context, const Arguments& arguments) const;
+  // Returns the children of the cached instantiation of call, if it can be reused in session
+  boost::optional<std::vector<std::shared_ptr<AbstractNode>>> get(const Call& call, const EvaluationSession& session);
+  // Stores the instantiation of call, with the lookups recorded while instantiating it
+  void insert(Call&& call, DependencyRecorder&& recorder, const std::shared_ptr<AbstractNode>& node);
+
+  size_t size() const { return this->cache.size(); }
+  size_t hits() const { return this->numhits; }
+  size_t peakCost() const { return this->peak_cost; }
+  void clear() { this->cache.clear(); }
+  void resetStatistics() { this->numhits = this->peak_cost = 0; }
+  void print();
+
+private:
+  static ModuleCache *inst;
+
+  struct cache_entry {
+    Call call;
+    std::vector<std::pair<std::string, Value>> specials;
+    // Other lookups from outside the call, reported to enclosing recorders on reuse
+    std::vector<std::pair<const ContextFrame *, std::pair<std::string, Value>>> lookups;
+    std::vector<std::shared_ptr<AbstractNode>> children;
+  };
+
+  Cache<size_t, cache_entry> cache;
+  size_t numhits{0};
+  size_t peak_cost{0};
+};
@@ -8,7 +8,7 @@
 void ModuleInstantiation::print(std::ostream& stream, const std::string& indent, const bool inlined) const
 {
   if (!inlined) stream << indent;
-  stream << modname + "(";
+  stream << modname.getName() + "(";
   for (size_t i = 0; i < this->arguments.size(); ++i) {
     const auto& arg = this->arguments[i];
     if (i > 0) stream << ", ";
@@ -60,7 +60,7 @@ static void NOINLINE print_trace(const ModuleInstantiation *mod, const std::shar
 
 std::shared_ptr<AbstractNode> ModuleInstantiation::evaluate(const std::shared_ptr<const Context>& context) const
 {
-  boost::optional<InstantiableModule> module = context->lookup_module(this->name(), this->loc);
+  boost::optional<InstantiableModule> module = context->lookup_module(this->modname, this->loc);
   if (!module) {
     return nullptr;
   }
@@ -18,7 +18,7 @@ public:
   void print(std::ostream& stream, const std::string& indent) const override { print(stream, indent, false); }
   std::shared_ptr<AbstractNode> evaluate(const std::shared_ptr<const Context>& context) const;
 
-  const std::string& name() const { return this->modname; }
+  const std::string& name() const { return this->modname.getName(); }
   bool isBackground() const { return this->tag_background; }
   bool isHighlight() const { return this->tag_highlight; }
   bool isRoot() const { return this->tag_root; }
@@ -30,7 +30,7 @@ public:
   bool tag_highlight{false};
   bool tag_background{false};
 protected:
-  std::string modname;
+  Identifier modname;
 };
 
 class IfElseModuleInstantiation : public ModuleInstantiation
@@ -1,15 +1,24 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <cassert>
 #include "node.h"
 #include "printutils.h"
+#include "hash.h"
 
 /*!
    Caches string values per node based on the node.index().
    The node index guaranteed to be unique per node tree since the index is reset
    every time a new tree is generated.
+
+   In addition to the string, a 128-bit structural hash of each subtree
+   can be stored, which is used as a compact key into the geometry caches.
+
+   Id caches also record each subtree by node object, so a later dump of a
+   tree sharing those objects can copy their dumps and hashes, see NodeDumper.
  */
 
 class NodeCache
@@ -24,10 +33,11 @@ public:
            (long)this->rootString.size() >= result->second.second;
   }
 
-  std::string operator[](const AbstractNode& node) const {
+  // Valid until the cache is rebuilt
+  std::string_view operator[](const AbstractNode& node) const {
     // throws std::out_of_range on miss
     auto indexpair = this->cache.at(node.index());
-    return rootString.substr(indexpair.first, indexpair.second - indexpair.first);
+    return std::string_view(rootString).substr(indexpair.first, indexpair.second - indexpair.first);
   }
 
   void insertStart(const size_t nodeidx, const long startindex) {
@@ -45,16 +55,62 @@ public:
 #endif
   }
 
-  void setRootString(const std::string& rootString) {
-    this->rootString = rootString;
+  bool containsHash(const AbstractNode& node) const {
+    return this->hashes.find(node.index()) != this->hashes.end();
+  }
+
+  const Hash128& hash(const AbstractNode& node) const {
+    // throws std::out_of_range on miss
+    return this->hashes.at(node.index());
+  }
+
+  void insertHash(const size_t nodeidx, const Hash128& hash) {
+    this->hashes[nodeidx] = hash;
+  }
+
+  struct Subtree {
+    std::weak_ptr<const AbstractNode> node;
+    long start;
+    long end;
+    Hash128 hash;
+    bool background;
+    bool highlight;
+  };
+
+  void insertSubtree(const AbstractNode& node, Subtree subtree) {
+    this->subtrees[&node] = std::move(subtree);
+  }
+
+  void setSubtreeHash(const AbstractNode& node, const Hash128& hash) {
+    auto it = this->subtrees.find(&node);
+    if (it != this->subtrees.end()) it->second.hash = hash;
+  }
+
+  // The recorded subtree of this very node object, if it's still alive
+  const Subtree *subtree(const AbstractNode& node) const {
+    auto it = this->subtrees.find(&node);
+    if (it == this->subtrees.end() || it->second.node.lock().get() != &node) return nullptr;
+    return &it->second;
   }
 
+  [[nodiscard]] bool hasSubtrees() const { return !this->subtrees.empty(); }
+
+  void setRootString(std::string rootString) {
+    this->rootString = std::move(rootString);
+  }
+
+  const std::string& getRootString() const { return this->rootString; }
+
   void clear() {
     this->cache.clear();
+    this->hashes.clear();
+    this->subtrees.clear();
     this->rootString = "";
   }
 
 private:
   std::unordered_map<size_t, std::pair<long, long>> cache;
+  std::unordered_map<size_t, Hash128> hashes;
+  std::unordered_map<const AbstractNode *, Subtree> subtrees;
   std::string rootString;
 };
@@ -55,19 +55,148 @@ Response GroupNodeChecker::visit(State& state, const AbstractNode&)
 
 void NodeDumper::initCache()
 {
-  this->dumpstream.str("");
-  this->dumpstream.clear();
-  this->cache.clear();
+  if (!this->cache) return;
+  this->buffer.str("");
+  this->buffer.clear();
+  this->cache->clear();
+  this->openRanges.clear();
+  this->closedRanges.clear();
 }
 
 void NodeDumper::finalizeCache()
 {
-  this->cache.setRootString(this->dumpstream.str());
+  if (!this->cache) return;
+  this->cache->setRootString(this->buffer.str());
+  if (this->idString) this->computeHashes();
+  this->closedRanges.clear();
+}
+
+void NodeDumper::openNode(const State& state, const AbstractNode& node)
+{
+  if (!this->cache) return;
+  const long start = this->buffer.tellp();
+  this->cache->insertStart(node.index(), start);
+  this->openRanges.push_back(DumpRange{node.index(), start, -1L, {}, &node, state.isBackground(), state.isHighlight(), false, {}});
+}
+
+void NodeDumper::closeNode(const AbstractNode& node)
+{
+  if (!this->cache) return;
+  const long end = this->buffer.tellp();
+  this->cache->insertEnd(node.index(), end);
+  assert(!this->openRanges.empty() && this->openRanges.back().nodeidx == node.index());
+  this->closedRanges.push_back(std::move(this->openRanges.back()));
+  this->openRanges.pop_back();
+  auto& range = this->closedRanges.back();
+  range.end = end;
+  if (this->idString) {
+    this->cache->insertSubtree(node, {node.shared_from_this(), range.start, end, {}, range.background, range.highlight});
+  }
+  if (!this->openRanges.empty()) {
+    this->openRanges.back().children.push_back(this->closedRanges.size() - 1);
+  }
+}
+
+/*!
+   Computes a Merkle-style hash of each dumped subtree, bottom-up: The hash of a
+   node covers its own part of the dump, with the dump of each child replaced by
+   the hash of that child. The total cost is thus linear in the size of the dump,
+   and the resulting keys are independent of the subtree size.
+ */
+void NodeDumper::computeHashes()
+{
+  const std::string& dump = this->cache->getRootString();
+  std::vector<Hash128> hashes(this->closedRanges.size());
+  std::string buffer;
+  for (size_t i = 0; i < this->closedRanges.size(); ++i) {
+    const auto& range = this->closedRanges[i];
+    if (range.reused) {
+      hashes[i] = range.hash;
+      this->cache->insertHash(range.nodeidx, hashes[i]);
+      continue;
+    }
+    // A node contributing nothing but a single child (e.g. a group with one child)
+    // has the same id string as that child, so it gets the same hash as well.
+    if (range.children.size() == 1) {
+      const auto& child = this->closedRanges[range.children.front()];
+      if (child.start == range.start && child.end == range.end) {
+        hashes[i] = hashes[range.children.front()];
+        this->cache->insertHash(range.nodeidx, hashes[i]);
+        this->cache->setSubtreeHash(*range.node, hashes[i]);
+        continue;
+      }
+    }
+    buffer.clear();
+    long pos = range.start;
+    for (const auto childidx : range.children) {
+      const auto& child = this->closedRanges[childidx];
+      buffer.append(dump, pos, child.start - pos);
+      buffer.append(reinterpret_cast<const char *>(&hashes[childidx]), sizeof(Hash128));
+      pos = child.end;
+    }
+    buffer.append(dump, pos, range.end - pos);
+    hashes[i] = hash128(buffer.data(), buffer.size());
+    this->cache->insertHash(range.nodeidx, hashes[i]);
+    this->cache->setSubtreeHash(*range.node, hashes[i]);
+  }
+}
+
+/*!
+   Copies the dump of node from the previous id cache, if the node object is
+   shared with the previous tree (e.g. kept by incremental evaluation) and was
+   dumped with the same inherited modifiers. The descendants are indexed from
+   their recorded offsets, without dumping or hashing them again.
+ */
+bool NodeDumper::reuseSubtree(const State& state, const AbstractNode& node)
+{
+#ifdef IDPREFIX
+  return false; // Dumps contain the node indices
+#endif
+  if (!this->previous || this->openRanges.empty()) return false;
+  const auto prev = this->previous->subtree(node);
+  if (!prev || prev->background != state.isBackground() || prev->highlight != state.isHighlight()) return false;
+  std::vector<std::pair<const AbstractNode *, const NodeCache::Subtree *>> descendants;
+  if (!collectSubtrees(node, *prev, descendants)) return false;
+
+  const long offset = static_cast<long>(this->buffer.tellp()) - prev->start;
+  this->buffer.write(this->previous->getRootString().data() + prev->start, prev->end - prev->start);
+  for (const auto& descendant : descendants) {
+    auto subtree = *descendant.second;
+    subtree.start += offset;
+    subtree.end += offset;
+    this->cache->insertStart(descendant.first->index(), subtree.start);
+    this->cache->insertEnd(descendant.first->index(), subtree.end);
+    this->cache->insertHash(descendant.first->index(), subtree.hash);
+    this->cache->insertSubtree(*descendant.first, std::move(subtree));
+  }
+
+  const long start = prev->start + offset;
+  const long end = prev->end + offset;
+  this->cache->insertStart(node.index(), start);
+  this->cache->insertEnd(node.index(), end);
+  this->cache->insertSubtree(node, {prev->node, start, end, prev->hash, prev->background, prev->highlight});
+  this->closedRanges.push_back(DumpRange{node.index(), start, end, {}, &node, prev->background, prev->highlight, true, prev->hash});
+  this->openRanges.back().children.push_back(this->closedRanges.size() - 1);
+  this->reused = &node;
+  return true;
+}
+
+// Collects the recorded descendants of node, which must lie in the range of outer
+bool NodeDumper::collectSubtrees(const AbstractNode& node, const NodeCache::Subtree& outer,
+                                 std::vector<std::pair<const AbstractNode *, const NodeCache::Subtree *>>& result) const
+{
+  for (const auto& child : node.getChildren()) {
+    const auto subtree = this->previous->subtree(*child);
+    if (!subtree || subtree->start < outer.start || subtree->end > outer.end) return false;
+    result.emplace_back(child.get(), subtree);
+    if (!collectSubtrees(*child, outer, result)) return false;
+  }
+  return true;
 }
 
 bool NodeDumper::isCached(const AbstractNode& node) const
 {
-  return this->cache.contains(node);
+  return this->cache && this->cache->contains(node);
 }
 
 Response NodeDumper::visit(State& state, const GroupNode& node)
@@ -93,20 +222,25 @@ Response NodeDumper::visit(State& state, const GroupNode& node)
     this->dumpstream << "/*" << node.index() << "*/";
 #endif
 
+    if (this->root.get() != &node && this->reuseSubtree(state, node)) return Response::PruneTraversal;
     // insert start index
-    this->cache.insertStart(node.index(), this->dumpstream.tellp());
+    this->openNode(state, node);
 
     if (this->groupChecker.getChildCount(node.index()) > 1) {
       this->dumpstream << node << "{";
     }
     this->currindent++;
   } else if (state.isPostfix()) {
+    if (this->reused == &node) {
+      this->reused = nullptr;
+      return Response::ContinueTraversal;
+    }
     this->currindent--;
     if (this->groupChecker.getChildCount(node.index()) > 1) {
       this->dumpstream << "}";
     }
     // insert end index
-    this->cache.insertEnd(node.index(), this->dumpstream.tellp());
+    this->closeNode(node);
 
     // For handling root modifier '!'
     // Check if we are processing the root of the current Tree and finalize cache
@@ -143,13 +277,14 @@ Response NodeDumper::visit(State& state, const AbstractNode& node)
     this->dumpstream << "/*" << node.index() << "*/";
 #endif
 
+    if (this->root.get() != &node && this->reuseSubtree(state, node)) return Response::PruneTraversal;
     // insert start index
-    this->cache.insertStart(node.index(), this->dumpstream.tellp());
+    this->openNode(state, node);
 
     if (this->idString) {
 
       static const boost::regex re(R"([^\s\"]+|\"(?:[^\"\\]|\\.)*\")");
-      const auto name = STR(node);
+      const auto name = node.toIdString();
       boost::sregex_token_iterator it(name.begin(), name.end(), re, 0);
       std::copy(it, boost::sregex_token_iterator(), std::ostream_iterator<std::string>(this->dumpstream));
 
@@ -171,6 +306,10 @@ Response NodeDumper::visit(State& state, const AbstractNode& node)
     this->currindent++;
 
   } else if (state.isPostfix()) {
+    if (this->reused == &node) {
+      this->reused = nullptr;
+      return Response::ContinueTraversal;
+    }
 
     this->currindent--;
 
@@ -192,7 +331,7 @@ Response NodeDumper::visit(State& state, const AbstractNode& node)
     }
 
     // insert end index
-    this->cache.insertEnd(node.index(), this->dumpstream.tellp());
+    this->closeNode(node);
 
     // For handling root modifier '!'
     // Check if we are processing the root of the current Tree and finalize cache
@@ -214,12 +353,17 @@ Response NodeDumper::visit(State& state, const ListNode& node)
     if (this->root.get() == &node) {
       this->initCache();
     }
+    if (this->root.get() != &node && this->idString && this->reuseSubtree(state, node)) return Response::PruneTraversal;
+    this->openNode(state, node);
     // pass modifiers down to children via state
     if (node.modinst->isHighlight()) state.setHighlight(true);
     if (node.modinst->isBackground()) state.setBackground(true);
-    this->cache.insertStart(node.index(), this->dumpstream.tellp());
   } else if (state.isPostfix()) {
-    this->cache.insertEnd(node.index(), this->dumpstream.tellp());
+    if (this->reused == &node) {
+      this->reused = nullptr;
+      return Response::ContinueTraversal;
+    }
+    this->closeNode(node);
     // For handling root modifier '!'
     if (this->root.get() == &node) {
       this->finalizeCache();
@@ -238,9 +382,9 @@ Response NodeDumper::visit(State& state, const RootNode& node)
 
   if (state.isPrefix()) {
     this->initCache();
-    this->cache.insertStart(node.index(), this->dumpstream.tellp());
+    this->openNode(state, node);
   } else if (state.isPostfix()) {
-    this->cache.insertEnd(node.index(), this->dumpstream.tellp());
+    this->closeNode(node);
     this->finalizeCache();
   }
 
@@ -3,6 +3,7 @@
 #include <string>
 #include <unordered_map>
 #include <list>
+#include <vector>
 #include <utility>
 #include "NodeVisitor.h"
 #include "node.h"
@@ -32,12 +33,18 @@ private:
 class NodeDumper : public NodeVisitor
 {
 public:
-  NodeDumper(NodeCache& cache, std::shared_ptr<const AbstractNode> root_node, std::string indent, bool idString) :
-    cache(cache), indent(std::move(indent)), idString(idString), root(std::move(root_node)) {
+  // Id dumps copy the subtrees whose nodes are shared with the tree dumped into previous
+  NodeDumper(NodeCache& cache, std::shared_ptr<const AbstractNode> root_node, std::string indent, bool idString,
+             const NodeCache *previous = nullptr) :
+    cache(&cache), previous(idString ? previous : nullptr), indent(std::move(indent)), idString(idString),
+    root(std::move(root_node)), dumpstream(buffer) {
     if (idString) {
       groupChecker.traverse(*root);
     }
   }
+  // Writes the dump straight to out, without caching it
+  NodeDumper(std::ostream& out, std::shared_ptr<const AbstractNode> root_node, std::string indent) :
+    indent(std::move(indent)), idString(false), root(std::move(root_node)), dumpstream(out) {}
 
   Response visit(State& state, const AbstractNode& node) override;
   Response visit(State& state, const GroupNode& node) override;
@@ -48,8 +55,16 @@ private:
   void initCache();
   void finalizeCache();
   bool isCached(const AbstractNode& node) const;
+  void openNode(const State& state, const AbstractNode& node);
+  void closeNode(const AbstractNode& node);
+  void computeHashes();
+  bool reuseSubtree(const State& state, const AbstractNode& node);
+  bool collectSubtrees(const AbstractNode& node, const NodeCache::Subtree& outer,
+                       std::vector<std::pair<const AbstractNode *, const NodeCache::Subtree *>>& result) const;
 
-  NodeCache& cache;
+  NodeCache *cache{nullptr};
+  const NodeCache *previous{nullptr};
+  const AbstractNode *reused{nullptr}; // Copied from previous, until its postfix visit
   // Output Formatting options
   std::string indent;
   bool idString;
@@ -57,7 +72,23 @@ private:
   int currindent{0};
   std::shared_ptr<const AbstractNode> root;
   GroupNodeChecker groupChecker;
-  std::ostringstream dumpstream;
+  std::ostringstream buffer;
+  std::ostream& dumpstream; // buffer, unless streaming
+
+  // Dump ranges of visited nodes, used for computing subtree hashes
+  struct DumpRange {
+    size_t nodeidx;
+    long start;
+    long end;
+    std::vector<size_t> children; // indices into closedRanges
+    const AbstractNode *node;
+    bool background;
+    bool highlight;
+    bool reused; // copied from previous, with the hash already known
+    Hash128 hash;
+  };
+  std::vector<DumpRange> openRanges; // currently open nodes, innermost last
+  std::vector<DumpRange> closedRanges; // closed nodes, children before parents
 
 };
 
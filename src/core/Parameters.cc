@@ -25,6 +25,7 @@
  */
 
 #include <set>
+#include <unordered_map>
 #include <utility>
 
 #include "Expression.h"
@@ -195,12 +196,105 @@ static ContextFrame parse_without_defaults(
   return output;
 }
 
+namespace {
+
+/*
+ * How the arguments of a call site map to the parameters of a builtin,
+ * computed once per call site. Only calls that match without warnings are
+ * bound, others are parsed each time so the warnings are repeated.
+ */
+struct ParameterBinding {
+  std::vector<boost::optional<std::string>> argument_names;
+  std::vector<std::string> parameters; // Required, then optional
+  size_t num_required{0};
+  bool valid{false};
+  std::vector<int> slots; // Parameter of each positional argument, -1 for named ones
+  std::vector<Identifier> targets; // Variable each argument is bound to
+  std::vector<Identifier> unbound; // Required parameters without arguments
+
+  bool matches(const Arguments& arguments, const std::vector<std::string>& required, const std::vector<std::string>& optional) const
+  {
+    if (arguments.size() != argument_names.size() || required.size() != num_required ||
+        required.size() + optional.size() != parameters.size()) return false;
+    for (size_t i = 0; i < arguments.size(); ++i) {
+      if (arguments[i].name != argument_names[i]) return false;
+    }
+    return std::equal(required.begin(), required.end(), parameters.begin()) &&
+           std::equal(optional.begin(), optional.end(), parameters.begin() + num_required);
+  }
+};
+
+ParameterBinding make_binding(const Arguments& arguments, const std::vector<std::string>& required, const std::vector<std::string>& optional)
+{
+  ParameterBinding binding;
+  binding.parameters = required;
+  binding.parameters.insert(binding.parameters.end(), optional.begin(), optional.end());
+  binding.num_required = required.size();
+
+  std::vector<bool> bound(binding.parameters.size());
+  std::set<std::string> named;
+  size_t position = 0;
+  for (const auto& argument : arguments) {
+    binding.argument_names.push_back(argument.name);
+    if (argument.name) {
+      const auto& name = *argument.name;
+      const auto it = std::find(binding.parameters.begin(), binding.parameters.end(), name);
+      // Repeated, overriding or unexpected: warned about by parse_without_defaults()
+      if (!named.insert(name).second) return binding;
+      if (it == binding.parameters.end()) {
+        if (!ContextFrame::is_config_variable(name)) return binding;
+      } else {
+        if (bound[it - binding.parameters.begin()]) return binding;
+        bound[it - binding.parameters.begin()] = true;
+      }
+      binding.slots.push_back(-1);
+    } else {
+      while (position < binding.parameters.size() && named.count(binding.parameters[position])) ++position;
+      if (position == binding.parameters.size()) return binding; // Too many unnamed arguments
+      bound[position] = true;
+      binding.slots.push_back(position++);
+    }
+  }
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    const int slot = binding.slots[i];
+    binding.targets.emplace_back(slot < 0 ? *arguments[i].name : binding.parameters[slot]);
+  }
+  for (size_t i = 0; i < required.size(); ++i) {
+    if (!bound[i]) binding.unbound.emplace_back(binding.parameters[i]);
+  }
+  binding.valid = true;
+  return binding;
+}
+
+// Call sites are validated on every use, since their lists may be freed and reused by later parses
+thread_local std::unordered_map<const AssignmentList *, ParameterBinding> bindings;
+const size_t maxBindings = 1 << 16;
+
+} // namespace
+
 Parameters Parameters::parse(
   Arguments arguments,
   const Location& loc,
   const std::vector<std::string>& required_parameters,
   const std::vector<std::string>& optional_parameters
   ) {
+  if (const auto *site = arguments.callSite()) {
+    auto it = bindings.find(site);
+    if (it == bindings.end() || !it->second.matches(arguments, required_parameters, optional_parameters)) {
+      if (bindings.size() >= maxBindings) bindings.clear();
+      it = bindings.insert_or_assign(site, make_binding(arguments, required_parameters, optional_parameters)).first;
+    }
+    const auto& binding = it->second;
+    if (binding.valid) {
+      ContextFrame frame{arguments.session()};
+      for (size_t i = 0; i < arguments.size(); ++i) {
+        frame.set_variable(binding.targets[i], std::move(arguments[i].value));
+      }
+      for (const auto& parameter : binding.unbound) frame.set_variable(parameter, Value::undefined.clone());
+      return Parameters{std::move(frame), loc};
+    }
+  }
+
   ContextFrame frame{parse_without_defaults(std::move(arguments), loc, required_parameters, optional_parameters, true,
                                             [](const std::string& s) -> std::string {
       return s;
@@ -229,11 +323,11 @@ Parameters Parameters::parse(
                                             )};
 
   for (const auto& parameter : required_parameters) {
-    if (!frame.lookup_local_variable(parameter->getName())) {
+    if (!frame.lookup_local_variable(parameter->getIdentifier())) {
       if (parameter->getExpr()) {
-        frame.set_variable(parameter->getName(), parameter->getExpr()->evaluate(defining_context));
+        frame.set_variable(parameter->getIdentifier(), parameter->getExpr()->evaluate(defining_context));
       } else {
-        frame.set_variable(parameter->getName(), Value::undefined.clone());
+        frame.set_variable(parameter->getIdentifier(), Value::undefined.clone());
       }
     }
   }
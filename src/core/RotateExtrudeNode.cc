@@ -33,6 +33,7 @@
 #include "io/fileutils.h"
 #include "Builtins.h"
 #include "handle_dep.h"
+#include "StatCache.h"
 #include <cmath>
 #include <sstream>
 #include <boost/assign/std/vector.hpp>
@@ -59,6 +60,7 @@ static std::shared_ptr<AbstractNode> builtin_rotate_extrude(const ModuleInstanti
     auto filename = lookup_file(parameters["file"].toString(), inst->location().filePath().parent_path().string(), parameters.documentRoot());
     node->filename = filename;
     handle_dep(filename);
+    parameters.session()->addExternalInput();
   }
 
   node->layername = parameters["layer"].isUndefined() ? "" : parameters["layer"].toString();
@@ -101,7 +103,7 @@ std::string RotateExtrudeNode::toString() const
       "layer = " << QuotedString(this->layername) << ", "
       "origin = [" << std::dec << this->origin_x << ", " << this->origin_y << "], "
       "scale = " << this->scale << ", "
-           << "timestamp = " << (fs::exists(path) ? fs::last_write_time(path) : 0) << ", "
+           << "timestamp = " << StatCache::mtime(path.string()) << ", "
     ;
   }
   stream <<
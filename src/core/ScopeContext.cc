@@ -54,11 +54,11 @@ void ScopeContext::evaluateAssignments(const AssignmentList& assignments)
 void ScopeContext::init()
 {
   for (const auto& assignment : scope->assignments) {
-    if (assignment->getExpr()->isLiteral() && lookup_local_variable(assignment->getName())) {
+    if (assignment->getExpr()->isLiteral() && lookup_local_variable(assignment->getIdentifier())) {
       LOG(message_group::Warning, assignment->location(), this->documentRoot(), "Parameter %1$s is overwritten with a literal", assignment->getName());
     }
     try{
-      set_variable(assignment->getName(), assignment->getExpr()->evaluate(get_shared_ptr()));
+      set_variable(assignment->getIdentifier(), assignment->getExpr()->evaluate(get_shared_ptr()));
     } catch (EvaluationException& e) {
       if (e.traceDepth > 0) {
         if(assignment->locationOfOverwrite().isNone()){
@@ -77,7 +77,7 @@ void ScopeContext::init()
 //	evaluateAssignments(module.scope.assignments);
 }
 
-boost::optional<CallableFunction> ScopeContext::lookup_local_function(const std::string& name, const Location& loc) const
+boost::optional<CallableFunction> ScopeContext::lookup_local_function(const Identifier& name, const Location& loc) const
 {
   const auto& search = scope->functions.find(name);
   if (search != scope->functions.end()) {
@@ -86,7 +86,7 @@ boost::optional<CallableFunction> ScopeContext::lookup_local_function(const std:
   return Context::lookup_local_function(name, loc);
 }
 
-boost::optional<InstantiableModule> ScopeContext::lookup_local_module(const std::string& name, const Location& loc) const
+boost::optional<InstantiableModule> ScopeContext::lookup_local_module(const Identifier& name, const Location& loc) const
 {
   const auto& search = scope->modules.find(name);
   if (search != scope->modules.end()) {
@@ -99,8 +99,9 @@ UserModuleContext::UserModuleContext(const std::shared_ptr<const Context>& paren
   ScopeContext(parent, &module->body),
   children(std::move(children))
 {
-  set_variable("$children", Value(double(this->children.size())));
-  set_variable("$parent_modules", Value(double(StaticModuleNameStack::size())));
+  static const Identifier children_id("$children"), parent_modules_id("$parent_modules");
+  set_variable(children_id, Value(double(this->children.size())));
+  set_variable(parent_modules_id, Value(double(StaticModuleNameStack::size())));
   apply_variables(Parameters::parse(std::move(arguments), loc, module->parameters, parent).to_context_frame());
 }
 
@@ -111,7 +112,7 @@ std::vector<const std::shared_ptr<const Context> *> UserModuleContext::list_refe
   return output;
 }
 
-boost::optional<CallableFunction> FileContext::lookup_local_function(const std::string& name, const Location& loc) const
+boost::optional<CallableFunction> FileContext::lookup_local_function(const Identifier& name, const Location& loc) const
 {
   auto result = ScopeContext::lookup_local_function(name, loc);
   if (result) {
@@ -124,7 +125,7 @@ boost::optional<CallableFunction> FileContext::lookup_local_function(const std::
     if (usedmod && usedmod->scope.functions.find(name) != usedmod->scope.functions.end()) {
       ContextHandle<FileContext> context{Context::create<FileContext>(this->parent, usedmod)};
 #ifdef DEBUG
-      PRINTDB("FileContext for function %s::%s:", m % name);
+      PRINTDB("FileContext for function %s::%s:", m % name.getName());
       PRINTDB("%s", context->dump());
 #endif
       return CallableFunction{CallableUserFunction{*context, usedmod->scope.functions[name].get()}};
@@ -133,7 +134,7 @@ boost::optional<CallableFunction> FileContext::lookup_local_function(const std::
   return boost::none;
 }
 
-boost::optional<InstantiableModule> FileContext::lookup_local_module(const std::string& name, const Location& loc) const
+boost::optional<InstantiableModule> FileContext::lookup_local_module(const Identifier& name, const Location& loc) const
 {
   auto result = ScopeContext::lookup_local_module(name, loc);
   if (result) {
@@ -146,7 +147,7 @@ boost::optional<InstantiableModule> FileContext::lookup_local_module(const std::
     if (usedmod && usedmod->scope.modules.find(name) != usedmod->scope.modules.end()) {
       ContextHandle<FileContext> context{Context::create<FileContext>(this->parent, usedmod)};
 #ifdef DEBUG
-      PRINTDB("FileContext for module %s::%s:", m % name);
+      PRINTDB("FileContext for module %s::%s:", m % name.getName());
       PRINTDB("%s", context->dump());
 #endif
       return InstantiableModule{*context, usedmod->scope.modules[name].get()};
@@ -28,10 +28,12 @@
 #include "SourceFileCache.h"
 #include "node.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 #include "exceptions.h"
 #include "ScopeContext.h"
 #include "parsersettings.h"
 #include "StatCache.h"
+#include "Feature.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <utility>
@@ -62,6 +64,7 @@ void SourceFile::registerUse(const std::string& path, const Location& loc)
   if (boost::iequals(ext, ".otf") || boost::iequals(ext, ".ttf")) {
     if (fs::is_regular_file(path)) {
       FontCache::instance()->register_font_file(path);
+      usedfonts.push_back(path);
     } else {
       LOG(message_group::Error, "Can't read font with path '%1$s'", path);
     }
@@ -168,11 +171,16 @@ time_t SourceFile::handleDependencies(bool is_root)
 
 std::shared_ptr<AbstractNode> SourceFile::instantiate(const std::shared_ptr<const Context>& context, std::shared_ptr<const FileContext> *resulting_file_context) const
 {
+  TimingCounters::Scope timer(TimingCounters::INSTANTIATE);
   auto node = std::make_shared<RootNode>();
   try {
     ContextHandle<FileContext> file_context{Context::create<FileContext>(context, this)};
     *resulting_file_context = *file_context;
-    this->scope.instantiateModules(*file_context, node);
+    if (Feature::ExperimentalIncrementalEval.is_enabled()) {
+      this->instantiation_cache.instantiateModules(this->scope, *file_context, node);
+    } else {
+      this->scope.instantiateModules(*file_context, node);
+    }
   } catch (HardWarningException& e) {
     throw;
   } catch (EvaluationException& e) {
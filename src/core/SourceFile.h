@@ -8,6 +8,7 @@
 #include "module.h"
 #include "LocalScope.h"
 #include "IndicatorData.h"
+#include "InstantiationCache.h"
 
 class SourceFile : public ASTNode
 {
@@ -21,6 +22,7 @@ public:
   const std::string& modulePath() const { return this->path; }
   void registerUse(const std::string& path, const Location& loc);
   void registerInclude(const std::string& localpath, const std::string& fullpath, const Location& loc);
+  const std::unordered_map<std::string, std::string>& getIncludes() const { return this->includes; }
   std::time_t includesChanged() const;
   std::time_t handleDependencies(bool is_root = true);
   bool hasIncludes() const { return !this->includes.empty(); }
@@ -30,9 +32,12 @@ public:
   void setFilename(const std::string& filename) { this->filename = filename; }
   const std::string& getFilename() const { return this->filename; }
   const std::string getFullpath() const;
+  // Must be called when used libraries changed, as cached nodes may depend on them
+  void clearInstantiationCache() { this->instantiation_cache.clear(); }
 
   LocalScope scope;
   std::vector<std::string> usedlibs;
+  std::vector<std::string> usedfonts;
 
   std::vector<IndicatorData> indicatorData;
 
@@ -40,6 +45,7 @@ private:
   std::time_t include_modified(const std::string& filename) const;
 
   std::unordered_map<std::string, std::string> includes;
+  mutable InstantiationCache instantiation_cache;
   bool is_handling_dependencies{false};
 
   std::string path;
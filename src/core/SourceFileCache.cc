@@ -1,9 +1,11 @@
 #include "SourceFileCache.h"
 #include "StatCache.h"
 #include "SourceFile.h"
+#include "SourceFileDiskCache.h"
 #include "printutils.h"
 #include "openscad.h"
 #include <boost/format.hpp>
+#include <boost/functional/hash.hpp>
 
 #include <cstdio>
 #include <fstream>
@@ -16,6 +18,21 @@
 
 SourceFileCache *SourceFileCache::inst = nullptr;
 
+namespace {
+
+std::size_t hashIncludes(const SourceFile& file)
+{
+  std::size_t seed = 0;
+  for (const auto& include : file.getIncludes()) {
+    std::ifstream ifs(include.second.c_str());
+    boost::hash_combine(seed, include.second);
+    if (ifs.is_open()) boost::hash_combine(seed, STR(ifs.rdbuf()));
+  }
+  return seed;
+}
+
+} // namespace
+
 /*!
    Reevaluate the given file and all its dependencies and recompile anything
    needing reevaluation. Updates the cache if necessary.
@@ -97,17 +114,38 @@ std::time_t SourceFileCache::evaluate(const std::string& mainFile, const std::st
       }
       text = STR(ifs.rdbuf(), "\n\x03\n", commandline_commands);
     }
+    const std::size_t text_hash = std::hash<std::string>()(text);
+
+    // A file only touched, e.g. by a checkout, keeps its parse. Files using it
+    // look it up by name when instantiated, so they never need to be reparsed.
+    if (cacheEntry.file && text_hash == cacheEntry.text_hash &&
+        hashIncludes(*cacheEntry.file) == cacheEntry.includes_hash) {
+      PRINTDB("Unchanged library: %s", filename);
+      cacheEntry.cache_id = cache_id;
+    } else {
+      print_messages_push();
 
-    print_messages_push();
-
-    delete cacheEntry.parsed_file;
-    file = parse(cacheEntry.parsed_file, text, filename, mainFile, false) ? cacheEntry.parsed_file : nullptr;
-    PRINTDB("compiled file: %s", filename);
-    cacheEntry.file = file;
-    cacheEntry.cache_id = cache_id;
-    auto mod = file ? file : cacheEntry.parsed_file;
-    if (!found && mod) cacheEntry.includes_mtime = mod->includesChanged();
-    print_messages_pop();
+      delete cacheEntry.parsed_file;
+      // The main file is parsed with customizer annotations and location info, never cache it
+      auto diskcache = filename != mainFile ? SourceFileDiskCache::instance() : nullptr;
+      cacheEntry.parsed_file = diskcache ? diskcache->get(filename, text) : nullptr;
+      if (cacheEntry.parsed_file) {
+        file = cacheEntry.parsed_file;
+      } else {
+        const size_t messages = print_message_count;
+        file = parse(cacheEntry.parsed_file, text, filename, mainFile, false) ? cacheEntry.parsed_file : nullptr;
+        PRINTDB("compiled file: %s", filename);
+        // Warnings aren't stored, files parsed with any are compiled again next time
+        if (diskcache && file && print_message_count == messages) diskcache->insert(filename, text, *file);
+      }
+      cacheEntry.file = file;
+      cacheEntry.cache_id = cache_id;
+      cacheEntry.text_hash = text_hash;
+      auto mod = file ? file : cacheEntry.parsed_file;
+      if (!found && mod) cacheEntry.includes_mtime = mod->includesChanged();
+      if (mod) cacheEntry.includes_hash = hashIncludes(*mod);
+      print_messages_pop();
+    }
   }
 
   sourceFile = file;
@@ -122,6 +160,18 @@ void SourceFileCache::clear()
   this->entries.clear();
 }
 
+std::vector<std::string> SourceFileCache::filenames() const
+{
+  std::vector<std::string> names;
+  for (const auto& entry : this->entries) {
+    names.push_back(entry.first);
+    if (auto file = entry.second.parsed_file) {
+      for (const auto& include : file->getIncludes()) names.push_back(include.second);
+    }
+  }
+  return names;
+}
+
 SourceFile *SourceFileCache::lookup(const std::string& filename)
 {
   auto it = this->entries.find(filename);
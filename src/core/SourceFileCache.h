@@ -3,6 +3,7 @@
 #include <string>
 #include <ctime>
 #include <unordered_map>
+#include <vector>
 
 class SourceFile;
 
@@ -17,6 +18,8 @@ public:
   std::time_t evaluate(const std::string& mainFile, const std::string& filename, SourceFile *& sourceFile);
   SourceFile *lookup(const std::string& filename);
   size_t size() const { return this->entries.size(); }
+  // The cached files and the files they include
+  std::vector<std::string> filenames() const;
   void clear();
   static void clear_markers();
 
@@ -29,6 +32,8 @@ private:
     SourceFile *file{};
     SourceFile *parsed_file{};                   // the last version parsed for the include list
     std::string cache_id;
+    std::size_t text_hash{}; // hash of the text last parsed
+    std::size_t includes_hash{}; // hash of the included files' text last parsed
     std::time_t mtime{}; // time file last modified
     std::time_t includes_mtime{}; // time the includes last changed
   };
@@ -0,0 +1,718 @@
+#include "SourceFileDiskCache.h"
+#include "SourceFile.h"
+#include "Expression.h"
+#include "ModuleInstantiation.h"
+#include "UserModule.h"
+#include "function.h"
+#include "FontCache.h"
+#include "handle_dep.h"
+#include "parsersettings.h"
+#include "printutils.h"
+#include "version.h"
+#include "Feature.h"
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+SourceFileDiskCache *SourceFileDiskCache::inst = nullptr;
+
+namespace {
+
+const char entry_magic[8] = {'O', 'S', 'C', 'A', 'S', 'T', '\0', '\0'};
+const uint32_t entry_format_version = 2;
+const char *entry_extension = ".ast";
+
+enum class ExpressionType : uint8_t {
+  NONE = 0,
+  LITERAL_UNDEF,
+  LITERAL_BOOL,
+  LITERAL_NUMBER,
+  LITERAL_STRING,
+  UNARY_OP,
+  BINARY_OP,
+  TERNARY_OP,
+  ARRAY_LOOKUP,
+  RANGE,
+  VECTOR,
+  LOOKUP,
+  MEMBER_LOOKUP,
+  FUNCTION_CALL,
+  FUNCTION_DEFINITION,
+  ASSERT,
+  ECHO,
+  LET,
+  LC_IF,
+  LC_FOR,
+  LC_FOR_C,
+  LC_EACH,
+  LC_LET,
+  LITERAL_VECTOR,
+};
+
+// The elements of packed vector literals
+enum class ValueType : uint8_t {
+  NUMBER = 0,
+  VECTOR,
+};
+
+// Thrown for AST nodes which can't be written and for malformed entries
+struct EntryError {};
+
+template <typename T>
+void write_value(std::ostream& out, const T& value)
+{
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T read_value(std::istream& in)
+{
+  T value;
+  in.read(reinterpret_cast<char *>(&value), sizeof(value));
+  if (!in) throw EntryError();
+  return value;
+}
+
+void write_string(std::ostream& out, const std::string& str)
+{
+  write_value<uint32_t>(out, str.size());
+  out.write(str.data(), str.size());
+}
+
+/*!
+   Reads the length of a string or the number of elements that follow. Each
+   takes at least a byte, so a length exceeding the rest of the entry means
+   the entry is corrupt, and isn't used to allocate anything.
+ */
+uint32_t read_length(std::istream& in)
+{
+  const auto length = read_value<uint32_t>(in);
+  const auto pos = in.tellg();
+  in.seekg(0, std::ios::end);
+  const auto end = in.tellg();
+  in.seekg(pos);
+  if (!in || pos < 0 || end < pos || length > static_cast<uint64_t>(end - pos)) throw EntryError();
+  return length;
+}
+
+std::string read_string(std::istream& in)
+{
+  const auto size = read_length(in);
+  std::string str(size, '\0');
+  in.read(&str[0], size);
+  if (!in) throw EntryError();
+  return str;
+}
+
+bool hash_file(const std::string& filename, Hash128& hash)
+{
+  std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!ifs.is_open()) return false;
+  std::ostringstream contents;
+  contents << ifs.rdbuf();
+  const auto str = contents.str();
+  hash = hash128(str.data(), str.size());
+  return true;
+}
+
+class EntryWriter
+{
+public:
+  EntryWriter(std::ostream& out) : out(out) {}
+
+  void writeLocation(const Location& loc) {
+    // Paths are written once, locations refer to them by index (0 is Location::NONE)
+    if (loc.isNone()) {
+      write_value<uint32_t>(out, 0);
+      return;
+    }
+    const auto name = loc.fileName();
+    auto it = this->paths.find(name);
+    if (it == this->paths.end()) {
+      const uint32_t index = this->paths.size() + 1;
+      this->paths.emplace(name, index);
+      write_value(out, index);
+      write_string(out, name);
+    } else {
+      write_value(out, it->second);
+    }
+    write_value<int32_t>(out, loc.firstLine());
+    write_value<int32_t>(out, loc.firstColumn());
+    write_value<int32_t>(out, loc.lastLine());
+    write_value<int32_t>(out, loc.lastColumn());
+  }
+
+  void writeAssignments(const AssignmentList& assignments) {
+    write_value<uint32_t>(out, assignments.size());
+    for (const auto& assignment : assignments) {
+      // Annotations are only parsed for the customizer and never needed for libraries
+      if (assignment->hasAnnotations()) throw EntryError();
+      write_string(out, assignment->getName());
+      writeLocation(assignment->location());
+      writeLocation(assignment->locationOfOverwrite());
+      writeExpression(assignment->getExpr().get());
+    }
+  }
+
+  // Packed vector literals only hold numbers and vectors of them, see Vector::pack()
+  void writeValue(const Value& value) {
+    if (value.type() == Value::Type::NUMBER) {
+      write_value(out, ValueType::NUMBER);
+      write_value(out, value.toDouble());
+    } else if (value.type() == Value::Type::VECTOR) {
+      const auto& vector = value.toVector();
+      write_value(out, ValueType::VECTOR);
+      write_value<uint32_t>(out, vector.size());
+      for (const auto& element : vector) writeValue(element);
+    } else {
+      throw EntryError();
+    }
+  }
+
+  void writeExpression(const Expression *expr) {
+    if (!expr) {
+      write_value(out, ExpressionType::NONE);
+      return;
+    }
+    const auto& type = typeid(*expr);
+    if (type == typeid(Literal)) {
+      const auto *literal = static_cast<const Literal *>(expr);
+      if (literal->isUndefined()) {
+        writeHeader(ExpressionType::LITERAL_UNDEF, expr);
+      } else if (literal->isBool()) {
+        writeHeader(ExpressionType::LITERAL_BOOL, expr);
+        write_value<uint8_t>(out, literal->toBool());
+      } else if (literal->isDouble()) {
+        writeHeader(ExpressionType::LITERAL_NUMBER, expr);
+        write_value(out, literal->toDouble());
+      } else if (literal->isString()) {
+        writeHeader(ExpressionType::LITERAL_STRING, expr);
+        write_string(out, literal->toString());
+      } else if (literal->isVector()) {
+        writeHeader(ExpressionType::LITERAL_VECTOR, expr);
+        writeValue(literal->getValue());
+      } else {
+        throw EntryError();
+      }
+    } else if (type == typeid(UnaryOp)) {
+      const auto *op = static_cast<const UnaryOp *>(expr);
+      writeHeader(ExpressionType::UNARY_OP, expr);
+      write_value(out, op->getOp());
+      writeExpression(op->getExpr());
+    } else if (type == typeid(BinaryOp)) {
+      const auto *op = static_cast<const BinaryOp *>(expr);
+      writeHeader(ExpressionType::BINARY_OP, expr);
+      write_value(out, op->getOp());
+      writeExpression(op->getLeft());
+      writeExpression(op->getRight());
+    } else if (type == typeid(TernaryOp)) {
+      const auto *op = static_cast<const TernaryOp *>(expr);
+      writeHeader(ExpressionType::TERNARY_OP, expr);
+      writeExpression(op->getCond());
+      writeExpression(op->getIfExpr());
+      writeExpression(op->getElseExpr());
+    } else if (type == typeid(ArrayLookup)) {
+      const auto *lookup = static_cast<const ArrayLookup *>(expr);
+      writeHeader(ExpressionType::ARRAY_LOOKUP, expr);
+      writeExpression(lookup->getArray());
+      writeExpression(lookup->getIndex());
+    } else if (type == typeid(Range)) {
+      const auto *range = static_cast<const Range *>(expr);
+      writeHeader(ExpressionType::RANGE, expr);
+      writeExpression(range->getBegin());
+      writeExpression(range->getStep());
+      writeExpression(range->getEnd());
+    } else if (type == typeid(Vector)) {
+      const auto *vector = static_cast<const Vector *>(expr);
+      writeHeader(ExpressionType::VECTOR, expr);
+      write_value<uint32_t>(out, vector->getChildren().size());
+      for (const auto& child : vector->getChildren()) writeExpression(child.get());
+    } else if (type == typeid(Lookup)) {
+      writeHeader(ExpressionType::LOOKUP, expr);
+      write_string(out, static_cast<const Lookup *>(expr)->get_name());
+    } else if (type == typeid(MemberLookup)) {
+      const auto *lookup = static_cast<const MemberLookup *>(expr);
+      writeHeader(ExpressionType::MEMBER_LOOKUP, expr);
+      write_string(out, lookup->getMember());
+      writeExpression(lookup->getExpr());
+    } else if (type == typeid(FunctionCall)) {
+      const auto *call = static_cast<const FunctionCall *>(expr);
+      writeHeader(ExpressionType::FUNCTION_CALL, expr);
+      writeExpression(call->expr.get());
+      writeAssignments(call->arguments);
+    } else if (type == typeid(FunctionDefinition)) {
+      const auto *definition = static_cast<const FunctionDefinition *>(expr);
+      writeHeader(ExpressionType::FUNCTION_DEFINITION, expr);
+      writeAssignments(definition->parameters);
+      writeExpression(definition->expr.get());
+    } else if (type == typeid(Assert)) {
+      writeArgumentsAndExpression(ExpressionType::ASSERT, static_cast<const Assert *>(expr));
+    } else if (type == typeid(Echo)) {
+      writeArgumentsAndExpression(ExpressionType::ECHO, static_cast<const Echo *>(expr));
+    } else if (type == typeid(Let)) {
+      writeArgumentsAndExpression(ExpressionType::LET, static_cast<const Let *>(expr));
+    } else if (type == typeid(LcIf)) {
+      const auto *lc = static_cast<const LcIf *>(expr);
+      writeHeader(ExpressionType::LC_IF, expr);
+      writeExpression(lc->getCond());
+      writeExpression(lc->getIfExpr());
+      writeExpression(lc->getElseExpr());
+    } else if (type == typeid(LcFor)) {
+      writeArgumentsAndExpression(ExpressionType::LC_FOR, static_cast<const LcFor *>(expr));
+    } else if (type == typeid(LcForC)) {
+      const auto *lc = static_cast<const LcForC *>(expr);
+      writeHeader(ExpressionType::LC_FOR_C, expr);
+      writeAssignments(lc->getArguments());
+      writeAssignments(lc->getIncrArguments());
+      writeExpression(lc->getCond());
+      writeExpression(lc->getExpr());
+    } else if (type == typeid(LcEach)) {
+      writeHeader(ExpressionType::LC_EACH, expr);
+      writeExpression(static_cast<const LcEach *>(expr)->getExpr());
+    } else if (type == typeid(LcLet)) {
+      writeArgumentsAndExpression(ExpressionType::LC_LET, static_cast<const LcLet *>(expr));
+    } else {
+      throw EntryError();
+    }
+  }
+
+  void writeScope(const LocalScope& scope) {
+    writeAssignments(scope.assignments);
+    write_value<uint32_t>(out, scope.astFunctions.size());
+    for (const auto& entry : scope.astFunctions) {
+      const auto& function = *entry.second;
+      write_string(out, function.name);
+      writeLocation(function.location());
+      writeAssignments(function.parameters);
+      writeExpression(function.expr.get());
+    }
+    write_value<uint32_t>(out, scope.astModules.size());
+    for (const auto& entry : scope.astModules) {
+      const auto& module = *entry.second;
+      write_string(out, module.name);
+      writeLocation(module.location());
+      writeAssignments(module.parameters);
+      writeScope(module.body);
+    }
+    write_value<uint32_t>(out, scope.moduleInstantiations.size());
+    for (const auto& inst : scope.moduleInstantiations) writeModuleInstantiation(*inst);
+  }
+
+  void writeModuleInstantiation(const ModuleInstantiation& inst) {
+    const auto *ifelse = dynamic_cast<const IfElseModuleInstantiation *>(&inst);
+    if (ifelse ? typeid(inst) != typeid(IfElseModuleInstantiation) : typeid(inst) != typeid(ModuleInstantiation)) {
+      throw EntryError();
+    }
+    write_value<uint8_t>(out, ifelse ? 1 : 0);
+    write_string(out, inst.name());
+    writeLocation(inst.location());
+    writeAssignments(inst.arguments);
+    write_value<uint8_t>(out, inst.tag_root | inst.tag_highlight << 1 | inst.tag_background << 2);
+    writeScope(inst.scope);
+    if (ifelse) {
+      write_value<uint8_t>(out, ifelse->getElseScope() ? 1 : 0);
+      if (ifelse->getElseScope()) writeScope(*ifelse->getElseScope());
+    }
+  }
+
+private:
+  void writeHeader(ExpressionType type, const Expression *expr) {
+    write_value(out, type);
+    writeLocation(expr->location());
+  }
+
+  template <typename T>
+  void writeArgumentsAndExpression(ExpressionType type, const T *expr) {
+    writeHeader(type, expr);
+    writeAssignments(expr->getArguments());
+    writeExpression(expr->getExpr());
+  }
+
+  std::ostream& out;
+  std::unordered_map<std::string, uint32_t> paths;
+};
+
+class EntryReader
+{
+public:
+  EntryReader(std::istream& in) : in(in) {}
+
+  Location readLocation() {
+    const auto index = read_value<uint32_t>(in);
+    if (index == 0) return Location::NONE;
+    if (index == this->paths.size() + 1) {
+      this->paths.push_back(std::make_shared<fs::path>(read_string(in)));
+    } else if (index > this->paths.size()) {
+      throw EntryError();
+    }
+    const auto firstLine = read_value<int32_t>(in);
+    const auto firstColumn = read_value<int32_t>(in);
+    const auto lastLine = read_value<int32_t>(in);
+    const auto lastColumn = read_value<int32_t>(in);
+    return {firstLine, firstColumn, lastLine, lastColumn, this->paths[index - 1]};
+  }
+
+  AssignmentList readAssignments() {
+    AssignmentList assignments(read_length(in));
+    for (auto& assignment : assignments) {
+      auto name = read_string(in);
+      const auto loc = readLocation();
+      const auto locOfOverwrite = readLocation();
+      assignment = ::assignment(name, shared_ptr<Expression>(readExpression().release()), loc);
+      assignment->setLocationOfOverwrite(locOfOverwrite);
+    }
+    return assignments;
+  }
+
+  Value readValue() {
+    switch (read_value<ValueType>(in)) {
+    case ValueType::NUMBER:
+      return {read_value<double>(in)};
+    case ValueType::VECTOR: {
+      const auto size = read_length(in);
+      VectorType vector(nullptr);
+      for (uint32_t i = 0; i < size; ++i) vector.emplace_back(readValue());
+      return {std::move(vector)};
+    }
+    default:
+      throw EntryError();
+    }
+  }
+
+  std::unique_ptr<Expression> readExpression() {
+    const auto type = read_value<ExpressionType>(in);
+    if (type == ExpressionType::NONE) return nullptr;
+    const auto loc = readLocation();
+    switch (type) {
+    case ExpressionType::LITERAL_UNDEF:
+      return std::make_unique<Literal>(loc);
+    case ExpressionType::LITERAL_BOOL:
+      return std::make_unique<Literal>(Value(read_value<uint8_t>(in) != 0), loc);
+    case ExpressionType::LITERAL_NUMBER:
+      return std::make_unique<Literal>(Value(read_value<double>(in)), loc);
+    case ExpressionType::LITERAL_STRING:
+      return std::make_unique<Literal>(Value(str_utf8_wrapper(read_string(in))), loc);
+    case ExpressionType::LITERAL_VECTOR:
+      return std::make_unique<Literal>(readValue(), loc);
+    case ExpressionType::UNARY_OP: {
+      const auto op = read_value<UnaryOp::Op>(in);
+      auto expr = readExpression();
+      return std::make_unique<UnaryOp>(op, expr.release(), loc);
+    }
+    case ExpressionType::BINARY_OP: {
+      const auto op = read_value<BinaryOp::Op>(in);
+      auto left = readExpression();
+      auto right = readExpression();
+      return std::make_unique<BinaryOp>(left.release(), op, right.release(), loc);
+    }
+    case ExpressionType::TERNARY_OP: {
+      auto cond = readExpression();
+      auto ifexpr = readExpression();
+      auto elseexpr = readExpression();
+      return std::make_unique<TernaryOp>(cond.release(), ifexpr.release(), elseexpr.release(), loc);
+    }
+    case ExpressionType::ARRAY_LOOKUP: {
+      auto array = readExpression();
+      auto index = readExpression();
+      return std::make_unique<ArrayLookup>(array.release(), index.release(), loc);
+    }
+    case ExpressionType::RANGE: {
+      auto begin = readExpression();
+      auto step = readExpression();
+      auto end = readExpression();
+      return std::make_unique<Range>(begin.release(), step.release(), end.release(), loc);
+    }
+    case ExpressionType::VECTOR: {
+      auto vector = std::make_unique<Vector>(loc);
+      const auto size = read_length(in);
+      for (uint32_t i = 0; i < size; ++i) vector->emplace_back(readExpression().release());
+      return vector;
+    }
+    case ExpressionType::LOOKUP:
+      return std::make_unique<Lookup>(read_string(in), loc);
+    case ExpressionType::MEMBER_LOOKUP: {
+      auto member = read_string(in);
+      auto expr = readExpression();
+      return std::make_unique<MemberLookup>(expr.release(), member, loc);
+    }
+    case ExpressionType::FUNCTION_CALL: {
+      auto expr = readExpression();
+      if (!expr) throw EntryError();
+      return std::make_unique<FunctionCall>(expr.release(), readAssignments(), loc);
+    }
+    case ExpressionType::FUNCTION_DEFINITION: {
+      auto parameters = readAssignments();
+      auto expr = readExpression();
+      return std::make_unique<FunctionDefinition>(expr.release(), parameters, loc);
+    }
+    case ExpressionType::ASSERT:
+      return readArgumentsAndExpression<Assert>(loc);
+    case ExpressionType::ECHO:
+      return readArgumentsAndExpression<Echo>(loc);
+    case ExpressionType::LET:
+      return readArgumentsAndExpression<Let>(loc);
+    case ExpressionType::LC_IF: {
+      auto cond = readExpression();
+      auto ifexpr = readExpression();
+      auto elseexpr = readExpression();
+      return std::make_unique<LcIf>(cond.release(), ifexpr.release(), elseexpr.release(), loc);
+    }
+    case ExpressionType::LC_FOR:
+      return readArgumentsAndExpression<LcFor>(loc);
+    case ExpressionType::LC_FOR_C: {
+      auto arguments = readAssignments();
+      auto incr_arguments = readAssignments();
+      auto cond = readExpression();
+      auto expr = readExpression();
+      return std::make_unique<LcForC>(arguments, incr_arguments, cond.release(), expr.release(), loc);
+    }
+    case ExpressionType::LC_EACH:
+      return std::make_unique<LcEach>(readExpression().release(), loc);
+    case ExpressionType::LC_LET:
+      return readArgumentsAndExpression<LcLet>(loc);
+    default:
+      throw EntryError();
+    }
+  }
+
+  void readScope(LocalScope& scope) {
+    for (const auto& assignment : readAssignments()) scope.addAssignment(assignment);
+    auto count = read_length(in);
+    for (uint32_t i = 0; i < count; ++i) {
+      auto name = read_string(in);
+      const auto loc = readLocation();
+      auto parameters = readAssignments();
+      auto expr = shared_ptr<Expression>(readExpression().release());
+      scope.addFunction(make_shared<UserFunction>(name.c_str(), parameters, expr, loc));
+    }
+    count = read_length(in);
+    for (uint32_t i = 0; i < count; ++i) {
+      auto name = read_string(in);
+      auto module = make_shared<UserModule>(name.c_str(), readLocation());
+      module->parameters = readAssignments();
+      readScope(module->body);
+      scope.addModule(module);
+    }
+    count = read_length(in);
+    for (uint32_t i = 0; i < count; ++i) scope.addModuleInst(readModuleInstantiation());
+  }
+
+  shared_ptr<ModuleInstantiation> readModuleInstantiation() {
+    const bool ifelse = read_value<uint8_t>(in) != 0;
+    auto name = read_string(in);
+    const auto loc = readLocation();
+    auto arguments = readAssignments();
+    shared_ptr<ModuleInstantiation> inst;
+    if (ifelse) {
+      if (arguments.size() != 1) throw EntryError();
+      inst = make_shared<IfElseModuleInstantiation>(arguments[0]->getExpr(), loc);
+    } else {
+      inst = make_shared<ModuleInstantiation>(name, arguments, loc);
+    }
+    const auto tags = read_value<uint8_t>(in);
+    inst->tag_root = tags & 1;
+    inst->tag_highlight = tags & 2;
+    inst->tag_background = tags & 4;
+    readScope(inst->scope);
+    if (ifelse && read_value<uint8_t>(in)) {
+      readScope(*static_cast<IfElseModuleInstantiation *>(inst.get())->makeElseScope());
+    }
+    return inst;
+  }
+
+private:
+  template <typename T>
+  std::unique_ptr<Expression> readArgumentsAndExpression(const Location& loc) {
+    auto arguments = readAssignments();
+    auto expr = readExpression();
+    return std::make_unique<T>(arguments, expr.release(), loc);
+  }
+
+  std::istream& in;
+  std::vector<std::shared_ptr<fs::path>> paths;
+};
+
+} // namespace
+
+/*!
+   Enables the cache, using (and creating if necessary) the given directory.
+ */
+bool SourceFileDiskCache::setDirectory(const std::string& dir)
+{
+  this->dir.clear();
+  if (dir.empty()) return true;
+
+  try {
+    fs::create_directories(dir);
+  } catch (const fs::filesystem_error& e) {
+    LOG(message_group::Warning, "Can't use library cache directory '%1$s': %2$s", dir, e.what());
+    return false;
+  }
+  this->dir = dir;
+
+  // The parser and the AST may change between versions, and some syntax is
+  // only accepted with experimental features enabled.
+  const std::string config = openscad_versionnumber + " " + Feature::features();
+  this->prefix = hash128(config.data(), config.size());
+  return true;
+}
+
+/*!
+   One entry per library file and library search path, as use<> and
+   include<> are resolved against both.
+ */
+std::string SourceFileDiskCache::entryPath(const std::string& filename) const
+{
+  std::string key = filename;
+  for (const auto& path : get_library_path()) key += "\n" + path;
+  const Hash128 ids[2] = {this->prefix, hash128(key.data(), key.size())};
+  return (fs::path(this->dir) / (hash128(ids, sizeof(ids)).toString() + entry_extension)).string();
+}
+
+SourceFile *SourceFileDiskCache::get(const std::string& filename, const std::string& text)
+{
+  if (!isEnabled()) return nullptr;
+  std::ifstream entry(entryPath(filename), std::ios::in | std::ios::binary);
+  if (!entry.good()) return nullptr;
+  // Read at once, the lengths in it are checked against its size
+  std::stringstream in;
+  in << entry.rdbuf();
+  if (!entry) return nullptr;
+
+  std::unique_ptr<SourceFile> file;
+  try {
+    char magic[sizeof(entry_magic)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, entry_magic, sizeof(magic)) != 0) return nullptr;
+    if (read_value<uint32_t>(in) != entry_format_version) return nullptr;
+    if (read_value<Hash128>(in) != hash128(text.data(), text.size())) return nullptr;
+
+    auto path = read_string(in);
+    file = std::make_unique<SourceFile>(path, read_string(in));
+
+    // Included files are part of the AST, so they must be unchanged as well
+    auto count = read_length(in);
+    for (uint32_t i = 0; i < count; ++i) {
+      auto localpath = read_string(in);
+      auto fullpath = read_string(in);
+      const auto hash = read_value<Hash128>(in);
+      Hash128 current;
+      if (!hash_file(fullpath, current) || current != hash) return nullptr;
+      file->registerInclude(localpath, fullpath, Location::NONE);
+    }
+    count = read_length(in);
+    for (uint32_t i = 0; i < count; ++i) {
+      file->usedlibs.push_back(read_string(in));
+      if (!fs::exists(file->usedlibs.back())) return nullptr;
+    }
+    count = read_length(in);
+    for (uint32_t i = 0; i < count; ++i) {
+      file->usedfonts.push_back(read_string(in));
+      if (!fs::is_regular_file(file->usedfonts.back())) return nullptr;
+    }
+    count = read_length(in);
+    for (uint32_t i = 0; i < count; ++i) {
+      const auto firstLine = read_value<int32_t>(in);
+      const auto firstColumn = read_value<int32_t>(in);
+      const auto lastLine = read_value<int32_t>(in);
+      const auto lastColumn = read_value<int32_t>(in);
+      file->indicatorData.emplace_back(firstLine, firstColumn, lastLine, lastColumn, read_string(in));
+    }
+
+    EntryReader reader(in);
+    reader.readScope(file->scope);
+  } catch (const EntryError&) {
+    // Truncated or written by an incompatible build
+    return nullptr;
+  } catch (const std::exception& e) {
+    // Corrupt in a way not detected above, still just a miss
+    PRINTDB("Library cache entry of %s unreadable: %s", filename % e.what());
+    return nullptr;
+  }
+
+  // Replay what the parser does for use<> and include<> statements
+  for (const auto& include : file->getIncludes()) handle_dep(include.second);
+  for (const auto& lib : file->usedlibs) handle_dep(lib);
+  for (const auto& font : file->usedfonts) {
+    handle_dep(font);
+    FontCache::instance()->register_font_file(font);
+  }
+
+  ++this->numhits;
+  PRINTDB("Library cache hit: %s", filename);
+  return file.release();
+}
+
+/*!
+   Writes the parsed file to the cache directory. The entry is written to a
+   temporary file first, so concurrent processes sharing the directory never
+   see partial entries.
+ */
+bool SourceFileDiskCache::insert(const std::string& filename, const std::string& text, const SourceFile& file)
+{
+  if (!isEnabled()) return false;
+
+  const auto path = fs::path(entryPath(filename));
+  const auto tmppath = fs::path(this->dir) / fs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+  bool ok = true;
+  {
+    std::ofstream out(tmppath.string(), std::ios::out | std::ios::binary);
+    if (!out.good()) return false;
+    try {
+      out.write(entry_magic, sizeof(entry_magic));
+      write_value(out, entry_format_version);
+      write_value(out, hash128(text.data(), text.size()));
+      write_string(out, file.modulePath());
+      write_string(out, file.getFilename());
+
+      write_value<uint32_t>(out, file.getIncludes().size());
+      for (const auto& include : file.getIncludes()) {
+        Hash128 hash;
+        if (!hash_file(include.second, hash)) throw EntryError();
+        write_string(out, include.first);
+        write_string(out, include.second);
+        write_value(out, hash);
+      }
+      write_value<uint32_t>(out, file.usedlibs.size());
+      for (const auto& lib : file.usedlibs) write_string(out, lib);
+      write_value<uint32_t>(out, file.usedfonts.size());
+      for (const auto& font : file.usedfonts) write_string(out, font);
+      write_value<uint32_t>(out, file.indicatorData.size());
+      for (const auto& data : file.indicatorData) {
+        write_value<int32_t>(out, data.first_line);
+        write_value<int32_t>(out, data.first_col);
+        write_value<int32_t>(out, data.last_line);
+        write_value<int32_t>(out, data.last_col);
+        write_string(out, data.path);
+      }
+
+      EntryWriter writer(out);
+      writer.writeScope(file.scope);
+    } catch (const EntryError&) {
+      ok = false;
+    }
+    ok = ok && bool(out);
+  }
+
+  boost::system::error_code ec;
+  if (ok) fs::rename(tmppath, path, ec);
+  if (!ok || ec) {
+    fs::remove(tmppath, ec);
+    return false;
+  }
+  return true;
+}
+
+void SourceFileDiskCache::print()
+{
+  if (!isEnabled()) return;
+  LOG("Libraries loaded from disk cache: %1$d", this->numhits);
+}
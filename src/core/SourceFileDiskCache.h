@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include "hash.h"
+
+class SourceFile;
+
+/*!
+   Persistent cache of parsed library files (use<> and include<>).
+
+   Each library file has one entry in the cache directory, holding the
+   serialized AST together with hashes of the source text and of every
+   included file. An entry is only used if all of those are unchanged, so
+   editing a library simply overwrites its entry on the next parse.
+
+   Only files which parsed without any messages are stored, as a cached
+   parse can't reproduce warnings. The cache is disabled until a directory is
+   set, e.g. with --cache-dir.
+ */
+class SourceFileDiskCache
+{
+public:
+  SourceFileDiskCache() = default;
+
+  static SourceFileDiskCache *instance() { if (!inst) inst = new SourceFileDiskCache; return inst; }
+
+  bool setDirectory(const std::string& dir);
+  const std::string& directory() const { return this->dir; }
+  bool isEnabled() const { return !this->dir.empty(); }
+
+  // Returns a newly allocated SourceFile, or nullptr if there is no valid entry
+  SourceFile *get(const std::string& filename, const std::string& text);
+  bool insert(const std::string& filename, const std::string& text, const SourceFile& file);
+  size_t hits() const { return this->numhits; }
+  void print();
+
+private:
+  static SourceFileDiskCache *inst;
+
+  std::string entryPath(const std::string& filename) const;
+
+  std::string dir;
+  // Distinguishes entries written by different versions and configurations
+  Hash128 prefix;
+  size_t numhits{0};
+};
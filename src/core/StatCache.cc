@@ -27,7 +27,9 @@
 #include "StatCache.h"
 
 #include <string>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <chrono>
 
 namespace {
@@ -46,6 +48,16 @@ struct CacheEntry
 };
 
 std::unordered_map<std::string, CacheEntry> statMap;
+struct Resolution
+{
+  std::string path;
+  double timestamp;
+};
+std::unordered_map<std::string, Resolution> resolutions;
+std::unordered_set<std::string> watched;
+bool keep_all = false;
+// Batch jobs look up files from several threads
+std::mutex mutex;
 
 } // namespace
 
@@ -53,9 +65,10 @@ namespace StatCache {
 
 int stat(const std::string& path, struct ::stat &st)
 {
+  std::lock_guard<std::mutex> lock(mutex);
   auto iter = statMap.find(path);
   if (iter != statMap.end()) {                // Have we got an entry for this file?
-    if (millis_clock() - iter->second.timestamp < stale) {
+    if (keep_all || watched.count(path) || millis_clock() - iter->second.timestamp < stale) {
       st = iter->second.st;      // Not stale yet so return it
       return 0;
     }
@@ -66,4 +79,60 @@ int stat(const std::string& path, struct ::stat &st)
   return 0;
 }
 
+std::time_t mtime(const std::string& path)
+{
+  struct ::stat st;
+  return stat(path, st) == 0 ? st.st_mtime : 0;
+}
+
+void keepAll(bool keep)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  keep_all = keep;
+}
+
+void watch(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  watched.insert(path);
+}
+
+void unwatchAll()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  watched.clear();
+  resolutions.clear();
+}
+
+void invalidate(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  statMap.erase(path);
+  resolutions.clear();
+}
+
+void invalidateAll()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  statMap.clear();
+  resolutions.clear();
+}
+
+std::string resolve(const std::string& key, const std::function<std::string()>& resolver)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = resolutions.find(key);
+    if (iter != resolutions.end()) {
+      // Watched files report changes, so resolutions are kept while watching
+      if (keep_all || !watched.empty() || millis_clock() - iter->second.timestamp < stale) return iter->second.path;
+      resolutions.erase(iter);
+    }
+  }
+  auto path = resolver();
+  std::lock_guard<std::mutex> lock(mutex);
+  resolutions[key] = {path, millis_clock()};
+  return path;
+}
+
 } // namespace StatCache
@@ -26,11 +26,27 @@
 
 #pragma once
 
+#include <ctime>
+#include <functional>
 #include <string>
 #include <sys/stat.h>
 
 namespace StatCache {
 
 int stat(const std::string& path, struct ::stat& st);
+// The modification time of path, 0 if it doesn't exist
+std::time_t mtime(const std::string& path);
+// Keeps all results until invalidated, for runs not watching files
+void keepAll(bool keep);
+// Keeps the result for a file watched for changes until it is invalidated
+void watch(const std::string& path);
+void unwatchAll();
+// Drops the result for path, e.g. after it changed
+void invalidate(const std::string& path);
+void invalidateAll();
+// Resolves a file name, e.g. in the library path, once for the lifetime of
+// stat results. Failed resolutions (empty results) are cached too. Changes
+// to any file drop all resolutions, as they may depend on several paths.
+std::string resolve(const std::string& key, const std::function<std::string()>& resolver);
 
 }
@@ -36,15 +36,15 @@
 #include "handle_dep.h"
 #include "ext/lodepng/lodepng.h"
 #include "SurfaceNode.h"
+#include "StatCache.h"
+#include "parallel.h"
 
+#include <charconv>
 #include <cstdint>
 #include <sstream>
 #include <fstream>
-#include <unordered_map>
-#include <boost/functional/hash.hpp>
-#include <boost/tokenizer.hpp>
+#include <string_view>
 #include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string.hpp>
 #include <boost/assign/std/vector.hpp>
 using namespace boost::assign; // bring 'operator+=()' into scope
 
@@ -52,6 +52,23 @@ using namespace boost::assign; // bring 'operator+=()' into scope
 namespace fs = boost::filesystem;
 
 
+// Parses a whole token as a double, like boost::lexical_cast
+static bool parse_double(std::string_view token, double& value)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+  auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+  return result.ec == std::errc() && result.ptr == token.data() + token.size();
+#else
+  try {
+    value = boost::lexical_cast<double>(token.data(), token.size());
+    return true;
+  } catch (const boost::bad_lexical_cast&) {
+    return false;
+  }
+#endif
+}
+
 static std::shared_ptr<AbstractNode> builtin_surface(const ModuleInstantiation *inst, Arguments arguments, const Children& children)
 {
   if (!children.empty()) {
@@ -67,6 +84,7 @@ static std::shared_ptr<AbstractNode> builtin_surface(const ModuleInstantiation *
   auto filename = lookup_file(fileval, inst->location().filePath().parent_path().string(), parameters.documentRoot());
   node->filename = filename;
   handle_dep(fs::path(filename).generic_string());
+  parameters.session()->addExternalInput();
 
   if (parameters["center"].type() == Value::Type::BOOL) {
     node->center = parameters["center"].toBool();
@@ -87,18 +105,24 @@ void SurfaceNode::convert_image(img_data_t& data, std::vector<uint8_t>& img, uns
 {
   data.width = width;
   data.height = height;
-  data.reserve( (size_t)width * height);
-  double min_val = 200;
-  for (unsigned int y = 0; y < height; ++y) {
+  data.resize((size_t)width * height);
+  std::vector<unsigned int> rows(height);
+  for (unsigned int y = 0; y < height; ++y) rows[y] = y;
+  // Rows are converted in parallel, each returning its minimum
+  std::vector<double> row_min(height);
+  parallelizable_transform(rows.begin(), rows.end(), row_min.begin(), [&](unsigned int y) {
+    double min_val = 200;
     for (unsigned int x = 0; x < width; ++x) {
-      long idx = 4l * (y * width + x);
+      size_t idx = 4ul * ((size_t)y * width + x);
       double pixel = 0.2126 * img[idx] + 0.7152 * img[idx + 1] + 0.0722 * img[idx + 2];
       double z = 100.0 / 255 * (invert ? 1 - pixel : pixel);
-      data[ x + (width * (height - 1 - y)) ] = z;
+      data.storage[x + ((size_t)width * (height - 1 - y))] = z;
       min_val = std::min(z, min_val);
     }
-  }
-  data.min_val = min_val;
+    return min_val;
+  });
+  data.min_val = 200;
+  for (const auto v : row_min) data.min_val = std::min(v, data.min_val);
 }
 
 bool SurfaceNode::is_png(std::vector<uint8_t>& png) const
@@ -148,61 +172,59 @@ img_data_t SurfaceNode::read_png_or_dat(std::string filename) const
 img_data_t SurfaceNode::read_dat(std::string filename) const
 {
   img_data_t data;
-  std::ifstream stream(filename.c_str());
+  std::ifstream stream(filename.c_str(), std::ios::in | std::ios::binary);
 
   if (!stream.good()) {
     LOG(message_group::Warning, "Can't open DAT file '%1$s'.", filename);
     return data;
   }
+  const std::string text((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
 
-  int lines = 0, columns = 0;
+  size_t columns = 0;
   double min_val = 1; // this balances out with the (min_val-1) inside createGeometry, to match old behavior
 
-  using tokenizer = boost::tokenizer<boost::char_separator<char>>;
-  boost::char_separator<char> sep(" \t");
-
-  // We use an unordered map because the data file may not be rectangular,
-  // and we may need to fill in some bits.
-  using unordered_image_data_t = std::unordered_map<std::pair<int, int>, double, boost::hash<std::pair<int, int>>>;
-  unordered_image_data_t unordered_data;
-
-  while (!stream.eof()) {
-    std::string line;
-    while (!stream.eof() && (line.size() == 0 || line[0] == '#')) {
-      std::getline(stream, line);
-      boost::trim(line);
-    }
-    if (line.size() == 0 && stream.eof()) break;
-
-    int col = 0;
-    tokenizer tokens(line, sep);
-    try {
-      for (const auto& token : tokens) {
-        auto v = boost::lexical_cast<double>(token);
-        unordered_data[ std::make_pair(lines, col++) ] = v;
-        if (col > columns) columns = col;
-        min_val = std::min(v, min_val);
+  // The data file may not be rectangular, short rows are filled with zeros
+  std::vector<std::vector<double>> rows;
+  for (size_t pos = 0; pos < text.size();) {
+    const size_t end = std::min(text.find('\n', pos), text.size());
+    std::string_view line(text.data() + pos, end - pos);
+    const bool last = end + 1 >= text.size();
+    pos = end + 1;
+
+    const auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; };
+    while (!line.empty() && is_space(line.front())) line.remove_prefix(1);
+    while (!line.empty() && is_space(line.back())) line.remove_suffix(1);
+    if (line.empty() || line[0] == '#') continue;
+
+    std::vector<double> row;
+    while (!line.empty()) {
+      size_t len = 0;
+      while (len < line.size() && line[len] != ' ' && line[len] != '\t') ++len;
+      const auto token = line.substr(0, len);
+      double v;
+      if (!parse_double(token, v)) {
+        // A partial last line is ignored, like stream extraction used to
+        if (!last) {
+          LOG(message_group::Warning, "Illegal value in '%1$s': '%2$s'", filename, std::string(token));
+        }
+        return data;
       }
-    } catch (const boost::bad_lexical_cast& blc) {
-      if (!stream.eof()) {
-        LOG(message_group::Warning, "Illegal value in '%1$s': %2$s", filename, blc.what());
-      }
-      return data;
+      row.push_back(v);
+      min_val = std::min(v, min_val);
+      line.remove_prefix(len);
+      while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) line.remove_prefix(1);
     }
-
-    lines++;
+    columns = std::max(columns, row.size());
+    rows.push_back(std::move(row));
   }
 
   data.width = columns;
-  data.height = lines;
+  data.height = rows.size();
   data.min_val = min_val;
-
-  // Now convert the unordered, possibly non-rectangular data into a well ordered vector
-  // for faster access and reduced memory usage.
-  data.resize( (size_t)lines * columns);
-  for (int i = 0; i < lines; ++i)
-    for (int j = 0; j < columns; ++j)
-      data[ i * columns + j ] = unordered_data[std::make_pair(i, j)];
+  data.resize(rows.size() * columns);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    std::copy(rows[i].begin(), rows[i].end(), data.storage.begin() + i * columns);
+  }
 
   return data;
 }
@@ -219,41 +241,49 @@ const Geometry *SurfaceNode::createGeometry() const
   double min_val = data.min_value() - 1; // make the bottom solid, and match old code
 
   // reserve the polygon vector size so we don't have to reallocate as often
-  p->polygons.reserve( (lines - 1) * (columns - 1) * 4 + (lines - 1) * 2 + (columns - 1) * 2 + 1);
+  auto& faces = p->mutablePolygons();
+  faces.reserve( (lines - 1) * (columns - 1) * 4 + (lines - 1) * 2 + (columns - 1) * 2 + 1);
 
   double ox = center ? -(columns - 1) / 2.0 : 0;
   double oy = center ? -(lines - 1) / 2.0 : 0;
 
-  // the bulk of the heightmap
-  for (int i = 1; i < lines; ++i)
+  // the bulk of the heightmap, built in parallel by rows
+  std::vector<int> rows(lines > 1 ? lines - 1 : 0);
+  for (size_t i = 0; i < rows.size(); ++i) rows[i] = i + 1;
+  std::vector<Polygons> row_polygons(rows.size());
+  parallelizable_transform(rows.begin(), rows.end(), row_polygons.begin(), [&](int i) {
+    Polygons polygons;
+    polygons.reserve((columns - 1) * 4);
     for (int j = 1; j < columns; ++j) {
       double v1 = data[ (j - 1) + (i - 1) * columns ];
       double v2 = data[ (j) + (i - 1) * columns ];
       double v3 = data[ (j - 1) + (i) * columns ];
       double v4 = data[ (j) + (i) * columns ];
 
-      double vx = (v1 + v2 + v3 + v4) / 4;
-
-      p->append_poly(3);
-      p->append_vertex(ox + j - 1, oy + i - 1, v1);
-      p->append_vertex(ox + j, oy + i - 1, v2);
-      p->append_vertex(ox + j - 0.5, oy + i - 0.5, vx);
+      const Vector3d p1(ox + j - 1, oy + i - 1, v1);
+      const Vector3d p2(ox + j, oy + i - 1, v2);
+      const Vector3d p3(ox + j - 1, oy + i, v3);
+      const Vector3d p4(ox + j, oy + i, v4);
 
-      p->append_poly(3);
-      p->append_vertex(ox + j, oy + i - 1, v2);
-      p->append_vertex(ox + j, oy + i, v4);
-      p->append_vertex(ox + j - 0.5, oy + i - 0.5, vx);
-
-      p->append_poly(3);
-      p->append_vertex(ox + j, oy + i, v4);
-      p->append_vertex(ox + j - 1, oy + i, v3);
-      p->append_vertex(ox + j - 0.5, oy + i - 0.5, vx);
+      // A flat cell needs no center vertex
+      if (v1 == v2 && v1 == v3 && v1 == v4) {
+        polygons.push_back({p1, p2, p4});
+        polygons.push_back({p4, p3, p1});
+        continue;
+      }
 
-      p->append_poly(3);
-      p->append_vertex(ox + j - 1, oy + i, v3);
-      p->append_vertex(ox + j - 1, oy + i - 1, v1);
-      p->append_vertex(ox + j - 0.5, oy + i - 0.5, vx);
+      const Vector3d px(ox + j - 0.5, oy + i - 0.5, (v1 + v2 + v3 + v4) / 4);
+      polygons.push_back({p1, p2, px});
+      polygons.push_back({p2, p4, px});
+      polygons.push_back({p4, p3, px});
+      polygons.push_back({p3, p1, px});
     }
+    return polygons;
+  });
+  for (auto& polygons : row_polygons) {
+    std::move(polygons.begin(), polygons.end(), std::back_inserter(faces));
+    Polygons().swap(polygons);
+  }
 
   // edges along Y
   for (int i = 1; i < lines; ++i) {
@@ -319,7 +349,7 @@ std::string SurfaceNode::toString() const
   stream << this->name() << "(file = " << this->filename
          << ", center = " << (this->center ? "true" : "false")
          << ", invert = " << (this->invert ? "true" : "false")
-         << ", " "timestamp = " << (fs::exists(path) ? fs::last_write_time(path) : 0)
+         << ", " "timestamp = " << StatCache::mtime(path.string())
          << ")";
 
   return stream.str();
@@ -1,5 +1,6 @@
 #include "Tree.h"
 #include "NodeDumper.h"
+#include "Feature.h"
 
 #include <cassert>
 #include <algorithm>
@@ -15,10 +16,11 @@ Tree::~Tree()
    Returns the cached string representation of the subtree rooted by \a node.
    If node is not cached, the cache will be rebuilt.
  */
-const std::string Tree::getString(const AbstractNode& node, const std::string& indent) const
+std::string_view Tree::getString(const AbstractNode& node, const std::string& indent) const
 {
   assert(this->root_node);
   bool idString = false;
+  std::lock_guard<std::mutex> lock(this->mutex);
 
   // Retrieve a nodecache given a tuple of NodeDumper constructor options
   NodeCache& nodecache = this->nodecachemap[std::make_tuple(indent, idString)];
@@ -32,6 +34,17 @@ const std::string Tree::getString(const AbstractNode& node, const std::string& i
   return nodecache[node];
 }
 
+/*!
+   Writes the string representation of the subtree rooted by \a node to the
+   stream while it's generated, rather than building the whole dump first.
+   Indentation starts at the node.
+ */
+void Tree::writeString(const AbstractNode& node, const std::string& indent, std::ostream& out) const
+{
+  NodeDumper dumper(out, node.shared_from_this(), indent);
+  dumper.traverse(node);
+}
+
 /*!
    Returns the cached ID string representation of the subtree rooted by \a node.
    If node is not cached, the cache will be rebuilt.
@@ -40,7 +53,28 @@ const std::string Tree::getString(const AbstractNode& node, const std::string& i
    is stripped for whitespace. Especially indentation whitespace is important to
    strip to enable cache hits for equivalent nodes from different scopes.
  */
-const std::string Tree::getIdString(const AbstractNode& node) const
+std::string_view Tree::getIdString(const AbstractNode& node) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return getIdCache(node)[node];
+}
+
+/*!
+   Returns the cached structural hash of the subtree rooted by \a node.
+   If node is not cached, the cache will be rebuilt.
+
+   The hash is computed alongside the ID string and identifies the same subtrees,
+   but is cheap to compare and store regardless of the subtree size. This is what
+   the geometry caches are keyed on.
+ */
+const Hash128 Tree::getIdHash(const AbstractNode& node) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return getIdCache(node).hash(node);
+}
+
+// Expects the mutex to be held
+NodeCache& Tree::getIdCache(const AbstractNode& node) const
 {
   assert(this->root_node);
   const std::string indent = "";
@@ -49,14 +83,15 @@ const std::string Tree::getIdString(const AbstractNode& node) const
   // Retrieve a nodecache given a tuple of NodeDumper constructor options
   NodeCache& nodecache = this->nodecachemap[make_tuple(indent, idString)];
 
-  if (!nodecache.contains(node)) {
+  if (!nodecache.contains(node) || !nodecache.containsHash(node)) {
     nodecache.clear();
-    NodeDumper dumper(nodecache, this->root_node, indent, idString);
+    NodeDumper dumper(nodecache, this->root_node, indent, idString, &this->previousIdCache);
     dumper.traverse(*this->root_node);
     assert(nodecache.contains(*this->root_node) &&
            "NodeDumper failed to create id cache");
+    this->previousIdCache.clear();
   }
-  return nodecache[node];
+  return nodecache;
 }
 
 /*!
@@ -64,7 +99,16 @@ const std::string Tree::getIdString(const AbstractNode& node) const
  */
 void Tree::setRoot(const std::shared_ptr<const AbstractNode> &root)
 {
+  std::lock_guard<std::mutex> lock(this->mutex);
   this->root_node = root;
+  this->previousIdCache.clear();
+  if (Feature::ExperimentalIncrementalEval.is_enabled()) {
+    // Node objects shared with the new tree keep their dumps
+    const auto it = this->nodecachemap.find(make_tuple(std::string(), true));
+    if (it != this->nodecachemap.end() && it->second.hasSubtrees()) {
+      this->previousIdCache = std::move(it->second);
+    }
+  }
   this->nodecachemap.clear();
 }
 
@@ -2,6 +2,9 @@
 
 #include "NodeCache.h"
 #include <map>
+#include <mutex>
+#include <ostream>
+#include <string_view>
 #include <utility>
 
 /*!
@@ -9,6 +12,11 @@
    cache based on node indices around.
 
    Note that since node trees don't survive a recompilation, the tree cannot either.
+   With incremental evaluation, the nodes kept from the previous tree have their
+   id strings and hashes copied from its id cache instead of dumped again.
+
+   Lookups may come from the worker threads of parallel evaluation, so the
+   caches are guarded by a mutex.
  */
 class Tree
 {
@@ -20,13 +28,22 @@ public:
   void setDocumentPath(const std::string& path);
   const std::shared_ptr<const AbstractNode>& root() const { return this->root_node; }
 
-  const std::string getString(const AbstractNode& node, const std::string& indent) const;
-  const std::string getIdString(const AbstractNode& node) const;
+  // The views point into the tree's cache, and stay valid until the cache is rebuilt
+  std::string_view getString(const AbstractNode& node, const std::string& indent) const;
+  std::string_view getIdString(const AbstractNode& node) const;
+  // Dumps the subtree without caching it, e.g. for CSG export of huge trees
+  void writeString(const AbstractNode& node, const std::string& indent, std::ostream& out) const;
+  const Hash128 getIdHash(const AbstractNode& node) const;
   const std::string getDocumentPath() const;
 
 private:
+  NodeCache& getIdCache(const AbstractNode& node) const;
+
   std::shared_ptr<const AbstractNode> root_node;
   // keep a separate nodecache per tuple of NodeDumper constructor parameters
   mutable std::map<std::tuple<std::string, bool>, NodeCache> nodecachemap;
+  // The id cache of the previous root, until the new one is dumped
+  mutable NodeCache previousIdCache;
+  mutable std::mutex mutex;
   std::string document_path;
 };
@@ -32,7 +32,12 @@
 #include "ScopeContext.h"
 #include "Expression.h"
 #include "printutils.h"
+#include "EvalProfiler.h"
+#include "EvaluationSession.h"
+#include "InstantiationCache.h"
+#include "ModuleCache.h"
 #include "compiler_specific.h"
+#include <memory>
 #include <sstream>
 
 std::vector<std::string> StaticModuleNameStack::stack;
@@ -80,11 +85,33 @@ std::shared_ptr<AbstractNode> UserModule::instantiate(const std::shared_ptr<cons
   }
 
   StaticModuleNameStack name{inst->name()}; // push on static stack, pop at end of method!
+  EvalProfiler::Call profile{"module", inst->name(), inst->location(), context->session()->accounting()};
+  Arguments arguments(inst->arguments, context);
+  auto target = std::make_shared<GroupNode>(inst, std::string("module ") + this->name);
+
+  boost::optional<ModuleCache::Call> cache_call;
+  if (!inst->scope.hasChildren()) cache_call = ModuleCache::instance()->makeCall(this, defining_context, arguments);
+  if (cache_call) {
+    if (auto children = ModuleCache::instance()->get(*cache_call, *context->session())) {
+      target->children = std::move(*children);
+      return target;
+    }
+  }
+  // Lookups from frames existing before the call, including those of default
+  // parameter values, decide if its nodes can be reused
+  DependencyRecorder recorder;
+  std::unique_ptr<RecordingScope> recording;
+  if (cache_call) {
+    recorder.frames.insert(context->session()->frames().begin(), context->session()->frames().end());
+    recording = std::make_unique<RecordingScope>(context->session(), &recorder);
+  }
+  const size_t messages = print_message_count;
+
   ContextHandle<UserModuleContext> module_context{Context::create<UserModuleContext>(
                                                     defining_context,
                                                     this,
                                                     inst->location(),
-                                                    Arguments(inst->arguments, context),
+                                                    std::move(arguments),
                                                     Children(&inst->scope, context)
                                                     )};
 #if 0 && DEBUG
@@ -94,7 +121,7 @@ std::shared_ptr<AbstractNode> UserModule::instantiate(const std::shared_ptr<cons
 
   std::shared_ptr<AbstractNode> ret;
   try{
-    ret = this->body.instantiateModules(*module_context, std::make_shared<GroupNode>(inst, std::string("module ") + this->name));
+    ret = this->body.instantiateModules(*module_context, target);
   } catch (EvaluationException& e) {
     if (OpenSCAD::traceUsermoduleParameters && e.traceDepth > 0) {
       print_trace(this, *module_context, this->parameters);
@@ -102,6 +129,10 @@ std::shared_ptr<AbstractNode> UserModule::instantiate(const std::shared_ptr<cons
     }
     throw;
   }
+  recording.reset();
+  if (cache_call && print_message_count == messages) {
+    ModuleCache::instance()->insert(std::move(*cache_call), std::move(recorder), ret);
+  }
   return ret;
 }
 
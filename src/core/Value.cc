@@ -29,6 +29,7 @@
 #include <numeric>
 #include <sstream>
 #include <boost/lexical_cast.hpp>
+#include <Eigen/Core>
 
 #include "Value.h"
 #include "EvaluationSession.h"
@@ -533,11 +534,20 @@ VectorType::VectorType(class EvaluationSession *session, double x, double y, dou
   emplace_back(z);
 }
 
+void VectorType::VectorObject::count(const Value& val, bool first)
+{
+  if (val.type() != Value::Type::NUMBER) ++non_numbers;
+  const bool numeric_row = val.type() == Value::Type::VECTOR && val.toVector().isNumeric();
+  if (first) row_length = numeric_row ? val.toVector().size() : 0;
+  if (!numeric_row || row_length == 0 || val.toVector().size() != row_length) ++irregular_rows;
+}
+
 void VectorType::emplace_back(Value&& val)
 {
   if (val.type() == Value::Type::EMBEDDED_VECTOR) {
     emplace_back(std::move(val.toEmbeddedVectorNonConst()));
   } else {
+    ptr->count(val, ptr->vec.empty());
     ptr->vec.push_back(std::move(val));
     if (ptr->evaluation_session) {
       ptr->evaluation_session->accounting().addVectorElement(1);
@@ -545,6 +555,11 @@ void VectorType::emplace_back(Value&& val)
   }
 }
 
+void VectorType::add_vector_elements(size_t count)
+{
+  ptr->evaluation_session->accounting().addVectorElement(count);
+}
+
 // Specialized handler for EmbeddedVectorTypes
 void VectorType::emplace_back(EmbeddedVectorType&& mbed)
 {
@@ -552,6 +567,7 @@ void VectorType::emplace_back(EmbeddedVectorType&& mbed)
     // embed_excess represents how many to add to vec.size() to get the total elements after flattening,
     // the embedded vector itself already counts towards an element in the parent's size, so subtract 1 from its size.
     ptr->embed_excess += mbed.size() - 1;
+    ptr->count(Value::undefined, ptr->vec.empty()); // The shape is only known after flattening
     ptr->vec.emplace_back(std::move(mbed));
     if (ptr->evaluation_session) {
       ptr->evaluation_session->accounting().addVectorElement(1);
@@ -579,6 +595,49 @@ void VectorType::flatten() const
     ptr->evaluation_session->accounting().removeVectorElement(ptr->vec.size());
   }
   ptr->vec = std::move(ret);
+  ptr->offsets.clear();
+  ptr->lookup_cost = 0;
+  ptr->non_numbers = ptr->irregular_rows = 0;
+  for (size_t i = 0; i < ptr->vec.size(); ++i) ptr->count(ptr->vec[i], i == 0);
+}
+
+/*!
+   Finds the element by binary search of the start indices of the elements,
+   descending into embedded vectors, so indexing a concatenation doesn't copy
+   it. Accesses deep into long chains of concatenations add up though, so the
+   vector is flattened once they have descended as many levels as it has
+   elements.
+ */
+const Value& VectorType::lookup(size_t idx) const
+{
+  if (ptr->lookup_cost > ptr->size()) {
+    flatten();
+    return ptr->vec[idx];
+  }
+  VectorObject *vo = ptr.get();
+  size_type levels = 0;
+  while (vo->embed_excess) {
+    auto& offsets = vo->offsets;
+    size_type start = offsets.empty() ? 0 : offsets.back();
+    for (size_t i = offsets.size(); i < vo->vec.size(); ++i) {
+      if (i > 0) {
+        const Value& previous = vo->vec[i - 1];
+        start += previous.type() == Value::Type::EMBEDDED_VECTOR ? previous.toEmbeddedVector().size() : 1;
+      }
+      offsets.push_back(start);
+    }
+    const auto it = std::upper_bound(offsets.begin(), offsets.end(), idx) - 1;
+    const Value& element = vo->vec[it - offsets.begin()];
+    if (element.type() != Value::Type::EMBEDDED_VECTOR) {
+      ptr->lookup_cost += levels;
+      return element;
+    }
+    idx -= *it;
+    vo = element.toEmbeddedVector().ptr.get();
+    ++levels;
+  }
+  ptr->lookup_cost += levels;
+  return vo->vec[idx];
 }
 
 void VectorType::VectorObjectDeleter::operator()(VectorObject *v)
@@ -876,6 +935,12 @@ public:
     // FIXME: should we really truncate to shortest vector here?
     //   Maybe better to either "add zeroes" and return longest
     //   and/or issue an warning/error about length mismatch.
+    if (op1.isNumeric() && op2.isNumeric()) {
+      for (size_t i = 0; i < op1.size() && i < op2.size(); ++i) {
+        sum.emplace_back(op1[i].toDouble() + op2[i].toDouble());
+      }
+      return std::move(sum);
+    }
     for (auto it1 = op1.begin(), end1 = op1.end(), it2 = op2.begin(), end2 = op2.end();
          it1 != end1 && it2 != end2;
          ++it1, ++it2) {
@@ -904,6 +969,12 @@ public:
   Value operator()(const VectorType& op1, const VectorType& op2) const {
     VectorType sum(op1.evaluation_session());
     sum.reserve(op1.size());
+    if (op1.isNumeric() && op2.isNumeric()) {
+      for (size_t i = 0; i < op1.size() && i < op2.size(); ++i) {
+        sum.emplace_back(op1[i].toDouble() - op2[i].toDouble());
+      }
+      return std::move(sum);
+    }
     for (size_t i = 0; i < op1.size() && i < op2.size(); ++i) {
       sum.emplace_back(op1[i] - op2[i]);
     }
@@ -921,17 +992,75 @@ Value multvecnum(const VectorType& vecval, const Value& numval)
   // Vector * Number
   VectorType dstv(vecval.evaluation_session());
   dstv.reserve(vecval.size());
+  if (vecval.isNumeric()) {
+    const double factor = numval.toDouble();
+    for (size_t i = 0; i < vecval.size(); ++i) dstv.emplace_back(vecval[i].toDouble() * factor);
+    return std::move(dstv);
+  }
   for (const auto& val : vecval) {
     dstv.emplace_back(val * numval);
   }
   return std::move(dstv);
 }
 
+using RowMajorMatrix = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+// Copies a matrix of numbers (see VectorType::numericRowLength()) into contiguous storage
+template <typename Matrix>
+static Matrix toEigenMatrix(const VectorType& rows, size_t cols)
+{
+  Matrix matrix(rows.size(), cols);
+  Eigen::Index i = 0;
+  for (const auto& row : rows) {
+    const auto& rowvec = row.toVector();
+    for (size_t j = 0; j < cols; ++j) matrix(i, j) = rowvec[j].toDouble();
+    ++i;
+  }
+  return matrix;
+}
+
+static VectorType fromEigenVector(const Eigen::Ref<const Eigen::RowVectorXd>& vec, EvaluationSession *session)
+{
+  VectorType dstv(session);
+  dstv.reserve(vec.size());
+  for (Eigen::Index i = 0; i < vec.size(); ++i) dstv.emplace_back(vec[i]);
+  return dstv;
+}
+
+/*
+   The products of numeric matrices below accumulate whole rows or columns
+   as vector operations, which Eigen vectorizes. Each result element is still
+   summed in the same order as by the scalar loops, so results are identical.
+ */
+static VectorType multvecmat_numeric(const VectorType& vectorvec, const RowMajorMatrix& matrix, EvaluationSession *session)
+{
+  Eigen::RowVectorXd result = Eigen::RowVectorXd::Zero(matrix.cols());
+  for (Eigen::Index j = 0; j < matrix.rows(); ++j) result += vectorvec[j].toDouble() * matrix.row(j);
+  return fromEigenVector(result, session);
+}
+
+static Value multmatmat_numeric(const VectorType& matrix1, const VectorType& matrix2)
+{
+  const auto matrix = toEigenMatrix<RowMajorMatrix>(matrix2, matrix2.numericRowLength());
+  VectorType dstv(matrix1.evaluation_session());
+  dstv.reserve(matrix1.size());
+  for (const auto& row : matrix1) {
+    dstv.emplace_back(multvecmat_numeric(row.toVector(), matrix, matrix1.evaluation_session()));
+  }
+  return {std::move(dstv)};
+}
+
 Value multmatvec(const VectorType& matrixvec, const VectorType& vectorvec)
 {
   // Matrix * Vector
   VectorType dstv(matrixvec.evaluation_session());
   dstv.reserve(matrixvec.size());
+  if (!vectorvec.empty() && matrixvec.numericRowLength() == vectorvec.size() && vectorvec.isNumeric()) {
+    const auto matrix = toEigenMatrix<Eigen::MatrixXd>(matrixvec, vectorvec.size());
+    Eigen::VectorXd result = Eigen::VectorXd::Zero(matrix.rows());
+    for (Eigen::Index j = 0; j < matrix.cols(); ++j) result += matrix.col(j) * vectorvec[j].toDouble();
+    return fromEigenVector(result.transpose(), matrixvec.evaluation_session());
+  }
   for (size_t i = 0; i < matrixvec.size(); ++i) {
     if (matrixvec[i].type() != Value::Type::VECTOR ||
         matrixvec[i].toVector().size() != vectorvec.size()) {
@@ -959,6 +1088,9 @@ Value multvecmat(const VectorType& vectorvec, const VectorType& matrixvec)
   VectorType dstv(matrixvec[0].toVector().evaluation_session());
   size_t firstRowSize = matrixvec[0].toVector().size();
   dstv.reserve(firstRowSize);
+  if (firstRowSize > 0 && matrixvec.numericRowLength() == firstRowSize && vectorvec.isNumeric()) {
+    return multvecmat_numeric(vectorvec, toEigenMatrix<RowMajorMatrix>(matrixvec, firstRowSize), dstv.evaluation_session());
+  }
   for (size_t i = 0; i < firstRowSize; ++i) {
     double r_e = 0.0;
     for (size_t j = 0; j < vectorvec.size(); ++j) {
@@ -985,6 +1117,10 @@ Value multvecmat(const VectorType& vectorvec, const VectorType& matrixvec)
 Value multvecvec(const VectorType& vec1, const VectorType& vec2) {
   // Vector dot product.
   auto r = 0.0;
+  if (vec1.isNumeric() && vec2.isNumeric()) {
+    for (size_t i = 0; i < vec1.size(); i++) r += vec1[i].toDouble() * vec2[i].toDouble();
+    return {r};
+  }
   for (size_t i = 0; i < vec1.size(); i++) {
     if (vec1[i].type() != Value::Type::NUMBER || vec2[i].type() != Value::Type::NUMBER) {
       return Value::undef(STR("undefined operation (", vec1[i].typeName(), " * ", vec2[i].typeName(), ")"));
@@ -1023,6 +1159,9 @@ public:
       } else if (eltype2 == Value::Type::VECTOR) {
         if ((*first1).toVector().size() == op2.size()) {
           // Matrix * Matrix
+          if (op1.numericRowLength() == op2.size() && op2.numericRowLength() > 0) {
+            return multmatmat_numeric(op1, op2);
+          }
           VectorType dstv(op1.evaluation_session());
           dstv.reserve(op1.size());
           size_t i = 0;
@@ -1058,9 +1197,15 @@ Value Value::operator/(const Value& v) const
   if (this->type() == Type::NUMBER && v.type() == Type::NUMBER) {
     return this->toDouble() / v.toDouble();
   } else if (this->type() == Type::VECTOR && v.type() == Type::NUMBER) {
-    VectorType dstv(this->toVector().evaluation_session());
-    dstv.reserve(this->toVector().size());
-    for (const auto& vecval : this->toVector()) {
+    const auto& vec = this->toVector();
+    VectorType dstv(vec.evaluation_session());
+    dstv.reserve(vec.size());
+    if (vec.isNumeric()) {
+      const double divisor = v.toDouble();
+      for (size_t i = 0; i < vec.size(); ++i) dstv.emplace_back(vec[i].toDouble() / divisor);
+      return std::move(dstv);
+    }
+    for (const auto& vecval : vec) {
       dstv.emplace_back(vecval / v);
     }
     return std::move(dstv);
@@ -1088,9 +1233,14 @@ Value Value::operator-() const
   if (this->type() == Type::NUMBER) {
     return {-this->toDouble()};
   } else if (this->type() == Type::VECTOR) {
-    VectorType dstv(this->toVector().evaluation_session());
-    dstv.reserve(this->toVector().size());
-    for (const auto& vecval : this->toVector()) {
+    const auto& vec = this->toVector();
+    VectorType dstv(vec.evaluation_session());
+    dstv.reserve(vec.size());
+    if (vec.isNumeric()) {
+      for (size_t i = 0; i < vec.size(); ++i) dstv.emplace_back(-vec[i].toDouble());
+      return std::move(dstv);
+    }
+    for (const auto& vecval : vec) {
       dstv.emplace_back(-vecval);
     }
     return std::move(dstv);
@@ -1187,22 +1337,33 @@ ObjectType::ObjectType(EvaluationSession *session) :
 
 const Value& ObjectType::get(const std::string& key) const
 {
-  auto result = ptr->map.find(key);
+  const size_t index = ptr->shape->find(key);
   // NEEDSWORK it would be nice to have a "cause" for the undef, but Value::undef(...)
   // does not appear compatible with Value&.
-  return result == ptr->map.end() ? Value::undefined : result->second;
+  return index == ObjectShape::npos ? Value::undefined : ptr->values[index];
 }
 
+// The first value of a key is kept
 void ObjectType::set(const std::string& key, Value&& value)
 {
-  ptr->map.emplace(key, value.clone());
-  ptr->keys.emplace_back(key);
+  if (ptr->shape->find(key) != ObjectShape::npos) return;
+  ObjectShape::append(ptr->shape, key);
   ptr->values.emplace_back(std::move(value));
 }
 
 const std::vector<std::string>& ObjectType::keys() const
 {
-  return ptr->keys;
+  return ptr->shape->keys();
+}
+
+const shared_ptr<ObjectShape>& ObjectType::shape() const
+{
+  return ptr->shape;
+}
+
+const Value& ObjectType::slot(size_t index) const
+{
+  return ptr->values[index];
 }
 
 const Value& ObjectType::operator[](const str_utf8_wrapper& v) const
@@ -1216,13 +1377,76 @@ ObjectType ObjectType::clone() const
   return ObjectType(this->ptr);
 }
 
+namespace {
+
+// Keys of smaller shapes are searched linearly
+constexpr size_t maxUnindexedKeys = 8;
+// Larger shapes are owned by their object, as records rarely get that big
+constexpr size_t maxSharedKeys = 64;
+
+} // namespace
+
+shared_ptr<ObjectShape> ObjectShape::empty()
+{
+  static const auto shape = std::make_shared<ObjectShape>();
+  return shape;
+}
+
+size_t ObjectShape::find(const std::string& key) const
+{
+  if (this->keyList.size() <= maxUnindexedKeys) {
+    const auto it = std::find(this->keyList.begin(), this->keyList.end(), key);
+    return it == this->keyList.end() ? npos : it - this->keyList.begin();
+  }
+  const auto it = this->index.find(key);
+  return it == this->index.end() ? npos : it->second;
+}
+
+void ObjectShape::add(const std::string& key)
+{
+  this->keyList.push_back(key);
+  if (this->keyList.size() == maxUnindexedKeys + 1) {
+    for (size_t i = 0; i < this->keyList.size(); ++i) this->index.emplace(this->keyList[i], i);
+  } else if (this->keyList.size() > maxUnindexedKeys + 1) {
+    this->index.emplace(key, this->keyList.size() - 1);
+  }
+}
+
+void ObjectShape::append(shared_ptr<ObjectShape>& shape, const std::string& key)
+{
+  if (shape->owned && shape.use_count() == 1) {
+    shape->add(key);
+    return;
+  }
+  if (shape->keyList.size() >= maxSharedKeys) {
+    auto copy = std::make_shared<ObjectShape>();
+    copy->keyList = shape->keyList;
+    copy->index = shape->index;
+    copy->owned = true;
+    copy->add(key);
+    shape = std::move(copy);
+    return;
+  }
+  auto& transition = shape->transitions[key];
+  auto next = transition.lock();
+  if (!next) {
+    next = std::make_shared<ObjectShape>();
+    next->keyList = shape->keyList;
+    next->index = shape->index;
+    next->add(key);
+    transition = next;
+  }
+  shape = std::move(next);
+}
+
 std::ostream& operator<<(std::ostream& stream, const ObjectType& v)
 {
   stream << "{ ";
-  auto iter = v.ptr->keys.begin();
-  if (iter != v.ptr->keys.end()) {
+  const auto& keys = v.keys();
+  auto iter = keys.begin();
+  if (iter != keys.end()) {
     str_utf8_wrapper k(*iter);
-    for (; iter != v.ptr->keys.end(); ++iter) {
+    for (; iter != keys.end(); ++iter) {
       str_utf8_wrapper k2(*iter);
       stream << k2.toString() << " = " << v[k2] << "; ";
     }
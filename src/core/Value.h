@@ -9,6 +9,7 @@
 #include <ostream>
 #include <memory>
 #include <type_traits>
+#include <unordered_map>
 #include <variant>
 
 #include "FunctionType.h"
@@ -22,6 +23,8 @@ class tostring_visitor;
 class tostream_visitor;
 class Expression;
 class Value;
+class ObjectShape;
+struct VectorIndex;
 
 class QuotedString : public std::string
 {
@@ -99,8 +102,8 @@ public:
    * by treating their elements as elements of their parent, traversable via VectorType's custom iterator.
    * -- An embedded vector should never exist "in the wild", only as a pseudo-element of a parent vector.
    *    Eg "Lc*" Expressions return Embedded Vectors but they are necessarily child expressions of a Vector expression.
-   * -- Any VectorType containing embedded elements will be forced to "flatten" upon usage of operator[],
-   *    which is the only case of random-access.
+   * -- Random access by operator[] descends through the embedded vectors by the start indices of their elements.
+   *    Only once those accesses have cost as much as copying the elements is the VectorType "flattened".
    * -- Any loops through VectorTypes should prefer automatic range-based for loops eg: for(const auto& value : vec) { ... }
    *    which make use of begin() and end() iterators of VectorType.  https://en.cppreference.com/w/cpp/language/range-for
    * -- Moving a temporary Value of type VectorType or EmbeddedVectorType is always safe,
@@ -125,8 +128,16 @@ protected:
       vec_t vec;
       size_type embed_excess = 0; // Keep count of the number of embedded elements *excess of* vec.size()
       class EvaluationSession *evaluation_session = nullptr; // Used for heap size bookkeeping. May be null for vectors of known small maximum size.
+      // Shape of vec, kept up to date on insertion so numeric code can skip per-element type checks
+      size_type non_numbers = 0;    // Number of elements which aren't numbers
+      size_type row_length = 0;     // Size of the first element, if it is a vector of numbers
+      size_type irregular_rows = 0; // Number of elements which aren't vectors of row_length numbers
       [[nodiscard]] size_type size() const { return vec.size() + embed_excess;  }
       [[nodiscard]] bool empty() const { return vec.empty() && embed_excess == 0;  }
+      void count(const Value& val, bool first); // Update the shape for val being added to vec
+      std::shared_ptr<VectorIndex> index; // Built by builtins repeatedly searching this vector, see builtin_functions.cc
+      std::vector<size_type> offsets; // Start index of the elements of vec, built by random accesses while embed_excess is non-zero
+      size_type lookup_cost = 0;      // Embedded levels descended by random accesses so far
     };
     using vec_t = VectorObject::vec_t;
 public:
@@ -143,6 +154,7 @@ protected:
     void flatten() const; // flatten replaces VectorObject::vec with a new vector
                           // where any embedded elements are copied directly into the top level vec,
                           // leaving only true elements for straightforward indexing by operator[].
+    [[nodiscard]] const Value& lookup(size_t idx) const; // operator[] while there are embedded elements
     explicit VectorType(const shared_ptr<VectorObject>& copy) : ptr(copy) { } // called by clone()
 public:
     using size_type = VectorObject::size_type;
@@ -225,11 +237,14 @@ public:
     [[nodiscard]] const_iterator   end() const { return iterator(ptr.get(), true); }
     [[nodiscard]] size_type size() const { return ptr->size(); }
     [[nodiscard]] bool empty() const { return ptr->empty(); }
+    // All elements are numbers, so toDouble() can be used on them without checking their type
+    [[nodiscard]] bool isNumeric() const { return ptr->non_numbers == 0; }
+    // If all elements are non-empty vectors of numbers of the same size, that size, else 0
+    [[nodiscard]] size_type numericRowLength() const { return ptr->irregular_rows == 0 ? ptr->row_length : 0; }
     // const accesses to VectorObject require .clone to be move-able
     const Value& operator[](size_t idx) const {
       if (idx < this->size()) {
-        if (ptr->embed_excess) flatten();
-        return ptr->vec[idx];
+        return ptr->embed_excess ? lookup(idx) : ptr->vec[idx];
       } else {
         return Value::undefined;
       }
@@ -245,6 +260,17 @@ public:
     void emplace_back(Value&& val);
     void emplace_back(EmbeddedVectorType&& mbed);
     template <typename ... Args> void emplace_back(Args&&... args) { emplace_back(Value(std::forward<Args>(args)...)); }
+    // Appends count numbers returned by next(), updating the shape and heap accounting once
+    template <typename F> void emplace_numbers(size_t count, F&& next) {
+      if (count == 0) return;
+      if (ptr->vec.empty()) ptr->row_length = 0;
+      ptr->irregular_rows += count;
+      ptr->vec.reserve(ptr->vec.size() + count);
+      for (size_t i = 0; i < count; ++i) ptr->vec.emplace_back(static_cast<double>(next()));
+      if (ptr->evaluation_session) add_vector_elements(count);
+    }
+private:
+    void add_vector_elements(size_t count);
   };
 
   class EmbeddedVectorType : public VectorType
@@ -288,6 +314,9 @@ public:
     Value operator>=(const ObjectType& v) const;
     const Value& operator[](const str_utf8_wrapper& v) const;
     [[nodiscard]] const std::vector<std::string>& keys() const;
+    // For lookups caching the slot of a key per shape
+    [[nodiscard]] const shared_ptr<ObjectShape>& shape() const;
+    [[nodiscard]] const Value& slot(size_t index) const;
   };
 
 private:
@@ -380,12 +409,40 @@ private:
   Variant value;
 };
 
+/*!
+   The keys of an object, in order, mapped to the slots of its values.
+   Objects built by setting the same keys in the same order share one shape,
+   as hidden classes do, so records don't repeat their keys.
+
+   Shapes of objects with many keys aren't shared, but owned by their object
+   and extended in place. Shapes are only created by the (single threaded)
+   evaluation.
+ */
+class ObjectShape
+{
+public:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+  static shared_ptr<ObjectShape> empty();
+
+  [[nodiscard]] size_t find(const std::string& key) const;
+  [[nodiscard]] const std::vector<std::string>& keys() const { return keyList; }
+  // Replaces the shape by one with the key appended
+  static void append(shared_ptr<ObjectShape>& shape, const std::string& key);
+
+private:
+  void add(const std::string& key);
+
+  std::vector<std::string> keyList;
+  // Only built for more keys than are quickly searched
+  std::unordered_map<std::string, size_t> index;
+  std::unordered_map<std::string, std::weak_ptr<ObjectShape>> transitions;
+  bool owned{false};
+};
+
 // The object type which ObjectType's shared_ptr points to.
 struct Value::ObjectType::ObjectObject {
-  using obj_t = std::unordered_map<std::string, Value>;
-  obj_t map;
   class EvaluationSession *evaluation_session = nullptr;
-  std::vector<std::string> keys;
+  shared_ptr<ObjectShape> shape{ObjectShape::empty()};
   std::vector<Value> values;
 };
 
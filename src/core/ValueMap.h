@@ -1,41 +1,79 @@
 #pragma once
 #include "Value.h"
+#include "Identifier.h"
 #include <utility>
 #include <unordered_map>
+#include <vector>
 
-// Wrapper for provide *futuristic* unordered_map features,
-// plus some functions specialized to our use case.
+// Variables of a context frame, stored in a flat array in insertion order.
+// Entries are found by comparing the ids of their interned Identifiers, so
+// looking a name up through many frames only compares integers. Frames with
+// many variables (e.g. the file scope of a large library) also keep an index.
 class ValueMap
 {
-  using map_t = std::unordered_map<std::string, Value>;
+  using map_t = std::vector<std::pair<Identifier, Value>>;
   map_t map;
+  std::vector<unsigned> ids; // ids[i] is the id of map[i].first, scanned without touching the values
+
+  // Position of the entry of each id, built once the frame has
+  // index_threshold entries
+  std::unordered_map<unsigned, size_t> index;
+  static constexpr size_t index_threshold = 16;
+
+  size_t position(unsigned id) const {
+    if (!index.empty()) {
+      auto it = index.find(id);
+      return it == index.end() ? map.size() : it->second;
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+      if (ids[i] == id) return i;
+    }
+    return map.size();
+  }
 
 public:
   using iterator = map_t::iterator;
   using const_iterator = map_t::const_iterator;
 
-// Gotta have C++20 for this beast
-  bool contains(const std::string& name) const { return map.count(name); }
+  bool contains(const std::string& name) const { return find(name) != end(); }
 
-// Directly wrapped calls
-  const_iterator find(const std::string& name) const {  return map.find(name); }
+  const_iterator find(const std::string& name) const {
+    const auto identifier = Identifier::find(name);
+    return identifier ? find(*identifier) : end();
+  }
+  const_iterator find(const Identifier& name) const {
+    return map.begin() + position(name.getId());
+  }
   const_iterator begin() const {  return map.cbegin(); }
   const_iterator end() const {  return map.cend(); }
   iterator begin() {  return map.begin(); }
   iterator end() {  return map.end(); }
-  void clear() { map.clear(); }
+  void clear() { map.clear(); ids.clear(); index.clear(); }
   size_t size() const { return map.size(); }
-  template <typename ... Args> std::pair<iterator, bool> emplace(Args&&... args) {
-    return map.emplace(std::forward<Args>(args)...);
-  }
+
   std::pair<iterator, bool> insert_or_assign(const std::string& name, Value&& value) {
-    return map.insert_or_assign(name, std::move(value));
+    return insert_or_assign(Identifier(name), std::move(value));
+  }
+  std::pair<iterator, bool> insert_or_assign(const Identifier& name, Value&& value) {
+    const size_t pos = position(name.getId());
+    if (pos < map.size()) {
+      map[pos].second = std::move(value);
+      return {map.begin() + pos, false};
+    }
+    map.emplace_back(name, std::move(value));
+    ids.push_back(name.getId());
+    if (map.size() == index_threshold) {
+      for (size_t i = 0; i < ids.size(); ++i) index.emplace(ids[i], i);
+    } else if (map.size() > index_threshold) {
+      index.emplace(name.getId(), pos);
+    }
+    return {map.begin() + pos, true};
   }
 
   // Get value by name, without possibility of default-constructing a missing name
   //   return Value::undefined if key missing
   const Value& get(const std::string& name) const {
-    auto result = map.find(name);
-    return result == map.end() ? Value::undefined : result->second;
+    auto result = find(name);
+    return result == end() ? Value::undefined : result->second;
   }
 };
@@ -27,6 +27,7 @@
 #include "function.h"
 #include "Arguments.h"
 #include "Expression.h"
+#include "FunctionCache.h"
 #include "Builtins.h"
 #include "printutils.h"
 #include "memory.h"
@@ -42,7 +43,9 @@
 #include <ctime>
 #include <limits>
 #include <algorithm>
+#include <map>
 #include <random>
+#include <unordered_map>
 
 #include "boost-utils.h"
 // hash double
@@ -118,6 +121,7 @@ Value builtin_sign(Arguments arguments, const Location& loc)
 
 Value builtin_rands(Arguments arguments, const Location& loc)
 {
+  FunctionCache::instance()->addSideEffect();
   if (arguments.size() < 3 || arguments.size() > 4) {
     print_argCnt_warning("rands", arguments.size(), "3 or 4", loc, arguments.documentRoot());
     return Value::undefined.clone();
@@ -125,6 +129,8 @@ Value builtin_rands(Arguments arguments, const Location& loc)
     if (!check_arguments("rands", arguments, loc, { Value::Type::NUMBER, Value::Type::NUMBER, Value::Type::NUMBER })) {
       return Value::undefined.clone();
     }
+    // Unseeded, differs between evaluations
+    arguments.session()->addExternalInput();
   } else {
     if (!check_arguments("rands", arguments, loc, { Value::Type::NUMBER, Value::Type::NUMBER, Value::Type::NUMBER, Value::Type::NUMBER })) {
       return Value::undefined.clone();
@@ -162,15 +168,11 @@ Value builtin_rands(Arguments arguments, const Location& loc)
   }
 
   VectorType vec(arguments.session());
-  vec.reserve(numresults);
   if (min >= max) { // uniform_real_distribution doesn't allow min == max
-    for (size_t i = 0; i < numresults; ++i)
-      vec.emplace_back(min);
+    vec.emplace_numbers(numresults, [min]() { return min; });
   } else {
     std::uniform_real_distribution<> distributor(min, max);
-    for (size_t i = 0; i < numresults; ++i) {
-      vec.emplace_back(distributor(deterministic_rng));
-    }
+    vec.emplace_numbers(numresults, [&]() { return distributor(deterministic_rng); });
   }
   return std::move(vec);
 }
@@ -378,9 +380,12 @@ Value builtin_ln(Arguments arguments, const Location& loc)
 Value builtin_str(Arguments arguments, const Location& /*loc*/)
 {
   std::ostringstream stream;
-  for (const auto& argument : arguments) {
-    stream << argument->toString();
+  // Appending to a leading string shares it, for building strings incrementally
+  const bool append = arguments.size() > 1 && arguments[0]->type() == Value::Type::STRING;
+  for (size_t i = append ? 1 : 0; i < arguments.size(); ++i) {
+    stream << arguments[i]->toString();
   }
+  if (append) return {arguments[0]->toStrUtf8Wrapper().append(stream.str())};
   return {stream.str()};
 }
 
@@ -426,6 +431,128 @@ Value builtin_concat(Arguments arguments, const Location& /*loc*/)
   return std::move(result);
 }
 
+/*!
+   Indexes of a table which lookup() or search() is called on repeatedly,
+   cached on the table's VectorObject. Values are immutable, so an index
+   stays valid for the lifetime of its table.
+
+   Tables are indexed on their second use only, as a single scan is
+   cheaper than building an index.
+ */
+struct VectorIndex {
+  static constexpr size_t min_table_size = 16;
+
+  // lookup(): the entries sorted by key, only the first of equal keys
+  size_t lookups = 0;
+  bool lookup_indexed = false;
+  std::vector<std::pair<double, double>> lookup_table;
+
+  // search(): positions of the entries whose value in a column is a given number or
+  // string, or a string starting with a given character
+  struct SearchColumn {
+    std::unordered_map<double, std::vector<size_t>> numbers;
+    std::unordered_map<std::string, std::vector<size_t>> strings;
+    std::unordered_map<uint32_t, std::vector<size_t>> characters;
+    size_t first_invalid; // First entry without a value in the column
+
+    const std::vector<size_t>& find(const Value& value) const;
+    const std::vector<size_t>& findCharacter(uint32_t character) const;
+  };
+  size_t searches = 0;
+  std::map<unsigned int, SearchColumn> search_columns;
+};
+
+template <typename Map>
+static const std::vector<size_t>& find_positions(const Map& map, const typename Map::key_type& key)
+{
+  static const std::vector<size_t> none;
+  auto it = map.find(key);
+  return it == map.end() ? none : it->second;
+}
+
+const std::vector<size_t>& VectorIndex::SearchColumn::find(const Value& value) const
+{
+  if (value.type() == Value::Type::NUMBER) return find_positions(numbers, value.toDouble());
+  return find_positions(strings, value.toStrUtf8Wrapper().toString());
+}
+
+const std::vector<size_t>& VectorIndex::SearchColumn::findCharacter(uint32_t character) const
+{
+  return find_positions(characters, character);
+}
+
+// Returns nullptr if table is too small to index, and on its first use
+static VectorIndex *vector_index(const VectorType& table, size_t VectorIndex::*uses, size_t count)
+{
+  if (table.size() < VectorIndex::min_table_size) return nullptr;
+  if (!table.ptr->index) table.ptr->index = std::make_shared<VectorIndex>();
+  VectorIndex *index = table.ptr->index.get();
+  index->*uses += count;
+  return index->*uses > 1 ? index : nullptr;
+}
+
+static const std::vector<std::pair<double, double>> *lookup_index(const VectorType& table)
+{
+  // Only tables of valid entries without NaN keys are indexed, for others the
+  // order of entries matters in ways a sorted index can't reproduce
+  if (table.numericRowLength() != 2) return nullptr;
+  VectorIndex *index = vector_index(table, &VectorIndex::lookups, 1);
+  if (!index) return nullptr;
+  if (!index->lookup_indexed) {
+    index->lookup_indexed = true;
+    auto& sorted = index->lookup_table;
+    sorted.reserve(table.size());
+    for (const auto& entry : table) {
+      const auto& row = entry.toVector();
+      if (std::isnan(row[0].toDouble())) {
+        sorted.clear();
+        break;
+      }
+      sorted.emplace_back(row[0].toDouble(), row[1].toDouble());
+    }
+    auto byKey = [](const auto& a, const auto& b) { return a.first < b.first; };
+    std::stable_sort(sorted.begin(), sorted.end(), byKey);
+    sorted.erase(std::unique(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first == b.first; }), sorted.end());
+    sorted.shrink_to_fit();
+  }
+  return index->lookup_table.empty() ? nullptr : &index->lookup_table;
+}
+
+static const VectorIndex::SearchColumn *search_index(const VectorType& table, unsigned int index_col_num, size_t queries)
+{
+  VectorIndex *index = vector_index(table, &VectorIndex::searches, queries);
+  if (!index) return nullptr;
+  auto it = index->search_columns.find(index_col_num);
+  if (it != index->search_columns.end()) return &it->second;
+
+  auto& column = index->search_columns[index_col_num];
+  column.first_invalid = table.size();
+  size_t j = 0;
+  for (const auto& entry : table) {
+    // Same matching rules as the scans in builtin_search()
+    const Value *value = nullptr;
+    if (entry.type() == Value::Type::VECTOR) {
+      if (index_col_num < entry.toVector().size()) value = &entry.toVector()[index_col_num];
+    } else if (index_col_num == 0) {
+      value = &entry;
+    }
+    if (value && value->type() == Value::Type::NUMBER && !std::isnan(value->toDouble())) {
+      column.numbers[value->toDouble()].push_back(j);
+    } else if (value && value->type() == Value::Type::STRING) {
+      column.strings[value->toStrUtf8Wrapper().toString()].push_back(j);
+    }
+
+    const auto& entryVec = entry.toVector();
+    if (entryVec.size() <= index_col_num) {
+      column.first_invalid = std::min(column.first_invalid, j);
+    } else {
+      column.characters[entryVec[index_col_num].toStrUtf8Wrapper().get_utf8_char()].push_back(j);
+    }
+    ++j;
+  }
+  return &column;
+}
+
 Value builtin_lookup(Arguments arguments, const Location& loc)
 {
   if (!check_arguments("lookup", arguments, loc, { Value::Type::NUMBER, Value::Type::VECTOR })) {
@@ -448,16 +575,25 @@ Value builtin_lookup(Arguments arguments, const Location& loc)
   high_p = low_p;
   high_v = low_v;
 
-  for (++it; it != vec.end(); ++it) {
-    double this_p, this_v;
-    if (it->getVec2(this_p, this_v)) {
-      if (this_p <= p && (this_p > low_p || low_p > p)) {
-        low_p = this_p;
-        low_v = this_v;
-      }
-      if (this_p >= p && (this_p < high_p || high_p < p)) {
-        high_p = this_p;
-        high_v = this_v;
+  if (const auto *sorted = lookup_index(vec)) {
+    // Same result as the scan below: the first entries with the closest keys
+    // not above and not below p, defaulting to the first entry
+    auto high = std::lower_bound(sorted->begin(), sorted->end(), p, [](const auto& entry, double key) { return entry.first < key; });
+    auto low = std::upper_bound(sorted->begin(), sorted->end(), p, [](double key, const auto& entry) { return key < entry.first; });
+    if (low != sorted->begin()) std::tie(low_p, low_v) = *(low - 1);
+    if (high != sorted->end()) std::tie(high_p, high_v) = *high;
+  } else {
+    for (++it; it != vec.end(); ++it) {
+      double this_p, this_v;
+      if (it->getVec2(this_p, this_v)) {
+        if (this_p <= p && (this_p > low_p || low_p > p)) {
+          low_p = this_p;
+          low_v = this_v;
+        }
+        if (this_p >= p && (this_p < high_p || high_p < p)) {
+          high_p = this_p;
+          high_v = this_v;
+        }
       }
     }
   }
@@ -565,10 +701,30 @@ static VectorType search(
   //Unicode glyph count for the length
   unsigned int findThisSize = find.get_utf8_strlen();
   unsigned int searchTableSize = table.size();
+  const auto *index = search_index(table, index_col_num, findThisSize);
   for (size_t i = 0; i < findThisSize; ++i) {
     unsigned int matchCount = 0;
     VectorType resultvec(session);
     const auto ft = find[i];
+    if (index) {
+      static const std::vector<size_t> none;
+      const auto& positions = ft.empty() ? none : index->findCharacter(ft.get_utf8_char());
+      const size_t count = num_returns_per_match == 0 ? positions.size() : std::min<size_t>(num_returns_per_match, positions.size());
+      // The scan stops after the last requested match, warn if it would have reached an invalid entry first
+      const size_t scanned = count > 0 && count == num_returns_per_match ? positions[count - 1] : searchTableSize;
+      if (index->first_invalid < scanned) {
+        const size_t j = index->first_invalid;
+        LOG(message_group::Warning, loc, session->documentRoot(), "Invalid entry in search vector at index %1$d, required number of values in the entry: %2$d. Invalid entry: %3$s", j, (index_col_num + 1), table[j].toEchoStringNoThrow());
+        return {session};
+      }
+      if (num_returns_per_match == 1) {
+        if (count > 0) returnvec.emplace_back(double(positions[0]));
+      } else {
+        for (size_t k = 0; k < count; ++k) resultvec.emplace_back(double(positions[k]));
+        returnvec.emplace_back(std::move(resultvec));
+      }
+      continue;
+    }
     for (size_t j = 0; j < searchTableSize; ++j) {
       const auto& entryVec = table[j].toVector();
       if (entryVec.size() <= index_col_num) {
@@ -595,6 +751,29 @@ static VectorType search(
   return returnvec;
 }
 
+// Positions of the first limit (or all, if 0) entries of table matching find
+static std::vector<size_t> search_matches(const Value& find, const VectorType& table, unsigned int index_col_num, unsigned int limit, const VectorIndex::SearchColumn *index)
+{
+  std::vector<size_t> matches;
+  if (index && (find.type() == Value::Type::NUMBER || find.type() == Value::Type::STRING)) {
+    const auto& positions = index->find(find);
+    const size_t count = limit == 0 ? positions.size() : std::min<size_t>(limit, positions.size());
+    matches.assign(positions.begin(), positions.begin() + count);
+    return matches;
+  }
+  size_t j = 0;
+  for (const auto& search_element : table) {
+    if ((index_col_num == 0 && (find == search_element).toBool()) ||
+        (index_col_num < search_element.toVector().size() &&
+         (find == search_element.toVector()[index_col_num]).toBool())) {
+      matches.push_back(j);
+      if (limit != 0 && matches.size() >= limit) break;
+    }
+    ++j;
+  }
+  return matches;
+}
+
 Value builtin_search(Arguments arguments, const Location& loc)
 {
   if (arguments.size() < 2 || arguments.size() > 4) {
@@ -610,17 +789,9 @@ Value builtin_search(Arguments arguments, const Location& loc)
   VectorType returnvec(arguments.session());
 
   if (findThis.type() == Value::Type::NUMBER) {
-    unsigned int matchCount = 0;
-    size_t j = 0;
-    for (const auto& search_element : searchTable.toVector()) {
-      if ((index_col_num == 0 && (findThis == search_element).toBool()) ||
-          (index_col_num < search_element.toVector().size() &&
-           (findThis == search_element.toVector()[index_col_num]).toBool())) {
-        returnvec.emplace_back(double(j));
-        matchCount++;
-        if (num_returns_per_match != 0 && matchCount >= num_returns_per_match) break;
-      }
-      ++j;
+    const auto& table = searchTable.toVector();
+    for (size_t j : search_matches(findThis, table, index_col_num, num_returns_per_match, search_index(table, index_col_num, 1))) {
+      returnvec.emplace_back(double(j));
     }
   } else if (findThis.type() == Value::Type::STRING) {
     if (searchTable.type() == Value::Type::STRING) {
@@ -630,29 +801,15 @@ Value builtin_search(Arguments arguments, const Location& loc)
     }
   } else if (findThis.type() == Value::Type::VECTOR) {
     const auto& findVec = findThis.toVector();
+    const auto& table = searchTable.toVector();
+    const auto *index = search_index(table, index_col_num, findVec.size());
     for (const auto& find_value : findVec) {
-      unsigned int matchCount = 0;
-      VectorType resultvec(arguments.session());
-
-      size_t j = 0;
-      for (const auto& search_element : searchTable.toVector()) {
-        if ((index_col_num == 0 && (find_value == search_element).toBool()) ||
-            (index_col_num < search_element.toVector().size() &&
-             (find_value == search_element.toVector()[index_col_num]).toBool())) {
-          matchCount++;
-          if (num_returns_per_match == 1) {
-            returnvec.emplace_back(double(j));
-            break;
-          } else {
-            resultvec.emplace_back(double(j));
-          }
-          if (num_returns_per_match > 1 && matchCount >= num_returns_per_match) break;
-        }
-        ++j;
-      }
-      if ((num_returns_per_match == 1 && matchCount == 0) ||
-          num_returns_per_match == 0 ||
-          num_returns_per_match > 1) {
+      const auto matches = search_matches(find_value, table, index_col_num, num_returns_per_match, index);
+      if (num_returns_per_match == 1 && !matches.empty()) {
+        returnvec.emplace_back(double(matches.front()));
+      } else {
+        VectorType resultvec(arguments.session());
+        for (size_t j : matches) resultvec.emplace_back(double(j));
         returnvec.emplace_back(std::move(resultvec));
       }
     }
@@ -688,6 +845,7 @@ Value builtin_version_num(Arguments arguments, const Location& loc)
 
 Value builtin_parent_module(Arguments arguments, const Location& loc)
 {
+  FunctionCache::instance()->addSideEffect();
   double d;
   if (arguments.size() == 0) {
     d = 1;
@@ -715,8 +873,16 @@ Value builtin_norm(Arguments arguments, const Location& loc)
   if (!check_arguments("norm", arguments, loc, { Value::Type::VECTOR })) {
     return Value::undefined.clone();
   }
+  const auto& vec = arguments[0]->toVector();
   double sum = 0;
-  for (const auto& v : arguments[0]->toVector()) {
+  if (vec.isNumeric()) {
+    for (size_t i = 0; i < vec.size(); ++i) {
+      const double x = vec[i].toDouble();
+      sum += x * x;
+    }
+    return {sqrt(sum)};
+  }
+  for (const auto& v : vec) {
     if (v.type() == Value::Type::NUMBER) {
       double x = v.toDouble();
       sum += x * x;
@@ -869,7 +1035,7 @@ Value builtin_is_undef(const std::shared_ptr<const Context>& context, const Func
     return Value::undefined.clone();
   }
   if (auto lookup = dynamic_pointer_cast<Lookup>(call->arguments[0]->getExpr())) {
-    auto result = context->try_lookup_variable(lookup->get_name());
+    auto result = context->try_lookup_variable(lookup->get_identifier());
     return !result || result->isUndefined();
   } else {
     return call->arguments[0]->getExpr()->evaluate(context).isUndefined();
@@ -930,6 +1096,7 @@ Value builtin_import(Arguments arguments, const Location& loc)
   const Parameters parameters = Parameters::parse(std::move(arguments), loc, {}, {"file"});
   std::string raw_filename = parameters.get("file", "");
   std::string file = lookup_file(raw_filename, loc.filePath().parent_path().string(), parameters.documentRoot());
+  session->addExternalInput();
   return import_json(file, session, loc);
 }
 
@@ -1,9 +1,10 @@
 #include "CommentParser.h"
 #include "Expression.h"
 #include "Annotation.h"
+#include <algorithm>
+#include <iterator>
 #include <string>
 #include <vector>
-#include <boost/range/adaptor/reversed.hpp>
 // gcc 4.8 and earlier have issues with std::regex see
 // #2291 and https://stackoverflow.com/questions/12530406/is-gcc-4-8-or-earlier-buggy-about-regular-expressions
 // therefore, we use boost::regex
@@ -16,6 +17,29 @@ struct GroupInfo {
 
 using GroupList = std::vector<GroupInfo>;
 
+/*
+   Offsets of the start of each line, so lines are found without scanning
+   the text from its start for each parameter
+ */
+class LineIndex
+{
+public:
+  LineIndex(const std::string& fulltext) : length(fulltext.length()) {
+    starts.push_back(0);
+    for (size_t i = 0; i < fulltext.length(); ++i) {
+      if (fulltext[i] == '\n') starts.push_back(i + 1);
+    }
+  }
+  // Offset of the line numbered from 1, the end of the text past the last line
+  [[nodiscard]] size_t start(int line) const {
+    return static_cast<size_t>(line) <= starts.size() ? starts[line - 1] : length;
+  }
+
+private:
+  std::vector<size_t> starts;
+  size_t length;
+};
+
 /*
    Finds line to break stop parsing parsing parameters
 
@@ -79,16 +103,12 @@ static int getLineToStop(const std::string& fulltext){
    Finds the given line in the given source code text, and
    extracts the comment (excluding the "//" prefix)
  */
-static std::string getComment(const std::string& fulltext, int line)
+static std::string getComment(const std::string& fulltext, const LineIndex& lines, int line)
 {
   if (line < 1) return "";
 
   // Locate line
-  std::size_t start = 0;
-  for (; start < fulltext.length(); ++start) {
-    if (line <= 1) break;
-    if (fulltext[start] == '\n') line--;
-  }
+  std::size_t start = lines.start(line);
 
   std::size_t end = start + 1;
   while (end < fulltext.size() && fulltext[end] != '\n') end++;
@@ -122,15 +142,11 @@ static std::string getComment(const std::string& fulltext, int line)
    Extracts a parameter description from comment on the given line.
    Returns description, without any "//"
  */
-static std::string getDescription(const std::string& fulltext, int line)
+static std::string getDescription(const std::string& fulltext, const LineIndex& lines, int line)
 {
   if (line < 1) return "";
 
-  unsigned int start = 0;
-  for (; start < fulltext.length(); ++start) {
-    if (line <= 1) break;
-    if (fulltext[start] == '\n') line--;
-  }
+  std::size_t start = lines.start(line);
 
   // not a valid description
   if (fulltext.compare(start, 2, "//") != 0) return "";
@@ -262,6 +278,7 @@ void CommentParser::collectParameters(const std::string& fulltext, SourceFile *r
   // Get all groups of parameters
   GroupList groupList = collectGroups(fulltext);
   int parseTill = getLineToStop(fulltext);
+  const LineIndex lines(fulltext);
   // Extract parameters for all literal assignments
   for (auto& assignment : root_file->scope.assignments) {
     if (!assignment->getExpr()->isLiteral()) continue; // Only consider literals
@@ -284,7 +301,7 @@ void CommentParser::collectParameters(const std::string& fulltext, SourceFile *r
 
     // Extracting the parameter comment
     shared_ptr<Expression> params;
-    std::string comment = getComment(fulltext, firstLine);
+    std::string comment = getComment(fulltext, lines, firstLine);
     if (comment.length() > 0) { // don't parse what doesn't exist, so we don't get bogus errors from the parser
       // getting the node for parameter annotation
       params = CommentParser::parser(comment.c_str());
@@ -295,21 +312,20 @@ void CommentParser::collectParameters(const std::string& fulltext, SourceFile *r
     annotationList->push_back(Annotation("Parameter", params));
 
     //extracting the description
-    std::string descr = getDescription(fulltext, firstLine - 1);
+    std::string descr = getDescription(fulltext, lines, firstLine - 1);
     if (descr != "") {
       //creating node for description
       shared_ptr<Expression> expr(new Literal(descr));
       annotationList->push_back(Annotation("Description", expr));
     }
 
-    // Look for the group to which the given assignment belong
-    for (const auto& groupInfo :boost::adaptors::reverse(groupList)) {
-      if (groupInfo.lineNo < firstLine) {
-        //creating node for description
-        shared_ptr<Expression> expr(new Literal(groupInfo.commentString));
-        annotationList->push_back(Annotation("Group", expr));
-        break;
-      }
+    // Look for the group to which the given assignment belong, the last one before it
+    const auto group = std::lower_bound(groupList.begin(), groupList.end(), firstLine,
+                                        [](const GroupInfo& groupInfo, int line) { return groupInfo.lineNo < line; });
+    if (group != groupList.begin()) {
+      //creating node for description
+      shared_ptr<Expression> expr(new Literal(std::prev(group)->commentString));
+      annotationList->push_back(Annotation("Group", expr));
     }
     assignment->addAnnotations(annotationList);
   }
@@ -11,8 +11,23 @@
 #include <vector>
 
 class Arguments;
+class Bytecode;
+class Expression;
 class FunctionCall;
 
+/*!
+   Lazily compiled bytecode of a function body, see Bytecode.
+ */
+class BytecodeCache
+{
+public:
+  // Returns nullptr if the bytecode feature is disabled or expr can't be compiled
+  const std::shared_ptr<const Bytecode>& get(const Expression& expr) const;
+private:
+  mutable std::shared_ptr<const Bytecode> bytecode;
+  mutable bool compiled{false};
+};
+
 class BuiltinFunction
 {
 public:
@@ -39,6 +54,10 @@ public:
   UserFunction(const char *name, AssignmentList& parameters, shared_ptr<Expression> expr, const Location& loc);
 
   void print(std::ostream& stream, const std::string& indent) const override;
+  [[nodiscard]] const std::shared_ptr<const Bytecode>& getBytecode() const { return bytecode.get(*expr); }
+
+private:
+  BytecodeCache bytecode;
 };
 
 
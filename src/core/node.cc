@@ -93,10 +93,10 @@ std::string AbstractIntersectionNode::name() const
   return "intersection";
 }
 
-void AbstractNode::progress_prepare()
+void AbstractNode::progress_prepare(const std::function<int (const AbstractNode&)>& weight)
 {
-  std::for_each(this->children.begin(), this->children.end(), std::mem_fn(&AbstractNode::progress_prepare));
-  this->progress_mark = ++progress_report_count;
+  for (const auto& child : this->children) child->progress_prepare(weight);
+  this->progress_mark = progress_report_count += weight ? weight(*this) : 1;
 }
 
 void AbstractNode::progress_report() const
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <utility>
 #include <utility>
 #include <vector>
@@ -13,7 +15,8 @@ extern int progress_report_count;
 extern void (*progress_report_f)(const std::shared_ptr<const AbstractNode>&, void *, int);
 extern void *progress_report_vp;
 
-void progress_report_prep(const std::shared_ptr<AbstractNode>& root, void (*f)(const std::shared_ptr<const AbstractNode>& node, void *vp, int mark), void *vp);
+void progress_report_prep(const std::shared_ptr<AbstractNode>& root, void (*f)(const std::shared_ptr<const AbstractNode>& node, void *vp, int mark), void *vp,
+                          const std::function<int (const AbstractNode&)>& weight);
 void progress_report_fin();
 
 /*!
@@ -34,6 +37,10 @@ public:
   VISITABLE();
   AbstractNode(const ModuleInstantiation *mi);
   virtual std::string toString() const;
+  /*! The representation in id strings, i.e. cache keys. Nodes with big data
+      override it to put a digest of that data instead, toString() stays
+      complete for CSG export. */
+  virtual std::string toIdString() const { return toString(); }
   /*! The 'OpenSCAD name' of this node, defaults to classname, but can be
       overloaded to provide specialization for e.g. CSG nodes, primitive nodes etc.
       Used for human-readable output. */
@@ -52,15 +59,18 @@ public:
   size_t index() const { return this->idx; }
 
   static void resetIndexCounter() { idx_counter = 1; }
+  // Makes new nodes take indices from end on, e.g. past the nodes of a previous evaluation
+  static void reserveIndicesBelow(size_t end) { idx_counter = std::max(idx_counter, end); }
 
   // FIXME: Make protected
   std::vector<std::shared_ptr<AbstractNode>> children;
   const ModuleInstantiation *modinst;
 
-  // progress_mark is a running number used for progress indication
+  // progress_mark is a running number used for progress indication, the
+  // sum of the weights of the nodes up to this one in postfix order
   // FIXME: Make all progress handling external, put it in the traverser class?
   int progress_mark{0};
-  void progress_prepare();
+  void progress_prepare(const std::function<int (const AbstractNode&)>& weight = {});
   void progress_report() const;
 
   int idx; // Node index (unique per tree)
@@ -43,6 +43,7 @@
 #include "Expression.h"
 #include "function.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 #include "memory.h"
 #include <sstream>
 #include <stack>
@@ -527,7 +528,8 @@ primary
             }
         | '[' vector_elements optional_trailing_comma ']'
             {
-              $$ = $2;
+              // Customizer parameters keep their vectors of up to 4 numbers as expressions
+              $$ = $2->getChildren().size() > 4 ? Vector::pack($2) : $2;
             }
 		;
 
@@ -593,12 +595,12 @@ vector_elements
         : vector_element
             {
               $$ = new Vector(LOCD("vector", @$));
-              $$->emplace_back($1);
+              $$->emplace_back(Vector::pack($1));
             }
         | vector_elements ',' vector_element
             {
               $$ = $1;
-              $$->emplace_back($3);
+              $$->emplace_back(Vector::pack($3));
             }
         ;
 
@@ -758,6 +760,7 @@ void handle_assignment(const std::string token, Expression *expr, const Location
 
 bool parse(SourceFile *&file, const std::string& text, const std::string &filename, const std::string &mainFile, int debug)
 {
+  TimingCounters::Scope timer(TimingCounters::PARSE);
   fs::path filepath;
   try {
     filepath = fs::absolute(fs::path(filename));
@@ -1,7 +1,9 @@
 #include "parsersettings.h"
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include "PlatformUtils.h"
+#include "StatCache.h"
 
 namespace fs = boost::filesystem;
 
@@ -95,7 +97,15 @@ fs::path find_valid_path(const fs::path& sourcepath,
                          const fs::path& localpath,
                          const std::vector<std::string> *openfilenames)
 {
-  return {find_valid_path_(sourcepath, localpath, openfilenames).generic_string()};
+  const auto key = "find_valid_path\n" + sourcepath.generic_string() + "\n" + localpath.generic_string();
+  const auto path = StatCache::resolve(key, [&]() {
+    return find_valid_path_(sourcepath, localpath, nullptr).generic_string();
+  });
+  // A circular include may still be found elsewhere in the library path
+  if (openfilenames && std::find(openfilenames->begin(), openfilenames->end(), path) != openfilenames->end()) {
+    return {find_valid_path_(sourcepath, localpath, openfilenames).generic_string()};
+  }
+  return {path};
 }
 
 
@@ -34,9 +34,15 @@
 #include "printutils.h"
 #include "calc.h"
 #include "degree_trig.h"
+#include "hash.h"
 #include <sstream>
 #include <cassert>
 #include <cmath>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <boost/assign/std/vector.hpp>
 #include "ModuleInstantiation.h"
 #include "primitives.h"
@@ -44,12 +50,54 @@ using namespace boost::assign; // bring 'operator+=()' into scope
 
 #define F_MINIMUM 0.01
 
-static void generate_circle(point2d *circle, double r, int fragments)
+using UnitPoints = std::shared_ptr<const std::vector<point2d>>;
+
+// Id strings of polyhedron() and polygon() digest data of more points and indices
+static const size_t maxIdStringValues = 1024;
+
+template <typename T>
+static Hash128 hash_values(const std::vector<T>& values)
 {
-  for (int i = 0; i < fragments; ++i) {
-    double phi = (360.0 * i) / fragments;
-    circle[i].x = r * cos_degrees(phi);
-    circle[i].y = r * sin_degrees(phi);
+  return hash128(values.data(), values.size() * sizeof(T));
+}
+
+// Computes (cos, sin) of the angles once per process for each number of points.
+// Primitives may be created on several threads.
+static UnitPoints cached_points(std::unordered_map<int, UnitPoints>& cache, int n, const std::function<double(int)>& angle)
+{
+  static std::mutex mutex;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& points = cache[n];
+  if (!points) {
+    auto table = std::make_shared<std::vector<point2d>>(n);
+    for (int i = 0; i < n; ++i) {
+      double phi = angle(i);
+      (*table)[i] = {cos_degrees(phi), sin_degrees(phi)};
+    }
+    points = std::move(table);
+  }
+  return points;
+}
+
+// Points of a unit circle with the given number of fragments
+static UnitPoints unit_circle(int fragments)
+{
+  static std::unordered_map<int, UnitPoints> circles;
+  return cached_points(circles, fragments, [fragments](int i) { return (360.0 * i) / fragments; });
+}
+
+// Height and radius, as x and y, of the rings of a unit sphere from the top
+static UnitPoints unit_meridian(int rings)
+{
+  static std::unordered_map<int, UnitPoints> meridians;
+  return cached_points(meridians, rings, [rings](int i) { return (180.0 * (i + 0.5)) / rings; });
+}
+
+static void generate_circle(point2d *circle, double r, const std::vector<point2d>& unit)
+{
+  for (size_t i = 0; i < unit.size(); ++i) {
+    circle[i].x = r * unit[i].x;
+    circle[i].y = r * unit[i].y;
   }
 }
 
@@ -229,14 +277,15 @@ const Geometry *SphereNode::createGeometry() const
 
   auto ring = std::vector<ring_s>(rings);
 
+  const auto circle = unit_circle(fragments);
+  const auto meridian = unit_meridian(rings);
 //	double offset = 0.5 * ((fragments / 2) % 2);
   for (int i = 0; i < rings; ++i) {
 //		double phi = (180.0 * (i + offset)) / (fragments/2);
-    double phi = (180.0 * (i + 0.5)) / rings;
-    double radius = r * sin_degrees(phi);
-    ring[i].z = r * cos_degrees(phi);
+    double radius = r * (*meridian)[i].y;
+    ring[i].z = r * (*meridian)[i].x;
     ring[i].points.resize(fragments);
-    generate_circle(ring[i].points.data(), radius, fragments);
+    generate_circle(ring[i].points.data(), radius, *circle);
   }
 
   p->reserve(rings * fragments + 2);
@@ -336,8 +385,9 @@ const Geometry *CylinderNode::createGeometry() const
   auto circle1 = std::vector<point2d>(fragments);
   auto circle2 = std::vector<point2d>(fragments);
 
-  generate_circle(circle1.data(), r1, fragments);
-  generate_circle(circle2.data(), r2, fragments);
+  const auto circle = unit_circle(fragments);
+  generate_circle(circle1.data(), r1, *circle);
+  generate_circle(circle2.data(), r2, *circle);
 
   p->reserve(fragments * 2 + 2);
   
@@ -450,41 +500,54 @@ std::string PolyhedronNode::toString() const
     stream << "[" << point.x << ", " << point.y << ", " << point.z << "]";
   }
   stream << "], faces = [";
-  bool firstFace = true;
-  for (const auto& face : this->faces) {
-    if (firstFace) {
-      firstFace = false;
-    } else {
+  size_t begin = 0;
+  for (const auto end : this->faces) {
+    if (begin > 0) {
       stream << ", ";
     }
     stream << "[";
-    bool firstIndex = true;
-    for (const auto& index : face) {
-      if (firstIndex) {
-        firstIndex = false;
-      } else {
+    for (size_t i = begin; i < end; ++i) {
+      if (i > begin) {
         stream << ", ";
       }
-      stream << index;
+      stream << this->indices[i];
     }
     stream << "]";
+    begin = end;
   }
   stream << "], convexity = " << this->convexity << ")";
   return stream.str();
 }
 
+std::string PolyhedronNode::toIdString() const
+{
+  if (this->points.size() + this->indices.size() <= maxIdStringValues) return toString();
+  const Hash128 parts[] = {
+    hash_values(this->points), hash_values(this->indices), hash_values(this->faces)
+  };
+  std::ostringstream stream;
+  stream << "polyhedron(points = " << this->points.size() << ", faces = " << this->faces.size()
+         << ", digest = " << hash128(parts, sizeof(parts)).toString() << ", convexity = " << this->convexity << ")";
+  return stream.str();
+}
+
 const Geometry *PolyhedronNode::createGeometry() const
 {
   auto p = new PolySet(3);
   p->setConvexity(this->convexity);
-  p->reserve(this->faces.size());
-  for (const auto& face : this->faces) {
-    p->append_poly(face.size());
-    for (const auto& index : face) {
-      assert(index < this->points.size());
-      const auto& point = points[index];
-      p->insert_vertex(point.x, point.y, point.z);
+  auto& polygons = p->mutablePolygons();
+  polygons.resize(this->faces.size());
+  size_t begin = 0;
+  for (size_t face = 0; face < this->faces.size(); ++face) {
+    // Faces are given clockwise, polygons are counterclockwise
+    auto& poly = polygons[face];
+    poly.reserve(this->faces[face] - begin);
+    for (size_t i = this->faces[face]; i-- > begin;) {
+      assert(this->indices[i] < this->points.size());
+      const auto& point = points[this->indices[i]];
+      poly.emplace_back(point.x, point.y, point.z);
     }
+    begin = this->faces[face];
   }
   return p;
 }
@@ -504,10 +567,17 @@ static std::shared_ptr<AbstractNode> builtin_polyhedron(const ModuleInstantiatio
     LOG(message_group::Error, inst->location(), parameters.documentRoot(), "Unable to convert points = %1$s to a vector of coordinates", parameters["points"].toEchoStringNoThrow());
     return node;
   }
-  node->points.reserve(parameters["points"].toVector().size());
-  for (const Value& pointValue : parameters["points"].toVector()) {
+  const auto& points = parameters["points"].toVector();
+  node->points.reserve(points.size());
+  // For a matrix of numbers the coordinates can be read without checking each of them
+  const bool numeric_points = points.numericRowLength() == 3;
+  for (const Value& pointValue : points) {
     point3d point;
-    if (!pointValue.getVec3(point.x, point.y, point.z, 0.0) ||
+    if (numeric_points) {
+      const auto& coords = pointValue.toVector();
+      point = {coords[0].toDouble(), coords[1].toDouble(), coords[2].toDouble()};
+    }
+    if ((!numeric_points && !pointValue.getVec3(point.x, point.y, point.z, 0.0)) ||
         !std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)
         ) {
       LOG(message_group::Error, inst->location(), parameters.documentRoot(), "Unable to convert points[%1$d] = %2$s to a vec3 of numbers", node->points.size(), pointValue.toEchoStringNoThrow());
@@ -531,27 +601,33 @@ static std::shared_ptr<AbstractNode> builtin_polyhedron(const ModuleInstantiatio
   }
   size_t faceIndex = 0;
   node->faces.reserve(faces->toVector().size());
+  node->indices.reserve(3 * faces->toVector().size());
   for (const Value& faceValue : faces->toVector()) {
     if (faceValue.type() != Value::Type::VECTOR) {
       LOG(message_group::Error, inst->location(), parameters.documentRoot(), "Unable to convert faces[%1$d] = %2$s to a vector of numbers", faceIndex, faceValue.toEchoStringNoThrow());
     } else {
       size_t pointIndexIndex = 0;
-      std::vector<size_t> face;
-      for (const Value& pointIndexValue : faceValue.toVector()) {
-        if (pointIndexValue.type() != Value::Type::NUMBER) {
+      const size_t begin = node->indices.size();
+      const auto& face = faceValue.toVector();
+      // Faces of numbers only need their indices checked against the points
+      const bool numeric_face = face.isNumeric();
+      for (const Value& pointIndexValue : face) {
+        if (!numeric_face && pointIndexValue.type() != Value::Type::NUMBER) {
           LOG(message_group::Error, inst->location(), parameters.documentRoot(), "Unable to convert faces[%1$d][%2$d] = %3$s to a number", faceIndex, pointIndexIndex, pointIndexValue.toEchoStringNoThrow());
         } else {
           auto pointIndex = (size_t)pointIndexValue.toDouble();
           if (pointIndex < node->points.size()) {
-            face.push_back(pointIndex);
+            node->indices.push_back(pointIndex);
           } else {
             LOG(message_group::Warning, inst->location(), parameters.documentRoot(), "Point index %1$d is out of bounds (from faces[%2$d][%3$d])", pointIndex, faceIndex, pointIndexIndex);
           }
         }
         pointIndexIndex++;
       }
-      if (face.size() >= 3) {
-        node->faces.push_back(std::move(face));
+      if (node->indices.size() - begin >= 3) {
+        node->faces.push_back(node->indices.size());
+      } else {
+        node->indices.resize(begin);
       }
     }
     faceIndex++;
@@ -633,9 +709,9 @@ const Geometry *CircleNode::createGeometry() const
   auto fragments = Calc::get_fragments_from_r(this->r, this->fn, this->fs, this->fa);
   Outline2d o;
   o.vertices.resize(fragments);
+  const auto circle = unit_circle(fragments);
   for (int i = 0; i < fragments; ++i) {
-    double phi = (360.0 * i) / fragments;
-    o.vertices[i] = {this->r * cos_degrees(phi), this->r * sin_degrees(phi)};
+    o.vertices[i] = {this->r * (*circle)[i].x, this->r * (*circle)[i].y};
   }
   p->addOutline(o);
   p->setSanitized(true);
@@ -711,11 +787,26 @@ std::string PolygonNode::toString() const
   return stream.str();
 }
 
+std::string PolygonNode::toIdString() const
+{
+  size_t size = this->points.size();
+  for (const auto& path : this->paths) size += path.size();
+  if (size <= maxIdStringValues) return toString();
+  std::vector<Hash128> parts{hash_values(this->points)};
+  for (const auto& path : this->paths) parts.push_back(hash_values(path));
+  std::ostringstream stream;
+  stream << "polygon(points = " << this->points.size() << ", paths = " << this->paths.size()
+         << ", digest = " << hash128(parts.data(), parts.size() * sizeof(Hash128)).toString()
+         << ", convexity = " << this->convexity << ")";
+  return stream.str();
+}
+
 const Geometry *PolygonNode::createGeometry() const
 {
   auto p = new Polygon2d();
   if (this->paths.empty() && this->points.size() > 2) {
     Outline2d outline;
+    outline.vertices.reserve(this->points.size());
     for (const auto& point : this->points) {
       outline.vertices.emplace_back(point.x, point.y);
     }
@@ -723,6 +814,7 @@ const Geometry *PolygonNode::createGeometry() const
   } else {
     for (const auto& path : this->paths) {
       Outline2d outline;
+      outline.vertices.reserve(path.size());
       for (const auto& index : path) {
         assert(index < this->points.size());
         const auto& point = points[index];
@@ -752,9 +844,16 @@ static std::shared_ptr<AbstractNode> builtin_polygon(const ModuleInstantiation *
     LOG(message_group::Error, inst->location(), parameters.documentRoot(), "Unable to convert points = %1$s to a vector of coordinates", parameters["points"].toEchoStringNoThrow());
     return node;
   }
-  for (const Value& pointValue : parameters["points"].toVector()) {
+  const auto& points = parameters["points"].toVector();
+  const bool numeric_points = points.numericRowLength() == 2;
+  node->points.reserve(points.size());
+  for (const Value& pointValue : points) {
     point2d point;
-    if (!pointValue.getVec2(point.x, point.y) ||
+    if (numeric_points) {
+      const auto& coords = pointValue.toVector();
+      point = {coords[0].toDouble(), coords[1].toDouble()};
+    }
+    if ((!numeric_points && !pointValue.getVec2(point.x, point.y)) ||
         !std::isfinite(point.x) || !std::isfinite(point.y)
         ) {
       LOG(message_group::Error, inst->location(), parameters.documentRoot(), "Unable to convert points[%1$d] = %2$s to a vec2 of numbers", node->points.size(), pointValue.toEchoStringNoThrow());
@@ -772,8 +871,11 @@ static std::shared_ptr<AbstractNode> builtin_polygon(const ModuleInstantiation *
       } else {
         size_t pointIndexIndex = 0;
         std::vector<size_t> path;
-        for (const Value& pointIndexValue : pathValue.toVector()) {
-          if (pointIndexValue.type() != Value::Type::NUMBER) {
+        const auto& indices = pathValue.toVector();
+        const bool numeric_path = indices.isNumeric();
+        path.reserve(indices.size());
+        for (const Value& pointIndexValue : indices) {
+          if (!numeric_path && pointIndexValue.type() != Value::Type::NUMBER) {
             LOG(message_group::Error, inst->location(), parameters.documentRoot(), "Unable to convert paths[%1$d][%2$d] = %3$s to a number", pathIndex, pointIndexIndex, pointIndexValue.toEchoStringNoThrow());
           } else {
             auto pointIndex = (size_t)pointIndexValue.toDouble();
@@ -113,11 +113,13 @@ class PolyhedronNode : public LeafNode
 public:
   PolyhedronNode (const ModuleInstantiation *mi) : LeafNode(mi) {}
   std::string toString() const override;
+  std::string toIdString() const override;
   std::string name() const override { return "polyhedron"; }
   const Geometry *createGeometry() const override;
 
   std::vector<point3d> points;
-  std::vector<std::vector<size_t>> faces;
+  std::vector<size_t> indices; // Point indices of all faces
+  std::vector<size_t> faces; // End of each face in indices
   int convexity = 1;
 };
 
@@ -171,6 +173,7 @@ class PolygonNode : public LeafNode
 public:
   PolygonNode (const ModuleInstantiation *mi) : LeafNode(mi) {}
   std::string toString() const override;
+  std::string toIdString() const override;
   std::string name() const override { return "polygon"; }
   const Geometry *createGeometry() const override;
 
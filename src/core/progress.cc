@@ -1,17 +1,32 @@
 #include "progress.h"
 #include "node.h"
 
+#include <atomic>
+#include <mutex>
+
 int progress_report_count;
 int progress_mark_;
 void (*progress_report_f)(const std::shared_ptr<const AbstractNode> &, void *, int);
 void *progress_report_userdata;
+// Progress may be reported from several geometry evaluation threads
+static std::mutex progress_mutex;
+static std::atomic<bool> progress_cancelled{false};
+
+// Throws once for each call of progress_cancel()
+static void check_cancelled()
+{
+  if (progress_cancelled.load(std::memory_order_relaxed) && progress_cancelled.exchange(false)) {
+    throw ProgressCancelException();
+  }
+}
 
-void progress_report_prep(const std::shared_ptr<AbstractNode> &root, void (*f)(const std::shared_ptr<const AbstractNode> &node, void *userdata, int mark), void *userdata)
+void progress_report_prep(const std::shared_ptr<AbstractNode> &root, void (*f)(const std::shared_ptr<const AbstractNode> &node, void *userdata, int mark), void *userdata,
+                          const ProgressWeight& weight)
 {
   progress_report_count = 0;
   progress_report_f = f;
   progress_report_userdata = userdata;
-  root->progress_prepare();
+  root->progress_prepare(weight);
 }
 
 void progress_report_fin()
@@ -23,7 +38,9 @@ void progress_report_fin()
 
 void progress_update(const std::shared_ptr<const AbstractNode> &node, int mark)
 {
+  check_cancelled();
   if (progress_report_f) {
+    std::lock_guard<std::mutex> lock(progress_mutex);
     progress_mark_ = mark;
     progress_report_f(node, progress_report_userdata, progress_mark_);
   }
@@ -31,5 +48,23 @@ void progress_update(const std::shared_ptr<const AbstractNode> &node, int mark)
 
 void progress_tick()
 {
-  if (progress_report_f) progress_report_f(std::shared_ptr<const AbstractNode>(), progress_report_userdata, ++progress_mark_);
+  check_cancelled();
+  if (progress_report_f) {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    progress_report_f(std::shared_ptr<const AbstractNode>(), progress_report_userdata, ++progress_mark_);
+  }
+}
+
+void progress_check()
+{
+  check_cancelled();
+  if (progress_report_f) {
+    std::lock_guard<std::mutex> lock(progress_mutex);
+    progress_report_f(std::shared_ptr<const AbstractNode>(), progress_report_userdata, progress_mark_);
+  }
+}
+
+void progress_cancel()
+{
+  progress_cancelled = true;
 }
@@ -1,20 +1,28 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 
 class AbstractNode;
 
-// Reset to 0 in _prep() and increased for each Node instance in progress_prepare()
+// Reset to 0 in _prep() and increased by the weight of each Node instance in progress_prepare()
 extern int progress_report_count;
 
 extern void (*progress_report_f)(const std::shared_ptr<const AbstractNode> &, void *, int);
 extern void *progress_report_userdata;
 
-void progress_report_prep(const std::shared_ptr<AbstractNode> &root, void (*f)(const std::shared_ptr<const AbstractNode> &node, void *userdata, int mark), void *userdata);
+// Weighs the nodes' share of the progress, e.g. by their expected evaluation time. Nodes count as 1 without it.
+using ProgressWeight = std::function<int (const AbstractNode&)>;
+void progress_report_prep(const std::shared_ptr<AbstractNode> &root, void (*f)(const std::shared_ptr<const AbstractNode> &node, void *userdata, int mark), void *userdata,
+                          const ProgressWeight& weight = {});
 void progress_report_fin();
 void progress_update(const std::shared_ptr<const AbstractNode> &node, int mark);
 // CGALUtils::applyUnion3D may process nodes out of order, so allow for an increment instead of tracking exact node
 void progress_tick();
+// Lets the progress callback cancel a long operation, without advancing the progress
+void progress_check();
+// Makes the next progress report throw ProgressCancelException, callable from any thread
+void progress_cancel();
 
 class ProgressCancelException
 {
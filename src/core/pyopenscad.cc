@@ -30,6 +30,11 @@
 
 std::shared_ptr<AbstractNode> python_result_node; 
 
+/*!
+   Placeholder for the Python engine: no interpreter is embedded yet, so no
+   Python objects are converted to nodes and python_result_node stays empty.
+   Returns the error message to log.
+ */
 std::string evaluatePython(const std::string &code, double time)
 {
   return "Python not yet  fully  inside";
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <glib.h>
 
@@ -18,9 +20,49 @@ private:
     }
     str_utf8_t(const char *cstr, size_t size, size_t u8len) : u8str(cstr, size), u8len(u8len) {
     }
-    const std::string u8str;
-    size_t u8len = LENGTH_UNKNOWN;
+    // An appended string, where u8str only holds the suffix until flattened
+    str_utf8_t(std::shared_ptr<str_utf8_t> prefix_in, std::string suffix) :
+      u8str(std::move(suffix)), prefix(std::move(prefix_in)), bytes(prefix->size() + u8str.size()) {
+      // Counting a flat prefix once keeps the length known along the chain
+      if (prefix->u8len == LENGTH_UNKNOWN && !prefix->prefix) {
+        prefix->u8len = g_utf8_strlen(prefix->u8str.c_str(), static_cast<gssize>(prefix->u8str.size()));
+      }
+      if (prefix->u8len != LENGTH_UNKNOWN) {
+        u8len = prefix->u8len + g_utf8_strlen(u8str.c_str(), static_cast<gssize>(u8str.size()));
+      }
+    }
+    str_utf8_t(const str_utf8_t&) = delete;
+    str_utf8_t& operator=(const str_utf8_t&) = delete;
+    ~str_utf8_t() {
+      // Release chains of appended strings without recursion
+      auto next = std::move(prefix);
+      while (next && next.use_count() == 1) next = std::move(next->prefix);
+    }
+
+    [[nodiscard]] size_t size() const { return prefix ? bytes : u8str.size(); }
+
+    // Copies the whole chain of appended strings into u8str once
+    const std::string& str() const {
+      if (prefix) {
+        std::vector<const str_utf8_t *> parts{this};
+        for (const str_utf8_t *p = prefix.get(); p; p = p->prefix.get()) parts.push_back(p);
+        std::string result;
+        result.reserve(bytes);
+        for (auto it = parts.rbegin(); it != parts.rend(); ++it) result += (*it)->u8str;
+        u8str = std::move(result);
+        auto released = std::move(prefix);
+      }
+      return u8str;
+    }
+
+    mutable std::string u8str;
+    mutable std::shared_ptr<str_utf8_t> prefix;
+    size_t bytes = 0;
+    mutable size_t u8len = LENGTH_UNKNOWN;
   };
+
+  // Shorter strings are copied when appended to
+  static constexpr size_t MIN_APPEND_SHARED = 256;
   // private constructor for copying members
   explicit str_utf8_wrapper(const std::shared_ptr<str_utf8_t>& str_in) : str_ptr(str_in) { }
 
@@ -70,22 +112,28 @@ private:
   ~str_utf8_wrapper() = default;
   [[nodiscard]] str_utf8_wrapper clone() const { return str_utf8_wrapper(this->str_ptr); } // makes a copy of shared_ptr
 
-  bool operator==(const str_utf8_wrapper& rhs) const { return this->str_ptr->u8str == rhs.str_ptr->u8str; }
-  bool operator!=(const str_utf8_wrapper& rhs) const { return this->str_ptr->u8str != rhs.str_ptr->u8str; }
-  bool operator<(const str_utf8_wrapper& rhs) const { return this->str_ptr->u8str < rhs.str_ptr->u8str; }
-  bool operator>(const str_utf8_wrapper& rhs) const { return this->str_ptr->u8str > rhs.str_ptr->u8str; }
-  bool operator<=(const str_utf8_wrapper& rhs) const { return this->str_ptr->u8str <= rhs.str_ptr->u8str; }
-  bool operator>=(const str_utf8_wrapper& rhs) const { return this->str_ptr->u8str >= rhs.str_ptr->u8str; }
-  [[nodiscard]] bool empty() const { return this->str_ptr->u8str.empty(); }
-  [[nodiscard]] const char *c_str() const { return this->str_ptr->u8str.c_str(); }
-  [[nodiscard]] const std::string& toString() const { return this->str_ptr->u8str; }
-  [[nodiscard]] size_t size() const { return this->str_ptr->u8str.size(); }
+  // Appending shares this string, so building a string piece by piece is linear
+  [[nodiscard]] str_utf8_wrapper append(std::string suffix) const {
+    if (this->size() < MIN_APPEND_SHARED) return {this->toString() + suffix};
+    return str_utf8_wrapper(std::make_shared<str_utf8_t>(this->str_ptr, std::move(suffix)));
+  }
+
+  bool operator==(const str_utf8_wrapper& rhs) const { return this->str_ptr->str() == rhs.str_ptr->str(); }
+  bool operator!=(const str_utf8_wrapper& rhs) const { return this->str_ptr->str() != rhs.str_ptr->str(); }
+  bool operator<(const str_utf8_wrapper& rhs) const { return this->str_ptr->str() < rhs.str_ptr->str(); }
+  bool operator>(const str_utf8_wrapper& rhs) const { return this->str_ptr->str() > rhs.str_ptr->str(); }
+  bool operator<=(const str_utf8_wrapper& rhs) const { return this->str_ptr->str() <= rhs.str_ptr->str(); }
+  bool operator>=(const str_utf8_wrapper& rhs) const { return this->str_ptr->str() >= rhs.str_ptr->str(); }
+  [[nodiscard]] bool empty() const { return this->size() == 0; }
+  [[nodiscard]] const char *c_str() const { return this->str_ptr->str().c_str(); }
+  [[nodiscard]] const std::string& toString() const { return this->str_ptr->str(); }
+  [[nodiscard]] size_t size() const { return this->str_ptr->size(); }
   str_utf8_wrapper operator[](const size_t idx) const {
     if (idx < this->size()) {
       // Ensure character (not byte) index is inside the character/glyph array
       if (idx < this->get_utf8_strlen()) {
         gchar utf8_of_cp[6] = ""; //A buffer for a single unicode character to be copied into
-	auto ptr = g_utf8_offset_to_pointer(str_ptr->u8str.c_str(), idx);
+	auto ptr = g_utf8_offset_to_pointer(this->c_str(), idx);
 	if (ptr) {
           g_utf8_strncpy(utf8_of_cp, ptr, 1);
         }
@@ -97,17 +145,18 @@ private:
 
   [[nodiscard]] size_t get_utf8_strlen() const {
     if (str_ptr->u8len == str_utf8_t::LENGTH_UNKNOWN) {
-      str_ptr->u8len = g_utf8_strlen(str_ptr->u8str.c_str(), static_cast<gssize>(str_ptr->u8str.size()));
+      const auto& str = str_ptr->str();
+      str_ptr->u8len = g_utf8_strlen(str.c_str(), static_cast<gssize>(str.size()));
     }
     return str_ptr->u8len;
   }
 
   [[nodiscard]] uint32_t get_utf8_char() const {
-    return g_utf8_get_char(str_ptr->u8str.c_str());
+    return g_utf8_get_char(this->c_str());
   }
 
   [[nodiscard]] bool utf8_validate() const {
-    return g_utf8_validate(str_ptr->u8str.c_str(), -1, nullptr);
+    return g_utf8_validate(this->c_str(), -1, nullptr);
   }
 
 private:
@@ -0,0 +1,176 @@
+#include "BackendBenchmark.h"
+#include "Tree.h"
+#include "Feature.h"
+#include "GeometryEvaluator.h"
+#include "GeometryCache.h"
+#include "GeometryDiskCache.h"
+#include "CGALCache.h"
+#include "PlatformUtils.h"
+#include "PolySet.h"
+#include "Polygon2d.h"
+#include "cgalutils.h"
+#include "printutils.h"
+#include "progress.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <vector>
+#include <json.hpp>
+
+namespace {
+
+struct Backend {
+  const char *name;
+  std::vector<const Feature *> features;
+};
+
+struct Result {
+  std::string backend;
+  bool ok{false};
+  std::string error;
+  double seconds{0};
+  size_t result_bytes{0};
+  size_t cache_bytes{0};
+  size_t facets{0};
+  unsigned int dimension{0};
+  double measure{0}; // Volume, or area for 2D
+  BoundingBox bbox;
+  double measure_difference{0};
+  double bbox_difference{0};
+};
+
+void measure(const shared_ptr<const Geometry>& geom, Result& result)
+{
+  result.result_bytes = geom ? geom->memsize() : 0;
+  if (!geom || geom->isEmpty()) return;
+  result.dimension = geom->getDimension();
+  result.bbox = geom->getBoundingBox();
+  if (auto poly = dynamic_pointer_cast<const Polygon2d>(geom)) {
+    result.facets = poly->outlines().size();
+    result.measure = poly->area();
+  } else if (auto ps = CGALUtils::getGeometryAsPolySet(geom)) {
+    result.facets = ps->numFacets();
+    result.measure = ps->getDimension() == 3 ? ps->volume() : ps->getPolygon().area();
+  }
+}
+
+void compare(const Result& reference, Result& result)
+{
+  if (reference.measure > 0) result.measure_difference = std::abs(result.measure - reference.measure) / reference.measure;
+  if (result.bbox.isEmpty() || reference.bbox.isEmpty()) return;
+  result.bbox_difference = std::max((result.bbox.min() - reference.bbox.min()).cwiseAbs().maxCoeff(),
+                                    (result.bbox.max() - reference.bbox.max()).cwiseAbs().maxCoeff());
+}
+
+void clear_caches()
+{
+  GeometryCache::instance()->clear();
+  CGALCache::instance()->clear();
+}
+
+} // namespace
+
+namespace BackendBenchmark {
+
+bool run(const Tree& tree, const std::string& jsonfile)
+{
+  std::vector<Backend> backends{
+    {"cgal", {}},
+    {"fast-csg", {&Feature::ExperimentalFastCsg}},
+    {"fast-csg-safer", {&Feature::ExperimentalFastCsg, &Feature::ExperimentalFastCsgSafer}},
+#ifdef ENABLE_MANIFOLD
+    {"manifold", {&Feature::ExperimentalManifold}},
+#endif
+  };
+#ifndef ENABLE_EXPERIMENTAL
+  LOG(message_group::Warning, "Only the CGAL backend can be benchmarked, this build has no experimental features.");
+  backends.resize(1);
+#endif
+
+  const std::vector<const Feature *> switched{&Feature::ExperimentalFastCsg, &Feature::ExperimentalFastCsgSafer, &Feature::ExperimentalManifold};
+  std::vector<bool> was_enabled;
+  for (const auto feature : switched) was_enabled.push_back(feature->is_enabled());
+  // Entries restored from disk would skip the evaluation
+  auto diskcache = GeometryDiskCache::instance();
+  const std::string diskcache_dir = diskcache->directory();
+  const bool writethrough = diskcache->writesThrough();
+  diskcache->setDirectory("");
+
+  std::vector<Result> results;
+  for (const auto& backend : backends) {
+    for (const auto feature : switched) Feature::enable_feature(feature->get_name(), false);
+    for (const auto feature : backend.features) Feature::enable_feature(feature->get_name(), true);
+    clear_caches();
+
+    Result result;
+    result.backend = backend.name;
+    LOG("Benchmarking the %1$s backend...", backend.name);
+    const auto start = std::chrono::steady_clock::now();
+    try {
+      GeometryEvaluator evaluator(tree);
+      const auto geom = evaluator.evaluateGeometry(*tree.root(), true);
+      result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      result.cache_bytes = GeometryCache::instance()->totalCost() + CGALCache::instance()->totalCost();
+      measure(geom, result);
+      result.ok = true;
+    } catch (const ProgressCancelException&) {
+      throw;
+    } catch (const std::exception& e) {
+      result.error = e.what();
+    }
+    if (result.ok && !results.empty() && results.front().ok) compare(results.front(), result);
+    results.push_back(result);
+  }
+
+  for (size_t i = 0; i < switched.size(); ++i) Feature::enable_feature(switched[i]->get_name(), was_enabled[i]);
+  clear_caches();
+  diskcache->setDirectory(diskcache_dir, writethrough);
+
+  LOG("Backend benchmark, differences relative to %1$s:", results.front().backend);
+  LOG("   %1$-16s %2$10s %3$12s %4$12s %5$10s %6$12s %7$12s", "Backend", "Time [s]", "Result [B]", "Caches [B]", "Facets", "Measure diff", "BBox diff");
+  bool any_ok = false;
+  for (const auto& result : results) {
+    if (!result.ok) {
+      LOG("   %1$-16s failed: %2$s", result.backend, result.error);
+      continue;
+    }
+    any_ok = true;
+    LOG("   %1$-16s %2$10.3f %3$12d %4$12d %5$10d %6$12.3g %7$12.3g", result.backend, result.seconds,
+        result.result_bytes, result.cache_bytes, result.facets, result.measure_difference, result.bbox_difference);
+  }
+  const auto peak_rss = PlatformUtils::peakMemoryUsage();
+  LOG("   Peak RSS of all runs: %1$d bytes", peak_rss);
+
+  if (!jsonfile.empty()) {
+    nlohmann::json json, runs = nlohmann::json::array();
+    for (const auto& result : results) {
+      nlohmann::json run;
+      run["backend"] = result.backend;
+      run["ok"] = result.ok;
+      if (!result.ok) {
+        run["error"] = result.error;
+      } else {
+        run["seconds"] = result.seconds;
+        run["result_bytes"] = result.result_bytes;
+        run["cache_bytes"] = result.cache_bytes;
+        run["facets"] = result.facets;
+        run["dimension"] = result.dimension;
+        run["measure"] = result.measure;
+        run["measure_difference"] = result.measure_difference;
+        run["bbox_difference"] = result.bbox_difference;
+      }
+      runs.push_back(run);
+    }
+    json["reference"] = results.front().backend;
+    json["runs"] = runs;
+    json["peak_rss"] = peak_rss;
+    std::ofstream out(jsonfile);
+    if (out) out << json.dump(4) << std::endl;
+    else LOG(message_group::Error, "Can't write the backend benchmark to '%1$s'", jsonfile);
+  }
+  return any_ok;
+}
+
+} // namespace BackendBenchmark
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+class Tree;
+
+/*!
+   Evaluates a tree once with each geometry backend: CGAL Nef polyhedra,
+   fast-csg, fast-csg-safer and Manifold. The caches are cleared before each
+   run, so every backend evaluates the whole tree.
+
+   Reports the time of each run, the memory held by its result and the
+   caches, the facets of the result, and how far the result deviates from
+   that of the first backend: the relative difference in volume (or area,
+   for 2D) and the largest difference of the bounding box corners.
+   The peak RSS of the process only grows, so it is reported for the
+   process as a whole.
+
+   The features enabled before are restored afterwards.
+ */
+namespace BackendBenchmark {
+
+// Writes the results to jsonfile as well, unless it is empty. Returns false if no backend succeeded.
+bool run(const Tree& tree, const std::string& jsonfile);
+
+}
@@ -0,0 +1,199 @@
+#include "CacheMissRecorder.h"
+#include "printutils.h"
+
+#include <algorithm>
+
+CacheMissRecorder *CacheMissRecorder::inst = nullptr;
+
+namespace {
+
+// Enough to find the closest of recent variants, without holding on to every node of a session
+constexpr size_t maxKnownPerName = 64;
+
+/*!
+   Returns the node's own part of an id string, up to its children.
+ */
+std::string_view header(std::string_view idstring)
+{
+  bool quoted = false;
+  for (size_t i = 0; i < idstring.size(); ++i) {
+    const char c = idstring[i];
+    if (quoted) {
+      if (c == '\\') ++i;
+      else if (c == '"') quoted = false;
+    } else if (c == '"') {
+      quoted = true;
+    } else if (c == '{' || c == ';') {
+      return idstring.substr(0, i);
+    }
+  }
+  return idstring;
+}
+
+/*!
+   Splits a header into punctuation, quoted strings, and everything between,
+   i.e. names and numbers. Id strings have no whitespace outside of strings.
+ */
+std::vector<std::string_view> tokenize(std::string_view s)
+{
+  static const std::string_view punctuation = "(),=[]{};";
+  std::vector<std::string_view> tokens;
+  size_t i = 0;
+  while (i < s.size()) {
+    size_t end = i + 1;
+    if (s[i] == '"') {
+      while (end < s.size() && s[end] != '"') end += s[end] == '\\' ? 2 : 1;
+      end = std::min(end + 1, s.size());
+    } else if (punctuation.find(s[i]) == std::string_view::npos) {
+      while (end < s.size() && s[end] != '"' && punctuation.find(s[end]) == std::string_view::npos) ++end;
+    }
+    tokens.push_back(s.substr(i, end - i));
+    i = end;
+  }
+  return tokens;
+}
+
+size_t commonPrefix(const std::vector<std::string_view>& a, const std::vector<std::string_view>& b)
+{
+  size_t n = 0;
+  while (n < a.size() && n < b.size() && a[n] == b[n]) ++n;
+  return n;
+}
+
+/*!
+   Returns the name of the parameter whose value holds the given token,
+   or the token itself if it is a parameter name.
+ */
+std::string parameterOf(const std::vector<std::string_view>& tokens, size_t index)
+{
+  if (index >= tokens.size()) return {};
+  if (index + 1 < tokens.size() && tokens[index + 1] == "=") return std::string(tokens[index]);
+  int depth = 0;
+  for (size_t i = index; i > 0; --i) {
+    const auto& t = tokens[i - 1];
+    if (t == "]") depth++;
+    else if (t == "[" && depth > 0) depth--;
+    else if (depth == 0 && t == "(") break;
+    else if (depth == 0 && t == "=" && i >= 2) return std::string(tokens[i - 2]);
+  }
+  return {};
+}
+
+std::string abbreviate(const std::string& s, size_t length = 80)
+{
+  return s.size() <= length ? s : s.substr(0, length - 3) + "...";
+}
+
+} // namespace
+
+void CacheMissRecorder::clear()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->misses.clear();
+  this->total = 0;
+  this->new_nodes = 0;
+  this->children_changed = 0;
+}
+
+void CacheMissRecorder::recordCached(const std::string& name, const Hash128& key, std::string_view idstring)
+{
+  std::string own(header(idstring));
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (!this->known_headers.insert(own).second) return;
+  auto& list = this->known[name];
+  if (list.size() == maxKnownPerName) {
+    this->known_headers.erase(list.front().header);
+    list.pop_front();
+  }
+  list.push_back({std::move(own), key});
+}
+
+void CacheMissRecorder::recordMiss(const std::string& name, const std::string& location, std::string_view idstring)
+{
+  const auto own = header(idstring);
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->total++;
+  if (this->known_headers.count(std::string(own))) {
+    this->children_changed++;
+    return;
+  }
+
+  const auto tokens = tokenize(own);
+  const Known *closest = nullptr;
+  std::vector<std::string_view> closest_tokens;
+  size_t best = 0;
+  auto it = this->known.find(name);
+  if (it != this->known.end()) {
+    for (const auto& candidate : it->second) {
+      auto candidate_tokens = tokenize(candidate.header);
+      const size_t n = commonPrefix(tokens, candidate_tokens);
+      // Ties go to the most recent
+      if (!closest || n >= best) {
+        closest = &candidate;
+        closest_tokens = std::move(candidate_tokens);
+        best = n;
+      }
+    }
+  }
+
+  Miss miss{name, location};
+  if (closest) {
+    miss.parameter = parameterOf(tokens, best);
+    if (best < tokens.size()) miss.token = std::string(tokens[best]);
+    if (best < closest_tokens.size()) miss.previous_token = std::string(closest_tokens[best]);
+    miss.closest = closest->header;
+    miss.closest_key = closest->key;
+  } else {
+    this->new_nodes++;
+  }
+  auto& entry = this->misses.emplace(std::make_tuple(location, name, miss.parameter, miss.token, miss.previous_token), miss).first->second;
+  entry.count++;
+}
+
+nlohmann::json CacheMissRecorder::summaryJson() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  nlohmann::json nodes = nlohmann::json::array();
+  for (const auto& entry : this->misses) {
+    const auto& miss = entry.second;
+    nlohmann::json missJson;
+    missJson["name"] = miss.name;
+    missJson["location"] = miss.location;
+    missJson["count"] = miss.count;
+    if (!miss.closest.empty()) {
+      missJson["parameter"] = miss.parameter;
+      missJson["token"] = miss.token;
+      missJson["previous_token"] = miss.previous_token;
+      missJson["closest"] = miss.closest;
+      missJson["closest_key"] = miss.closest_key.toString();
+    }
+    nodes.push_back(missJson);
+  }
+  nlohmann::json json;
+  json["misses"] = this->total;
+  json["new_nodes"] = this->new_nodes;
+  json["children_changed"] = this->children_changed;
+  json["nodes"] = nodes;
+  return json;
+}
+
+void CacheMissRecorder::print(size_t count) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (this->total == 0) return;
+  LOG("Cache misses: %1$d nodes, %2$d only due to changed children, %3$d without an earlier node of their kind:",
+      this->total, this->children_changed, this->new_nodes);
+  std::vector<const Miss *> sorted;
+  for (const auto& entry : this->misses) sorted.push_back(&entry.second);
+  std::stable_sort(sorted.begin(), sorted.end(), [](const Miss *a, const Miss *b) { return a->count > b->count; });
+  for (size_t i = 0; i < std::min(count, sorted.size()); ++i) {
+    const auto& miss = *sorted[i];
+    if (miss.closest.empty()) {
+      LOG("   %1$5d x %2$s (%3$s): new", miss.count, miss.name, miss.location);
+    } else {
+      LOG("   %1$5d x %2$s (%3$s): %4$s '%5$s', was '%6$s' in %7$s",
+          miss.count, miss.name, miss.location, miss.parameter.empty() ? "changed" : miss.parameter + " changed to",
+          abbreviate(miss.token, 40), abbreviate(miss.previous_token, 40), abbreviate(miss.closest));
+    }
+  }
+}
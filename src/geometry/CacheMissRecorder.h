@@ -0,0 +1,73 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <json.hpp>
+#include "hash.h"
+
+/*!
+   Explains why nodes missed the geometry caches (--summary cache-misses).
+
+   The GeometryEvaluator reports every node it caches, and every node it has
+   to evaluate because neither the GeometryCache nor the CGALCache holds it.
+   A miss is compared with the nodes of the same kind cached before, by the
+   node's own part of the id string (its name and parameters, without its
+   children): the closest one and the first token which differs, e.g.
+   "$fn=64" where it was "$fn=32", tell which parameter changed. Misses whose
+   own part was seen before only missed due to changed children, which are
+   listed themselves.
+
+   Known nodes are kept across renders, so the misses of a render are those
+   against everything cached earlier in the session.
+ */
+class CacheMissRecorder
+{
+public:
+  static CacheMissRecorder *instance() { if (!inst) inst = new CacheMissRecorder; return inst; }
+
+  void setEnabled(bool on) { this->enabled = on; }
+  bool isEnabled() const { return this->enabled; }
+  // Forgets the misses of the previous render, not the known nodes
+  void clear();
+
+  void recordCached(const std::string& name, const Hash128& key, std::string_view idstring);
+  void recordMiss(const std::string& name, const std::string& location, std::string_view idstring);
+
+  nlohmann::json summaryJson() const;
+  void print(size_t count = 20) const;
+
+private:
+  static CacheMissRecorder *inst;
+
+  struct Known {
+    std::string header;
+    Hash128 key;
+  };
+  // Misses of the same node and change are counted together
+  struct Miss {
+    std::string name;
+    std::string location;
+    std::string parameter;
+    std::string token;
+    std::string previous_token;
+    std::string closest;
+    Hash128 closest_key;
+    size_t count{0};
+  };
+
+  bool enabled{false};
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, std::deque<Known>> known; // By node name, most recent last
+  std::unordered_set<std::string> known_headers;
+  std::map<std::tuple<std::string, std::string, std::string, std::string, std::string>, Miss> misses;
+  size_t total{0};
+  size_t new_nodes{0};
+  size_t children_changed{0};
+};
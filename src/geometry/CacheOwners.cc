@@ -0,0 +1,24 @@
+#include "CacheOwners.h"
+
+CacheOwners *CacheOwners::inst = nullptr;
+
+unsigned CacheOwners::add()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  const unsigned owner = this->next++;
+  this->owners.push_back(owner);
+  return owner;
+}
+
+void CacheOwners::remove(unsigned owner)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->owners.erase(std::remove(this->owners.begin(), this->owners.end(), owner), this->owners.end());
+  if (this->current_owner == owner) this->current_owner = 0;
+}
+
+std::vector<unsigned> CacheOwners::active() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->owners;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/*!
+   The designs sharing the geometry caches, i.e. the tabs of the GUI. Each
+   cache entry remembers the owners which inserted or used it, so a subtree
+   cached for one tab is reused by another, e.g. when comparing variants.
+
+   Once the caches are full, the entries of closed tabs are evicted first,
+   then those of the tab using more than its share of the limit, so a big
+   design in one tab doesn't evict everything another tab uses. Without
+   owners, e.g. on the command line, only the caches' own policy applies.
+ */
+class CacheOwners
+{
+public:
+  static CacheOwners *instance() { if (!inst) inst = new CacheOwners; return inst; }
+
+  // Returns a new owner, never 0
+  unsigned add();
+  void remove(unsigned owner);
+  [[nodiscard]] std::vector<unsigned> active() const;
+
+  // The owner of the evaluation in progress, 0 for none
+  void setCurrent(unsigned owner) { this->current_owner = owner; }
+  [[nodiscard]] unsigned current() const { return this->current_owner; }
+
+private:
+  static CacheOwners *inst;
+
+  mutable std::mutex mutex;
+  std::vector<unsigned> owners;
+  unsigned next{1};
+  std::atomic<unsigned> current_owner{0};
+};
+
+// The owners of a cache entry, usually one or two
+struct CacheEntryOwners {
+  std::vector<unsigned> owners;
+
+  CacheEntryOwners() { add(CacheOwners::instance()->current()); }
+  void add(unsigned owner) {
+    if (owner && std::find(owners.begin(), owners.end(), owner) == owners.end()) owners.push_back(owner);
+  }
+  [[nodiscard]] bool contains(unsigned owner) const { return std::find(owners.begin(), owners.end(), owner) != owners.end(); }
+  [[nodiscard]] bool onlyOwnedBy(unsigned owner) const { return owners.size() == 1 && owners.front() == owner; }
+  // True if all owners were removed, not for entries without owners
+  [[nodiscard]] bool orphaned(const std::vector<unsigned>& active) const {
+    return !owners.empty() && std::none_of(owners.begin(), owners.end(), [&active](unsigned owner) {
+      return std::find(active.begin(), active.end(), owner) != active.end();
+    });
+  }
+};
+
+/*!
+   Makes room for an entry of the given cost in a ShardedCache of entries with
+   CacheEntryOwners owners, by evicting the entries of closed tabs and then
+   those of the owner using more than its share. Whatever doesn't fit after
+   that is left to the cache's own eviction.
+ */
+template <class ShardedCacheType>
+void evictForFairShare(ShardedCacheType& cache, size_t cost)
+{
+  const auto active = CacheOwners::instance()->active();
+  if (active.size() < 2) return;
+  const size_t limit = cache.maxCost();
+  if (cost > limit || cache.totalCost() + cost <= limit) return;
+  size_t excess = cache.totalCost() + cost - limit;
+
+  excess -= std::min(excess, cache.evict(excess, [&active](const auto&, const auto& entry) {
+    return !entry.owners.orphaned(active);
+  }));
+  if (excess == 0) return;
+
+  const size_t share = limit / active.size();
+  unsigned heaviest = 0;
+  size_t most = 0;
+  for (const auto owner : active) {
+    const size_t used = cache.costIf([owner](const auto&, const auto& entry) { return entry.owners.contains(owner); });
+    if (used > most) {
+      heaviest = owner;
+      most = used;
+    }
+  }
+  if (most <= share) return;
+  cache.evict(std::min(excess, most - share), [heaviest](const auto&, const auto& entry) {
+    return !entry.owners.onlyOwnedBy(heaviest);
+  });
+}
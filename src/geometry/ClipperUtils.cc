@@ -1,5 +1,9 @@
 #include "ClipperUtils.h"
+#include "parallel.h"
 #include "printutils.h"
+#include "TimingCounters.h"
+
+#include <algorithm>
 
 namespace ClipperUtils {
 
@@ -27,6 +31,38 @@ VectorOfVector2d fromPath(const ClipperLib::Path& path, int pow2)
   return ret;
 }
 
+/*!
+   Like fromPolygon2d(), but sanitized polygons keep their converted paths.
+   Results of operations are often used by several others at the same scale,
+   e.g. a panel outline offset again and again. Results of ClipperUtils carry
+   the paths they were made from, see toPolygon2d().
+
+   Paths at a coarser scale are scaled up exactly by shifting, since the
+   vertices of the polygon are on their grid.
+ */
+std::shared_ptr<const ScaledPaths> scaledPaths(const Polygon2d& poly, int pow2)
+{
+  std::shared_ptr<const ScaledPaths> result;
+  if (poly.isSanitized()) {
+    auto cached = poly.cachedClipperPaths();
+    if (cached && cached->pow2 == pow2) return cached;
+    if (cached && cached->pow2 < pow2 && pow2 - cached->pow2 < 32) {
+      const ClipperLib::cInt factor = ClipperLib::cInt(1) << (pow2 - cached->pow2);
+      ClipperLib::Paths paths = cached->paths;
+      for (auto& path : paths) {
+        for (auto& p : path) {
+          p.X *= factor;
+          p.Y *= factor;
+        }
+      }
+      result = std::make_shared<const ScaledPaths>(ScaledPaths{pow2, std::move(paths)});
+    }
+  }
+  if (!result) result = std::make_shared<const ScaledPaths>(ScaledPaths{pow2, fromPolygon2d(poly, pow2)});
+  if (poly.isSanitized()) poly.setCachedClipperPaths(result);
+  return result;
+}
+
 ClipperLib::Paths fromPolygon2d(const Polygon2d& poly, int pow2)
 {
   bool keep_orientation = poly.isSanitized();
@@ -70,8 +106,9 @@ ClipperLib::PolyTree sanitize(const ClipperLib::Paths& paths)
 
 Polygon2d *sanitize(const Polygon2d& poly)
 {
-  auto tmp = ClipperUtils::fromPolygon2d(poly);
-  return toPolygon2d(sanitize(tmp.geometry), ClipperUtils::getScalePow2(tmp.bounds));
+  TimingCounters::Scope timer(TimingCounters::CLIPPER);
+  const int pow2 = ClipperUtils::getScalePow2(poly.getBoundingBox());
+  return toPolygon2d(sanitize(scaledPaths(poly, pow2)->paths), pow2);
 }
 
 /*!
@@ -79,10 +116,14 @@ Polygon2d *sanitize(const Polygon2d& poly)
    have an explicit notion of holes.
    We could use a Paths structure, but we'd have to check the orientation of each
    path before adding it to the Polygon2d.
+
+   The result keeps the cleaned paths, so a following operation at the same
+   or a finer scale needn't convert the outlines back.
  */
 Polygon2d *toPolygon2d(const ClipperLib::PolyTree& poly, int pow2)
 {
   auto result = new Polygon2d;
+  ClipperLib::Paths paths;
   auto node = poly.GetFirst();
   double scale = std::ldexp(1.0, -pow2);
   while (node) {
@@ -100,11 +141,13 @@ Polygon2d *toPolygon2d(const ClipperLib::PolyTree& poly, int pow2)
         outline.vertices.emplace_back(scale * ip.X, scale * ip.Y);
       }
       result->addOutline(outline);
+      paths.push_back(std::move(cleaned_path));
     }
 
     node = node->GetNext();
   }
   result->setSanitized(true);
+  result->setCachedClipperPaths(std::make_shared<const ScaledPaths>(ScaledPaths{pow2, std::move(paths)}));
   return result;
 }
 
@@ -112,6 +155,7 @@ ClipperLib::Paths process(const ClipperLib::Paths& polygons,
                           ClipperLib::ClipType cliptype,
                           ClipperLib::PolyFillType polytype)
 {
+  TimingCounters::Scope timer(TimingCounters::CLIPPER);
   ClipperLib::Paths result;
   ClipperLib::Clipper clipper;
   clipper.AddPaths(polygons, ClipperLib::ptSubject, true);
@@ -127,6 +171,7 @@ ClipperLib::Paths process(const ClipperLib::Paths& polygons,
 Polygon2d *apply(const std::vector<ClipperLib::Paths>& pathsvector,
                  ClipperLib::ClipType clipType, int pow2)
 {
+  TimingCounters::Scope timer(TimingCounters::CLIPPER);
   ClipperLib::Clipper clipper;
 
   if (clipType == ClipperLib::ctIntersection && pathsvector.size() >= 2) {
@@ -166,6 +211,7 @@ Polygon2d *apply(const std::vector<ClipperLib::Paths>& pathsvector,
 Polygon2d *apply(const std::vector<const Polygon2d *>& polygons,
                  ClipperLib::ClipType clipType)
 {
+  TimingCounters::Scope timer(TimingCounters::CLIPPER);
   BoundingBox bounds;
   for (auto polygon : polygons) {
     if (polygon) bounds.extend(polygon->getBoundingBox());
@@ -175,7 +221,7 @@ Polygon2d *apply(const std::vector<const Polygon2d *>& polygons,
   std::vector<ClipperLib::Paths> pathsvector;
   for (const auto& polygon : polygons) {
     if (polygon) {
-      auto polypaths = fromPolygon2d(*polygon, pow2);
+      auto polypaths = scaledPaths(*polygon, pow2)->paths;
       if (!polygon->isSanitized()) ClipperLib::PolyTreeToPaths(sanitize(polypaths), polypaths);
       pathsvector.push_back(polypaths);
     } else {
@@ -253,8 +299,52 @@ static void fill_minkowski_insides(const ClipperLib::Paths& a,
   }
 }
 
+// Like Polygon2d::is_convex(), for a counter-clockwise path
+static bool is_convex(const ClipperLib::Path& path)
+{
+  const size_t n = path.size();
+  for (size_t i = 0; i < n; ++i) {
+    const auto& p0 = path[i];
+    const auto& p1 = path[(i + 1) % n];
+    const auto& p2 = path[(i + 2) % n];
+    double zcross = (double(p1.X) - p0.X) * (double(p2.Y) - p1.Y) - (double(p1.Y) - p0.Y) * (double(p2.X) - p1.X);
+    if (zcross < 0) return false;
+  }
+  return true;
+}
+
+// The Minkowski sum of two convex counter-clockwise paths, by merging their edges in order of angle.
+// This is linear in the number of vertices, compared to the quadratic number of quads from minkowski_outline().
+static ClipperLib::Path convex_minkowski(const ClipperLib::Path& a, const ClipperLib::Path& b)
+{
+  auto lowest = [](const ClipperLib::Path& path) {
+      return std::min_element(path.begin(), path.end(), [](const auto& p, const auto& q) {
+          return p.Y < q.Y || (p.Y == q.Y && p.X < q.X);
+        }) - path.begin();
+    };
+  const size_t n = a.size(), m = b.size();
+  const size_t a0 = lowest(a), b0 = lowest(b);
+  ClipperLib::Path result;
+  result.reserve(n + m);
+  size_t i = 0, j = 0;
+  while (i < n || j < m) {
+    const auto& p = a[(a0 + i) % n];
+    const auto& q = b[(b0 + j) % m];
+    result.emplace_back(p.X + q.X, p.Y + q.Y);
+    const auto& p1 = a[(a0 + i + 1) % n];
+    const auto& q1 = b[(b0 + j + 1) % m];
+    double cross = (double(p1.X) - p.X) * (double(q1.Y) - q.Y) - (double(p1.Y) - p.Y) * (double(q1.X) - q.X);
+    bool advance_a = i < n && (j == m || cross >= 0);
+    bool advance_b = j < m && (i == n || cross <= 0);
+    if (advance_a) ++i;
+    if (advance_b) ++j;
+  }
+  return result;
+}
+
 Polygon2d *applyMinkowski(const std::vector<const Polygon2d *>& polygons)
 {
+  TimingCounters::Scope timer(TimingCounters::CLIPPER);
   if (polygons.size() == 1) {
     return polygons[0] ? new Polygon2d(*polygons[0]) : nullptr; // Just copy
   }
@@ -275,25 +365,37 @@ Polygon2d *applyMinkowski(const std::vector<const Polygon2d *>& polygons)
   int pow2 = getScalePow2(in_bounds.extend(out_bounds));
 
   ClipperLib::Clipper c;
-  auto lhs = fromPolygon2d(polygons[0] ? *polygons[0] : Polygon2d(), pow2);
+  auto lhs = polygons[0] ? scaledPaths(*polygons[0], pow2)->paths : ClipperLib::Paths();
 
   for (size_t i = 1; i < polygons.size(); ++i) {
     if (!polygons[i]) continue;
     ClipperLib::Paths minkowski_terms;
-    auto rhs = fromPolygon2d(*polygons[i], pow2);
-
-    // First, convolve each outline of lhs with the outlines of rhs
-    for (auto const& rhs_path : rhs) {
-      for (auto const& lhs_path : lhs) {
-        ClipperLib::Paths result;
-        minkowski_outline(lhs_path, rhs_path, result, true, true);
-        minkowski_terms.insert(minkowski_terms.end(), result.begin(), result.end());
+    auto rhs_paths = scaledPaths(*polygons[i], pow2);
+    const auto& rhs = rhs_paths->paths;
+
+    if (lhs.size() == 1 && rhs.size() == 1 && lhs[0].size() >= 3 && rhs[0].size() >= 3 &&
+        ClipperLib::Orientation(lhs[0]) && ClipperLib::Orientation(rhs[0]) &&
+        is_convex(lhs[0]) && is_convex(rhs[0])) {
+      // Both operands are convex, so their sum is one convex outline
+      minkowski_terms.push_back(convex_minkowski(lhs[0], rhs[0]));
+    } else {
+      // First, convolve each outline of lhs with the outlines of rhs.
+      // The outline pairs are independent, so they are convolved in parallel.
+      std::vector<ClipperLib::Paths> outline_terms(rhs.size() * lhs.size());
+      parallelizable_cross_product_transform(rhs, lhs, outline_terms.begin(),
+                                             [](const ClipperLib::Path& rhs_path, const ClipperLib::Path& lhs_path) {
+          ClipperLib::Paths result;
+          minkowski_outline(lhs_path, rhs_path, result, true, true);
+          return result;
+        });
+      for (const auto& terms : outline_terms) {
+        minkowski_terms.insert(minkowski_terms.end(), terms.begin(), terms.end());
       }
-    }
 
-    // Then, fill the central parts
-    fill_minkowski_insides(lhs, rhs, minkowski_terms);
-    fill_minkowski_insides(rhs, lhs, minkowski_terms);
+      // Then, fill the central parts
+      fill_minkowski_insides(lhs, rhs, minkowski_terms);
+      fill_minkowski_insides(rhs, lhs, minkowski_terms);
+    }
 
     // This union operation must be performed at each iteration since the minkowski_terms
     // now contain lots of small quads
@@ -313,21 +415,46 @@ Polygon2d *applyMinkowski(const std::vector<const Polygon2d *>& polygons)
 Polygon2d *applyOffset(const Polygon2d& poly, double offset, ClipperLib::JoinType joinType,
                        double miter_limit, double arc_tolerance)
 {
-  bool isMiter = joinType == ClipperLib::jtMiter;
-  bool isRound = joinType == ClipperLib::jtRound;
+  return applyOffsets(poly, {{offset, joinType, miter_limit, arc_tolerance}});
+}
+
+/*!
+   Applies the offsets in turn, e.g. for the offset(r = -x) offset(delta = 2 * x)
+   offset(r = -x) fillet idiom. The paths stay in Clipper's integer space
+   between the steps, at a scale fitting the growth of all of them, and are
+   only converted back to a Polygon2d at the end.
+ */
+Polygon2d *applyOffsets(const Polygon2d& poly, const std::vector<OffsetStep>& steps)
+{
+  TimingCounters::Scope timer(TimingCounters::CLIPPER);
   auto bounds = poly.getBoundingBox();
-  double max_diff = std::abs(offset) * (isMiter ? miter_limit : 1.0);
+  double max_diff = 0;
+  for (const auto& step : steps) {
+    max_diff += std::abs(step.delta) * (step.joinType == ClipperLib::jtMiter ? step.miter_limit : 1.0);
+  }
   bounds.min() -= Vector3d(max_diff, max_diff, 0);
   bounds.max() += Vector3d(max_diff, max_diff, 0);
   int pow2 = getScalePow2(bounds);
-  ClipperLib::ClipperOffset co(
-    isMiter ? miter_limit : 2.0,
-    isRound ? std::ldexp(arc_tolerance, pow2) : 1.0
-    );
-  auto p = ClipperUtils::fromPolygon2d(poly, pow2);
-  co.AddPaths(p, joinType, ClipperLib::etClosedPolygon);
+
+  ClipperLib::Paths paths = scaledPaths(poly, pow2)->paths;
   ClipperLib::PolyTree result;
-  co.Execute(result, std::ldexp(offset, pow2));
+  for (size_t i = 0; i < steps.size(); ++i) {
+    const auto& step = steps[i];
+    bool isMiter = step.joinType == ClipperLib::jtMiter;
+    bool isRound = step.joinType == ClipperLib::jtRound;
+    ClipperLib::ClipperOffset co(
+      isMiter ? step.miter_limit : 2.0,
+      isRound ? std::ldexp(step.arc_tolerance, pow2) : 1.0
+      );
+    co.AddPaths(paths, step.joinType, ClipperLib::etClosedPolygon);
+    if (i + 1 < steps.size()) {
+      // Cleaned like toPolygon2d() would between separate offsets
+      co.Execute(paths, std::ldexp(step.delta, pow2));
+      ClipperLib::CleanPolygons(paths);
+    } else {
+      co.Execute(result, std::ldexp(step.delta, pow2));
+    }
+  }
   return toPolygon2d(result, pow2);
 }
 } // namespace ClipperUtils
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+#include <vector>
 #include "ext/polyclipping/clipper.hpp"
 #include "Polygon2d.h"
 
@@ -12,8 +14,23 @@ struct AutoScaled {
   BoundingBox bounds;
 };
 
+// The outlines of a polygon scaled by 2^pow2
+struct ScaledPaths {
+  int pow2;
+  ClipperLib::Paths paths;
+};
+
+// One offset() of a chain, see applyOffsets()
+struct OffsetStep {
+  double delta;
+  ClipperLib::JoinType joinType;
+  double miter_limit;
+  double arc_tolerance;
+};
+
 int getScalePow2(const BoundingBox& bounds, int bits = 0);
 ClipperLib::Paths fromPolygon2d(const Polygon2d& poly, int pow2);
+std::shared_ptr<const ScaledPaths> scaledPaths(const Polygon2d& poly, int pow2);
 ClipperLib::PolyTree sanitize(const ClipperLib::Paths& paths);
 VectorOfVector2d fromPath(const ClipperLib::Path& path, int pow2);
 Polygon2d *sanitize(const Polygon2d& poly);
@@ -21,6 +38,8 @@ Polygon2d *toPolygon2d(const ClipperLib::PolyTree& poly, int pow2);
 ClipperLib::Paths process(const ClipperLib::Paths& polygons,
                           ClipperLib::ClipType, ClipperLib::PolyFillType);
 Polygon2d *applyOffset(const Polygon2d& poly, double offset, ClipperLib::JoinType joinType, double miter_limit, double arc_tolerance);
+Polygon2d *applyOffsets(const Polygon2d& poly, const std::vector<OffsetStep>& steps);
 Polygon2d *applyMinkowski(const std::vector<const Polygon2d *>& polygons);
+Polygon2d *apply(const std::vector<ClipperLib::Paths>& pathsvector, ClipperLib::ClipType, int pow2);
 Polygon2d *apply(const std::vector<const Polygon2d *>& polygons, ClipperLib::ClipType);
 }
@@ -0,0 +1,87 @@
+#include "CostHistory.h"
+#include "printutils.h"
+
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+CostHistory *CostHistory::inst = nullptr;
+
+namespace {
+
+// Appended to the file, a later record for the same key replaces the earlier one
+struct Record {
+  uint64_t h1, h2;
+  double seconds;
+};
+
+} // namespace
+
+void CostHistory::setFile(const std::string& filename)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (this->file.is_open()) this->file.close();
+  if (filename.empty()) return;
+
+  size_t records = 0;
+  {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    Record record;
+    while (in.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+      auto& seconds = this->costs[Hash128{record.h1, record.h2}];
+      this->total += record.seconds - seconds;
+      seconds = record.seconds;
+      records++;
+    }
+  }
+
+  // Rewrite the file once re-evaluated nodes make up most of it
+  if (records > 2 * this->costs.size() + 1024) {
+    const auto tmppath = fs::path(filename).parent_path() / fs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+    bool ok;
+    {
+      std::ofstream out(tmppath.string(), std::ios::out | std::ios::binary);
+      for (const auto& entry : this->costs) {
+        const Record record{entry.first.h1, entry.first.h2, entry.second};
+        out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+      }
+      ok = out.good();
+    }
+    boost::system::error_code ec;
+    if (ok) fs::rename(tmppath, filename, ec);
+    if (!ok || ec) fs::remove(tmppath, ec);
+  }
+
+  this->file.open(filename, std::ios::out | std::ios::binary | std::ios::app);
+  if (!this->file.is_open()) {
+    LOG(message_group::Warning, "Can't record evaluation times in '%1$s'", filename);
+  }
+}
+
+void CostHistory::record(const Hash128& key, double seconds)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto& recorded = this->costs[key];
+  this->total += seconds - recorded;
+  recorded = seconds;
+  if (this->file.is_open()) {
+    const Record record{key.h1, key.h2, seconds};
+    // Flushed right away, as other processes may append to the same file
+    this->file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    this->file.flush();
+  }
+}
+
+std::optional<double> CostHistory::get(const Hash128& key) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  auto it = this->costs.find(key);
+  if (it == this->costs.end()) return {};
+  return it->second;
+}
+
+double CostHistory::typical() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->costs.empty() ? 0 : this->total / this->costs.size();
+}
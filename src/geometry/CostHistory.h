@@ -0,0 +1,40 @@
+#pragma once
+
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "hash.h"
+
+/*!
+   The times it took to evaluate nodes, by subtree key, for predicting the
+   cost of evaluating them again: render progress is weighed by it, and the
+   parallel evaluation starts the costliest subtrees first.
+
+   Each time is the node's own work, excluding its children, so the cost of a
+   subtree is the sum over the nodes which aren't cached. With the geometry
+   disk cache enabled, the times are kept in its directory across runs.
+ */
+class CostHistory
+{
+public:
+  static CostHistory *instance() { if (!inst) inst = new CostHistory; return inst; }
+
+  // Loads the times recorded in the file and appends new ones to it, no file keeps them in memory only
+  void setFile(const std::string& filename);
+
+  void record(const Hash128& key, double seconds);
+  std::optional<double> get(const Hash128& key) const;
+  // The mean of the recorded times, assumed for nodes evaluated for the first time
+  double typical() const;
+  size_t size() const { std::lock_guard<std::mutex> lock(this->mutex); return this->costs.size(); }
+
+private:
+  static CostHistory *inst;
+
+  mutable std::mutex mutex;
+  std::unordered_map<Hash128, double> costs;
+  double total{0};
+  std::ofstream file;
+};
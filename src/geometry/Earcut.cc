@@ -0,0 +1,296 @@
+#include "Earcut.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Vertex in a doubly linked ring, rings are linked by index into a node vector
+struct Node {
+  Node(double x, double y) : x(x), y(y) {}
+  double x, y;
+  int prev{-1};
+  int next{-1};
+};
+
+using Nodes = std::vector<Node>;
+
+// Twice the signed area of the triangle, negative for counter-clockwise order
+double area(const Node& p, const Node& q, const Node& r)
+{
+  return (q.y - p.y) * (r.x - q.x) - (q.x - p.x) * (r.y - q.y);
+}
+
+double signedArea(const Outline2d& o)
+{
+  double sum = 0;
+  for (size_t i = 0, j = o.vertices.size() - 1; i < o.vertices.size(); j = i++) {
+    sum += (o.vertices[j][0] - o.vertices[i][0]) * (o.vertices[i][1] + o.vertices[j][1]);
+  }
+  return sum / 2;
+}
+
+bool contains(const Outline2d& o, const Vector2d& p)
+{
+  bool inside = false;
+  for (size_t i = 0, j = o.vertices.size() - 1; i < o.vertices.size(); j = i++) {
+    const auto& a = o.vertices[i];
+    const auto& b = o.vertices[j];
+    if ((a[1] > p[1]) != (b[1] > p[1]) &&
+        p[0] < (b[0] - a[0]) * (p[1] - a[1]) / (b[1] - a[1]) + a[0]) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+bool pointInTriangle(const Node& a, const Node& b, const Node& c, const Node& p)
+{
+  return (c.x - p.x) * (a.y - p.y) >= (a.x - p.x) * (c.y - p.y) &&
+         (a.x - p.x) * (b.y - p.y) >= (b.x - p.x) * (a.y - p.y) &&
+         (b.x - p.x) * (c.y - p.y) >= (c.x - p.x) * (b.y - p.y);
+}
+
+int insertNode(Nodes& nodes, const Vector2d& v, int last)
+{
+  int i = nodes.size();
+  nodes.emplace_back(v[0], v[1]);
+  if (last < 0) {
+    nodes[i].prev = nodes[i].next = i;
+  } else {
+    nodes[i].next = nodes[last].next;
+    nodes[i].prev = last;
+    nodes[nodes[last].next].prev = i;
+    nodes[last].next = i;
+  }
+  return i;
+}
+
+void removeNode(Nodes& nodes, int i)
+{
+  nodes[nodes[i].next].prev = nodes[i].prev;
+  nodes[nodes[i].prev].next = nodes[i].next;
+}
+
+// Links the outline as a ring, counter-clockwise for outer outlines and clockwise for holes
+int linkRing(Nodes& nodes, const Outline2d& o, bool counterclockwise)
+{
+  int last = -1;
+  if (counterclockwise == (signedArea(o) > 0)) {
+    for (const auto& v : o.vertices) last = insertNode(nodes, v, last);
+  } else {
+    for (auto it = o.vertices.rbegin(); it != o.vertices.rend(); ++it) last = insertNode(nodes, *it, last);
+  }
+  return last;
+}
+
+bool isEar(const Nodes& nodes, int ear)
+{
+  const Node& a = nodes[nodes[ear].prev];
+  const Node& b = nodes[ear];
+  const Node& c = nodes[b.next];
+  if (area(a, b, c) >= 0) return false; // reflex or collinear
+
+  const double x0 = std::min({a.x, b.x, c.x}), x1 = std::max({a.x, b.x, c.x});
+  const double y0 = std::min({a.y, b.y, c.y}), y1 = std::max({a.y, b.y, c.y});
+  for (int p = c.next; p != b.prev; p = nodes[p].next) {
+    const Node& n = nodes[p];
+    if (n.x >= x0 && n.x <= x1 && n.y >= y0 && n.y <= y1 &&
+        pointInTriangle(a, b, c, n) &&
+        area(nodes[n.prev], n, nodes[n.next]) >= 0) return false;
+  }
+  return true;
+}
+
+bool locallyInside(const Nodes& nodes, int a, int b)
+{
+  const Node& na = nodes[a];
+  const Node& nb = nodes[b];
+  return area(nodes[na.prev], na, nodes[na.next]) < 0 ?
+         area(na, nb, nodes[na.next]) >= 0 && area(na, nodes[na.prev], nb) >= 0 :
+         area(na, nb, nodes[na.prev]) < 0 || area(na, nodes[na.next], nb) < 0;
+}
+
+bool sectorContainsSector(const Nodes& nodes, int m, int p)
+{
+  return area(nodes[nodes[m].prev], nodes[m], nodes[nodes[p].prev]) < 0 &&
+         area(nodes[nodes[p].next], nodes[m], nodes[nodes[m].next]) < 0;
+}
+
+// Finds a vertex of the outer ring which can be connected to the leftmost vertex of a hole
+int findHoleBridge(const Nodes& nodes, int hole, int outer)
+{
+  const double hx = nodes[hole].x, hy = nodes[hole].y;
+  double qx = -std::numeric_limits<double>::infinity();
+  int m = -1;
+
+  // Find the segment left of the hole vertex, closest to it on a horizontal ray
+  int p = outer;
+  do {
+    const Node& n = nodes[p];
+    const Node& next = nodes[n.next];
+    if (hy <= n.y && hy >= next.y && next.y != n.y) {
+      double x = n.x + (hy - n.y) * (next.x - n.x) / (next.y - n.y);
+      if (x <= hx && x > qx) {
+        qx = x;
+        m = n.x < next.x ? p : n.next;
+        if (x == hx) return m; // the hole touches the outer segment
+      }
+    }
+    p = n.next;
+  } while (p != outer);
+  if (m < 0) return -1;
+
+  // Vertices inside the triangle of the hole vertex, the intersection and the segment
+  // endpoint would block the bridge. Use the one with the smallest angle instead.
+  const int stop = m;
+  double tanMin = std::numeric_limits<double>::infinity();
+  p = m;
+  do {
+    const Node& n = nodes[p];
+    const Node& mn = nodes[m];
+    if (hx >= n.x && n.x >= mn.x && hx != n.x &&
+        pointInTriangle(Node(hy < mn.y ? hx : qx, hy), mn, Node(hy < mn.y ? qx : hx, hy), n)) {
+      double tan = std::abs(hy - n.y) / (hx - n.x);
+      if (locallyInside(nodes, p, hole) &&
+          (tan < tanMin || (tan == tanMin && (n.x > mn.x || (n.x == mn.x && sectorContainsSector(nodes, m, p)))))) {
+        m = p;
+        tanMin = tan;
+      }
+    }
+    p = n.next;
+  } while (p != stop);
+  return m;
+}
+
+// Connects a and b with a pair of coincident edges, which splices b's ring into a's
+void splitRing(Nodes& nodes, int a, int b)
+{
+  int a2 = nodes.size();
+  nodes.emplace_back(nodes[a].x, nodes[a].y);
+  int b2 = nodes.size();
+  nodes.emplace_back(nodes[b].x, nodes[b].y);
+  int an = nodes[a].next, bp = nodes[b].prev;
+
+  nodes[a].next = b;
+  nodes[b].prev = a;
+  nodes[a2].next = an;
+  nodes[an].prev = a2;
+  nodes[b2].next = a2;
+  nodes[a2].prev = b2;
+  nodes[bp].next = b2;
+  nodes[b2].prev = bp;
+}
+
+int leftmost(const Nodes& nodes, int start)
+{
+  int p = start, left = start;
+  do {
+    if (nodes[p].x < nodes[left].x || (nodes[p].x == nodes[left].x && nodes[p].y < nodes[left].y)) left = p;
+    p = nodes[p].next;
+  } while (p != start);
+  return left;
+}
+
+bool clipEars(Nodes& nodes, int ear, VectorOfVector2d& triangles)
+{
+  int stop = ear;
+  while (nodes[ear].prev != nodes[ear].next) {
+    int prev = nodes[ear].prev, next = nodes[ear].next;
+    if (isEar(nodes, ear)) {
+      triangles.emplace_back(nodes[prev].x, nodes[prev].y);
+      triangles.emplace_back(nodes[ear].x, nodes[ear].y);
+      triangles.emplace_back(nodes[next].x, nodes[next].y);
+      removeNode(nodes, ear);
+      ear = stop = nodes[next].next;
+      continue;
+    }
+    ear = next;
+    // No ear in a full round, e.g. for touching or degenerate outlines
+    if (ear == stop) return false;
+  }
+  return true;
+}
+
+// Triangulates an outer outline with its holes
+bool triangulateGroup(const Polygon2d::Outlines2d& outlines, size_t outer, const std::vector<size_t>& holes,
+                      VectorOfVector2d& triangles)
+{
+  size_t count = outlines[outer].vertices.size();
+  for (auto h : holes) count += outlines[h].vertices.size();
+
+  Nodes nodes;
+  nodes.reserve(count + 2 * holes.size());
+  int ring = linkRing(nodes, outlines[outer], true);
+
+  std::vector<int> holenodes;
+  for (auto h : holes) holenodes.push_back(leftmost(nodes, linkRing(nodes, outlines[h], false)));
+  std::sort(holenodes.begin(), holenodes.end(), [&](int a, int b) { return nodes[a].x < nodes[b].x; });
+  for (int hole : holenodes) {
+    int bridge = findHoleBridge(nodes, hole, ring);
+    if (bridge < 0) return false;
+    splitRing(nodes, bridge, hole);
+  }
+
+  return clipEars(nodes, ring, triangles);
+}
+
+} // namespace
+
+namespace Earcut {
+
+bool triangulate(const Polygon2d& poly, size_t max_vertices, VectorOfVector2d& triangles)
+{
+  const auto& outlines = poly.outlines();
+
+  // Assign each hole to the smallest outer outline containing it
+  std::vector<double> areas;
+  std::vector<size_t> outers;
+  double total_area = 0, abs_area = 0;
+  for (size_t i = 0; i < outlines.size(); ++i) {
+    if (outlines[i].vertices.size() < 3) return false;
+    areas.push_back(std::abs(signedArea(outlines[i])));
+    if (outlines[i].positive) outers.push_back(i);
+    total_area += outlines[i].positive ? areas[i] : -areas[i];
+    abs_area += areas[i];
+  }
+  std::vector<std::vector<size_t>> holes(outlines.size());
+  std::vector<size_t> sizes(outlines.size());
+  for (size_t i = 0; i < outlines.size(); ++i) {
+    if (outlines[i].positive) {
+      sizes[i] += outlines[i].vertices.size();
+      continue;
+    }
+    size_t best = outlines.size();
+    for (auto o : outers) {
+      if ((best == outlines.size() || areas[o] < areas[best]) && contains(outlines[o], outlines[i].vertices[0])) best = o;
+    }
+    if (best == outlines.size()) return false;
+    holes[best].push_back(i);
+    sizes[best] += outlines[i].vertices.size();
+  }
+  for (auto o : outers) {
+    if (sizes[o] > max_vertices) return false;
+  }
+
+  VectorOfVector2d result;
+  for (auto o : outers) {
+    if (!triangulateGroup(outlines, o, holes[o], result)) return false;
+  }
+
+  // Holes assigned to the wrong outline would show up as a difference in area
+  double result_area = 0;
+  for (size_t i = 0; i + 2 < result.size(); i += 3) {
+    const auto& a = result[i];
+    const auto& b = result[i + 1];
+    const auto& c = result[i + 2];
+    result_area += ((b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1])) / 2;
+  }
+  if (std::abs(result_area - total_area) > 1e-6 * abs_area) return false;
+
+  triangles.insert(triangles.end(), result.begin(), result.end());
+  return true;
+}
+
+} // namespace Earcut
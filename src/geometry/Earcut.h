@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Polygon2d.h"
+
+/*!
+   Ear clipping triangulation of sanitized polygons, after the algorithm of
+   mapbox/earcut. Holes are bridged into the outline containing them, so every
+   outline vertex is kept and no vertices are added.
+ */
+namespace Earcut {
+
+/*!
+   Appends the triangles of poly, three counter-clockwise vertices each.
+   Fails if an outline group has more than max_vertices vertices, or if no
+   valid triangulation was found. Triangles is left unchanged on failure.
+ */
+bool triangulate(const Polygon2d& poly, size_t max_vertices, VectorOfVector2d& triangles);
+
+}
@@ -1,6 +1,11 @@
 #include "GeometryCache.h"
 #include "printutils.h"
+#include "Feature.h"
 #include "Geometry.h"
+#include "PolySet.h"
+#include "Polygon2d.h"
+
+#include <string>
 
 #ifdef DEBUG
   #ifndef ENABLE_CGAL
@@ -11,28 +16,142 @@
 
 GeometryCache *GeometryCache::inst = nullptr;
 
-shared_ptr<const Geometry> GeometryCache::get(const std::string& id) const
+namespace {
+
+template <typename T>
+void append_value(std::string& buffer, const T& value)
+{
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void append_polygon2d(std::string& buffer, const Polygon2d& poly)
+{
+  append_value<uint8_t>(buffer, poly.isSanitized());
+  append_value<uint64_t>(buffer, poly.outlines().size());
+  for (const auto& outline : poly.outlines()) {
+    append_value<uint8_t>(buffer, outline.positive);
+    append_value<uint64_t>(buffer, outline.vertices.size());
+    for (const auto& v : outline.vertices) {
+      append_value(buffer, v[0]);
+      append_value(buffer, v[1]);
+    }
+  }
+}
+
+/*!
+   Hashes everything that distinguishes a mesh, including the properties
+   which don't change the shape like convexity. Only materialized meshes
+   are hashed, returns false for other geometry.
+ */
+bool content_hash(const Geometry& geom, Hash128& hash)
 {
-  const auto& geom = this->cache[id]->geom;
+  std::string buffer;
+  if (const auto ps = dynamic_cast<const PolySet *>(&geom)) {
+    const auto convex = ps->convexValue();
+    buffer.reserve(ps->memsize());
+    append_value<uint8_t>(buffer, 1);
+    append_value<uint32_t>(buffer, ps->getDimension());
+    append_value<int32_t>(buffer, ps->getConvexity());
+    append_value<int8_t>(buffer, boost::indeterminate(convex) ? 2 : (convex ? 1 : 0));
+    append_value<uint64_t>(buffer, ps->getPolygons().size());
+    for (const auto& poly : ps->getPolygons()) {
+      append_value<uint32_t>(buffer, poly.size());
+      for (const auto& v : poly) {
+        append_value(buffer, v[0]);
+        append_value(buffer, v[1]);
+        append_value(buffer, v[2]);
+      }
+    }
+    if (ps->getDimension() == 2) append_polygon2d(buffer, ps->getPolygon());
+  } else if (const auto poly = dynamic_cast<const Polygon2d *>(&geom)) {
+    buffer.reserve(poly->memsize());
+    append_value<uint8_t>(buffer, 2);
+    append_value<int32_t>(buffer, poly->getConvexity());
+    append_polygon2d(buffer, *poly);
+  } else {
+    return false;
+  }
+  hash = hash128(buffer.data(), buffer.size());
+  return true;
+}
+
+} // namespace
+
+shared_ptr<const Geometry> GeometryCache::get(const Hash128& id) const
+{
+  return this->cache.access(id, [&id](Cache<Hash128, cache_entry>& cache) -> shared_ptr<const Geometry> {
+    const auto entry = cache[id];
+    if (!entry) return nullptr;
+    entry->owners.add(CacheOwners::instance()->current());
 #ifdef DEBUG
-  PRINTDB("Geometry Cache hit: %s (%d bytes)", id.substr(0, 40) % (geom ? geom->memsize() : 0));
+    PRINTDB("Geometry Cache hit: %s (%d bytes)", id.toString() % (entry->geom ? entry->geom->memsize() : 0));
 #endif
-  return geom;
+    return entry->geom;
+  });
 }
 
-bool GeometryCache::insert(const std::string& id, const shared_ptr<const Geometry>& geom)
+/*!
+   With geometry-dedup, a mesh equal to one already cached for another node
+   is stored as the cached one, and counted only once: by the entry which
+   first held it.
+ */
+bool GeometryCache::insert(const Hash128& id, const shared_ptr<const Geometry>& geom, double computetime)
 {
-  auto inserted = this->cache.insert(id, new cache_entry(geom), geom ? geom->memsize() : 0);
+  bool duplicate = false;
+  const auto shared = geom && Feature::ExperimentalGeometryDedup.is_enabled() ? deduplicate(geom, duplicate) : geom;
+  const size_t cost = shared && !duplicate ? shared->memsize() : 0;
+  makeRoom(cost);
+  auto inserted = this->cache.insert(id, new cache_entry(shared), cost, computetime);
 #ifdef DEBUG
   assert(!dynamic_cast<const CGAL_Nef_polyhedron *>(geom.get()));
   if (inserted) PRINTDB("Geometry Cache insert: %s (%d bytes)",
-                        id.substr(0, 40) % (geom ? geom->memsize() : 0));
+                        id.toString() % (geom ? geom->memsize() : 0));
   else PRINTDB("Geometry Cache insert failed: %s (%d bytes)",
-               id.substr(0, 40) % (geom ? geom->memsize() : 0));
+               id.toString() % (geom ? geom->memsize() : 0));
 #endif
   return inserted;
 }
 
+/*!
+   Returns the geometry with the same content as geom held by the cache, or
+   geom itself after registering it as the holder of its content.
+ */
+shared_ptr<const Geometry> GeometryCache::deduplicate(const shared_ptr<const Geometry>& geom, bool& duplicate)
+{
+  Hash128 hash;
+  if (geom->isEmpty() || !content_hash(*geom, hash)) return geom;
+  std::lock_guard<std::mutex> lock(this->contents_mutex);
+  auto& entry = this->contents[hash];
+  if (auto existing = entry.lock()) {
+    if (existing != geom) {
+      duplicate = true;
+      this->numduplicates++;
+      this->duplicatebytes += geom->memsize();
+    }
+    return existing;
+  }
+  entry = geom;
+  // The index only refers to the meshes, drop those freed since
+  if (this->contents.size() > 2 * this->contents_pruned + 64) {
+    for (auto it = this->contents.begin(); it != this->contents.end();) {
+      if (it->second.expired()) it = this->contents.erase(it);
+      else ++it;
+    }
+    this->contents_pruned = this->contents.size();
+  }
+  return geom;
+}
+
+void GeometryCache::clear()
+{
+  this->cache.clear();
+  this->conversions_inserted = 0;
+  this->conversions_pruned = 0;
+  std::lock_guard<std::mutex> lock(this->contents_mutex);
+  this->contents.clear();
+  this->contents_pruned = 0;
+}
+
 size_t GeometryCache::size() const
 {
   return cache.size();
@@ -53,10 +172,164 @@ void GeometryCache::setMaxSizeMB(size_t limit)
   this->cache.setMaxCost(limit * 1024ul * 1024ul);
 }
 
+/*!
+   Before the cache evicts anything to fit cost, conversions whose source was
+   freed are dropped, as they can't be looked up anymore.
+ */
+void GeometryCache::makeRoom(size_t cost)
+{
+  if (this->cache.totalCost() + cost > this->cache.maxCost()) removeExpiredConversions();
+  evictForFairShare(this->cache, cost);
+}
+
+size_t GeometryCache::removeExpiredConversions()
+{
+  const size_t freed = this->cache.removeIf([](const Hash128&, const cache_entry& entry) {
+    return entry.conversion && entry.source.expired();
+  });
+  this->conversions_inserted = 0;
+  this->conversions_pruned = this->cache.size();
+  return freed;
+}
+
+/*!
+   Conversions share the memory limit with the node results. They are keyed
+   by the address of the source geometry, so a child reused by several
+   operators is converted only once while it stays in memory. The address is
+   hashed with its own seed, so the keys can't match those of node results,
+   and the entry holds a weak_ptr to tell a reused address from its source.
+ */
+Hash128 GeometryCache::conversionKey(const Geometry *geom, Conversion to)
+{
+  const uint64_t key[2] = {reinterpret_cast<uintptr_t>(geom), static_cast<uint64_t>(to)};
+  return hash128(key, sizeof(key), /* seed */ 0x636f6e76ull);
+}
+
+shared_ptr<const Geometry> GeometryCache::getConversion(const shared_ptr<const Geometry>& geom, Conversion to)
+{
+  const Hash128 key = conversionKey(geom.get(), to);
+  return this->cache.access(key, [&](Cache<Hash128, cache_entry>& cache) -> shared_ptr<const Geometry> {
+    const auto entry = cache[key];
+    if (!entry) return nullptr;
+    if (entry->source.lock() != geom) {
+      // The source was freed, and its address reused
+      cache.remove(key);
+      return nullptr;
+    }
+    return entry->geom;
+  });
+}
+
+void GeometryCache::insertConversion(const shared_ptr<const Geometry>& geom, Conversion to, const shared_ptr<const Geometry>& converted)
+{
+  auto entry = new cache_entry(converted);
+  entry->source = geom;
+  entry->conversion = true;
+  const size_t cost = converted ? converted->memsize() : 0;
+  // Sources are freed without the cache knowing, drop their conversions now and then
+  if (++this->conversions_inserted > this->conversions_pruned / 2 + 64) removeExpiredConversions();
+  makeRoom(cost);
+  this->cache.insert(conversionKey(geom.get(), to), entry, cost);
+}
+
+bool GeometryCache::releaseForModification(const shared_ptr<const Geometry>& geom)
+{
+  Hash128 hash;
+  const bool hashed = Feature::ExperimentalGeometryDedup.is_enabled() && !geom->isEmpty() && content_hash(*geom, hash);
+  // Other threads only find geom through the contents index, under this lock
+  std::lock_guard<std::mutex> lock(this->contents_mutex);
+  if (geom.use_count() != 1) return false;
+  if (hashed) {
+    const auto it = this->contents.find(hash);
+    if (it != this->contents.end() && it->second.lock() == geom) this->contents.erase(it);
+  }
+  for (const auto to : {Conversion::PolySet, Conversion::Manifold, Conversion::Nef, Conversion::ConvexParts,
+                        Conversion::Footprint, Conversion::Hull, Conversion::ApproximateManifold, Conversion::PreviewLOD}) {
+    this->cache.remove(conversionKey(geom.get(), to));
+  }
+  return true;
+}
+
+size_t GeometryCache::ownerCost(unsigned owner) const
+{
+  return this->cache.costIf([owner](const Hash128&, const cache_entry& entry) {
+    return entry.owners.contains(owner);
+  });
+}
+
+size_t GeometryCache::unpinnedCost() const
+{
+  return this->cache.costIf([](const Hash128&, const cache_entry& entry) {
+    return entry.geom.use_count() == 1;
+  });
+}
+
+size_t GeometryCache::evictUnpinned(size_t bytes, std::vector<std::pair<Hash128, shared_ptr<const Geometry>>> *spill)
+{
+  const size_t expired = removeExpiredConversions();
+  if (expired >= bytes) return expired;
+  return expired + this->cache.evict(bytes - expired, [spill](const Hash128& id, const cache_entry& entry) {
+    if (entry.geom.use_count() != 1) return true;
+    // Conversions are keyed by address, they can't be found again later
+    if (spill && !entry.conversion) spill->emplace_back(id, entry.geom);
+    return false;
+  });
+}
+
+bool GeometryCache::claim(const Hash128& id)
+{
+  const auto self = std::this_thread::get_id();
+  std::unique_lock<std::mutex> lock(this->inflight_mutex);
+  auto it = this->inflight.find(id);
+  if (it == this->inflight.end()) {
+    this->inflight.emplace(id, InFlight{self, 1});
+    return true;
+  }
+  if (it->second.owner == self) {
+    it->second.depth++;
+    return true;
+  }
+  // Follow the owners and what they wait for, if that leads back to us
+  // waiting would never end
+  auto owner = it->second.owner;
+  for (size_t i = 0; i < this->waiting.size(); ++i) {
+    const auto waits = this->waiting.find(owner);
+    if (waits == this->waiting.end()) break;
+    const auto next = this->inflight.find(waits->second);
+    if (next == this->inflight.end()) break;
+    owner = next->second.owner;
+    if (owner == self) return true;
+  }
+  this->waiting[self] = id;
+  this->inflight_done.wait(lock, [this, &id]() { return this->inflight.find(id) == this->inflight.end(); });
+  this->waiting.erase(self);
+  return false;
+}
+
+void GeometryCache::release(const Hash128& id)
+{
+  std::lock_guard<std::mutex> lock(this->inflight_mutex);
+  auto it = this->inflight.find(id);
+  if (it == this->inflight.end() || it->second.owner != std::this_thread::get_id()) return;
+  if (--it->second.depth > 0) return;
+  this->inflight.erase(it);
+  this->inflight_done.notify_all();
+}
+
 void GeometryCache::print()
 {
   LOG("Geometries in cache: %1$d", this->cache.size());
   LOG("Geometry cache size in bytes: %1$d", this->cache.totalCost());
+  LOG("Geometry cache compute time held: %1$.3f s, evicted: %2$d entries (%3$.3f s)",
+      this->cache.totalBenefit(), this->cache.evictions(), this->cache.evictedBenefit());
+  const auto owner = CacheOwners::instance()->current();
+  if (owner && CacheOwners::instance()->active().size() > 1) {
+    LOG("Geometry cache size in bytes used by this design: %1$d", ownerCost(owner));
+  }
+  if (Feature::ExperimentalGeometryDedup.is_enabled()) {
+    std::lock_guard<std::mutex> lock(this->contents_mutex);
+    LOG("Geometry cache duplicates shared: %1$d (%2$d bytes)", this->numduplicates, this->duplicatebytes);
+  }
 }
 
 GeometryCache::cache_entry::cache_entry(const shared_ptr<const Geometry>& geom)
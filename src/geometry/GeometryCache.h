@@ -1,7 +1,16 @@
 #pragma once
 
-#include "Cache.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ShardedCache.h"
+#include "CacheOwners.h"
 #include "memory.h"
+#include "hash.h"
 #include "Geometry.h"
 
 class GeometryCache
@@ -11,15 +20,48 @@ public:
 
   static GeometryCache *instance() { if (!inst) inst = new GeometryCache; return inst; }
 
-  bool contains(const std::string& id) const { return this->cache.contains(id); }
-  shared_ptr<const class Geometry> get(const std::string& id) const;
-  bool insert(const std::string& id, const shared_ptr<const Geometry>& geom);
+  bool contains(const Hash128& id) const { return this->cache.contains(id); }
+  shared_ptr<const class Geometry> get(const Hash128& id) const;
+  // computetime is the time in seconds it took to evaluate geom, weighing
+  // its eviction against its memory use
+  bool insert(const Hash128& id, const shared_ptr<const Geometry>& geom, double computetime = 0);
   size_t size() const;
   size_t totalCost() const;
   size_t maxSizeMB() const;
   void setMaxSizeMB(size_t limit);
-  void clear() { cache.clear(); }
+  void clear();
   void print();
+  // Bytes held by entries the owner inserted or used, including those shared with other owners
+  size_t ownerCost(unsigned owner) const;
+
+  // Bytes held by entries no evaluation refers to, which eviction would free
+  size_t unpinnedCost() const;
+  // Evicts unpinned entries, least recently used first, until at least bytes
+  // were freed. The evicted node results are appended to spill. Returns the bytes freed.
+  size_t evictUnpinned(size_t bytes, std::vector<std::pair<Hash128, shared_ptr<const Geometry>>> *spill);
+
+  // Representations a geometry may be converted to by the backends.
+  // ConvexParts is a GeometryList of the convex PolySets of a decomposition,
+  // Footprint the Polygon2d of projection(cut = false). ApproximateManifold
+  // is the unrepaired conversion of quick renders. PreviewLOD is the PolySet
+  // decimated for previews.
+  enum class Conversion { PolySet = 1, Manifold, Nef, ConvexParts, Footprint, Hull, ApproximateManifold, PreviewLOD };
+  // Returns nullptr unless geom was converted before and is still alive
+  shared_ptr<const Geometry> getConversion(const shared_ptr<const Geometry>& geom, Conversion to);
+  void insertConversion(const shared_ptr<const Geometry>& geom, Conversion to, const shared_ptr<const Geometry>& converted);
+  // Returns true if geom is referenced by nobody but the caller, after
+  // dropping what the cache remembers about it, so it may be modified in place
+  bool releaseForModification(const shared_ptr<const Geometry>& geom);
+
+  // Keeps threads from evaluating the same subtree at once. Returns true if
+  // the caller should evaluate id, and must then call release(id) once the
+  // result is cached. Returns false after waiting for another thread which
+  // evaluated id meanwhile. Doesn't wait where that would deadlock, i.e. for
+  // a thread waiting for the caller, and rather lets both evaluate id. Threads
+  // of the TBB pool may wait as well, as long as evaluations run isolated,
+  // see GeometryEvaluator::traverseIsolated().
+  bool claim(const Hash128& id);
+  void release(const Hash128& id);
 
 private:
   static GeometryCache *inst;
@@ -27,8 +69,39 @@ private:
   struct cache_entry {
     shared_ptr<const class Geometry> geom;
     std::string msg;
+    // For conversions, the geometry geom was converted from
+    std::weak_ptr<const Geometry> source;
+    bool conversion{false};
+    CacheEntryOwners owners;
     cache_entry(const shared_ptr<const Geometry>& geom);
   };
 
-  Cache<std::string, cache_entry> cache;
+  static Hash128 conversionKey(const Geometry *geom, Conversion to);
+  // Removes the conversions of sources freed since, returns the bytes freed
+  size_t removeExpiredConversions();
+  void makeRoom(size_t cost);
+  shared_ptr<const Geometry> deduplicate(const shared_ptr<const Geometry>& geom, bool& duplicate);
+
+  // Sharded, as the cache is accessed from several evaluation threads
+  ShardedCache<Hash128, cache_entry> cache;
+
+  struct InFlight {
+    std::thread::id owner;
+    int depth; // Claims by the owner
+  };
+  std::unordered_map<Hash128, InFlight> inflight;
+  std::unordered_map<std::thread::id, Hash128> waiting;
+  std::mutex inflight_mutex;
+  std::condition_variable inflight_done;
+
+  // Conversions inserted since, and the cache size when, expired ones were last removed
+  std::atomic<size_t> conversions_inserted{0};
+  std::atomic<size_t> conversions_pruned{0};
+
+  // Meshes in the cache by content hash, for geometry-dedup
+  std::unordered_map<Hash128, std::weak_ptr<const Geometry>> contents;
+  size_t contents_pruned{0}; // Size of contents when expired entries were last removed
+  size_t numduplicates{0};
+  size_t duplicatebytes{0};
+  std::mutex contents_mutex;
 };
@@ -0,0 +1,291 @@
+#include "GeometryDiskCache.h"
+#include "GeometryFile.h"
+#include "GeometryRemoteCache.h"
+#include "CostHistory.h"
+#include "printutils.h"
+#include "version.h"
+#include "Feature.h"
+#include "Geometry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+GeometryDiskCache *GeometryDiskCache::inst = nullptr;
+
+
+/*!
+   Enables the cache, using (and creating if necessary) the given directory.
+   Existing entries are indexed so they count towards the size limit.
+ */
+bool GeometryDiskCache::setDirectory(const std::string& dir, bool writethrough)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->writethrough = writethrough;
+  this->entries.clear();
+  this->total = 0;
+  this->dir.clear();
+  if (dir.empty()) return true;
+
+  try {
+    fs::create_directories(dir);
+    for (const auto& entry : fs::directory_iterator(dir)) {
+      if (fs::is_regular_file(entry.status()) && entry.path().extension() == GeometryFile::extension) {
+        const auto size = fs::file_size(entry.path());
+        this->entries[entry.path().filename().string()] = size;
+        this->total += size;
+      }
+    }
+  } catch (const fs::filesystem_error& e) {
+    LOG(message_group::Warning, "Can't use geometry cache directory '%1$s': %2$s", dir, e.what());
+    this->entries.clear();
+    this->total = 0;
+    return false;
+  }
+  this->dir = dir;
+
+  // Geometry results may depend on the OpenSCAD version and on enabled features,
+  // so entries from different configurations must never alias each other.
+  const std::string config = openscad_versionnumber + " " + Feature::features();
+  this->prefix = hash128(config.data(), config.size());
+
+  if (this->total > this->maxsize) prune(this->maxsize);
+  CostHistory::instance()->setFile((fs::path(dir) / "costs").string());
+  return true;
+}
+
+void GeometryDiskCache::setMaxSizeMB(size_t limit)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->maxsize = limit * 1024ul * 1024ul;
+  if (isEnabled() && this->total > this->maxsize) prune(this->maxsize);
+}
+
+std::string GeometryDiskCache::entryName(const Hash128& id) const
+{
+  const Hash128 key[2] = {this->prefix, id};
+  return hash128(key, sizeof(key)).toString() + GeometryFile::extension;
+}
+
+bool GeometryDiskCache::contains(const Hash128& id) const
+{
+  if (!isEnabled()) return false;
+  const auto name = entryName(id);
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->entries.find(name) != this->entries.end()) return true;
+  }
+  return GeometryRemoteCache::instance()->contains(name);
+}
+
+shared_ptr<const Geometry> GeometryDiskCache::get(const Hash128& id)
+{
+  if (!isEnabled()) return nullptr;
+  const auto name = entryName(id);
+  bool local;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    local = this->entries.find(name) != this->entries.end();
+  }
+  // A prefetch of the entry stores it locally once done, fetching it again would only race with it
+  if (!local && GeometryRemoteCache::instance()->waitForPending(name)) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    local = this->entries.find(name) != this->entries.end();
+  }
+
+  const auto path = fs::path(this->dir) / name;
+  shared_ptr<const Geometry> geom;
+  if (local) {
+    geom = GeometryFile::load(path.string());
+  } else {
+    std::string data;
+    if (!GeometryRemoteCache::instance()->fetch(name, data)) return nullptr;
+    geom = GeometryFile::read(data);
+    if (geom) store(name, data);
+  }
+  if (!geom) {
+    // Pruned by another process, truncated or otherwise unusable
+    std::lock_guard<std::mutex> lock(this->mutex);
+    remove(name);
+    return nullptr;
+  }
+
+  boost::system::error_code ec;
+  fs::last_write_time(path, std::time(nullptr), ec); // Mark as recently used
+  std::lock_guard<std::mutex> lock(this->mutex);
+  ++this->numhits;
+#ifdef DEBUG
+  PRINTDB("Disk Cache hit: %s", id.toString());
+#endif
+  return geom;
+}
+
+/*!
+   Writes the geometry to the cache directory, and publishes it to the remote
+   cache if it took long enough to evaluate.
+ */
+bool GeometryDiskCache::insert(const Hash128& id, const shared_ptr<const Geometry>& geom, double computetime)
+{
+  if (!isEnabled() || !geom) return false;
+  const auto name = entryName(id);
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->entries.find(name) != this->entries.end()) return true;
+  }
+
+  std::ostringstream out;
+  if (!GeometryFile::write(out, *geom)) return false;
+  const auto data = out.str();
+  auto remote = GeometryRemoteCache::instance();
+  if (remote->isEnabled() && computetime >= remote->minComputeTime()) remote->publish(name, data);
+#ifdef DEBUG
+  PRINTDB("Disk Cache insert: %s (%d bytes)", id.toString() % data.size());
+#endif
+  return store(name, data);
+}
+
+/*!
+   Stores a list of geometries, e.g. the intermediate state of a long running
+   operation, replacing any earlier entry with the same id.
+ */
+bool GeometryDiskCache::insertParts(const Hash128& id, const std::vector<shared_ptr<const Geometry>>& parts)
+{
+  if (!isEnabled()) return false;
+  Geometry::Geometries children;
+  for (const auto& part : parts) children.emplace_back(nullptr, part);
+  std::ostringstream out;
+  if (!GeometryFile::write(out, GeometryList(children), true)) return false;
+  const auto name = entryName(id);
+  const auto data = out.str();
+  auto remote = GeometryRemoteCache::instance();
+  if (remote->isEnabled()) remote->publish(name, data);
+  {
+    // Unindex only, the file is replaced atomically by store()
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->entries.find(name);
+    if (it != this->entries.end()) {
+      this->total -= it->second;
+      this->entries.erase(it);
+    }
+  }
+  return store(name, data);
+}
+
+std::vector<shared_ptr<const Geometry>> GeometryDiskCache::getParts(const Hash128& id)
+{
+  std::vector<shared_ptr<const Geometry>> parts;
+  if (const auto list = dynamic_pointer_cast<const GeometryList>(get(id))) {
+    for (const auto& item : list->getChildren()) parts.push_back(item.second);
+  }
+  return parts;
+}
+
+void GeometryDiskCache::erase(const Hash128& id)
+{
+  if (!isEnabled()) return;
+  const auto name = entryName(id);
+  std::lock_guard<std::mutex> lock(this->mutex);
+  remove(name);
+}
+
+void GeometryDiskCache::prefetch(const Hash128& id)
+{
+  if (!isEnabled()) return;
+  const auto name = entryName(id);
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->entries.find(name) != this->entries.end()) return;
+  }
+  GeometryRemoteCache::instance()->prefetch(name, [this, name](const std::string& data) { store(name, data); });
+}
+
+/*!
+   Writes a serialized entry. It's written to a temporary file first, so
+   concurrent processes sharing the directory never see partial entries.
+ */
+bool GeometryDiskCache::store(const std::string& name, const std::string& data)
+{
+  const auto path = fs::path(this->dir) / name;
+  const auto tmppath = fs::path(this->dir) / fs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+  bool ok;
+  {
+    std::ofstream out(tmppath.string(), std::ios::out | std::ios::binary);
+    out.write(data.data(), data.size());
+    ok = out.good();
+  }
+
+  boost::system::error_code ec;
+  if (ok) fs::rename(tmppath, path, ec);
+  if (!ok || ec) {
+    fs::remove(tmppath, ec);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (!this->entries.emplace(name, data.size()).second) return true; // Inserted concurrently
+  this->total += data.size();
+  if (this->total > this->maxsize) prune(this->maxsize * 3 / 4);
+  return true;
+}
+
+bool GeometryDiskCache::adopt(const Hash128& id)
+{
+  if (!isEnabled()) return false;
+  const auto name = entryName(id);
+  boost::system::error_code ec;
+  const auto size = fs::file_size(fs::path(this->dir) / name, ec);
+  if (ec) return false;
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (this->entries.emplace(name, size).second) this->total += size;
+  return true;
+}
+
+/*!
+   Removes the entry with the given file name. The caller must hold the mutex.
+ */
+void GeometryDiskCache::remove(const std::string& name)
+{
+  auto it = this->entries.find(name);
+  if (it == this->entries.end()) return;
+  boost::system::error_code ec;
+  fs::remove(fs::path(this->dir) / name, ec);
+  this->total -= it->second;
+  this->entries.erase(it);
+}
+
+/*!
+   Removes least recently used entries until the total size is below limit.
+   The caller must hold the mutex.
+ */
+void GeometryDiskCache::prune(size_t limit)
+{
+  std::vector<std::pair<std::time_t, std::string>> byage;
+  byage.reserve(this->entries.size());
+  for (const auto& entry : this->entries) {
+    boost::system::error_code ec;
+    const auto mtime = fs::last_write_time(fs::path(this->dir) / entry.first, ec);
+    byage.emplace_back(ec ? 0 : mtime, entry.first);
+  }
+  std::sort(byage.begin(), byage.end());
+  for (const auto& entry : byage) {
+    if (this->total <= limit) break;
+    remove(entry.second);
+  }
+}
+
+void GeometryDiskCache::print()
+{
+  if (!isEnabled()) return;
+  std::lock_guard<std::mutex> lock(this->mutex);
+  LOG("Geometries in disk cache: %1$d", this->entries.size());
+  LOG("Disk cache size in bytes: %1$d", this->total);
+  LOG("Disk cache hits: %1$d", this->numhits);
+  GeometryRemoteCache::instance()->print();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "memory.h"
+#include "hash.h"
+
+class Geometry;
+
+/*!
+   Persistent, content-addressed geometry cache shared across runs.
+
+   Entries are stored as one file per subtree key in the cache directory.
+   The directory is pruned in least-recently-used order (based on file
+   modification time, which is refreshed on every hit) once the total size
+   exceeds the configured limit.
+
+   The cache is disabled until a directory is set, e.g. with --cache-dir.
+   A directory set with --spill-dir isn't written through: it only receives
+   the results evicted from memory under --max-memory.
+
+   With a GeometryRemoteCache store set, local misses are looked up there,
+   and costly results are published to it.
+
+   The directory also keeps the CostHistory, the evaluation times by key.
+ */
+class GeometryDiskCache
+{
+public:
+  GeometryDiskCache() = default;
+
+  static GeometryDiskCache *instance() { if (!inst) inst = new GeometryDiskCache; return inst; }
+
+  bool setDirectory(const std::string& dir, bool writethrough = true);
+  const std::string& directory() const { return this->dir; }
+  bool isEnabled() const { return !this->dir.empty(); }
+  // Whether every evaluated result is stored, rather than only spilled ones
+  bool writesThrough() const { return this->writethrough; }
+
+  bool contains(const Hash128& id) const;
+  shared_ptr<const Geometry> get(const Hash128& id);
+  bool insert(const Hash128& id, const shared_ptr<const Geometry>& geom, double computetime = 0);
+  // Lists of geometries, for checkpoints of long running operations
+  bool insertParts(const Hash128& id, const std::vector<shared_ptr<const Geometry>>& parts);
+  std::vector<shared_ptr<const Geometry>> getParts(const Hash128& id);
+  void erase(const Hash128& id);
+  // Fetches the entry from the remote cache in the background, if it's there
+  void prefetch(const Hash128& id);
+  // Indexes the entry if another process sharing the directory wrote it
+  bool adopt(const Hash128& id);
+  size_t size() const { std::lock_guard<std::mutex> lock(this->mutex); return this->entries.size(); }
+  size_t totalCost() const { std::lock_guard<std::mutex> lock(this->mutex); return this->total; }
+  size_t maxSizeMB() const { return this->maxsize / (1024ul * 1024ul); }
+  void setMaxSizeMB(size_t limit);
+  size_t hits() const { std::lock_guard<std::mutex> lock(this->mutex); return this->numhits; }
+  void print();
+
+private:
+  static GeometryDiskCache *inst;
+
+  std::string entryName(const Hash128& id) const;
+  bool store(const std::string& name, const std::string& data);
+  void remove(const std::string& name);
+  void prune(size_t limit);
+
+  std::string dir;
+  // Distinguishes entries written by different versions and configurations
+  Hash128 prefix;
+  std::unordered_map<std::string, size_t> entries; // file name -> file size
+  size_t total{0};
+  size_t maxsize{1024ul * 1024ul * 1024ul};
+  size_t numhits{0};
+  bool writethrough{true};
+  // Guards the index, which may be accessed from several evaluation threads
+  mutable std::mutex mutex;
+};
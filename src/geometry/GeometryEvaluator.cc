@@ -1,6 +1,13 @@
 #include "GeometryEvaluator.h"
 #include "Tree.h"
 #include "GeometryCache.h"
+#include "GeometryDiskCache.h"
+#include "GeometryRemoteCache.h"
+#include "NodeProfiler.h"
+#include "CacheMissRecorder.h"
+#include "CostHistory.h"
+#include "MemoryLimit.h"
+#include "TimingCounters.h"
 #include "CGALCache.h"
 #include "Polygon2d.h"
 #include "ModuleInstantiation.h"
@@ -16,6 +23,7 @@
 #include "ProjectionNode.h"
 #include "CsgOpNode.h"
 #include "TextNode.h"
+#include "ImportNode.h"
 #include "CGALHybridPolyhedron.h"
 #include "cgalutils.h"
 #include "RenderNode.h"
@@ -27,22 +35,42 @@
 #include "calc.h"
 #include "DxfData.h"
 #include "degree_trig.h"
+#include "parallel.h"
+#include "progress.h"
+#include "Cache.h"
+#include "openscad_mimalloc.h"
 #include <ciso646> // C alternative tokens (xor)
 #include <algorithm>
+#include <functional>
+#include <mutex>
+#include <iterator>
+#include <numeric>
+#include <unordered_set>
 #include "boost-utils.h"
 #ifdef ENABLE_MANIFOLD
 #include "ManifoldGeometry.h"
 #include "manifoldutils.h"
 #endif
 
-#include <CGAL/convex_hull_2.h>
-#include <CGAL/Point_2.h>
+#ifdef ENABLE_TBB
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#endif
 
 class Geometry;
 class Polygon2d;
 class Tree;
 
-GeometryEvaluator::GeometryEvaluator(const Tree& tree) : tree(tree) { }
+GeometryEvaluator::GeometryEvaluator(const Tree& tree, Precision precision)
+  : tree(tree), precision(precision), profile_mark(NodeProfiler::instance()->now()) { }
+
+GeometryEvaluator::~GeometryEvaluator()
+{
+  // The results this evaluator held no longer count towards the memory limit
+  if (this->working_set) MemoryLimit::instance()->update(this->working_set, 0);
+  // Nodes left unfinished, e.g. when cancelled, are free for other threads to evaluate
+  for (const auto& claim : this->claims) GeometryCache::instance()->release(claim.second);
+}
 
 /*!
    Set allownef to false to force the result to _not_ be a Nef polyhedron
@@ -50,7 +78,12 @@ GeometryEvaluator::GeometryEvaluator(const Tree& tree) : tree(tree) { }
 shared_ptr<const Geometry> GeometryEvaluator::evaluateGeometry(const AbstractNode& node,
                                                                bool allownef)
 {
-  const std::string& key = this->tree.getIdString(node);
+  TimingCounters::Scope timer(TimingCounters::GEOMETRY);
+  const Hash128 key = cacheKey(node);
+  if (!GeometryCache::instance()->contains(key) && !CGALCache::instance()->contains(key)) {
+    prefetchFromRemoteCache(node);
+    restoreFromDiskCache(key);
+  }
   if (!GeometryCache::instance()->contains(key)) {
     shared_ptr<const Geometry> N;
     if (CGALCache::instance()->contains(key)) {
@@ -61,7 +94,12 @@ shared_ptr<const Geometry> GeometryEvaluator::evaluateGeometry(const AbstractNod
     if (N) {
       this->root = N;
     } else {
-      this->traverse(node);
+      try {
+        traverseIsolated(node);
+      } catch (const ProgressCancelException&) {
+        cacheVisitedChildren();
+        throw;
+      }
     }
 
     if (dynamic_pointer_cast<const CGALHybridPolyhedron>(this->root)) {
@@ -117,6 +155,25 @@ GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren(const Abstrac
   return {};
 }
 
+/*!
+   Groups the children into clusters of objects whose bounding boxes overlap,
+   directly or through other children. Touching boxes count as overlapping.
+   Objects in different clusters cannot intersect each other.
+ */
+static std::vector<Geometry::Geometries> clusterByBoundingBox(const Geometry::Geometries& children)
+{
+  std::vector<BoundingBox> boxes;
+  boxes.reserve(children.size());
+  for (const auto& item : children) boxes.push_back(item.second->getBoundingBox());
+
+  std::vector<Geometry::Geometries> clusters;
+  for (const auto& indices : GeometryUtils::clusterByBoundingBox(boxes)) {
+    clusters.emplace_back();
+    for (const auto i : indices) clusters.back().push_back(children[i]);
+  }
+  return clusters;
+}
+
 /*!
    Applies the operator to all child nodes of the given node.
 
@@ -154,6 +211,9 @@ GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren3D(const Abstr
     }
     if (actualchildren.empty()) return {};
     if (actualchildren.size() == 1) return {actualchildren.front().second};
+#ifdef ENABLE_MANIFOLD
+    if (useManifold()) return {ManifoldUtils::applyMinkowskiManifold(actualchildren)};
+#endif
     return {CGALUtils::applyMinkowski(actualchildren)};
     break;
   }
@@ -165,19 +225,108 @@ GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren3D(const Abstr
     }
     if (actualchildren.empty()) return {};
     if (actualchildren.size() == 1) return {actualchildren.front().second};
+
+    auto applyUnion = [this](Geometry::Geometries& operands) -> shared_ptr<const Geometry> {
+      if (operands.size() == 1) return operands.front().second;
 #ifdef ENABLE_MANIFOLD
-    if (Feature::ExperimentalManifold.is_enabled()) {
-      return {ManifoldUtils::applyOperator3DManifold(actualchildren, op)};
+      if (useManifold()) {
+        return ManifoldUtils::applyOperator3DManifold(operands, OpenSCADOperator::UNION, isApproximate());
+      }
+#endif
+      // Checkpoints are keyed by the operands, so a restarted union can resume
+      std::vector<Hash128> keys;
+      for (const auto& item : operands) {
+        if (item.first) keys.push_back(cacheKey(*item.first));
+      }
+      useCachedNefPolyhedra(operands);
+      shared_ptr<const Geometry> result;
+      if (keys.size() < operands.size()) {
+        result = CGALUtils::applyUnion3D(operands.begin(), operands.end());
+      } else {
+        const Hash128 checkpoint = hash128(keys.data(), keys.size() * sizeof(Hash128));
+        result = CGALUtils::applyUnion3D(operands.begin(), operands.end(), &checkpoint);
+      }
+      cacheNefPolyhedra(operands);
+      return result;
+    };
+
+    if (Feature::ExperimentalDisjointUnion.is_enabled()) {
+      // Only objects whose bounding boxes overlap need a boolean union,
+      // the results for disjoint clusters can simply be combined.
+      auto clusters = clusterByBoundingBox(actualchildren);
+      if (clusters.size() > 1) {
+        auto *ps = new PolySet(3);
+        unsigned int convexity = 1;
+        for (auto& cluster : clusters) {
+          auto chps = CGALUtils::getGeometryAsPolySet(applyUnion(cluster));
+          if (!chps) continue;
+          ps->append(*chps);
+          convexity = std::max(convexity, chps->getConvexity());
+        }
+        ps->setConvexity(convexity);
+        return ps;
+      }
     }
+    return {applyUnion(actualchildren)};
+    break;
+  }
+  case OpenSCADOperator::DIFFERENCE:
+  {
+#ifdef ENABLE_MANIFOLD
+    // Filters and merges the subtrahends itself
+    if (useManifold()) return {ManifoldUtils::applyOperator3DManifold(children, op, isApproximate())};
 #endif
-    return {CGALUtils::applyUnion3D(actualchildren.begin(), actualchildren.end())};
+    const auto& minuend = children.front();
+    if (!minuend.second || minuend.second->isEmpty()) return {};
+
+    // Subtrahends outside the minuend's bounding box can't change it
+    const auto bbox = minuend.second->getBoundingBox();
+    Geometry::Geometries subtrahends;
+    for (auto it = std::next(children.begin()); it != children.end(); ++it) {
+      if (it->second && !it->second->isEmpty() && it->second->getBoundingBox().intersects(bbox)) subtrahends.push_back(*it);
+      else if (it->first) it->first->progress_report();
+    }
+
+    Geometry::Geometries operands{minuend};
+    if (subtrahends.size() > 1) {
+      // Subtract their union once, so the minuend takes part in one boolean only.
+      // Subtrahends that can't touch each other are combined without a union.
+      auto clusters = clusterByBoundingBox(subtrahends);
+      for (auto& cluster : clusters) {
+        if (cluster.size() > 1) useCachedNefPolyhedra(cluster);
+      }
+      shared_ptr<const Geometry> merged;
+      if (clusters.size() == 1) {
+        merged = CGALUtils::applyUnion3D(clusters.front().begin(), clusters.front().end());
+      } else {
+        auto ps = make_shared<PolySet>(3);
+        unsigned int convexity = 1;
+        for (auto& cluster : clusters) {
+          auto chps = CGALUtils::getGeometryAsPolySet(cluster.size() == 1 ? cluster.front().second :
+                                                      CGALUtils::applyUnion3D(cluster.begin(), cluster.end()));
+          if (!chps) continue;
+          ps->append(*chps);
+          convexity = std::max(convexity, chps->getConvexity());
+        }
+        ps->setConvexity(convexity);
+        merged = ps;
+      }
+      for (const auto& cluster : clusters) cacheNefPolyhedra(cluster);
+      if (merged) operands.emplace_back(nullptr, merged);
+    } else {
+      operands.insert(operands.end(), subtrahends.begin(), subtrahends.end());
+    }
+    useCachedNefPolyhedra(operands);
+    auto result = CGALUtils::applyOperator3D(operands, op);
+    cacheNefPolyhedra(operands);
+    return {result};
     break;
   }
   default:
   {
 #ifdef ENABLE_MANIFOLD
-    if (Feature::ExperimentalManifold.is_enabled()) {
-      return {ManifoldUtils::applyOperator3DManifold(children, op)};
+    if (useManifold()) {
+      return {ManifoldUtils::applyOperator3DManifold(children, op, isApproximate())};
     }
 #endif
     return {CGALUtils::applyOperator3D(children, op)};
@@ -194,37 +343,48 @@ GeometryEvaluator::ResultObject GeometryEvaluator::applyToChildren3D(const Abstr
    May return an empty geometry but will not return nullptr.
  */
 
+/*!
+   Hulls the corners of the children's own hulls. Those are found in
+   parallel, and kept in the GeometryCache for larger children, as chained
+   hulls often share children with their neighbours.
+ */
 Polygon2d *GeometryEvaluator::applyHull2D(const AbstractNode& node)
 {
-  std::vector<const Polygon2d *> children = collectChildren2D(node);
-  auto *geometry = new Polygon2d();
+  constexpr size_t minimumPointsForCachedHull = 64;
+  collectChildren2D(node); // Caches the children and warns about 3D ones
+  std::vector<shared_ptr<const Polygon2d>> children;
+  for (const auto& item : this->visitedchildren[node.index()]) {
+    if (item.first->modinst->isBackground()) continue;
+    auto poly = dynamic_pointer_cast<const Polygon2d>(item.second);
+    if (poly && !poly->isEmpty()) children.push_back(poly);
+  }
 
-  using CGALPoint2 = CGAL::Point_2<CGAL::Cartesian<double>>;
-  // Collect point cloud
-  std::list<CGALPoint2> points;
-  for (const auto& p : children) {
-    if (p) {
-      for (const auto& o : p->outlines()) {
-        for (const auto& v : o.vertices) {
-          points.emplace_back(v[0], v[1]);
-        }
-      }
+  auto cache = GeometryCache::instance();
+  std::vector<shared_ptr<const Polygon2d>> hulls(children.size());
+  parallelizable_transform(children.begin(), children.end(), hulls.begin(), [cache](const shared_ptr<const Polygon2d>& child) {
+    if (auto hull = dynamic_pointer_cast<const Polygon2d>(cache->getConversion(child, GeometryCache::Conversion::Hull))) {
+      return hull;
     }
+    VectorOfVector2d points;
+    for (const auto& o : child->outlines()) points.insert(points.end(), o.vertices.begin(), o.vertices.end());
+    const bool cached = points.size() >= minimumPointsForCachedHull;
+    auto hull = make_shared<Polygon2d>();
+    Outline2d outline;
+    outline.vertices = GeometryUtils::convexHull2D(std::move(points));
+    hull->addOutline(std::move(outline));
+    if (cached) cache->insertConversion(child, GeometryCache::Conversion::Hull, hull);
+    return shared_ptr<const Polygon2d>(hull);
+  });
+
+  auto *geometry = new Polygon2d();
+  VectorOfVector2d points;
+  for (const auto& hull : hulls) {
+    for (const auto& o : hull->outlines()) points.insert(points.end(), o.vertices.begin(), o.vertices.end());
   }
-  if (points.size() > 0) {
-    // Apply hull
-    std::list<CGALPoint2> result;
-    try {
-      CGAL::convex_hull_2(points.begin(), points.end(), std::back_inserter(result));
-      // Construct Polygon2d
-      Outline2d outline;
-      for (const auto& p : result) {
-        outline.vertices.push_back(Vector2d(p[0], p[1]));
-      }
-      geometry->addOutline(outline);
-    } catch (const CGAL::Failure_exception& e) {
-      LOG(message_group::Warning, "GeometryEvaluator::applyHull2D() during CGAL::convex_hull_2(): %1$s", e.what());
-    }
+  if (!points.empty()) {
+    Outline2d outline;
+    outline.vertices = GeometryUtils::convexHull2D(std::move(points));
+    geometry->addOutline(std::move(outline));
   }
   return geometry;
 }
@@ -233,15 +393,16 @@ Polygon2d *GeometryEvaluator::applyFill2D(const AbstractNode& node)
 {
   // Merge and sanitize input geometry
   std::vector<const Polygon2d *> children = collectChildren2D(node);
-  Polygon2d *geometry_in = ClipperUtils::apply(children, ClipperLib::ctUnion);
+  std::unique_ptr<Polygon2d> geometry_in(ClipperUtils::apply(children, ClipperLib::ctUnion));
 
+  std::vector<std::unique_ptr<Polygon2d>> positive;
   std::vector<const Polygon2d *> newchildren;
   // Keep only the 'positive' outlines, eg: the outside edges
   for (const auto& outline : geometry_in->outlines()) {
     if (outline.positive) {
-      auto *poly = new Polygon2d();
-      poly->addOutline(outline);
-      newchildren.push_back(poly);
+      positive.push_back(std::make_unique<Polygon2d>());
+      positive.back()->addOutline(outline);
+      newchildren.push_back(positive.back().get());
     }
   }
 
@@ -316,29 +477,217 @@ std::vector<const Polygon2d *> GeometryEvaluator::collectChildren2D(const Abstra
 void GeometryEvaluator::smartCacheInsert(const AbstractNode& node,
                                          const shared_ptr<const Geometry>& geom)
 {
-  const std::string& key = this->tree.getIdString(node);
+  const Hash128 key = cacheKey(node);
+  double computetime = 0;
+  auto it = this->computetimes.find(node.index());
+  if (it != this->computetimes.end()) {
+    computetime = it->second;
+    this->computetimes.erase(it);
+    CostHistory::instance()->record(key, computetime);
+  }
 
   if (CGALCache::acceptsGeometry(geom)) {
-    if (!CGALCache::instance()->contains(key)) CGALCache::instance()->insert(key, geom);
+    if (!CGALCache::instance()->contains(key)) CGALCache::instance()->insert(key, geom, computetime);
   } else {
     if (!GeometryCache::instance()->contains(key)) {
-      if (!GeometryCache::instance()->insert(key, geom)) {
+      if (!GeometryCache::instance()->insert(key, geom, computetime)) {
         LOG(message_group::Warning, "GeometryEvaluator: Node didn't fit into cache.");
       }
     }
   }
+  if (GeometryDiskCache::instance()->isEnabled() && GeometryDiskCache::instance()->writesThrough()) {
+    GeometryDiskCache::instance()->insert(key, geom, computetime);
+  }
+  auto recorder = CacheMissRecorder::instance();
+  if (recorder->isEnabled()) recorder->recordCached(node.verbose_name(), key, this->tree.getIdString(node));
+}
+
+/*!
+   Returns the result as a geometry which may be modified. A const result
+   nobody else refers to, in particular no cache, is taken over instead of
+   copied.
+ */
+shared_ptr<Geometry> GeometryEvaluator::ResultObject::asMutableGeometry()
+{
+  if (!isConst()) return ptr();
+  if (!this->const_pointer) return nullptr;
+  if (GeometryCache::instance()->releaseForModification(this->const_pointer)) {
+    // Geometries are all created mutable, const only marks them as shared
+    this->pointer = std::const_pointer_cast<Geometry>(std::move(this->const_pointer));
+  } else {
+    this->pointer.reset(this->const_pointer->copy());
+  }
+  this->const_pointer.reset();
+  this->is_const = false;
+  return this->pointer;
 }
 
+/*!
+   Drops the children of node ahead of addToParent(), so a child's result
+   passed on by the node is referenced only by the node's ResultObject.
+   The profiler still needs them to measure the node's inputs.
+ */
+void GeometryEvaluator::releaseChildren(const AbstractNode& node)
+{
+  if (!NodeProfiler::instance()->isEnabled()) this->visitedchildren.erase(node.index());
+}
+
+/*!
+   Caches the finished children, as collectChildren3D() would. Used when evaluation
+   is cancelled, so evaluating the tree again resumes from the finished subtrees.
+ */
+void GeometryEvaluator::cacheFinished(const Geometry::Geometries& children)
+{
+  for (const auto& item : children) {
+    if (item.first && !item.first->modinst->isBackground()) smartCacheInsert(*item.first, item.second);
+  }
+}
+
+void GeometryEvaluator::cacheVisitedChildren()
+{
+  for (const auto& visited : this->visitedchildren) {
+    // The child of a transform or offset still pending passed on its input geometry
+    if (this->pendingtransforms.count(visited.first) || this->pendingoffsets.count(visited.first)) continue;
+    cacheFinished(visited.second);
+  }
+}
+
+/*!
+   Returns true if the node is cached. Otherwise the node is claimed for this
+   evaluator, so other threads wanting the same subtree wait for its result
+   instead of evaluating it as well.
+ */
 bool GeometryEvaluator::isSmartCached(const AbstractNode& node)
 {
-  const std::string& key = this->tree.getIdString(node);
+  const Hash128 key = cacheKey(node);
+  if (isCached(key)) return true;
+  if (this->claims.count(node.index())) return false;
+  if (GeometryCache::instance()->claim(key)) {
+    this->claims[node.index()] = key;
+    auto recorder = CacheMissRecorder::instance();
+    if (recorder->isEnabled()) recorder->recordMiss(node.verbose_name(), nodeLocation(node), this->tree.getIdString(node));
+    return false;
+  }
+  // Another thread evaluated the node meanwhile
+  return isCached(key);
+}
+
+/*!
+   Returns the key of the node's geometry in the caches. Approximate results
+   go by other keys, so exact evaluations never pick them up.
+ */
+Hash128 GeometryEvaluator::cacheKey(const AbstractNode& node) const
+{
+  const Hash128 key = this->tree.getIdHash(node);
+  if (!isApproximate()) return key;
+  return hash128(&key, sizeof(key), /* seed */ static_cast<uint64_t>(Precision::Approximate));
+}
+
+/*!
+   Returns the node's source file, relative to the document, and line.
+ */
+std::string GeometryEvaluator::nodeLocation(const AbstractNode& node) const
+{
+  const auto& location = node.modinst->location();
+  if (location.isNone()) return "unknown";
+  return boostfs_uncomplete(location.fileName(), this->tree.getDocumentPath()).generic_string() + ":" + std::to_string(location.firstLine());
+}
+
+bool GeometryEvaluator::useManifold() const
+{
+#ifdef ENABLE_MANIFOLD
+  return isApproximate() || Feature::ExperimentalManifold.is_enabled();
+#else
+  return false;
+#endif
+}
+
+bool GeometryEvaluator::hasCachedResult(const AbstractNode& node) const
+{
+  const Hash128 key = cacheKey(node);
+  return GeometryCache::instance()->contains(key) || CGALCache::instance()->contains(key);
+}
+
+/*!
+   Returns the time evaluating the node itself is expected to take, in
+   seconds, from the time it took before. Cached nodes take no time.
+ */
+double GeometryEvaluator::predictedSelfTime(const AbstractNode& node) const
+{
+  if (hasCachedResult(node)) return 0;
+  const auto history = CostHistory::instance();
+  const auto seconds = history->get(cacheKey(node));
+  return seconds ? *seconds : history->typical();
+}
+
+/*!
+   Returns the time evaluating the subtree is expected to take, in seconds,
+   i.e. that of its nodes which aren't cached.
+ */
+double GeometryEvaluator::predictedTime(const AbstractNode& node) const
+{
+  double seconds = 0;
+  std::vector<const AbstractNode *> stack{&node};
+  std::unordered_set<const AbstractNode *> visited;
+  while (!stack.empty()) {
+    const auto *current = stack.back();
+    stack.pop_back();
+    if (!visited.insert(current).second || hasCachedResult(*current)) continue;
+    seconds += predictedSelfTime(*current);
+    for (const auto& child : current->children) stack.push_back(child.get());
+  }
+  return seconds;
+}
+
+bool GeometryEvaluator::isCached(const Hash128& key)
+{
   return (GeometryCache::instance()->contains(key) ||
-          CGALCache::instance()->contains(key));
+          CGALCache::instance()->contains(key) ||
+          restoreFromDiskCache(key));
+}
+
+/*!
+   Loads the geometry for the given key from the persistent disk cache (if enabled)
+   into the appropriate in-memory cache. Returns true if the geometry is now cached.
+ */
+bool GeometryEvaluator::restoreFromDiskCache(const Hash128& key)
+{
+  auto diskcache = GeometryDiskCache::instance();
+  if (!diskcache->contains(key)) return false;
+  auto geom = diskcache->get(key);
+  if (!geom) return false;
+  if (CGALCache::acceptsGeometry(geom)) return CGALCache::instance()->insert(key, geom);
+  return GeometryCache::instance()->insert(key, geom);
+}
+
+/*!
+   Starts fetching the topmost subtrees found in the remote cache, so they
+   arrive while the rest of the tree is evaluated. Subtrees below them are
+   never needed.
+ */
+void GeometryEvaluator::prefetchFromRemoteCache(const AbstractNode& node)
+{
+  auto diskcache = GeometryDiskCache::instance();
+  if (!diskcache->isEnabled() || !GeometryRemoteCache::instance()->isEnabled()) return;
+  std::vector<const AbstractNode *> stack{&node};
+  std::unordered_set<const AbstractNode *> visited;
+  while (!stack.empty()) {
+    const auto *current = stack.back();
+    stack.pop_back();
+    if (!visited.insert(current).second) continue;
+    const Hash128 key = cacheKey(*current);
+    if (GeometryCache::instance()->contains(key) || CGALCache::instance()->contains(key)) continue;
+    if (diskcache->contains(key)) {
+      diskcache->prefetch(key);
+      continue;
+    }
+    for (const auto& child : current->children) stack.push_back(child.get());
+  }
 }
 
 shared_ptr<const Geometry> GeometryEvaluator::smartCacheGet(const AbstractNode& node, bool preferNef)
 {
-  const std::string& key = this->tree.getIdString(node);
+  const Hash128 key = cacheKey(node);
   shared_ptr<const Geometry> geom;
   bool hasgeom = GeometryCache::instance()->contains(key);
   bool hascgal = CGALCache::instance()->contains(key);
@@ -347,6 +696,36 @@ shared_ptr<const Geometry> GeometryEvaluator::smartCacheGet(const AbstractNode&
   return geom;
 }
 
+/*!
+   The CGAL union and difference convert their operands to Nef polyhedra.
+   Those conversions are kept in the CGALCache by the operands' subtree keys,
+   so later operators on the same subtrees, also in other parts of the tree,
+   take them from there instead of converting again.
+ */
+void GeometryEvaluator::useCachedNefPolyhedra(Geometry::Geometries& operands)
+{
+  if (Feature::ExperimentalFastCsg.is_enabled()) return;
+  for (auto& item : operands) {
+    if (!item.first || CGALCache::acceptsGeometry(item.second)) continue;
+    const Hash128 key = cacheKey(*item.first);
+    if (!CGALCache::instance()->contains(key)) continue;
+    if (auto N = CGALCache::instance()->get(key)) item.second = N;
+  }
+}
+
+void GeometryEvaluator::cacheNefPolyhedra(const Geometry::Geometries& operands)
+{
+  if (Feature::ExperimentalFastCsg.is_enabled()) return;
+  for (const auto& item : operands) {
+    if (!item.first || !item.second || CGALCache::acceptsGeometry(item.second)) continue;
+    const Hash128 key = cacheKey(*item.first);
+    if (CGALCache::instance()->contains(key)) continue;
+    if (auto N = GeometryCache::instance()->getConversion(item.second, GeometryCache::Conversion::Nef)) {
+      CGALCache::instance()->insert(key, N);
+    }
+  }
+}
+
 /*!
    Returns a list of 3D Geometry children of the given node.
    May return empty geometries, but not nullptr objects
@@ -423,6 +802,22 @@ Polygon2d *GeometryEvaluator::applyToChildren2D(const AbstractNode& node, OpenSC
   return ClipperUtils::apply(children, clipType);
 }
 
+/*!
+   Returns the name of the backend which produced the given geometry.
+ */
+static const char *backendName(const shared_ptr<const Geometry>& geom)
+{
+  if (!geom) return "none";
+  if (dynamic_pointer_cast<const Polygon2d>(geom)) return "Clipper";
+  if (dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) return "Nef";
+  if (dynamic_pointer_cast<const CGALHybridPolyhedron>(geom)) return "Hybrid";
+#ifdef ENABLE_MANIFOLD
+  if (dynamic_pointer_cast<const ManifoldGeometry>(geom)) return "Manifold";
+#endif
+  if (dynamic_pointer_cast<const GeometryList>(geom)) return "List";
+  return "PolySet";
+}
+
 /*!
    Adds ourself to our parent's list of traversed children.
    Call this for _every_ node which affects output during traversal.
@@ -436,6 +831,69 @@ void GeometryEvaluator::addToParent(const State& state,
                                     const AbstractNode& node,
                                     const shared_ptr<const Geometry>& geom)
 {
+  auto profiler = NodeProfiler::instance();
+  auto memorylimit = MemoryLimit::instance();
+  // Everything since the previous node completed was spent on this node itself,
+  // which is what it costs to evaluate it again once its children are cached
+  const auto end = profiler->now();
+  if (geom) this->computetimes[node.index()] = (end - this->profile_mark) / 1e6;
+  auto claim = this->claims.find(node.index());
+  // A claimed node was evaluated here, even if its result is cached below
+  bool cached = false;
+  if (profiler->isEnabled() && claim == this->claims.end()) {
+    const Hash128 key = cacheKey(node);
+    cached = GeometryCache::instance()->contains(key) || CGALCache::instance()->contains(key);
+  }
+  if (claim != this->claims.end()) {
+    // Cache the result right away for the threads waiting for it. A transform
+    // or offset passing its child's geometry on to its parent has no result of its own.
+    const bool deferred = state.parent() &&
+                          (this->pendingtransforms.count(state.parent()->index()) || this->pendingoffsets.count(state.parent()->index()));
+    if (geom && !node.modinst->isBackground() && !deferred) smartCacheInsert(node, geom);
+    GeometryCache::instance()->release(claim->second);
+    this->claims.erase(claim);
+  }
+  if (profiler->isEnabled() || memorylimit->isEnabled()) {
+    // The node's inputs and result are all alive now, along with the results
+    // waiting for the other unfinished nodes
+    size_t pending_bytes = geom ? geom->memsize() : 0, pending_geometries = geom ? 1 : 0;
+    for (const auto& visited : this->visitedchildren) {
+      for (const auto& item : visited.second) {
+        if (item.second) {
+          pending_bytes += item.second->memsize();
+          pending_geometries++;
+        }
+      }
+    }
+    if (profiler->isEnabled()) profiler->recordPending(pending_bytes, pending_geometries);
+    if (memorylimit->isEnabled()) memorylimit->update(this->working_set, pending_bytes);
+  }
+  if (profiler->isEnabled()) {
+    size_t facets_in = 0, memory_in = 0;
+    for (const auto& item : this->visitedchildren[node.index()]) {
+      if (item.second) {
+        facets_in += item.second->numFacets();
+        memory_in += item.second->memsize();
+      }
+    }
+    const size_t memory_out = geom ? geom->memsize() : 0;
+    profiler->record({
+      node.index(),
+      state.parent() ? state.parent()->index() : -1,
+      node.verbose_name(),
+      nodeLocation(node),
+      backendName(geom),
+      cached,
+      facets_in,
+      geom ? geom->numFacets() : 0,
+      memory_in,
+      memory_out,
+      this->profile_mark,
+      end
+    });
+  }
+  this->profile_mark = end;
+
   this->visitedchildren.erase(node.index());
   if (state.parent()) {
     this->visitedchildren[state.parent()->index()].push_back(std::make_pair(node.shared_from_this(), geom));
@@ -446,6 +904,184 @@ void GeometryEvaluator::addToParent(const State& state,
   }
 }
 
+#ifdef ENABLE_TBB
+/*!
+   Returns true if the subtree can be evaluated on a worker thread.
+   Exact CGAL numerics are not thread-safe, so subtrees which may need Nef
+   polyhedra must be evaluated on the calling thread.
+ */
+static bool isThreadSafeSubtree(const AbstractNode& node)
+{
+  if (const auto *adv = dynamic_cast<const CgalAdvNode *>(&node)) {
+    if (adv->type == CgalAdvType::MINKOWSKI || adv->type == CgalAdvType::RESIZE) return false;
+  }
+  if (const auto *import = dynamic_cast<const ImportNode *>(&node)) {
+    if (import->type == ImportType::NEF3) return false;
+  }
+  if (dynamic_cast<const ProjectionNode *>(&node) || dynamic_cast<const RoofNode *>(&node)) return false;
+  return std::all_of(node.getChildren().begin(), node.getChildren().end(),
+                     [](const auto& child) { return isThreadSafeSubtree(*child); });
+}
+
+/*!
+   Adds the children of node to list, looking through list nodes since they
+   only pass their children on to their parent.
+ */
+static void collectEffectiveChildren(const AbstractNode& node, std::vector<shared_ptr<const AbstractNode>>& list)
+{
+  for (const auto& child : node.getChildren()) {
+    if (dynamic_cast<const ListNode *>(child.get())) {
+      if (!child->modinst->isBackground()) collectEffectiveChildren(*child, list);
+    } else {
+      list.push_back(child);
+    }
+  }
+}
+#endif
+
+/*!
+   Traverses the subtree so that a thread waiting inside it, e.g. for the
+   subtrees it evaluates in parallel, only picks up tasks of the same subtree.
+   A thread of the pool blocked in GeometryCache::claim() then only holds
+   claims on the subtree it waits in and the ancestors of it, so the owner it
+   waits for can't in turn wait for the blocked thread, and claims may wait
+   on the pool as well.
+ */
+void GeometryEvaluator::traverseIsolated(const AbstractNode& node, const State& state)
+{
+#ifdef ENABLE_TBB
+  tbb::this_task_arena::isolate([&]() { traverse(node, state); });
+#else
+  traverse(node, state);
+#endif
+}
+
+/*!
+   Returns true if node can be evaluated concurrently with other evaluations,
+   i.e. nothing in its subtree needs exact CGAL numerics.
+ */
+bool GeometryEvaluator::isThreadSafe(const AbstractNode& node)
+{
+#ifdef ENABLE_TBB
+  return Feature::ExperimentalManifold.is_enabled() && isThreadSafeSubtree(node);
+#else
+  return false;
+#endif
+}
+
+/*!
+   Returns true if node is a leaf which can be created concurrently with other
+   evaluations. Leaves don't combine geometries, so this doesn't need manifold.
+ */
+bool GeometryEvaluator::isThreadSafeLeaf(const AbstractNode& node)
+{
+#ifdef ENABLE_TBB
+  return dynamic_cast<const LeafNode *>(&node) && isThreadSafeSubtree(node);
+#else
+  return false;
+#endif
+}
+
+/*!
+   Moves the results of the children collected by collectEffectiveChildren()
+   into list, starting at results[next]. Results from list nodes are passed on
+   like visit(ListNode) does, up to the first one mixing dimensions.
+ */
+void GeometryEvaluator::mergeEffectiveChildren(const AbstractNode& node, std::vector<Geometry::Geometries>& results,
+                                               size_t& next, Geometry::Geometries& list) const
+{
+  for (const auto& child : node.getChildren()) {
+    if (dynamic_cast<const ListNode *>(child.get())) {
+      if (child->modinst->isBackground()) continue;
+      Geometry::Geometries items;
+      mergeEffectiveChildren(*child, results, next, items);
+      unsigned int dim = 0;
+      for (auto& item : items) {
+        if (!isValidDim(item, dim)) break;
+        list.push_back(std::move(item));
+      }
+    } else {
+      auto& result = results[next++];
+      list.insert(list.end(), std::make_move_iterator(result.begin()), std::make_move_iterator(result.end()));
+    }
+  }
+}
+
+/*!
+   Called from the prefix stage of nodes operating on all their children.
+   Evaluates the children concurrently, each on its own GeometryEvaluator, and
+   collects the results in child order just like a serial traversal would.
+   Returns false if the children should be traversed as usual.
+ */
+bool GeometryEvaluator::evaluateChildrenInParallel(const State& state, const AbstractNode& node)
+{
+#ifdef ENABLE_TBB
+  if (!Feature::ExperimentalParallelEval.is_enabled() || !useManifold()) return false;
+
+  std::vector<shared_ptr<const AbstractNode>> children;
+  collectEffectiveChildren(node, children);
+  // Not claiming the children, the evaluators below would wait for this thread.
+  // This also dumps the tree before the workers look up their cache keys.
+  const auto uncached = std::count_if(children.begin(), children.end(),
+                                      [this](const auto& child) { return !isCached(cacheKey(*child)); });
+  if (uncached < 2) return false;
+
+  State childstate = state;
+  childstate.setParent(node.shared_from_this());
+  std::vector<Geometry::Geometries> results(children.size());
+  std::vector<std::unordered_map<int, double>> computetimes(children.size());
+  auto evaluate = [&](size_t i) {
+    GeometryEvaluator evaluator(this->tree, this->precision);
+    try {
+      evaluator.traverseIsolated(*children[i], childstate);
+    } catch (const ProgressCancelException&) {
+      evaluator.cacheVisitedChildren();
+      throw;
+    }
+    results[i] = std::move(evaluator.visitedchildren[node.index()]);
+    computetimes[i] = std::move(evaluator.computetimes);
+    // The subtree's temporaries are gone, only its results live on
+    release_thread_memory();
+  };
+
+  // The subtrees expected to take longest are started first, so they don't
+  // hold up the parent after the others are done
+  std::vector<size_t> order(children.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::vector<double> predicted(children.size());
+  for (size_t i = 0; i < children.size(); ++i) predicted[i] = predictedTime(*children[i]);
+  std::stable_sort(order.begin(), order.end(), [&predicted](size_t a, size_t b) { return predicted[a] > predicted[b]; });
+
+  tbb::task_group group;
+  std::vector<size_t> serial;
+  for (const auto i : order) {
+    if (isThreadSafeSubtree(*children[i])) group.run([&evaluate, i]() { evaluate(i); });
+    else serial.push_back(i);
+  }
+  try {
+    try {
+      for (const auto i : serial) evaluate(i);
+    } catch (...) {
+      group.cancel();
+      group.wait();
+      throw;
+    }
+    group.wait(); // Rethrows exceptions from the worker threads
+  } catch (const ProgressCancelException&) {
+    for (const auto& result : results) cacheFinished(result);
+    throw;
+  }
+
+  size_t next = 0;
+  mergeEffectiveChildren(node, results, next, this->visitedchildren[node.index()]);
+  for (const auto& times : computetimes) this->computetimes.insert(times.begin(), times.end());
+  this->profile_mark = NodeProfiler::instance()->now();
+  return true;
+#else
+  return false;
+#endif
+}
+
 /*!
    Custom nodes are handled here => implicit union
  */
@@ -454,6 +1090,7 @@ Response GeometryEvaluator::visit(State& state, const AbstractNode& node)
   if (state.isPrefix()) {
     if (isSmartCached(node)) return Response::PruneTraversal;
     state.setPreferNef(true); // Improve quality of CSG by avoiding conversion loss
+    if (evaluateChildrenInParallel(state, node)) return Response::PruneTraversal;
   }
   if (state.isPostfix()) {
     shared_ptr<const Geometry> geom;
@@ -480,13 +1117,13 @@ Response GeometryEvaluator::visit(State& state, const ListNode& node)
     }
     if (state.isPostfix()) {
       unsigned int dim = 0;
-      for (const auto& item : this->visitedchildren[node.index()]) {
+      Geometry::Geometries children = std::move(this->visitedchildren[node.index()]);
+      this->visitedchildren.erase(node.index());
+      auto& parentchildren = this->visitedchildren[state.parent()->index()];
+      for (auto& item : children) {
         if (!isValidDim(item, dim)) break;
-        auto& chnode = item.first;
-        const shared_ptr<const Geometry>& chgeom = item.second;
-        addToParent(state, *chnode, chgeom);
+        parentchildren.push_back(std::move(item));
       }
-      this->visitedchildren.erase(node.index());
     }
     return Response::ContinueTraversal;
   } else {
@@ -559,18 +1196,34 @@ Response GeometryEvaluator::visit(State& state, const OffsetNode& node)
   if (state.isPrefix() && isSmartCached(node)) return Response::PruneTraversal;
   if (state.isPostfix()) {
     shared_ptr<const Geometry> geom;
+    // Offsets of the chain below this node, which passed on their input
+    std::vector<ClipperUtils::OffsetStep> steps;
+    bool pending = false;
+    auto it = this->pendingoffsets.find(node.index());
+    if (it != this->pendingoffsets.end()) {
+      steps = std::move(it->second);
+      pending = true;
+      this->pendingoffsets.erase(it);
+    }
     if (!isSmartCached(node)) {
-      const Geometry *geometry = applyToChildren2D(node, OpenSCADOperator::UNION);
-      if (geometry) {
-        const auto *polygon = dynamic_cast<const Polygon2d *>(geometry);
+      shared_ptr<const Geometry> input = pending ? this->visitedchildren[node.index()].front().second :
+                                         shared_ptr<const Geometry>(applyToChildren2D(node, OpenSCADOperator::UNION));
+      if (input) {
         // ClipperLib documentation: The formula for the number of steps in a full
         // circular arc is ... Pi / acos(1 - arc_tolerance / abs(delta))
         double n = Calc::get_fragments_from_r(std::abs(node.delta), node.fn, node.fs, node.fa);
         double arc_tolerance = std::abs(node.delta) * (1 - cos_degrees(180 / n));
-        const Polygon2d *result = ClipperUtils::applyOffset(*polygon, node.delta, node.join_type, node.miter_limit, arc_tolerance);
-        assert(result);
-        geom.reset(result);
-        delete geometry;
+        steps.push_back({node.delta, node.join_type, node.miter_limit, arc_tolerance});
+        if (defersOffset(state, node)) {
+          // The parent offsets the input with this chain in one go
+          this->pendingoffsets[state.parent()->index()] = std::move(steps);
+          geom = input;
+        } else {
+          const auto *polygon = dynamic_cast<const Polygon2d *>(input.get());
+          const Polygon2d *result = ClipperUtils::applyOffsets(*polygon, steps);
+          assert(result);
+          geom.reset(result);
+        }
       }
     } else {
       geom = smartCacheGet(node, false);
@@ -594,6 +1247,7 @@ Response GeometryEvaluator::visit(State& state, const RenderNode& node)
     shared_ptr<const Geometry> geom;
     if (!isSmartCached(node)) {
       ResultObject res = applyToChildren(node, OpenSCADOperator::UNION);
+      releaseChildren(node);
       auto mutableGeom = res.asMutableGeometry();
       if (mutableGeom) mutableGeom->setConvexity(node.convexity);
       geom = mutableGeom;
@@ -639,15 +1293,37 @@ Response GeometryEvaluator::visit(State& state, const TextNode& node)
   if (state.isPrefix()) {
     shared_ptr<const Geometry> geom;
     if (!isSmartCached(node)) {
-      std::vector<const Geometry *> geometrylist = node.createGeometryList();
+      std::vector<std::unique_ptr<const Geometry>> geometrylist;
+      for (const auto *geometry : node.createGeometryList()) geometrylist.emplace_back(geometry);
       std::vector<const Polygon2d *> polygonlist;
+      std::vector<BoundingBox> boxes;
       for (const auto& geometry : geometrylist) {
-        const auto *polygon = dynamic_cast<const Polygon2d *>(geometry);
+        const auto *polygon = dynamic_cast<const Polygon2d *>(geometry.get());
         assert(polygon);
         polygonlist.push_back(polygon);
+        boxes.push_back(polygon->getBoundingBox());
       }
-      geom.reset(ClipperUtils::apply(polygonlist, ClipperLib::ctUnion));
-    } else geom = GeometryCache::instance()->get(this->tree.getIdString(node));
+      // Only glyphs whose boxes overlap, e.g. by kerning or in script fonts, need a
+      // union with each other. Each glyph still needs one to normalize its contours.
+      const auto clusters = GeometryUtils::clusterByBoundingBox(boxes);
+      std::vector<std::unique_ptr<Polygon2d>> unions(clusters.size());
+      parallelizable_transform(clusters.begin(), clusters.end(), unions.begin(), [&polygonlist](const std::vector<size_t>& cluster) {
+        std::vector<const Polygon2d *> operands;
+        for (const auto i : cluster) operands.push_back(polygonlist[i]);
+        return std::unique_ptr<Polygon2d>(ClipperUtils::apply(operands, ClipperLib::ctUnion));
+      });
+      if (unions.size() == 1) {
+        geom = std::move(unions.front());
+      } else {
+        auto *text = new Polygon2d();
+        for (auto& polygon : unions) {
+          if (!polygon) continue;
+          for (const auto& outline : polygon->outlines()) text->addOutline(outline);
+        }
+        text->setSanitized(true);
+        geom.reset(text);
+      }
+    } else geom = GeometryCache::instance()->get(cacheKey(node));
     addToParent(state, node, geom);
     node.progress_report();
   }
@@ -666,11 +1342,13 @@ Response GeometryEvaluator::visit(State& state, const CsgOpNode& node)
   if (state.isPrefix()) {
     if (isSmartCached(node)) return Response::PruneTraversal;
     state.setPreferNef(true); // Improve quality of CSG by avoiding conversion loss
+    if (evaluateChildrenInParallel(state, node)) return Response::PruneTraversal;
   }
   if (state.isPostfix()) {
     shared_ptr<const Geometry> geom;
     if (!isSmartCached(node)) {
       geom = applyToChildren(node, node.type).constptr();
+      if (geom && Feature::ExperimentalRoundExact.is_enabled()) geom = CGALUtils::roundExactCoordinates(geom);
     } else {
       geom = smartCacheGet(node, state.preferNef());
     }
@@ -689,31 +1367,43 @@ Response GeometryEvaluator::visit(State& state, const CsgOpNode& node)
  */
 Response GeometryEvaluator::visit(State& state, const TransformNode& node)
 {
-  if (state.isPrefix() && isSmartCached(node)) return Response::PruneTraversal;
+  if (state.isPrefix()) {
+    if (isSmartCached(node)) return Response::PruneTraversal;
+    if (evaluateChildrenInParallel(state, node)) return Response::PruneTraversal;
+  }
   if (state.isPostfix()) {
     shared_ptr<const Geometry> geom;
+    Transform3d matrix = node.matrix;
+    bool pending = false;
+    auto it = this->pendingtransforms.find(node.index());
+    if (it != this->pendingtransforms.end()) {
+      matrix = matrix * it->second;
+      pending = true;
+      this->pendingtransforms.erase(it);
+    }
     if (!isSmartCached(node)) {
-      if (matrix_contains_infinity(node.matrix) || matrix_contains_nan(node.matrix)) {
+      if (matrix_contains_infinity(matrix) || matrix_contains_nan(matrix)) {
         // due to the way parse/eval works we can't currently distinguish between NaN and Inf
         LOG(message_group::Warning, node.modinst->location(), this->tree.getDocumentPath(), "Transformation matrix contains Not-a-Number and/or Infinity - removing object.");
       } else {
-        // First union all children
-        ResultObject res = applyToChildren(node, OpenSCADOperator::UNION);
+        // First union all children. A pending child passed on its own child's
+        // geometry, which must not be cached as the pending child's result.
+        ResultObject res = pending ? ResultObject(this->visitedchildren[node.index()].front().second) :
+                           applyToChildren(node, OpenSCADOperator::UNION);
         if ((geom = res.constptr())) {
           if (geom->getDimension() == 2) {
-            shared_ptr<const Polygon2d> polygons = dynamic_pointer_cast<const Polygon2d>(geom);
-            assert(polygons);
-
-            // If we got a const object, make a copy
-            shared_ptr<Polygon2d> newpoly;
-            if (res.isConst()) newpoly.reset(new Polygon2d(*polygons));
-            else newpoly = dynamic_pointer_cast<Polygon2d>(res.ptr());
+            // A const object is copied, unless res is the only reference left
+            geom.reset();
+            releaseChildren(node);
+            auto newpoly = dynamic_pointer_cast<Polygon2d>(res.asMutableGeometry());
+            assert(newpoly);
+            geom = newpoly;
 
             Transform2d mat2;
             mat2.matrix() <<
-              node.matrix(0, 0), node.matrix(0, 1), node.matrix(0, 3),
-              node.matrix(1, 0), node.matrix(1, 1), node.matrix(1, 3),
-              node.matrix(3, 0), node.matrix(3, 1), node.matrix(3, 3);
+              matrix(0, 0), matrix(0, 1), matrix(0, 3),
+              matrix(1, 0), matrix(1, 1), matrix(1, 3),
+              matrix(3, 0), matrix(3, 1), matrix(3, 3);
             newpoly->transform(mat2);
             // A 2D transformation may flip the winding order of a polygon.
             // If that happens with a sanitized polygon, we need to reverse
@@ -722,9 +1412,16 @@ Response GeometryEvaluator::visit(State& state, const TransformNode& node)
               geom.reset(ClipperUtils::sanitize(*newpoly));
             }
           } else if (geom->getDimension() == 3) {
-            auto mutableGeom = res.asMutableGeometry();
-            if (mutableGeom) mutableGeom->transform(node.matrix);
-            geom = mutableGeom;
+            if (res.isConst() && defersTransform(state, node)) {
+              // Pass the shared geometry on as is, the parent applies both transforms in one copy
+              this->pendingtransforms[state.parent()->index()] = matrix;
+            } else {
+              geom.reset();
+              releaseChildren(node);
+              auto mutableGeom = res.asMutableGeometry();
+              if (mutableGeom) mutableGeom->transform(matrix);
+              geom = mutableGeom;
+            }
           }
         }
       }
@@ -737,9 +1434,30 @@ Response GeometryEvaluator::visit(State& state, const TransformNode& node)
   return Response::ContinueTraversal;
 }
 
+/*!
+   Returns true if the 3D result of a transform node can be left untransformed
+   for its parent, because the parent is a transform of just this node.
+ */
+bool GeometryEvaluator::defersTransform(const State& state, const TransformNode& node)
+{
+  auto parent = dynamic_pointer_cast<const TransformNode>(state.parent());
+  return parent && parent->children.size() == 1 && !node.modinst->isBackground();
+}
+
+/*!
+   Returns true if the offset node can leave its offset to its parent, because
+   the parent is an offset of just this node. Consecutive offsets are then
+   done without converting back to a Polygon2d in between.
+ */
+bool GeometryEvaluator::defersOffset(const State& state, const OffsetNode& node)
+{
+  auto parent = dynamic_pointer_cast<const OffsetNode>(state.parent());
+  return parent && parent->children.size() == 1 && !node.modinst->isBackground();
+}
+
 static void translate_PolySet(PolySet& ps, const Vector3d& translation)
 {
-  for (auto& p : ps.polygons) {
+  for (auto& p : ps.mutablePolygons()) {
     for (auto& v : p) {
       v += translation;
     }
@@ -821,47 +1539,23 @@ static void add_slice(PolySet *ps, const Polygon2d& poly,
         //Vector2d mid_prev = trans3 * (prev1 +curr1+curr2)/4;
         Vector2d mid = trans_mid * (o.vertices[(i - 1) % o.vertices.size()] + o.vertices[i % o.vertices.size()]) / 2;
         double h_mid = (h1 + h2) / 2;
-        ps->append_poly(3);
-        ps->insert_vertex(prev1[0], prev1[1], h1);
-        ps->insert_vertex(mid[0],   mid[1], h_mid);
-        ps->insert_vertex(curr1[0], curr1[1], h1);
-        ps->append_poly(3);
-        ps->insert_vertex(curr1[0], curr1[1], h1);
-        ps->insert_vertex(mid[0],   mid[1], h_mid);
-        ps->insert_vertex(curr2[0], curr2[1], h2);
-        ps->append_poly(3);
-        ps->insert_vertex(curr2[0], curr2[1], h2);
-        ps->insert_vertex(mid[0],   mid[1], h_mid);
-        ps->insert_vertex(prev2[0], prev2[1], h2);
-        ps->append_poly(3);
-        ps->insert_vertex(prev2[0], prev2[1], h2);
-        ps->insert_vertex(mid[0],   mid[1], h_mid);
-        ps->insert_vertex(prev1[0], prev1[1], h1);
+        ps->append_triangle(Vector3d(curr1[0], curr1[1], h1), Vector3d(mid[0], mid[1], h_mid), Vector3d(prev1[0], prev1[1], h1));
+        ps->append_triangle(Vector3d(curr2[0], curr2[1], h2), Vector3d(mid[0], mid[1], h_mid), Vector3d(curr1[0], curr1[1], h1));
+        ps->append_triangle(Vector3d(prev2[0], prev2[1], h2), Vector3d(mid[0], mid[1], h_mid), Vector3d(curr2[0], curr2[1], h2));
+        ps->append_triangle(Vector3d(prev1[0], prev1[1], h1), Vector3d(mid[0], mid[1], h_mid), Vector3d(prev2[0], prev2[1], h2));
       } else
 #endif // ifdef LINEXT_4WAY
       // Split along shortest diagonal,
       // unless at top for a 0-scaled axis (which can create 0 thickness "ears")
       if (splitfirst xor any_zero) {
-        ps->append_poly(3);
-        ps->insert_vertex(prev1[0], prev1[1], h1);
-        ps->insert_vertex(curr2[0], curr2[1], h2);
-        ps->insert_vertex(curr1[0], curr1[1], h1);
+        ps->append_triangle(Vector3d(curr1[0], curr1[1], h1), Vector3d(curr2[0], curr2[1], h2), Vector3d(prev1[0], prev1[1], h1));
         if (!any_zero || (any_non_zero && prev2 != curr2)) {
-          ps->append_poly(3);
-          ps->insert_vertex(curr2[0], curr2[1], h2);
-          ps->insert_vertex(prev1[0], prev1[1], h1);
-          ps->insert_vertex(prev2[0], prev2[1], h2);
+          ps->append_triangle(Vector3d(prev2[0], prev2[1], h2), Vector3d(prev1[0], prev1[1], h1), Vector3d(curr2[0], curr2[1], h2));
         }
       } else {
-        ps->append_poly(3);
-        ps->insert_vertex(prev1[0], prev1[1], h1);
-        ps->insert_vertex(prev2[0], prev2[1], h2);
-        ps->insert_vertex(curr1[0], curr1[1], h1);
+        ps->append_triangle(Vector3d(curr1[0], curr1[1], h1), Vector3d(prev2[0], prev2[1], h2), Vector3d(prev1[0], prev1[1], h1));
         if (!any_zero || (any_non_zero && prev2 != curr2)) {
-          ps->append_poly(3);
-          ps->insert_vertex(prev2[0], prev2[1], h2);
-          ps->insert_vertex(curr2[0], curr2[1], h2);
-          ps->insert_vertex(curr1[0], curr1[1], h1);
+          ps->append_triangle(Vector3d(curr1[0], curr1[1], h1), Vector3d(curr2[0], curr2[1], h2), Vector3d(prev2[0], prev2[1], h2));
         }
       }
       prev1 = curr1;
@@ -1141,7 +1835,7 @@ static Geometry *extrudePolygon(const LinearExtrudeNode& node, const Polygon2d&
   // Create bottom face.
   PolySet *ps_bottom = polyref.tessellate(); // bottom
   // Flip vertex ordering for bottom polygon
-  for (auto& p : ps_bottom->polygons) {
+  for (auto& p : ps_bottom->mutablePolygons()) {
     std::reverse(p.begin(), p.end());
   }
   translate_PolySet(*ps_bottom, Vector3d(0, 0, h1));
@@ -1149,17 +1843,27 @@ static Geometry *extrudePolygon(const LinearExtrudeNode& node, const Polygon2d&
   delete ps_bottom;
 
   // Create slice sides.
-  for (unsigned int j = 0; j < slices; j++) {
-    double rot1 = node.twist * j / slices;
-    double rot2 = node.twist * (j + 1) / slices;
-    double height1 = h1 + (h2 - h1) * j / slices;
-    double height2 = h1 + (h2 - h1) * (j + 1) / slices;
-    Vector2d scale1(1 - (1 - node.scale_x) * j / slices,
-                    1 - (1 - node.scale_y) * j / slices);
-    Vector2d scale2(1 - (1 - node.scale_x) * (j + 1) / slices,
-                    1 - (1 - node.scale_y) * (j + 1) / slices);
-    add_slice(ps, polyref, rot1, rot2, height1, height2, scale1, scale2);
-  }
+  // The slices are independent, so they are built in parallel into their own
+  // PolySets, which are then appended in order.
+  std::vector<unsigned int> slice_indices(slices);
+  std::iota(slice_indices.begin(), slice_indices.end(), 0);
+  std::vector<PolySet> slice_sides(slices, PolySet(3));
+  parallelizable_transform(slice_indices.begin(), slice_indices.end(), slice_sides.begin(), [&](unsigned int j) {
+      double rot1 = node.twist * j / slices;
+      double rot2 = node.twist * (j + 1) / slices;
+      double height1 = h1 + (h2 - h1) * j / slices;
+      double height2 = h1 + (h2 - h1) * (j + 1) / slices;
+      Vector2d scale1(1 - (1 - node.scale_x) * j / slices,
+                      1 - (1 - node.scale_y) * j / slices);
+      Vector2d scale2(1 - (1 - node.scale_x) * (j + 1) / slices,
+                      1 - (1 - node.scale_y) * (j + 1) / slices);
+      PolySet slice(3);
+      slice.reserve(2 * polyref.numFacets());
+      add_slice(&slice, polyref, rot1, rot2, height1, height2, scale1, scale2);
+      return slice;
+    });
+  ps->reserve(ps->getPolygons().size() + slices * 2 * polyref.numFacets());
+  for (auto& slice : slice_sides) ps->append(std::move(slice));
 
   // Create top face.
   // If either scale components are 0, then top will be zero-area, so skip it.
@@ -1191,9 +1895,9 @@ Response GeometryEvaluator::visit(State& state, const LinearExtrudeNode& node)
     if (!isSmartCached(node)) {
       const Geometry *geometry = nullptr;
       if (!node.filename.empty()) {
-        DxfData dxf(node.fn, node.fs, node.fa, node.filename, node.layername, node.origin_x, node.origin_y, node.scale_x);
+        const auto dxf = DxfData::load(node.fn, node.fs, node.fa, node.filename, node.layername, node.origin_x, node.origin_y, node.scale_x);
 
-        Polygon2d *p2d = dxf.toPolygon2d();
+        Polygon2d *p2d = dxf->toPolygon2d();
         if (p2d) geometry = ClipperUtils::sanitize(*p2d);
         delete p2d;
       } else {
@@ -1215,24 +1919,6 @@ Response GeometryEvaluator::visit(State& state, const LinearExtrudeNode& node)
   return Response::ContinueTraversal;
 }
 
-static void fill_ring(std::vector<Vector3d>& ring, const Outline2d& o, double a, bool flip)
-{
-  if (flip) {
-    unsigned int l = o.vertices.size() - 1;
-    for (unsigned int i = 0; i < o.vertices.size(); ++i) {
-      ring[i][0] = o.vertices[l - i][0] * sin_degrees(a);
-      ring[i][1] = o.vertices[l - i][0] * cos_degrees(a);
-      ring[i][2] = o.vertices[l - i][1];
-    }
-  } else {
-    for (unsigned int i = 0; i < o.vertices.size(); ++i) {
-      ring[i][0] = o.vertices[i][0] * sin_degrees(a);
-      ring[i][1] = o.vertices[i][0] * cos_degrees(a);
-      ring[i][2] = o.vertices[i][1];
-    }
-  }
-}
-
 /*!
    Input to extrude should be clean. This means non-intersecting, correct winding order
    etc., the input coming from a library like Clipper.
@@ -1250,8 +1936,11 @@ static void fill_ring(std::vector<Vector3d>& ring, const Outline2d& o, double a,
 
    Currently, we generate a lot of zero-area triangles
 
+   If mesh is given, it receives the same solid with shared vertices: the rings
+   of a full revolution close on the first one, vertices on the axis are shared
+   by all rings and the zero-area triangles are left out.
  */
-static Geometry *rotatePolygon(const RotateExtrudeNode& node, const Polygon2d& poly)
+static Geometry *rotatePolygon(const RotateExtrudeNode& node, const Polygon2d& poly, IndexedTriangleMesh *mesh = nullptr)
 {
   if (node.angle == 0) return nullptr;
 
@@ -1284,7 +1973,7 @@ static Geometry *rotatePolygon(const RotateExtrudeNode& node, const Polygon2d& p
     ps_start->transform(rot);
     // Flip vertex ordering
     if (!flip_faces) {
-      for (auto& p : ps_start->polygons) {
+      for (auto& p : ps_start->mutablePolygons()) {
         std::reverse(p.begin(), p.end());
       }
     }
@@ -1295,7 +1984,7 @@ static Geometry *rotatePolygon(const RotateExtrudeNode& node, const Polygon2d& p
     Transform3d rot2(angle_axis_degrees(node.angle, Vector3d::UnitZ()) * angle_axis_degrees(90, Vector3d::UnitX()));
     ps_end->transform(rot2);
     if (flip_faces) {
-      for (auto& p : ps_end->polygons) {
+      for (auto& p : ps_end->mutablePolygons()) {
         std::reverse(p.begin(), p.end());
       }
     }
@@ -1303,27 +1992,105 @@ static Geometry *rotatePolygon(const RotateExtrudeNode& node, const Polygon2d& p
     delete ps_end;
   }
 
+  // Angle of ring j, the first ring being j = 0
+  const bool full = node.angle == 360;
+  auto ring_angle = [&](unsigned int j) {
+      if (full) return -90 + (j % fragments) * 360.0 / fragments; // start on the -X axis, for legacy support
+      else return 90 - j * node.angle / fragments; // start on the X axis
+    };
+
+  // The profile's vertices, each outline reversed for flipped faces
+  std::vector<Vector2d> profile;
+  std::vector<std::pair<size_t, size_t>> outline_ranges;
   for (const auto& o : poly.outlines()) {
-    std::vector<Vector3d> rings[2];
-    rings[0].resize(o.vertices.size());
-    rings[1].resize(o.vertices.size());
-
-    fill_ring(rings[0], o, (node.angle == 360) ? -90 : 90, flip_faces); // first ring
-    for (unsigned int j = 0; j < fragments; ++j) {
-      double a;
-      if (node.angle == 360) a = -90 + ((j + 1) % fragments) * 360.0 / fragments; // start on the -X axis, for legacy support
-      else a = 90 - (j + 1) * node.angle / fragments; // start on the X axis
-      fill_ring(rings[(j + 1) % 2], o, a, flip_faces);
-
-      for (size_t i = 0; i < o.vertices.size(); ++i) {
-        ps->append_poly(3);
-        ps->insert_vertex(rings[j % 2][i]);
-        ps->insert_vertex(rings[(j + 1) % 2][(i + 1) % o.vertices.size()]);
-        ps->insert_vertex(rings[j % 2][(i + 1) % o.vertices.size()]);
-        ps->append_poly(3);
-        ps->insert_vertex(rings[j % 2][i]);
-        ps->insert_vertex(rings[(j + 1) % 2][i]);
-        ps->insert_vertex(rings[(j + 1) % 2][(i + 1) % o.vertices.size()]);
+    outline_ranges.emplace_back(profile.size(), o.vertices.size());
+    if (flip_faces) profile.insert(profile.end(), o.vertices.rbegin(), o.vertices.rend());
+    else profile.insert(profile.end(), o.vertices.begin(), o.vertices.end());
+  }
+  const size_t n = profile.size();
+
+  // Each ring is computed once, with one sine and cosine, and shared by its two fragments
+  const size_t num_rings = full ? fragments : fragments + 1;
+  std::vector<Vector3d> rings(num_rings * n);
+  for (size_t r = 0; r < num_rings; ++r) {
+    const double s = sin_degrees(ring_angle(r));
+    const double c = cos_degrees(ring_angle(r));
+    for (size_t k = 0; k < n; ++k) rings[r * n + k] = {profile[k][0] * s, profile[k][0] * c, profile[k][1]};
+  }
+  auto ring = [&](size_t j) { return full ? j % fragments : j; };
+
+  std::vector<unsigned int> fragment_indices(fragments);
+  std::iota(fragment_indices.begin(), fragment_indices.end(), 0);
+  std::vector<PolySet> fragment_sides(fragments, PolySet(3));
+  for (const auto& range : outline_ranges) {
+    const size_t first = range.first, size = range.second;
+    parallelizable_transform(fragment_indices.begin(), fragment_indices.end(), fragment_sides.begin(), [&](unsigned int j) {
+        const Vector3d *ring0 = &rings[ring(j) * n + first];
+        const Vector3d *ring1 = &rings[ring(j + 1) * n + first];
+        PolySet fragment(3);
+        fragment.reserve(2 * size);
+        for (size_t i = 0; i < size; ++i) {
+          fragment.append_triangle(ring0[(i + 1) % size], ring1[(i + 1) % size], ring0[i]);
+          fragment.append_triangle(ring1[(i + 1) % size], ring1[i], ring0[i]);
+        }
+        return fragment;
+      });
+    for (auto& fragment : fragment_sides) ps->append(std::move(fragment));
+  }
+
+  if (mesh) {
+    // Vertices are numbered as they are first used, the axis ones on ring 0
+    std::vector<int> remap(rings.size(), -1);
+    auto vertex = [&](size_t r, size_t k) {
+        const size_t slot = profile[k][0] == 0 ? k : r * n + k;
+        if (remap[slot] < 0) {
+          remap[slot] = mesh->vertices.size();
+          mesh->vertices.push_back(rings[slot].cast<float>());
+        }
+        return remap[slot];
+      };
+    auto add_triangle = [&](int a, int b, int c) {
+        if (a != b && a != c && b != c) mesh->triangles.emplace_back(a, b, c);
+      };
+
+    if (!full) {
+      // The caps reuse the profile's triangulation, mapped back to its vertices
+      std::unique_ptr<PolySet> cap(poly.tessellate());
+      std::map<std::pair<double, double>, size_t> profile_index;
+      for (size_t k = 0; k < n; ++k) profile_index.emplace(std::make_pair(profile[k][0], profile[k][1]), k);
+      for (const auto& triangle : cap ? cap->getPolygons() : Polygons()) {
+        size_t k[3];
+        for (int i = 0; i < 3; ++i) {
+          auto it = profile_index.find(std::make_pair(triangle[i][0], triangle[i][1]));
+          if (it == profile_index.end()) {
+            // A vertex added by the triangulation, the caller works from the PolySet alone
+            mesh->triangles.clear();
+            return ps;
+          }
+          k[i] = it->second;
+        }
+        const int start[3] = {vertex(0, k[0]), vertex(0, k[1]), vertex(0, k[2])};
+        const int end[3] = {vertex(fragments, k[0]), vertex(fragments, k[1]), vertex(fragments, k[2])};
+        if (flip_faces) {
+          add_triangle(start[0], start[1], start[2]);
+          add_triangle(end[2], end[1], end[0]);
+        } else {
+          add_triangle(start[2], start[1], start[0]);
+          add_triangle(end[0], end[1], end[2]);
+        }
+      }
+    }
+
+    for (const auto& range : outline_ranges) {
+      const size_t first = range.first, size = range.second;
+      for (unsigned int j = 0; j < fragments; ++j) {
+        for (size_t i = 0; i < size; ++i) {
+          const size_t k0 = first + i, k1 = first + (i + 1) % size;
+          const int a0 = vertex(ring(j), k0), a1 = vertex(ring(j), k1);
+          const int b0 = vertex(ring(j + 1), k0), b1 = vertex(ring(j + 1), k1);
+          add_triangle(a1, b1, a0);
+          add_triangle(b1, b0, a0);
+        }
       }
     }
   }
@@ -1346,8 +2113,8 @@ Response GeometryEvaluator::visit(State& state, const RotateExtrudeNode& node)
     if (!isSmartCached(node)) {
       const Geometry *geometry = nullptr;
       if (!node.filename.empty()) {
-        DxfData dxf(node.fn, node.fs, node.fa, node.filename, node.layername, node.origin_x, node.origin_y, node.scale);
-        Polygon2d *p2d = dxf.toPolygon2d();
+        const auto dxf = DxfData::load(node.fn, node.fs, node.fa, node.filename, node.layername, node.origin_x, node.origin_y, node.scale);
+        Polygon2d *p2d = dxf->toPolygon2d();
         if (p2d) geometry = ClipperUtils::sanitize(*p2d);
         delete p2d;
       } else {
@@ -1355,9 +2122,19 @@ Response GeometryEvaluator::visit(State& state, const RotateExtrudeNode& node)
       }
       if (geometry) {
         const auto *polygons = dynamic_cast<const Polygon2d *>(geometry);
-        Geometry *rotated = rotatePolygon(node, *polygons);
+        IndexedTriangleMesh mesh;
+        Geometry *rotated = rotatePolygon(node, *polygons, useManifold() ? &mesh : nullptr);
         geom.reset(rotated);
         delete geometry;
+#ifdef ENABLE_MANIFOLD
+        // Saves the CSG from welding and tessellating the PolySet again
+        if (rotated && !mesh.triangles.empty()) {
+          if (auto mani = ManifoldUtils::createManifoldFromTriangleMesh(mesh)) {
+            const auto conversion = isApproximate() ? GeometryCache::Conversion::ApproximateManifold : GeometryCache::Conversion::Manifold;
+            GeometryCache::instance()->insertConversion(geom, conversion, mani);
+          }
+        }
+#endif
       }
     } else {
       geom = smartCacheGet(node, false);
@@ -1381,7 +2158,32 @@ shared_ptr<const Geometry> GeometryEvaluator::projectionCut(const ProjectionNode
 {
   shared_ptr<const Geometry> geom;
   shared_ptr<const Geometry> newgeom = applyToChildren3D(node, OpenSCADOperator::UNION).constptr();
-  if (newgeom) {
+#ifdef ENABLE_MANIFOLD
+  if (newgeom && useManifold()) {
+    // Meshes Manifold can't represent fall back to Nef polyhedra below
+    auto manifold = ManifoldUtils::createMutableManifoldFromGeometry(newgeom, isApproximate());
+    if (manifold && manifold->isValid()) {
+      Polygon2d *poly = manifold->isEmpty() ? nullptr : ManifoldUtils::projectCut(*manifold);
+      if (poly) {
+        poly->setConvexity(node.convexity);
+        geom.reset(poly);
+      }
+      return geom;
+    }
+  }
+#endif
+  if (newgeom && !dynamic_pointer_cast<const CGAL_Nef_polyhedron>(newgeom)) {
+    // Slicing the faces avoids converting meshes to Nef polyhedra, which
+    // are only needed below for meshes without closed cross sections
+    if (auto ps = CGALUtils::getGeometryAsPolySet(newgeom)) {
+      if (Polygon2d *poly = PolySetUtils::slice(*ps)) {
+        poly->setConvexity(node.convexity);
+        geom.reset(poly);
+        return geom;
+      }
+    }
+  }
+  if (newgeom && !isApproximate()) {
     auto Nptr = CGALUtils::getNefPolyhedronFromGeometry(newgeom);
     if (Nptr && !Nptr->isEmpty()) {
       Polygon2d *poly = CGALUtils::project(*Nptr, node.cut_mode);
@@ -1394,42 +2196,56 @@ shared_ptr<const Geometry> GeometryEvaluator::projectionCut(const ProjectionNode
   return geom;
 }
 
+// Whether geom is a closed mesh, whose faces facing down needn't be projected
+static bool isClosedMesh(const shared_ptr<const Geometry>& geom)
+{
+  if (dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) return true;
+  if (const auto ps = dynamic_pointer_cast<const PolySet>(geom)) return ps->isManifold();
+  if (const auto hybrid = dynamic_pointer_cast<const CGALHybridPolyhedron>(geom)) return hybrid->isManifold();
+#ifdef ENABLE_MANIFOLD
+  if (const auto mani = dynamic_pointer_cast<const ManifoldGeometry>(geom)) return mani->isValid();
+#endif
+  return false;
+}
+
 shared_ptr<const Geometry> GeometryEvaluator::projectionNoCut(const ProjectionNode& node)
 {
   shared_ptr<const Geometry> geom;
-  std::vector<const Polygon2d *> tmp_geom;
+  std::vector<shared_ptr<const Polygon2d>> footprints;
   BoundingBox bounds;
   for (const auto& item : this->visitedchildren[node.index()]) {
     auto& chnode = item.first;
     const shared_ptr<const Geometry>& chgeom = item.second;
-    if (chnode->modinst->isBackground()) continue;
-
-    const Polygon2d *poly = nullptr;
-
-    // Clipper version of Geometry projection
-    // Clipper doesn't handle meshes very well.
-    // It's better in V6 but not quite there. FIXME: stand-alone example.
-    // project chgeom -> polygon2d
-    auto chPS = CGALUtils::getGeometryAsPolySet(chgeom);
-    if (chPS) poly = PolySetUtils::project(*chPS);
-
-    if (poly) {
-      bounds.extend(poly->getBoundingBox());
-      tmp_geom.push_back(poly);
+    if (chnode->modinst->isBackground() || !chgeom) continue;
+
+    // The footprint of a cached child is reused while the child stays in memory
+    auto cache = GeometryCache::instance();
+    auto footprint = dynamic_pointer_cast<const Polygon2d>(cache->getConversion(chgeom, GeometryCache::Conversion::Footprint));
+    if (!footprint) {
+      // Clipper version of Geometry projection
+      // Clipper doesn't handle meshes very well.
+      // It's better in V6 but not quite there. FIXME: stand-alone example.
+      // project chgeom -> polygon2d
+      auto chPS = CGALUtils::getGeometryAsPolySet(chgeom);
+      if (!chPS) continue;
+      footprint.reset(PolySetUtils::footprint(*chPS, isClosedMesh(chgeom)));
+      cache->insertConversion(chgeom, GeometryCache::Conversion::Footprint, footprint);
+    }
+    if (!footprint->isEmpty()) {
+      bounds.extend(footprint->getBoundingBox());
+      footprints.push_back(footprint);
     }
-
+  }
+  if (footprints.size() == 1) {
+    geom = footprints.front();
+    return geom;
   }
   int pow2 = ClipperUtils::getScalePow2(bounds);
 
   ClipperLib::Clipper sumclipper;
-  for (auto poly : tmp_geom) {
-    ClipperLib::Paths result = ClipperUtils::fromPolygon2d(*poly, pow2);
-    // Using NonZero ensures that we don't create holes from polygons sharing
-    // edges since we're unioning a mesh
-    result = ClipperUtils::process(result, ClipperLib::ctUnion, ClipperLib::pftNonZero);
-    // Add correctly winded polygons to the main clipper
-    sumclipper.AddPaths(result, ClipperLib::ptSubject, true);
-    delete poly;
+  for (const auto& footprint : footprints) {
+    // The footprints are sanitized, with holes oriented as such
+    sumclipper.AddPaths(ClipperUtils::scaledPaths(*footprint, pow2)->paths, ClipperLib::ptSubject, true);
   }
 
   ClipperLib::PolyTree sumresult;
@@ -1443,7 +2259,6 @@ shared_ptr<const Geometry> GeometryEvaluator::projectionNoCut(const ProjectionNo
   return geom;
 }
 
-
 /*!
    input: List of 3D objects
    output: Polygon2d
@@ -1508,6 +2323,7 @@ Response GeometryEvaluator::visit(State& state, const CgalAdvNode& node)
       }
       case CgalAdvType::RESIZE: {
         ResultObject res = applyToChildren(node, OpenSCADOperator::UNION);
+        releaseChildren(node);
         auto editablegeom = res.asMutableGeometry();
         geom = editablegeom;
         if (editablegeom) {
@@ -1533,6 +2349,7 @@ Response GeometryEvaluator::visit(State& state, const AbstractIntersectionNode&
   if (state.isPrefix()) {
     if (isSmartCached(node)) return Response::PruneTraversal;
     state.setPreferNef(true); // Improve quality of CSG by avoiding conversion loss
+    if (evaluateChildrenInParallel(state, node)) return Response::PruneTraversal;
   }
   if (state.isPostfix()) {
     shared_ptr<const Geometry> geom;
@@ -1547,19 +2364,102 @@ Response GeometryEvaluator::visit(State& state, const AbstractIntersectionNode&
   return Response::ContinueTraversal;
 }
 
-static Geometry *roofOverPolygon(const RoofNode& node, const Polygon2d& poly)
+// Roofs of single outlines with their holes, by roofKey()
+static Cache<Hash128, PolySet> roof_cache(32ul * 1024ul * 1024ul);
+static std::mutex roof_cache_mutex;
+
+void GeometryEvaluator::clearRoofCache()
 {
-  PolySet *roof = nullptr;
-  if (node.method == "voronoi") {
-    roof = roof_vd::voronoi_diagram_roof(poly, node.fa, node.fs);
-    roof->setConvexity(node.convexity);
-  } else if (node.method == "straight") {
-    roof = roof_ss::straight_skeleton_roof(poly);
-    roof->setConvexity(node.convexity);
-  } else {
-    assert(false && "Invalid roof method");
+  std::lock_guard<std::mutex> lock(roof_cache_mutex);
+  roof_cache.clear();
+}
+
+static Hash128 roofKey(const RoofNode& node, const Polygon2d& component)
+{
+  std::vector<double> data{node.method == "voronoi" ? 1.0 : 0.0, node.fa, node.fs};
+  for (const auto& outline : component.outlines()) {
+    data.push_back(static_cast<double>(outline.vertices.size()));
+    for (const auto& v : outline.vertices) data.insert(data.end(), {v[0], v[1]});
   }
+  return hash128(data.data(), data.size() * sizeof(double));
+}
 
+/*!
+   Splits poly into its outer outlines, each with the holes directly inside
+   it. The roof of each is independent of the others. The vertices are on
+   the grid both roof methods round to, so the roofs come out the same as
+   for the whole polygon.
+ */
+static std::vector<Polygon2d> roofComponents(const Polygon2d& poly)
+{
+  const int pow2 = ClipperUtils::getScalePow2(poly.getBoundingBox(), 32);
+  const ClipperLib::PolyTree polytree = ClipperUtils::sanitize(ClipperUtils::fromPolygon2d(poly, pow2));
+  std::vector<Polygon2d> components;
+  auto toOutline = [pow2](const ClipperLib::Path& path) {
+    Outline2d outline;
+    outline.vertices = ClipperUtils::fromPath(path, pow2);
+    outline.positive = ClipperLib::Orientation(path);
+    return outline;
+  };
+  std::function<void (const ClipperLib::PolyNode&)> walk = [&](const ClipperLib::PolyNode& outer) {
+    Polygon2d component;
+    component.addOutline(toOutline(outer.Contour));
+    for (const auto *hole : outer.Childs) {
+      component.addOutline(toOutline(hole->Contour));
+      for (const auto *island : hole->Childs) walk(*island);
+    }
+    component.setSanitized(true);
+    components.push_back(std::move(component));
+  };
+  for (const auto *outer : polytree.Childs) walk(*outer);
+  return components;
+}
+
+static PolySet *roofOverComponent(const RoofNode& node, const Polygon2d& component)
+{
+  if (node.method == "voronoi") return roof_vd::voronoi_diagram_roof(component, node.fa, node.fs);
+  assert(node.method == "straight" && "Invalid roof method");
+  return roof_ss::straight_skeleton_roof(component);
+}
+
+/*!
+   The roofs of the components of poly are computed in parallel, and kept
+   in a cache so editing one outline doesn't recompute the others.
+ */
+static Geometry *roofOverPolygon(const RoofNode& node, const Polygon2d& poly)
+{
+  struct ComponentRoof {
+    shared_ptr<const PolySet> roof;
+    std::string error;
+  };
+  const auto components = roofComponents(poly);
+  std::vector<ComponentRoof> roofs(components.size());
+  parallelizable_transform(components.begin(), components.end(), roofs.begin(), [&node](const Polygon2d& component) {
+    const Hash128 key = roofKey(node, component);
+    {
+      std::lock_guard<std::mutex> lock(roof_cache_mutex);
+      if (const PolySet *cached = roof_cache[key]) return ComponentRoof{make_shared<const PolySet>(*cached), {}};
+    }
+    try {
+      auto roof = roofOverComponent(node, component);
+      std::lock_guard<std::mutex> lock(roof_cache_mutex);
+      roof_cache.insert(key, new PolySet(*roof), roof->memsize());
+      return ComponentRoof{shared_ptr<const PolySet>(roof), {}};
+    } catch (RoofNode::roof_exception& e) {
+      // Rethrown on the calling thread below
+      return ComponentRoof{nullptr, e.message()};
+    }
+  });
+
+  auto *roof = new PolySet(3);
+  for (const auto& component : roofs) {
+    if (!component.roof) {
+      delete roof;
+      throw RoofNode::roof_exception(component.error);
+    }
+    roof->append(*component.roof);
+  }
+  roof->setConvexity(node.convexity);
   return roof;
 }
 
@@ -4,22 +4,38 @@
 #include "enums.h"
 #include "memory.h"
 #include "Geometry.h"
+#include "hash.h"
+#include "ClipperUtils.h"
 
+#include <iterator>
 #include <utility>
 #include <list>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 class CGAL_Nef_polyhedron;
 class Polygon2d;
 class Tree;
+class TransformNode;
+class OffsetNode;
 
 class GeometryEvaluator : public NodeVisitor
 {
 public:
-  GeometryEvaluator(const Tree& tree);
+  // Approximate evaluations use Manifold's float precision throughout, for
+  // quick renders. Their results are cached apart from the exact ones.
+  enum class Precision { Exact, Approximate };
+
+  GeometryEvaluator(const Tree& tree, Precision precision = Precision::Exact);
+  ~GeometryEvaluator() override;
 
   shared_ptr<const Geometry> evaluateGeometry(const AbstractNode& node, bool allownef);
+  static bool isThreadSafe(const AbstractNode& node);
+  static bool isThreadSafeLeaf(const AbstractNode& node);
+  [[nodiscard]] Precision getPrecision() const { return precision; }
+  // Drops the roofs of outlines kept for roof()
+  static void clearRoofCache();
 
   Response visit(State& state, const AbstractNode& node) override;
   Response visit(State& state, const AbstractIntersectionNode& node) override;
@@ -40,6 +56,14 @@ public:
   Response visit(State& state, const OffsetNode& node) override;
 
   [[nodiscard]] const Tree& getTree() const { return this->tree; }
+  // The key of the node's geometry in the caches, depending on the precision
+  [[nodiscard]] Hash128 cacheKey(const AbstractNode& node) const;
+  bool isCached(const Hash128& key);
+  // True if the in-memory caches hold the node's result, the disk cache is not consulted
+  [[nodiscard]] bool hasCachedResult(const AbstractNode& node) const;
+  // Expected evaluation times in seconds, from earlier evaluations of the same subtrees
+  [[nodiscard]] double predictedSelfTime(const AbstractNode& node) const;
+  [[nodiscard]] double predictedTime(const AbstractNode& node) const;
 
 private:
   class ResultObject
@@ -57,10 +81,7 @@ public:
     [[nodiscard]] shared_ptr<const Geometry> constptr() const {
       return is_const ? const_pointer : static_pointer_cast<const Geometry>(pointer);
     }
-    shared_ptr<Geometry> asMutableGeometry() {
-      if (isConst()) return shared_ptr<Geometry>(constptr() ? constptr()->copy() : nullptr);
-      else return ptr();
-    }
+    shared_ptr<Geometry> asMutableGeometry();
 private:
     bool is_const;
     shared_ptr<Geometry> pointer;
@@ -69,7 +90,14 @@ private:
 
   void smartCacheInsert(const AbstractNode& node, const shared_ptr<const Geometry>& geom);
   shared_ptr<const Geometry> smartCacheGet(const AbstractNode& node, bool preferNef);
+  void useCachedNefPolyhedra(Geometry::Geometries& operands);
+  void cacheNefPolyhedra(const Geometry::Geometries& operands);
   bool isSmartCached(const AbstractNode& node);
+  [[nodiscard]] bool isApproximate() const { return this->precision == Precision::Approximate; }
+  [[nodiscard]] bool useManifold() const;
+  bool restoreFromDiskCache(const Hash128& key);
+  std::string nodeLocation(const AbstractNode& node) const;
+  void prefetchFromRemoteCache(const AbstractNode& node);
   bool isValidDim(const Geometry::GeometryItem& item, unsigned int& dim) const;
   std::vector<const Polygon2d *> collectChildren2D(const AbstractNode& node);
   Geometry::Geometries collectChildren3D(const AbstractNode& node);
@@ -85,11 +113,64 @@ private:
   shared_ptr<const Geometry> projectionNoCut(const ProjectionNode& node);
 
   void addToParent(const State& state, const AbstractNode& node, const shared_ptr<const Geometry>& geom);
+  void cacheFinished(const Geometry::Geometries& children);
+  void releaseChildren(const AbstractNode& node);
+  void cacheVisitedChildren();
+  bool evaluateChildrenInParallel(const State& state, const AbstractNode& node);
+  void traverseIsolated(const AbstractNode& node, const State& state = NodeVisitor::nullstate);
+  void mergeEffectiveChildren(const AbstractNode& node, std::vector<Geometry::Geometries>& results,
+                              size_t& next, Geometry::Geometries& list) const;
+  static bool defersTransform(const State& state, const TransformNode& node);
+  static bool defersOffset(const State& state, const OffsetNode& node);
   Response lazyEvaluateRootNode(State& state, const AbstractNode& node);
 
-  std::map<int, Geometry::Geometries> visitedchildren;
+  /*!
+     Results of the children of the nodes being evaluated, by node index. The
+     tree is traversed depth first, so these belong to the ancestors of the
+     current node, and a stack searched from the top finds them right away.
+   */
+  class VisitedChildren
+  {
+public:
+    using Entries = std::vector<std::pair<int, Geometry::Geometries>>;
+    Geometry::Geometries& operator[](int index) {
+      auto it = find(index);
+      if (it != entries.end()) return it->second;
+      entries.emplace_back(index, Geometry::Geometries());
+      return entries.back().second;
+    }
+    void erase(int index) {
+      auto it = find(index);
+      if (it != entries.end()) entries.erase(it);
+    }
+    [[nodiscard]] bool empty() const { return entries.empty(); }
+    [[nodiscard]] Entries::const_iterator begin() const { return entries.begin(); }
+    [[nodiscard]] Entries::const_iterator end() const { return entries.end(); }
+private:
+    Entries::iterator find(int index) {
+      for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        if (it->first == index) return std::prev(it.base());
+      }
+      return entries.end();
+    }
+    Entries entries;
+  };
+  VisitedChildren visitedchildren;
+  // Transform still to be applied to the only child of a transform node, by node index
+  std::map<int, Transform3d> pendingtransforms;
+  // Offsets still to be applied, in order, by the parent offset node of a chain, by its index
+  std::map<int, std::vector<ClipperUtils::OffsetStep>> pendingoffsets;
   const Tree& tree;
+  Precision precision;
   shared_ptr<const Geometry> root;
+  // Time of the last completed node, used by the NodeProfiler and for cache priorities
+  int64_t profile_mark;
+  // Time in seconds spent evaluating each node, until it is inserted into a cache
+  std::unordered_map<int, double> computetimes;
+  // Geometry held in visitedchildren at the last completed node, as reported to the MemoryLimit
+  size_t working_set{0};
+  // Cache keys claimed from the GeometryCache by node index, until the nodes are cached
+  std::unordered_map<int, Hash128> claims;
 
 public:
 };
@@ -0,0 +1,217 @@
+#include "GeometryRemoteCache.h"
+#include "printutils.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <boost/filesystem.hpp>
+#include <zlib.h>
+
+namespace fs = boost::filesystem;
+
+GeometryRemoteCache *GeometryRemoteCache::inst = nullptr;
+
+namespace {
+
+const char *remote_extension = ".geomz";
+// Bound of the compression ratio of zlib, see the zlib technical details
+const uint64_t max_compression_ratio = 1032;
+
+// The uncompressed size, then the zlib stream
+std::string compress(const std::string& data)
+{
+  uLongf size = compressBound(data.size());
+  std::string result(sizeof(uint64_t) + size, '\0');
+  const uint64_t length = data.size();
+  std::memcpy(&result[0], &length, sizeof(length));
+  if (compress2(reinterpret_cast<Bytef *>(&result[sizeof(length)]), &size,
+                reinterpret_cast<const Bytef *>(data.data()), data.size(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+    return "";
+  }
+  result.resize(sizeof(length) + size);
+  return result;
+}
+
+bool uncompress(const std::string& data, std::string& result)
+{
+  uint64_t length;
+  if (data.size() < sizeof(length)) return false;
+  std::memcpy(&length, data.data(), sizeof(length));
+  // Corrupt or foreign entries mustn't make us allocate whatever they claim
+  if (length > (data.size() - sizeof(length)) * max_compression_ratio + 64) return false;
+  result.assign(length, '\0');
+  uLongf size = length;
+  return ::uncompress(reinterpret_cast<Bytef *>(&result[0]), &size,
+                      reinterpret_cast<const Bytef *>(data.data() + sizeof(length)), data.size() - sizeof(length)) == Z_OK &&
+         size == length;
+}
+
+} // namespace
+
+bool DirectoryStore::list(std::vector<std::string>& names)
+{
+  boost::system::error_code ec;
+  // A new store starts out empty
+  if (!fs::exists(this->dir, ec) && !fs::create_directories(this->dir, ec)) return false;
+  for (fs::directory_iterator it(this->dir, ec), end; !ec && it != end; it.increment(ec)) {
+    if (it->path().extension() == remote_extension) names.push_back(it->path().stem().string());
+  }
+  return !ec;
+}
+
+bool DirectoryStore::read(const std::string& name, std::string& data)
+{
+  std::ifstream in((fs::path(this->dir) / (name + remote_extension)).string(), std::ios::in | std::ios::binary);
+  if (!in.good()) return false;
+  data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return !in.bad();
+}
+
+bool DirectoryStore::write(const std::string& name, const std::string& data)
+{
+  const auto path = fs::path(this->dir) / (name + remote_extension);
+  const auto tmppath = fs::path(this->dir) / fs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+  bool ok;
+  {
+    std::ofstream out(tmppath.string(), std::ios::out | std::ios::binary);
+    out.write(data.data(), data.size());
+    ok = out.good();
+  }
+  boost::system::error_code ec;
+  if (ok) fs::rename(tmppath, path, ec);
+  if (!ok || ec) fs::remove(tmppath, ec);
+  return ok && !ec;
+}
+
+GeometryRemoteCache::~GeometryRemoteCache()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->changed.notify_all();
+  if (this->worker.joinable()) this->worker.join();
+}
+
+void GeometryRemoteCache::setStore(std::unique_ptr<RemoteStore> store)
+{
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->store = std::move(store);
+    this->names.clear();
+    if (!this->store) return;
+  }
+  // Lookups before the listing is done miss, which only costs an evaluation
+  enqueue([this]() {
+    std::vector<std::string> listed;
+    if (!this->store->list(listed)) {
+      LOG(message_group::Warning, "Can't list the remote geometry cache '%1$s'", this->store->description());
+    }
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->names.insert(listed.begin(), listed.end());
+  });
+}
+
+bool GeometryRemoteCache::contains(const std::string& name) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  return this->store && this->names.count(name);
+}
+
+bool GeometryRemoteCache::fetch(const std::string& name, std::string& data)
+{
+  if (!contains(name)) return false;
+  std::string compressed;
+  if (!this->store->read(name, compressed) || !uncompress(compressed, data)) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->names.erase(name); // Removed, or not usable
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->numfetched++;
+  return true;
+}
+
+void GeometryRemoteCache::prefetch(const std::string& name, std::function<void(const std::string& data)> done)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->store || !this->names.count(name) || !this->pending.insert(name).second) return;
+  }
+  enqueue([this, name, done = std::move(done)]() {
+    std::string data;
+    if (fetch(name, data)) done(data);
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->pending.erase(name);
+  });
+}
+
+bool GeometryRemoteCache::waitForPending(const std::string& name)
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  if (!this->pending.count(name)) return false;
+  this->changed.wait(lock, [this, &name]() { return !this->pending.count(name); });
+  return true;
+}
+
+void GeometryRemoteCache::publish(const std::string& name, const std::string& data)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->store || this->names.count(name) || !this->pending.insert(name).second) return;
+  }
+  enqueue([this, name, data]() {
+    const auto compressed = compress(data);
+    const bool ok = !compressed.empty() && this->store->write(name, compressed);
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->pending.erase(name);
+    if (ok) {
+      this->names.insert(name);
+      this->numpublished++;
+    }
+  });
+}
+
+void GeometryRemoteCache::enqueue(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->tasks.push_back(std::move(task));
+    if (!this->worker.joinable()) this->worker = std::thread([this]() { run(); });
+  }
+  this->changed.notify_all();
+}
+
+void GeometryRemoteCache::run()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (true) {
+    this->changed.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+    if (this->tasks.empty()) return;
+    auto task = std::move(this->tasks.front());
+    this->tasks.pop_front();
+    this->running++;
+    lock.unlock();
+    task();
+    lock.lock();
+    this->running--;
+    this->changed.notify_all();
+  }
+}
+
+void GeometryRemoteCache::flush()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->changed.wait(lock, [this]() { return this->tasks.empty() && this->running == 0; });
+}
+
+void GeometryRemoteCache::print()
+{
+  if (!isEnabled()) return;
+  std::lock_guard<std::mutex> lock(this->mutex);
+  LOG("Geometries in remote cache: %1$d", this->names.size());
+  LOG("Remote cache entries fetched: %1$d", this->numfetched);
+  LOG("Remote cache entries published: %1$d", this->numpublished);
+}
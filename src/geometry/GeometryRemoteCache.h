@@ -0,0 +1,102 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+/*!
+   Storage of the remote cache tier. Entries are opaque blobs, named like the
+   entries of the disk cache. Other backends, e.g. for HTTP or object stores,
+   implement this interface.
+ */
+class RemoteStore
+{
+public:
+  virtual ~RemoteStore() = default;
+  virtual bool list(std::vector<std::string>& names) = 0;
+  virtual bool read(const std::string& name, std::string& data) = 0;
+  virtual bool write(const std::string& name, const std::string& data) = 0;
+  [[nodiscard]] virtual std::string description() const = 0;
+};
+
+/*!
+   Stores entries as files in a directory, e.g. on a network share or a
+   mounted bucket. Entries are written to temporary files first, so readers
+   never see partial entries.
+ */
+class DirectoryStore : public RemoteStore
+{
+public:
+  DirectoryStore(std::string dir) : dir(std::move(dir)) {}
+  bool list(std::vector<std::string>& names) override;
+  bool read(const std::string& name, std::string& data) override;
+  bool write(const std::string& name, const std::string& data) override;
+  [[nodiscard]] std::string description() const override { return this->dir; }
+
+private:
+  std::string dir;
+};
+
+/*!
+   Remote tier behind the disk cache, shared by several machines: lookups go
+   to memory, then the local disk cache, then the remote store.
+
+   The names of the remote entries are listed in the background once the
+   store is set. Entries found there are fetched into the disk cache, either
+   in the background ahead of evaluation, or when they are looked up.
+   Results are published in the background, zlib compressed, and only if
+   they took at least minComputeTime() seconds, since cheaper ones are
+   faster to evaluate again than to fetch. Entries are never removed from
+   the store, which is pruned by whoever manages it.
+ */
+class GeometryRemoteCache
+{
+public:
+  GeometryRemoteCache() = default;
+  ~GeometryRemoteCache();
+
+  static GeometryRemoteCache *instance() { if (!inst) inst = new GeometryRemoteCache; return inst; }
+
+  void setStore(std::unique_ptr<RemoteStore> store);
+  bool isEnabled() const { std::lock_guard<std::mutex> lock(this->mutex); return bool(this->store); }
+  void setMinComputeTime(double seconds) { this->mincomputetime = seconds; }
+  double minComputeTime() const { return this->mincomputetime; }
+
+  bool contains(const std::string& name) const;
+  // Reads and uncompresses the entry, blocking
+  bool fetch(const std::string& name, std::string& data);
+  // Fetches the entry in the background and passes it to done
+  void prefetch(const std::string& name, std::function<void(const std::string& data)> done);
+  void publish(const std::string& name, const std::string& data);
+  // Waits for a prefetch or publish of the entry, returns false if there was none
+  bool waitForPending(const std::string& name);
+  // Waits for the background work, e.g. before exiting
+  void flush();
+  void print();
+
+private:
+  static GeometryRemoteCache *inst;
+
+  void enqueue(std::function<void()> task);
+  void run();
+
+  std::unique_ptr<RemoteStore> store;
+  std::unordered_set<std::string> names; // Known to be in the store
+  std::unordered_set<std::string> pending; // Being fetched or published
+  double mincomputetime{1.0};
+  size_t numfetched{0};
+  size_t numpublished{0};
+
+  std::deque<std::function<void()>> tasks;
+  size_t running{0};
+  std::thread worker;
+  std::condition_variable changed;
+  bool stopping{false};
+  mutable std::mutex mutex;
+};
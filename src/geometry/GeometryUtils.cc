@@ -1,10 +1,14 @@
 #include "GeometryUtils.h"
 #include "ext/libtess2/Include/tesselator.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 #include "Reindexer.h"
 #include <unordered_map>
 #include <string>
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <numeric>
 
 #include <boost/functional/hash.hpp>
 
@@ -194,6 +198,7 @@ bool GeometryUtils::tessellatePolygonWithHoles(const std::vector<Vector3f>& vert
                                                std::vector<IndexedTriangle>& triangles,
                                                const Vector3f *normal)
 {
+  TimingCounters::Scope timer(TimingCounters::TESSELLATION);
   // Algorithm outline:
   // o Remove consecutive equal vertices and null ears (i.e. 23,24,23)
   // o Ignore polygons with < 3 vertices
@@ -417,6 +422,7 @@ bool GeometryUtils::tessellatePolygonWithHoles(const std::vector<Vector3f>& vert
 bool GeometryUtils::tessellatePolygon(const Polygon& polygon, Polygons& triangles,
                                       const Vector3f *normal)
 {
+  TimingCounters::Scope timer(TimingCounters::TESSELLATION);
   auto err = false;
   Reindexer<Vector3f> uniqueVertices;
   std::vector<IndexedFace> indexedfaces{{}};
@@ -498,3 +504,59 @@ Transform3d GeometryUtils::getResizeTransform(const BoundingBox &bbox, const Vec
 
   return t;
 }
+
+VectorOfVector2d GeometryUtils::convexHull2D(VectorOfVector2d points)
+{
+  std::sort(points.begin(), points.end(), [](const Vector2d& a, const Vector2d& b) {
+    return a[0] < b[0] || (a[0] == b[0] && a[1] < b[1]);
+  });
+  points.erase(std::unique(points.begin(), points.end()), points.end());
+  if (points.size() < 3) return points;
+
+  const auto cross = [](const Vector2d& o, const Vector2d& a, const Vector2d& b) {
+    return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+  };
+  // The lower chain left to right, then the upper one back
+  VectorOfVector2d hull(2 * points.size());
+  size_t k = 0;
+  for (const auto& p : points) {
+    while (k >= 2 && cross(hull[k - 2], hull[k - 1], p) <= 0) k--;
+    hull[k++] = p;
+  }
+  for (size_t i = points.size() - 1, lower = k + 1; i-- > 0;) {
+    while (k >= lower && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) k--;
+    hull[k++] = points[i];
+  }
+  hull.resize(k - 1); // The last point is the first one again
+  return hull;
+}
+
+std::vector<std::vector<size_t>> GeometryUtils::clusterByBoundingBox(const std::vector<BoundingBox>& boxes)
+{
+  std::vector<size_t> cluster(boxes.size());
+  std::iota(cluster.begin(), cluster.end(), 0);
+  std::function<size_t(size_t)> find = [&](size_t i) {
+    return cluster[i] == i ? i : (cluster[i] = find(cluster[i]));
+  };
+
+  // Sweep along x, so only boxes overlapping in x are compared
+  std::vector<size_t> order(boxes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return boxes[a].min().x() < boxes[b].min().x(); });
+  for (size_t i = 0; i < order.size(); ++i) {
+    const auto& box = boxes[order[i]];
+    for (size_t j = i + 1; j < order.size() && boxes[order[j]].min().x() <= box.max().x(); ++j) {
+      if (box.intersects(boxes[order[j]])) cluster[find(order[j])] = find(order[i]);
+    }
+  }
+
+  // Keep the boxes' order, both among and within clusters
+  std::vector<std::vector<size_t>> clusters;
+  std::unordered_map<size_t, size_t> index;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    auto it = index.emplace(find(i), clusters.size()).first;
+    if (it->second == clusters.size()) clusters.emplace_back();
+    clusters[it->second].push_back(i);
+  }
+  return clusters;
+}
@@ -37,5 +37,13 @@ bool tessellatePolygonWithHoles(const std::vector<Vector3f>& vertices,
 int findUnconnectedEdges(const std::vector<std::vector<IndexedFace>>& polygons);
 int findUnconnectedEdges(const std::vector<IndexedTriangle>& triangles);
 
+// Andrew's monotone chain: the hull's corners counter-clockwise, from the
+// lowest of the leftmost points, without points on its edges
+VectorOfVector2d convexHull2D(VectorOfVector2d points);
+
+// Groups the boxes into clusters overlapping directly or through others, in
+// order of their first box. Touching boxes count as overlapping.
+std::vector<std::vector<size_t>> clusterByBoundingBox(const std::vector<BoundingBox>& boxes);
+
 Transform3d getResizeTransform(const BoundingBox &bbox, const Vector3d& newsize, const Eigen::Matrix<bool, 3, 1>& autosize);
 }
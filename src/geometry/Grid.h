@@ -2,6 +2,7 @@
 
 #include "linalg.h"
 #include "hash.h"
+#include "FlatHashMap.h"
 #include <boost/functional/hash.hpp>
 #include <cmath>
 
@@ -86,37 +87,55 @@ class Grid3d
 public:
   double res;
   using Key = Vector3l;
-  using GridContainer = std::unordered_map<Key, T>;
+  using GridContainer = FlatHashMap<Key, T>;
   GridContainer db;
 
+  // A grid cell with its hash in db
+  struct Cell {
+    Key key;
+    size_t hash;
+  };
+
   Grid3d(double resolution) {
     res = resolution;
   }
 
-  inline void createGridVertex(const Vector3d& v, Vector3l& i) {
+  inline void createGridVertex(const Vector3d& v, Vector3l& i) const {
     i[0] = int64_t(v[0] / this->res);
     i[1] = int64_t(v[1] / this->res);
     i[2] = int64_t(v[2] / this->res);
   }
 
+  // Doesn't depend on the contents of the grid, so cells can be found in parallel before aligning
+  Cell cell(const Vector3d& v) const {
+    Cell c;
+    createGridVertex(v, c.key);
+    c.hash = GridContainer::hash(c.key);
+    return c;
+  }
+
   // Aligns vertex to the grid. Returns index of the vertex.
   // Will automatically increase the index as new unique vertices are added.
   T align(Vector3d& v) {
-    Vector3l key;
-    createGridVertex(v, key);
-    auto iter = db.find(key);
-    if (iter == db.end()) {
+    return align(v, cell(v));
+  }
+
+  // Like align(v), for the cell of v
+  T align(Vector3d& v, const Cell& cell) {
+    Vector3l key = cell.key;
+    auto entry = db.find(key, cell.hash);
+    if (!entry) {
       float dist = 10.0f; // > max possible distance
       for (int64_t jx = key[0] - 1; jx <= key[0] + 1; ++jx) {
         for (int64_t jy = key[1] - 1; jy <= key[1] + 1; ++jy) {
           for (int64_t jz = key[2] - 1; jz <= key[2] + 1; ++jz) {
             Vector3l k(jx, jy, jz);
-            auto tmpiter = db.find(k);
-            if (tmpiter == db.end()) continue;
+            auto tmpentry = db.find(k);
+            if (!tmpentry) continue;
             float d = sqrt((key - k).squaredNorm());
             if (d < dist) {
               dist = d;
-              iter = tmpiter;
+              entry = tmpentry;
             }
           }
         }
@@ -124,13 +143,13 @@ public:
     }
 
     T data;
-    if (iter == db.end()) { // Not found: insert using key
+    if (!entry) { // Not found: insert using key
       data = db.size();
-      db[key] = data;
+      db.emplace(key, data, cell.hash);
     } else {
       // If found return existing data
-      key = iter->first;
-      data = iter->second;
+      key = entry->first;
+      data = entry->second;
     }
 
     // Align vertex
@@ -141,19 +160,20 @@ public:
     return data;
   }
 
-  bool has(const Vector3d& v, T *data = nullptr) {
-    Vector3l key = createGridVertex(v);
-    typename GridContainer::iterator pos = db.find(key);
-    if (pos != db.end()) {
-      if (data) *data = pos->second;
+  bool has(const Vector3d& v, T *data = nullptr) const {
+    Vector3l key;
+    createGridVertex(v, key);
+    auto entry = db.find(key);
+    if (entry) {
+      if (data) *data = entry->second;
       return true;
     }
     for (int64_t jx = key[0] - 1; jx <= key[0] + 1; ++jx)
       for (int64_t jy = key[1] - 1; jy <= key[1] + 1; ++jy)
         for (int64_t jz = key[2] - 1; jz <= key[2] + 1; ++jz) {
-          pos = db.find(Vector3l(jx, jy, jz));
-          if (pos != db.end()) {
-            if (data) *data = pos->second;
+          entry = db.find(Vector3l(jx, jy, jz));
+          if (entry) {
+            if (data) *data = entry->second;
             return true;
           }
         }
@@ -31,19 +31,18 @@
 #include "ManifoldGeometry.h"
 #endif
 
-#ifdef ENABLE_CGAL
-
-#include "cgal.h"
-#include "cgalutils.h"
-#include "CGAL_Nef_polyhedron.h"
-#include "CGALHybridPolyhedron.h"
-
 #include "PolySet.h"
 
 void IndexedMesh::append_geometry(const PolySet& ps)
 {
   IndexedMesh& mesh = *this;
-  for (const auto& p : ps.polygons) {
+  if (mesh.numfaces == 0 && mesh.vertices.size() == 0) {
+    // Copying the PolySet's own indexed form is still cheaper than welding its
+    // vertices again. Single PolySets are shared by fromGeometry() instead.
+    mesh = *ps.getIndexedMesh();
+    return;
+  }
+  for (const auto& p : ps.getPolygons()) {
     for (const auto& v : p) {
       mesh.indices.push_back(mesh.vertices.lookup(v));
     }
@@ -52,6 +51,14 @@ void IndexedMesh::append_geometry(const PolySet& ps)
   }
 }
 
+#ifdef ENABLE_CGAL
+
+#include "cgal.h"
+#include "cgalutils.h"
+#include "CGAL_Nef_polyhedron.h"
+#include "CGALHybridPolyhedron.h"
+
+
 void IndexedMesh::append_geometry(const shared_ptr<const Geometry>& geom)
 {
   IndexedMesh& mesh = *this;
@@ -83,4 +90,13 @@ void IndexedMesh::append_geometry(const shared_ptr<const Geometry>& geom)
   }
 }
 
+std::shared_ptr<const IndexedMesh> IndexedMesh::fromGeometry(const shared_ptr<const Geometry>& geom)
+{
+  if (const auto ps = dynamic_pointer_cast<const PolySet>(geom)) return ps->getIndexedMesh();
+  auto mesh = std::make_shared<IndexedMesh>();
+  mesh->append_geometry(geom);
+  mesh->vertices.getArray(); // Materialize the vertex array for const users
+  return mesh;
+}
+
 #endif // ENABLE_CGAL
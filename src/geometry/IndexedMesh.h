@@ -27,11 +27,13 @@
 
 #pragma once
 
-#ifdef ENABLE_CGAL
-
 #include "PolySet.h"
 #include "Reindexer.h"
 
+/*!
+   Vertex-welded mesh: each distinct vertex is stored once, and faces are
+   stored as indices into the vertex array, each face terminated by -1.
+ */
 struct IndexedMesh {
   IndexedMesh() = default;
 
@@ -40,7 +42,9 @@ struct IndexedMesh {
   size_t numfaces{0};
 
   void append_geometry(const PolySet& ps);
+#ifdef ENABLE_CGAL
   void append_geometry(const shared_ptr<const Geometry>& geom);
+  // Shares the indexed form of a PolySet, other geometries are converted
+  static std::shared_ptr<const IndexedMesh> fromGeometry(const shared_ptr<const Geometry>& geom);
+#endif
 };
-
-#endif // ENABLE_CGAL
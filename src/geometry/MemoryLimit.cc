@@ -0,0 +1,46 @@
+#include "MemoryLimit.h"
+#include "GeometryCache.h"
+#include "GeometryDiskCache.h"
+#include "CGALCache.h"
+#include "PlatformUtils.h"
+#include "exceptions.h"
+#include "printutils.h"
+
+#include <utility>
+#include <vector>
+
+MemoryLimit *MemoryLimit::inst = nullptr;
+
+void MemoryLimit::update(size_t& reported, size_t bytes)
+{
+  const size_t total = this->working_set += bytes - reported;
+  reported = bytes;
+  if (!isEnabled()) return;
+
+  const size_t limit = this->limit;
+  if (total > limit) {
+    // Dropping our own working set is always fine, e.g. when an evaluator finishes
+    if (bytes == 0) return;
+    const std::string msg = STR("Geometry being evaluated needs ", PlatformUtils::toMemorySizeString(total, 2),
+                                ", more than the memory limit of ", PlatformUtils::toMemorySizeString(limit, 2), " (--max-memory)");
+    LOG(message_group::Error, "%1$s", msg);
+    throw MemoryLimitException(msg);
+  }
+  // Quick check, pinned entries are counted twice here
+  if (total + GeometryCache::instance()->totalCost() + CGALCache::instance()->totalCost() <= limit) return;
+
+  std::vector<std::pair<Hash128, shared_ptr<const Geometry>>> spill;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    const size_t unpinned = GeometryCache::instance()->unpinnedCost() + CGALCache::instance()->unpinnedCost();
+    if (total + unpinned <= limit) return;
+    const size_t excess = total + unpinned - limit;
+    const auto spillto = GeometryDiskCache::instance()->isEnabled() ? &spill : nullptr;
+    const size_t freed = GeometryCache::instance()->evictUnpinned(excess, spillto);
+    if (freed < excess) CGALCache::instance()->evictUnpinned(excess - freed, spillto);
+  }
+  // Written outside the lock, the geometry is freed once written
+  for (const auto& item : spill) {
+    GeometryDiskCache::instance()->insert(item.first, item.second);
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+/*!
+   Keeps the geometry held in memory under the limit set with --max-memory.
+
+   That geometry is the working set, the results the running evaluations hold
+   for nodes whose parents aren't finished yet, plus the geometry and CGAL
+   caches. Once the total exceeds the limit, cache entries no evaluation refers
+   to are evicted, least recently used first. If a disk cache is enabled
+   (--cache-dir or --spill-dir), evicted results are written to it, so they are
+   restored rather than evaluated again when needed later. A render only fails
+   when its working set alone exceeds the limit.
+ */
+class MemoryLimit
+{
+public:
+  static MemoryLimit *instance() { if (!inst) inst = new MemoryLimit; return inst; }
+
+  void setLimitMB(size_t limit) { this->limit = limit * 1024ul * 1024ul; }
+  bool isEnabled() const { return this->limit > 0; }
+
+  // Replaces the working set an evaluator reported before with bytes, and
+  // evicts cache entries as needed. Throws MemoryLimitException if the
+  // working set of all evaluators exceeds the limit.
+  void update(size_t& reported, size_t bytes);
+
+private:
+  static MemoryLimit *inst;
+
+  std::atomic<size_t> limit{0};
+  std::atomic<size_t> working_set{0};
+  // Serializes evictions between evaluation threads
+  std::mutex mutex;
+};
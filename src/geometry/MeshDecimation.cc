@@ -0,0 +1,290 @@
+#include "MeshDecimation.h"
+#include "IndexedMesh.h"
+#include "PolySet.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <queue>
+#include <vector>
+
+namespace {
+
+using Triangle = std::array<int, 3>;
+// Sum of the squared distances to planes, as in Garland and Heckbert's quadric error metric
+using Quadric = Eigen::Matrix4d;
+
+// Faces whose normal turns by more than about 78 degrees block a collapse
+constexpr double minNormalDot = 0.2;
+
+struct Collapse {
+  double cost;
+  int u, v; // v is merged into u, which moves to position
+  Vector3d position;
+  unsigned stamp_u, stamp_v;
+
+  bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+/*!
+   Decimates one connected component by collapsing the edge of lowest
+   quadric error, as long as the collapse keeps the mesh manifold and doesn't
+   fold faces over. Edges on open boundaries or shared by more than two faces
+   are kept, so open and non-manifold meshes keep their outlines.
+ */
+class ComponentDecimator
+{
+public:
+  ComponentDecimator(std::vector<Vector3d> points, std::vector<Triangle> triangles)
+    : positions(std::move(points)), faces(std::move(triangles)), alive(faces.size(), true),
+    vertexfaces(this->positions.size()), quadrics(this->positions.size(), Quadric::Zero()),
+    locked(this->positions.size(), false), stamps(this->positions.size(), 0), numfaces(faces.size())
+  {
+    std::vector<std::pair<int, int>> edges;
+    for (size_t f = 0; f < faces.size(); ++f) {
+      const auto& t = faces[f];
+      const Vector3d cross = (this->positions[t[1]] - this->positions[t[0]]).cross(this->positions[t[2]] - this->positions[t[0]]);
+      const double area2 = cross.norm();
+      if (area2 > 0) {
+        // Weighted by area, so slivers don't pin vertices in place
+        const Vector3d n = cross / area2;
+        const Eigen::Vector4d plane(n[0], n[1], n[2], -n.dot(this->positions[t[0]]));
+        const Quadric q = plane * plane.transpose() * (area2 / 2);
+        for (const int v : t) quadrics[v] += q;
+      }
+      for (int i = 0; i < 3; ++i) {
+        vertexfaces[t[i]].push_back(f);
+        edges.emplace_back(std::min(t[i], t[(i + 1) % 3]), std::max(t[i], t[(i + 1) % 3]));
+      }
+    }
+    // Edges of other than two faces are boundaries or non-manifold
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+      size_t j = i;
+      while (j < edges.size() && edges[j] == edges[i]) ++j;
+      if (j - i != 2) locked[edges[i].first] = locked[edges[i].second] = true;
+      else candidates.push_back(edges[i]);
+      i = j;
+    }
+  }
+
+  std::vector<Triangle> run(size_t targetFaces, double maxError)
+  {
+    for (const auto& edge : candidates) push(edge.first, edge.second);
+    const double maxCost = maxError * maxError;
+    // A tetrahedron can't be collapsed any further while staying closed
+    targetFaces = std::max<size_t>(targetFaces, 4);
+    while (!queue.empty() && numfaces > targetFaces) {
+      const Collapse c = queue.top();
+      queue.pop();
+      if (stamps[c.u] != c.stamp_u || stamps[c.v] != c.stamp_v) continue;
+      if (maxError > 0 && c.cost > maxCost) break;
+      if (!canCollapse(c)) continue;
+      collapse(c);
+    }
+
+    std::vector<Triangle> result;
+    for (size_t f = 0; f < faces.size(); ++f) {
+      if (alive[f]) result.push_back(faces[f]);
+    }
+    return result;
+  }
+
+  const std::vector<Vector3d>& vertices() const { return positions; }
+
+private:
+  static double cost(const Quadric& q, const Vector3d& x) {
+    const Eigen::Vector4d p(x[0], x[1], x[2], 1);
+    return std::max(0.0, p.dot(q * p));
+  }
+
+  void push(int u, int v)
+  {
+    if (locked[u] || locked[v]) return;
+    const Quadric q = quadrics[u] + quadrics[v];
+    const Vector3d& a = positions[u];
+    const Vector3d& b = positions[v];
+    std::vector<Vector3d> options{a, b, (a + b) / 2};
+    // The optimal position, unless the quadric is degenerate (e.g. on flat areas)
+    const Eigen::Matrix3d A = q.topLeftCorner<3, 3>();
+    const auto lu = A.fullPivLu();
+    if (lu.isInvertible()) {
+      const Vector3d x = lu.solve(-q.topRightCorner<3, 1>());
+      if ((x - options[2]).norm() <= (b - a).norm()) options.push_back(x);
+    }
+    Collapse c{cost(q, options[0]), u, v, options[0], stamps[u], stamps[v]};
+    for (size_t i = 1; i < options.size(); ++i) {
+      const double e = cost(q, options[i]);
+      if (e < c.cost) {
+        c.cost = e;
+        c.position = options[i];
+      }
+    }
+    queue.push(c);
+  }
+
+  void neighbors(int v, std::vector<int>& result) const
+  {
+    result.clear();
+    for (const int f : vertexfaces[v]) {
+      for (const int w : faces[f]) {
+        if (w != v) result.push_back(w);
+      }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+  }
+
+  bool canCollapse(const Collapse& c)
+  {
+    // Link condition: only the two vertices opposite the edge may be shared
+    neighbors(c.u, nu);
+    neighbors(c.v, nv);
+    std::vector<int> shared;
+    std::set_intersection(nu.begin(), nu.end(), nv.begin(), nv.end(), std::back_inserter(shared));
+    if (shared.size() != 2) return false;
+
+    for (const int w : {c.u, c.v}) {
+      for (const int f : vertexfaces[w]) {
+        const auto& t = faces[f];
+        if (std::find(t.begin(), t.end(), c.u) != t.end() && std::find(t.begin(), t.end(), c.v) != t.end()) continue;
+        std::array<Vector3d, 3> p;
+        for (int i = 0; i < 3; ++i) p[i] = t[i] == w ? c.position : positions[t[i]];
+        const Vector3d before = (positions[t[1]] - positions[t[0]]).cross(positions[t[2]] - positions[t[0]]);
+        const Vector3d after = (p[1] - p[0]).cross(p[2] - p[0]);
+        const double norms = before.norm() * after.norm();
+        if (norms == 0 || before.dot(after) < minNormalDot * norms) return false;
+      }
+    }
+    return true;
+  }
+
+  void collapse(const Collapse& c)
+  {
+    for (const int f : vertexfaces[c.v]) {
+      auto& t = faces[f];
+      if (std::find(t.begin(), t.end(), c.u) != t.end()) {
+        alive[f] = false;
+        numfaces--;
+        for (const int w : t) {
+          if (w == c.v) continue;
+          auto& list = vertexfaces[w];
+          list.erase(std::remove(list.begin(), list.end(), f), list.end());
+        }
+      } else {
+        std::replace(t.begin(), t.end(), c.v, c.u);
+        vertexfaces[c.u].push_back(f);
+      }
+    }
+    vertexfaces[c.v].clear();
+    positions[c.u] = c.position;
+    quadrics[c.u] += quadrics[c.v];
+    stamps[c.u]++;
+    stamps[c.v]++;
+    locked[c.v] = true;
+
+    neighbors(c.u, nu);
+    for (const int w : nu) push(c.u, w);
+  }
+
+  std::vector<Vector3d> positions;
+  std::vector<Triangle> faces;
+  std::vector<bool> alive;
+  std::vector<std::vector<int>> vertexfaces;
+  std::vector<Quadric, Eigen::aligned_allocator<Quadric>> quadrics;
+  std::vector<bool> locked;
+  std::vector<unsigned> stamps;
+  std::vector<std::pair<int, int>> candidates;
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+  size_t numfaces;
+  std::vector<int> nu, nv; // Scratch space
+};
+
+int find_root(std::vector<int>& parents, int v)
+{
+  while (parents[v] != v) {
+    parents[v] = parents[parents[v]];
+    v = parents[v];
+  }
+  return v;
+}
+
+} // namespace
+
+namespace MeshDecimation {
+
+/*!
+   Decimates the mesh, whose faces are split into triangle fans. Connected
+   components are decimated in parallel, each towards its share of the target
+   face count.
+ */
+shared_ptr<PolySet> decimate(const IndexedMesh& mesh, const DecimationOptions& options)
+{
+  std::vector<Triangle> triangles;
+  triangles.reserve(mesh.numfaces);
+  for (size_t begin = 0; begin < mesh.indices.size();) {
+    size_t end = begin;
+    while (end < mesh.indices.size() && mesh.indices[end] != -1) ++end;
+    for (size_t i = begin + 1; i + 1 < end; ++i) {
+      triangles.push_back({mesh.indices[begin], mesh.indices[i], mesh.indices[i + 1]});
+    }
+    begin = end + 1;
+  }
+
+  const auto vertices = mesh.vertices.toVector();
+  std::vector<int> parents(vertices.size());
+  std::iota(parents.begin(), parents.end(), 0);
+  for (const auto& t : triangles) {
+    parents[find_root(parents, t[1])] = find_root(parents, t[0]);
+    parents[find_root(parents, t[2])] = find_root(parents, t[0]);
+  }
+
+  // Components in the order of their first triangle, with local vertex indices
+  struct Component {
+    std::vector<Vector3d> vertices;
+    std::vector<Triangle> triangles;
+  };
+  std::vector<Component> components;
+  std::vector<int> component_of(vertices.size(), -1), local(vertices.size(), -1);
+  for (const auto& t : triangles) {
+    const int root = find_root(parents, t[0]);
+    if (component_of[root] < 0) {
+      component_of[root] = components.size();
+      components.emplace_back();
+    }
+    auto& component = components[component_of[root]];
+    Triangle lt;
+    for (int i = 0; i < 3; ++i) {
+      if (local[t[i]] < 0) {
+        local[t[i]] = component.vertices.size();
+        component.vertices.push_back(vertices[t[i]]);
+      }
+      lt[i] = local[t[i]];
+    }
+    component.triangles.push_back(lt);
+  }
+
+  std::vector<std::vector<std::array<Vector3d, 3>>> results(components.size());
+  parallelizable_transform(components.begin(), components.end(), results.begin(), [&](const Component& component) {
+    const size_t target = options.targetFaces == 0 ? 0 :
+                          static_cast<size_t>(std::ceil(double(options.targetFaces) * component.triangles.size() / triangles.size()));
+    ComponentDecimator decimator(component.vertices, component.triangles);
+    std::vector<std::array<Vector3d, 3>> result;
+    for (const auto& t : decimator.run(target, options.maxError)) {
+      result.push_back({decimator.vertices()[t[0]], decimator.vertices()[t[1]], decimator.vertices()[t[2]]});
+    }
+    return result;
+  });
+
+  auto ps = make_shared<PolySet>(3);
+  ps->reserve(std::accumulate(results.begin(), results.end(), size_t(0), [](size_t n, const auto& result) { return n + result.size(); }));
+  for (const auto& result : results) {
+    for (const auto& t : result) ps->append_triangle(t[0], t[1], t[2]);
+  }
+  return ps;
+}
+
+} // namespace MeshDecimation
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include "memory.h"
+
+class PolySet;
+struct IndexedMesh;
+
+/*!
+   Limits for the decimation of meshes: edges are collapsed until the mesh has
+   no more than targetFaces triangles, or until the next collapse would move
+   the surface by more than maxError. A zero limit doesn't apply.
+ */
+struct DecimationOptions {
+  double maxError{0};
+  size_t targetFaces{0};
+
+  [[nodiscard]] bool enabled() const { return maxError > 0 || targetFaces > 0; }
+};
+
+namespace MeshDecimation {
+
+shared_ptr<PolySet> decimate(const IndexedMesh& mesh, const DecimationOptions& options);
+
+}
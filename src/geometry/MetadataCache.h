@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <utility>
+
+/*!
+   Values derived from a geometry (bounding box, volume..), computed on first
+   use. Updates store a new copy, so const geometries shared between
+   evaluation threads can fill it in concurrently; at worst a value is
+   computed twice. Copies of the geometry share the values until modified.
+ */
+template <typename Metadata>
+class MetadataCache
+{
+public:
+  template <typename T, typename F>
+  T get(std::optional<T> Metadata::*field, F&& compute) const {
+    auto current = std::atomic_load(&this->data);
+    if (current && (*current).*field) return *((*current).*field);
+    T value = compute();
+    auto updated = current ? std::make_shared<Metadata>(*current) : std::make_shared<Metadata>();
+    (*updated).*field = value;
+    std::atomic_store(&this->data, std::shared_ptr<const Metadata>(std::move(updated)));
+    return value;
+  }
+
+  // The values known so far, for carrying them over a transform
+  [[nodiscard]] std::shared_ptr<const Metadata> known() const { return std::atomic_load(&this->data); }
+  // Only called while the geometry is modified, which nobody reads meanwhile
+  void set(std::shared_ptr<const Metadata> metadata) { this->data = std::move(metadata); }
+  void reset() { this->data.reset(); }
+
+private:
+  mutable std::shared_ptr<const Metadata> data;
+};
@@ -0,0 +1,191 @@
+#include "NodeProfiler.h"
+#include "printutils.h"
+#include "PlatformUtils.h"
+
+#include <algorithm>
+#include <fstream>
+
+NodeProfiler *NodeProfiler::inst = nullptr;
+
+void NodeProfiler::clear()
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->entries.clear();
+  this->subtree_start.clear();
+  this->threads.clear();
+  this->peak_pending_bytes = 0;
+  this->peak_pending_geometries = 0;
+}
+
+int64_t NodeProfiler::now() const
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - this->epoch).count();
+}
+
+/*!
+   Records an evaluated node. Children must be recorded before their parent,
+   which is the natural order of the (postfix) geometry evaluation.
+ */
+void NodeProfiler::record(Entry entry)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  int64_t start = entry.self_start;
+  auto it = this->subtree_start.find(entry.index);
+  if (it != this->subtree_start.end()) {
+    start = std::min(start, it->second);
+    this->subtree_start.erase(it);
+  }
+  if (entry.parent >= 0) {
+    auto parent = this->subtree_start.emplace(entry.parent, start).first;
+    parent->second = std::min(parent->second, start);
+  }
+  const int thread = this->threads.emplace(std::this_thread::get_id(), this->threads.size()).first->second;
+  this->entries.push_back({std::move(entry), start, thread});
+}
+
+void NodeProfiler::recordPending(size_t bytes, size_t geometries)
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (bytes > this->peak_pending_bytes) {
+    this->peak_pending_bytes = bytes;
+    this->peak_pending_geometries = geometries;
+  }
+}
+
+/*!
+   Returns the entries aggregated by node name and location, most expensive first.
+ */
+std::vector<NodeProfiler::LocationSummary> NodeProfiler::summarize() const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  std::map<std::pair<std::string, std::string>, LocationSummary> bylocation;
+  for (const auto& trace : this->entries) {
+    const auto& e = trace.entry;
+    auto& summary = bylocation[std::make_pair(e.location, e.name)];
+    summary.name = e.name;
+    summary.location = e.location;
+    summary.count++;
+    if (e.cached) summary.cached++;
+    summary.self_time += e.end - e.self_start;
+    summary.memory_in += e.memory_in;
+    summary.memory_out += e.memory_out;
+  }
+  std::vector<LocationSummary> result;
+  result.reserve(bylocation.size());
+  for (auto& entry : bylocation) result.push_back(std::move(entry.second));
+  std::stable_sort(result.begin(), result.end(), [](const LocationSummary& a, const LocationSummary& b) {
+    return a.self_time > b.self_time;
+  });
+  return result;
+}
+
+nlohmann::json NodeProfiler::summaryJson() const
+{
+  nlohmann::json json = nlohmann::json::array();
+  for (const auto& summary : summarize()) {
+    nlohmann::json entryJson;
+    entryJson["name"] = summary.name;
+    entryJson["location"] = summary.location;
+    entryJson["count"] = summary.count;
+    entryJson["cached"] = summary.cached;
+    entryJson["self_ms"] = summary.self_time / 1000.0;
+    json.push_back(entryJson);
+  }
+  return json;
+}
+
+/*!
+   Returns the geometry memory per location, largest results first, and the
+   peak memory held for unfinished nodes.
+ */
+nlohmann::json NodeProfiler::memoryJson() const
+{
+  auto summaries = summarize();
+  std::stable_sort(summaries.begin(), summaries.end(), [](const LocationSummary& a, const LocationSummary& b) {
+    return a.memory_out > b.memory_out;
+  });
+  nlohmann::json nodes = nlohmann::json::array();
+  for (const auto& summary : summaries) {
+    nlohmann::json entryJson;
+    entryJson["name"] = summary.name;
+    entryJson["location"] = summary.location;
+    entryJson["count"] = summary.count;
+    entryJson["retained_bytes"] = summary.memory_out;
+    entryJson["transient_bytes"] = summary.memory_in;
+    nodes.push_back(entryJson);
+  }
+  std::lock_guard<std::mutex> lock(this->mutex);
+  nlohmann::json json;
+  json["nodes"] = nodes;
+  json["pending_peak_bytes"] = this->peak_pending_bytes;
+  json["pending_peak_geometries"] = this->peak_pending_geometries;
+  return json;
+}
+
+void NodeProfiler::print(size_t count) const
+{
+  const auto summaries = summarize();
+  if (summaries.empty()) return;
+  LOG("Most expensive nodes (time excluding children):");
+  for (size_t i = 0; i < std::min(count, summaries.size()); ++i) {
+    const auto& summary = summaries[i];
+    LOG("   %1$10.3f ms  %2$5d x %3$s (%4$s)", summary.self_time / 1000.0, summary.count, summary.name, summary.location);
+  }
+}
+
+void NodeProfiler::printMemory(size_t count) const
+{
+  auto summaries = summarize();
+  if (summaries.empty()) return;
+  std::stable_sort(summaries.begin(), summaries.end(), [](const LocationSummary& a, const LocationSummary& b) {
+    return a.memory_out > b.memory_out;
+  });
+  LOG("Largest geometry results (retained / consumed from children):");
+  for (size_t i = 0; i < std::min(count, summaries.size()); ++i) {
+    const auto& summary = summaries[i];
+    LOG("   %1$10s / %2$10s  %3$5d x %4$s (%5$s)",
+        PlatformUtils::toMemorySizeString(summary.memory_out, 2), PlatformUtils::toMemorySizeString(summary.memory_in, 2),
+        summary.count, summary.name, summary.location);
+  }
+  std::lock_guard<std::mutex> lock(this->mutex);
+  LOG("Peak geometry held for unfinished nodes: %1$s in %2$d objects",
+      PlatformUtils::toMemorySizeString(this->peak_pending_bytes, 2), this->peak_pending_geometries);
+}
+
+/*!
+   Writes all entries in the Chrome trace event format.
+ */
+bool NodeProfiler::writeChromeTrace(const std::string& filename) const
+{
+  nlohmann::json events = nlohmann::json::array();
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (const auto& trace : this->entries) {
+      const auto& e = trace.entry;
+      nlohmann::json event;
+      event["name"] = e.name;
+      event["cat"] = e.cached ? "cached" : e.backend;
+      event["ph"] = "X";
+      event["ts"] = trace.start;
+      event["dur"] = e.end - trace.start;
+      event["pid"] = 1;
+      event["tid"] = trace.thread;
+      event["args"] = {
+        {"location", e.location},
+        {"backend", e.backend},
+        {"cached", e.cached},
+        {"facets_in", e.facets_in},
+        {"facets_out", e.facets_out},
+        {"self_ms", (e.end - e.self_start) / 1000.0},
+      };
+      events.push_back(event);
+    }
+  }
+  std::ofstream stream(filename);
+  if (!stream.is_open()) {
+    LOG(message_group::Error, "Can't write profile trace '%1$s'", filename);
+    return false;
+  }
+  stream << nlohmann::json{{"traceEvents", events}, {"displayTimeUnit", "ms"}};
+  return stream.good();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <json.hpp>
+
+/*!
+   Collects per-node timings of geometry evaluation.
+
+   The GeometryEvaluator records one entry for each node it evaluates (or fetches
+   from a cache): the time spent on the node itself, excluding its children,
+   facet counts in and out, and the backend that produced the result.
+   Entries can be summarized per source location (--summary profile) or
+   written as a Chrome trace (--profile-trace), which can be loaded in
+   chrome://tracing or Perfetto to see a flame graph of the evaluation.
+
+   For --summary memory, entries also hold the size of the node's result,
+   which is retained until its parent is done (or longer, if cached), and of
+   the children results it consumed, which are transient unless cached.
+ */
+class NodeProfiler
+{
+public:
+  struct Entry {
+    int index;          // Node index
+    int parent;         // Parent node index, -1 for the root
+    std::string name;
+    std::string location;
+    std::string backend;
+    bool cached;
+    size_t facets_in;
+    size_t facets_out;
+    size_t memory_in;   // Bytes, children results
+    size_t memory_out;  // Bytes, own result
+    int64_t self_start; // Microseconds, start of the node's own work
+    int64_t end;
+  };
+
+  static NodeProfiler *instance() { if (!inst) inst = new NodeProfiler; return inst; }
+
+  void setEnabled(bool on) { this->enabled = on; }
+  bool isEnabled() const { return this->enabled; }
+  void clear();
+
+  int64_t now() const;
+  void record(Entry entry);
+  // Records the geometries held for nodes which are not finished yet
+  void recordPending(size_t bytes, size_t geometries);
+
+  nlohmann::json summaryJson() const;
+  nlohmann::json memoryJson() const;
+  void print(size_t count = 10) const;
+  void printMemory(size_t count = 10) const;
+  bool writeChromeTrace(const std::string& filename) const;
+
+private:
+  static NodeProfiler *inst;
+
+  struct TraceEntry {
+    Entry entry;
+    int64_t start; // Including children
+    int thread;
+  };
+  struct LocationSummary {
+    std::string name;
+    std::string location;
+    size_t count{0};
+    size_t cached{0};
+    int64_t self_time{0};
+    size_t memory_in{0};
+    size_t memory_out{0};
+  };
+  std::vector<LocationSummary> summarize() const;
+
+  bool enabled{false};
+  const std::chrono::steady_clock::time_point epoch{std::chrono::steady_clock::now()};
+  mutable std::mutex mutex;
+  std::vector<TraceEntry> entries;
+  std::unordered_map<int, int64_t> subtree_start; // Earliest start among recorded children, by parent index
+  std::map<std::thread::id, int> threads;
+  size_t peak_pending_bytes{0};
+  size_t peak_pending_geometries{0};
+};
@@ -25,11 +25,16 @@
  */
 
 #include "PolySet.h"
+#include "IndexedMesh.h"
 #include "PolySetUtils.h"
 #include "linalg.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 #include "Grid.h"
+#include "parallel.h"
 #include <Eigen/LU>
+#include <algorithm>
+#include <cmath>
 #include <utility>
 
 /*! /class PolySet
@@ -78,12 +83,26 @@ std::string PolySet::dump() const
 void PolySet::append_poly(size_t expected_vertex_count)
 {
   polygons.emplace_back().reserve(expected_vertex_count);
+  this->indexed.mesh.reset();
+  this->metadata.reset();
 }
 
 void PolySet::append_poly(const Polygon& poly)
 {
   polygons.push_back(poly);
-  this->dirty = true;
+  invalidate();
+}
+
+void PolySet::append_poly(Polygon&& poly)
+{
+  polygons.push_back(std::move(poly));
+  invalidate();
+}
+
+void PolySet::append_triangle(const Vector3d& a, const Vector3d& b, const Vector3d& c)
+{
+  polygons.push_back({a, b, c});
+  invalidate();
 }
 
 void PolySet::append_vertex(double x, double y, double z)
@@ -94,7 +113,7 @@ void PolySet::append_vertex(double x, double y, double z)
 void PolySet::append_vertex(const Vector3d& v)
 {
   polygons.back().push_back(v);
-  this->dirty = true;
+  invalidate();
 }
 
 void PolySet::append_vertex(const Vector3f& v)
@@ -110,7 +129,7 @@ void PolySet::insert_vertex(double x, double y, double z)
 void PolySet::insert_vertex(const Vector3d& v)
 {
   polygons.back().insert(polygons.back().begin(), v);
-  this->dirty = true;
+  invalidate();
 }
 
 void PolySet::insert_vertex(const Vector3f& v)
@@ -143,17 +162,39 @@ size_t PolySet::memsize() const
 
 void PolySet::append(const PolySet& ps)
 {
+  if (!dirty && !this->bbox.isNull()) {
+    this->bbox.extend(ps.getBoundingBox());
+  } else {
+    // The bounding box may not have been computed yet
+    this->dirty = true;
+  }
   this->polygons.insert(this->polygons.end(), ps.polygons.begin(), ps.polygons.end());
+  if (convex) convex = unknown;
+  this->indexed.mesh.reset();
+  this->metadata.reset();
+}
+
+void PolySet::append(PolySet&& ps)
+{
+  // As in the copying overload, but here the box of ps has to be read before
+  // its polygons are moved out
   if (!dirty && !this->bbox.isNull()) {
     this->bbox.extend(ps.getBoundingBox());
+  } else {
+    // The bounding box may not have been computed yet
+    this->dirty = true;
   }
+  this->polygons.insert(this->polygons.end(), std::make_move_iterator(ps.polygons.begin()), std::make_move_iterator(ps.polygons.end()));
   if (convex) convex = unknown;
+  this->indexed.mesh.reset();
+  this->metadata.reset();
 }
 
 void PolySet::transform(const Transform3d& mat)
 {
   // If mirroring transform, flip faces to avoid the object to end up being inside-out
-  bool mirrored = mat.matrix().determinant() < 0;
+  const double det = mat.matrix().determinant();
+  bool mirrored = det < 0;
 
   for (auto& p : this->polygons) {
     for (auto& v : p) {
@@ -161,13 +202,107 @@ void PolySet::transform(const Transform3d& mat)
     }
     if (mirrored) std::reverse(p.begin(), p.end());
   }
+  // Faces are flipped along with mirroring, so the topology is kept and the
+  // volume only scales. Flattening transforms make the convexity unknown.
+  const auto known = this->metadata.known();
+  invalidate();
+  if (known) {
+    auto transformed = std::make_shared<Metadata>();
+    if (known->volume) transformed->volume = *known->volume * std::abs(det);
+    if (det != 0) {
+      transformed->manifold = known->manifold;
+      transformed->convex = known->convex;
+    }
+    this->metadata.set(std::move(transformed));
+  }
+}
+
+/*!
+   Marks the derived data (bounding box, indexed form, metadata) as outdated.
+ */
+void PolySet::invalidate()
+{
   this->dirty = true;
+  this->indexed.mesh.reset();
+  this->metadata.reset();
+}
+
+/*!
+   Returns the PolySet as an indexed mesh with shared vertices.
+   The mesh is built on first use and then shared by all consumers (exporters,
+   Manifold conversion..) until the PolySet is modified.
+ */
+std::shared_ptr<const IndexedMesh> PolySet::getIndexedMesh() const
+{
+  // May be called concurrently on shared (const) PolySets from evaluation threads
+  auto mesh = std::atomic_load(&this->indexed.mesh);
+  if (!mesh) {
+    auto newmesh = std::make_shared<IndexedMesh>();
+    newmesh->vertices.reserve(this->polygons.size());
+    for (const auto& p : this->polygons) {
+      for (const auto& v : p) {
+        newmesh->indices.push_back(newmesh->vertices.lookup(v));
+      }
+      newmesh->indices.push_back(-1);
+      newmesh->numfaces++;
+    }
+    newmesh->vertices.getArray(); // Materialize the vertex array while we own the mesh
+    mesh = newmesh;
+    std::atomic_store(&this->indexed.mesh, mesh);
+  }
+  return mesh;
 }
 
 bool PolySet::is_convex() const {
   if (convex || this->isEmpty()) return true;
   if (!convex) return false;
-  return PolySetUtils::is_approximately_convex(*this);
+  return this->metadata.get(&Metadata::convex, [this]() { return PolySetUtils::is_approximately_convex(*this); });
+}
+
+bool PolySet::isManifold() const {
+  return this->metadata.get(&Metadata::manifold, [this]() {
+    if (this->isEmpty()) return false;
+    // Each directed edge must appear once, and reversed once
+    const auto mesh = getIndexedMesh();
+    std::vector<std::pair<int, int>> edges, reversed;
+    for (size_t begin = 0; begin < mesh->indices.size();) {
+      size_t end = begin;
+      while (end < mesh->indices.size() && mesh->indices[end] != -1) ++end;
+      for (size_t i = begin; i < end; ++i) {
+        const int a = mesh->indices[i];
+        const int b = mesh->indices[i + 1 < end ? i + 1 : begin];
+        if (a == b) continue;
+        edges.emplace_back(a, b);
+        reversed.emplace_back(b, a);
+      }
+      begin = end + 1;
+    }
+    std::sort(edges.begin(), edges.end());
+    if (std::adjacent_find(edges.begin(), edges.end()) != edges.end()) return false;
+    std::sort(reversed.begin(), reversed.end());
+    return edges == reversed;
+  });
+}
+
+void PolySet::setManifold(bool manifold)
+{
+  this->metadata.get(&Metadata::manifold, [manifold]() { return manifold; });
+}
+
+/*!
+   Volume enclosed by the polygons, summed as signed tetrahedra from the
+   origin over a fan of each face, which is exact for planar faces.
+ */
+double PolySet::volume() const {
+  return this->metadata.get(&Metadata::volume, [this]() {
+    double sum = 0;
+    for (const auto& poly : this->polygons) {
+      for (size_t i = 1; i + 1 < poly.size(); ++i) {
+        sum += poly[0].dot(poly[i].cross(poly[i + 1]));
+      }
+    }
+    return std::abs(sum) / 6;
+  });
 }
 
 void PolySet::resize(const Vector3d& newsize, const Eigen::Matrix<bool, 3, 1>& autosize)
@@ -182,32 +317,57 @@ void PolySet::resize(const Vector3d& newsize, const Eigen::Matrix<bool, 3, 1>& a
  */
 void PolySet::quantizeVertices(std::vector<Vector3d> *pPointsOut)
 {
+  TimingCounters::Scope timer(TimingCounters::QUANTIZE);
+  // Vertices are aligned in order, as the first vertex found in a cell decides
+  // where nearby vertices go. Their grid cells are found in parallel, for
+  // batches of polygons small enough to keep in cache.
+  constexpr size_t batchVertices = 1 << 16;
   Grid3d<unsigned int> grid(GRID_FINE);
+  std::vector<const Vector3d *> batch;
+  std::vector<Grid3d<unsigned int>::Cell> cells;
   std::vector<unsigned int> indices; // Vertex indices in one polygon
-  for (auto iter = this->polygons.begin(); iter != this->polygons.end();) {
-    Polygon& p = *iter;
-    indices.resize(p.size());
-    // Quantize all vertices. Build index list
-    for (unsigned int i = 0; i < p.size(); ++i) {
-      indices[i] = grid.align(p[i]);
-      if (pPointsOut && pPointsOut->size() < grid.db.size()) {
-        pPointsOut->push_back(p[i]);
-      }
+  size_t kept = 0;
+  for (size_t begin = 0; begin < this->polygons.size();) {
+    size_t end = begin;
+    batch.clear();
+    while (end < this->polygons.size() && batch.size() < batchVertices) {
+      for (const auto& v : this->polygons[end]) batch.push_back(&v);
+      ++end;
     }
-    // Remove consecutive duplicate vertices
-    auto currp = p.begin();
-    for (unsigned int i = 0; i < indices.size(); ++i) {
-      if (indices[i] != indices[(i + 1) % indices.size()]) {
-        (*currp++) = p[i];
+    cells.resize(batch.size());
+    parallelizable_transform(batch.begin(), batch.end(), cells.begin(), [&grid](const Vector3d *v) {
+      return grid.cell(*v);
+    });
+
+    size_t c = 0;
+    for (size_t j = begin; j < end; ++j) {
+      Polygon& p = this->polygons[j];
+      indices.resize(p.size());
+      // Quantize all vertices. Build index list
+      for (unsigned int i = 0; i < p.size(); ++i) {
+        indices[i] = grid.align(p[i], cells[c++]);
+        if (pPointsOut && pPointsOut->size() < grid.db.size()) {
+          pPointsOut->push_back(p[i]);
+        }
+      }
+      // Remove consecutive duplicate vertices
+      auto currp = p.begin();
+      for (unsigned int i = 0; i < indices.size(); ++i) {
+        if (indices[i] != indices[(i + 1) % indices.size()]) {
+          (*currp++) = p[i];
+        }
+      }
+      p.erase(currp, p.end());
+      if (p.size() < 3) {
+        PRINTD("Removing collapsed polygon due to quantizing");
+      } else {
+        if (kept != j) this->polygons[kept] = std::move(p);
+        ++kept;
       }
     }
-    p.erase(currp, p.end());
-    if (p.size() < 3) {
-      PRINTD("Removing collapsed polygon due to quantizing");
-      this->polygons.erase(iter);
-    } else {
-      iter++;
-    }
+    begin = end;
   }
+  this->polygons.resize(kept);
+  invalidate();
 }
 
@@ -5,20 +5,27 @@
 #include "GeometryUtils.h"
 #include "Polygon2d.h"
 #include "boost-utils.h"
+#include "MetadataCache.h"
 
+#include <memory>
 #include <vector>
 #include <string>
 
+struct IndexedMesh;
+
 class PolySet : public Geometry
 {
 public:
   VISITABLE_GEOMETRY();
-  Polygons polygons;
 
   PolySet(unsigned int dim, boost::tribool convex = unknown);
   PolySet(Polygon2d origin);
 
   const Polygon2d& getPolygon() const { return polygon; }
+  const Polygons& getPolygons() const { return polygons; }
+  // Marks the derived data as outdated, so don't modify the polygons through
+  // the reference after calling other methods
+  Polygons& mutablePolygons() { invalidate(); return polygons; }
 
   size_t memsize() const override;
   BoundingBox getBoundingBox() const override;
@@ -32,6 +39,9 @@ public:
   void reserve(size_t numFacets) { polygons.reserve(numFacets); }
   void append_poly(size_t expected_vertex_count);
   void append_poly(const Polygon& poly);
+  void append_poly(Polygon&& poly);
+  // Adds a triangle in one step, rather than growing it vertex by vertex
+  void append_triangle(const Vector3d& a, const Vector3d& b, const Vector3d& c);
   void append_vertex(double x, double y, double z = 0.0);
   void append_vertex(const Vector3d& v);
   void append_vertex(const Vector3f& v);
@@ -39,17 +49,44 @@ public:
   void insert_vertex(const Vector3d& v);
   void insert_vertex(const Vector3f& v);
   void append(const PolySet& ps);
+  void append(PolySet&& ps);
 
   void transform(const Transform3d& mat) override;
   void resize(const Vector3d& newsize, const Eigen::Matrix<bool, 3, 1>& autosize) override;
 
   bool is_convex() const;
   boost::tribool convexValue() const { return this->convex; }
+  // Closed, with every edge shared by two faces of opposite orientation
+  bool isManifold() const;
+  // For readers of formats which store the flag
+  void setManifold(bool manifold);
+  double volume() const;
+
+  std::shared_ptr<const IndexedMesh> getIndexedMesh() const;
 
 private:
+  void invalidate();
+
+  // Lazily built indexed form, not carried over to copies since those are
+  // usually made to be modified.
+  struct IndexedMeshCache {
+    IndexedMeshCache() = default;
+    IndexedMeshCache(const IndexedMeshCache& /*other*/) {}
+    IndexedMeshCache& operator=(const IndexedMeshCache& /*other*/) { mesh.reset(); return *this; }
+    std::shared_ptr<const IndexedMesh> mesh;
+  };
+
+  Polygons polygons;
   Polygon2d polygon;
   unsigned int dim;
   mutable boost::tribool convex;
   mutable BoundingBox bbox;
   mutable bool dirty;
+  mutable IndexedMeshCache indexed;
+  struct Metadata {
+    std::optional<bool> convex;
+    std::optional<bool> manifold;
+    std::optional<double> volume;
+  };
+  MetadataCache<Metadata> metadata;
 };
@@ -2,8 +2,16 @@
 #include "PolySet.h"
 #include "Polygon2d.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 #include "GeometryUtils.h"
 #include "Reindexer.h"
+#include "ClipperUtils.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <boost/functional/hash.hpp>
 #ifdef ENABLE_CGAL
 #include "cgalutils.h"
 #endif
@@ -16,7 +24,7 @@ namespace PolySetUtils {
 Polygon2d *project(const PolySet& ps) {
   auto poly = new Polygon2d;
 
-  for (const auto& p : ps.polygons) {
+  for (const auto& p : ps.getPolygons()) {
     Outline2d outline;
     for (const auto& v : p) {
       outline.vertices.emplace_back(v[0], v[1]);
@@ -26,6 +34,268 @@ Polygon2d *project(const PolySet& ps) {
   return poly;
 }
 
+namespace {
+
+struct PointHash {
+  size_t operator()(const Vector2d& v) const {
+    size_t seed = 0;
+    boost::hash_combine(seed, v[0]);
+    boost::hash_combine(seed, v[1]);
+    return seed;
+  }
+};
+
+/*!
+   Collects the closed outlines where the faces cross the plane at z, oriented counter-clockwise
+   around the material. Vertices at z count as above the plane if zero_above, else
+   as below it, i.e. the cut is taken just below or just above the plane.
+   Returns false if the crossings don't form closed outlines, as for open meshes.
+ */
+bool slice_outlines(const std::vector<const Polygon *>& faces, double z, bool zero_above, std::vector<VectorOfVector2d>& outlines)
+{
+  auto above = [z, zero_above](const Vector3d& v) { return zero_above ? v[2] >= z : v[2] > z; };
+  // Computed from the lower end of the edge, so both faces of an edge get the same point
+  auto crossing = [z](const Vector3d& below, const Vector3d& above) {
+    const double t = (z - below[2]) / (above[2] - below[2]);
+    return Vector2d(below[0] + t * (above[0] - below[0]) + 0.0, below[1] + t * (above[1] - below[1]) + 0.0);
+  };
+
+  std::vector<std::pair<Vector2d, Vector2d>> segments;
+  for (const auto *face : faces) {
+    const auto& p = *face;
+    // Fan triangles of concave faces overlap, but their crossings cancel out
+    for (size_t i = 1; i + 1 < p.size(); ++i) {
+      const Vector3d *v[3] = {&p[0], &p[i], &p[i + 1]};
+      Vector2d rising, falling;
+      int crossings = 0;
+      for (int j = 0; j < 3; ++j) {
+        const Vector3d& a = *v[j];
+        const Vector3d& b = *v[(j + 1) % 3];
+        if (!above(a) && above(b)) {
+          rising = crossing(a, b);
+          crossings++;
+        } else if (above(a) && !above(b)) {
+          falling = crossing(b, a);
+          crossings++;
+        }
+      }
+      // The material is left of walking from where the boundary goes down to where it goes up
+      if (crossings == 2 && falling != rising) segments.emplace_back(falling, rising);
+    }
+  }
+
+  std::unordered_map<Vector2d, std::vector<size_t>, PointHash> starts;
+  for (size_t i = 0; i < segments.size(); ++i) starts[segments[i].first].push_back(i);
+  std::vector<bool> used(segments.size());
+  for (size_t first = 0; first < segments.size(); ++first) {
+    if (used[first]) continue;
+    VectorOfVector2d outline;
+    size_t current = first;
+    while (true) {
+      used[current] = true;
+      outline.push_back(segments[current].first);
+      const Vector2d& end = segments[current].second;
+      if (end == segments[first].first) break;
+      auto it = starts.find(end);
+      if (it == starts.end()) return false;
+      auto& next = it->second;
+      while (!next.empty() && used[next.back()]) next.pop_back();
+      if (next.empty()) return false;
+      current = next.back();
+    }
+    if (outline.size() >= 3) outlines.push_back(std::move(outline));
+  }
+  return true;
+}
+
+/*!
+   Cross section of the faces at z. Like the intersection with a plane of Nef
+   polyhedra, faces lying in the plane belong to the cross section, whether the
+   object is above or below them. Returns nullptr if the faces don't form
+   closed outlines.
+ */
+Polygon2d *slice_faces(const std::vector<const Polygon *>& faces, double z)
+{
+  bool on_plane = false;
+  for (const auto *p : faces) {
+    for (const auto& v : *p) on_plane |= v[2] == z;
+  }
+  std::vector<VectorOfVector2d> outlines;
+  if (!slice_outlines(faces, z, false, outlines)) return nullptr;
+  // Faces in the plane only show up in one of the cuts just above and just below it
+  if (on_plane && !slice_outlines(faces, z, true, outlines)) return nullptr;
+  if (outlines.empty()) return new Polygon2d;
+
+  BoundingBox bounds;
+  for (const auto& outline : outlines) {
+    for (const auto& v : outline) bounds.extend(Vector3d(v[0], v[1], 0));
+  }
+  const int pow2 = ClipperUtils::getScalePow2(bounds);
+  const double scale = std::ldexp(1.0, pow2);
+  ClipperLib::Paths paths;
+  paths.reserve(outlines.size());
+  for (const auto& outline : outlines) {
+    ClipperLib::Path path;
+    path.reserve(outline.size());
+    for (const auto& v : outline) path.emplace_back(v[0] * scale, v[1] * scale);
+    paths.push_back(std::move(path));
+  }
+
+  // NonZero keeps the orientation, so holes stay holes and both cuts unite
+  TimingCounters::Scope timer(TimingCounters::CLIPPER);
+  ClipperLib::Clipper clipper;
+  clipper.AddPaths(paths, ClipperLib::ptSubject, true);
+  clipper.StrictlySimple(true);
+  ClipperLib::PolyTree result;
+  clipper.Execute(ClipperLib::ctUnion, result, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+  return ClipperUtils::toPolygon2d(result, pow2);
+}
+
+// Layers sliced per task
+constexpr size_t layersPerChunk = 16;
+
+} // namespace
+
+/*!
+   Cross section at z = 0, as for projection(cut = true), directly from the faces.
+ */
+Polygon2d *slice(const PolySet& ps)
+{
+  std::vector<const Polygon *> faces;
+  faces.reserve(ps.getPolygons().size());
+  for (const auto& p : ps.getPolygons()) faces.push_back(&p);
+  return slice_faces(faces, 0);
+}
+
+/*!
+   Cross sections at each of the heights, in the same order. The faces are
+   sorted by their lowest point, and runs of consecutive layers are sliced in
+   parallel, each sweeping up through the faces so only the faces spanning a
+   layer are visited for it. Layers which don't form closed outlines are nullptr.
+ */
+std::vector<shared_ptr<const Polygon2d>> slice(const PolySet& ps, const std::vector<double>& heights)
+{
+  struct Face {
+    const Polygon *polygon;
+    double zmin, zmax;
+  };
+  std::vector<Face> faces;
+  faces.reserve(ps.getPolygons().size());
+  for (const auto& p : ps.getPolygons()) {
+    if (p.empty()) continue;
+    Face face{&p, p[0][2], p[0][2]};
+    for (const auto& v : p) {
+      face.zmin = std::min(face.zmin, v[2]);
+      face.zmax = std::max(face.zmax, v[2]);
+    }
+    faces.push_back(face);
+  }
+  std::sort(faces.begin(), faces.end(), [](const Face& a, const Face& b) { return a.zmin < b.zmin; });
+
+  std::vector<size_t> order(heights.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), [&heights](size_t a, size_t b) { return heights[a] < heights[b]; });
+  std::vector<size_t> chunks;
+  for (size_t i = 0; i < order.size(); i += layersPerChunk) chunks.push_back(i);
+
+  std::vector<shared_ptr<const Polygon2d>> layers(heights.size());
+  std::vector<char> done(chunks.size());
+  parallelizable_transform(chunks.begin(), chunks.end(), done.begin(), [&](size_t begin) {
+    const size_t end = std::min(begin + layersPerChunk, order.size());
+    // Faces reaching up to the current layer, with those below dropped as the sweep rises
+    std::vector<const Polygon *> active;
+    std::vector<double> active_zmax;
+    size_t next = 0;
+    for (size_t i = begin; i < end; ++i) {
+      const double z = heights[order[i]];
+      for (; next < faces.size() && faces[next].zmin <= z; ++next) {
+        active.push_back(faces[next].polygon);
+        active_zmax.push_back(faces[next].zmax);
+      }
+      size_t kept = 0;
+      for (size_t j = 0; j < active.size(); ++j) {
+        if (active_zmax[j] < z) continue;
+        active[kept] = active[j];
+        active_zmax[kept++] = active_zmax[j];
+      }
+      active.resize(kept);
+      active_zmax.resize(kept);
+      layers[order[i]].reset(slice_faces(active, z));
+    }
+    return char(1);
+  });
+  return layers;
+}
+
+namespace {
+
+// Faces united per task, before the results are merged pairwise
+constexpr size_t facesPerChunk = 1 << 12;
+
+ClipperLib::Paths unite(const ClipperLib::Paths& a, const ClipperLib::Paths& b = {})
+{
+  ClipperLib::Clipper clipper;
+  clipper.AddPaths(a, ClipperLib::ptSubject, true);
+  clipper.AddPaths(b, ClipperLib::ptSubject, true);
+  ClipperLib::Paths result;
+  clipper.Execute(ClipperLib::ctUnion, result, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+  return result;
+}
+
+} // namespace
+
+/*!
+   The outline of the projection onto the xy plane, as for projection(cut = false).
+   The projected faces are united in chunks and then merged pairwise, in parallel.
+   For closed meshes, faces facing down are skipped, as the faces facing up cover
+   the same area. Faces projecting to a line are always skipped.
+ */
+Polygon2d *footprint(const PolySet& ps, bool closed)
+{
+  const int pow2 = ClipperUtils::getScalePow2(ps.getBoundingBox());
+  const double scale = std::ldexp(1.0, pow2);
+
+  std::vector<size_t> chunks;
+  for (size_t i = 0; i < ps.getPolygons().size(); i += facesPerChunk) chunks.push_back(i);
+  std::vector<ClipperLib::Paths> united(chunks.size());
+  parallelizable_transform(chunks.begin(), chunks.end(), united.begin(), [&](size_t begin) {
+    ClipperLib::Paths paths;
+    const size_t end = std::min(begin + facesPerChunk, ps.getPolygons().size());
+    for (size_t i = begin; i < end; ++i) {
+      ClipperLib::Path path;
+      path.reserve(ps.getPolygons()[i].size());
+      for (const auto& v : ps.getPolygons()[i]) path.emplace_back(v[0] * scale, v[1] * scale);
+      const double area = ClipperLib::Area(path);
+      if (area == 0 || (closed && area < 0)) continue;
+      // Make sure all polygons point up, as back-facing ones are kept for open meshes
+      if (area < 0) std::reverse(path.begin(), path.end());
+      paths.push_back(std::move(path));
+    }
+    return unite(paths);
+  });
+
+  while (united.size() > 1) {
+    std::vector<size_t> pairs;
+    for (size_t i = 0; i + 1 < united.size(); i += 2) pairs.push_back(i);
+    std::vector<ClipperLib::Paths> merged(pairs.size());
+    parallelizable_transform(pairs.begin(), pairs.end(), merged.begin(), [&united](size_t i) {
+      return unite(united[i], united[i + 1]);
+    });
+    if (united.size() % 2) merged.push_back(std::move(united.back()));
+    united = std::move(merged);
+  }
+
+  ClipperLib::PolyTree result;
+  if (!united.empty()) {
+    // This is key - without StrictlySimple, we tend to get self-intersecting results
+    ClipperLib::Clipper clipper;
+    clipper.StrictlySimple(true);
+    clipper.AddPaths(united.front(), ClipperLib::ptSubject, true);
+    clipper.Execute(ClipperLib::ctUnion, result, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+  }
+  return ClipperUtils::toPolygon2d(result, pow2);
+}
+
 /* Tessellation of 3d PolySet faces
 
    This code is for tessellating the faces of a 3d PolySet, assuming that
@@ -45,8 +315,20 @@ Polygon2d *project(const PolySet& ps) {
    polyset has simple polygon faces with no holes.
    The tessellation will be robust wrt. degenerate and self-intersecting
  */
-void tessellate_faces(const PolySet& inps, PolySet& outps)
+namespace {
+
+// Polygons tessellated per task
+constexpr size_t polygonsPerChunk = 1 << 12;
+
+} // namespace
+
+/*!
+   Tessellates the faces into triangles, in parallel chunks of polygons which
+   are concatenated in order.
+ */
+void tessellate_faces(const PolySet& inps, IndexedTriangleMesh& outmesh)
 {
+  TimingCounters::Scope timer(TimingCounters::TESSELLATION);
   int degeneratePolygons = 0;
 
   // Build Indexed PolyMesh
@@ -54,12 +336,12 @@ void tessellate_faces(const PolySet& inps, PolySet& outps)
   std::vector<std::vector<IndexedFace>> polygons;
 
   // best estimate without iterating all polygons, to reduce reallocations
-  polygons.reserve(inps.polygons.size() );
+  polygons.reserve(inps.getPolygons().size() );
 
   // minimum estimate without iterating all polygons, to reduce reallocation and rehashing
-  allVertices.reserve(3 * inps.polygons.size() );
+  allVertices.reserve(3 * inps.getPolygons().size() );
 
-  for (const auto& pgon : inps.polygons) {
+  for (const auto& pgon : inps.getPolygons()) {
     if (pgon.size() < 3) {
       degeneratePolygons++;
       continue;
@@ -83,44 +365,56 @@ void tessellate_faces(const PolySet& inps, PolySet& outps)
   }
 
   // Tessellate indexed mesh
-  const auto& verts = allVertices.getArray();
-
-  // we will reuse this memory instead of reallocating for each polygon
-  std::vector<IndexedTriangle> triangles;
-
-  // Estimate how many polygons we will need and preallocate.
-  // This is usually an undercount, but still prevents a lot of reallocations.
-  outps.polygons.reserve(polygons.size() );
-
-  for (const auto& faces : polygons) {
-    if (faces[0].size() == 3) {
-      // trivial case - triangles cannot be concave or have holes
-      outps.append_poly(3);
-      outps.append_vertex(verts[faces[0][0]]);
-      outps.append_vertex(verts[faces[0][1]]);
-      outps.append_vertex(verts[faces[0][2]]);
-    }
-    // Quads seem trivial, but can be concave, and can have degenerate cases.
-    // So everything more complex than triangles goes into the general case.
-    else {
-      triangles.clear();
-      auto err = GeometryUtils::tessellatePolygonWithHoles(verts, faces, triangles, nullptr);
-      if (!err) {
-        for (const auto& t : triangles) {
-          outps.append_poly(3);
-          outps.append_vertex(verts[t[0]]);
-          outps.append_vertex(verts[t[1]]);
-          outps.append_vertex(verts[t[2]]);
-        }
+  outmesh.vertices = allVertices.getArray();
+  const auto& verts = outmesh.vertices;
+  std::vector<size_t> chunks;
+  for (size_t i = 0; i < polygons.size(); i += polygonsPerChunk) chunks.push_back(i);
+  std::vector<std::vector<IndexedTriangle>> results(chunks.size());
+  parallelizable_transform(chunks.begin(), chunks.end(), results.begin(), [&](size_t begin) {
+    const size_t end = std::min(begin + polygonsPerChunk, polygons.size());
+    std::vector<IndexedTriangle> result;
+    // Usually an undercount, but still prevents a lot of reallocations
+    result.reserve(end - begin);
+    // we will reuse this memory instead of reallocating for each polygon
+    std::vector<IndexedTriangle> triangles;
+    for (size_t i = begin; i < end; ++i) {
+      const auto& faces = polygons[i];
+      if (faces[0].size() == 3) {
+        // trivial case - triangles cannot be concave or have holes
+        result.emplace_back(faces[0][0], faces[0][1], faces[0][2]);
+      }
+      // Quads seem trivial, but can be concave, and can have degenerate cases.
+      // So everything more complex than triangles goes into the general case.
+      else {
+        triangles.clear();
+        auto err = GeometryUtils::tessellatePolygonWithHoles(verts, faces, triangles, nullptr);
+        if (!err) result.insert(result.end(), triangles.begin(), triangles.end());
       }
     }
-  }
+    return result;
+  });
+
+  size_t count = 0;
+  for (const auto& result : results) count += result.size();
+  outmesh.triangles.clear();
+  outmesh.triangles.reserve(count);
+  for (const auto& result : results) outmesh.triangles.insert(outmesh.triangles.end(), result.begin(), result.end());
 
   if (degeneratePolygons > 0) {
     LOG(message_group::Warning, "PolySet has degenerate polygons");
   }
 }
 
+void tessellate_faces(const PolySet& inps, PolySet& outps)
+{
+  IndexedTriangleMesh mesh;
+  tessellate_faces(inps, mesh);
+  outps.reserve(outps.numFacets() + mesh.triangles.size());
+  for (const auto& t : mesh.triangles) {
+    outps.append_triangle(mesh.vertices[t[0]].cast<double>(), mesh.vertices[t[1]].cast<double>(), mesh.vertices[t[2]].cast<double>());
+  }
+}
+
 bool is_approximately_convex(const PolySet& ps) {
 #ifdef ENABLE_CGAL
   return CGALUtils::is_approximately_convex(ps);
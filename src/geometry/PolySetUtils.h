@@ -1,12 +1,21 @@
 #pragma once
 
+#include <vector>
+#include "memory.h"
+
 class Polygon2d;
 class PolySet;
+struct IndexedTriangleMesh;
 
 namespace PolySetUtils {
 
 Polygon2d *project(const PolySet& ps);
+Polygon2d *slice(const PolySet& ps);
+std::vector<shared_ptr<const Polygon2d>> slice(const PolySet& ps, const std::vector<double>& heights);
+Polygon2d *footprint(const PolySet& ps, bool closed);
 void tessellate_faces(const PolySet& inps, PolySet& outps);
+// Welds the vertices in float precision, for converting the triangles to other meshes without another PolySet
+void tessellate_faces(const PolySet& inps, IndexedTriangleMesh& outmesh);
 bool is_approximately_convex(const PolySet& ps);
 
 }
@@ -1,4 +1,5 @@
 #include "Polygon2d.h"
+#include "ClipperUtils.h"
 #include "printutils.h"
 
 
@@ -31,17 +32,22 @@ size_t Polygon2d::memsize() const
   for (const auto& o : this->outlines()) {
     mem += o.vertices.size() * sizeof(Vector2d) + sizeof(Outline2d);
   }
+  if (const auto paths = cachedClipperPaths()) {
+    for (const auto& path : paths->paths) mem += path.size() * sizeof(ClipperLib::IntPoint);
+  }
   mem += sizeof(Polygon2d);
   return mem;
 }
 
 BoundingBox Polygon2d::getBoundingBox() const
 {
-  BoundingBox bbox;
-  for (const auto& o : this->outlines()) {
-    bbox.extend(o.getBoundingBox());
-  }
-  return bbox;
+  return this->metadata.get(&Metadata::bbox, [this]() {
+    BoundingBox bbox;
+    for (const auto& o : this->outlines()) {
+      bbox.extend(o.getBoundingBox());
+    }
+    return bbox;
+  });
 }
 
 std::string Polygon2d::dump() const
@@ -64,11 +70,42 @@ bool Polygon2d::isEmpty() const
 
 void Polygon2d::transform(const Transform2d& mat)
 {
-  if (mat.matrix().determinant() == 0) {
+  this->clipperpaths.reset();
+  const double det = mat.matrix().determinant();
+  if (det == 0) {
     LOG(message_group::Warning, "Scaling a 2D object with 0 - removing object");
     this->theoutlines.clear();
+    this->triangles.reset();
+    this->metadata.reset();
     return;
   }
+  // Areas scale with the determinant, convexity is kept unless mirrored, and
+  // the bounding box maps onto the new one while the axes stay aligned
+  if (const auto known = this->metadata.known()) {
+    auto transformed = std::make_shared<Metadata>();
+    if (known->area) transformed->area = *known->area * std::abs(det);
+    if (det > 0) transformed->convex = known->convex;
+    if (known->bbox && mat.linear()(0, 1) == 0 && mat.linear()(1, 0) == 0) {
+      BoundingBox bbox;
+      if (!known->bbox->isEmpty()) {
+        for (const auto& corner : {known->bbox->min(), known->bbox->max()}) {
+          const Vector2d v = mat * Vector2d(corner[0], corner[1]);
+          bbox.extend(Vector3d(v[0], v[1], 0));
+        }
+      }
+      transformed->bbox = bbox;
+    }
+    this->metadata.set(std::move(transformed));
+  }
+  if (this->triangles) {
+    if (det > 0) {
+      auto transformed = std::make_shared<VectorOfVector2d>(*this->triangles);
+      for (auto& v : *transformed) v = mat * v;
+      this->triangles = std::move(transformed);
+    } else {
+      this->triangles.reset();
+    }
+  }
   for (auto& o : this->theoutlines) {
     for (auto& v : o.vertices) {
       v = mat * v;
@@ -102,6 +139,11 @@ void Polygon2d::resize(const Vector2d& newsize, const Eigen::Matrix<bool, 2, 1>&
 }
 
 bool Polygon2d::is_convex() const
+{
+  return this->metadata.get(&Metadata::convex, [this]() { return compute_convex(); });
+}
+
+bool Polygon2d::compute_convex() const
 {
   if (theoutlines.size() > 1) return false;
   if (theoutlines.empty()) return true;
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include "Geometry.h"
 #include "linalg.h"
+#include "MetadataCache.h"
 #include <numeric>
 
+namespace ClipperUtils {
+struct ScaledPaths;
+}
+
 /*!
    A single contour.
    positive is (optionally) used to distinguish between polygon contours and hole contours.
@@ -34,7 +40,7 @@ public:
     }
                            );
   }
-  void addOutline(Outline2d outline) { this->theoutlines.push_back(std::move(outline)); }
+  void addOutline(Outline2d outline) { this->theoutlines.push_back(std::move(outline)); this->clipperpaths.reset(); this->triangles.reset(); this->metadata.reset(); }
   [[nodiscard]] class PolySet *tessellate() const;
   [[nodiscard]] double area() const;
 
@@ -55,7 +61,23 @@ public:
   [[nodiscard]] bool isSanitized() const { return this->sanitized; }
   void setSanitized(bool s) { this->sanitized = s; }
   [[nodiscard]] bool is_convex() const;
+
+  // Outlines converted by ClipperUtils, kept while the polygon is unchanged
+  [[nodiscard]] std::shared_ptr<const ClipperUtils::ScaledPaths> cachedClipperPaths() const { return std::atomic_load(&this->clipperpaths); }
+  void setCachedClipperPaths(std::shared_ptr<const ClipperUtils::ScaledPaths> paths) const { std::atomic_store(&this->clipperpaths, std::move(paths)); }
 private:
+  [[nodiscard]] bool compute_convex() const;
+
   Outlines2d theoutlines;
   bool sanitized{false};
+  mutable std::shared_ptr<const ClipperUtils::ScaledPaths> clipperpaths;
+  // Triangles from tessellate(), three vertices each. Copies share them, and
+  // transforms which keep the orientation carry them over.
+  mutable std::shared_ptr<const VectorOfVector2d> triangles;
+  struct Metadata {
+    std::optional<BoundingBox> bbox;
+    std::optional<double> area;
+    std::optional<bool> convex;
+  };
+  MetadataCache<Metadata> metadata;
 };
@@ -1,9 +1,10 @@
 #pragma once
 
-#include <unordered_map>
+#include "FlatHashMap.h"
 #include <functional>
 #include <vector>
 #include <algorithm>
+#include <cassert>
 #include "hash.h" // IWYU pragma: keep
 
 /*!
@@ -21,12 +22,7 @@ public:
      Looks up a value. Will insert the value if it doesn't already exist.
      Returns the new index. */
   int lookup(const T& val) {
-    auto iter = this->map.find(val);
-    if (iter != this->map.end()) return iter->second;
-    else {
-      this->map.insert(std::make_pair(val, this->map.size()));
-      return this->map.size() - 1;
-    }
+    return this->map.emplace(val, this->map.size()).first->second;
   }
 
   /*!
@@ -54,6 +50,25 @@ public:
     return this->vec;
   }
 
+  /*!
+     The element array as built by the last call to getArray()
+   */
+  [[nodiscard]] const std::vector<T>& getArray() const {
+    assert(this->vec.size() == this->map.size() && "Reindexer array not built");
+    return this->vec;
+  }
+
+  /*!
+     Like getArray(), for const reindexers
+   */
+  [[nodiscard]] std::vector<T> toVector() const {
+    std::vector<T> result(this->map.size());
+    for (const auto& entry : map) {
+      result[entry.second] = entry.first;
+    }
+    return result;
+  }
+
   /*!
      Copies the internal vector to the given destination
    */
@@ -63,6 +78,6 @@ public:
   }
 
 private:
-  std::unordered_map<T, int> map;
+  FlatHashMap<T, int> map;
   std::vector<T> vec;
 };
@@ -0,0 +1,211 @@
+#include "SubtreeDistribution.h"
+#include "GeometryEvaluator.h"
+#include "GeometryDiskCache.h"
+#include "Tree.h"
+#include "node.h"
+#include "CsgOpNode.h"
+#include "CgalAdvNode.h"
+#include "ImportNode.h"
+#include "LinearExtrudeNode.h"
+#include "RotateExtrudeNode.h"
+#include "ProjectionNode.h"
+#include "RoofNode.h"
+#include "printutils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace SubtreeDistribution {
+
+namespace {
+
+struct Subtree {
+  const AbstractNode *node;
+  std::string key;
+  double cost;
+};
+
+using CostMap = std::unordered_map<const AbstractNode *, double>;
+
+/*!
+   Leaves cost one unit and imports more, as their files are read and
+   repaired. Booleans are charged per child, Minkowski sums by the product
+   of their operands and hulls by their points. Shared nodes are counted once.
+ */
+double cost(const AbstractNode& node, CostMap& costs)
+{
+  const auto it = costs.find(&node);
+  if (it != costs.end()) return it->second;
+
+  double children = 0, product = 1;
+  for (const auto& child : node.children) {
+    const double c = cost(*child, costs);
+    children += c;
+    product = std::min(product * std::max(c, 1.0), 1e15);
+  }
+  double result = children;
+  if (node.children.empty()) {
+    result = dynamic_cast<const ImportNode *>(&node) ? 20 : 1;
+  } else if (const auto *adv = dynamic_cast<const CgalAdvNode *>(&node)) {
+    result = adv->type == CgalAdvType::MINKOWSKI ? children + 10 * product : 2 * children;
+  } else if (dynamic_cast<const CsgOpNode *>(&node)) {
+    result = children + 5.0 * (node.children.size() - 1);
+  } else if (dynamic_cast<const RoofNode *>(&node)) {
+    result = 20 * children;
+  } else if (dynamic_cast<const ProjectionNode *>(&node)) {
+    result = 5 * children;
+  } else if (dynamic_cast<const LinearExtrudeNode *>(&node) || dynamic_cast<const RotateExtrudeNode *>(&node)) {
+    result = 2 * children;
+  }
+  costs.emplace(&node, result);
+  return result;
+}
+
+/*!
+   Collects the subtrees to distribute, top down: a subtree is taken as a
+   whole unless at least two of its children are worth distributing on
+   their own, which exposes more parallelism.
+ */
+void select(const AbstractNode& node, GeometryEvaluator& evaluator, double minCost, CostMap& costs,
+            std::unordered_set<const AbstractNode *>& selected, std::vector<Subtree>& subtrees)
+{
+  const double total = cost(node, costs);
+  if (total < minCost || !selected.insert(&node).second) return;
+  const auto expensive = std::count_if(node.children.begin(), node.children.end(),
+                                       [&](const auto& child) { return cost(*child, costs) >= minCost; });
+  if (expensive >= 2) {
+    for (const auto& child : node.children) select(*child, evaluator, minCost, costs, selected, subtrees);
+    return;
+  }
+  const Hash128 key = evaluator.cacheKey(node);
+  if (evaluator.isCached(key)) return;
+  subtrees.push_back({&node, key.toString(), total});
+}
+
+void evaluateLocally(const Subtree& subtree, const GeometryEvaluator& evaluator)
+{
+  GeometryEvaluator local(evaluator.getTree(), evaluator.getPrecision());
+  local.evaluateGeometry(*subtree.node, true);
+}
+
+} // namespace
+
+double estimateCost(const AbstractNode& node)
+{
+  CostMap costs;
+  return cost(node, costs);
+}
+
+namespace {
+
+const AbstractNode *findSubtree(const AbstractNode& root, const GeometryEvaluator& evaluator, const std::string& key)
+{
+  std::vector<const AbstractNode *> stack{&root};
+  std::unordered_set<const AbstractNode *> visited;
+  while (!stack.empty()) {
+    const auto *node = stack.back();
+    stack.pop_back();
+    if (!visited.insert(node).second) continue;
+    if (evaluator.cacheKey(*node).toString() == key) return node;
+    for (const auto& child : node->children) stack.push_back(child.get());
+  }
+  return nullptr;
+}
+
+} // namespace
+
+size_t evaluateSubtrees(const AbstractNode& root, GeometryEvaluator& evaluator, const std::vector<std::string>& keys)
+{
+  size_t missing = 0;
+  for (const auto& key : keys) {
+    const auto *node = findSubtree(root, evaluator, key);
+    if (!node) {
+      LOG(message_group::Warning, "No subtree with key %1$s in the design.", key);
+      missing++;
+      continue;
+    }
+    GeometryEvaluator local(evaluator.getTree(), evaluator.getPrecision());
+    local.evaluateGeometry(*node, true);
+  }
+  return missing;
+}
+
+void run(const AbstractNode& root, GeometryEvaluator& evaluator, const std::vector<std::string>& workers,
+         const nlohmann::json& job, double minCost)
+{
+  if (!GeometryDiskCache::instance()->isEnabled() || !GeometryDiskCache::instance()->writesThrough()) {
+    LOG(message_group::Warning, "Not distributing subtrees, the workers need a shared --cache-dir.");
+    return;
+  }
+  CostMap costs;
+  std::unordered_set<const AbstractNode *> selected;
+  std::vector<Subtree> subtrees;
+  select(root, evaluator, minCost, costs, selected, subtrees);
+  if (subtrees.size() < 2) return; // Nothing to evaluate beside the local share
+
+  // Longest first to the least loaded, this process being the last
+  std::sort(subtrees.begin(), subtrees.end(), [](const Subtree& a, const Subtree& b) { return a.cost > b.cost; });
+  std::vector<double> load(workers.size() + 1, 0);
+  std::vector<std::vector<const Subtree *>> shares(workers.size() + 1);
+  for (const auto& subtree : subtrees) {
+    const size_t i = std::min_element(load.begin(), load.end()) - load.begin();
+    load[i] += subtree.cost;
+    shares[i].push_back(&subtree);
+  }
+
+#ifndef _WIN32
+  // A worker that fails to start must not take this process down with it
+  const auto old_handler = std::signal(SIGPIPE, SIG_IGN);
+#endif
+  std::vector<FILE *> pipes(workers.size(), nullptr);
+  for (size_t i = 0; i < workers.size(); ++i) {
+    if (shares[i].empty()) continue;
+    pipes[i] = popen(workers[i].c_str(), "w");
+    if (!pipes[i]) {
+      LOG(message_group::Warning, "Can't start worker '%1$s', evaluating its subtrees locally.", workers[i]);
+      continue;
+    }
+    auto worker_job = job;
+    worker_job["subtrees"] = nlohmann::json::array();
+    for (const auto *subtree : shares[i]) worker_job["subtrees"].push_back(subtree->key);
+    const auto line = worker_job.dump() + "\n";
+    fwrite(line.data(), 1, line.size(), pipes[i]);
+    fflush(pipes[i]);
+  }
+  LOG("Distributing %1$d subtrees to %2$d workers", subtrees.size() - shares.back().size(), workers.size());
+
+  for (const auto *subtree : shares.back()) evaluateLocally(*subtree, evaluator);
+
+  // Results are loaded into the memory caches here, an entry which can't be
+  // read is dropped by the disk cache and its subtree evaluated locally
+  std::vector<const Subtree *> missing;
+  for (size_t i = 0; i < workers.size(); ++i) {
+    if (pipes[i] && pclose(pipes[i]) != 0) {
+      LOG(message_group::Warning, "Worker '%1$s' failed.", workers[i]);
+    }
+    for (const auto *subtree : shares[i]) {
+      const Hash128 key = evaluator.cacheKey(*subtree->node);
+      if (!GeometryDiskCache::instance()->adopt(key) || !evaluator.isCached(key)) missing.push_back(subtree);
+    }
+  }
+#ifndef _WIN32
+  std::signal(SIGPIPE, old_handler);
+#endif
+  if (!missing.empty()) {
+    LOG(message_group::Warning, "%1$d distributed subtrees weren't returned or couldn't be read, evaluating them locally.", missing.size());
+    for (const auto *subtree : missing) evaluateLocally(*subtree, evaluator);
+  }
+}
+
+} // namespace SubtreeDistribution
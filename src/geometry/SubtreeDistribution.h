@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <json.hpp>
+
+class AbstractNode;
+class GeometryEvaluator;
+
+/*!
+   Distributes the evaluation of expensive independent subtrees to render
+   servers (openscad --server) running on other machines. The workers need
+   the same design files at the same paths and share the persistent geometry
+   cache directory (--cache-dir) with this process, which is how results come
+   back: each worker evaluates its subtrees into the cache, and the local
+   evaluation of the whole design then finds them there. Workers need the
+   same version, features and render options, otherwise their keys differ.
+
+   Subtrees are chosen by a static cost model (see estimateCost()), since
+   their geometry is unknown before evaluation. Only subtrees estimated to
+   cost at least minCost are shipped, as shipping a subtree costs a parse
+   and instantiation of the design on the worker and writing and reading
+   its result. A share of the subtrees is evaluated locally while the
+   workers run.
+ */
+namespace SubtreeDistribution {
+
+// Estimated cost of evaluating the subtree, in arbitrary units
+double estimateCost(const AbstractNode& node);
+
+/*!
+   Sends the jobs for the subtrees of root worth distributing to the workers,
+   each given as a shell command reading jobs on stdin, e.g.
+   "ssh host openscad --server --cache-dir=/shared/cache".
+   The job holds the fields of a server job for the design; the keys of the
+   subtrees are added as "subtrees". Returns once all workers are done.
+ */
+void run(const AbstractNode& root, GeometryEvaluator& evaluator, const std::vector<std::string>& workers,
+         const nlohmann::json& job, double minCost);
+
+/*!
+   The worker side: evaluates the subtrees of root with the given keys into
+   the caches. Returns the number of keys not found in the design.
+ */
+size_t evaluateSubtrees(const AbstractNode& root, GeometryEvaluator& evaluator, const std::vector<std::string>& keys);
+
+}
@@ -9,13 +9,18 @@ CGALCache::CGALCache(size_t limit) : cache(limit)
 {
 }
 
-shared_ptr<const Geometry> CGALCache::get(const std::string& id) const
+shared_ptr<const Geometry> CGALCache::get(const Hash128& id) const
 {
-  const auto& N = this->cache[id]->N;
+  return this->cache.access(id, [&id](Cache<Hash128, cache_entry>& cache) -> shared_ptr<const Geometry> {
+    const auto entry = cache[id];
+    if (!entry) return nullptr;
+    entry->owners.add(CacheOwners::instance()->current());
+    const auto& N = entry->N;
 #ifdef DEBUG
-  LOG("CGAL Cache hit: %1$s (%2$d bytes)", id.substr(0, 40), N ? N->memsize() : 0);
+    LOG("CGAL Cache hit: %1$s (%2$d bytes)", id.toString(), N ? N->memsize() : 0);
 #endif
-  return N;
+    return N;
+  });
 }
 
 bool CGALCache::acceptsGeometry(const shared_ptr<const Geometry>& geom) {
@@ -24,13 +29,15 @@ bool CGALCache::acceptsGeometry(const shared_ptr<const Geometry>& geom) {
     dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom).get();
 }
 
-bool CGALCache::insert(const std::string& id, const shared_ptr<const Geometry>& N)
+bool CGALCache::insert(const Hash128& id, const shared_ptr<const Geometry>& N, double computetime)
 {
   assert(acceptsGeometry(N));
-  auto inserted = this->cache.insert(id, new cache_entry(N), N ? N->memsize() : 0);
+  const size_t cost = N ? N->memsize() : 0;
+  evictForFairShare(this->cache, cost);
+  auto inserted = this->cache.insert(id, new cache_entry(N), cost, computetime);
 #ifdef DEBUG
-  if (inserted) LOG("CGAL Cache insert: %1$s (%2$d bytes)", id.substr(0, 40), (N ? N->memsize() : 0));
-  else LOG("CGAL Cache insert failed: %1$s (%2$d bytes)", id.substr(0, 40), (N ? N->memsize() : 0));
+  if (inserted) LOG("CGAL Cache insert: %1$s (%2$d bytes)", id.toString(), (N ? N->memsize() : 0));
+  else LOG("CGAL Cache insert failed: %1$s (%2$d bytes)", id.toString(), (N ? N->memsize() : 0));
 #endif
   return inserted;
 }
@@ -64,6 +71,12 @@ void CGALCache::print()
 {
   LOG("CGAL Polyhedrons in cache: %1$d", this->cache.size());
   LOG("CGAL cache size in bytes: %1$d", this->cache.totalCost());
+  const auto owner = CacheOwners::instance()->current();
+  if (owner && CacheOwners::instance()->active().size() > 1) {
+    LOG("CGAL cache size in bytes used by this design: %1$d", ownerCost(owner));
+  }
+  LOG("CGAL cache compute time held: %1$.3f s, evicted: %2$d entries (%3$.3f s)",
+      this->cache.totalBenefit(), this->cache.evictions(), this->cache.evictedBenefit());
 }
 
 CGALCache::cache_entry::cache_entry(const shared_ptr<const Geometry>& N)
@@ -71,3 +84,26 @@ CGALCache::cache_entry::cache_entry(const shared_ptr<const Geometry>& N)
 {
   if (print_messages_stack.size() > 0) this->msg = print_messages_stack.back();
 }
+
+size_t CGALCache::ownerCost(unsigned owner) const
+{
+  return this->cache.costIf([owner](const Hash128&, const cache_entry& entry) {
+    return entry.owners.contains(owner);
+  });
+}
+
+size_t CGALCache::unpinnedCost() const
+{
+  return this->cache.costIf([](const Hash128&, const cache_entry& entry) {
+    return entry.N.use_count() == 1;
+  });
+}
+
+size_t CGALCache::evictUnpinned(size_t bytes, std::vector<std::pair<Hash128, shared_ptr<const Geometry>>> *spill)
+{
+  return this->cache.evict(bytes, [spill](const Hash128& id, const cache_entry& entry) {
+    if (entry.N.use_count() != 1) return true;
+    if (spill) spill->emplace_back(id, entry.N);
+    return false;
+  });
+}
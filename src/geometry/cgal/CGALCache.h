@@ -1,7 +1,11 @@
 #pragma once
 
-#include "Cache.h"
+#include <utility>
+#include <vector>
+#include "ShardedCache.h"
+#include "CacheOwners.h"
 #include "memory.h"
+#include "hash.h"
 
 class Geometry;
 
@@ -15,9 +19,9 @@ public:
   static CGALCache *instance() { if (!inst) inst = new CGALCache; return inst; }
   static bool acceptsGeometry(const shared_ptr<const Geometry>& geom);
 
-  bool contains(const std::string& id) const { return this->cache.contains(id); }
-  shared_ptr<const Geometry> get(const std::string& id) const;
-  bool insert(const std::string& id, const shared_ptr<const Geometry>& N);
+  bool contains(const Hash128& id) const { return this->cache.contains(id); }
+  shared_ptr<const Geometry> get(const Hash128& id) const;
+  bool insert(const Hash128& id, const shared_ptr<const Geometry>& N, double computetime = 0);
   size_t size() const;
   size_t totalCost() const;
   size_t maxSizeMB() const;
@@ -25,14 +29,21 @@ public:
   void clear();
   void print();
 
+  // See GeometryCache
+  size_t ownerCost(unsigned owner) const;
+  size_t unpinnedCost() const;
+  size_t evictUnpinned(size_t bytes, std::vector<std::pair<Hash128, shared_ptr<const Geometry>>> *spill);
+
 private:
   static CGALCache *inst;
 
   struct cache_entry {
     shared_ptr<const Geometry> N;
     std::string msg;
+    CacheEntryOwners owners;
     cache_entry(const shared_ptr<const Geometry>& N);
   };
 
-  Cache<std::string, cache_entry> cache;
+  // Sharded, as the cache is accessed from several evaluation threads
+  ShardedCache<Hash128, cache_entry> cache;
 };
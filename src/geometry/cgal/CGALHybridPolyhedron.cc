@@ -3,13 +3,26 @@
 
 #include "cgalutils.h"
 #include "Feature.h"
+#include "TimingCounters.h"
 #include <CGAL/Surface_mesh.h>
+#include <CGAL/boost/graph/copy_face_graph.h>
 #include <CGAL/boost/graph/helpers.h>
+#include <CGAL/Polygon_mesh_processing/bbox.h>
+#include <CGAL/Polygon_mesh_processing/self_intersections.h>
+#include <CGAL/Polygon_mesh_processing/stitch_borders.h>
 #include <fstream>
+#include <mutex>
 #include <sstream>
 #include <cstdio>
 #include <variant>
 
+namespace {
+
+std::mutex fallbacks_mutex;
+std::map<std::string, size_t> fallbacks;
+
+} // namespace
+
 CGALHybridPolyhedron::CGALHybridPolyhedron(const shared_ptr<CGAL_HybridNef>& nef)
 {
   assert(nef);
@@ -133,18 +146,60 @@ shared_ptr<const PolySet> CGALHybridPolyhedron::toPolySet() const
   }
 }
 
+bool CGALHybridPolyhedron::hasCoordinatesLargerThan(size_t maxBits) const
+{
+  if (auto mesh = getMesh()) {
+    for (auto v : mesh->vertices()) {
+      const auto& pt = mesh->point(v);
+      if (CGALUtils::hasLargeExactValue(pt.x(), maxBits) || CGALUtils::hasLargeExactValue(pt.y(), maxBits) ||
+          CGALUtils::hasLargeExactValue(pt.z(), maxBits)) return true;
+    }
+  }
+  return false;
+}
+
+void CGALHybridPolyhedron::roundCoordinates()
+{
+  if (auto mesh = getMesh()) {
+    for (auto v : mesh->vertices()) {
+      auto& pt = mesh->point(v);
+      pt = point_t(CGAL::to_double(pt.x()), CGAL::to_double(pt.y()), CGAL::to_double(pt.z()));
+    }
+  }
+}
+
+bool CGALHybridPolyhedron::isValidSolid() const
+{
+  auto mesh = getMesh();
+  if (!mesh) return false;
+  return CGAL::is_valid_polygon_mesh(*mesh) && CGAL::is_closed(*mesh) && CGAL::is_triangle_mesh(*mesh) &&
+         !CGAL::Polygon_mesh_processing::does_self_intersect(*mesh);
+}
+
 void CGALHybridPolyhedron::clear()
 {
   data = make_shared<CGAL_HybridMesh>();
 }
 
+bool CGALHybridPolyhedron::isApartFrom(const CGALHybridPolyhedron& other) const
+{
+  auto mesh = getMesh();
+  auto otherMesh = other.getMesh();
+  if (!mesh || !otherMesh || mesh->is_empty() || otherMesh->is_empty()) return false;
+  // The boxes of exact points enclose them, so touching operands always overlap
+  return !CGAL::do_overlap(CGAL::Polygon_mesh_processing::bbox(*mesh),
+                           CGAL::Polygon_mesh_processing::bbox(*otherMesh));
+}
+
 void CGALHybridPolyhedron::operator+=(CGALHybridPolyhedron& other)
 {
-  if (canCorefineWith(other)) {
-    if (meshBinOp("corefinement mesh union", other, [&](CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out) {
-      return CGALUtils::corefineAndComputeUnion(lhs, rhs, out);
-    })) return;
+  if (isApartFrom(other)) {
+    CGAL::copy_face_graph(*other.getMesh(), *getMesh());
+    return;
   }
+  if (corefine("corefinement mesh union", other, [&](CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out) {
+    return CGALUtils::corefineAndComputeUnion(lhs, rhs, out);
+  })) return;
 
   nefPolyBinOp("nef union", other,
                [&](CGAL_HybridNef& destinationNef, CGAL_HybridNef& otherNef) {
@@ -154,12 +209,14 @@ void CGALHybridPolyhedron::operator+=(CGALHybridPolyhedron& other)
 
 void CGALHybridPolyhedron::operator*=(CGALHybridPolyhedron& other)
 {
-  if (canCorefineWith(other)) {
-    if (meshBinOp("corefinement mesh intersection", other,
-                  [&](CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out) {
-      return CGALUtils::corefineAndComputeIntersection(lhs, rhs, out);
-    })) return;
+  if (isApartFrom(other)) {
+    clear();
+    return;
   }
+  if (corefine("corefinement mesh intersection", other,
+                [&](CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out) {
+    return CGALUtils::corefineAndComputeIntersection(lhs, rhs, out);
+  })) return;
 
   nefPolyBinOp("nef intersection", other,
                [&](CGAL_HybridNef& destinationNef, CGAL_HybridNef& otherNef) {
@@ -169,12 +226,11 @@ void CGALHybridPolyhedron::operator*=(CGALHybridPolyhedron& other)
 
 void CGALHybridPolyhedron::operator-=(CGALHybridPolyhedron& other)
 {
-  if (canCorefineWith(other)) {
-    if (meshBinOp("corefinement mesh difference", other,
-                  [&](CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out) {
-      return CGALUtils::corefineAndComputeDifference(lhs, rhs, out);
-    })) return;
-  }
+  if (isApartFrom(other)) return;
+  if (corefine("corefinement mesh difference", other,
+                [&](CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out) {
+    return CGALUtils::corefineAndComputeDifference(lhs, rhs, out);
+  })) return;
 
   nefPolyBinOp("nef difference", other,
                [&](CGAL_HybridNef& destinationNef, CGAL_HybridNef& otherNef) {
@@ -187,17 +243,39 @@ bool CGALHybridPolyhedron::canCorefineWith(const CGALHybridPolyhedron& other) co
   if (!Feature::ExperimentalFastCsgSafer.is_enabled()) {
     return true;
   }
-  const char *reasonWontCorefine = nullptr;
-  if (sharesAnyVertexWith(other)) {
-    reasonWontCorefine = "operands share some vertices";
-  } else if (!isManifold() || !other.isManifold()) {
-    reasonWontCorefine = "non manifoldness detected";
+  return isManifold() && other.isManifold();
+}
+
+bool CGALHybridPolyhedron::corefine(
+  const std::string& opName, CGALHybridPolyhedron& other,
+  const std::function<bool(CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out)>& operation)
+{
+  const char *failure = nullptr;
+  if (!canCorefineWith(other)) {
+    failure = "non manifoldness detected";
+  } else {
+    // Corefinement copes with most shared vertices, so rather than avoiding
+    // it the safer mode checks its result
+    const bool verify = Feature::ExperimentalFastCsgSafer.is_enabled() && sharesAnyVertexWith(other);
+    if (meshBinOp(opName, other, operation, verify, failure)) return true;
   }
-  if (reasonWontCorefine) {
-    LOG("[fast-csg] Performing safer but slower nef operation instead of corefinement because %1$s.",
-        reasonWontCorefine);
+  if (Feature::ExperimentalFastCsgSafer.is_enabled()) {
+    LOG("[fast-csg] Performing safer but slower nef operation instead of corefinement because %1$s.", failure);
   }
-  return !reasonWontCorefine;
+  countFallback(failure);
+  return false;
+}
+
+void CGALHybridPolyhedron::countFallback(const char *reason)
+{
+  std::lock_guard<std::mutex> lock(fallbacks_mutex);
+  fallbacks[reason]++;
+}
+
+std::map<std::string, size_t> CGALHybridPolyhedron::fallbackCounts()
+{
+  std::lock_guard<std::mutex> lock(fallbacks_mutex);
+  return fallbacks;
 }
 
 void CGALHybridPolyhedron::minkowski(CGALHybridPolyhedron& other)
@@ -334,8 +412,10 @@ void CGALHybridPolyhedron::nefPolyBinOp(
 
 bool CGALHybridPolyhedron::meshBinOp(
   const std::string& opName, CGALHybridPolyhedron& other,
-  const std::function<bool(CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out)>& operation)
+  const std::function<bool(CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out)>& operation,
+  bool verify, const char *& failure)
 {
+  TimingCounters::Scope timer(TimingCounters::COREFINEMENT);
   auto previousData = data;
   auto previousOtherData = other.data;
 
@@ -365,14 +445,32 @@ bool CGALHybridPolyhedron::meshBinOp(
       std::ofstream(rhsDebugDumpFile) << rhs;
     }
 
-    if ((success = operation(lhs, rhs, lhs))) {
-      CGALUtils::cleanupMesh(lhs, /* is_corefinement_result */ true);
+    // Cracks between duplicated vertices, as in many STL files, keep meshes
+    // from being closed, which corefinement needs
+    for (auto *mesh : {&lhs, &rhs}) {
+      if (!CGAL::is_closed(*mesh)) CGAL::Polygon_mesh_processing::stitch_borders(*mesh);
+    }
+
+    // A result to verify goes to a separate mesh, so the operands stay usable if it's rejected
+    CGAL_HybridMesh result;
+    auto& out = verify ? result : lhs;
+    if ((success = operation(lhs, rhs, out))) {
+      CGALUtils::cleanupMesh(out, /* is_corefinement_result */ true);
+      if (verify) {
+        if (CGAL::is_valid_polygon_mesh(result) && CGAL::is_closed(result)) {
+          lhs = std::move(result);
+        } else {
+          success = false;
+          failure = "operands share some vertices";
+        }
+      }
 
       if (debug) {
         remove(lhsDebugDumpFile.c_str());
         remove(rhsDebugDumpFile.c_str());
       }
     } else {
+      failure = "corefinement failed";
       LOG(message_group::Warning, "[fast-csg] Corefinement %1$s #%2$lu failed",
           opName.c_str(), opNumber);
     }
@@ -385,6 +483,7 @@ bool CGALHybridPolyhedron::meshBinOp(
     // union && difference assert triggered by testdata/scad/bugs/rotate-diff-nonmanifold-crash.scad and testdata/scad/bugs/issue204.scad
   } catch (const CGAL::Failure_exception& e) {
     success = false;
+    failure = "corefinement error";
     LOG(message_group::Warning,
         "[fast-csg] Corefinement %1$s #%2$lu failed with an error: %3$s\n", opName.c_str(), opNumber, e.what());
   }
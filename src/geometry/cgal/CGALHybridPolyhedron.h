@@ -1,6 +1,8 @@
 // Portions of this file are Copyright 2021 Google LLC, and licensed under GPL2+. See COPYING.
 #pragma once
 
+#include <map>
+#include <string>
 #include <variant>
 
 #include "cgal.h"
@@ -49,6 +51,14 @@ public:
   [[nodiscard]] size_t numVertices() const;
   [[nodiscard]] bool isManifold() const;
   [[nodiscard]] bool isValid() const;
+  /*! Whether any exact coordinate of the mesh takes more than maxBits. Nef
+   * polyhedra are always kept exact. */
+  [[nodiscard]] bool hasCoordinatesLargerThan(size_t maxBits) const;
+  /*! Rounds all coordinates of the mesh to doubles. Rounding can fold
+   * nearby faces into each other, so check isValidSolid() afterwards. */
+  void roundCoordinates();
+  /*! Whether this is a closed, valid triangle mesh without self-intersections. */
+  [[nodiscard]] bool isValidSolid() const;
   void clear();
 
   [[nodiscard]] size_t memsize() const override;
@@ -83,6 +93,10 @@ public:
   std::shared_ptr<CGAL_HybridNef> convertToNef();
   std::shared_ptr<CGAL_HybridMesh> convertToMesh();
 
+  /*! The number of boolean operations done with nef polyhedra instead of
+   * corefinement since the start, by reason. */
+  static std::map<std::string, size_t> fallbackCounts();
+
 private:
   // Old GCC versions used to build releases have object file limitations.
   // This conversion function could have been in the class but it requires knowledge
@@ -103,15 +117,30 @@ private:
    * the first one and potentially mutates (e.g. corefines) the second.
    * Returns false if the operation failed (e.g. because of shared edges), in
    * which case it may still have corefined the polyhedron, but it reverts the
-   * original nef if there was one. */
+   * original nef if there was one, and sets failure to the reason.
+   * If verify, the result must also be a valid closed mesh. */
   bool meshBinOp(
+    const std::string& opName, CGALHybridPolyhedron& other,
+    const std::function<bool(CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out)>& operation,
+    bool verify, const char *& failure);
+
+  /*! Runs the operation with meshBinOp() if the operands allow it, and else
+   * counts the reason the caller falls back to nefPolyBinOp(). */
+  bool corefine(
     const std::string& opName, CGALHybridPolyhedron& other,
     const std::function<bool(CGAL_HybridMesh& lhs, CGAL_HybridMesh& rhs, CGAL_HybridMesh& out)>& operation);
 
   [[nodiscard]] bool sharesAnyVertexWith(const CGALHybridPolyhedron& other) const;
 
+  /*! Whether both are meshes with disjoint bounding boxes, so that boolean
+   * operations need no corefinement, nor the spatial indices of both meshes
+   * it builds first. */
+  [[nodiscard]] bool isApartFrom(const CGALHybridPolyhedron& other) const;
+
   [[nodiscard]] bool canCorefineWith(const CGALHybridPolyhedron& other) const;
 
+  static void countFallback(const char *reason);
+
   /*! Returns the mesh if that's what's in the current data, or else nullptr.
    * Do NOT make this public. */
   [[nodiscard]] std::shared_ptr<CGAL_HybridMesh> getMesh() const;
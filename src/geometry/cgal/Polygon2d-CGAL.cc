@@ -1,4 +1,5 @@
 #include "Polygon2d.h"
+#include "Earcut.h"
 #include "PolySet.h"
 #include "printutils.h"
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
@@ -87,38 +88,36 @@ mark_domains(CDT& cdt)
 
 double Polygon2d::area() const
 {
-  const PolySet *p = tessellate();
-  if (p == nullptr) {
-    return 0;
-  }
+  return this->metadata.get(&Metadata::area, [this]() {
+    const std::unique_ptr<const PolySet> p(tessellate());
+    if (p == nullptr) {
+      return 0.0;
+    }
 
-  double area = 0.0;
-  for (const auto& poly : p->polygons) {
-    const auto& v1 = poly[0];
-    const auto& v2 = poly[1];
-    const auto& v3 = poly[2];
-    area += 0.5 * (
-      v1.x() * (v2.y() - v3.y())
-      + v2.x() * (v3.y() - v1.y())
-      + v3.x() * (v1.y() - v2.y()));
-  }
-  return area;
+    double area = 0.0;
+    for (const auto& poly : p->getPolygons()) {
+      const auto& v1 = poly[0];
+      const auto& v2 = poly[1];
+      const auto& v3 = poly[2];
+      area += 0.5 * (
+        v1.x() * (v2.y() - v3.y())
+        + v2.x() * (v3.y() - v1.y())
+        + v3.x() * (v1.y() - v2.y()));
+    }
+    return area;
+  });
 }
 
-/*!
-   Triangulates this polygon2d and returns a 2D-in-3D PolySet.
- */
-PolySet *Polygon2d::tessellate() const
-{
-  PRINTDB("Polygon2d::tessellate(): %d outlines", this->outlines().size());
-  auto polyset = new PolySet(*this);
+namespace Polygon2DCGAL {
 
-  Polygon2DCGAL::CDT cdt; // Uses a constrained Delaunay triangulator.
+bool triangulate(const Polygon2d& poly, VectorOfVector2d& triangles)
+{
+  CDT cdt; // Uses a constrained Delaunay triangulator.
 
   try {
 
     // Adds all vertices, and add all contours as constraints.
-    for (const auto& outline : this->outlines()) {
+    for (const auto& outline : poly.outlines()) {
       // Start with last point
       auto prev = cdt.insert({outline.vertices[outline.vertices.size() - 1][0], outline.vertices[outline.vertices.size() - 1][1]});
       for (const auto& v : outline.vertices) {
@@ -132,7 +131,7 @@ PolySet *Polygon2d::tessellate() const
 
   } catch (const CGAL::Precondition_exception& e) {
     LOG("CGAL error in Polygon2d::tesselate(): %1$s", e.what());
-    return nullptr;
+    return false;
   }
 
   // To extract triangles which is part of our polygon, we need to filter away
@@ -140,13 +139,47 @@ PolySet *Polygon2d::tessellate() const
   mark_domains(cdt);
   for (auto fit = cdt.finite_faces_begin(); fit != cdt.finite_faces_end(); ++fit) {
     if (fit->info().in_domain()) {
-      polyset->append_poly(3);
       for (int i = 0; i < 3; ++i) {
-        polyset->append_vertex(fit->vertex(i)->point()[0],
-                               fit->vertex(i)->point()[1],
-                               0);
+        triangles.emplace_back(fit->vertex(i)->point()[0], fit->vertex(i)->point()[1]);
       }
     }
   }
+  return true;
+}
+
+} // namespace Polygon2DCGAL
+
+/*!
+   Triangulates this polygon2d and returns a 2D-in-3D PolySet.
+
+   Sanitized polygons whose outlines with their holes are small enough are
+   triangulated by ear clipping, which is faster than the constrained Delaunay
+   triangulation for these. The triangles are kept for later calls.
+ */
+PolySet *Polygon2d::tessellate() const
+{
+  PRINTDB("Polygon2d::tessellate(): %d outlines", this->outlines().size());
+  // Ear clipping can take quadratic time, so large outlines use the CDT
+  constexpr size_t maxEarcutVertices = 512;
+
+  auto tris = std::atomic_load(&this->triangles);
+  if (!tris) {
+    auto computed = std::make_shared<VectorOfVector2d>();
+    if (!(this->sanitized && Earcut::triangulate(*this, maxEarcutVertices, *computed)) &&
+        !Polygon2DCGAL::triangulate(*this, *computed)) {
+      return nullptr;
+    }
+    tris = computed;
+    std::atomic_store(&this->triangles, tris);
+  }
+
+  auto polyset = new PolySet(*this);
+  polyset->reserve(tris->size() / 3);
+  for (size_t i = 0; i + 2 < tris->size(); i += 3) {
+    polyset->append_poly(3);
+    for (size_t j = i; j < i + 3; ++j) {
+      polyset->append_vertex((*tris)[j][0], (*tris)[j][1], 0);
+    }
+  }
   return polyset;
 }
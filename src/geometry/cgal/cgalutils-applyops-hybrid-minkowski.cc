@@ -9,6 +9,7 @@
 #include "printutils.h"
 #include "CGALHybridPolyhedron.h"
 #include "node.h"
+#include "progress.h"
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/normal_vector_newell_3.h>
@@ -107,6 +108,7 @@ shared_ptr<const Geometry> applyMinkowskiHybrid(const Geometry::Geometries& chil
 
       for (size_t i = 0; i < P[0].size(); ++i) {
         for (size_t j = 0; j < P[1].size(); ++j) {
+          progress_check();
           t.start();
           points[0].clear();
           points[1].clear();
@@ -28,21 +28,169 @@
 #include "memory.h"
 #include "Reindexer.h"
 #include "GeometryUtils.h"
+#include "GeometryCache.h"
+#include "GeometryDiskCache.h"
+#include "parallel.h"
 
+#include <algorithm>
+#include <chrono>
 #include <map>
 #include <queue>
 #include <unordered_set>
 
 namespace CGALUtils {
 
+namespace {
+
+using Hull_kernel = CGAL::Epick;
+using Hull_Points = std::vector<Hull_kernel::Point_3>;
+
+// A convex polyhedron as the half-spaces n.p <= d bounding it
+struct ConvexOperand {
+  std::vector<Vector3d> vertices;
+  std::vector<std::pair<Vector3d, Vector3d>> edges;
+  std::vector<std::pair<Vector3d, double>> planes;
+};
+
+ConvexOperand getConvexOperand(const PolySet& ps)
+{
+  ConvexOperand operand;
+  Reindexer<Vector3d> vertices;
+  for (const auto& polygon : ps.getPolygons()) {
+    Vector3d normal(0, 0, 0), center(0, 0, 0);
+    for (size_t i = 0; i < polygon.size(); ++i) {
+      const auto& v = polygon[i];
+      const auto& next = polygon[(i + 1) % polygon.size()];
+      vertices.lookup(v);
+      operand.edges.emplace_back(v, next);
+      normal += v.cross(next);
+      center += v;
+    }
+    if (polygon.size() < 3 || normal.norm() == 0) continue;
+    normal.normalize();
+    operand.planes.emplace_back(normal, normal.dot(center / polygon.size()));
+  }
+  operand.vertices = vertices.getArray();
+  return operand;
+}
+
+bool isInside(const Vector3d& p, const ConvexOperand& operand, double eps)
+{
+  return std::all_of(operand.planes.begin(), operand.planes.end(), [&](const auto& plane) {
+    return plane.first.dot(p) - plane.second <= eps;
+  });
+}
+
+/*!
+   Intersects two convex PolySets without building Nef polyhedra. Each vertex
+   of the intersection is a vertex of one operand inside the other, or where
+   an edge of one operand crosses a face of the other, so the result is the
+   hull of these points. Returns an empty PolySet if the operands don't share
+   any volume.
+ */
+shared_ptr<const PolySet> intersectConvex(const PolySet& a, const PolySet& b)
+{
+  const ConvexOperand operands[] = {getConvexOperand(a), getConvexOperand(b)};
+  BoundingBox bbox = a.getBoundingBox();
+  bbox.extend(b.getBoundingBox());
+  const double eps = 1e-9 * std::max(1.0, bbox.sizes().maxCoeff());
+
+  Hull_Points points;
+  for (int i = 0; i < 2; ++i) {
+    const auto& operand = operands[i];
+    const auto& other = operands[1 - i];
+    for (const auto& v : operand.vertices) {
+      if (isInside(v, other, eps)) points.emplace_back(v[0], v[1], v[2]);
+    }
+    for (const auto& edge : operand.edges) {
+      for (const auto& plane : other.planes) {
+        const double d0 = plane.first.dot(edge.first) - plane.second;
+        const double d1 = plane.first.dot(edge.second) - plane.second;
+        if ((d0 < -eps && d1 > eps) || (d0 > eps && d1 < -eps)) {
+          const Vector3d p = edge.first + (edge.second - edge.first) * (d0 / (d0 - d1));
+          if (isInside(p, other, eps)) points.emplace_back(p[0], p[1], p[2]);
+        }
+      }
+    }
+  }
+
+  auto result = make_shared<PolySet>(3, /* convex */ true);
+  // Lower dimensional intersections have no volume
+  auto it = points.begin();
+  if (it == points.end()) return result;
+  const auto p0 = *it;
+  it = std::find_if(it, points.end(), [&](const auto& p) { return p != p0; });
+  if (it == points.end()) return result;
+  const auto p1 = *it;
+  it = std::find_if(it, points.end(), [&](const auto& p) { return !CGAL::collinear(p0, p1, p); });
+  if (it == points.end()) return result;
+  const auto p2 = *it;
+  if (std::all_of(it, points.end(), [&](const auto& p) { return CGAL::coplanar(p0, p1, p2, p); })) return result;
+
+  CGAL::Polyhedron_3<Hull_kernel> r;
+  CGAL::convex_hull_3(points.begin(), points.end(), r);
+  if (!r.is_closed() || createPolySetFromPolyhedron(r, *result)) return {};
+  return result;
+}
+
+/*!
+   Intersects the convex non-empty PolySet children and replaces them by
+   their intersection, if there are at least two of them. Pairs are
+   intersected in parallel, halving the operands with each round. Returns
+   false if the intersection is empty, in which case the whole intersection is.
+ */
+bool intersectConvexChildren(Geometry::Geometries& children)
+{
+  std::vector<Geometry::Geometries::iterator> convex;
+  std::vector<shared_ptr<const PolySet>> operands;
+  for (auto it = children.begin(); it != children.end(); ++it) {
+    auto ps = dynamic_pointer_cast<const PolySet>(it->second);
+    if (ps && !ps->isEmpty() && ps->is_convex()) {
+      convex.push_back(it);
+      operands.push_back(ps);
+    }
+  }
+  if (operands.size() < 2) return true;
+
+  while (operands.size() > 1) {
+    progress_check();
+    std::vector<size_t> pairs(operands.size() / 2);
+    for (size_t i = 0; i < pairs.size(); ++i) pairs[i] = 2 * i;
+    std::vector<shared_ptr<const PolySet>> results(pairs.size());
+    parallelizable_transform(pairs.begin(), pairs.end(), results.begin(), [&operands](size_t i) {
+      try {
+        return intersectConvex(*operands[i], *operands[i + 1]);
+      } catch (const CGAL::Failure_exception&) {
+        return shared_ptr<const PolySet>();
+      }
+    });
+    for (const auto& result : results) {
+      // Keep the Nef results if a hull failed
+      if (!result) return true;
+      if (result->isEmpty()) return false;
+    }
+    if (operands.size() % 2) results.push_back(operands.back());
+    operands = std::move(results);
+  }
+
+  for (const auto& it : convex) {
+    if (it->first) it->first->progress_report();
+    children.erase(it);
+  }
+  children.emplace_front(nullptr, operands.front());
+  return true;
+}
+
+} // namespace
+
 /*!
    Applies op to all children and returns the result.
    The child list should be guaranteed to contain non-NULL 3D or empty Geometry objects
  */
-shared_ptr<const Geometry> applyOperator3D(const Geometry::Geometries& children, OpenSCADOperator op)
+shared_ptr<const Geometry> applyOperator3D(const Geometry::Geometries& operands, OpenSCADOperator op)
 {
   if (Feature::ExperimentalFastCsg.is_enabled()) {
-    return applyOperator3DHybrid(children, op);
+    return applyOperator3DHybrid(operands, op);
   }
 
   CGAL_Nef_polyhedron *N = nullptr;
@@ -50,8 +198,16 @@ shared_ptr<const Geometry> applyOperator3D(const Geometry::Geometries& children,
   assert(op != OpenSCADOperator::UNION && "use applyUnion3D() instead of applyOperator3D()");
   bool foundFirst = false;
 
+  // Convex operands of intersections don't need Nef polyhedra
+  Geometry::Geometries children = operands;
+  if (op == OpenSCADOperator::INTERSECTION) {
+    if (!intersectConvexChildren(children)) return nullptr;
+    if (children.size() == 1) return children.front().second;
+  }
+
   try {
     for (const auto& item : children) {
+      progress_check();
       const shared_ptr<const Geometry>& chgeom = item.second;
       auto chN = getNefPolyhedronFromGeometry(chgeom);
 
@@ -107,8 +263,16 @@ shared_ptr<const Geometry> applyOperator3D(const Geometry::Geometries& children,
   return shared_ptr<Geometry>(N);
 }
 
+// Time between checkpoints of a union's intermediate results
+constexpr auto unionCheckpointInterval = std::chrono::seconds(60);
+
+/*!
+   With a checkpoint key and the disk cache enabled, the remaining operands
+   are stored there periodically, and a union interrupted before finishing
+   resumes from the last stored state.
+ */
 shared_ptr<const Geometry> applyUnion3D(
-  Geometry::Geometries::iterator chbegin, Geometry::Geometries::iterator chend)
+  Geometry::Geometries::iterator chbegin, Geometry::Geometries::iterator chend, const Hash128 *checkpoint)
 {
   if (Feature::ExperimentalFastCsg.is_enabled()) {
     return applyUnion3DHybrid(chbegin, chend);
@@ -126,9 +290,19 @@ shared_ptr<const Geometry> applyUnion3D(
   };
   std::priority_queue<QueueConstItem, std::vector<QueueConstItem>, QueueItemGreater> q;
 
+  auto diskcache = GeometryDiskCache::instance();
+  if (!diskcache->isEnabled()) checkpoint = nullptr;
+
   try {
+    if (checkpoint) {
+      for (const auto& part : diskcache->getParts(*checkpoint)) {
+        auto N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(part);
+        if (N && !N->isEmpty()) q.emplace(N, -1);
+      }
+      if (!q.empty()) LOG("Resuming union of %1$d objects from checkpoint", q.size());
+    }
     // sort children by fewest faces
-    for (auto it = chbegin; it != chend; ++it) {
+    for (auto it = chbegin; q.empty() && it != chend; ++it) {
       auto curChild = getNefPolyhedronFromGeometry(it->second);
       if (curChild && !curChild->isEmpty()) {
         int node_mark = -1;
@@ -140,6 +314,7 @@ shared_ptr<const Geometry> applyUnion3D(
     }
 
     progress_tick();
+    auto lastcheckpoint = std::chrono::steady_clock::now();
     while (q.size() > 1) {
       auto p1 = q.top();
       q.pop();
@@ -147,7 +322,15 @@ shared_ptr<const Geometry> applyUnion3D(
       q.pop();
       q.emplace(make_shared<const CGAL_Nef_polyhedron>(*p1.first + *p2.first), -1);
       progress_tick();
+
+      if (checkpoint && q.size() > 1 && std::chrono::steady_clock::now() - lastcheckpoint >= unionCheckpointInterval) {
+        std::vector<shared_ptr<const Geometry>> parts;
+        for (auto copy = q; !copy.empty(); copy.pop()) parts.push_back(copy.top().first);
+        diskcache->insertParts(*checkpoint, parts);
+        lastcheckpoint = std::chrono::steady_clock::now();
+      }
     }
+    if (checkpoint) diskcache->erase(*checkpoint);
 
     if (q.size() == 1) {
       return shared_ptr<const Geometry>(new CGAL_Nef_polyhedron(q.top().first->p3));
@@ -162,75 +345,282 @@ shared_ptr<const Geometry> applyUnion3D(
 
 
 
-bool applyHull(const Geometry::Geometries& children, PolySet& result)
+namespace {
+
+// Fewest parts worth uniting on a separate thread
+constexpr size_t minimumPartsPerRun = 4;
+
+Hull_Points getPartPoints(const PolySet& part)
 {
-  using K = CGAL::Epick;
-  // Collect point cloud
-  Reindexer<K::Point_3> reindexer;
+  Reindexer<Vector3d> vertices;
+  for (const auto& polygon : part.getPolygons()) {
+    for (const auto& v : polygon) vertices.lookup(v);
+  }
+  Hull_Points points;
+  points.reserve(vertices.size());
+  for (const auto& v : vertices.getArray()) points.emplace_back(v[0], v[1], v[2]);
+  return points;
+}
 
-  auto addCapacity = [&](const auto n) {
-    reindexer.reserve(reindexer.size() + n);
-  };
+Hull_Points getPartPoints(const CGAL_Polyhedron& poly)
+{
+  CGAL::Cartesian_converter<CGAL_Kernel3, Hull_kernel> conv;
+  Hull_Points points;
+  points.reserve(poly.size_of_vertices());
+  for (auto pi = poly.vertices_begin(); pi != poly.vertices_end(); ++pi) {
+    points.push_back(conv(pi->point()));
+  }
+  return points;
+}
+
+std::vector<Hull_Points> getPartPoints(const GeometryList& parts)
+{
+  std::vector<Hull_Points> points;
+  points.reserve(parts.getChildren().size());
+  for (const auto& part : parts.getChildren()) {
+    points.push_back(getPartPoints(static_cast<const PolySet&>(*part.second)));
+  }
+  return points;
+}
+
+// Children with fewer distinct vertices go straight into the final hull
+constexpr size_t minimumPointsForChildHull = 64;
 
+// Distinct vertices of a 3D geometry
+Hull_Points getHullInputPoints(const Geometry& geom)
+{
+  Reindexer<Hull_kernel::Point_3> reindexer;
   auto addPoint = [&](const auto& v) {
-    reindexer.lookup(v);
+    reindexer.lookup(vector_convert<Hull_kernel::Point_3>(v));
   };
-
-  for (const auto& item : children) {
-    auto& chgeom = item.second;
-    if (const auto *N = dynamic_cast<const CGAL_Nef_polyhedron*>(chgeom.get())) {
-      if (!N->isEmpty()) {
-        addCapacity(N->p3->number_of_vertices());
-        for (CGAL_Nef_polyhedron3::Vertex_const_iterator i = N->p3->vertices_begin(); i != N->p3->vertices_end(); ++i) {
-          addPoint(vector_convert<K::Point_3>(i->point()));
-        }
+  if (const auto *N = dynamic_cast<const CGAL_Nef_polyhedron *>(&geom)) {
+    if (!N->isEmpty()) {
+      reindexer.reserve(N->p3->number_of_vertices());
+      for (CGAL_Nef_polyhedron3::Vertex_const_iterator i = N->p3->vertices_begin(); i != N->p3->vertices_end(); ++i) {
+        addPoint(i->point());
       }
-    } else if (const auto *hybrid = dynamic_cast<const CGALHybridPolyhedron*>(chgeom.get())) {
-      addCapacity(hybrid->numVertices());
-      hybrid->foreachVertexUntilTrue([&](auto& p) {
-          addPoint(vector_convert<K::Point_3>(p));
-          return false;
-        });
+    }
+  } else if (const auto *hybrid = dynamic_cast<const CGALHybridPolyhedron *>(&geom)) {
+    reindexer.reserve(hybrid->numVertices());
+    hybrid->foreachVertexUntilTrue([&](auto& p) {
+        addPoint(p);
+        return false;
+      });
 #ifdef ENABLE_MANIFOLD
-    } else if (const auto *mani = dynamic_cast<const ManifoldGeometry*>(chgeom.get())) {
-      addCapacity(mani->numVertices());
-      mani->foreachVertexUntilTrue([&](auto& p) {
-          addPoint(vector_convert<K::Point_3>(p));
-          return false;
-        });
+  } else if (const auto *mani = dynamic_cast<const ManifoldGeometry *>(&geom)) {
+    reindexer.reserve(mani->numVertices());
+    mani->foreachVertexUntilTrue([&](auto& p) {
+        addPoint(p);
+        return false;
+      });
 #endif
-    } else if (const auto *ps = dynamic_cast<const PolySet*>(chgeom.get())) {
-      addCapacity(ps->polygons.size() * 3);
-      for (const auto& p : ps->polygons) {
-        for (const auto& v : p) {
-          addPoint(vector_convert<K::Point_3>(v));
-        }
-      }
+  } else if (const auto *ps = dynamic_cast<const PolySet *>(&geom)) {
+    reindexer.reserve(ps->getPolygons().size() * 3);
+    for (const auto& p : ps->getPolygons()) {
+      for (const auto& v : p) addPoint(v);
     }
   }
+  return reindexer.getArray();
+}
+
+struct ChildHull {
+  Hull_Points points;
+  shared_ptr<const PolySet> hull; // Set once the child was hulled on its own
+  bool worthHulling{false};
+};
+
+/*!
+   Returns what a hull() child contributes to the hull. Convex children and
+   small ones contribute all their vertices, larger ones only the vertices of
+   their own hull, see hullChild(). Hulls of children are kept in the
+   GeometryCache, as chained hulls often share children with their neighbours.
+ */
+ChildHull getChildHullInput(const shared_ptr<const Geometry>& geom)
+{
+  if (auto hull = dynamic_pointer_cast<const PolySet>(
+        GeometryCache::instance()->getConversion(geom, GeometryCache::Conversion::Hull))) {
+    return {getPartPoints(*hull), hull};
+  }
+  ChildHull child{getHullInputPoints(*geom)};
+  const auto *ps = dynamic_cast<const PolySet *>(geom.get());
+  if (!(ps && ps->convexValue())) child.worthHulling = child.points.size() >= minimumPointsForChildHull;
+  return child;
+}
+
+// Only uses the inexact kernel, so children can be hulled concurrently
+ChildHull hullChild(const ChildHull& child)
+{
+  if (!child.worthHulling) return child;
+  try {
+    CGAL::Polyhedron_3<Hull_kernel> r;
+    CGAL::convex_hull_3(child.points.begin(), child.points.end(), r);
+    auto hull = make_shared<PolySet>(3, /* convex */ true);
+    if (createPolySetFromPolyhedron(r, *hull)) return child;
+    ChildHull result{{}, hull};
+    result.points.reserve(r.size_of_vertices());
+    for (auto v = r.vertices_begin(); v != r.vertices_end(); ++v) result.points.push_back(v->point());
+    return result;
+  } catch (const CGAL::Failure_exception&) {
+    // Keep all vertices, the final hull reports the error if it persists
+    return child;
+  }
+}
 
-  const auto &points = reindexer.getArray();
+/*!
+   Returns the vertices of the convex parts of a Minkowski operand.
+   Decompositions of non-convex operands are kept in the GeometryCache, as
+   the same rounding tool is often summed with many different objects.
+ */
+std::vector<Hull_Points> getConvexPartPoints(const shared_ptr<const Geometry>& operand, size_t i)
+{
+  auto cache = GeometryCache::instance();
+  if (auto parts = cache->getConversion(operand, GeometryCache::Conversion::ConvexParts)) {
+    PRINTDB("Minkowski: child %d was decomposed before", i);
+    return getPartPoints(static_cast<const GeometryList&>(*parts));
+  }
+
+  CGAL_Polyhedron poly;
+
+  auto ps = dynamic_pointer_cast<const PolySet>(operand);
+  auto nef = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(operand);
+
+  if (!nef) {
+    nef = CGALUtils::getNefPolyhedronFromGeometry(operand);
+  }
+
+  if (ps) CGALUtils::createPolyhedronFromPolySet(*ps, poly);
+  else if (nef && nef->p3->is_simple()) CGALUtils::convertNefToPolyhedron(*nef->p3, poly);
+  else throw 0;
+
+  if ((ps && ps->is_convex()) ||
+      (!ps && CGALUtils::is_weakly_convex(poly))) {
+    PRINTDB("Minkowski: child %d is convex and %s", i % (ps?"PolySet":"Nef"));
+    return {getPartPoints(poly)};
+  }
+
+  CGAL_Nef_polyhedron3 decomposed_nef;
+
+  if (ps) {
+    PRINTDB("Minkowski: child %d is nonconvex PolySet, transforming to Nef and decomposing...", i);
+    if (nef && !nef->isEmpty()) decomposed_nef = *nef->p3;
+  } else {
+    PRINTDB("Minkowski: child %d is nonconvex Nef, decomposing...", i);
+    decomposed_nef = *nef->p3;
+  }
+
+  CGAL::Timer t;
+  t.start();
+  CGAL::convex_decomposition_3(decomposed_nef);
+
+  Geometry::Geometries parts;
+  // the first volume is the outer volume, which ignored in the decomposition
+  CGAL_Nef_polyhedron3::Volume_const_iterator ci = ++decomposed_nef.volumes_begin();
+  for (; ci != decomposed_nef.volumes_end(); ++ci) {
+    if (ci->mark()) {
+      CGAL_Polyhedron part;
+      decomposed_nef.convert_inner_shell_to_polyhedron(ci->shells_begin(), part);
+      auto *part_ps = new PolySet(3, /* convex= */ true);
+      CGALUtils::createPolySetFromPolyhedron(part, *part_ps);
+      parts.emplace_back(std::shared_ptr<const AbstractNode>(), shared_ptr<const Geometry>(part_ps));
+    }
+  }
+
+  PRINTDB("Minkowski: decomposed into %d convex parts", parts.size());
+  t.stop();
+  PRINTDB("Minkowski: decomposition took %f s", t.time());
+
+  auto decomposition = make_shared<const GeometryList>(parts);
+  cache->insertConversion(operand, GeometryCache::Conversion::ConvexParts, decomposition);
+  return getPartPoints(*decomposition);
+}
+
+/*!
+   Unites the convex parts of a Minkowski sum. When running in parallel,
+   runs of consecutive parts are united concurrently before their results.
+ */
+shared_ptr<const Geometry> applyUnionOfParts(const std::vector<shared_ptr<const Geometry>>& parts)
+{
+  size_t runs = 1;
+#ifdef ENABLE_TBB
+  if (parallel_enabled()) {
+    runs = std::max<size_t>(1, std::min<size_t>(parallel_threads(), parts.size() / minimumPartsPerRun));
+  }
+#endif
+  std::vector<Geometry::Geometries> run_children(runs);
+  for (size_t i = 0; i < parts.size(); ++i) {
+    run_children[i * runs / parts.size()].emplace_back(std::shared_ptr<const AbstractNode>(), parts[i]);
+  }
+  if (runs == 1) return CGALUtils::applyUnion3D(run_children[0].begin(), run_children[0].end());
+
+  std::vector<shared_ptr<const Geometry>> run_results(runs);
+  parallelizable_transform(run_children.begin(), run_children.end(), run_results.begin(), [](const Geometry::Geometries& children) {
+      auto run = children;
+      return CGALUtils::applyUnion3D(run.begin(), run.end());
+    });
+  Geometry::Geometries fake_children;
+  for (const auto& result : run_results) {
+    if (!result) return nullptr;
+    fake_children.emplace_back(std::shared_ptr<const AbstractNode>(), result);
+  }
+  return CGALUtils::applyUnion3D(fake_children.begin(), fake_children.end());
+}
+
+} // namespace
+
+/*!
+   Hulls the children, each of which may first be hulled on its own, see
+   getChildHullInput(). Those hulls are found in parallel.
+ */
+bool applyHull(const Geometry::Geometries& children, PolySet& result)
+{
+  // Exact vertices are read on this thread, as lazy exact numbers may be shared
+  std::vector<ChildHull> inputs;
+  inputs.reserve(children.size());
+  for (const auto& item : children) inputs.push_back(getChildHullInput(item.second));
+  std::vector<ChildHull> child_hulls(inputs.size());
+  parallelizable_transform(inputs.begin(), inputs.end(), child_hulls.begin(), [](const ChildHull& child) {
+      return hullChild(child);
+    });
+  auto cache = GeometryCache::instance();
+  auto item = children.begin();
+  for (size_t i = 0; i < inputs.size(); ++i, ++item) {
+    if (inputs[i].worthHulling && child_hulls[i].hull) {
+      cache->insertConversion(item->second, GeometryCache::Conversion::Hull, child_hulls[i].hull);
+    }
+  }
+
+  // A single child's hull is the result
+  if (child_hulls.size() == 1 && child_hulls.front().hull) {
+    result.append(*child_hulls.front().hull);
+    return true;
+  }
+
+  // Collect point cloud
+  Reindexer<Hull_kernel::Point_3> reindexer;
+  for (const auto& child : child_hulls) {
+    reindexer.reserve(reindexer.size() + child.points.size());
+    for (const auto& p : child.points) reindexer.lookup(p);
+  }
+
+  const auto& points = reindexer.getArray();
   if (points.size() <= 3) return false;
 
   // Apply hull
   bool success = false;
-  if (points.size() >= 4) {
-    try {
-      CGAL::Polyhedron_3<K> r;
-      CGAL::convex_hull_3(points.begin(), points.end(), r);
-      PRINTDB("After hull vertices: %d", r.size_of_vertices());
-      PRINTDB("After hull facets: %d", r.size_of_facets());
-      PRINTDB("After hull closed: %d", r.is_closed());
-      PRINTDB("After hull valid: %d", r.is_valid());
-      success = !createPolySetFromPolyhedron(r, result);
-    } catch (const CGAL::Failure_exception& e) {
-      LOG(message_group::Error, "CGAL error in applyHull(): %1$s", e.what());
-    }
+  try {
+    CGAL::Polyhedron_3<Hull_kernel> r;
+    CGAL::convex_hull_3(points.begin(), points.end(), r);
+    PRINTDB("After hull vertices: %d", r.size_of_vertices());
+    PRINTDB("After hull facets: %d", r.size_of_facets());
+    PRINTDB("After hull closed: %d", r.is_closed());
+    PRINTDB("After hull valid: %d", r.is_valid());
+    success = !createPolySetFromPolyhedron(r, result);
+  } catch (const CGAL::Failure_exception& e) {
+    LOG(message_group::Error, "CGAL error in applyHull(): %1$s", e.what());
   }
   return success;
 }
 
-
 /*!
    children cannot contain nullptr objects
  */
@@ -251,103 +641,34 @@ shared_ptr<const Geometry> applyMinkowski(const Geometry::Geometries& children)
   shared_ptr<const Geometry> operands[2] = {it->second, shared_ptr<const Geometry>()};
   try {
     while (++it != children.end()) {
+      progress_check();
       operands[1] = it->second;
 
-      using Hull_kernel = CGAL::Epick;
-
-      std::list<CGAL_Polyhedron> P[2];
-      std::list<CGAL::Polyhedron_3<Hull_kernel>> result_parts;
-
+      std::vector<Hull_Points> P[2];
       for (size_t i = 0; i < 2; ++i) {
-        CGAL_Polyhedron poly;
-
-        auto ps = dynamic_pointer_cast<const PolySet>(operands[i]);
-        auto nef = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(operands[i]);
-
-        if (!nef) {
-          nef = CGALUtils::getNefPolyhedronFromGeometry(operands[i]);
-        }
-
-        if (ps) CGALUtils::createPolyhedronFromPolySet(*ps, poly);
-        else if (nef && nef->p3->is_simple()) CGALUtils::convertNefToPolyhedron(*nef->p3, poly);
-        else throw 0;
-
-        if ((ps && ps->is_convex()) ||
-            (!ps && is_weakly_convex(poly))) {
-          PRINTDB("Minkowski: child %d is convex and %s", i % (ps?"PolySet":"Nef"));
-          P[i].push_back(poly);
-        } else {
-          CGAL_Nef_polyhedron3 decomposed_nef;
-
-          if (ps) {
-            PRINTDB("Minkowski: child %d is nonconvex PolySet, transforming to Nef and decomposing...", i);
-            auto p = getNefPolyhedronFromGeometry(ps);
-            if (p && !p->isEmpty()) decomposed_nef = *p->p3;
-          } else {
-            PRINTDB("Minkowski: child %d is nonconvex Nef, decomposing...", i);
-            decomposed_nef = *nef->p3;
-          }
-
-          t.start();
-          CGAL::convex_decomposition_3(decomposed_nef);
-
-          // the first volume is the outer volume, which ignored in the decomposition
-          CGAL_Nef_polyhedron3::Volume_const_iterator ci = ++decomposed_nef.volumes_begin();
-          for (; ci != decomposed_nef.volumes_end(); ++ci) {
-            if (ci->mark()) {
-              CGAL_Polyhedron poly;
-              decomposed_nef.convert_inner_shell_to_polyhedron(ci->shells_begin(), poly);
-              P[i].push_back(poly);
-            }
-          }
-
-
-          PRINTDB("Minkowski: decomposed into %d convex parts", P[i].size());
-          t.stop();
-          PRINTDB("Minkowski: decomposition took %f s", t.time());
-        }
+        P[i] = getConvexPartPoints(operands[i], i);
       }
 
-      std::vector<Hull_kernel::Point_3> points[2];
-      std::vector<Hull_kernel::Point_3> minkowski_points;
+      auto combineParts = [&](const Hull_Points& points0, const Hull_Points& points1) -> shared_ptr<const Geometry> {
+          CGAL::Timer t;
 
-      CGAL::Cartesian_converter<CGAL_Kernel3, Hull_kernel> conv;
-
-      for (size_t i = 0; i < P[0].size(); ++i) {
-        for (size_t j = 0; j < P[1].size(); ++j) {
           t.start();
-          points[0].clear();
-          points[1].clear();
-
-          for (int k = 0; k < 2; ++k) {
-            auto it = P[k].begin();
-            std::advance(it, k == 0?i:j);
-
-            CGAL_Polyhedron const& poly = *it;
-            points[k].reserve(poly.size_of_vertices());
-
-            for (CGAL_Polyhedron::Vertex_const_iterator pi = poly.vertices_begin(); pi != poly.vertices_end(); ++pi) {
-              CGAL_Polyhedron::Point_3 const& p = pi->point();
-              points[k].push_back(conv(p));
-            }
-          }
-
-          minkowski_points.clear();
-          minkowski_points.reserve(points[0].size() * points[1].size());
-          for (size_t i = 0; i < points[0].size(); ++i) {
-            for (size_t j = 0; j < points[1].size(); ++j) {
-              minkowski_points.push_back(points[0][i] + (points[1][j] - CGAL::ORIGIN));
+          std::vector<Hull_kernel::Point_3> minkowski_points;
+          minkowski_points.reserve(points0.size() * points1.size());
+          for (size_t i = 0; i < points0.size(); ++i) {
+            for (size_t j = 0; j < points1.size(); ++j) {
+              minkowski_points.push_back(points0[i] + (points1[j] - CGAL::ORIGIN));
             }
           }
 
           if (minkowski_points.size() <= 3) {
             t.stop();
-            continue;
+            return nullptr;
           }
 
           CGAL::Polyhedron_3<Hull_kernel> result;
           t.stop();
-          PRINTDB("Minkowski: Point cloud creation (%d ⨉ %d -> %d) took %f ms", points[0].size() % points[1].size() % minkowski_points.size() % (t.time() * 1000));
+          PRINTDB("Minkowski: Point cloud creation (%d ⨉ %d -> %d) took %f ms", points0.size() % points1.size() % minkowski_points.size() % (t.time() * 1000));
           t.reset();
 
           t.start();
@@ -399,29 +720,23 @@ shared_ptr<const Geometry> applyMinkowski(const Geometry::Geometries& children)
           PRINTDB("Minkowski: Computing convex hull took %f s", t.time());
           t.reset();
 
-          result_parts.push_back(result);
-        }
-      }
-
-      if (it != std::next(children.begin())) operands[0].reset();
-
-      auto partToGeom = [&](auto& poly) -> shared_ptr<const Geometry> {
           auto *ps = new PolySet(3, /* convex= */ true);
-          createPolySetFromPolyhedron(poly, *ps);
+          createPolySetFromPolyhedron(result, *ps);
           return shared_ptr<const Geometry>(ps);
         };
 
+      std::vector<shared_ptr<const Geometry>> result_parts(P[0].size() * P[1].size());
+      parallelizable_cross_product_transform(P[0], P[1], result_parts.begin(), combineParts);
+      result_parts.erase(std::remove(result_parts.begin(), result_parts.end(), nullptr), result_parts.end());
+
+      if (it != std::next(children.begin())) operands[0].reset();
+
       if (result_parts.size() == 1) {
-        operands[0] = partToGeom(*result_parts.begin());
+        operands[0] = result_parts.front();
       } else if (!result_parts.empty()) {
         t.start();
         PRINTDB("Minkowski: Computing union of %d parts", result_parts.size());
-        Geometry::Geometries fake_children;
-        for (const auto& part : result_parts) {
-          fake_children.push_back(std::make_pair(std::shared_ptr<const AbstractNode>(),
-                                                 partToGeom(part)));
-        }
-        auto N = CGALUtils::applyUnion3D(fake_children.begin(), fake_children.end());
+        auto N = applyUnionOfParts(result_parts);
         // FIXME: This should really never throw.
         // Assert once we figured out what went wrong with issue #1069?
         if (!N) throw 0;
@@ -438,6 +753,8 @@ shared_ptr<const Geometry> applyMinkowski(const Geometry::Geometries& children)
     PRINTDB("Minkowski: Total execution time %f s", t_tot.time());
     t_tot.reset();
     return operands[0];
+  } catch (const ProgressCancelException&) {
+    throw;
   } catch (...) {
     // If anything throws we simply fall back to Nef Minkowski
     PRINTD("Minkowski: Falling back to Nef Minkowski");
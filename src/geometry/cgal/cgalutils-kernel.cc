@@ -2,6 +2,9 @@
 #include "cgalutils.h"
 #include <CGAL/Cartesian_converter.h>
 #include <CGAL/gmpxx.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace CGALUtils {
 
@@ -55,4 +58,23 @@ CGAL::Gmpq KernelConverter<CGAL_HybridKernel3, CGAL_Kernel3>::operator()(
   return {CGAL::Gmpz(e.get_num().get_mpz_t()), CGAL::Gmpz(e.get_den().get_mpz_t())};
 }
 
+size_t exactBits(const CGAL::Gmpq& n)
+{
+  return mpz_sizeinbase(n.numerator().mpz(), 2) + mpz_sizeinbase(n.denominator().mpz(), 2);
+}
+
+bool hasLargeExactValue(const CGAL_HybridKernel3::FT& n, size_t maxBits)
+{
+  // Forcing the exact value of a lazy number evaluates its whole expression
+  // DAG, so settle for the interval whenever it pins the value down to a few
+  // ulps: rounding can't get it any closer to a double.
+  const auto interval = CGAL::to_interval(n);
+  const double magnitude = std::max(std::abs(interval.first), std::abs(interval.second));
+  if (interval.second - interval.first <= 4 * std::numeric_limits<double>::epsilon() * magnitude) {
+    return false;
+  }
+  const auto& e = CGAL::exact(n);
+  return mpz_sizeinbase(e.get_num_mpz_t(), 2) + mpz_sizeinbase(e.get_den_mpz_t(), 2) > maxBits;
+}
+
 } // namespace CGALUtils
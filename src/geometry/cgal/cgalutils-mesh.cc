@@ -25,7 +25,7 @@ bool createMeshFromPolySet(const PolySet& ps, TriangleMesh& mesh)
 
   std::unordered_map<Vector3d, vertex_descriptor> indices;
 
-  for (const auto& p : ps.polygons) {
+  for (const auto& p : ps.getPolygons()) {
     polygon.clear();
     for (auto& v : p) {
       auto size_before = indices.size();
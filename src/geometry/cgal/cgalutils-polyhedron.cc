@@ -46,7 +46,7 @@ public:
     std::vector<std::vector<size_t>> indices;
 
     // Align all vertices to grid and build vertex array in vertices
-    for (const auto& p : ps.polygons) {
+    for (const auto& p : ps.getPolygons()) {
       indices.emplace_back();
       indices.back().reserve(p.size());
       for (auto v : boost::adaptors::reverse(p)) {
@@ -64,7 +64,7 @@ public:
     printf("polyhedron(faces=[");
     int pidx = 0;
 #endif
-    B.begin_surface(vertices.size(), ps.polygons.size());
+    B.begin_surface(vertices.size(), ps.getPolygons().size());
     for (const auto& p : vertices) {
       B.add_vertex(p);
     }
@@ -114,12 +114,12 @@ public:
     std::vector<size_t> indices(3);
 
     // Estimating same # of vertices as polygons (very rough)
-    B.begin_surface(ps.polygons.size(), ps.polygons.size());
+    B.begin_surface(ps.getPolygons().size(), ps.getPolygons().size());
     int pidx = 0;
 #ifdef GEN_SURFACE_DEBUG
     printf("polyhedron(faces=[");
 #endif
-    for (const auto& p : ps.polygons) {
+    for (const auto& p : ps.getPolygons()) {
 #ifdef GEN_SURFACE_DEBUG
       if (pidx++ > 0) printf(",");
 #endif
@@ -1,5 +1,6 @@
 #include "cgalutils.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 //#include "cgal.h"
 //#include "tess.h"
 
@@ -87,6 +88,7 @@ bool tessellatePolygonWithHoles(const PolyholeK& polygons,
                                 Polygons& triangles,
                                 const K::Vector_3 *normal)
 {
+  TimingCounters::Scope timer(TimingCounters::TESSELLATION);
   // No polygon. FIXME: Will this ever happen or can we assert here?
   if (polygons.empty()) return false;
 
@@ -139,6 +141,7 @@ bool tessellatePolygon(const PolygonK& polygon,
                        Polygons& triangles,
                        const K::Vector_3 *normal)
 {
+  TimingCounters::Scope timer(TimingCounters::TESSELLATION);
   if (polygon.size() == 3) {
     PRINTD("input polygon has 3 points. shortcut tessellation.");
     Polygon t;
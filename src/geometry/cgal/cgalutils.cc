@@ -7,6 +7,7 @@
 #include "cgalutils.h"
 #include "PolySet.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 #include "Polygon2d.h"
 #include "PolySetUtils.h"
 #include "node.h"
@@ -24,6 +25,7 @@
 
 #include "Reindexer.h"
 #include "GeometryUtils.h"
+#include "GeometryCache.h"
 #include "CGALHybridPolyhedron.h"
 #ifdef ENABLE_MANIFOLD
 #include "ManifoldGeometry.h"
@@ -37,6 +39,7 @@ namespace CGALUtils {
 
 CGAL_Nef_polyhedron *createNefPolyhedronFromPolySet(const PolySet& ps)
 {
+  TimingCounters::Scope timer(TimingCounters::NEF_CONVERSION);
   if (ps.isEmpty()) return new CGAL_Nef_polyhedron();
   assert(ps.getDimension() == 3);
 
@@ -105,6 +108,43 @@ CGAL_Nef_polyhedron *createNefPolyhedronFromPolySet(const PolySet& ps)
   return new CGAL_Nef_polyhedron(N);
 }
 
+/*!
+   Rounds the coordinates of a Nef polyhedron or fast-csg mesh to doubles once
+   their exact numbers take more than maxExactBits, so they don't keep growing
+   through long chains of boolean operations. The geometry is returned as is
+   if it has no such coordinates, or can't be rounded while staying closed.
+ */
+shared_ptr<const Geometry> roundExactCoordinates(const shared_ptr<const Geometry>& geom)
+{
+  constexpr size_t maxExactBits = 256;
+  if (const auto N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
+    if (!N->p3) return geom;
+    bool large = false;
+    for (auto vi = N->p3->vertices_begin(); vi != N->p3->vertices_end() && !large; ++vi) {
+      const auto& p = vi->point();
+      large = exactBits(p.x()) > maxExactBits || exactBits(p.y()) > maxExactBits || exactBits(p.z()) > maxExactBits;
+    }
+    if (!large) return geom;
+    PolySet ps(3);
+    if (createPolySetFromNefPolyhedron3(*N->p3, ps) || !ps.isManifold()) return geom;
+    // Snapping to doubles can make faces intersect, which the Nef would silently resolve
+    const auto check = createHybridPolyhedronFromPolySet(ps);
+    if (!check || !check->isValidSolid()) return geom;
+    shared_ptr<CGAL_Nef_polyhedron> rounded(createNefPolyhedronFromPolySet(ps));
+    if (!rounded || rounded->isEmpty()) return geom;
+    rounded->setConvexity(N->getConvexity());
+    return rounded;
+  }
+  if (const auto hybrid = dynamic_pointer_cast<const CGALHybridPolyhedron>(geom)) {
+    if (!hybrid->hasCoordinatesLargerThan(maxExactBits)) return geom;
+    auto rounded = make_shared<CGALHybridPolyhedron>(*hybrid);
+    rounded->roundCoordinates();
+    if (!rounded->isValidSolid()) return geom;
+    return rounded;
+  }
+  return geom;
+}
+
 static CGAL_Nef_polyhedron *createNefPolyhedronFromPolygon2d(const Polygon2d& polygon)
 {
   shared_ptr<PolySet> ps(polygon.tessellate());
@@ -172,16 +212,16 @@ bool is_approximately_convex(const PolySet& ps) {
   using Edge_to_facet_map = std::map<Edge, int, VecPairCompare>;
   Edge_to_facet_map edge_to_facet_map;
   std::vector<Plane> facet_planes;
-  facet_planes.reserve(ps.polygons.size());
+  facet_planes.reserve(ps.getPolygons().size());
 
-  for (size_t i = 0; i < ps.polygons.size(); ++i) {
+  for (size_t i = 0; i < ps.getPolygons().size(); ++i) {
     Plane plane;
-    auto N = ps.polygons[i].size();
+    auto N = ps.getPolygons()[i].size();
     if (N >= 3) {
       std::vector<Point> v(N);
       for (size_t j = 0; j < N; ++j) {
-        v[j] = vector_convert<Point>(ps.polygons[i][j]);
-        Edge edge(ps.polygons[i][j], ps.polygons[i][(j + 1) % N]);
+        v[j] = vector_convert<Point>(ps.getPolygons()[i][j]);
+        Edge edge(ps.getPolygons()[i][j], ps.getPolygons()[i][(j + 1) % N]);
         if (edge_to_facet_map.count(edge)) return false; // edge already exists: nonmanifold
         edge_to_facet_map[edge] = i;
       }
@@ -192,18 +232,18 @@ bool is_approximately_convex(const PolySet& ps) {
     facet_planes.push_back(plane);
   }
 
-  for (size_t i = 0; i < ps.polygons.size(); ++i) {
-    auto N = ps.polygons[i].size();
+  for (size_t i = 0; i < ps.getPolygons().size(); ++i) {
+    auto N = ps.getPolygons()[i].size();
     if (N < 3) continue;
     for (size_t j = 0; j < N; ++j) {
-      Edge other_edge(ps.polygons[i][(j + 1) % N], ps.polygons[i][j]);
+      Edge other_edge(ps.getPolygons()[i][(j + 1) % N], ps.getPolygons()[i][j]);
       if (edge_to_facet_map.count(other_edge) == 0) return false; //
       //Edge_to_facet_map::const_iterator it = edge_to_facet_map.find(other_edge);
       //if (it == edge_to_facet_map.end()) return false; // not a closed manifold
       //int other_facet = it->second;
       int other_facet = edge_to_facet_map[other_edge];
 
-      auto p = vector_convert<Point>(ps.polygons[i][(j + 2) % N]);
+      auto p = vector_convert<Point>(ps.getPolygons()[i][(j + 2) % N]);
 
       if (facet_planes[other_facet].has_on_positive_side(p)) {
         // Check angle
@@ -226,9 +266,9 @@ bool is_approximately_convex(const PolySet& ps) {
   while (!facets_to_visit.empty()) {
     int f = facets_to_visit.front(); facets_to_visit.pop();
 
-    for (size_t i = 0; i < ps.polygons[f].size(); ++i) {
-      int j = (i + 1) % ps.polygons[f].size();
-      auto it = edge_to_facet_map.find(Edge(ps.polygons[f][j], ps.polygons[f][i]));
+    for (size_t i = 0; i < ps.getPolygons()[f].size(); ++i) {
+      int j = (i + 1) % ps.getPolygons()[f].size();
+      auto it = edge_to_facet_map.find(Edge(ps.getPolygons()[f][j], ps.getPolygons()[f][i]));
       if (it == edge_to_facet_map.end()) return false; // Nonmanifold
       if (!explored_facets.count(it->second)) {
         explored_facets.insert(it->second);
@@ -238,10 +278,10 @@ bool is_approximately_convex(const PolySet& ps) {
   }
 
   // Make sure that we were able to reach all polygons during our visit
-  return explored_facets.size() == ps.polygons.size();
+  return explored_facets.size() == ps.getPolygons().size();
 }
 
-shared_ptr<const CGAL_Nef_polyhedron> getNefPolyhedronFromGeometry(const shared_ptr<const Geometry>& geom)
+static shared_ptr<const CGAL_Nef_polyhedron> convertToNefPolyhedron(const shared_ptr<const Geometry>& geom)
 {
   if (auto ps = dynamic_pointer_cast<const PolySet>(geom)) {
     return shared_ptr<CGAL_Nef_polyhedron>(createNefPolyhedronFromPolySet(*ps));
@@ -249,8 +289,6 @@ shared_ptr<const CGAL_Nef_polyhedron> getNefPolyhedronFromGeometry(const shared_
     return createNefPolyhedronFromHybrid(*poly);
   } else if (auto poly2d = dynamic_pointer_cast<const Polygon2d>(geom)) {
     return shared_ptr<CGAL_Nef_polyhedron>(createNefPolyhedronFromPolygon2d(*poly2d));
-  } else if (auto nef = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
-    return nef;
 #if ENABLE_MANIFOLD
   } else if (auto mani = dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
     return shared_ptr<CGAL_Nef_polyhedron>(createNefPolyhedronFromPolySet(*mani->toPolySet()));
@@ -259,6 +297,21 @@ shared_ptr<const CGAL_Nef_polyhedron> getNefPolyhedronFromGeometry(const shared_
   return nullptr;
 }
 
+shared_ptr<const CGAL_Nef_polyhedron> getNefPolyhedronFromGeometry(const shared_ptr<const Geometry>& geom)
+{
+  if (auto nef = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) return nef;
+  if (!geom) return nullptr;
+
+  // A child used by several operators is converted only once
+  auto cache = GeometryCache::instance();
+  if (auto converted = cache->getConversion(geom, GeometryCache::Conversion::Nef)) {
+    return static_pointer_cast<const CGAL_Nef_polyhedron>(converted);
+  }
+  auto N = convertToNefPolyhedron(geom);
+  if (N) cache->insertConversion(geom, GeometryCache::Conversion::Nef, N);
+  return N;
+}
+
 /*
    Create a PolySet from a Nef Polyhedron 3. return false on success,
    true on failure. The trick to this is that Nef Polyhedron3 faces have
@@ -269,6 +322,7 @@ shared_ptr<const CGAL_Nef_polyhedron> getNefPolyhedronFromGeometry(const shared_
 template <typename K>
 bool createPolySetFromNefPolyhedron3(const CGAL::Nef_polyhedron_3<K>& N, PolySet& ps)
 {
+  TimingCounters::Scope timer(TimingCounters::NEF_CONVERSION);
   // 1. Build Indexed PolyMesh
   // 2. Validate mesh (manifoldness)
   // 3. Triangulate each face
@@ -488,11 +542,8 @@ template Transform3d computeResizeTransform(
   const CGAL::Iso_cuboid_3<CGAL_HybridKernel3>& bb, unsigned int dimension, const Vector3d& newsize,
   const Eigen::Matrix<bool, 3, 1>& autosize);
 
-shared_ptr<const PolySet> getGeometryAsPolySet(const shared_ptr<const Geometry>& geom)
+static shared_ptr<const PolySet> convertToPolySet(const shared_ptr<const Geometry>& geom)
 {
-  if (auto ps = dynamic_pointer_cast<const PolySet>(geom)) {
-    return ps;
-  }
   if (auto N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
     auto ps = make_shared<PolySet>(3);
     ps->setConvexity(N->getConvexity());
@@ -515,6 +566,22 @@ shared_ptr<const PolySet> getGeometryAsPolySet(const shared_ptr<const Geometry>&
   return nullptr;
 }
 
+shared_ptr<const PolySet> getGeometryAsPolySet(const shared_ptr<const Geometry>& geom)
+{
+  if (auto ps = dynamic_pointer_cast<const PolySet>(geom)) {
+    return ps;
+  }
+  if (!geom) return nullptr;
+
+  auto cache = GeometryCache::instance();
+  if (auto converted = cache->getConversion(geom, GeometryCache::Conversion::PolySet)) {
+    return static_pointer_cast<const PolySet>(converted);
+  }
+  auto ps = convertToPolySet(geom);
+  if (ps) cache->insertConversion(geom, GeometryCache::Conversion::PolySet, ps);
+  return ps;
+}
+
 }  // namespace CGALUtils
 
 #endif /* ENABLE_CGAL */
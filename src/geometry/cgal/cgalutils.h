@@ -4,6 +4,7 @@
 #include "PolySet.h"
 #include "CGAL_Nef_polyhedron.h"
 #include "enums.h"
+#include "hash.h"
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 
@@ -37,7 +38,8 @@ bool is_weakly_convex(const CGAL::Polyhedron_3<K>& p);
 template <typename K>
 bool is_weakly_convex(const CGAL::Surface_mesh<CGAL::Point_3<K>>& m);
 shared_ptr<const Geometry> applyOperator3D(const Geometry::Geometries& children, OpenSCADOperator op);
-shared_ptr<const Geometry> applyUnion3D(Geometry::Geometries::iterator chbegin, Geometry::Geometries::iterator chend);
+shared_ptr<const Geometry> applyUnion3D(Geometry::Geometries::iterator chbegin, Geometry::Geometries::iterator chend,
+                                        const Hash128 *checkpoint = nullptr);
 shared_ptr<CGALHybridPolyhedron> applyOperator3DHybrid(const Geometry::Geometries& children, OpenSCADOperator op);
 shared_ptr<CGALHybridPolyhedron> applyUnion3DHybrid(
   const Geometry::Geometries::const_iterator& chbegin,
@@ -108,6 +110,12 @@ getCartesianConverter()
 }
 shared_ptr<CGAL_Nef_polyhedron> createNefPolyhedronFromHybrid(const CGALHybridPolyhedron& hybrid);
 std::shared_ptr<CGALHybridPolyhedron> createHybridPolyhedronFromPolySet(const PolySet& ps);
+// Bits taken by the numerator and denominator of an exact number
+size_t exactBits(const CGAL::Gmpq& n);
+// Whether a lazy number takes more than maxBits once evaluated exactly. Only
+// numbers whose interval approximation is loose are evaluated.
+bool hasLargeExactValue(const CGAL_HybridKernel3::FT& n, size_t maxBits);
+shared_ptr<const Geometry> roundExactCoordinates(const shared_ptr<const Geometry>& geom);
 std::shared_ptr<CGALHybridPolyhedron> createMutableHybridPolyhedronFromGeometry(const std::shared_ptr<const Geometry>& geom);
 std::shared_ptr<const CGALHybridPolyhedron> getHybridPolyhedronFromGeometry(const std::shared_ptr<const Geometry>& geom);
 template <typename K>
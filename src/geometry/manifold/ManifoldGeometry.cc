@@ -79,12 +79,9 @@ std::shared_ptr<const PolySet> ManifoldGeometry::toPolySet() const {
   auto ps = std::make_shared<PolySet>(3);
   manifold::Mesh mesh = getManifold().GetMesh();
   ps->reserve(mesh.triVerts.size());
-  Polygon poly(3);
   for (const auto &tv : mesh.triVerts) {
-    for (const int j : {0, 1, 2}) {
-      poly[j] = vector_convert<Vector3d>(mesh.vertPos[tv[j]]);
-    }
-    ps->append_poly(poly);
+    ps->append_triangle(vector_convert<Vector3d>(mesh.vertPos[tv[0]]), vector_convert<Vector3d>(mesh.vertPos[tv[1]]),
+                        vector_convert<Vector3d>(mesh.vertPos[tv[2]]));
   }
   return ps;
 }
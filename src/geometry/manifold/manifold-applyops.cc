@@ -8,8 +8,12 @@
 #include "node.h"
 #include "progress.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 
-#include <queue>
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
 
 namespace ManifoldUtils {
 
@@ -18,31 +22,121 @@ Location getLocation(const std::shared_ptr<const AbstractNode>& node)
   return node && node->modinst ? node->modinst->location() : Location::NONE;
 }
 
+/*!
+   Groups the operands whose bounding boxes overlap, directly or through other
+   operands. Operands of different groups can't touch each other. Boxes are
+   swept along x, so only operands overlapping in x are compared.
+ */
+static std::vector<std::vector<size_t>> overlappingGroups(const std::vector<BoundingBox>& boxes)
+{
+  std::vector<size_t> parent(boxes.size());
+  std::iota(parent.begin(), parent.end(), 0);
+  auto find = [&parent](size_t i) {
+    while (parent[i] != i) i = parent[i] = parent[parent[i]];
+    return i;
+  };
+
+  std::vector<size_t> order(parent);
+  std::sort(order.begin(), order.end(), [&boxes](size_t a, size_t b) { return boxes[a].min().x() < boxes[b].min().x(); });
+  std::vector<size_t> active;
+  for (const auto i : order) {
+    active.erase(std::remove_if(active.begin(), active.end(), [&](size_t a) { return boxes[a].max().x() < boxes[i].min().x(); }),
+                 active.end());
+    for (const auto a : active) {
+      if (boxes[a].intersects(boxes[i])) parent[find(a)] = find(i);
+    }
+    active.push_back(i);
+  }
+
+  std::vector<std::vector<size_t>> groups;
+  std::unordered_map<size_t, size_t> group_of_root;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    auto it = group_of_root.emplace(find(i), groups.size()).first;
+    if (it->second == groups.size()) groups.emplace_back();
+    groups[it->second].push_back(i);
+  }
+  return groups;
+}
+
+/*!
+   Unions the operands with Manifold's batch boolean, which schedules all of
+   them together. Groups of operands that can't touch each other are only
+   composed, without a boolean between them.
+ */
+static shared_ptr<ManifoldGeometry> applyUnion3DManifold(const std::vector<shared_ptr<ManifoldGeometry>>& operands)
+{
+  if (operands.empty()) return make_shared<ManifoldGeometry>();
+  if (operands.size() == 1) return operands.front();
+
+  std::vector<BoundingBox> boxes;
+  boxes.reserve(operands.size());
+  for (const auto& operand : operands) boxes.push_back(operand->getBoundingBox());
+
+  std::vector<manifold::Manifold> parts;
+  for (const auto& group : overlappingGroups(boxes)) {
+    std::vector<manifold::Manifold> manifolds;
+    manifolds.reserve(group.size());
+    for (const auto i : group) manifolds.push_back(operands[i]->getManifold());
+    parts.push_back(manifolds.size() == 1 ? manifolds.front() : manifold::Manifold::BatchBoolean(manifolds, manifold::OpType::Add));
+  }
+  // Progress is reported per operand merged, since the batch doesn't map to single nodes
+  for (size_t i = 1; i < operands.size(); ++i) progress_tick();
+  auto result = parts.size() == 1 ? parts.front() : manifold::Manifold::Compose(parts);
+  return make_shared<ManifoldGeometry>(make_shared<manifold::Manifold>(std::move(result)));
+}
+
 /*!
    Applies op to all children and returns the result.
    The child list should be guaranteed to contain non-NULL 3D or empty Geometry objects
  */
-shared_ptr<const ManifoldGeometry> applyOperator3DManifold(const Geometry::Geometries& children, OpenSCADOperator op)
+shared_ptr<const ManifoldGeometry> applyOperator3DManifold(const Geometry::Geometries& children, OpenSCADOperator op, bool approximate)
 {
+  TimingCounters::Scope timer(TimingCounters::MANIFOLD);
+  if (op == OpenSCADOperator::UNION || op == OpenSCADOperator::DIFFERENCE || op == OpenSCADOperator::INTERSECTION) {
+    std::vector<shared_ptr<ManifoldGeometry>> operands;
+    for (const auto& item : children) {
+      auto chN = item.second ? createMutableManifoldFromGeometry(item.second, approximate) : nullptr;
+      if (chN && !chN->isEmpty()) {
+        operands.push_back(chN);
+        continue;
+      }
+      // Intersecting something with nothing results in nothing, as does subtracting from nothing
+      if (op == OpenSCADOperator::INTERSECTION || (op == OpenSCADOperator::DIFFERENCE && operands.empty())) return nullptr;
+    }
+
+    if (op == OpenSCADOperator::UNION) return applyUnion3DManifold(operands);
+    if (operands.empty()) return make_shared<ManifoldGeometry>();
+    if (op == OpenSCADOperator::INTERSECTION) {
+      std::vector<manifold::Manifold> manifolds;
+      manifolds.reserve(operands.size());
+      for (const auto& operand : operands) manifolds.push_back(operand->getManifold());
+      for (size_t i = 1; i < operands.size(); ++i) progress_tick();
+      return make_shared<ManifoldGeometry>(make_shared<manifold::Manifold>(manifold::Manifold::BatchBoolean(manifolds, manifold::OpType::Intersect)));
+    }
+
+    // Subtract the union of the negatives once, skipping those that can't touch the positive
+    auto N = operands.front();
+    const auto bbox = N->getBoundingBox();
+    std::vector<shared_ptr<ManifoldGeometry>> negatives;
+    for (size_t i = 1; i < operands.size(); ++i) {
+      if (operands[i]->getBoundingBox().intersects(bbox)) negatives.push_back(operands[i]);
+      else progress_tick();
+    }
+    if (!negatives.empty()) {
+      *N -= *applyUnion3DManifold(negatives);
+      progress_tick();
+    }
+    return N;
+  }
+
   auto N = make_shared<ManifoldGeometry>();
 
   bool foundFirst = false;
 
   for (const auto& item : children) {
-    auto chN = item.second ? createMutableManifoldFromGeometry(item.second) : nullptr;
+    auto chN = item.second ? createMutableManifoldFromGeometry(item.second, approximate) : nullptr;
 
-    // Intersecting something with nothing results in nothing
-    if (!chN || chN->isEmpty()) {
-      if (op == OpenSCADOperator::INTERSECTION) {
-        N = nullptr;
-        break;
-      }
-      if (op == OpenSCADOperator::DIFFERENCE && !foundFirst) {
-        N = nullptr;
-        break;
-      }
-      continue;
-    }
+    if (!chN || chN->isEmpty()) continue;
 
     // Initialize N with first expected geometric object
     if (!foundFirst) {
@@ -52,15 +146,6 @@ shared_ptr<const ManifoldGeometry> applyOperator3DManifold(const Geometry::Geome
     }
 
     switch (op) {
-    case OpenSCADOperator::UNION:
-      *N += *chN;
-      break;
-    case OpenSCADOperator::INTERSECTION:
-      *N *= *chN;
-      break;
-    case OpenSCADOperator::DIFFERENCE:
-      *N -= *chN;
-      break;
     case OpenSCADOperator::MINKOWSKI:
       N->minkowski(*chN);
       break;
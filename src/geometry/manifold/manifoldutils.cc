@@ -2,13 +2,18 @@
 #include "manifoldutils.h"
 #include "ManifoldGeometry.h"
 #include "manifold.h"
-#include "IndexedMesh.h"
 #include "printutils.h"
 #include "cgalutils.h"
 #include "PolySetUtils.h"
 #include "CGALHybridPolyhedron.h"
+#include "GeometryCache.h"
+#include "ClipperUtils.h"
+#include "Polygon2d.h"
+#include "GeometryUtils.h"
+#include "parallel.h"
 #include <CGAL/convex_hull_3.h>
 #include <CGAL/Surface_mesh.h>
+#include <algorithm>
 
 using Error = manifold::Manifold::Error;
 
@@ -31,39 +36,42 @@ const char* statusToString(Error status) {
   }
 }
 
-std::shared_ptr<manifold::Manifold> trustedPolySetToManifold(const PolySet& ps) {
-  IndexedMesh im;
-  {
-    PolySet triangulated(3);
-    PolySetUtils::tessellate_faces(ps, triangulated);
-    im.append_geometry(triangulated);
-  }
+/*!
+   Tessellates the PolySet straight into a Manifold mesh, without an
+   intermediate triangulated PolySet.
+ */
+static manifold::Mesh toManifoldMesh(const IndexedTriangleMesh& tm)
+{
+  manifold::Mesh mesh;
+  mesh.vertPos.resize(tm.vertices.size());
+  parallelizable_transform(tm.vertices.begin(), tm.vertices.end(), mesh.vertPos.begin(), [](const Vector3f& v) {
+    return glm::vec3(v.x(), v.y(), v.z());
+  });
+  mesh.triVerts.resize(tm.triangles.size());
+  parallelizable_transform(tm.triangles.begin(), tm.triangles.end(), mesh.triVerts.begin(), [](const IndexedTriangle& t) {
+    return glm::ivec3(t[0], t[1], t[2]);
+  });
+  return mesh;
+}
 
-  auto numfaces = im.numfaces;
-  const auto &vertices = im.vertices.getArray();
-  const auto &indices = im.indices;
+static manifold::Mesh tessellateToMesh(const PolySet& ps)
+{
+  IndexedTriangleMesh tm;
+  PolySetUtils::tessellate_faces(ps, tm);
+  return toManifoldMesh(tm);
+}
 
-  manifold::Mesh mesh;
-  mesh.vertPos.resize(vertices.size());
-  mesh.triVerts.resize(numfaces);
-  for (size_t i = 0, n = vertices.size(); i < n; i++) {
-    const auto &v = vertices[i];
-    mesh.vertPos[i] = glm::vec3((float) v.x(), (float) v.y(), (float) v.z());
-  }
-  const auto vertexCount = mesh.vertPos.size();
-  assert(indices.size() == numfaces * 4);
-  for (size_t i = 0; i < numfaces; i++) {
-    auto offset = i * 4; // 3 indices of triangle then -1.
-    auto i0 = indices[offset];
-    auto i1 = indices[offset + 1];
-    auto i2 = indices[offset + 2];
-    assert(indices[offset + 3] == -1);
-    assert(i0 >= 0 && i0 < vertexCount &&
-           i1 >= 0 && i1 < vertexCount &&
-           i2 >= 0 && i2 < vertexCount);
-    assert(i0 != i1 && i0 != i2 && i1 != i2);
-    mesh.triVerts[i] = {i0, i1, i2};
+std::shared_ptr<manifold::Manifold> trustedPolySetToManifold(const PolySet& ps) {
+  auto mesh = tessellateToMesh(ps);
+#ifndef NDEBUG
+  const int vertexCount = mesh.vertPos.size();
+  for (const auto& t : mesh.triVerts) {
+    assert(t[0] >= 0 && t[0] < vertexCount &&
+           t[1] >= 0 && t[1] < vertexCount &&
+           t[2] >= 0 && t[2] < vertexCount);
+    assert(t[0] != t[1] && t[0] != t[2] && t[1] != t[2]);
   }
+#endif
   return make_shared<manifold::Manifold>(std::move(mesh));
 }
 
@@ -145,17 +153,93 @@ std::shared_ptr<ManifoldGeometry> createMutableManifoldFromPolySet(const PolySet
   return createMutableManifoldFromSurfaceMesh(m);
 }
 
-std::shared_ptr<ManifoldGeometry> createMutableManifoldFromGeometry(const std::shared_ptr<const Geometry>& geom) {
+/*!
+   Degenerate triangles are dropped, everything else is left to Manifold,
+   which merges nearby vertices itself. Falls back to the repairing
+   conversion if Manifold rejects the mesh.
+ */
+std::shared_ptr<ManifoldGeometry> createApproximateManifoldFromPolySet(const PolySet& ps)
+{
+  auto mesh = tessellateToMesh(ps);
+  mesh.triVerts.erase(std::remove_if(mesh.triVerts.begin(), mesh.triVerts.end(), [](const glm::ivec3& t) {
+    return t[0] == t[1] || t[0] == t[2] || t[1] == t[2];
+  }), mesh.triVerts.end());
+
+  auto mani = std::make_shared<manifold::Manifold>(std::move(mesh));
+  if (mani->Status() != Error::NoError) return createMutableManifoldFromPolySet(ps);
+  return std::make_shared<ManifoldGeometry>(mani);
+}
+
+std::shared_ptr<ManifoldGeometry> createManifoldFromTriangleMesh(const IndexedTriangleMesh& tm)
+{
+  auto mani = std::make_shared<manifold::Manifold>(toManifoldMesh(tm));
+  if (mani->Status() != Error::NoError) return nullptr;
+  return std::make_shared<ManifoldGeometry>(mani);
+}
+
+std::shared_ptr<ManifoldGeometry> createMutableManifoldFromGeometry(const std::shared_ptr<const Geometry>& geom, bool approximate) {
   if (auto mani = dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
     return std::make_shared<ManifoldGeometry>(*mani);
   }
 
+  if (!geom) return nullptr;
+
+  // A child used by several operators is converted only once. Copies of a
+  // ManifoldGeometry share the mesh, so returning one is cheap.
+  auto cache = GeometryCache::instance();
+  const auto conversion = approximate ? GeometryCache::Conversion::ApproximateManifold : GeometryCache::Conversion::Manifold;
+  if (auto converted = cache->getConversion(geom, conversion)) {
+    return std::make_shared<ManifoldGeometry>(static_cast<const ManifoldGeometry&>(*converted));
+  }
   auto ps = CGALUtils::getGeometryAsPolySet(geom);
   if (ps) {
-    return createMutableManifoldFromPolySet(*ps);
+    auto mani = approximate ? createApproximateManifoldFromPolySet(*ps) : createMutableManifoldFromPolySet(*ps);
+    if (mani) cache->insertConversion(geom, conversion, std::make_shared<ManifoldGeometry>(*mani));
+    return mani;
   }
-  
+
   return nullptr;
 }
 
+/*!
+   Everything below the plane is cut off with a box, whose top face then
+   holds the cross section as upward facing triangles at z = 0. These are
+   unioned in 2D, so no Nef polyhedron is needed for the cut.
+ */
+Polygon2d *projectCut(const ManifoldGeometry& geom)
+{
+  const BoundingBox bbox = geom.getBoundingBox();
+  if (bbox.isEmpty() || bbox.min().z() > 0 || bbox.max().z() < 0) return nullptr;
+
+  const glm::vec3 corner(bbox.min().x() - 1, bbox.min().y() - 1, bbox.min().z() - 1);
+  const glm::vec3 size(bbox.sizes().x() + 2, bbox.sizes().y() + 2, -corner.z);
+  const manifold::Manifold below = manifold::Manifold::Cube(size).Translate(corner);
+  const manifold::Mesh mesh = geom.getManifold().Boolean(below, manifold::OpType::Intersect).GetMesh();
+
+  // Vertices placed on the cutting plane may be off by float rounding
+  const double epsilon = 1e-6 * std::max(1.0, bbox.sizes().maxCoeff());
+  Polygon2d triangles;
+  for (const auto& tv : mesh.triVerts) {
+    const glm::vec3& a = mesh.vertPos[tv[0]];
+    const glm::vec3& b = mesh.vertPos[tv[1]];
+    const glm::vec3& c = mesh.vertPos[tv[2]];
+    if (std::abs(a.z) > epsilon || std::abs(b.z) > epsilon || std::abs(c.z) > epsilon) continue;
+    const double normal_z = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (normal_z <= 0) continue;
+    Outline2d outline;
+    outline.vertices = {Vector2d(a.x, a.y), Vector2d(b.x, b.y), Vector2d(c.x, c.y)};
+    triangles.addOutline(outline);
+  }
+  if (triangles.isEmpty()) return nullptr;
+
+  // NonZero, since neighbouring triangles share edges
+  const int pow2 = ClipperUtils::getScalePow2(triangles.getBoundingBox());
+  ClipperLib::Clipper clipper;
+  clipper.AddPaths(ClipperUtils::fromPolygon2d(triangles, pow2), ClipperLib::ptSubject, true);
+  ClipperLib::PolyTree result;
+  clipper.StrictlySimple(true);
+  clipper.Execute(ClipperLib::ctUnion, result, ClipperLib::pftNonZero, ClipperLib::pftNonZero);
+  return ClipperUtils::toPolygon2d(result, pow2);
+}
+
 }; // namespace ManifoldUtils
@@ -6,6 +6,8 @@
 #include "manifold.h"
 
 class PolySet;
+class Polygon2d;
+struct IndexedTriangleMesh;
 
 namespace manifold {
   class Manifold;
@@ -20,12 +22,20 @@ namespace ManifoldUtils {
   std::shared_ptr<manifold::Manifold> trustedPolySetToManifold(const PolySet& ps);
 
   std::shared_ptr<ManifoldGeometry> createMutableManifoldFromPolySet(const PolySet& ps);
-  std::shared_ptr<ManifoldGeometry> createMutableManifoldFromGeometry(const std::shared_ptr<const Geometry>& geom);
+  /*! Hands the triangulated faces to Manifold as they are, without repairing them with CGAL. */
+  std::shared_ptr<ManifoldGeometry> createApproximateManifoldFromPolySet(const PolySet& ps);
+  /*! For meshes built with shared vertices, e.g. by extrusions. Returns nullptr if the mesh isn't manifold. */
+  std::shared_ptr<ManifoldGeometry> createManifoldFromTriangleMesh(const IndexedTriangleMesh& mesh);
+  /*! approximate picks createApproximateManifoldFromPolySet() for PolySets, as for quick renders. */
+  std::shared_ptr<ManifoldGeometry> createMutableManifoldFromGeometry(const std::shared_ptr<const Geometry>& geom, bool approximate = false);
 
   template <class TriangleMesh>
   std::shared_ptr<ManifoldGeometry> createMutableManifoldFromSurfaceMesh(const TriangleMesh& mesh);
 
-  std::shared_ptr<const ManifoldGeometry> applyOperator3DManifold(const Geometry::Geometries& children, OpenSCADOperator op);
+  std::shared_ptr<const ManifoldGeometry> applyOperator3DManifold(const Geometry::Geometries& children, OpenSCADOperator op, bool approximate = false);
 
   std::shared_ptr<const Geometry> applyMinkowskiManifold(const Geometry::Geometries& children);
+
+  /*! Cross section at z = 0, as for projection(cut = true). Returns nullptr if the plane misses geom. */
+  Polygon2d *projectCut(const ManifoldGeometry& geom);
 };
\ No newline at end of file
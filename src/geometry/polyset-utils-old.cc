@@ -48,7 +48,7 @@ namespace PolySetUtils {
 Polygon2d *project(const PolySet& ps) {
   Polygon2d *poly = new Polygon2d;
 
-  for (const auto& p : ps.polygons) {
+  for (const auto& p : ps.getPolygons()) {
     Outline2d outline;
     for (const auto& v : p) {
       outline.vertices.push_back(Vector2d(v[0], v[1]));
@@ -212,8 +212,8 @@ bool triangulate_polygon(const PolySet::Polygon& pgon, std::vector<PolySet::Poly
    duplicate points, and proper orientation. */
 void tessellate_faces(const PolySet& inps, PolySet& outps) {
   int degeneratePolygons = 0;
-  for (size_t i = 0; i < inps.polygons.size(); ++i) {
-    const PolySet::Polygon pgon = inps.polygons[i];
+  for (size_t i = 0; i < inps.getPolygons().size(); ++i) {
+    const PolySet::Polygon pgon = inps.getPolygons()[i];
     if (pgon.size() < 3) {
       degeneratePolygons++;
       continue;
@@ -0,0 +1,100 @@
+#include "OcclusionCuller.h"
+#include "CSGNode.h"
+
+OcclusionCuller::OcclusionCuller(size_t size)
+  : queries(size), pending(size), hidden(size)
+{
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+  for (const auto query : this->queries) {
+    if (query) glDeleteQueries(1, &query);
+  }
+}
+
+bool OcclusionCuller::isSupported()
+{
+  return hasGLExtension(ARB_occlusion_query);
+}
+
+bool OcclusionCuller::canCull(const CSGProducts& products)
+{
+  for (const auto& product : products.products) {
+    for (const auto& csgobj : product.intersections) {
+      // Negative components leave the default color
+      const float alpha = csgobj.leaf->color[3];
+      if (alpha >= 0.0f && alpha < 1.0f) return false;
+    }
+  }
+  return true;
+}
+
+bool OcclusionCuller::isHidden(size_t index)
+{
+  if (this->pending[index]) {
+    GLuint available = 0;
+    glGetQueryObjectuiv(this->queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint samples = 0;
+      glGetQueryObjectuiv(this->queries[index], GL_QUERY_RESULT, &samples);
+      this->hidden[index] = samples == 0;
+      this->pending[index] = false;
+    }
+  }
+  return this->hidden[index];
+}
+
+void OcclusionCuller::beginQueries()
+{
+  Eigen::Matrix4d modelview;
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelview.data());
+  this->eye = (modelview.inverse() * Eigen::Vector4d(0, 0, 0, 1)).head<3>();
+
+  glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT | GL_LIGHTING_BIT);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glDepthMask(GL_FALSE);
+  glDepthFunc(GL_LEQUAL);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_LIGHTING);
+  glUseProgram(0);
+}
+
+void OcclusionCuller::query(size_t index, const BoundingBox& bbox)
+{
+  // A box around the eye is clipped by the near plane, and could test as hidden
+  if (bbox.isEmpty() || bbox.contains(this->eye)) {
+    this->hidden[index] = false;
+    return;
+  }
+  // The previous test is still running
+  if (this->pending[index]) return;
+  if (!this->queries[index]) glGenQueries(1, &this->queries[index]);
+
+  const Vector3d& lo = bbox.min();
+  const Vector3d& hi = bbox.max();
+  glBeginQuery(GL_SAMPLES_PASSED, this->queries[index]);
+  glBegin(GL_QUADS);
+  for (int axis = 0; axis < 3; ++axis) {
+    const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+    for (const double w : {lo[axis], hi[axis]}) {
+      Vector3d corner;
+      corner[axis] = w;
+      const double us[] = {lo[u], hi[u], hi[u], lo[u]};
+      const double vs[] = {lo[v], lo[v], hi[v], hi[v]};
+      for (int i = 0; i < 4; ++i) {
+        corner[u] = us[i];
+        corner[v] = vs[i];
+        glVertex3d(corner[0], corner[1], corner[2]);
+      }
+    }
+  }
+  glEnd();
+  glEndQuery(GL_SAMPLES_PASSED);
+  this->pending[index] = true;
+}
+
+void OcclusionCuller::endQueries()
+{
+  glPopAttrib();
+}
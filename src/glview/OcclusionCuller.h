@@ -0,0 +1,48 @@
+#pragma once
+
+#include "linalg.h"
+#include "system-gl.h"
+
+#include <vector>
+
+class CSGProducts;
+
+/*!
+   Skips drawing objects hidden behind others, e.g. the internals of an
+   enclosure. After a frame is drawn, the bounding box of each object is
+   tested against its depth buffer with an occlusion query. Objects whose box
+   has no visible samples are skipped in the following frames, while their box
+   is still tested, until it becomes visible again.
+
+   Results are collected without waiting for the GPU, so an object appearing
+   from behind another is drawn a frame late.
+ */
+class OcclusionCuller
+{
+public:
+  OcclusionCuller(size_t size);
+  ~OcclusionCuller();
+  OcclusionCuller(const OcclusionCuller&) = delete;
+  OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+  static bool isSupported();
+  [[nodiscard]] size_t size() const { return this->hidden.size(); }
+  // Transparent objects don't hide what is behind them
+  static bool canCull(const CSGProducts& products);
+
+  // True if the object was hidden when last tested
+  bool isHidden(size_t index);
+  // For objects outside the view, which can't be tested
+  void setVisible(size_t index) { this->hidden[index] = false; }
+
+  // Tests are issued between begin and end, with color and depth writes disabled
+  void beginQueries();
+  void query(size_t index, const BoundingBox& bbox);
+  void endQueries();
+
+private:
+  std::vector<GLuint> queries;
+  std::vector<char> pending;
+  std::vector<char> hidden;
+  Vector3d eye;
+};
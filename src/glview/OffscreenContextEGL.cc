@@ -42,9 +42,9 @@ const char* eglGetErrorString(EGLint error)
 class OffscreenContextEGL : public OffscreenContext {
 
 public:
-  EGLDisplay eglDisplay;
-  EGLSurface eglSurface;
-  EGLContext eglContext;
+  EGLDisplay eglDisplay{EGL_NO_DISPLAY};
+  EGLSurface eglSurface{EGL_NO_SURFACE};
+  EGLContext eglContext{EGL_NO_CONTEXT};
 
   OffscreenContextEGL(int width, int height) : OffscreenContext(width, height) {}
   ~OffscreenContextEGL() {
@@ -68,7 +68,7 @@ public:
     return eglMakeCurrent(this->eglDisplay, this->eglSurface, this->eglSurface, this->eglContext);
   }
 
-  void findPlatformDisplay() {
+  void findPlatformDisplay(unsigned device, bool wrap) {
     std::set<std::string> clientExtensions;
     std::string ext = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
     std::istringstream iss(ext);
@@ -83,13 +83,20 @@ public:
     }
 
     if (eglQueryDevicesEXT && eglGetPlatformDisplayEXT) {
-      EGLDeviceEXT eglDevice;
       EGLint numDevices = 0;
-      eglQueryDevicesEXT(1, &eglDevice, &numDevices);
-      if (numDevices > 0) {
-	// FIXME: Attribs
-        this->eglDisplay = eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, eglDevice, nullptr);
+      if (!eglQueryDevicesEXT(0, nullptr, &numDevices) || numDevices <= 0) return;
+      std::vector<EGLDeviceEXT> eglDevices(numDevices);
+      eglQueryDevicesEXT(numDevices, eglDevices.data(), &numDevices);
+      if (numDevices <= 0) return;
+      if (wrap) {
+        device %= numDevices;
+      } else if (device >= static_cast<unsigned>(numDevices)) {
+        LOG(message_group::Warning, "EGL device %1$d not found, using device 0 of %2$d", device, numDevices);
+        device = 0;
       }
+      PRINTDB("Using EGL device %d of %d", device % numDevices);
+      // FIXME: Attribs
+      this->eglDisplay = eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, eglDevices[device], nullptr);
     }
   }
 
@@ -109,7 +116,8 @@ public:
 // OpenGL ES major.minor
 std::shared_ptr<OffscreenContext> CreateOffscreenContextEGL(size_t width, size_t height,
 							    size_t majorGLVersion, size_t minorGLVersion,
-							    bool gles, bool compatibilityProfile)
+							    bool gles, bool compatibilityProfile,
+							    unsigned device, bool wrap)
 {
   auto ctx = std::make_shared<OffscreenContextEGL>(width, height);
 
@@ -142,7 +150,7 @@ std::shared_ptr<OffscreenContext> CreateOffscreenContextEGL(size_t width, size_t
 
   // FIXME: Should we try default display first?
   // If so, we also have to try initializing it
-  ctx->findPlatformDisplay();
+  ctx->findPlatformDisplay(device, wrap);
   if (ctx->eglDisplay == EGL_NO_DISPLAY) {
     ctx->eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
   }
@@ -5,6 +5,8 @@
 
 #include "OffscreenContext.h"
 
+// device is an index into the EGL devices, taken modulo their number if wrap
 std::shared_ptr<OffscreenContext> CreateOffscreenContextEGL(
     size_t width, size_t height, size_t majorGLVersion, 
-    size_t minorGLVersion, bool gles, bool compatibilityProfile);
+    size_t minorGLVersion, bool gles, bool compatibilityProfile,
+    unsigned device = 0, bool wrap = false);
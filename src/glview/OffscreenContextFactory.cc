@@ -2,6 +2,9 @@
 
 #include "printutils.h"
 
+#include <atomic>
+#include <random>
+
 #ifdef __APPLE__
 #include "offscreen-old/OffscreenContextNSOpenGL.h"
 #include "OffscreenContextCGL.h"
@@ -23,6 +26,29 @@
 
 namespace OffscreenContextFactory {
 
+namespace {
+
+std::atomic<unsigned> device_index{0};
+bool device_round_robin = false;
+
+unsigned nextDevice() {
+  return device_round_robin ? device_index++ : device_index.load();
+}
+
+} // namespace
+
+void selectDevice(unsigned index)
+{
+  device_index = index;
+  device_round_robin = false;
+}
+
+void selectDevicesRoundRobin()
+{
+  device_index = std::random_device{}() % 1024;
+  device_round_robin = true;
+}
+
 const char *defaultProvider() {
 #ifdef NULLGL
   return "nullgl";
@@ -75,7 +101,8 @@ std::shared_ptr<OpenGLContext> create(const std::string& provider, const Offscre
   } else if (provider == "egl") {
     return CreateOffscreenContextEGL(attrib.width, attrib.height,
 				     attrib.majorGLVersion, attrib.minorGLVersion,
-				     attrib.gles, attrib.compatibilityProfile);
+				     attrib.gles, attrib.compatibilityProfile,
+				     nextDevice(), device_round_robin);
   }
   else
 #endif
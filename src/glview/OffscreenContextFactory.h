@@ -19,4 +19,9 @@ struct ContextAttributes {
 const char *defaultProvider();
 std::shared_ptr<OpenGLContext> create(const std::string& provider, const ContextAttributes& attrib);
 
+// Selects the GPU of EGL contexts by its index in the EGL devices, the first one by default
+void selectDevice(unsigned index);
+// Spreads EGL contexts over all devices, starting from a random one so concurrent processes spread too
+void selectDevicesRoundRobin();
+
 }  // namespace OffscreenContextFactory
@@ -15,8 +15,6 @@ Renderer::Renderer()
 {
   PRINTD("Renderer() start");
 
-  renderer_shader.progid = 0;
-
   // Setup default colors
   // The main colors, MATERIAL and CUTOUT, come from this object's
   // colorscheme. Colorschemes don't currently hold information
@@ -34,6 +32,29 @@ Renderer::Renderer()
 
   Renderer::setColorScheme(ColorMap::inst()->defaultColorScheme());
 
+  if (share_shaders) {
+    if (!shared_shader.progid) shared_shader = compileShader();
+    renderer_shader = shared_shader;
+  } else {
+    renderer_shader = compileShader();
+  }
+
+  PRINTD("Renderer() end");
+}
+
+bool Renderer::share_shaders = false;
+Renderer::shaderinfo_t Renderer::shared_shader;
+
+void Renderer::shareShaders(bool enable)
+{
+  share_shaders = enable;
+  shared_shader = shaderinfo_t();
+}
+
+Renderer::shaderinfo_t Renderer::compileShader()
+{
+  shaderinfo_t shader;
+
   std::string vs_str = Renderer::loadShaderSource("Preview.vert");
   std::string fs_str = Renderer::loadShaderSource("Preview.frag");
   const char *vs_source = vs_str.c_str();
@@ -47,7 +68,7 @@ Renderer::Renderer()
   err = glGetError();
   if (err != GL_NO_ERROR) {
     PRINTDB("OpenGL Error: %s\n", gluErrorString(err));
-    return;
+    return shader;
   }
   glGetShaderiv(vs, GL_COMPILE_STATUS, &status);
   if (status == GL_FALSE) {
@@ -55,7 +76,7 @@ Renderer::Renderer()
     char logbuffer[1000];
     glGetShaderInfoLog(vs, sizeof(logbuffer), &loglen, logbuffer);
     PRINTDB("OpenGL Program Compile Vertex Shader Error:\n%s", logbuffer);
-    return;
+    return shader;
   }
 
   auto fs = glCreateShader(GL_FRAGMENT_SHADER);
@@ -64,7 +85,7 @@ Renderer::Renderer()
   err = glGetError();
   if (err != GL_NO_ERROR) {
     PRINTDB("OpenGL Error: %s\n", gluErrorString(err));
-    return;
+    return shader;
   }
   glGetShaderiv(fs, GL_COMPILE_STATUS, &status);
   if (status == GL_FALSE) {
@@ -72,7 +93,7 @@ Renderer::Renderer()
     char logbuffer[1000];
     glGetShaderInfoLog(fs, sizeof(logbuffer), &loglen, logbuffer);
     PRINTDB("OpenGL Program Compile Fragment Shader Error:\n%s", logbuffer);
-    return;
+    return shader;
   }
 
   auto edgeshader_prog = glCreateProgram();
@@ -83,7 +104,7 @@ Renderer::Renderer()
   err = glGetError();
   if (err != GL_NO_ERROR) {
     PRINTDB("OpenGL Error: %s\n", gluErrorString(err));
-    return;
+    return shader;
   }
 
   glGetProgramiv(edgeshader_prog, GL_LINK_STATUS, &status);
@@ -92,7 +113,7 @@ Renderer::Renderer()
     char logbuffer[1000];
     glGetProgramInfoLog(edgeshader_prog, sizeof(logbuffer), &loglen, logbuffer);
     PRINTDB("OpenGL Program Linker Error:\n%s", logbuffer);
-    return;
+    return shader;
   }
 
   int loglen;
@@ -107,13 +128,12 @@ Renderer::Renderer()
     PRINTDB("OpenGL Program Validation results:\n%s", logbuffer);
   }
 
-  renderer_shader.progid = edgeshader_prog; // 0
-  renderer_shader.type = EDGE_RENDERING;
-  renderer_shader.data.csg_rendering.color_area = glGetUniformLocation(edgeshader_prog, "color1"); // 1
-  renderer_shader.data.csg_rendering.color_edge = glGetUniformLocation(edgeshader_prog, "color2"); // 2
-  renderer_shader.data.csg_rendering.barycentric = glGetAttribLocation(edgeshader_prog, "barycentric"); // 3
-
-  PRINTD("Renderer() end");
+  shader.progid = edgeshader_prog; // 0
+  shader.type = EDGE_RENDERING;
+  shader.data.csg_rendering.color_area = glGetUniformLocation(edgeshader_prog, "color1"); // 1
+  shader.data.csg_rendering.color_edge = glGetUniformLocation(edgeshader_prog, "color2"); // 2
+  shader.data.csg_rendering.barycentric = glGetAttribLocation(edgeshader_prog, "barycentric"); // 3
+  return shader;
 }
 
 void Renderer::resize(int /*w*/, int /*h*/)
@@ -296,7 +316,7 @@ void Renderer::render_surface(const PolySet& ps, csgmode_e csgmode, const Transf
 
     // Render top+bottom
     for (double z : {-zbase / 2, zbase / 2}) {
-      for (const auto& poly : ps.polygons) {
+      for (const auto& poly : ps.getPolygons()) {
         if (poly.size() == 3) {
           if (z < 0) {
             gl_draw_triangle(shaderinfo, poly.at(0), poly.at(2), poly.at(1), true, true, true, z, mirrored);
@@ -346,7 +366,7 @@ void Renderer::render_surface(const PolySet& ps, csgmode_e csgmode, const Transf
     } else {
       // If we don't have borders, use the polygons as borders.
       // FIXME: When is this used?
-      const Polygons *borders_p = &ps.polygons;
+      const Polygons *borders_p = &ps.getPolygons();
       for (const auto& poly : *borders_p) {
         for (size_t j = 1; j <= poly.size(); ++j) {
           Vector3d p1 = poly.at(j - 1), p2 = poly.at(j - 1);
@@ -360,7 +380,7 @@ void Renderer::render_surface(const PolySet& ps, csgmode_e csgmode, const Transf
     }
     glEnd();
   } else if (ps.getDimension() == 3) {
-    for (const auto& poly : ps.polygons) {
+    for (const auto& poly : ps.getPolygons()) {
       glBegin(GL_TRIANGLES);
       if (poly.size() == 3) {
         gl_draw_triangle(shaderinfo, poly.at(0), poly.at(1), poly.at(2), true, true, true, 0, mirrored);
@@ -426,7 +446,7 @@ void Renderer::render_edges(const PolySet& ps, csgmode_e csgmode) const
       }
     }
   } else if (ps.getDimension() == 3) {
-    for (const auto& polygon : ps.polygons) {
+    for (const auto& polygon : ps.getPolygons()) {
       const Polygon *poly = &polygon;
       glBegin(GL_LINE_LOOP);
       for (const auto& p : *poly) {
@@ -443,6 +463,7 @@ void Renderer::render_edges(const PolySet& ps, csgmode_e csgmode) const
 #else //NULLGL
 
 Renderer::Renderer() : colorscheme(nullptr) {}
+void Renderer::shareShaders(bool /*enable*/) {}
 void Renderer::resize(int /*w*/, int /*h*/) {}
 bool Renderer::getColor(Renderer::ColorMode colormode, Color4f& col) const { return false; }
 std::string Renderer::loadShaderSource(const std::string& name) { return ""; }
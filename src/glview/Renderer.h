@@ -43,6 +43,12 @@ public:
   [[nodiscard]] virtual inline const Renderer::shaderinfo_t& getShader() const { return renderer_shader; }
 
   static std::string loadShaderSource(const std::string& name);
+  /*!
+     While enabled, all renderers use the shader program compiled by the first
+     one. Only valid as long as they draw into the same GL context, like the
+     offscreen view shared by command line image exports.
+   */
+  static void shareShaders(bool enable);
   virtual void prepare(bool showfaces, bool showedges, const shaderinfo_t *shaderinfo = nullptr) {}
   virtual void draw(bool showfaces, bool showedges, const shaderinfo_t *shaderinfo = nullptr) const = 0;
   [[nodiscard]] virtual BoundingBox getBoundingBox() const = 0;
@@ -88,5 +94,9 @@ protected:
   const ColorScheme *colorscheme{nullptr};
 
 private:
+  static shaderinfo_t compileShader();
+
   shaderinfo_t renderer_shader;
+  static bool share_shaders;
+  static shaderinfo_t shared_shader;
 };
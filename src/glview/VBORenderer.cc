@@ -39,6 +39,13 @@ VBORenderer::VBORenderer()
 {
 }
 
+// Whether a surface can be drawn again, from vertex data written with a different transform
+static bool isInstanceable(const PolySet& ps, const Transform3d& m)
+{
+  return Feature::ExperimentalVxORenderersInstancing.is_enabled() &&
+         ps.getDimension() == 3 && m.matrix().determinant() != 0;
+}
+
 void VBORenderer::resize(int w, int h)
 {
   Renderer::resize(w, h);
@@ -71,6 +78,7 @@ size_t VBORenderer::getSurfaceBufferSize(const std::shared_ptr<CSGProducts>& pro
 {
   size_t buffer_size = 0;
   if (unique_geometry) this->geomVisitMark.clear();
+  this->instanceVisitMark.clear();
 
   for (const auto& product : products->products) {
     for (const auto& csgobj : product.intersections) {
@@ -92,6 +100,15 @@ size_t VBORenderer::getSurfaceBufferSize(const CSGChainObject& csgobj, bool high
   if (csgobj.leaf->geom) {
     const auto *ps = dynamic_cast<const PolySet *>(csgobj.leaf->geom.get());
     if (ps) {
+      // The surface color only depends on the leaf color, flags and mode, so leaves
+      // which are equal in these share a surface in create_surface()
+      const Transform3d& m = csgobj.leaf->matrix;
+      const Color4f& c = csgobj.leaf->color;
+      if (isInstanceable(*ps, m) &&
+          !this->instanceVisitMark.emplace(ps, csgmode, std::array<float, 4>{c[0], c[1], c[2], c[3]},
+                                           csgobj.flags, m.matrix().determinant() < 0).second) {
+        return 0;
+      }
       buffer_size += getSurfaceBufferSize(*ps, csgmode);
     }
   }
@@ -101,7 +118,7 @@ size_t VBORenderer::getSurfaceBufferSize(const CSGChainObject& csgobj, bool high
 size_t VBORenderer::getSurfaceBufferSize(const PolySet& polyset, csgmode_e csgmode) const
 {
   size_t buffer_size = 0;
-  for (const auto& poly : polyset.polygons) {
+  for (const auto& poly : polyset.getPolygons()) {
     if (poly.size() == 3) {
       buffer_size++;
     } else if (poly.size() == 4) {
@@ -119,7 +136,7 @@ size_t VBORenderer::getSurfaceBufferSize(const PolySet& polyset, csgmode_e csgmo
           buffer_size += o.vertices.size() * 2;
         }
       } else {
-        for (const auto& poly : polyset.polygons) {
+        for (const auto& poly : polyset.getPolygons()) {
           buffer_size += poly.size() * 2;
         }
       }
@@ -173,7 +190,7 @@ size_t VBORenderer::getEdgeBufferSize(const PolySet& polyset, csgmode_e csgmode)
       }
     }
   } else if (polyset.getDimension() == 3) {
-    for (const auto& polygon : polyset.polygons) {
+    for (const auto& polygon : polyset.getPolygons()) {
       buffer_size += polygon.size();
     }
   }
@@ -192,6 +209,8 @@ void VBORenderer::add_shader_attributes(VertexArray& vertex_array,
   if (!shader_attributes_index) return;
 
   shared_ptr<VertexData> vertex_data = vertex_array.data();
+  // Edge data of the same array has no shader attributes
+  if (vertex_data->attributes().size() <= shader_attributes_index + BARYCENTRIC_ATTRIB) return;
 
   if (points.size() == 3 && getShader().data.csg_rendering.barycentric) {
     // Get edge states
@@ -326,6 +345,25 @@ void VBORenderer::create_surface(const PolySet& ps, VertexArray& vertex_array,
     create_polygons(ps, vertex_array, csgmode, m, color);
   } else if (ps.getDimension() == 3) {
     VertexStates& vertex_states = vertex_array.states();
+
+    // Repeated geometry is drawn from the vertices of its first instance, with a relative transform
+    const bool instanceable = isInstanceable(ps, m);
+    const VertexArray::SurfaceKey key{&ps, csgmode, {color[0], color[1], color[2], color[3]}, mirrored};
+    if (instanceable) {
+      auto it = vertex_array.surfaceInstances().find(key);
+      if (it != vertex_array.surfaceInstances().end()) {
+        const auto& instance = it->second;
+        std::shared_ptr<VertexState> vs = vertex_array.createVertexState(
+          instance.state->drawMode(), instance.state->drawSize(), instance.state->drawType(),
+          instance.state->drawOffset(), instance.state->elementOffset());
+        vs->glBegin().assign(instance.state->glBegin().begin(), instance.state->glBegin().begin() + instance.begin_size);
+        vs->glEnd().assign(instance.state->glEnd().begin(), instance.state->glEnd().begin() + instance.end_size);
+        vs->transform(std::make_shared<const Transform3d>(m * instance.inverse));
+        vertex_states.emplace_back(std::move(vs));
+        return;
+      }
+    }
+
     std::unordered_map<Vector3d, size_t> vert_mult_map;
     std::vector<Vector3d> mult_verts;
     size_t last_size = vertex_array.verticesOffset();
@@ -336,7 +374,7 @@ void VBORenderer::create_surface(const PolySet& ps, VertexArray& vertex_array,
       vertex_array.elementsMap().clear();
     }
 
-    for (const auto& poly : ps.polygons) {
+    for (const auto& poly : ps.getPolygons()) {
       if (poly.size() == 3) {
         Vector3d p0 = uniqueMultiply(vert_mult_map, mult_verts, poly.at(0), m);
         Vector3d p1 = uniqueMultiply(vert_mult_map, mult_verts, poly.at(1), m);
@@ -381,11 +419,43 @@ void VBORenderer::create_surface(const PolySet& ps, VertexArray& vertex_array,
       vertex_array.writeIndex(), elements_offset);
     vertex_states.emplace_back(std::move(vs));
     vertex_array.addAttributePointers(last_size);
+
+    if (instanceable) {
+      const auto& state = vertex_states.back();
+      vertex_array.surfaceInstances().emplace(key, VertexArray::SurfaceInstance{
+        state, m.inverse(), state->glBegin().size(), state->glEnd().size()});
+    }
   } else {
     assert(false && "Cannot render object with no dimension");
   }
 }
 
+void VBORenderer::create_triangles(size_t count, const std::function<std::array<Vector3d, 3>(size_t)>& triangle,
+                                   VertexArray& vertex_array, const Color4f& color) const
+{
+  if (!vertex_array.data()) return;
+
+  size_t last_size = vertex_array.verticesOffset();
+  size_t elements_offset = 0;
+  if (vertex_array.useElements()) {
+    elements_offset = vertex_array.elementsOffset();
+    vertex_array.elementsMap().clear();
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    const auto pts = triangle(i);
+    create_triangle(vertex_array, color, pts[0], pts[1], pts[2], 0, 0, 3, 3);
+  }
+
+  GLenum elements_type = 0;
+  if (vertex_array.useElements()) elements_type = vertex_array.elementsData()->glType();
+  std::shared_ptr<VertexState> vs = vertex_array.createVertexState(
+    GL_TRIANGLES, count * 3, elements_type,
+    vertex_array.writeIndex(), elements_offset);
+  vertex_array.states().emplace_back(std::move(vs));
+  vertex_array.addAttributePointers(last_size);
+}
+
 void VBORenderer::create_edges(const PolySet& ps,
                                VertexArray& vertex_array, csgmode_e csgmode,
                                const Transform3d& m,
@@ -475,7 +545,7 @@ void VBORenderer::create_edges(const PolySet& ps,
       }
     }
   } else if (ps.getDimension() == 3) {
-    for (const auto& polygon : ps.polygons) {
+    for (const auto& polygon : ps.getPolygons()) {
       size_t last_size = vertex_array.verticesOffset();
       size_t elements_offset = 0;
       if (vertex_array.useElements()) {
@@ -525,7 +595,7 @@ void VBORenderer::create_polygons(const PolySet& ps, VertexArray& vertex_array,
 
     if (csgmode == Renderer::CSGMODE_NONE) {
       PRINTD("create_polygons CSGMODE_NONE");
-      for (const auto& poly : ps.polygons) {
+      for (const auto& poly : ps.getPolygons()) {
         if (poly.size() == 3) {
           Vector3d p0 = uniqueMultiply(vert_mult_map, mult_verts, poly.at(0), m);
           Vector3d p1 = uniqueMultiply(vert_mult_map, mult_verts, poly.at(1), m);
@@ -571,7 +641,7 @@ void VBORenderer::create_polygons(const PolySet& ps, VertexArray& vertex_array,
       double zbase = 1 + ((csgmode & CSGMODE_DIFFERENCE_FLAG) ? 0.1 : 0.0);
       // Render top+bottom
       for (double z : { -zbase / 2, zbase / 2}) {
-        for (const auto& poly : ps.polygons) {
+        for (const auto& poly : ps.getPolygons()) {
           if (poly.size() == 3) {
             Vector3d p0 = poly.at(0); p0[2] += z;
             Vector3d p1 = poly.at(1); p1[2] += z;
@@ -669,7 +739,7 @@ void VBORenderer::create_polygons(const PolySet& ps, VertexArray& vertex_array,
         // If we don't have borders, use the polygons as borders.
         // FIXME: When is this used?
         PRINTD("Render sides with polygons");
-        for (const auto& poly : ps.polygons) {
+        for (const auto& poly : ps.getPolygons()) {
           for (size_t i = 1; i <= poly.size(); i++) {
             Vector3d p1 = poly.at(i - 1); p1[2] -= zbase / 2;
             Vector3d p2 = poly.at(i - 1); p2[2] += zbase / 2;
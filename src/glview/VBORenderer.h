@@ -7,6 +7,8 @@
 #endif
 #include "CSGNode.h"
 #include "VertexArray.h"
+#include <functional>
+#include <set>
 #include <unordered_map>
 #include <boost/functional/hash.hpp>
 
@@ -34,6 +36,10 @@ public:
   virtual void create_surface(const PolySet& ps, VertexArray& vertex_array,
                               csgmode_e csgmode, const Transform3d& m, const Color4f& color) const;
 
+  // Surface of a triangle mesh given by the triangle's vertices, e.g. read from a Manifold mesh
+  virtual void create_triangles(size_t count, const std::function<std::array<Vector3d, 3>(size_t)>& triangle,
+                                VertexArray& vertex_array, const Color4f& color) const;
+
   virtual void create_edges(const PolySet& ps, VertexArray& vertex_array,
                             csgmode_e csgmode, const Transform3d& m, const Color4f& color) const;
 
@@ -63,6 +69,8 @@ protected:
 
   mutable std::unordered_map<std::pair<const Geometry *, const Transform3d *>, int,
                              boost::hash<std::pair<const Geometry *, const Transform3d *>>> geomVisitMark;
+  // Leaves counted when sizing buffers, which will be drawn from the surface of an earlier leaf
+  mutable std::set<std::tuple<const Geometry *, int, std::array<float, 4>, int, bool>> instanceVisitMark;
 
 private:
   void add_shader_attributes(VertexArray& vertex_array,
@@ -112,6 +112,12 @@ void VertexState::draw(bool bind_buffers) const
     GL_TRACE("glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, %d)", elements_vbo_);
     GL_CHECKD(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elements_vbo_));
   }
+  if (transform_) {
+    GL_TRACE0("glPushMatrix()");
+    glPushMatrix();
+    GL_TRACE0("glMultMatrixd(transform)");
+    glMultMatrixd(transform_->data());
+  }
   for (const auto& gl_func : gl_begin_) {
     gl_func();
   }
@@ -153,6 +159,10 @@ void VertexState::draw(bool bind_buffers) const
   for (const auto& gl_func : gl_end_) {
     gl_func();
   }
+  if (transform_) {
+    GL_TRACE0("glPopMatrix()");
+    glPopMatrix();
+  }
   if (elements_vbo_ && bind_buffers) {
     GL_TRACE0("glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0)");
     GL_CHECKD(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
@@ -324,55 +334,33 @@ void VertexArray::fillInterleavedBuffer(std::vector<GLbyte>& interleaved_buffer)
   }
 }
 
-void VertexArray::createInterleavedVBOs()
+void VertexArray::prepareInterleavedBuffer()
 {
+  if (interleaved_prepared_) return;
+  interleaved_prepared_ = true;
+
   for (const auto& state : states_) {
     size_t index = state->drawOffset();
     state->drawOffset(this->indexOffset(index));
   }
 
   // If the upfront size was not known, the the buffer has to be built
-  size_t total_size = this->sizeInBytes();
-  // If VertexArray is not empty, and initial size is zero
-  if (!vertices_size_ && total_size) {
+  if (!vertices_size_) fillInterleavedBuffer(interleaved_buffer_);
+}
+
+void VertexArray::createInterleavedVBOs()
+{
+  prepareInterleavedBuffer();
+
+  if (!vertices_size_ && interleaved_buffer_.size()) {
+    // Upload the whole interleaved buffer at once, rather than one attribute value at a time
     GL_TRACE("glBindBuffer(GL_ARRAY_BUFFER, %d)", vertices_vbo_);
     GL_CHECKD(glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo_));
-    GL_TRACE("glBufferData(GL_ARRAY_BUFFER, %d, %p, GL_STATIC_DRAW)", total_size % (void *)nullptr);
-    GL_CHECKD(glBufferData(GL_ARRAY_BUFFER, total_size, nullptr, GL_STATIC_DRAW));
-
-    size_t dst_start = 0;
-    for (const auto& vertex_data : vertices_) {
-      // All attribute vectors need to be the same size to interleave
-      size_t idx = 0, last_size = 0, stride = vertex_data->stride();
-      for (const auto& data : vertex_data->attributes()) {
-        size_t size = data->sizeofAttribute();
-        const GLbyte *src = data->toBytes();
-        size_t dst = dst_start;
-
-        if (src) {
-          if (idx != 0) {
-            if (last_size != data->size() / data->count()) {
-              PRINTDB("attribute data for vertex incorrect size at index %d = %d", idx % (data->size() / data->count()));
-              PRINTDB("last_size = %d", last_size);
-              assert(false);
-            }
-          }
-          last_size = data->size() / data->count();
-          for (size_t i = 0; i < last_size; ++i) {
-            GL_TRACE("glBufferSubData(GL_ARRAY_BUFFER, %p, %d, %p)", (void *)dst % size % (void *)src);
-            GL_CHECKD(glBufferSubData(GL_ARRAY_BUFFER, dst, size, src));
-            src += size;
-            dst += stride;
-          }
-          dst_start += size;
-        }
-        idx++;
-      }
-      dst_start = vertex_data->sizeInBytes();
-    }
-
+    GL_TRACE("glBufferData(GL_ARRAY_BUFFER, %d, %p, GL_STATIC_DRAW)", interleaved_buffer_.size() % (void *)interleaved_buffer_.data());
+    GL_CHECKD(glBufferData(GL_ARRAY_BUFFER, interleaved_buffer_.size(), interleaved_buffer_.data(), GL_STATIC_DRAW));
     GL_TRACE0("glBindBuffer(GL_ARRAY_BUFFER, 0)");
     GL_CHECKD(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    std::vector<GLbyte>().swap(interleaved_buffer_);
   } else if (vertices_size_ && interleaved_buffer_.size()) {
     GL_TRACE("glBindBuffer(GL_ARRAY_BUFFER, %d)", vertices_vbo_);
     GL_CHECKD(glBindBuffer(GL_ARRAY_BUFFER, vertices_vbo_));
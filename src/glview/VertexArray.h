@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <map>
+#include <tuple>
 #include <unordered_map>
 #include <boost/functional/hash.hpp>
 #include <utility>
@@ -293,6 +296,11 @@ public:
   inline GLuint& verticesVBO() { return vertices_vbo_; }
   inline GLuint& elementsVBO() { return elements_vbo_; }
 
+  // Return the transform applied to the vertex data when drawing, if any
+  [[nodiscard]] inline const std::shared_ptr<const Transform3d>& transform() const { return transform_; }
+  // Set a transform to draw another instance of vertex data written for a different state
+  inline void transform(std::shared_ptr<const Transform3d> transform) { transform_ = std::move(transform); }
+
 private:
   GLenum draw_mode_;
   GLsizei draw_size_;
@@ -303,6 +311,7 @@ private:
   GLuint elements_vbo_;
   std::vector<std::function<void()>> gl_begin_;
   std::vector<std::function<void()>> gl_end_;
+  std::shared_ptr<const Transform3d> transform_;
 };
 // A set of VertexState objects
 using VertexStates = std::vector<std::shared_ptr<VertexState>>;
@@ -326,6 +335,17 @@ public:
 class VertexArray
 {
 public:
+  // Surface of a geometry drawn with the same mode and color, and whether it is mirrored
+  using SurfaceKey = std::tuple<const void *, int, std::array<float, 4>, bool>;
+  // Surface written for the first instance of a geometry, where repeated instances are drawn from
+  struct SurfaceInstance {
+    std::shared_ptr<VertexState> state;
+    Transform3d inverse; // of the transform applied to the written vertices
+    size_t begin_size;
+    size_t end_size;
+  };
+  using SurfaceInstances = std::map<SurfaceKey, SurfaceInstance>;
+
   using CreateVertexCallback = std::function<void (VertexArray& vertex_array,
                                                    const std::array<Vector3d, 3>& points,
                                                    const std::array<Vector3d, 3>& normals,
@@ -433,6 +453,10 @@ public:
   // Create an interleaved buffer and return it as GLbyte array pointer
   void fillInterleavedBuffer(std::vector<GLbyte>& interleaved_buffer) const;
 
+  // Resolve the state offsets and, unless the buffer was sized upfront, interleave the
+  // VertexData into a CPU side buffer. Makes no GL calls, so it can run on a worker thread.
+  void prepareInterleavedBuffer();
+
   // Create an interleaved VBO from the VertexData in the array.
   void createInterleavedVBOs();
 
@@ -464,6 +488,9 @@ public:
   // Return the internal unique vertex/element map
   inline ElementsMap& elementsMap() { return elements_map_; }
 
+  // Return the surfaces that can be drawn again for repeated geometry
+  inline SurfaceInstances& surfaceInstances() { return surface_instances_; }
+
   // Return current vertices offset
   inline size_t verticesOffset() const { return vertices_offset_; }
   // Set current vertices offset
@@ -483,9 +510,11 @@ private:
   bool use_elements_{false};
   std::vector<std::shared_ptr<VertexData>> vertices_;
   std::vector<GLbyte> interleaved_buffer_;
+  bool interleaved_prepared_{false};
   GLuint vertices_vbo_, elements_vbo_;
   size_t vertices_size_{0}, elements_size_{0};
   size_t vertices_offset_{0}, elements_offset_{0};
   VertexData elements_;
   ElementsMap elements_map_;
+  SurfaceInstances surface_instances_;
 };
@@ -0,0 +1,31 @@
+#include "ViewFrustum.h"
+#include "system-gl.h"
+
+ViewFrustum::ViewFrustum(const Eigen::Matrix4d& clip)
+{
+  // Gribb/Hartmann: each plane is the sum or difference of the last row and another row
+  for (int i = 0; i < 3; ++i) {
+    this->planes[2 * i] = clip.row(3).transpose() + clip.row(i).transpose();
+    this->planes[2 * i + 1] = clip.row(3).transpose() - clip.row(i).transpose();
+  }
+}
+
+ViewFrustum ViewFrustum::current()
+{
+  Eigen::Matrix4d projection, modelview;
+  glGetDoublev(GL_PROJECTION_MATRIX, projection.data());
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelview.data());
+  return {projection * modelview};
+}
+
+bool ViewFrustum::isVisible(const BoundingBox& bbox) const
+{
+  if (bbox.isEmpty()) return true;
+  for (const auto& plane : this->planes) {
+    // The corner furthest along the plane normal
+    Vector3d corner;
+    for (int i = 0; i < 3; ++i) corner[i] = plane[i] >= 0 ? bbox.max()[i] : bbox.min()[i];
+    if (plane.head<3>().dot(corner) + plane[3] < 0) return false;
+  }
+  return true;
+}
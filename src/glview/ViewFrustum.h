@@ -0,0 +1,26 @@
+#pragma once
+
+#include "linalg.h"
+
+#include <array>
+
+/*!
+   Clip planes of a view volume, to skip drawing objects which can't be seen.
+   The test is conservative: a box is only rejected if it lies entirely on the
+   outside of one plane.
+ */
+class ViewFrustum
+{
+public:
+  // For clip = projection * modelview
+  ViewFrustum(const Eigen::Matrix4d& clip);
+
+  // Frustum of the current GL projection and modelview matrices
+  static ViewFrustum current();
+
+  // Empty boxes are treated as visible, as their extent is unknown
+  [[nodiscard]] bool isVisible(const BoundingBox& bbox) const;
+
+private:
+  std::array<Eigen::Vector4d, 6> planes;
+};
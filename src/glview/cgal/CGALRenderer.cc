@@ -38,14 +38,15 @@
 #include "CGAL_OGL_VBOPolyhedron.h"
 #include "CGALHybridPolyhedron.h"
 #include "VertexStateManager.h"
+#include "ViewFrustum.h"
 #ifdef ENABLE_MANIFOLD
 #include "ManifoldGeometry.h"
+#include "manifold.h"
 #endif
 
 //#include "Preferences.h"
 
 CGALRenderer::CGALRenderer(const shared_ptr<const class Geometry>& geom)
-  : last_render_state(Feature::ExperimentalVxORenderers.is_enabled()) // FIXME: this is temporary to make switching between renderers seamless.
 {
   this->addGeometry(geom);
 }
@@ -76,7 +77,7 @@ void CGALRenderer::addGeometry(const shared_ptr<const Geometry>& geom)
     this->polysets.push_back(hybrid->toPolySet());
 #ifdef ENABLE_MANIFOLD
   } else if (const auto mani = dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
-    this->polysets.push_back(mani->toPolySet());
+    if (!mani->isEmpty()) this->manifolds.push_back(mani);
 #endif
   } else {
     assert(false && "unsupported geom in CGALRenderer");
@@ -100,24 +101,13 @@ void CGALRenderer::createPolyhedrons()
   PRINTD("createPolyhedrons");
   this->polyhedrons.clear();
 
-  if (!Feature::ExperimentalVxORenderers.is_enabled()) {
-    for (const auto& N : this->nefPolyhedrons) {
-      auto p = new CGAL_OGL_Polyhedron(*this->colorscheme);
-      CGAL::OGL::Nef3_Converter<CGAL_Nef_polyhedron3>::convert_to_OGLPolyhedron(*N->p3, p);
-      // CGAL_NEF3_MARKED_FACET_COLOR <- CGAL_FACE_BACK_COLOR
-      // CGAL_NEF3_UNMARKED_FACET_COLOR <- CGAL_FACE_FRONT_COLOR
-      p->init();
-      this->polyhedrons.push_back(shared_ptr<CGAL_OGL_Polyhedron>(p));
-    }
-  } else {
-    for (const auto& N : this->nefPolyhedrons) {
-      auto p = new CGAL_OGL_VBOPolyhedron(*this->colorscheme);
-      CGAL::OGL::Nef3_Converter<CGAL_Nef_polyhedron3>::convert_to_OGLPolyhedron(*N->p3, p);
-      // CGAL_NEF3_MARKED_FACET_COLOR <- CGAL_FACE_BACK_COLOR
-      // CGAL_NEF3_UNMARKED_FACET_COLOR <- CGAL_FACE_FRONT_COLOR
-      p->init();
-      this->polyhedrons.push_back(shared_ptr<CGAL_OGL_Polyhedron>(p));
-    }
+  for (const auto& N : this->nefPolyhedrons) {
+    auto p = new CGAL_OGL_VBOPolyhedron(*this->colorscheme);
+    CGAL::OGL::Nef3_Converter<CGAL_Nef_polyhedron3>::convert_to_OGLPolyhedron(*N->p3, p);
+    // CGAL_NEF3_MARKED_FACET_COLOR <- CGAL_FACE_BACK_COLOR
+    // CGAL_NEF3_UNMARKED_FACET_COLOR <- CGAL_FACE_FRONT_COLOR
+    p->init();
+    this->polyhedrons.push_back(shared_ptr<CGAL_OGL_Polyhedron>(p));
   }
   PRINTD("createPolyhedrons() end");
 }
@@ -138,6 +128,7 @@ void CGALRenderer::createPolySets()
   PRINTD("createPolySets() polyset");
 
   polyset_states.clear();
+  polyset_ranges.clear();
 
   VertexArray vertex_array(std::make_shared<VertexStateFactory>(), polyset_states);
 
@@ -145,14 +136,20 @@ void CGALRenderer::createPolySets()
 
   vertex_array.addEdgeData();
   vertex_array.addSurfaceData();
+  vertex_array.writeSurface();
+  add_shader_data(vertex_array);
 
 
+  // Buffers are only sized upfront when vertices are written to them directly
   size_t num_vertices = 0;
-  if (this->polysets.size()) {
+  if (Feature::ExperimentalVxORenderersDirect.is_enabled() || Feature::ExperimentalVxORenderersPrealloc.is_enabled()) {
     for (const auto& polyset : this->polysets) {
       num_vertices += getSurfaceBufferSize(*polyset);
       num_vertices += getEdgeBufferSize(*polyset);
     }
+#ifdef ENABLE_MANIFOLD
+    for (const auto& mani : this->manifolds) num_vertices += mani->numFacets() * 3 * 2;
+#endif
   }
 
   vsm.initializeSize(num_vertices);
@@ -201,13 +198,37 @@ void CGALRenderer::createPolySets()
       PRINTD("3d polysets");
       vertex_array.writeSurface();
 
-      // Create 3D polygons
+      // Create 3D polygons, with barycentric coordinates for showing edges
       getColor(ColorMode::MATERIAL, color);
+      vsm.addColor(color);
       this->create_surface(*polyset, vertex_array, CSGMODE_NORMAL, Transform3d::Identity(), color);
     }
+    polyset_ranges.push_back({polyset->getBoundingBox(), polyset_states.size(), polyset->getDimension() == 3});
   }
 
-  if (this->polysets.size()) {
+  bool empty = this->polysets.empty();
+#ifdef ENABLE_MANIFOLD
+  // Manifold meshes are triangulated already, so their vertices are read directly
+  for (const auto& mani : this->manifolds) {
+    vertex_array.writeSurface();
+    Color4f color;
+    getColor(ColorMode::MATERIAL, color);
+    vsm.addColor(color);
+    const manifold::Mesh mesh = mani->getManifold().GetMesh();
+    create_triangles(mesh.triVerts.size(), [&mesh](size_t i) {
+      std::array<Vector3d, 3> pts;
+      for (int j = 0; j < 3; ++j) {
+        const auto& v = mesh.vertPos[mesh.triVerts[i][j]];
+        pts[j] = {v.x, v.y, v.z};
+      }
+      return pts;
+    }, vertex_array, color);
+    polyset_ranges.push_back({mani->getBoundingBox(), polyset_states.size(), true});
+  }
+  empty = empty && this->manifolds.empty();
+#endif
+
+  if (!empty) {
     if (Feature::ExperimentalVxORenderersDirect.is_enabled() || Feature::ExperimentalVxORenderersPrealloc.is_enabled()) {
       if (Feature::ExperimentalVxORenderersIndexing.is_enabled()) {
         GL_TRACE0("glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0)");
@@ -227,9 +248,7 @@ void CGALRenderer::prepare(bool /*showfaces*/, bool /*showedges*/, const shaderi
 {
   PRINTD("prepare()");
   if (!polyset_states.size()) createPolySets();
-  if (!this->nefPolyhedrons.empty() &&
-      (this->polyhedrons.empty() || Feature::ExperimentalVxORenderers.is_enabled() != last_render_state)) // FIXME: this is temporary to make switching between renderers seamless.
-    createPolyhedrons();
+  if (!this->nefPolyhedrons.empty() && this->polyhedrons.empty()) createPolyhedrons();
 
   PRINTD("prepare() end");
 }
@@ -237,62 +256,58 @@ void CGALRenderer::prepare(bool /*showfaces*/, bool /*showedges*/, const shaderi
 void CGALRenderer::draw(bool showfaces, bool showedges, const shaderinfo_t * /*shaderinfo*/) const
 {
   PRINTD("draw()");
-  if (!Feature::ExperimentalVxORenderers.is_enabled()) {
-    for (const auto& polyset : this->polysets) {
-      PRINTD("draw() polyset");
-      if (polyset->getDimension() == 2) {
-        // Draw 2D polygons
-        glDisable(GL_LIGHTING);
-        setColor(ColorMode::CGAL_FACE_2D_COLOR);
-
-        for (const auto& polygon : polyset->polygons) {
-          glBegin(GL_POLYGON);
-          for (const auto& p : polygon) {
-            glVertex3d(p[0], p[1], 0);
-          }
-          glEnd();
-        }
-
-        // Draw 2D edges
-        glDisable(GL_DEPTH_TEST);
-
-        glLineWidth(2);
-        setColor(ColorMode::CGAL_EDGE_2D_COLOR);
-        this->render_edges(*polyset, CSGMODE_NONE);
-        glEnable(GL_DEPTH_TEST);
-      } else {
-        // Draw 3D polygons
-        setColor(ColorMode::MATERIAL);
-        this->render_surface(*polyset, CSGMODE_NORMAL, Transform3d::Identity(), nullptr);
+  const ViewFrustum frustum = ViewFrustum::current();
+
+  // grab current state to restore after
+  GLfloat current_point_size, current_line_width;
+  GLboolean origVertexArrayState = glIsEnabled(GL_VERTEX_ARRAY);
+  GLboolean origNormalArrayState = glIsEnabled(GL_NORMAL_ARRAY);
+  GLboolean origColorArrayState = glIsEnabled(GL_COLOR_ARRAY);
+
+  GL_CHECKD(glGetFloatv(GL_POINT_SIZE, &current_point_size));
+  GL_CHECKD(glGetFloatv(GL_LINE_WIDTH, &current_line_width));
+
+  const auto& shader = getShader();
+  size_t begin = 0;
+  for (const auto& range : polyset_ranges) {
+    const bool edges = showedges && range.shaded && shader.progid;
+    if (frustum.isVisible(range.bbox)) {
+      if (edges) {
+        GL_TRACE("glUseProgram(%d)", shader.progid);
+        GL_CHECKD(glUseProgram(shader.progid));
+        shader_attribs_enable();
+      }
+      for (size_t i = begin; i < range.end; ++i) {
+        const auto& vs = polyset_states[i];
+        if (!vs || (!edges && std::dynamic_pointer_cast<VBOShaderVertexState>(vs))) continue;
+        vs->draw();
+      }
+      if (edges) {
+        shader_attribs_disable();
+        GL_TRACE0("glUseProgram(0)");
+        GL_CHECKD(glUseProgram(0));
       }
     }
-  } else {
-    // grab current state to restore after
-    GLfloat current_point_size, current_line_width;
-    GLboolean origVertexArrayState = glIsEnabled(GL_VERTEX_ARRAY);
-    GLboolean origNormalArrayState = glIsEnabled(GL_NORMAL_ARRAY);
-    GLboolean origColorArrayState = glIsEnabled(GL_COLOR_ARRAY);
-
-    GL_CHECKD(glGetFloatv(GL_POINT_SIZE, &current_point_size));
-    GL_CHECKD(glGetFloatv(GL_LINE_WIDTH, &current_line_width));
-
-    for (const auto& polyset : polyset_states) {
-      if (polyset) polyset->draw();
-    }
+    begin = range.end;
+  }
+  for (size_t i = begin; i < polyset_states.size(); ++i) {
+    if (polyset_states[i]) polyset_states[i]->draw();
+  }
 
-    // restore states
-    GL_TRACE("glPointSize(%d)", current_point_size);
-    GL_CHECKD(glPointSize(current_point_size));
-    GL_TRACE("glLineWidth(%d)", current_line_width);
-    GL_CHECKD(glLineWidth(current_line_width));
+  // restore states
+  GL_TRACE("glPointSize(%d)", current_point_size);
+  GL_CHECKD(glPointSize(current_point_size));
+  GL_TRACE("glLineWidth(%d)", current_line_width);
+  GL_CHECKD(glLineWidth(current_line_width));
 
-    if (!origVertexArrayState) glDisableClientState(GL_VERTEX_ARRAY);
-    if (!origNormalArrayState) glDisableClientState(GL_NORMAL_ARRAY);
-    if (!origColorArrayState) glDisableClientState(GL_COLOR_ARRAY);
-  }
+  if (!origVertexArrayState) glDisableClientState(GL_VERTEX_ARRAY);
+  if (!origNormalArrayState) glDisableClientState(GL_NORMAL_ARRAY);
+  if (!origColorArrayState) glDisableClientState(GL_COLOR_ARRAY);
 
   for (const auto& p : this->getPolyhedrons()) {
-    *const_cast<bool *>(&last_render_state) = Feature::ExperimentalVxORenderers.is_enabled(); // FIXME: this is temporary to make switching between renderers seamless.
+    const CGAL::Bbox_3 cgalbbox = p->bbox();
+    if (!frustum.isVisible(BoundingBox(Vector3d(cgalbbox.xmin(), cgalbbox.ymin(), cgalbbox.zmin()),
+                                       Vector3d(cgalbbox.xmax(), cgalbbox.ymax(), cgalbbox.zmax())))) continue;
     if (showfaces) p->set_style(SNC_BOUNDARY);
     else p->set_style(SNC_SKELETON);
     p->draw(showfaces && showedges);
@@ -314,5 +329,10 @@ BoundingBox CGALRenderer::getBoundingBox() const
   for (const auto& ps : this->polysets) {
     bbox.extend(ps->getBoundingBox());
   }
+#ifdef ENABLE_MANIFOLD
+  for (const auto& mani : this->manifolds) {
+    bbox.extend(mani->getBoundingBox());
+  }
+#endif
   return bbox;
 }
@@ -19,13 +19,22 @@ private:
   const std::list<shared_ptr<class CGAL_OGL_Polyhedron>>& getPolyhedrons() const { return this->polyhedrons; }
   void createPolyhedrons();
   void createPolySets();
-  bool last_render_state; // FIXME: this is temporary to make switching between renderers seamless.
 
   std::list<shared_ptr<class CGAL_OGL_Polyhedron>> polyhedrons;
   std::list<shared_ptr<const class PolySet>> polysets;
   std::list<shared_ptr<const CGAL_Nef_polyhedron>> nefPolyhedrons;
+#ifdef ENABLE_MANIFOLD
+  // Drawn from their meshes, without converting to PolySets
+  std::list<shared_ptr<const class ManifoldGeometry>> manifolds;
+#endif
 
   VertexStates polyset_states;
+  struct PolySetRange {
+    BoundingBox bbox;
+    size_t end; // of its states in polyset_states
+    bool shaded; // edges are drawn from the surface by the edge shader
+  };
+  std::vector<PolySetRange> polyset_ranges;
   GLuint polyset_vertices_vbo{0};
   GLuint polyset_elements_vbo{0};
 };
@@ -1,8 +1,11 @@
 #include <stack>
 
+#include <boost/functional/hash.hpp>
+
 #include "CSGTreeNormalizer.h"
 #include "CSGNode.h"
 #include "printutils.h"
+#include "TimingCounters.h"
 
 // Helper function to debug normalization bugs
 #if 0
@@ -21,14 +24,52 @@ static bool validate_tree(const shared_ptr<CSGNode>& node)
  */
 shared_ptr<CSGNode> CSGTreeNormalizer::normalize(const shared_ptr<CSGNode>& root)
 {
+  TimingCounters::Scope timer(TimingCounters::NORMALIZE);
   this->aborted = false;
   this->nodecount = 0;
   shared_ptr<CSGNode> temp = root;
   temp = normalizePass(temp);
   this->rootnode.reset();
+  this->created.clear();
+  this->normalized.clear();
+  this->active.clear();
   return temp;
 }
 
+size_t CSGTreeNormalizer::OperationHash::operator()(const Operation& op) const
+{
+  size_t hash = static_cast<size_t>(std::get<0>(op));
+  boost::hash_combine(hash, std::get<1>(op));
+  boost::hash_combine(hash, std::get<2>(op));
+  return hash;
+}
+
+/*!
+   Creates a term for the rewrite rules. Rules applied to shared operands
+   create the same terms over and over, these share a single node so they're
+   only normalized once.
+ */
+shared_ptr<CSGNode> CSGTreeNormalizer::createCSGNode(OpenSCADOperator type, const shared_ptr<CSGNode>& left, const shared_ptr<CSGNode>& right)
+{
+  const Operation key{type, left.get(), right.get()};
+  auto it = this->created.find(key);
+  if (it != this->created.end() && !this->active.count(it->second.node.get())) return it->second.node;
+  auto node = CSGOperation::createCSGNode(type, left, right);
+  this->created[key] = {left, right, node};
+  return node;
+}
+
+bool CSGTreeNormalizer::grow(size_t nodes)
+{
+  this->nodecount += nodes;
+  if (this->nodecount > this->limit) {
+    LOG(message_group::Warning, "Normalized tree is growing past %1$d elements. Aborting normalization.\n", this->limit);
+    this->aborted = true;
+    return false;
+  }
+  return true;
+}
+
 /*!
    After aborting, a subtree might have become invalidated (nullptr child node)
    since terms can be instantiated multiple times.
@@ -80,18 +121,30 @@ shared_ptr<CSGNode> CSGTreeNormalizer::normalizePass(shared_ptr<CSGNode> node)
   // stores current node and bool indicating if it was a left or right call;
   using stackframe_t = std::pair<shared_ptr<CSGOperation>, bool>;
   std::stack<stackframe_t> callstack;
+  // The terms being normalized, with the node count and call depth they started at
+  struct Entry {
+    shared_ptr<CSGNode> term;
+    size_t nodecount;
+    size_t depth;
+  };
+  std::stack<Entry> entries;
 
 entrypoint:
   if (dynamic_pointer_cast<CSGLeaf>(node)) goto return_node;
+  {
+    auto it = this->normalized.find(node.get());
+    if (it != this->normalized.end()) {
+      // Shared subterms are normalized once, but count towards the limit wherever they occur
+      if (!grow(it->second.nodes)) return {};
+      node = it->second.result;
+      goto return_node;
+    }
+  }
+  entries.push({node, this->nodecount, callstack.size()});
   do {
     while (node && match_and_replace(node)) {
     }
-    this->nodecount++;
-    if (nodecount > this->limit) {
-      LOG(message_group::Warning, "Normalized tree is growing past %1$d elements. Aborting normalization.\n", this->limit);
-      this->aborted = true;
-      return {};
-    }
+    if (!grow(1)) return {};
     if (!node || dynamic_pointer_cast<CSGLeaf>(node)) goto return_node;
     goto normalize_left_if_op;
 cont_left:;
@@ -110,11 +163,21 @@ cont_right:;
   }
 
 return_node:
+  if (!entries.empty() && entries.top().depth == callstack.size()) {
+    const auto& entry = entries.top();
+    if (!this->aborted) {
+      const size_t nodes = this->nodecount - entry.nodecount;
+      this->normalized.emplace(entry.term.get(), Normalized{entry.term, node, nodes});
+      if (node) this->normalized.emplace(node.get(), Normalized{node, node, nodes});
+    }
+    entries.pop();
+  }
   if (callstack.empty()) {
     return node;
   } else {
     stackframe_t frame = callstack.top();
     callstack.pop();
+    this->active.erase(frame.first.get());
     if (frame.second) { // came from a left call
       frame.first->left() = node;
       node = frame.first;
@@ -128,6 +191,7 @@ return_node:
 normalize_left_if_op:
   if (shared_ptr<CSGOperation> op = dynamic_pointer_cast<CSGOperation>(node)) {
     callstack.emplace(op, true);
+    this->active.insert(op.get());
     node = op->left();
     goto entrypoint;
   }
@@ -136,6 +200,7 @@ normalize_right:
   shared_ptr<CSGOperation> op = dynamic_pointer_cast<CSGOperation>(node);
   assert(op);
   callstack.emplace(op, false);
+  this->active.insert(op.get());
   node = op->right();
   goto entrypoint;
 }
@@ -174,44 +239,44 @@ bool CSGTreeNormalizer::match_and_replace(shared_ptr<CSGNode>& node)
 
     // 1.  x - (y + z) -> (x - y) - z
     if (op->getType() == OpenSCADOperator::DIFFERENCE && rightop->getType() == OpenSCADOperator::UNION) {
-      node = CSGOperation::createCSGNode(OpenSCADOperator::DIFFERENCE,
-                                         CSGOperation::createCSGNode(OpenSCADOperator::DIFFERENCE, x, y),
-                                         z);
+      node = createCSGNode(OpenSCADOperator::DIFFERENCE,
+                           createCSGNode(OpenSCADOperator::DIFFERENCE, x, y),
+                           z);
       return true;
     }
     // 2.  x * (y + z) -> (x * y) + (x * z)
     else if (op->getType() == OpenSCADOperator::INTERSECTION && rightop->getType() == OpenSCADOperator::UNION) {
-      node = CSGOperation::createCSGNode(OpenSCADOperator::UNION,
-                                         CSGOperation::createCSGNode(OpenSCADOperator::INTERSECTION, x, y),
-                                         CSGOperation::createCSGNode(OpenSCADOperator::INTERSECTION, x, z));
+      node = createCSGNode(OpenSCADOperator::UNION,
+                           createCSGNode(OpenSCADOperator::INTERSECTION, x, y),
+                           createCSGNode(OpenSCADOperator::INTERSECTION, x, z));
       return true;
     }
     // 3.  x - (y * z) -> (x - y) + (x - z)
     else if (op->getType() == OpenSCADOperator::DIFFERENCE && rightop->getType() == OpenSCADOperator::INTERSECTION) {
-      node = CSGOperation::createCSGNode(OpenSCADOperator::UNION,
-                                         CSGOperation::createCSGNode(OpenSCADOperator::DIFFERENCE, x, y),
-                                         CSGOperation::createCSGNode(OpenSCADOperator::DIFFERENCE, x, z));
+      node = createCSGNode(OpenSCADOperator::UNION,
+                           createCSGNode(OpenSCADOperator::DIFFERENCE, x, y),
+                           createCSGNode(OpenSCADOperator::DIFFERENCE, x, z));
       return true;
     }
     // 4.  x * (y * z) -> (x * y) * z
     else if (op->getType() == OpenSCADOperator::INTERSECTION && rightop->getType() == OpenSCADOperator::INTERSECTION) {
-      node = CSGOperation::createCSGNode(OpenSCADOperator::INTERSECTION,
-                                         CSGOperation::createCSGNode(OpenSCADOperator::INTERSECTION, x, y),
-                                         z);
+      node = createCSGNode(OpenSCADOperator::INTERSECTION,
+                           createCSGNode(OpenSCADOperator::INTERSECTION, x, y),
+                           z);
       return true;
     }
     // 5.  x - (y - z) -> (x - y) + (x * z)
     else if (op->getType() == OpenSCADOperator::DIFFERENCE && rightop->getType() == OpenSCADOperator::DIFFERENCE) {
-      node = CSGOperation::createCSGNode(OpenSCADOperator::UNION,
-                                         CSGOperation::createCSGNode(OpenSCADOperator::DIFFERENCE, x, y),
-                                         CSGOperation::createCSGNode(OpenSCADOperator::INTERSECTION, x, z));
+      node = createCSGNode(OpenSCADOperator::UNION,
+                           createCSGNode(OpenSCADOperator::DIFFERENCE, x, y),
+                           createCSGNode(OpenSCADOperator::INTERSECTION, x, z));
       return true;
     }
     // 6.  x * (y - z) -> (x * y) - z
     else if (op->getType() == OpenSCADOperator::INTERSECTION && rightop->getType() == OpenSCADOperator::DIFFERENCE) {
-      node = CSGOperation::createCSGNode(OpenSCADOperator::DIFFERENCE,
-                                         CSGOperation::createCSGNode(OpenSCADOperator::INTERSECTION, x, y),
-                                         z);
+      node = createCSGNode(OpenSCADOperator::DIFFERENCE,
+                           createCSGNode(OpenSCADOperator::INTERSECTION, x, y),
+                           z);
       return true;
     }
   }
@@ -225,23 +290,23 @@ bool CSGTreeNormalizer::match_and_replace(shared_ptr<CSGNode>& node)
 
     // 7. (x - y) * z  -> (x * z) - y
     if (leftop->getType() == OpenSCADOperator::DIFFERENCE && op->getType() == OpenSCADOperator::INTERSECTION) {
-      node = CSGOperation::createCSGNode(OpenSCADOperator::DIFFERENCE,
-                                         CSGOperation::createCSGNode(OpenSCADOperator::INTERSECTION, x, z),
-                                         y);
+      node = createCSGNode(OpenSCADOperator::DIFFERENCE,
+                           createCSGNode(OpenSCADOperator::INTERSECTION, x, z),
+                           y);
       return true;
     }
     // 8. (x + y) - z  -> (x - z) + (y - z)
     else if (leftop->getType() == OpenSCADOperator::UNION && op->getType() == OpenSCADOperator::DIFFERENCE) {
-      node = CSGOperation::createCSGNode(OpenSCADOperator::UNION,
-                                         CSGOperation::createCSGNode(OpenSCADOperator::DIFFERENCE, x, z),
-                                         CSGOperation::createCSGNode(OpenSCADOperator::DIFFERENCE, y, z));
+      node = createCSGNode(OpenSCADOperator::UNION,
+                           createCSGNode(OpenSCADOperator::DIFFERENCE, x, z),
+                           createCSGNode(OpenSCADOperator::DIFFERENCE, y, z));
       return true;
     }
     // 9. (x + y) * z  -> (x * z) + (y * z)
     else if (leftop->getType() == OpenSCADOperator::UNION && op->getType() == OpenSCADOperator::INTERSECTION) {
-      node = CSGOperation::createCSGNode(OpenSCADOperator::UNION,
-                                         CSGOperation::createCSGNode(OpenSCADOperator::INTERSECTION, x, z),
-                                         CSGOperation::createCSGNode(OpenSCADOperator::INTERSECTION, y, z));
+      node = createCSGNode(OpenSCADOperator::UNION,
+                           createCSGNode(OpenSCADOperator::INTERSECTION, x, z),
+                           createCSGNode(OpenSCADOperator::INTERSECTION, y, z));
       return true;
     }
   }
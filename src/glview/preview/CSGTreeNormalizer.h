@@ -1,6 +1,11 @@
 #pragma once
 
 #include "memory.h"
+#include "enums.h"
+
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
 
 class CSGTreeNormalizer
 {
@@ -14,10 +19,32 @@ private:
   bool match_and_replace(shared_ptr<class CSGNode>& term);
   shared_ptr<CSGNode> collapse_null_terms(const shared_ptr<CSGNode>& term);
   shared_ptr<CSGNode> cleanup_term(shared_ptr<CSGNode>& t);
+  shared_ptr<CSGNode> createCSGNode(OpenSCADOperator type, const shared_ptr<CSGNode>& left, const shared_ptr<CSGNode>& right);
+  bool grow(size_t nodes);
   [[nodiscard]] unsigned int count(const shared_ptr<CSGNode>& term) const;
 
   bool aborted{false};
   size_t limit;
   size_t nodecount{0};
   shared_ptr<class CSGNode> rootnode;
+
+  // Terms created by the rewrite rules, by operator and operands, so identical subterms are shared
+  using Operation = std::tuple<OpenSCADOperator, const CSGNode *, const CSGNode *>;
+  struct OperationHash {
+    size_t operator()(const Operation& op) const;
+  };
+  struct Created {
+    shared_ptr<CSGNode> left, right; // Keep the operands alive, their addresses are the key
+    shared_ptr<CSGNode> node;
+  };
+  std::unordered_map<Operation, Created, OperationHash> created;
+  // Normalized subterms by the term they were normalized from, with the nodes they counted
+  struct Normalized {
+    shared_ptr<CSGNode> term;
+    shared_ptr<CSGNode> result;
+    size_t nodes;
+  };
+  std::unordered_map<const CSGNode *, Normalized> normalized;
+  // Terms being normalized, which mustn't become their own subterms
+  std::unordered_set<const CSGNode *> active;
 };
@@ -28,10 +28,16 @@
 #include "memory.h"
 #include "OpenCSGRenderer.h"
 
+#include <algorithm>
+#include <numeric>
 #include <utility>
+#include <boost/functional/hash.hpp>
 #include "PolySet.h"
 #include "Feature.h"
 #include "VertexStateManager.h"
+#include "parallel.h"
+#include "ViewFrustum.h"
+#include "OcclusionCuller.h"
 
 #ifdef ENABLE_OPENCSG
 
@@ -75,26 +81,104 @@ private:
 };
 #endif // ENABLE_OPENCSG
 
+OpenCSGVBOProduct::~OpenCSGVBOProduct()
+{
+#ifdef ENABLE_OPENCSG
+  for (auto *primitive : *primitives_) delete primitive;
+#endif
+  if (!vbos_.empty()) glDeleteBuffers(vbos_.size(), vbos_.data());
+}
+
+size_t OpenCSGVBOCache::Key::hash() const
+{
+  size_t seed = 0;
+  boost::hash_combine(seed, highlight_mode);
+  boost::hash_combine(seed, background_mode);
+  for (const auto& leaf : leaves) {
+    boost::hash_combine(seed, leaf.ptr);
+    boost::hash_combine(seed, leaf.index);
+    for (int i = 0; i < 16; ++i) boost::hash_combine(seed, leaf.matrix.data()[i]);
+  }
+  return seed;
+}
+
+bool OpenCSGVBOCache::Key::operator==(const Key& other) const
+{
+  if (highlight_mode != other.highlight_mode || background_mode != other.background_mode ||
+      colors != other.colors || shader != other.shader || leaves.size() != other.leaves.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < leaves.size(); ++i) {
+    const auto& a = leaves[i];
+    const auto& b = other.leaves[i];
+    if (a.ptr != b.ptr || a.geom.expired() || b.geom.expired() || a.index != b.index ||
+        a.subtraction != b.subtraction || a.color != b.color || a.matrix.matrix() != b.matrix.matrix()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::unique_ptr<OpenCSGVBOProduct> OpenCSGVBOCache::take(const Key& key)
+{
+  auto range = entries.equal_range(key.hash());
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.first == key) {
+      auto product = std::move(it->second.second);
+      entries.erase(it);
+      return product;
+    }
+  }
+  return nullptr;
+}
+
+void OpenCSGVBOCache::store(std::vector<Key>&& keys, OpenCSGVBOProducts&& products)
+{
+  assert(keys.size() == products.size());
+  entries.clear();
+  for (size_t i = 0; i < keys.size(); ++i) {
+    size_t hash = keys[i].hash();
+    entries.emplace(hash, std::make_pair(std::move(keys[i]), std::move(products[i])));
+  }
+}
+
 OpenCSGRenderer::OpenCSGRenderer(std::shared_ptr<CSGProducts> root_products,
                                  std::shared_ptr<CSGProducts> highlights_products,
-                                 std::shared_ptr<CSGProducts> background_products)
+                                 std::shared_ptr<CSGProducts> background_products,
+                                 std::shared_ptr<OpenCSGVBOCache> vbo_cache)
   : root_products(std::move(root_products)),
   highlights_products(std::move(highlights_products)),
-  background_products(std::move(background_products))
+  background_products(std::move(background_products)),
+  vbo_cache(std::move(vbo_cache))
+{
+}
+
+OpenCSGRenderer::~OpenCSGRenderer()
+{
+  if (vbo_cache) {
+    vbo_cache->store(std::move(vbo_product_keys), std::move(vbo_vertex_products));
+  }
+}
+
+static std::vector<size_t> allProducts(const CSGProducts& products)
 {
+  std::vector<size_t> indices(products.products.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  return indices;
 }
 
 void OpenCSGRenderer::prepare(bool /*showfaces*/, bool /*showedges*/, const shaderinfo_t *shaderinfo)
 {
-  if (Feature::ExperimentalVxORenderers.is_enabled() && !vbo_vertex_products.size()) {
+  // Batched products are written while drawing
+  if (Feature::ExperimentalVxORenderers.is_enabled() && !this->batch_size && !vbo_vertex_products.size()) {
     if (this->root_products) {
-      createCSGProducts(*this->root_products, shaderinfo, false, false);
+      createCSGProducts(*this->root_products, allProducts(*this->root_products), shaderinfo, false, false);
     }
     if (this->background_products) {
-      createCSGProducts(*this->background_products, shaderinfo, false, true);
+      createCSGProducts(*this->background_products, allProducts(*this->background_products), shaderinfo, false, true);
     }
     if (this->highlights_products) {
-      createCSGProducts(*this->highlights_products, shaderinfo, true, false);
+      createCSGProducts(*this->highlights_products, allProducts(*this->highlights_products), shaderinfo, true, false);
     }
   }
 }
@@ -105,7 +189,7 @@ void OpenCSGRenderer::draw(bool /*showfaces*/, bool showedges, const shaderinfo_
 
   if (!Feature::ExperimentalVxORenderers.is_enabled()) {
     if (this->root_products) {
-      renderCSGProducts(this->root_products, showedges, shaderinfo, false, false);
+      renderCSGProducts(this->root_products, showedges, shaderinfo, false, false, occlusionCuller());
     }
     if (this->background_products) {
       renderCSGProducts(this->background_products, showedges, shaderinfo, false, true);
@@ -113,9 +197,87 @@ void OpenCSGRenderer::draw(bool /*showfaces*/, bool showedges, const shaderinfo_
     if (this->highlights_products) {
       renderCSGProducts(this->highlights_products, showedges, shaderinfo, true, false);
     }
+  } else if (this->batch_size) {
+    // Writing the batches changes the renderer's vertex writing state, but not what is drawn
+    const_cast<OpenCSGRenderer *>(this)->renderBatches(showedges, shaderinfo);
+  } else {
+    renderCSGProducts(std::make_shared<CSGProducts>(), showedges, shaderinfo, false, false, occlusionCuller());
+  }
+}
+
+OcclusionCuller *OpenCSGRenderer::occlusionCuller() const
+{
+  if (!this->culler_checked) {
+    this->culler_checked = true;
+    // Batched products are written anew for every pass, so they aren't culled
+    if (Feature::ExperimentalOcclusionCulling.is_enabled() && !this->batch_size && this->root_products &&
+        OcclusionCuller::isSupported() && OcclusionCuller::canCull(*this->root_products)) {
+      this->culler = std::make_unique<OcclusionCuller>(this->root_products->products.size());
+    }
+  }
+  return this->culler.get();
+}
+
+void OpenCSGRenderer::renderBatches(bool showedges, const Renderer::shaderinfo_t *shaderinfo)
+{
+  const ViewFrustum frustum = ViewFrustum::current();
+  auto renderBatched = [&](const std::shared_ptr<CSGProducts>& products, bool highlight_mode, bool background_mode) {
+      if (!products) return;
+      std::vector<size_t> visible;
+      for (size_t i = 0; i < products->products.size(); ++i) {
+        if (frustum.isVisible(products->products[i].getBoundingBox())) visible.push_back(i);
+      }
+      for (size_t begin = 0; begin < visible.size(); begin += this->batch_size) {
+        const size_t end = std::min(visible.size(), begin + this->batch_size);
+        createCSGProducts(*products, std::vector<size_t>(visible.begin() + begin, visible.begin() + end),
+                          shaderinfo, highlight_mode, background_mode);
+        renderCSGProducts(std::make_shared<CSGProducts>(), showedges, shaderinfo);
+        vbo_vertex_products.clear();
+        vbo_product_keys.clear();
+      }
+    };
+  renderBatched(this->root_products, false, false);
+  renderBatched(this->background_products, false, true);
+  renderBatched(this->highlights_products, true, false);
+}
+
+OpenCSGStrategy OpenCSGStrategy::choose(const OpenCSGPrimitives& primitives)
+{
+  size_t subtractions = 0;
+  unsigned int layers = 0;
+  bool convex = true;
+  for (const auto *primitive : primitives) {
+    if (primitive->getOperation() == OpenCSG::Subtraction) subtractions++;
+    convex = convex && primitive->getConvexity() <= 1;
+    layers += std::max(primitive->getConvexity(), 1u);
+  }
+
+  OpenCSGStrategy strategy;
+  // Up to a few subtractions, SCS draws fewer passes than Goldfeather's layers
+  if (convex && subtractions <= 8) {
+    strategy.algorithm = OpenCSG::SCS;
+    strategy.depth_complexity = primitives.size() > 32 ? OpenCSG::OcclusionQuery : OpenCSG::NoDepthComplexitySampling;
   } else {
-    renderCSGProducts(std::make_shared<CSGProducts>(), showedges, shaderinfo);
+    strategy.algorithm = OpenCSG::Goldfeather;
+    // The sum of the convexities overestimates the layers seen at any pixel, more so with many primitives
+    strategy.depth_complexity = layers > 16 ? OpenCSG::OcclusionQuery : OpenCSG::NoDepthComplexitySampling;
+  }
+  return strategy;
+}
+
+void OpenCSGStrategy::render(const OpenCSGPrimitives& primitives) const
+{
+  const int algorithm = OpenCSG::getOption(OpenCSG::AlgorithmSetting);
+  if (algorithm != OpenCSG::Automatic || this->algorithm == OpenCSG::Automatic) {
+    OpenCSG::render(primitives);
+    return;
   }
+  const int depth_complexity = OpenCSG::getOption(OpenCSG::DepthComplexitySetting);
+  OpenCSG::setOption(OpenCSG::AlgorithmSetting, this->algorithm);
+  OpenCSG::setOption(OpenCSG::DepthComplexitySetting, this->depth_complexity);
+  OpenCSG::render(primitives);
+  OpenCSG::setOption(OpenCSG::AlgorithmSetting, algorithm);
+  OpenCSG::setOption(OpenCSG::DepthComplexitySetting, depth_complexity);
 }
 
 // Primitive for rendering using OpenCSG
@@ -143,35 +305,102 @@ OpenCSGVBOPrim *OpenCSGRenderer::createVBOPrimitive(const std::shared_ptr<OpenCS
   opencsg_vs->glBegin().insert(opencsg_vs->glBegin().begin(), vertex_state->glBegin().begin(), vertex_state->glBegin().begin() + 2);
   // First glEnd entry is the disable vertex position call
   opencsg_vs->glEnd().insert(opencsg_vs->glEnd().begin(), vertex_state->glEnd().begin(), vertex_state->glEnd().begin() + 1);
+  opencsg_vs->transform(vertex_state->transform());
 
   return new OpenCSGVBOPrim(operation, convexity, std::move(opencsg_vs));
 }
 
-void OpenCSGRenderer::createCSGProducts(const CSGProducts& products, const Renderer::shaderinfo_t * /*shaderinfo*/, bool highlight_mode, bool background_mode)
+OpenCSGVBOCache::Key OpenCSGRenderer::productKey(const CSGProduct& product, bool highlight_mode, bool background_mode) const
 {
-  size_t vbo_count = products.products.size();
-  if (vbo_count) {
-    if (Feature::ExperimentalVxORenderersIndexing.is_enabled()) {
-      vbo_count *= 2;
-    }
-    all_vbos_.resize(vbo_count);
-    glGenBuffers(vbo_count, all_vbos_.data());
+  OpenCSGVBOCache::Key key;
+  auto addLeaves = [&key](const std::vector<CSGChainObject>& objects, bool subtraction) {
+      for (const auto& csgobj : objects) {
+        const auto& leaf = csgobj.leaf;
+        if (leaf->geom) key.leaves.push_back({leaf->geom, leaf->geom.get(), leaf->matrix, leaf->color, leaf->index, subtraction});
+      }
+    };
+  addLeaves(product.intersections, false);
+  addLeaves(product.subtractions, true);
+  key.highlight_mode = highlight_mode;
+  key.background_mode = background_mode;
+  const ColorMode modes[] = {ColorMode::MATERIAL, ColorMode::CUTOUT, ColorMode::HIGHLIGHT, ColorMode::BACKGROUND};
+  for (size_t i = 0; i < key.colors.size(); ++i) {
+    key.colors[i] = Color4f(-1.0f, -1.0f, -1.0f, -1.0f);
+    getColor(modes[i], key.colors[i]);
   }
+  const auto& shader = getShader().data.csg_rendering;
+  key.shader = {shader.color_area, shader.color_edge, shader.barycentric};
+  return key;
+}
 
+void OpenCSGRenderer::createCSGProducts(const CSGProducts& products, const std::vector<size_t>& indices,
+                                        const Renderer::shaderinfo_t * /*shaderinfo*/, bool highlight_mode, bool background_mode)
+{
 #ifdef ENABLE_OPENCSG
-  size_t vbo_index = 0;
-  for (const auto& product : products.products) {
-    Color4f last_color;
-    std::unique_ptr<OpenCSGPrimitives> primitives = std::make_unique<OpenCSGPrimitives>();
-    std::unique_ptr<VertexStates> vertex_states = std::make_unique<VertexStates>();
-    VertexArray vertex_array(std::make_shared<OpenCSGVertexStateFactory>(), *(vertex_states.get()),
-                             all_vbos_[vbo_index++]);
-    VertexStateManager vsm(*this, vertex_array);
-    vertex_array.addSurfaceData();
-    vertex_array.writeSurface();
-    add_shader_data(vertex_array);
-
-    size_t num_vertices = 0;
+  // Vertices are written on worker threads, unless they go straight to the GL buffers
+  const bool direct = Feature::ExperimentalVxORenderersDirect.is_enabled() || Feature::ExperimentalVxORenderersPrealloc.is_enabled();
+
+  std::vector<OpenCSGVBOCache::Key> keys;
+  OpenCSGVBOProducts created(indices.size());
+  std::vector<ProductBuild> builds;
+  for (size_t i = 0; i < indices.size(); ++i) {
+    const auto& product = products.products[indices[i]];
+    keys.push_back(productKey(product, highlight_mode, background_mode));
+    if (vbo_cache && !this->batch_size && (created[i] = vbo_cache->take(keys.back()))) continue;
+
+    ProductBuild build{i, &product};
+    build.vbos.resize(Feature::ExperimentalVxORenderersIndexing.is_enabled() ? 2 : 1);
+    glGenBuffers(build.vbos.size(), build.vbos.data());
+    build.primitives = std::make_unique<OpenCSGPrimitives>();
+    build.vertex_states = std::make_unique<VertexStates>();
+    build.vertex_array = std::make_unique<VertexArray>(std::make_shared<OpenCSGVertexStateFactory>(),
+                                                       *build.vertex_states, build.vbos[0]);
+    build.vertex_array->addSurfaceData();
+    build.vertex_array->writeSurface();
+    add_shader_data(*build.vertex_array);
+    builds.emplace_back(std::move(build));
+  }
+
+  if (direct) {
+    for (auto& build : builds) writeVBOProduct(build, highlight_mode, background_mode);
+  } else {
+    std::vector<char> written(builds.size());
+    parallelizable_transform(builds.begin(), builds.end(), written.begin(), [&](ProductBuild& build) {
+      writeVBOProduct(build, highlight_mode, background_mode);
+      build.vertex_array->prepareInterleavedBuffer();
+      return 1;
+    });
+  }
+
+  // Uploads happen on the GL thread
+  for (auto& build : builds) {
+    build.vertex_array->createInterleavedVBOs();
+    created[build.index] = std::make_unique<OpenCSGVBOProduct>(
+      std::move(build.primitives), std::move(build.vertex_states), std::move(build.vbos),
+      build.product->getBoundingBox());
+  }
+  for (size_t i = 0; i < created.size(); ++i) {
+    vbo_vertex_products.emplace_back(std::move(created[i]));
+    vbo_product_keys.emplace_back(std::move(keys[i]));
+  }
+#endif // ENABLE_OPENCSG
+}
+
+#ifdef ENABLE_OPENCSG
+void OpenCSGRenderer::writeVBOProduct(ProductBuild& build, bool highlight_mode, bool background_mode)
+{
+  const CSGProduct& product = *build.product;
+  VertexArray& vertex_array = *build.vertex_array;
+  std::unique_ptr<OpenCSGPrimitives>& primitives = build.primitives;
+  std::unique_ptr<VertexStates>& vertex_states = build.vertex_states;
+  size_t vbo_index = 1;
+  Color4f last_color;
+  VertexStateManager vsm(*this, vertex_array);
+
+  // Buffers are only sized upfront when vertices are written to them directly
+  size_t num_vertices = 0;
+  if (Feature::ExperimentalVxORenderersDirect.is_enabled() || Feature::ExperimentalVxORenderersPrealloc.is_enabled()) {
+    this->instanceVisitMark.clear();
     for (const auto& csgobj : product.intersections) {
       if (csgobj.leaf->geom) {
         num_vertices += getSurfaceBufferSize(csgobj, highlight_mode, background_mode, OpenSCADOperator::INTERSECTION);
@@ -182,162 +411,172 @@ void OpenCSGRenderer::createCSGProducts(const CSGProducts& products, const Rende
         num_vertices += getSurfaceBufferSize(csgobj, highlight_mode, background_mode, OpenSCADOperator::DIFFERENCE);
       }
     }
+  }
 
-    vsm.initializeSize(num_vertices, all_vbos_, vbo_index);
-
-    for (const auto& csgobj : product.intersections) {
-      if (csgobj.leaf->geom) {
-        const auto *ps = dynamic_cast<const PolySet *>(csgobj.leaf->geom.get());
-        if (!ps) continue;
-
-        const Color4f& c = csgobj.leaf->color;
-        csgmode_e csgmode = get_csgmode(highlight_mode, background_mode);
-
-        ColorMode colormode = ColorMode::NONE;
-        if (highlight_mode) {
-          colormode = ColorMode::HIGHLIGHT;
-        } else if (background_mode) {
-          colormode = ColorMode::BACKGROUND;
-        } else {
-          colormode = ColorMode::MATERIAL;
-        }
-
-        Color4f color;
-        if (getShaderColor(colormode, c, color)) {
-          last_color = color;
-        }
-
-        vsm.addColor(last_color);
-
-        if (color[3] == 1.0f) {
-          // object is opaque, draw normally
-          create_surface(*ps, vertex_array, csgmode, csgobj.leaf->matrix, last_color);
-          std::shared_ptr<OpenCSGVertexState> surface = std::dynamic_pointer_cast<OpenCSGVertexState>(vertex_states->back());
-          if (surface != nullptr) {
-            surface->csgObjectIndex(csgobj.leaf->index);
-            primitives->emplace_back(createVBOPrimitive(surface,
-                                                        OpenCSG::Intersection,
-                                                        csgobj.leaf->geom->getConvexity()));
-          }
-        } else {
-          // object is transparent, so draw rear faces first.  Issue #1496
-          std::shared_ptr<VertexState> cull = std::make_shared<VertexState>();
-          cull->glBegin().emplace_back([]() {
-            GL_TRACE0("glEnable(GL_CULL_FACE)"); glEnable(GL_CULL_FACE);
-          });
-          cull->glBegin().emplace_back([]() {
-            GL_TRACE0("glCullFace(GL_FRONT)"); glCullFace(GL_FRONT);
-          });
-          vertex_states->emplace_back(std::move(cull));
-
-          create_surface(*ps, vertex_array, csgmode, csgobj.leaf->matrix, last_color);
-          std::shared_ptr<OpenCSGVertexState> surface = std::dynamic_pointer_cast<OpenCSGVertexState>(vertex_states->back());
-
-          if (surface != nullptr) {
-            surface->csgObjectIndex(csgobj.leaf->index);
-
-            primitives->emplace_back(createVBOPrimitive(surface,
-                                                        OpenCSG::Intersection,
-                                                        csgobj.leaf->geom->getConvexity()));
+  vsm.initializeSize(num_vertices, build.vbos, vbo_index);
 
-            cull = std::make_shared<VertexState>();
-            cull->glBegin().emplace_back([]() {
-              GL_TRACE0("glCullFace(GL_BACK)"); glCullFace(GL_BACK);
-            });
-            vertex_states->emplace_back(std::move(cull));
+  for (const auto& csgobj : product.intersections) {
+    if (csgobj.leaf->geom) {
+      const auto *ps = dynamic_cast<const PolySet *>(csgobj.leaf->geom.get());
+      if (!ps) continue;
 
-            vertex_states->emplace_back(surface);
+      const Color4f& c = csgobj.leaf->color;
+      csgmode_e csgmode = get_csgmode(highlight_mode, background_mode);
 
-            cull = std::make_shared<VertexState>();
-            cull->glEnd().emplace_back([]() {
-              GL_TRACE0("glDisable(GL_CULL_FACE)"); glDisable(GL_CULL_FACE);
-            });
-            vertex_states->emplace_back(std::move(cull));
-          } else {
-            assert(false && "Intersection surface state was nullptr");
-          }
-        }
+      ColorMode colormode = ColorMode::NONE;
+      if (highlight_mode) {
+        colormode = ColorMode::HIGHLIGHT;
+      } else if (background_mode) {
+        colormode = ColorMode::BACKGROUND;
+      } else {
+        colormode = ColorMode::MATERIAL;
       }
-    }
 
-    for (const auto& csgobj : product.subtractions) {
-      if (csgobj.leaf->geom) {
-        const auto *ps = dynamic_cast<const PolySet *>(csgobj.leaf->geom.get());
-        if (!ps) continue;
-        const Color4f& c = csgobj.leaf->color;
-        csgmode_e csgmode = get_csgmode(highlight_mode, background_mode, OpenSCADOperator::DIFFERENCE);
+      Color4f color;
+      if (getShaderColor(colormode, c, color)) {
+        last_color = color;
+      }
 
-        ColorMode colormode = ColorMode::NONE;
-        if (highlight_mode) {
-          colormode = ColorMode::HIGHLIGHT;
-        } else if (background_mode) {
-          colormode = ColorMode::BACKGROUND;
-        } else {
-          colormode = ColorMode::CUTOUT;
-        }
+      vsm.addColor(last_color);
 
-        Color4f color;
-        if (getShaderColor(colormode, c, color)) {
-          last_color = color;
+      if (color[3] == 1.0f) {
+        // object is opaque, draw normally
+        create_surface(*ps, vertex_array, csgmode, csgobj.leaf->matrix, last_color);
+        std::shared_ptr<OpenCSGVertexState> surface = std::dynamic_pointer_cast<OpenCSGVertexState>(vertex_states->back());
+        if (surface != nullptr) {
+          surface->csgObjectIndex(csgobj.leaf->index);
+          primitives->emplace_back(createVBOPrimitive(surface,
+                                                      OpenCSG::Intersection,
+                                                      csgobj.leaf->geom->getConvexity()));
         }
-
-        vsm.addColor(last_color);
-
-        // negative objects should only render rear faces
+      } else {
+        // object is transparent, so draw rear faces first.  Issue #1496
         std::shared_ptr<VertexState> cull = std::make_shared<VertexState>();
         cull->glBegin().emplace_back([]() {
-          GL_TRACE0("glEnable(GL_CULL_FACE)");
-          GL_CHECKD(glEnable(GL_CULL_FACE));
+          GL_TRACE0("glEnable(GL_CULL_FACE)"); glEnable(GL_CULL_FACE);
         });
         cull->glBegin().emplace_back([]() {
-          GL_TRACE0("glCullFace(GL_FRONT)");
-          GL_CHECKD(glCullFace(GL_FRONT));
+          GL_TRACE0("glCullFace(GL_FRONT)"); glCullFace(GL_FRONT);
         });
         vertex_states->emplace_back(std::move(cull));
 
         create_surface(*ps, vertex_array, csgmode, csgobj.leaf->matrix, last_color);
         std::shared_ptr<OpenCSGVertexState> surface = std::dynamic_pointer_cast<OpenCSGVertexState>(vertex_states->back());
+
         if (surface != nullptr) {
           surface->csgObjectIndex(csgobj.leaf->index);
+
           primitives->emplace_back(createVBOPrimitive(surface,
-                                                      OpenCSG::Subtraction,
+                                                      OpenCSG::Intersection,
                                                       csgobj.leaf->geom->getConvexity()));
+
+          cull = std::make_shared<VertexState>();
+          cull->glBegin().emplace_back([]() {
+            GL_TRACE0("glCullFace(GL_BACK)"); glCullFace(GL_BACK);
+          });
+          vertex_states->emplace_back(std::move(cull));
+
+          vertex_states->emplace_back(surface);
+
+          cull = std::make_shared<VertexState>();
+          cull->glEnd().emplace_back([]() {
+            GL_TRACE0("glDisable(GL_CULL_FACE)"); glDisable(GL_CULL_FACE);
+          });
+          vertex_states->emplace_back(std::move(cull));
         } else {
-          assert(false && "Subtraction surface state was nullptr");
+          assert(false && "Intersection surface state was nullptr");
         }
-
-        cull = std::make_shared<VertexState>();
-        cull->glEnd().emplace_back([]() {
-          GL_TRACE0("glDisable(GL_CULL_FACE)");
-          GL_CHECKD(glDisable(GL_CULL_FACE));
-        });
-        vertex_states->emplace_back(std::move(cull));
       }
     }
+  }
 
-    if (Feature::ExperimentalVxORenderersDirect.is_enabled() || Feature::ExperimentalVxORenderersPrealloc.is_enabled()) {
-      if (Feature::ExperimentalVxORenderersIndexing.is_enabled()) {
-        GL_TRACE0("glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0)");
-        GL_CHECKD(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+  for (const auto& csgobj : product.subtractions) {
+    if (csgobj.leaf->geom) {
+      const auto *ps = dynamic_cast<const PolySet *>(csgobj.leaf->geom.get());
+      if (!ps) continue;
+      const Color4f& c = csgobj.leaf->color;
+      csgmode_e csgmode = get_csgmode(highlight_mode, background_mode, OpenSCADOperator::DIFFERENCE);
+
+      ColorMode colormode = ColorMode::NONE;
+      if (highlight_mode) {
+        colormode = ColorMode::HIGHLIGHT;
+      } else if (background_mode) {
+        colormode = ColorMode::BACKGROUND;
+      } else {
+        colormode = ColorMode::CUTOUT;
       }
-      GL_TRACE0("glBindBuffer(GL_ARRAY_BUFFER, 0)");
-      GL_CHECKD(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+      Color4f color;
+      if (getShaderColor(colormode, c, color)) {
+        last_color = color;
+      }
+
+      vsm.addColor(last_color);
+
+      // negative objects should only render rear faces
+      std::shared_ptr<VertexState> cull = std::make_shared<VertexState>();
+      cull->glBegin().emplace_back([]() {
+        GL_TRACE0("glEnable(GL_CULL_FACE)");
+        GL_CHECKD(glEnable(GL_CULL_FACE));
+      });
+      cull->glBegin().emplace_back([]() {
+        GL_TRACE0("glCullFace(GL_FRONT)");
+        GL_CHECKD(glCullFace(GL_FRONT));
+      });
+      vertex_states->emplace_back(std::move(cull));
+
+      create_surface(*ps, vertex_array, csgmode, csgobj.leaf->matrix, last_color);
+      std::shared_ptr<OpenCSGVertexState> surface = std::dynamic_pointer_cast<OpenCSGVertexState>(vertex_states->back());
+      if (surface != nullptr) {
+        surface->csgObjectIndex(csgobj.leaf->index);
+        primitives->emplace_back(createVBOPrimitive(surface,
+                                                    OpenCSG::Subtraction,
+                                                    csgobj.leaf->geom->getConvexity()));
+      } else {
+        assert(false && "Subtraction surface state was nullptr");
+      }
+
+      cull = std::make_shared<VertexState>();
+      cull->glEnd().emplace_back([]() {
+        GL_TRACE0("glDisable(GL_CULL_FACE)");
+        GL_CHECKD(glDisable(GL_CULL_FACE));
+      });
+      vertex_states->emplace_back(std::move(cull));
     }
+  }
 
-    vertex_array.createInterleavedVBOs();
-    vbo_vertex_products.emplace_back(std::make_unique<OpenCSGVBOProduct>(
-                                       std::move(primitives), std::move(vertex_states)));
+  if (Feature::ExperimentalVxORenderersDirect.is_enabled() || Feature::ExperimentalVxORenderersPrealloc.is_enabled()) {
+    if (Feature::ExperimentalVxORenderersIndexing.is_enabled()) {
+      GL_TRACE0("glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0)");
+      GL_CHECKD(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+    }
+    GL_TRACE0("glBindBuffer(GL_ARRAY_BUFFER, 0)");
+    GL_CHECKD(glBindBuffer(GL_ARRAY_BUFFER, 0));
   }
-#endif // ENABLE_OPENCSG
 }
+#endif // ENABLE_OPENCSG
 
 void OpenCSGRenderer::renderCSGProducts(const std::shared_ptr<CSGProducts>& products, bool showedges,
                                         const Renderer::shaderinfo_t *shaderinfo,
-                                        bool highlight_mode, bool background_mode) const
+                                        bool highlight_mode, bool background_mode, OcclusionCuller *culler) const
 {
 #ifdef ENABLE_OPENCSG
+  const ViewFrustum frustum = ViewFrustum::current();
+  // The culled products in the view, tested once all are drawn
+  std::vector<std::pair<size_t, BoundingBox>> tested;
+  auto isCulled = [&](size_t i, const BoundingBox& bbox) {
+      if (!frustum.isVisible(bbox)) {
+        if (culler && i < culler->size()) culler->setVisible(i);
+        return true;
+      }
+      if (!culler || i >= culler->size()) return false;
+      tested.emplace_back(i, bbox);
+      return culler->isHidden(i);
+    };
   if (!Feature::ExperimentalVxORenderers.is_enabled()) {
-    for (const auto& product : products->products) {
+    for (size_t i = 0; i < products->products.size(); ++i) {
+      const auto& product = products->products[i];
+      if (isCulled(i, product.getBoundingBox())) continue;
       std::vector<OpenCSG::Primitive *> primitives;
       for (const auto& csgobj : product.intersections) {
         if (csgobj.leaf->geom) primitives.push_back(createCSGPrimitive(csgobj, OpenCSG::Intersection, highlight_mode, background_mode, OpenSCADOperator::INTERSECTION));
@@ -346,7 +585,9 @@ void OpenCSGRenderer::renderCSGProducts(const std::shared_ptr<CSGProducts>& prod
         if (csgobj.leaf->geom) primitives.push_back(createCSGPrimitive(csgobj, OpenCSG::Subtraction, highlight_mode, background_mode, OpenSCADOperator::DIFFERENCE));
       }
       if (primitives.size() > 1) {
-        OpenCSG::render(primitives);
+        auto it = this->strategies.find(&product);
+        if (it == this->strategies.end()) it = this->strategies.emplace(&product, OpenCSGStrategy::choose(primitives)).first;
+        it->second.render(primitives);
         GL_CHECKD(glDepthFunc(GL_EQUAL));
       }
 
@@ -431,9 +672,11 @@ void OpenCSGRenderer::renderCSGProducts(const std::shared_ptr<CSGProducts>& prod
       glDepthFunc(GL_LEQUAL);
     }
   } else {
-    for (const auto& product : vbo_vertex_products) {
+    for (size_t i = 0; i < vbo_vertex_products.size(); ++i) {
+      const auto& product = vbo_vertex_products[i];
+      if (isCulled(i, product->bbox())) continue;
       if (product->primitives().size() > 1) {
-        GL_CHECKD(OpenCSG::render(product->primitives()));
+        GL_CHECKD(product->strategy().render(product->primitives()));
         GL_TRACE0("glDepthFunc(GL_EQUAL)");
         GL_CHECKD(glDepthFunc(GL_EQUAL));
       }
@@ -482,6 +725,12 @@ void OpenCSGRenderer::renderCSGProducts(const std::shared_ptr<CSGProducts>& prod
     }
   }
 
+  // Picking draws the same products, and needn't test them again
+  if (!tested.empty() && !(shaderinfo && shaderinfo->type == SELECT_RENDERING)) {
+    culler->beginQueries();
+    for (const auto& test : tested) culler->query(test.first, test.second);
+    culler->endQueries();
+  }
 #endif // ENABLE_OPENCSG
 }
 
@@ -8,9 +8,13 @@
 #include "CSGNode.h"
 
 #include "VBORenderer.h"
+#include <map>
+#include <unordered_map>
 
 class CSGChainObject;
+class CSGProduct;
 class CSGProducts;
+class OcclusionCuller;
 class OpenCSGPrim;
 class OpenCSGVBOPrim;
 
@@ -56,35 +60,104 @@ public:
 };
 
 using OpenCSGPrimitives = std::vector<OpenCSG::Primitive *>;
+
+/*!
+   The OpenCSG algorithm and depth complexity mode for drawing one product,
+   chosen from its primitives when OpenCSG isn't forced to one algorithm.
+   SCS is only correct for convex primitives, and needs a pass per subtraction
+   for every subtraction, while Goldfeather needs a pass per layer of depth
+   complexity; counting the layers by occlusion queries pays off only with
+   many primitives.
+ */
+struct OpenCSGStrategy {
+  OpenCSG::Algorithm algorithm{OpenCSG::Automatic};
+  OpenCSG::DepthComplexityAlgorithm depth_complexity{OpenCSG::NoDepthComplexitySampling};
+
+  static OpenCSGStrategy choose(const OpenCSGPrimitives& primitives);
+  // Renders the primitives with the strategy, unless the global setting forces another algorithm
+  void render(const OpenCSGPrimitives& primitives) const;
+};
+
 class OpenCSGVBOProduct
 {
 public:
-  OpenCSGVBOProduct(std::unique_ptr<OpenCSGPrimitives> primitives, std::unique_ptr<VertexStates> states)
-    : primitives_(std::move(primitives)), states_(std::move(states)) {}
-  virtual ~OpenCSGVBOProduct() = default;
+  OpenCSGVBOProduct(std::unique_ptr<OpenCSGPrimitives> primitives, std::unique_ptr<VertexStates> states,
+                    std::vector<GLuint> vbos, const BoundingBox& bbox)
+    : primitives_(std::move(primitives)), states_(std::move(states)), vbos_(std::move(vbos)), bbox_(bbox),
+    strategy_(OpenCSGStrategy::choose(*primitives_)) {}
+  virtual ~OpenCSGVBOProduct();
 
   [[nodiscard]] const OpenCSGPrimitives& primitives() const { return *(primitives_.get()); }
   [[nodiscard]] const VertexStates& states() const { return *(states_.get()); }
+  // Bounds of what the product can draw, for culling against the view
+  [[nodiscard]] const BoundingBox& bbox() const { return bbox_; }
+  [[nodiscard]] const OpenCSGStrategy& strategy() const { return strategy_; }
 
 private:
   const std::unique_ptr<OpenCSGPrimitives> primitives_;
   const std::unique_ptr<VertexStates> states_;
+  const std::vector<GLuint> vbos_;
+  const BoundingBox bbox_;
+  const OpenCSGStrategy strategy_;
 };
 using OpenCSGVBOProducts = std::vector<std::unique_ptr<OpenCSGVBOProduct>>;
 
+/*!
+   Products of the previous renderer, kept across recompiles. A product drawing the
+   same leaves again is handed to the next renderer, instead of writing and
+   uploading its vertices again.
+ */
+class OpenCSGVBOCache
+{
+public:
+  struct Leaf {
+    std::weak_ptr<const Geometry> geom;
+    const Geometry *ptr;
+    Transform3d matrix;
+    Color4f color;
+    int index;
+    bool subtraction;
+  };
+
+  // The leaves of a product, and the renderer state their vertices were written with
+  struct Key {
+    std::vector<Leaf> leaves;
+    bool highlight_mode;
+    bool background_mode;
+    std::array<Color4f, 4> colors;
+    std::array<int, 3> shader;
+
+    [[nodiscard]] size_t hash() const;
+    bool operator==(const Key& other) const;
+  };
+
+  // Returns the product for the key, if it was stored and all its geometries are still alive
+  std::unique_ptr<OpenCSGVBOProduct> take(const Key& key);
+  // Replaces the cached products
+  void store(std::vector<Key>&& keys, OpenCSGVBOProducts&& products);
+  void clear() { entries.clear(); }
+
+private:
+  std::multimap<size_t, std::pair<Key, std::unique_ptr<OpenCSGVBOProduct>>> entries;
+};
+
 class OpenCSGRenderer : public VBORenderer
 {
 public:
   OpenCSGRenderer(std::shared_ptr<CSGProducts> root_products,
                   std::shared_ptr<CSGProducts> highlights_products,
-                  std::shared_ptr<CSGProducts> background_products);
-  ~OpenCSGRenderer() override {
-    if (all_vbos_.size()) {
-      glDeleteBuffers(all_vbos_.size(), all_vbos_.data());
-    }
-  }
+                  std::shared_ptr<CSGProducts> background_products,
+                  std::shared_ptr<OpenCSGVBOCache> vbo_cache = nullptr);
+  ~OpenCSGRenderer() override;
   void prepare(bool showfaces, bool showedges, const shaderinfo_t *shaderinfo = nullptr) override;
   void draw(bool showfaces, bool showedges, const shaderinfo_t *shaderinfo = nullptr) const override;
+  /*!
+     Draws the products in passes of at most batch_size visible products, whose vertex
+     buffers are written for the pass and released once it is drawn. This keeps memory
+     bounded for huge product counts, at the cost of writing the vertices on every draw.
+     0 keeps the buffers of all products.
+   */
+  void setBatchSize(size_t batch_size) { this->batch_size = batch_size; }
 
   BoundingBox getBoundingBox() const override;
 private:
@@ -92,14 +165,40 @@ private:
   OpenCSGPrim *createCSGPrimitive(const CSGChainObject& csgobj, OpenCSG::Operation operation, bool highlight_mode, bool background_mode, OpenSCADOperator type) const;
   OpenCSGVBOPrim *createVBOPrimitive(const std::shared_ptr<OpenCSGVertexState>& vertex_state,
                                      const OpenCSG::Operation operation, const unsigned int convexity) const;
+
+  // A product whose vertices are written, but not uploaded yet
+  struct ProductBuild {
+    size_t index;
+    const CSGProduct *product;
+    std::vector<GLuint> vbos;
+    std::unique_ptr<OpenCSGPrimitives> primitives;
+    std::unique_ptr<VertexStates> vertex_states;
+    std::unique_ptr<VertexArray> vertex_array;
+  };
+  // Writes the vertices and states of the product. Makes no GL calls unless writing directly to buffers.
+  void writeVBOProduct(ProductBuild& build, bool highlight_mode, bool background_mode);
 #endif // ENABLE_OPENCSG
-  void createCSGProducts(const CSGProducts& products, const Renderer::shaderinfo_t *shaderinfo, bool highlight_mode, bool background_mode);
+  void createCSGProducts(const CSGProducts& products, const std::vector<size_t>& indices,
+                         const Renderer::shaderinfo_t *shaderinfo, bool highlight_mode, bool background_mode);
+  void renderBatches(bool showedges, const Renderer::shaderinfo_t *shaderinfo);
+  OpenCSGVBOCache::Key productKey(const CSGProduct& product, bool highlight_mode, bool background_mode) const;
+  // Products [0, culler size) are skipped while the culler finds them hidden
   void renderCSGProducts(const std::shared_ptr<CSGProducts>& products, bool showedges = false, const Renderer::shaderinfo_t *shaderinfo = nullptr,
-                         bool highlight_mode = false, bool background_mode = false) const;
+                         bool highlight_mode = false, bool background_mode = false, OcclusionCuller *culler = nullptr) const;
+  // The culler of the root products, if occlusion culling applies
+  OcclusionCuller *occlusionCuller() const;
 
   OpenCSGVBOProducts vbo_vertex_products;
-  std::vector<GLuint> all_vbos_;
+  std::vector<OpenCSGVBOCache::Key> vbo_product_keys;
+  std::shared_ptr<OpenCSGVBOCache> vbo_cache;
   std::shared_ptr<CSGProducts> root_products;
   std::shared_ptr<CSGProducts> highlights_products;
   std::shared_ptr<CSGProducts> background_products;
+  size_t batch_size{0};
+#ifdef ENABLE_OPENCSG
+  // Chosen on the first draw of each product and kept for the following frames
+  mutable std::unordered_map<const CSGProduct *, OpenCSGStrategy> strategies;
+#endif
+  mutable std::unique_ptr<OcclusionCuller> culler;
+  mutable bool culler_checked{false};
 };
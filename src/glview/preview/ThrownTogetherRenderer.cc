@@ -28,9 +28,11 @@
 
 #include <utility>
 #include "Feature.h"
+#include "OcclusionCuller.h"
 #include "PolySet.h"
 #include "printutils.h"
 #include "VertexStateManager.h"
+#include "ViewFrustum.h"
 
 #include "system-gl.h"
 
@@ -85,6 +87,7 @@ void ThrownTogetherRenderer::prepare(bool /*showfaces*/, bool /*showedges*/, con
     vertex_array.createInterleavedVBOs();
     vertices_vbo = vertex_array.verticesVBO();
     elements_vbo = vertex_array.elementsVBO();
+    if (!elements_vbo) createBatchedStates(vertex_array.data()->stride());
   }
 }
 
@@ -104,13 +107,42 @@ void ThrownTogetherRenderer::draw(bool /*showfaces*/, bool showedges, const Rend
 
   if (!Feature::ExperimentalVxORenderers.is_enabled()) {
     if (this->root_products) {
+      if (!this->culler_checked) {
+        this->culler_checked = true;
+        if (Feature::ExperimentalOcclusionCulling.is_enabled() && OcclusionCuller::isSupported() &&
+            OcclusionCuller::canCull(*this->root_products)) {
+          this->culler = std::make_unique<OcclusionCuller>(this->root_products->products.size());
+        }
+      }
+      // Decided once for both passes, as results may arrive in between
+      std::vector<char> hidden;
+      if (this->culler) {
+        const ViewFrustum frustum = ViewFrustum::current();
+        hidden.resize(this->root_products->products.size());
+        for (size_t i = 0; i < hidden.size(); ++i) {
+          if (frustum.isVisible(this->root_products->products[i].getBoundingBox(true))) {
+            hidden[i] = this->culler->isHidden(i);
+          } else {
+            this->culler->setVisible(i);
+            hidden[i] = 2; // Not tested
+          }
+        }
+      }
       glEnable(GL_CULL_FACE);
       glCullFace(GL_BACK);
-      renderCSGProducts(this->root_products, showedges, shaderinfo, false, false, false);
+      renderCSGProducts(this->root_products, showedges, shaderinfo, false, false, false, this->culler ? &hidden : nullptr);
       glCullFace(GL_FRONT);
       glColor3ub(255, 0, 255);
-      renderCSGProducts(this->root_products, showedges, shaderinfo, false, false, true);
+      renderCSGProducts(this->root_products, showedges, shaderinfo, false, false, true, this->culler ? &hidden : nullptr);
       glDisable(GL_CULL_FACE);
+      if (this->culler && !(shaderinfo && shaderinfo->type == Renderer::SELECT_RENDERING)) {
+        this->culler->beginQueries();
+        for (size_t i = 0; i < hidden.size(); ++i) {
+          if (hidden[i] != 2) this->culler->query(i, this->root_products->products[i].getBoundingBox(true));
+        }
+        this->culler->endQueries();
+        if (shaderinfo && shaderinfo->progid) glUseProgram(shaderinfo->progid);
+      }
     }
     if (this->background_products) renderCSGProducts(this->background_products, showedges, shaderinfo, false, true, false);
     if (this->highlight_products) renderCSGProducts(this->highlight_products, showedges, shaderinfo, true, false, false);
@@ -164,14 +196,16 @@ void ThrownTogetherRenderer::renderChainObject(const CSGChainObject& csgobj, boo
 void ThrownTogetherRenderer::renderCSGProducts(const std::shared_ptr<CSGProducts>& products, bool showedges,
                                                const Renderer::shaderinfo_t *shaderinfo,
                                                bool highlight_mode, bool background_mode,
-                                               bool fberror) const
+                                               bool fberror, const std::vector<char> *hidden) const
 {
   PRINTD("Thrown renderCSGProducts");
   glDepthFunc(GL_LEQUAL);
   this->geomVisitMark.clear();
 
   if (!Feature::ExperimentalVxORenderers.is_enabled()) {
-    for (const auto& product : products->products) {
+    for (size_t i = 0; i < products->products.size(); ++i) {
+      if (hidden && (*hidden)[i] == 1) continue;
+      const auto& product = products->products[i];
       for (const auto& csgobj : product.intersections) {
         renderChainObject(csgobj, showedges, shaderinfo, highlight_mode, background_mode, fberror, OpenSCADOperator::INTERSECTION);
       }
@@ -180,7 +214,9 @@ void ThrownTogetherRenderer::renderCSGProducts(const std::shared_ptr<CSGProducts
       }
     }
   } else {
-    for (const auto& vs : vertex_states) {
+    const bool select = shaderinfo && shaderinfo->type == Renderer::SELECT_RENDERING;
+    const auto& states = (showedges || select || batched_states.empty()) ? vertex_states : batched_states;
+    for (const auto& vs : states) {
       if (vs) {
         std::shared_ptr<TTRVertexState> csg_vs = std::dynamic_pointer_cast<TTRVertexState>(vs);
         if (csg_vs) {
@@ -207,7 +243,7 @@ void ThrownTogetherRenderer::renderCSGProducts(const std::shared_ptr<CSGProducts
 
 void ThrownTogetherRenderer::createChainObject(VertexArray& vertex_array,
                                                const CSGChainObject& csgobj, bool highlight_mode,
-                                               bool background_mode, OpenSCADOperator type)
+                                               bool background_mode, bool fberror, OpenSCADOperator type)
 {
   if (csgobj.leaf->geom) {
     const auto *ps = dynamic_cast<const PolySet *>(csgobj.leaf->geom.get());
@@ -223,64 +259,20 @@ void ThrownTogetherRenderer::createChainObject(VertexArray& vertex_array,
 
     VertexStateManager vsm(*this, vertex_array); // Currently, choosing to create a new VSM instead of trying to reuse the one from ThrownTogetherRenderer::prepare
 
-    if (highlight_mode || background_mode) {
-      const ColorMode colormode = getColorMode(csgobj.flags, highlight_mode, background_mode, false, type);
-      getShaderColor(colormode, leaf_color, color);
-
-      vsm.addColor(color);
-
-      create_surface(*ps, vertex_array, csgmode, csgobj.leaf->matrix, color);
-      std::shared_ptr<TTRVertexState> vs = std::dynamic_pointer_cast<TTRVertexState>(vertex_array.states().back());
-      if (vs) {
-        vs->csgObjectIndex(csgobj.leaf->index);
-      }
-    } else { // root mode
-      ColorMode colormode = getColorMode(csgobj.flags, highlight_mode, background_mode, false, type);
-      getShaderColor(colormode, leaf_color, color);
-
-      vsm.addColor(color);
-
-      std::shared_ptr<VertexState> cull = std::make_shared<VertexState>();
-      cull->glBegin().emplace_back([]() {
-        GL_TRACE0("glEnable(GL_CULL_FACE)");
-        GL_CHECKD(glEnable(GL_CULL_FACE));
-      });
-      cull->glBegin().emplace_back([]() {
-        GL_TRACE0("glCullFace(GL_BACK)");
-        GL_CHECKD(glCullFace(GL_BACK));
-      });
-      vertex_states.emplace_back(std::move(cull));
-
-      create_surface(*ps, vertex_array, csgmode, csgobj.leaf->matrix, color);
-      std::shared_ptr<TTRVertexState> vs = std::dynamic_pointer_cast<TTRVertexState>(vertex_array.states().back());
-      if (vs) {
-        vs->csgObjectIndex(csgobj.leaf->index);
-      }
-
+    ColorMode colormode = getColorMode(csgobj.flags, highlight_mode, background_mode, false, type);
+    getShaderColor(colormode, leaf_color, color);
+    if (fberror) {
       color[0] = 1.0; color[1] = 0.0; color[2] = 1.0; // override leaf color on front/back error
-
       colormode = getColorMode(csgobj.flags, highlight_mode, background_mode, true, type);
       getShaderColor(colormode, leaf_color, color);
+    }
 
-      vsm.addColor(color);
-
-      cull = std::make_shared<VertexState>();
-      cull->glBegin().emplace_back([]() {
-        GL_TRACE0("glCullFace(GL_FRONT)");
-        GL_CHECKD(glCullFace(GL_FRONT));
-      });
-      vertex_states.emplace_back(std::move(cull));
-
-      create_surface(*ps, vertex_array, csgmode, csgobj.leaf->matrix, color);
-      vs = std::dynamic_pointer_cast<TTRVertexState>(vertex_array.states().back());
-      if (vs) {
-        vs->csgObjectIndex(csgobj.leaf->index);
-      }
+    vsm.addColor(color);
 
-      vertex_states.back()->glEnd().emplace_back([]() {
-        GL_TRACE0("glDisable(GL_CULL_FACE)");
-        GL_CHECKD(glDisable(GL_CULL_FACE));
-      });
+    create_surface(*ps, vertex_array, csgmode, csgobj.leaf->matrix, color);
+    std::shared_ptr<TTRVertexState> vs = std::dynamic_pointer_cast<TTRVertexState>(vertex_array.states().back());
+    if (vs) {
+      vs->csgObjectIndex(csgobj.leaf->index);
     }
   }
 }
@@ -288,16 +280,80 @@ void ThrownTogetherRenderer::createChainObject(VertexArray& vertex_array,
 void ThrownTogetherRenderer::createCSGProducts(const CSGProducts& products, VertexArray& vertex_array,
                                                bool highlight_mode, bool background_mode)
 {
-  PRINTD("Thrown renderCSGProducts");
-  this->geomVisitMark.clear();
+  PRINTD("Thrown createCSGProducts");
+  auto create = [&](bool fberror) {
+      this->geomVisitMark.clear();
+      for (const auto& product : products.products) {
+        for (const auto& csgobj : product.intersections) {
+          createChainObject(vertex_array, csgobj, highlight_mode, background_mode, fberror, OpenSCADOperator::INTERSECTION);
+        }
+        for (const auto& csgobj : product.subtractions) {
+          createChainObject(vertex_array, csgobj, highlight_mode, background_mode, fberror, OpenSCADOperator::DIFFERENCE);
+        }
+      }
+    };
+  if (highlight_mode || background_mode) {
+    create(false);
+    return;
+  }
+
+  // Root objects are drawn with back faces culled, then once more in the error color with
+  // front faces culled. Each pass covers all objects, so its surfaces are adjacent in the buffer.
+  auto cull = std::make_shared<VertexState>();
+  cull->glBegin().emplace_back([]() {
+    GL_TRACE0("glEnable(GL_CULL_FACE)");
+    GL_CHECKD(glEnable(GL_CULL_FACE));
+  });
+  cull->glBegin().emplace_back([]() {
+    GL_TRACE0("glCullFace(GL_BACK)");
+    GL_CHECKD(glCullFace(GL_BACK));
+  });
+  vertex_states.emplace_back(std::move(cull));
+  create(false);
+
+  cull = std::make_shared<VertexState>();
+  cull->glBegin().emplace_back([]() {
+    GL_TRACE0("glCullFace(GL_FRONT)");
+    GL_CHECKD(glCullFace(GL_FRONT));
+  });
+  vertex_states.emplace_back(std::move(cull));
+  create(true);
+
+  cull = std::make_shared<VertexState>();
+  cull->glBegin().emplace_back([]() {
+    GL_TRACE0("glDisable(GL_CULL_FACE)");
+    GL_CHECKD(glDisable(GL_CULL_FACE));
+  });
+  vertex_states.emplace_back(std::move(cull));
+}
 
-  for (const auto& product : products.products) {
-    for (const auto& csgobj : product.intersections) {
-      createChainObject(vertex_array, csgobj, highlight_mode, background_mode, OpenSCADOperator::INTERSECTION);
+// Surfaces carry their color per vertex, so consecutive surfaces of the same
+// draw mode which follow each other in the vertex buffer can share one draw call.
+// The color uniform states in between are only used for edges and are left out.
+void ThrownTogetherRenderer::createBatchedStates(size_t stride)
+{
+  batched_states.clear();
+  std::shared_ptr<TTRVertexState> batch;
+  for (const auto& vs : vertex_states) {
+    if (!vs || std::dynamic_pointer_cast<VBOShaderVertexState>(vs)) continue;
+    auto surface = std::dynamic_pointer_cast<TTRVertexState>(vs);
+    if (!surface || surface->drawSize() <= 0 || surface->transform() || surface->drawMode() != GL_TRIANGLES) {
+      batched_states.emplace_back(vs);
+      batch.reset();
+      continue;
     }
-    for (const auto& csgobj : product.subtractions) {
-      createChainObject(vertex_array, csgobj, highlight_mode, background_mode, OpenSCADOperator::DIFFERENCE);
+    if (batch && batch->drawOffset() + batch->drawSize() * stride == surface->drawOffset()) {
+      batch->drawSize(batch->drawSize() + surface->drawSize());
+      batch->glEnd() = surface->glEnd();
+      continue;
     }
+    // Attribute pointers set up by glBegin refer to the first surface, which starts the batch
+    batch = std::make_shared<TTRVertexState>(surface->drawMode(), surface->drawSize(), surface->drawType(),
+                                             surface->drawOffset(), surface->elementOffset(),
+                                             surface->verticesVBO(), surface->elementsVBO());
+    batch->glBegin() = surface->glBegin();
+    batch->glEnd() = surface->glEnd();
+    batched_states.emplace_back(batch);
   }
 }
 
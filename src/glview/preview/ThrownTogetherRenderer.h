@@ -7,6 +7,7 @@
 
 class CSGProducts;
 class CSGChainObject;
+class OcclusionCuller;
 
 class TTRVertexState : public VertexState
 {
@@ -54,10 +55,11 @@ public:
 
   BoundingBox getBoundingBox() const override;
 private:
+  // Products i with hidden[i] set are skipped
   void renderCSGProducts(const shared_ptr<CSGProducts>& products, bool showedges = false,
                          const Renderer::shaderinfo_t *shaderinfo = nullptr,
                          bool highlight_mode = false, bool background_mode = false,
-                         bool fberror = false) const;
+                         bool fberror = false, const std::vector<char> *hidden = nullptr) const;
   void renderChainObject(const CSGChainObject& csgobj, bool showedges,
                          const Renderer::shaderinfo_t *, bool highlight_mode,
                          bool background_mode, bool fberror, OpenSCADOperator type) const;
@@ -66,15 +68,22 @@ private:
                          bool highlight_mode, bool background_mode);
   void createChainObject(VertexArray& vertex_array, const CSGChainObject& csgobj,
                          bool highlight_mode, bool background_mode,
-                         OpenSCADOperator type);
+                         bool fberror, OpenSCADOperator type);
+  void createBatchedStates(size_t stride);
 
   Renderer::ColorMode getColorMode(const CSGNode::Flag& flags, bool highlight_mode,
                                    bool background_mode, bool fberror, OpenSCADOperator type) const;
 
   VertexStates vertex_states;
+  // vertex_states with adjacent surfaces merged into one draw call, used when
+  // neither edges nor per object selection ids are needed
+  VertexStates batched_states;
   shared_ptr<CSGProducts> root_products;
   shared_ptr<CSGProducts> highlight_products;
   shared_ptr<CSGProducts> background_products;
   GLuint vertices_vbo{0};
   GLuint elements_vbo{0};
+  // Culls the root products when drawing without vertex objects, whose batches span products
+  mutable std::unique_ptr<OcclusionCuller> culler;
+  mutable bool culler_checked{false};
 };
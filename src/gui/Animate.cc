@@ -252,10 +252,13 @@ void Animate::updatePauseButtonIcon()
 }
 
 void Animate::cameraChanged(){
+  // Prefetched frames were evaluated with the old $vpr, $vpt, $vpd and $vpf
+  mainWindow->clearPrefetchedFrames();
   this->animateUpdate(); //for now so that we do not change the behavior
 }
 
 void Animate::editorContentChanged(){
+  mainWindow->clearPrefetchedFrames();
   this->animateUpdate(); //for now so that we do not change the behavior
 }
 
@@ -373,6 +376,19 @@ double Animate::getAnim_tval(){
   return anim_tval;
 }
 
+bool Animate::isPlaying() const
+{
+  return animate_timer->isActive() && !animate_timer->isSingleShot();
+}
+
+double Animate::frameTVal(int ahead) const
+{
+  if (this->anim_numsteps <= 1) return 0.0;
+  const int step = (this->anim_step + ahead) % this->anim_numsteps;
+  // Rounded like the value shown, which is the one the preview uses
+  return QString::number(1.0 * step / this->anim_numsteps, 'f', 5).toDouble();
+}
+
 void Animate::on_pushButton_MoveToBeginning_clicked(){
   pauseAnimation();
   this->anim_step = 0;
@@ -29,6 +29,10 @@ public:
 
   const QList<QAction *>& actions();
   double getAnim_tval();
+  // True while the animation plays at the set frame rate
+  bool isPlaying() const;
+  // The value of $t the given number of frames after the current one
+  double frameTVal(int ahead) const;
   QSize minimumSizeHint() const override;
 
 public slots:
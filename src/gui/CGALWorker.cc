@@ -21,9 +21,10 @@ CGALWorker::~CGALWorker()
   delete this->thread;
 }
 
-void CGALWorker::start(const Tree& tree)
+void CGALWorker::start(const Tree& tree, bool approximate)
 {
   this->tree = &tree;
+  this->approximate = approximate;
   this->thread->start();
 }
 
@@ -32,7 +33,8 @@ void CGALWorker::work()
   // this is a worker thread: we don't want any exceptions escaping and crashing the app.
   shared_ptr<const Geometry> root_geom;
   try {
-    GeometryEvaluator evaluator(*this->tree);
+    GeometryEvaluator evaluator(*this->tree, this->approximate ?
+                                GeometryEvaluator::Precision::Approximate : GeometryEvaluator::Precision::Exact);
     root_geom = evaluator.evaluateGeometry(*this->tree->root(), true);
   } catch (const ProgressCancelException& e) {
     LOG("Rendering cancelled.");
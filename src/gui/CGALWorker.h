@@ -13,7 +13,8 @@ public:
   ~CGALWorker() override;
 
 public slots:
-  void start(const Tree& tree);
+  // approximate renders with Manifold in float precision, see GeometryEvaluator::Precision
+  void start(const Tree& tree, bool approximate = false);
 
 protected slots:
   void work();
@@ -25,4 +26,5 @@ protected:
 
   class QThread *thread;
   const class Tree *tree;
+  bool approximate{false};
 };
@@ -0,0 +1,119 @@
+#include "CSGWorker.h"
+#include <QThread>
+
+#include "Tree.h"
+#include "CSGNode.h"
+#include "CSGTreeEvaluator.h"
+#include "CSGTreeNormalizer.h"
+#include "GeometryEvaluator.h"
+#include "progress.h"
+#include "printutils.h"
+#include "exceptions.h"
+
+CSGWorker::CSGWorker()
+{
+  this->tree = nullptr;
+  this->thread = new QThread();
+  if (this->thread->stackSize() < 1024 * 1024) this->thread->setStackSize(1024 * 1024);
+  connect(this->thread, SIGNAL(started()), this, SLOT(work()));
+  moveToThread(this->thread);
+}
+
+CSGWorker::~CSGWorker()
+{
+  delete this->thread;
+}
+
+bool CSGWorker::isRunning() const
+{
+  return this->thread->isRunning();
+}
+
+void CSGWorker::wait()
+{
+  this->thread->wait();
+}
+
+void CSGWorker::start(const Tree& tree, size_t normalizelimit)
+{
+  // The thread may still be finishing after emitting done()
+  this->thread->wait();
+  this->aborted = false;
+  this->tree = &tree;
+  this->normalizelimit = normalizelimit;
+  clear();
+  this->thread->start();
+}
+
+void CSGWorker::clear()
+{
+  this->csgRoot.reset();
+  this->normalizedRoot.reset();
+  this->root_products.reset();
+  this->highlights_products.reset();
+  this->background_products.reset();
+}
+
+void CSGWorker::work()
+{
+  // this is a worker thread: we don't want any exceptions escaping and crashing the app.
+  try {
+    GeometryEvaluator geomevaluator(*this->tree);
+    CSGTreeEvaluator csgrenderer(*this->tree, &geomevaluator);
+    try {
+      this->csgRoot = csgrenderer.buildCSGTree(*this->tree->root());
+    } catch (const ProgressCancelException&) {
+      LOG("CSG generation cancelled.");
+    } catch (const HardWarningException&) {
+      LOG("CSG generation cancelled due to hardwarning being enabled.");
+    }
+
+    LOG("Compiling design (CSG Products normalization)...");
+    CSGTreeNormalizer normalizer(this->normalizelimit);
+
+    if (this->csgRoot) {
+      this->normalizedRoot = normalizer.normalize(this->csgRoot);
+      if (this->normalizedRoot) {
+        this->root_products.reset(new CSGProducts());
+        this->root_products->import(this->normalizedRoot);
+      } else {
+        LOG(message_group::Warning, "CSG normalization resulted in an empty tree");
+      }
+    }
+
+    const std::vector<shared_ptr<CSGNode>>& highlight_terms = csgrenderer.getHighlightNodes();
+    if (highlight_terms.size() > 0) {
+      LOG("Compiling highlights (%1$d CSG Trees)...", highlight_terms.size());
+
+      this->highlights_products.reset(new CSGProducts());
+      for (const auto& highlight_term : highlight_terms) {
+        auto nterm = normalizer.normalize(highlight_term);
+        if (nterm) {
+          this->highlights_products->import(nterm);
+        }
+      }
+    }
+
+    const auto& background_terms = csgrenderer.getBackgroundNodes();
+    if (background_terms.size() > 0) {
+      LOG("Compiling background (%1$d CSG Trees)...", background_terms.size());
+
+      this->background_products.reset(new CSGProducts());
+      for (const auto& background_term : background_terms) {
+        auto nterm = normalizer.normalize(background_term);
+        if (nterm) {
+          this->background_products->import(nterm);
+        }
+      }
+    }
+  } catch (const HardWarningException&) {
+    this->aborted = true;
+  } catch (const std::exception& e) {
+    LOG(message_group::Error, "CSG generation cancelled by exception %1$s", e.what());
+  } catch (...) {
+    LOG(message_group::Error, "CSG generation cancelled by unknown exception.");
+  }
+
+  emit done();
+  thread->quit();
+}
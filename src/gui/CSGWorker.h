@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QObject>
+#include <vector>
+#include "memory.h"
+
+class Tree;
+class CSGNode;
+class CSGProducts;
+
+/*!
+   Builds and normalizes the CSG tree for the preview on a worker thread.
+   The results are read from the public members once done() is emitted.
+ */
+class CSGWorker : public QObject
+{
+  Q_OBJECT;
+public:
+  CSGWorker();
+  ~CSGWorker() override;
+
+  [[nodiscard]] bool isRunning() const;
+  // Blocks until the current run has finished
+  void wait();
+  // Releases the results
+  void clear();
+
+  // Set if a warning was raised with hard warnings enabled
+  bool aborted{false};
+
+  shared_ptr<CSGNode> csgRoot;
+  shared_ptr<CSGNode> normalizedRoot;
+  shared_ptr<CSGProducts> root_products;
+  shared_ptr<CSGProducts> highlights_products;
+  shared_ptr<CSGProducts> background_products;
+
+public slots:
+  void start(const Tree& tree, size_t normalizelimit);
+
+protected slots:
+  void work();
+
+signals:
+  void done();
+
+protected:
+
+  class QThread *thread;
+  const class Tree *tree;
+  size_t normalizelimit{0};
+};
@@ -44,6 +44,7 @@ Console::Console(QWidget *parent) : QPlainTextEdit(parent)
   connect(this, SIGNAL(linkActivated(QString)), this, SLOT(hyperlinkClicked(const QString&)));
   this->setUndoRedoEnabled(false);
   this->appendCursor = this->textCursor();
+  this->maxLines = Preferences::inst()->getValue("advanced/consoleMaxLines").toUInt();
 }
 
 void Console::focusInEvent(QFocusEvent * /*event*/)
@@ -64,21 +65,50 @@ void Console::addMessage(const Message& msg)
   //    QTextCursor::insertText(const QString &text, const QTextCharFormat &format)
   // But if no link, and matching colors, then concat message strings with newline in between.
   // This results in less calls to insertText in Console::update(), and much better performance.
+  const auto text = QString::fromStdString(msg.str());
   if (!this->msgBuffer.empty() && msg.loc.isNone() && this->msgBuffer.back().link.isEmpty() &&
       (getGroupColor(msg.group) == getGroupColor(this->msgBuffer.back().group)) ) {
     auto& lastmsg = this->msgBuffer.back().message;
     lastmsg += QChar('\n');
-    lastmsg += QString::fromStdString(msg.str());
+    lastmsg += text;
+    this->bufferedLines++;
   } else {
     this->msgBuffer.push_back(
     {
-      QString::fromStdString(msg.str()),
+      text,
       (getGroupTextPlain(msg.group) || msg.loc.isNone()) ?
       QString() :
       QString("%1,%2").arg(msg.loc.firstLine()).arg(QString::fromStdString(msg.loc.fileName())),
       msg.group
     }
       );
+    this->bufferedLines++;
+  }
+  this->bufferedLines += text.count(QChar('\n'));
+  // Lines beyond the limit would only be removed again after inserting them
+  if (this->maxLines > 0 && this->bufferedLines > 2 * this->maxLines) trimBuffer();
+}
+
+/*!
+   Drops the oldest buffered lines beyond maxLines, so a script echoing in a
+   loop costs the console a bounded amount of work per update.
+ */
+void Console::trimBuffer()
+{
+  while (this->bufferedLines > this->maxLines && !this->msgBuffer.empty()) {
+    auto& message = this->msgBuffer.front().message;
+    const size_t lines = message.count(QChar('\n')) + 1;
+    const size_t excess = this->bufferedLines - this->maxLines;
+    if (lines <= excess) {
+      this->msgBuffer.pop_front();
+      this->bufferedLines -= lines;
+      continue;
+    }
+    // Keep the last lines of a block of concatenated messages
+    int pos = -1;
+    for (size_t i = 0; i < excess; ++i) pos = message.indexOf(QChar('\n'), pos + 1);
+    message.remove(0, pos + 1);
+    this->bufferedLines -= excess;
   }
 }
 
@@ -96,6 +126,7 @@ void Console::setFont(const QString& fontFamily, uint ptSize) {
 
 void Console::update()
 {
+  if (this->maxLines > 0) trimBuffer();
   // Faster to ignore block count until group of messages are done inserting.
   this->setMaximumBlockCount(0);
   for (const auto& line : this->msgBuffer) {
@@ -116,13 +147,16 @@ void Console::update()
     appendCursor.insertText(line.message, charFormat);
   }
   msgBuffer.clear();
+  bufferedLines = 0;
   this->setTextCursor(appendCursor);
-  this->setMaximumBlockCount(Preferences::inst()->getValue("advanced/consoleMaxLines").toUInt());
+  this->maxLines = Preferences::inst()->getValue("advanced/consoleMaxLines").toUInt();
+  this->setMaximumBlockCount(this->maxLines);
 }
 
 void Console::actionClearConsole_triggered()
 {
   this->msgBuffer.clear();
+  this->bufferedLines = 0;
   this->document()->clear();
   this->appendCursor = this->textCursor();
 }
@@ -29,7 +29,7 @@
 #include <QPlainTextEdit>
 #include <QMouseEvent>
 #include <QString>
-#include <vector>
+#include <deque>
 #include "printutils.h"
 #include "qtgettext.h" // IWYU pragma: keep
 #include "ui_Console.h"
@@ -46,9 +46,14 @@ class Console : public QPlainTextEdit, public Ui::Console
 
 private:
   static constexpr int MAX_LINES = 5000;
-  std::vector<ConsoleMessageBlock> msgBuffer;
+  // Messages waiting for the next update, only as many lines as the console keeps
+  std::deque<ConsoleMessageBlock> msgBuffer;
+  size_t bufferedLines{0};
+  size_t maxLines{0}; // advanced/consoleMaxLines, 0 for no limit
   QTextCursor appendCursor; // keep a cursor always at the end of document.
 
+  void trimBuffer();
+
 public:
   Console(QWidget *parent = nullptr);
   QString clickedAnchor;
@@ -78,4 +78,5 @@ public:
   std::string autoReloadId;
   std::vector<IndicatorData> indicatorData;
   ParameterWidget *parameterWidget;
+  unsigned cacheOwner{0}; // The tab's share of the geometry caches, see CacheOwners
 };
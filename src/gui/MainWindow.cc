@@ -30,6 +30,9 @@
 #include "openscad.h"
 #include "GeometryCache.h"
 #include "SourceFileCache.h"
+#include "GlyphCache.h"
+#include "ImportCache.h"
+#include "StatCache.h"
 #include "MainWindow.h"
 #include "OpenSCADApp.h"
 #include "parsersettings.h"
@@ -43,6 +46,8 @@
 #include "ScopeContext.h"
 #include "progress.h"
 #include "dxfdim.h"
+#include "DxfData.h"
+#include "import.h"
 #include "Settings.h"
 #include "AboutDialog.h"
 #include "FontListDialog.h"
@@ -66,6 +71,7 @@
 #include "AutoUpdater.h"
 #endif
 #include "TabManager.h"
+#include "parallel.h"
 
 #include <QMenu>
 #include <QTime>
@@ -76,6 +82,7 @@
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QTextStream>
 #include <QStatusBar>
 #include <QDropEvent>
@@ -91,6 +98,7 @@
 #include <QClipboard>
 #include <QDesktopWidget>
 #include <memory>
+#include <sstream>
 #include <string>
 #include "QWordSearchField.h"
 #include <QSettings> //Include QSettings for direct operations on settings arrays
@@ -136,12 +144,14 @@ std::string SHA256HashString(std::string aString){
 #include "cgalutils.h"
 #include "CGALCache.h"
 #include "GeometryEvaluator.h"
+#include "CacheOwners.h"
 #include "CGALRenderer.h"
 #include "CGAL_Nef_polyhedron.h"
 #include "CGALHybridPolyhedron.h"
 #include "CGALWorker.h"
 
 #endif // ENABLE_CGAL
+#include "CSGWorker.h"
 
 #ifdef ENABLE_MANIFOLD
 #include "ManifoldGeometry.h"
@@ -159,6 +169,12 @@ std::string SHA256HashString(std::string aString){
 #include "qt-obsolete.h" // IWYU pragma: keep
 
 static const int autoReloadPollingPeriodMS = 200;
+// Time to wait for more changes, e.g. when several files are saved at once
+static const int autoReloadSettleMS = 100;
+// Pause in typing after which the text is evaluated in the background
+static const int speculativeEvalDelayMS = 750;
+// Frames of a playing animation prepared ahead
+static const int animationPrefetchFrames = 8;
 
 // Global application state
 unsigned int GuiLocker::gui_locked = 0;
@@ -368,12 +384,23 @@ MainWindow::MainWindow(const QStringList& filenames)
   connect(this->cgalworker, SIGNAL(done(shared_ptr<const Geometry>)),
           this, SLOT(actionRenderDone(shared_ptr<const Geometry>)));
 #endif
+  this->csgworker = new CSGWorker();
+  connect(this->csgworker, SIGNAL(done()), this, SLOT(compileCSGDone()));
+  this->speculativeworker = new CSGWorker();
+  connect(this->speculativeworker, SIGNAL(done()), this, SLOT(speculativeDone()));
+  this->speculativeTimer = new QTimer(this);
+  this->speculativeTimer->setSingleShot(true);
+  this->speculativeTimer->setInterval(speculativeEvalDelayMS);
+  connect(this->speculativeTimer, SIGNAL(timeout()), this, SLOT(speculativeEvaluate()));
+  this->prefetchworker = new CSGWorker();
+  connect(this->prefetchworker, SIGNAL(done()), this, SLOT(prefetchDone()));
 
 #ifdef ENABLE_CGAL
   this->cgalRenderer = nullptr;
 #endif
 #ifdef ENABLE_OPENCSG
   this->opencsgRenderer = nullptr;
+  this->opencsgVBOCache = std::make_shared<OpenCSGVBOCache>();
 #endif
   this->thrownTogetherRenderer = nullptr;
 
@@ -386,13 +413,19 @@ MainWindow::MainWindow(const QStringList& filenames)
   QSettingsCached settings;
   this->qglview->setMouseCentricZoom(Settings::Settings::mouseCentricZoom.value());
   this->qglview->setMouseSwapButtons(Settings::Settings::mouseSwapButtons.value());
+  this->qglview->setAdaptiveResolution(Settings::Settings::adaptiveResolution.value());
+  this->qglview->setHideEdgesWhileMoving(Settings::Settings::hideEdgesWhileMoving.value());
 
 
   autoReloadTimer = new QTimer(this);
-  autoReloadTimer->setSingleShot(false);
-  autoReloadTimer->setInterval(autoReloadPollingPeriodMS);
+  autoReloadTimer->setSingleShot(true);
+  autoReloadTimer->setInterval(autoReloadSettleMS);
   connect(autoReloadTimer, SIGNAL(timeout()), this, SLOT(checkAutoReload()));
 
+  fileWatcher = new QFileSystemWatcher(this);
+  connect(fileWatcher, SIGNAL(fileChanged(QString)), this, SLOT(dependencyChanged(QString)));
+  connect(fileWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(dependencyChanged(QString)));
+
   waitAfterReloadTimer = new QTimer(this);
   waitAfterReloadTimer->setSingleShot(true);
   waitAfterReloadTimer->setInterval(autoReloadPollingPeriodMS);
@@ -464,6 +497,11 @@ MainWindow::MainWindow(const QStringList& filenames)
   connect(this->designActionRender, SIGNAL(triggered()), this, SLOT(actionRender()));
 #else
   this->designActionRender->setVisible(false);
+#endif
+#ifdef ENABLE_MANIFOLD
+  connect(this->designActionQuickRender, SIGNAL(triggered()), this, SLOT(actionQuickRender()));
+#else
+  this->designActionQuickRender->setVisible(false);
 #endif
   connect(this->designAction3DPrint, SIGNAL(triggered()), this, SLOT(action3DPrint()));
   connect(this->designCheckValidity, SIGNAL(triggered()), this, SLOT(actionCheckValidity()));
@@ -483,10 +521,6 @@ MainWindow::MainWindow(const QStringList& filenames)
   connect(this->fileActionExportImage, SIGNAL(triggered()), this, SLOT(actionExportImage()));
   connect(this->designActionFlushCaches, SIGNAL(triggered()), this, SLOT(actionFlushCaches()));
 
-#ifndef ENABLE_LIB3MF
-  this->fileActionExport3MF->setVisible(false);
-#endif
-
 #ifndef ENABLE_3D_PRINTING
   this->designAction3DPrint->setVisible(false);
   this->designAction3DPrint->setEnabled(false);
@@ -568,6 +602,8 @@ MainWindow::MainWindow(const QStringList& filenames)
   connect(Preferences::inst(), SIGNAL(requestRedraw()), this->qglview, SLOT(update()));
   connect(Preferences::inst(), SIGNAL(updateMouseCentricZoom(bool)), this->qglview, SLOT(setMouseCentricZoom(bool)));
   connect(Preferences::inst(), SIGNAL(updateMouseSwapButtons(bool)), this->qglview, SLOT(setMouseSwapButtons(bool)));
+  connect(Preferences::inst(), SIGNAL(updateAdaptiveResolution(bool)), this->qglview, SLOT(setAdaptiveResolution(bool)));
+  connect(Preferences::inst(), SIGNAL(updateHideEdgesWhileMoving(bool)), this->qglview, SLOT(setHideEdgesWhileMoving(bool)));
   connect(Preferences::inst(), SIGNAL(updateReorderMode(bool)), this, SLOT(updateReorderMode(bool)));
   connect(Preferences::inst(), SIGNAL(updateUndockMode(bool)), this, SLOT(updateUndockMode(bool)));
   connect(Preferences::inst(), SIGNAL(openCSGSettingsChanged()), this, SLOT(openCSGSettingsChanged()));
@@ -904,6 +940,8 @@ void MainWindow::loadDesignSettings()
   }
   auto polySetCacheSizeMB = Preferences::inst()->getValue("advanced/polysetCacheSizeMB").toUInt();
   GeometryCache::instance()->setMaxSizeMB(polySetCacheSizeMB);
+  // Keeps the limit of --threads unless one is set
+  if (auto threads = Preferences::inst()->getValue("advanced/threads").toUInt()) set_parallel_threads(threads);
 #ifdef ENABLE_CGAL
   auto cgalCacheSizeMB = Preferences::inst()->getValue("advanced/cgalCacheSizeMB").toUInt();
   CGALCache::instance()->setMaxSizeMB(cgalCacheSizeMB);
@@ -967,6 +1005,8 @@ void MainWindow::updateReorderMode(bool reorderMode)
 
 MainWindow::~MainWindow()
 {
+  stopSpeculation();
+  stopPrefetch();
   // If root_file is not null then it will be the same as parsed_file,
   // so no need to delete it.
   delete parsed_file;
@@ -975,6 +1015,7 @@ MainWindow::~MainWindow()
 #endif
 #ifdef ENABLE_OPENCSG
   delete this->opencsgRenderer;
+  this->opencsgVBOCache->clear();
 #endif
   delete this->thrownTogetherRenderer;
   scadApp->windowManager.remove(this);
@@ -1011,6 +1052,18 @@ void MainWindow::report_func(const std::shared_ptr<const AbstractNode>&, void *v
   }
 }
 
+void MainWindow::speculative_report_func(const std::shared_ptr<const AbstractNode>&, void *vp, int)
+{
+  auto thisp = static_cast<MainWindow *>(vp);
+  if (thisp->speculation_cancelled) throw ProgressCancelException();
+}
+
+void MainWindow::prefetch_report_func(const std::shared_ptr<const AbstractNode>&, void *vp, int)
+{
+  auto thisp = static_cast<MainWindow *>(vp);
+  if (thisp->prefetch_cancelled) throw ProgressCancelException();
+}
+
 bool MainWindow::network_progress_func(const double permille)
 {
   QMetaObject::invokeMethod(this->progresswidget, "setValue", Qt::QueuedConnection, Q_ARG(int, (int)permille));
@@ -1060,6 +1113,8 @@ void MainWindow::compile(bool reload, bool forcedone)
     compileErrors = 0;
     compileWarnings = 0;
 
+    // Caches the results for this tab, also those of the renders and background work which follow
+    CacheOwners::instance()->setCurrent(this->activeEditor->cacheOwner);
     this->renderStatistic.start();
 
     // Reload checks the timestamp of the toplevel file and refreshes if necessary,
@@ -1089,6 +1144,7 @@ void MainWindow::compile(bool reload, bool forcedone)
       if (mtime > this->includes_mtime) {
         this->includes_mtime = mtime;
         shouldcompiletoplevel = true;
+        this->reusable_parse.clear();
       }
     }
     // Parsing and dependency handling must run to completion even with stop on errors to prevent auto
@@ -1115,6 +1171,7 @@ void MainWindow::compile(bool reload, bool forcedone)
       if (mtime > this->deps_mtime) {
         this->deps_mtime = mtime;
         LOG("Used file cache size: %1$d files", SourceFileCache::instance()->size());
+        this->root_file->clearInstantiationCache();
         didcompile = true;
       }
     }
@@ -1219,7 +1276,11 @@ void MainWindow::compileEnded()
 {
   clearCurrentOutput();
   GuiLocker::unlock();
-  if (designActionAutoReload->isChecked()) autoReloadTimer->start();
+  if (designActionAutoReload->isChecked()) watchDependencies();
+  if (this->preview_requested) {
+    // the preview was requested while the gui was locked, it must be called from the mainloop
+    QTimer::singleShot(0, this, SLOT(actionRenderPreview()));
+  }
 }
 
 void MainWindow::instantiateRoot()
@@ -1297,121 +1358,71 @@ void MainWindow::instantiateRoot()
 }
 
 /*!
-   Generates CSG tree for OpenCSG evaluation.
+   Generates CSG tree for OpenCSG evaluation on the CSG worker, then calls afterCSGSlot.
    Assumes that the design has been parsed and evaluated (this->root_node is set)
  */
 void MainWindow::compileCSG()
 {
+  assert(this->root_node);
   OpenSCAD::hardwarnings = Preferences::inst()->getValue("advanced/enableHardwarnings").toBool();
-  try{
-    assert(this->root_node);
-    LOG("Compiling design (CSG Products generation)...");
-    this->processEvents();
-
-    // Main CSG evaluation
-    this->progresswidget = new ProgressWidget(this);
-    connect(this->progresswidget, SIGNAL(requestShow()), this, SLOT(showProgress()));
-
-#ifdef ENABLE_CGAL
-    GeometryEvaluator geomevaluator(this->tree);
-#else
-    // FIXME: Will we support this?
-#endif
-#ifdef ENABLE_OPENCSG
-    CSGTreeEvaluator csgrenderer(this->tree, &geomevaluator);
-#endif
-
-    if (!isClosing) progress_report_prep(this->root_node, report_func, this);
-    else return;
-    try {
-#ifdef ENABLE_OPENCSG
-      this->processEvents();
-      this->csgRoot = csgrenderer.buildCSGTree(*root_node);
-#endif
-      renderStatistic.printCacheStatistic();
-      this->processEvents();
-    } catch (const ProgressCancelException&) {
-      LOG("CSG generation cancelled.");
-    } catch (const HardWarningException&) {
-      LOG("CSG generation cancelled due to hardwarning being enabled.");
-    }
-    progress_report_fin();
-    updateStatusBar(nullptr);
-
-    LOG("Compiling design (CSG Products normalization)...");
-    this->processEvents();
-
-    size_t normalizelimit = 2ul * Preferences::inst()->getValue("advanced/openCSGLimit").toUInt();
-    CSGTreeNormalizer normalizer(normalizelimit);
+  LOG("Compiling design (CSG Products generation)...");
+  this->processEvents();
 
-    if (this->csgRoot) {
-      this->normalizedRoot = normalizer.normalize(this->csgRoot);
-      if (this->normalizedRoot) {
-        this->root_products.reset(new CSGProducts());
-        this->root_products->import(this->normalizedRoot);
-      } else {
-        this->root_products.reset();
-        LOG(message_group::Warning, "CSG normalization resulted in an empty tree");
-        this->processEvents();
-      }
-    }
+  // Main CSG evaluation
+  this->progresswidget = new ProgressWidget(this);
+  connect(this->progresswidget, SIGNAL(requestShow()), this, SLOT(showProgress()));
 
-    const std::vector<shared_ptr<CSGNode>>& highlight_terms = csgrenderer.getHighlightNodes();
-    if (highlight_terms.size() > 0) {
-      LOG("Compiling highlights (%1$d CSG Trees)...", highlight_terms.size());
-      this->processEvents();
+  if (!isClosing) progress_report_prep(this->root_node, report_func, this);
+  else return;
 
-      this->highlights_products.reset(new CSGProducts());
-      for (const auto& highlight_term : highlight_terms) {
-        auto nterm = normalizer.normalize(highlight_term);
-        if (nterm) {
-          this->highlights_products->import(nterm);
-        }
-      }
-    } else {
-      this->highlights_products.reset();
-    }
+  size_t normalizelimit = 2ul * Preferences::inst()->getValue("advanced/openCSGLimit").toUInt();
+  this->csgworker->start(this->tree, normalizelimit);
+}
 
-    const auto& background_terms = csgrenderer.getBackgroundNodes();
-    if (background_terms.size() > 0) {
-      LOG("Compiling background (%1$d CSG Trees)...", background_terms.size());
-      this->processEvents();
+void MainWindow::compileCSGDone()
+{
+  progress_report_fin();
+  updateStatusBar(nullptr);
+  if (this->csgworker->aborted) {
+    exceptionCleanup();
+    return;
+  }
+  renderStatistic.printCacheStatistic();
 
-      this->background_products.reset(new CSGProducts());
-      for (const auto& background_term : background_terms) {
-        auto nterm = normalizer.normalize(background_term);
-        if (nterm) {
-          this->background_products->import(nterm);
-        }
-      }
-    } else {
-      this->background_products.reset();
-    }
+  this->csgRoot = std::move(this->csgworker->csgRoot);
+  this->normalizedRoot = std::move(this->csgworker->normalizedRoot);
+  this->root_products = std::move(this->csgworker->root_products);
+  this->highlights_products = std::move(this->csgworker->highlights_products);
+  this->background_products = std::move(this->csgworker->background_products);
 
-    if (this->root_products &&
-        (this->root_products->size() >
-         Preferences::inst()->getValue("advanced/openCSGLimit").toUInt())) {
-      LOG(message_group::UI_Warning, "Normalized tree has %1$d elements!", this->root_products->size());
-      LOG(message_group::UI_Warning, "OpenCSG rendering has been disabled.");
-    }
 #ifdef ENABLE_OPENCSG
-    else {
-      LOG("Normalized tree has %1$d elements!",
-          (this->root_products ? this->root_products->size() : 0));
-      this->opencsgRenderer = new OpenCSGRenderer(this->root_products,
-                                                  this->highlights_products,
-                                                  this->background_products);
-    }
+  LOG("Normalized tree has %1$d elements!",
+      (this->root_products ? this->root_products->size() : 0));
 #endif
-    this->thrownTogetherRenderer = new ThrownTogetherRenderer(this->root_products,
-                                                              this->highlights_products,
-                                                              this->background_products);
-    LOG("Compile and preview finished.");
-    renderStatistic.printRenderingTime();
-    this->processEvents();
-  } catch (const HardWarningException&) {
-    exceptionCleanup();
+  createPreviewRenderers();
+  LOG("Compile and preview finished.");
+  renderStatistic.printRenderingTime();
+  this->processEvents();
+  QMetaObject::invokeMethod(this, this->afterCSGSlot);
+}
+
+void MainWindow::createPreviewRenderers()
+{
+#ifdef ENABLE_OPENCSG
+  this->opencsgRenderer = new OpenCSGRenderer(this->root_products,
+                                              this->highlights_products,
+                                              this->background_products,
+                                              this->opencsgVBOCache);
+  const size_t opencsglimit = Preferences::inst()->getValue("advanced/openCSGLimit").toUInt();
+  if (this->root_products && this->root_products->size() > opencsglimit) {
+    LOG(message_group::UI_Warning, "Normalized tree has %1$d elements!", this->root_products->size());
+    LOG(message_group::UI_Warning, "OpenCSG rendering is done in passes of %1$d elements.", opencsglimit);
+    this->opencsgRenderer->setBatchSize(opencsglimit);
   }
+#endif
+  this->thrownTogetherRenderer = new ThrownTogetherRenderer(this->root_products,
+                                                            this->highlights_products,
+                                                            this->background_products);
 }
 
 void MainWindow::actionOpen()
@@ -1890,6 +1901,8 @@ bool MainWindow::trust_python_file(const std::string &file,  const std::string &
 void MainWindow::parseTopLevelDocument()
 {
   resetSuppressedMessages();
+  // Prefetched frames refer to the previous parse and parameters
+  clearPrefetchedFrames();
 
   this->last_compiled_doc = activeEditor->toPlainText();
 
@@ -1899,6 +1912,16 @@ void MainWindow::parseTopLevelDocument()
 
   auto fnameba = activeEditor->filepath.toLocal8Bit();
   const char *fname = activeEditor->filepath.isEmpty() ? "" : fnameba;
+
+  // If the text is unchanged only parameters changed. Keeping the AST lets
+  // instantiation reuse the parts of the tree not depending on them.
+  std::string parse_key = std::string(fname) + '\0' + fulltext;
+  if (Feature::ExperimentalIncrementalEval.is_enabled() && this->root_file && parse_key == this->reusable_parse) {
+    this->activeEditor->parameterWidget->applyParameters(this->root_file);
+    return;
+  }
+  this->reusable_parse.clear();
+
   delete this->parsed_file;
 #ifdef ENABLE_PYTHON
   this->python_active = false;
@@ -1923,7 +1946,14 @@ void MainWindow::parseTopLevelDocument()
 #endif // ifdef ENABLE_PYTHON
   this->parsed_file = nullptr; // because the parse() call can throw and we don't want a stale pointer!
   this->root_file = nullptr;  // ditto
+  const size_t messages = print_message_count;
   this->root_file = parse(this->parsed_file, fulltext, fname, fname, false) ? this->parsed_file : nullptr;
+  // Parse warnings must be shown again, so only clean parses are kept
+  if (this->root_file && print_message_count == messages) this->reusable_parse = std::move(parse_key);
+#ifdef ENABLE_PYTHON
+  // Python scripts are run again on every compile
+  if (this->python_active) this->reusable_parse.clear();
+#endif
 
   this->activeEditor->resetHighlighting();
   if (this->root_file != nullptr) {
@@ -1945,6 +1975,11 @@ void MainWindow::changeParameterWidget()
 
 void MainWindow::checkAutoReload()
 {
+  // Check again once the running compile or render is done
+  if (GuiLocker::isLocked()) {
+    autoReloadTimer->start();
+    return;
+  }
   if (!activeEditor->filepath.isEmpty()) {
     actionReloadRenderPreview();
   }
@@ -1955,12 +1990,54 @@ void MainWindow::autoReloadSet(bool on)
   QSettingsCached settings;
   settings.setValue("design/autoReload", designActionAutoReload->isChecked());
   if (on) {
-    autoReloadTimer->start(autoReloadPollingPeriodMS);
+    watchDependencies();
+    autoReloadTimer->start();
   } else {
     autoReloadTimer->stop();
+    fileWatcher->removePaths(fileWatcher->files() + fileWatcher->directories());
+    StatCache::unwatchAll();
   }
 }
 
+/*!
+   Watches the document and the files it depends on, so auto reload only checks
+   them once one has changed. Missing files are seen through their directory.
+ */
+void MainWindow::watchDependencies()
+{
+  auto watched = fileWatcher->files() + fileWatcher->directories();
+  if (!watched.isEmpty()) fileWatcher->removePaths(watched);
+  StatCache::unwatchAll();
+
+  std::vector<std::string> files = SourceFileCache::instance()->filenames();
+  if (!activeEditor->filepath.isEmpty()) files.push_back(activeEditor->filepath.toStdString());
+  if (this->root_file) {
+    for (const auto& include : this->root_file->getIncludes()) files.push_back(include.second);
+  }
+
+  QStringList paths;
+  for (const auto& file : files) {
+    QFileInfo info(QString::fromStdString(file));
+    if (info.exists()) paths << info.filePath();
+    else if (info.dir().exists()) paths << info.dir().path();
+  }
+  paths.removeDuplicates();
+  if (paths.isEmpty()) return;
+  // Files the watcher couldn't take, e.g. over the system limit, are still stat()ed as before
+  auto failed = fileWatcher->addPaths(paths);
+  for (const auto& path : fileWatcher->files()) {
+    if (!failed.contains(path)) StatCache::watch(path.toStdString());
+  }
+}
+
+void MainWindow::dependencyChanged(const QString& path)
+{
+  StatCache::invalidate(path.toStdString());
+  // Editors saving by replacing the file make the watcher drop it
+  if (!fileWatcher->files().contains(path) && QFileInfo::exists(path)) fileWatcher->addPath(path);
+  if (designActionAutoReload->isChecked()) autoReloadTimer->start();
+}
+
 bool MainWindow::checkEditorModified()
 {
   if (activeEditor->isContentModified()) {
@@ -1990,8 +2067,13 @@ void MainWindow::actionReloadRenderPreview()
 
 void MainWindow::csgReloadRender()
 {
+  this->afterCSGSlot = "csgReloadRenderDone";
   if (this->root_node) compileCSG();
+  else csgReloadRenderDone();
+}
 
+void MainWindow::csgReloadRenderDone()
+{
   // Go to non-CGAL view mode
   if (viewActionThrownTogether->isChecked()) {
     viewModeThrownTogether();
@@ -2019,27 +2101,43 @@ void MainWindow::prepareCompile(const char *afterCompileSlot, bool procevents, b
 
 void MainWindow::actionRenderPreview()
 {
-  static bool preview_requested;
-
-  preview_requested = true;
-  if (GuiLocker::isLocked()) return;
+  this->preview_requested = true;
+  if (GuiLocker::isLocked()) {
+    // A newer preview replaces the CSG tree still being built
+    if (this->csgworker->isRunning() && this->progresswidget) this->progresswidget->cancel();
+    return;
+  }
+  if (previewPrefetchedFrame()) {
+    this->preview_requested = false;
+    return;
+  }
   GuiLocker::lock();
-  preview_requested = false;
+  this->preview_requested = false;
 
   prepareCompile("csgRender", windowActionHideAnimate->isChecked(), true);
   compile(false, false);
-  if (preview_requested) {
-    // if the action was called when the gui was locked, we must request it one more time
-    // however, it's not possible to call it directly NOR make the loop
-    // it must be called from the mainloop
-    QTimer::singleShot(0, this, SLOT(actionRenderPreview()));
-  }
 }
 
 void MainWindow::csgRender()
 {
+  this->afterCSGSlot = "csgRenderDone";
   if (this->root_node) compileCSG();
+  else csgRenderDone();
+}
+
+void MainWindow::csgRenderDone()
+{
+  displayPreview();
+  compileEnded();
+  // Later frames can be evaluated from the design just compiled
+  if (this->root_file && this->animateWidget->isPlaying() && Feature::ExperimentalAnimationPrefetch.is_enabled()) {
+    this->prefetch_ready = true;
+    QTimer::singleShot(0, this, SLOT(prefetchAnimationFrame()));
+  }
+}
 
+void MainWindow::displayPreview()
+{
   // Go to non-CGAL view mode
   if (viewActionThrownTogether->isChecked()) {
     viewModeThrownTogether();
@@ -2057,8 +2155,218 @@ void MainWindow::csgRender()
     QString filename = QString("frame%1.png").arg(steps, 5, 10, QChar('0'));
     img.save(filename, "PNG");
   }
+}
 
-  compileEnded();
+/*!
+   Shows the frame for the current $t of the playing animation if it was
+   prefetched. If it is still being prefetched, or can be prefetched from the
+   current design, it is shown once done. Returns false if the preview must
+   compile the design instead.
+ */
+bool MainWindow::previewPrefetchedFrame()
+{
+  if (!Feature::ExperimentalAnimationPrefetch.is_enabled() || !this->prefetch_ready || this->prefetch_viewport) return false;
+  if (!this->animateWidget->isPlaying() || activeEditor->toPlainText() != this->last_compiled_doc) return false;
+
+  const double tval = this->animateWidget->getAnim_tval();
+  auto it = std::find_if(this->prefetched_frames.begin(), this->prefetched_frames.end(),
+                         [tval](const PrefetchedFrame& frame) { return frame.tval == tval; });
+  if (it == this->prefetched_frames.end()) {
+    if (!this->prefetching || this->prefetch_frame.tval != tval) {
+      stopPrefetch();
+      if (!startPrefetch(tval)) return false;
+    }
+    this->prefetch_waiting = true;
+    return true;
+  }
+  // Frames before this one were skipped
+  auto frame = std::move(*it);
+  this->prefetched_frames.erase(this->prefetched_frames.begin(), it + 1);
+
+  this->qglview->setRenderer(nullptr);
+#ifdef ENABLE_OPENCSG
+  delete this->opencsgRenderer;
+  this->opencsgRenderer = nullptr;
+#endif
+  delete this->thrownTogetherRenderer;
+  this->thrownTogetherRenderer = nullptr;
+
+  this->absolute_root_node = std::move(frame.absolute_root_node);
+  this->root_node = std::move(frame.root_node);
+  this->tree.setRoot(this->root_node);
+  this->csgRoot = std::move(frame.csgRoot);
+  this->normalizedRoot = std::move(frame.normalizedRoot);
+  this->root_products = std::move(frame.root_products);
+  this->highlights_products = std::move(frame.highlights_products);
+  this->background_products = std::move(frame.background_products);
+  createPreviewRenderers();
+
+  // The messages of the frame, as if it was just compiled
+  compileErrors = 0;
+  compileWarnings = 0;
+  this->errorLogWidget->clearModel();
+  if (Preferences::inst()->getValue("advanced/consoleAutoClear").toBool()) {
+    this->console->actionClearConsole_triggered();
+  }
+  for (const auto& msg : frame.console) consoleOutput(msg);
+  for (const auto& msg : frame.errorlog) errorLogOutput(msg);
+  updateCompileResult();
+
+  displayPreview();
+  QTimer::singleShot(0, this, SLOT(prefetchAnimationFrame()));
+  return true;
+}
+
+/*!
+   Evaluates the next frame of the playing animation which isn't prepared yet,
+   so it can be shown without delay once its turn comes. Like the speculative
+   evaluation, the design is instantiated on the GUI thread, and the CSG tree
+   is built on a worker thread.
+ */
+void MainWindow::prefetchAnimationFrame()
+{
+  if (!Feature::ExperimentalAnimationPrefetch.is_enabled() || !this->prefetch_ready || this->prefetch_viewport) return;
+  if (this->prefetching || GuiLocker::isLocked() || !this->animateWidget->isPlaying()) return;
+
+  const double current = this->animateWidget->getAnim_tval();
+  for (int ahead = 1; ahead <= animationPrefetchFrames; ++ahead) {
+    const double tval = this->animateWidget->frameTVal(ahead);
+    // Short animations wrap around to the frame shown
+    if (tval == current) return;
+    auto it = std::find_if(this->prefetched_frames.begin(), this->prefetched_frames.end(),
+                           [tval](const PrefetchedFrame& frame) { return frame.tval == tval; });
+    if (it == this->prefetched_frames.end()) {
+      startPrefetch(tval);
+      return;
+    }
+  }
+}
+
+bool MainWindow::startPrefetch(double tval)
+{
+  if (!this->root_file) return false;
+#ifdef ENABLE_PYTHON
+  if (this->python_active) return false;
+#endif
+
+  this->prefetch_frame = PrefetchedFrame();
+  this->prefetch_frame.tval = tval;
+  set_output_handler(&MainWindow::prefetchConsoleOutput, &MainWindow::prefetchErrorLogOutput, this);
+  try {
+    boost::filesystem::path doc(activeEditor->filepath.toStdString());
+    EvaluationSession session{doc.parent_path().string()};
+    ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
+    setRenderVariables(builtin_context);
+    builtin_context->set_variable("$preview", Value(true));
+    builtin_context->set_variable("$t", Value(tval));
+
+    std::shared_ptr<const FileContext> file_context;
+    this->prefetch_frame.absolute_root_node = this->root_file->instantiate(*builtin_context, &file_context);
+    // The viewport set by one frame is used by the next, so these frames are compiled one by one
+    if (file_context) {
+      for (const auto *name : {"$vpr", "$vpt", "$vpd", "$vpf"}) {
+        if (file_context->lookup_local_variable(name)) this->prefetch_viewport = true;
+      }
+    }
+  } catch (...) {
+    // Errors are reported once the frame is compiled for real
+    this->prefetch_frame.absolute_root_node.reset();
+  }
+  if (!this->prefetch_frame.absolute_root_node || this->prefetch_viewport) {
+    this->prefetch_frame = PrefetchedFrame();
+    clearCurrentOutput();
+    return false;
+  }
+  auto root = find_root_tag(this->prefetch_frame.absolute_root_node);
+  this->prefetch_frame.root_node = root ? root : this->prefetch_frame.absolute_root_node;
+  this->prefetch_tree.setRoot(this->prefetch_frame.root_node);
+  this->prefetch_tree.setDocumentPath(this->tree.getDocumentPath());
+
+  this->prefetching = true;
+  this->prefetch_cancelled = false;
+  progress_report_prep(this->prefetch_frame.root_node, prefetch_report_func, this);
+  size_t normalizelimit = 2ul * Preferences::inst()->getValue("advanced/openCSGLimit").toUInt();
+  this->prefetchworker->start(this->prefetch_tree, normalizelimit);
+  return true;
+}
+
+void MainWindow::prefetchDone()
+{
+  // The signal of a prefetch cancelled by stopPrefetch()
+  if (this->prefetch_stale_signals > 0) {
+    --this->prefetch_stale_signals;
+    return;
+  }
+  if (!this->prefetching) return;
+  this->prefetchworker->wait();
+  this->prefetching = false;
+  progress_report_fin();
+  clearCurrentOutput();
+
+  auto& frame = this->prefetch_frame;
+  if (!this->prefetchworker->aborted && this->prefetchworker->csgRoot) {
+    frame.csgRoot = std::move(this->prefetchworker->csgRoot);
+    frame.normalizedRoot = std::move(this->prefetchworker->normalizedRoot);
+    frame.root_products = std::move(this->prefetchworker->root_products);
+    frame.highlights_products = std::move(this->prefetchworker->highlights_products);
+    frame.background_products = std::move(this->prefetchworker->background_products);
+    this->prefetched_frames.push_back(std::move(frame));
+    if (this->prefetched_frames.size() > static_cast<size_t>(animationPrefetchFrames)) this->prefetched_frames.pop_front();
+  }
+  this->prefetchworker->clear();
+  this->prefetch_tree.setRoot(nullptr);
+  this->prefetch_frame = PrefetchedFrame();
+
+  if (this->prefetch_waiting) {
+    // Shows the frame, or compiles the current one if playback moved on meanwhile
+    this->prefetch_waiting = false;
+    actionRenderPreview();
+  } else {
+    prefetchAnimationFrame();
+  }
+}
+
+/*!
+   Cancels the prefetch of a frame and waits for it, before anything else uses
+   the progress callback or the caches.
+ */
+void MainWindow::stopPrefetch()
+{
+  if (!this->prefetching) return;
+  this->prefetch_cancelled = true;
+  this->prefetchworker->wait();
+  this->prefetching = false;
+  ++this->prefetch_stale_signals;
+  progress_report_fin();
+  this->prefetchworker->clear();
+  this->prefetch_tree.setRoot(nullptr);
+  this->prefetch_frame = PrefetchedFrame();
+}
+
+/*!
+   Drops the prefetched frames, e.g. when the design, its parameters or the
+   viewport changed. The next frame is compiled before prefetching resumes.
+ */
+void MainWindow::clearPrefetchedFrames()
+{
+  stopPrefetch();
+  this->prefetched_frames.clear();
+  this->prefetch_ready = false;
+  this->prefetch_waiting = false;
+}
+
+void MainWindow::prefetchConsoleOutput(const Message& msgObj, void *userdata)
+{
+  auto thisp = static_cast<MainWindow *>(userdata);
+  QMutexLocker lock(&thisp->prefetchmutex);
+  thisp->prefetch_frame.console.push_back(msgObj);
+}
+
+void MainWindow::prefetchErrorLogOutput(const Message& log_msg, void *userdata)
+{
+  auto thisp = static_cast<MainWindow *>(userdata);
+  QMutexLocker lock(&thisp->prefetchmutex);
+  thisp->prefetch_frame.errorlog.push_back(log_msg);
 }
 
 void MainWindow::action3DPrint()
@@ -2116,6 +2424,14 @@ ExportInfo createExportInfo(FileFormat format, const QString& exportFilename, co
   return exportInfo;
 }
 
+QByteArray exportToMemory(const shared_ptr<const Geometry>& geom, const ExportInfo& exportInfo)
+{
+  std::ostringstream stream(std::ios::out | std::ios::binary);
+  exportFile(geom, stream, exportInfo);
+  const std::string& data = stream.str();
+  return QByteArray(data.data(), static_cast<int>(data.size()));
+}
+
 }
 
 void MainWindow::sendToOctoPrint()
@@ -2144,29 +2460,22 @@ void MainWindow::sendToOctoPrint()
     exportFileFormat = FileFormat::STL;
   }
 
-  QTemporaryFile exportFile{QDir::temp().filePath("OpenSCAD.XXXXXX." + fileFormat.toLower())};
-  if (!exportFile.open()) {
-    LOG("Could not open temporary file.");
-    return;
-  }
-  const QString exportFileName = exportFile.fileName();
-  exportFile.close();
-
   QString userFileName;
   if (activeEditor->filepath.isEmpty()) {
-    userFileName = exportFileName;
+    userFileName = "unsaved." + fileFormat.toLower();
   } else {
     QFileInfo fileInfo{activeEditor->filepath};
     userFileName = fileInfo.baseName() + "." + fileFormat.toLower();
   }
 
-  ExportInfo exportInfo = createExportInfo(exportFileFormat, exportFileName, activeEditor->filepath);
-  exportFileByName(this->root_geom, exportInfo);
+  // Exported into memory rather than a temporary file that is read back for the upload
+  ExportInfo exportInfo = createExportInfo(exportFileFormat, userFileName, activeEditor->filepath);
+  const QByteArray exported = exportToMemory(this->root_geom, exportInfo);
 
   try {
     this->progresswidget = new ProgressWidget(this);
     connect(this->progresswidget, SIGNAL(requestShow()), this, SLOT(showProgress()));
-    const QString fileUrl = octoPrint.upload(exportFileName, userFileName, [this](double v) -> bool {
+    const QString fileUrl = octoPrint.upload(exported, userFileName, [this](double v) -> bool {
       return network_progress_func(v);
     });
 
@@ -2194,17 +2503,6 @@ void MainWindow::sendToPrintService()
   //differentiate between in customer support later.
   static unsigned int printCounter = 0;
 
-  QTemporaryFile exportFile;
-  if (!exportFile.open()) {
-    LOG(message_group::Error, "Could not open temporary file.");
-    return;
-  }
-  const QString exportFilename = exportFile.fileName();
-
-  //Render the stl to a temporary file:
-  ExportInfo exportInfo = createExportInfo(FileFormat::STL, exportFilename, activeEditor->filepath);
-  exportFileByName(this->root_geom, exportInfo);
-
   //Create a name that the order process will use to refer to the file. Base it off of the project name
   QString userFacingName = "unsaved.stl";
   if (!activeEditor->filepath.isEmpty()) {
@@ -2212,12 +2510,9 @@ void MainWindow::sendToPrintService()
     userFacingName = QString{"%1_%2.stl"}.arg(baseName).arg(printCounter++);
   }
 
-  QFile file(exportFilename);
-  if (!file.open(QIODevice::ReadOnly)) {
-    LOG(message_group::Error, "Unable to open exported STL file.");
-    return;
-  }
-  const QString fileContentBase64 = file.readAll().toBase64();
+  //Render the stl into memory:
+  ExportInfo exportInfo = createExportInfo(FileFormat::STL, userFacingName, activeEditor->filepath);
+  const QString fileContentBase64 = exportToMemory(this->root_geom, exportInfo).toBase64();
 
   if (fileContentBase64.length() > PrintService::inst()->getFileSizeLimit()) {
     const auto msg = QString{_("Exported design exceeds the service upload limit of (%1 MB).")}.arg(PrintService::inst()->getFileSizeLimitMB());
@@ -2251,6 +2546,21 @@ void MainWindow::actionRender()
   if (GuiLocker::isLocked()) return;
   GuiLocker::lock();
 
+  this->quickRender = false;
+  prepareCompile("cgalRender", true, false);
+  compile(false);
+}
+
+/*!
+   Renders with Manifold in float precision only, for a quick look at the
+   geometry. The results are cached apart from those of actionRender().
+ */
+void MainWindow::actionQuickRender()
+{
+  if (GuiLocker::isLocked()) return;
+  GuiLocker::lock();
+
+  this->quickRender = true;
   prepareCompile("cgalRender", true, false);
   compile(false);
 }
@@ -2267,16 +2577,21 @@ void MainWindow::cgalRender()
   this->cgalRenderer = nullptr;
   this->root_geom.reset();
 
-  LOG("Rendering Polygon Mesh using %1$s...",
-      Feature::ExperimentalManifold.is_enabled() ? "Manifold" : "CGAL");
+  if (this->quickRender) LOG("Quick rendering Polygon Mesh using Manifold in float precision...");
+  else LOG("Rendering Polygon Mesh using %1$s...", Feature::ExperimentalManifold.is_enabled() ? "Manifold" : "CGAL");
 
   this->progresswidget = new ProgressWidget(this);
   connect(this->progresswidget, SIGNAL(requestShow()), this, SLOT(showProgress()));
 
-  if (!isClosing) progress_report_prep(this->root_node, report_func, this);
-  else return;
+  if (isClosing) return;
+  // Weighed by the expected time of each node in milliseconds, so a single
+  // costly node doesn't leave the progress bar stuck
+  const GeometryEvaluator predictor(this->tree, this->quickRender ? GeometryEvaluator::Precision::Approximate : GeometryEvaluator::Precision::Exact);
+  progress_report_prep(this->root_node, report_func, this, [&predictor](const AbstractNode& node) {
+    return std::max(1, static_cast<int>(predictor.predictedSelfTime(node) * 1000));
+  });
 
-  this->cgalworker->start(this->tree);
+  this->cgalworker->start(this->tree, this->quickRender);
 }
 
 void MainWindow::actionRenderDone(const shared_ptr<const Geometry>& root_geom)
@@ -2463,7 +2778,7 @@ void MainWindow::exceptionCleanup(){
   LOG("Execution aborted");
   LOG(" ");
   GuiLocker::unlock();
-  if (designActionAutoReload->isChecked()) autoReloadTimer->start();
+  if (designActionAutoReload->isChecked()) watchDependencies();
 }
 
 void MainWindow::UnknownExceptionCleanup(std::string msg){
@@ -2475,7 +2790,7 @@ void MainWindow::UnknownExceptionCleanup(std::string msg){
   }
   LOG(" ");
   GuiLocker::unlock();
-  if (designActionAutoReload->isChecked()) autoReloadTimer->start();
+  if (designActionAutoReload->isChecked()) watchDependencies();
 }
 
 void MainWindow::actionDisplayAST()
@@ -2507,7 +2822,8 @@ void MainWindow::actionDisplayCSGTree()
   e->setWindowTitle("CSG Tree Dump");
   e->setReadOnly(true);
   if (this->root_node) {
-    e->setPlainText(QString::fromStdString(this->tree.getString(*this->root_node, "  ")));
+    const auto dump = this->tree.getString(*this->root_node, "  ");
+    e->setPlainText(QString::fromUtf8(dump.data(), dump.size()));
   } else {
     e->setPlainText("No CSG to dump. Please try compiling first...");
   }
@@ -2779,7 +3095,8 @@ void MainWindow::actionExportCSG()
   if (!fstream.is_open()) {
     LOG("Can't open file \"%1$s\" for export", csg_filename.toLocal8Bit().constData());
   } else {
-    fstream << this->tree.getString(*this->root_node, "\t") << "\n";
+    this->tree.writeString(*this->root_node, "\t", fstream);
+    fstream << "\n";
     fstream.close();
     fileExportedMessage("CSG", csg_filename);
     this->export_paths[suffix] = csg_filename;
@@ -2827,13 +3144,21 @@ void MainWindow::actionCopyViewport()
 
 void MainWindow::actionFlushCaches()
 {
+  stopSpeculation();
+  this->last_speculated_doc.clear();
+  clearPrefetchedFrames();
   GeometryCache::instance()->clear();
 #ifdef ENABLE_CGAL
   CGALCache::instance()->clear();
 #endif
   dxf_dim_cache.clear();
   dxf_cross_cache.clear();
+  DxfData::clearCache();
   SourceFileCache::instance()->clear();
+  GlyphCache::instance()->clear();
+  ImportCache::instance()->clear();
+  flush_svg_cache();
+  GeometryEvaluator::clearRoofCache();
 
   setCurrentOutput();
   LOG("Caches Flushed");
@@ -2946,8 +3271,102 @@ void MainWindow::editorContentChanged()
 {
   auto current_doc = activeEditor->toPlainText();
   if (current_doc != last_compiled_doc) {
+    this->prefetch_viewport = false;
     animateWidget->editorContentChanged();
+    // An edit makes the CSG tree being built for the previous text obsolete
+    if (this->csgworker->isRunning() && this->progresswidget) this->progresswidget->cancel();
+    if (Feature::ExperimentalSpeculativeEval.is_enabled()) {
+      this->speculation_cancelled = true;
+      this->speculativeTimer->start();
+    }
+  }
+}
+
+/*!
+   Evaluates the edited text in the background after a pause in typing, so the
+   geometry caches are warm once the preview is requested. The results are
+   thrown away. Parsing and instantiation aren't thread-safe, so only building
+   the CSG tree, which evaluates the geometry, runs on the worker thread.
+ */
+void MainWindow::speculativeEvaluate()
+{
+  if (GuiLocker::isLocked()) return;
+  // Wait for the cancelled evaluation of an older text to wind down
+  if (this->speculativeworker->isRunning()) {
+    this->speculativeTimer->start();
+    return;
+  }
+  stopSpeculation();
+  auto text = activeEditor->toPlainText();
+  if (text == this->last_compiled_doc || text == this->last_speculated_doc) return;
+  this->speculative_doc = text;
+
+  // Messages are those of a text which may still be incomplete
+  hideCurrentOutput();
+  bool instantiated = false;
+  try {
+    auto fulltext = std::string(text.toUtf8().constData()) + "\n\x03\n" + commandline_commands;
+    auto fnameba = activeEditor->filepath.toLocal8Bit();
+    const char *fname = activeEditor->filepath.isEmpty() ? "" : fnameba;
+    if (parse(this->speculative_file, fulltext, fname, fname, false)) {
+      this->speculative_file->handleDependencies();
+
+      boost::filesystem::path doc(activeEditor->filepath.toStdString());
+      EvaluationSession session{doc.parent_path().string()};
+      ContextHandle<BuiltinContext> builtin_context{Context::create<BuiltinContext>(&session)};
+      setRenderVariables(builtin_context);
+      builtin_context->set_variable("$preview", Value(true));
+
+      std::shared_ptr<const FileContext> file_context;
+      auto absolute_root = this->speculative_file->instantiate(*builtin_context, &file_context);
+      if (absolute_root) {
+        auto root = find_root_tag(absolute_root);
+        this->speculative_tree.setRoot(root ? root : absolute_root);
+        this->speculative_tree.setDocumentPath(doc.parent_path().string());
+        instantiated = true;
+      }
+    }
+  } catch (...) {
+    // Errors show up once the text is compiled for real
+  }
+  if (!instantiated) {
+    setCurrentOutput();
+    return;
   }
+
+  this->speculating = true;
+  this->speculation_cancelled = false;
+  progress_report_prep(this->speculative_tree.root(), speculative_report_func, this);
+  size_t normalizelimit = 2ul * Preferences::inst()->getValue("advanced/openCSGLimit").toUInt();
+  this->speculativeworker->start(this->speculative_tree, normalizelimit);
+}
+
+void MainWindow::speculativeDone()
+{
+  // Already finished by stopSpeculation()
+  if (!this->speculating) return;
+  // Not repeated until the text changes
+  if (!this->speculation_cancelled) this->last_speculated_doc = this->speculative_doc;
+  // Finishes the evaluation through stopSpeculation()
+  setCurrentOutput();
+}
+
+/*!
+   Cancels the background evaluation and waits for it, before anything else uses
+   the output handler, the progress callback or the caches.
+ */
+void MainWindow::stopSpeculation()
+{
+  if (this->speculating) {
+    this->speculation_cancelled = true;
+    this->speculativeworker->wait();
+    this->speculating = false;
+    progress_report_fin();
+  }
+  this->speculativeworker->clear();
+  this->speculative_tree.setRoot(nullptr);
+  delete this->speculative_file;
+  this->speculative_file = nullptr;
 }
 
 void MainWindow::viewAngleTop()
@@ -3499,6 +3918,8 @@ void MainWindow::closeEvent(QCloseEvent *event)
     for (auto dock : findChildren<Dock *>()) {
       dock->disableSettingsUpdate();
     }
+    // The cache entries of the window's tabs go first from now on
+    for (auto *edt : tabManager->editorList) CacheOwners::instance()->remove(edt->cacheOwner);
     event->accept();
   } else {
     event->ignore();
@@ -3558,7 +3979,11 @@ void MainWindow::consoleOutput(const Message& msgObj)
   }
   // FIXME: scad parsing/evaluation should be done on separate thread so as not to block the gui.
   // Then processEvents should no longer be needed here.
-  this->processEvents();
+  // Processing events for every message would make scripts echoing in loops crawl.
+  if (!this->consoleEventsThrottle.isValid() || this->consoleEventsThrottle.hasExpired(20)) {
+    this->processEvents();
+    this->consoleEventsThrottle.start();
+  }
   if (consoleUpdater && !consoleUpdater->isActive()) {
     consoleUpdater->start(50); // Limit console updates to 20 FPS
   }
@@ -3583,6 +4008,8 @@ void MainWindow::errorLogOutput(const Message& log_msg)
 
 void MainWindow::setCurrentOutput()
 {
+  stopSpeculation();
+  stopPrefetch();
   set_output_handler(&MainWindow::consoleOutput, &MainWindow::errorLogOutput, this);
 }
 
@@ -5,6 +5,7 @@
 #include "export.h"
 #include "ExportPdfDialog.h"
 #include "memory.h"
+#include "printutils.h"
 #include "RenderStatistic.h"
 #include "TabManager.h"
 #include "Tree.h"
@@ -12,6 +13,8 @@
 #include "qtgettext.h" // IWYU pragma: keep
 #include "ui_MainWindow.h"
 
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <string>
 #include <vector>
@@ -29,6 +32,7 @@ Q_IMPORT_PLUGIN(QSvgPlugin)
 
 class BuiltinContext;
 class CGALWorker;
+class CSGWorker;
 class CSGNode;
 class CSGProducts;
 class FontListDialog;
@@ -49,6 +53,7 @@ public:
   bool is_preview;
 
   QTimer *autoReloadTimer;
+  class QFileSystemWatcher *fileWatcher;
   QTimer *waitAfterReloadTimer;
   RenderStatistic renderStatistic;
 
@@ -72,6 +77,8 @@ public:
 #endif
 #ifdef ENABLE_OPENCSG
   class OpenCSGRenderer *opencsgRenderer;
+  // Vertex buffers of the last preview, for the products unchanged by a recompile
+  std::shared_ptr<class OpenCSGVBOCache> opencsgVBOCache;
   std::unique_ptr<class MouseSelector> selector;
 #endif
   ThrownTogetherRenderer *thrownTogetherRenderer;
@@ -134,6 +141,13 @@ private:
   void updateCompileResult();
   void compile(bool reload, bool forcedone = false);
   void compileCSG();
+  void watchDependencies();
+  void stopSpeculation();
+  bool previewPrefetchedFrame();
+  bool startPrefetch(double tval);
+  void stopPrefetch();
+  void createPreviewRenderers();
+  void displayPreview();
   bool checkEditorModified();
   QString dumpCSGTree(const std::shared_ptr<AbstractNode>& root);
 
@@ -234,14 +248,19 @@ protected:
 
 public slots:
   void actionRenderPreview();
+  void clearPrefetchedFrames();
 private slots:
   void csgRender();
+  void csgRenderDone();
   void csgReloadRender();
+  void csgReloadRenderDone();
+  void compileCSGDone();
   void action3DPrint();
   void sendToOctoPrint();
   void sendToPrintService();
 #ifdef ENABLE_CGAL
   void actionRender();
+  void actionQuickRender();
   void actionRenderDone(const shared_ptr<const Geometry>&);
   void cgalRender();
 #endif
@@ -336,6 +355,10 @@ public slots:
   void viewResetView();
   void viewAll();
   void editorContentChanged();
+  void speculativeEvaluate();
+  void speculativeDone();
+  void prefetchAnimationFrame();
+  void prefetchDone();
   void selectObject(QPoint coordinate);
   void dragEnterEvent(QDragEnterEvent *event) override;
   void dropEvent(QDropEvent *event) override;
@@ -349,12 +372,17 @@ public slots:
   void helpFontInfo();
   void quit();
   void checkAutoReload();
+  void dependencyChanged(const QString& path);
   void waitAfterReload();
   void autoReloadSet(bool);
 
 private:
   bool network_progress_func(const double permille);
   static void report_func(const std::shared_ptr<const AbstractNode>&, void *vp, int mark);
+  static void speculative_report_func(const std::shared_ptr<const AbstractNode>&, void *vp, int mark);
+  static void prefetch_report_func(const std::shared_ptr<const AbstractNode>&, void *vp, int mark);
+  static void prefetchConsoleOutput(const Message& msgObj, void *userdata);
+  static void prefetchErrorLogOutput(const Message& log_msg, void *userdata);
   static bool undockMode;
   static bool reorderMode;
   static const int tabStopWidth;
@@ -369,13 +397,54 @@ private:
 
   char const *afterCompileSlot;
   bool procevents{false};
+  QElapsedTimer consoleEventsThrottle; // Limits event processing for console output
   QTemporaryFile *tempFile{nullptr};
   ProgressWidget *progresswidget{nullptr};
   CGALWorker *cgalworker;
+  // Whether the running render is a quick one, see actionQuickRender()
+  bool quickRender{false};
+  CSGWorker *csgworker;
+  char const *afterCSGSlot;
+  // Evaluation of the edited text in the background, see speculativeEvaluate()
+  QTimer *speculativeTimer;
+  CSGWorker *speculativeworker;
+  SourceFile *speculative_file{nullptr};
+  Tree speculative_tree;
+  QString speculative_doc;
+  // The text last evaluated to the end, which isn't evaluated again
+  QString last_speculated_doc;
+  bool speculating{false};
+  std::atomic<bool> speculation_cancelled{false};
+  // A frame of the playing animation evaluated ahead, see prefetchAnimationFrame()
+  struct PrefetchedFrame {
+    double tval{0.0};
+    std::shared_ptr<AbstractNode> absolute_root_node;
+    std::shared_ptr<AbstractNode> root_node;
+    shared_ptr<CSGNode> csgRoot;
+    shared_ptr<CSGNode> normalizedRoot;
+    shared_ptr<CSGProducts> root_products;
+    shared_ptr<CSGProducts> highlights_products;
+    shared_ptr<CSGProducts> background_products;
+    std::vector<Message> console; // Shown with the frame
+    std::vector<Message> errorlog;
+  };
+  CSGWorker *prefetchworker;
+  Tree prefetch_tree;
+  PrefetchedFrame prefetch_frame; // The frame being prefetched
+  std::deque<PrefetchedFrame> prefetched_frames;
+  QMutex prefetchmutex; // For the messages of prefetch_frame, which may come from the worker
+  bool prefetching{false};
+  bool prefetch_ready{false}; // root_file is the one of the last preview, with the current parameters
+  bool prefetch_waiting{false}; // The preview shows prefetch_frame once done
+  bool prefetch_viewport{false}; // The design sets the viewport, which each frame must update
+  int prefetch_stale_signals{0}; // Pending done() signals of cancelled prefetches
+  std::atomic<bool> prefetch_cancelled{false};
+  bool preview_requested{false};
   QMutex consolemutex;
   EditorInterface *renderedEditor; // stores pointer to editor which has been most recently rendered
   time_t includes_mtime{0}; // latest include mod time
   time_t deps_mtime{0}; // latest dependency mod time
+  std::string reusable_parse; // file name and text of the last parse, if it can be kept for parameter changes
   std::unordered_map<std::string, QString> export_paths; // for each file type, where it was exported to last
   QString exportPath(const char *suffix); // look up the last export path and generate one if not found
   int last_parser_error_pos{-1}; // last highlighted error position
@@ -14,6 +14,10 @@
  * per color channel to store the identifier.
  * Increasing this should be done carefully while testing on older graphics cards, they
  * might do "fancy" optimization.
+ *
+ * Only the pixel below the mouse is rendered. The projection is narrowed to that pixel,
+ * so the renderers' view frustum culling skips every object whose bounding box misses
+ * it, and the framebuffer is a single pixel.
  */
 
 MouseSelector::MouseSelector(GLView *view) {
@@ -26,12 +30,9 @@ MouseSelector::MouseSelector(GLView *view) {
   if (view) this->reset(view);
 }
 
-/**
- * Resize the framebuffer whenever it changed
- */
 void MouseSelector::reset(GLView *view) {
   this->view = view;
-  this->setup_framebuffer(view);
+  this->setup_framebuffer();
 }
 
 /**
@@ -112,16 +113,11 @@ void MouseSelector::init_shader() {
 }
 
 /**
- * Resize or create the framebuffer
+ * Create the single pixel framebuffer
  */
-void MouseSelector::setup_framebuffer(const GLView *view) {
-  if (!this->framebuffer ||
-      static_cast<unsigned int>(this->framebuffer->width()) != view->cam.pixel_width ||
-      static_cast<unsigned int>(this->framebuffer->height()) != view->cam.pixel_height) {
-    this->framebuffer = std::make_unique<QOpenGLFramebufferObject>(
-      view->cam.pixel_width,
-      view->cam.pixel_width,
-      QOpenGLFramebufferObject::Depth);
+void MouseSelector::setup_framebuffer() {
+  if (!this->framebuffer) {
+    this->framebuffer = std::make_unique<QOpenGLFramebufferObject>(1, 1, QOpenGLFramebufferObject::Depth);
     this->framebuffer->release();
   }
 }
@@ -142,18 +138,25 @@ int MouseSelector::select(const Renderer *renderer, int x, int y) {
     return -1;
   }
 
-  // Initialize GL to draw to texture
-  // Ideally a texture of only 1x1 or 2x2 pixels as a subset of the viewing frustrum
-  // of the currently selected frame.
-  // For now, i will use a texture the same size as the normal viewport
-  // and select the identifier at the mouse coordinates
+  // Draw to the single pixel framebuffer
   GL_CHECKD(this->framebuffer->bind());
 
   glClearColor(0, 0, 0, 1.0);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-  glViewport(0, 0, this->view->cam.pixel_width, this->view->cam.pixel_height);
+  glViewport(0, 0, 1, 1);
   this->view->setupCamera();
+
+  // Map the pixel at x/y to the whole viewport, like gluPickMatrix()
+  GLdouble projection[16];
+  glMatrixMode(GL_PROJECTION);
+  glGetDoublev(GL_PROJECTION_MATRIX, projection);
+  glLoadIdentity();
+  glTranslated(this->view->cam.pixel_width - 2.0 * (x + 0.5), this->view->cam.pixel_height - 2.0 * (y + 0.5), 0.0);
+  glScaled(this->view->cam.pixel_width, this->view->cam.pixel_height, 1.0);
+  glMultMatrixd(projection);
+  glMatrixMode(GL_MODELVIEW);
+
   glTranslated(this->view->cam.object_trans.x(),
                this->view->cam.object_trans.y(),
                this->view->cam.object_trans.z());
@@ -167,19 +170,16 @@ int MouseSelector::select(const Renderer *renderer, int x, int y) {
   // call the renderer with the selector shader
   GL_CHECKD(renderer->draw(true, false, &this->shaderinfo));
 
-  // Not strictly necessary, but a nop if not required.
-  glFlush();
-  glFinish();
-
   // Grab the color from the framebuffer and convert it back to an identifier
   GLubyte color[3] = { 0 };
-  GL_CHECKD(glReadPixels(x, y, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, color));
+  GL_CHECKD(glReadPixels(0, 0, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, color));
   glDisable(GL_DEPTH_TEST);
 
   int index = (uint32_t)color[0] | ((uint32_t)color[1] << 8) | ((uint32_t)color[2] << 16);
 
-  // Switch the active framebuffer back to the default
+  // Switch the active framebuffer and viewport back to the default
   this->framebuffer->release();
+  glViewport(0, 0, this->view->cam.pixel_width, this->view->cam.pixel_height);
 
   return index;
 }
@@ -14,7 +14,7 @@ class MouseSelector
 public:
   MouseSelector(GLView *view);
 
-  /// Resize the renderbuffer
+  /// Set the view to select from
   void reset(GLView *view);
 
   int select(const Renderer *renderer, int x, int y);
@@ -23,7 +23,7 @@ public:
 
 private:
   void init_shader();
-  void setup_framebuffer(const GLView *view);
+  void setup_framebuffer();
 
   std::unique_ptr<QOpenGLFramebufferObject> framebuffer;
 
@@ -28,6 +28,7 @@
 #include "OctoPrint.h"
 
 #include <utility>
+#include <QBuffer>
 #include "printutils.h"
 #include "PlatformUtils.h"
 
@@ -104,16 +105,18 @@ const std::pair<const QString, const QString> OctoPrint::getVersion() const
   return result;
 }
 
-const QString OctoPrint::upload(const QString& exportFileName, const QString& fileName, const network_progress_func_t& progress_func) const {
+// Uploads the exported data straight from memory
+const QString OctoPrint::upload(const QByteArray& data, const QString& fileName, const network_progress_func_t& progress_func) const {
 
   auto *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
   QHttpPart filePart;
   filePart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant{R"(form-data; name="file"; filename=")" + fileName + "\""});
   filePart.setHeader(QNetworkRequest::ContentTypeHeader, QVariant{"application/octet-stream"});
 
-  auto *file = new QFile(exportFileName, multiPart);
-  file->open(QIODevice::ReadOnly);
-  filePart.setBodyDevice(file);
+  auto *buffer = new QBuffer(multiPart);
+  buffer->setData(data);
+  buffer->open(QIODevice::ReadOnly);
+  filePart.setBodyDevice(buffer);
 
   multiPart->append(filePart);
 
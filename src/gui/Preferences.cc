@@ -34,6 +34,7 @@
 #include <QTextDocument>
 #include <boost/algorithm/string.hpp>
 #include "GeometryCache.h"
+#include "parallel.h"
 #include "AutoUpdater.h"
 #include "Feature.h"
 #ifdef ENABLE_CGAL
@@ -122,6 +123,7 @@ void Preferences::init() {
   this->defaultmap["advanced/cgalCacheSizeMB"] = getValue("advanced/cgalCacheSize").toULongLong() / (1024ul * 1024ul); // carry over old settings if they exist
 #endif
   this->defaultmap["advanced/openCSGLimit"] = RenderSettings::inst()->openCSGTermLimit;
+  this->defaultmap["advanced/threads"] = 0;
   this->defaultmap["advanced/forceGoldfeather"] = false;
   this->defaultmap["advanced/undockableWindows"] = false;
   this->defaultmap["advanced/reorderWindows"] = true;
@@ -180,6 +182,7 @@ void Preferences::init() {
 #endif
   this->polysetCacheSizeMBEdit->setValidator(memvalidator);
   this->opencsgLimitEdit->setValidator(uintValidator);
+  this->threadsEdit->setValidator(uintValidator);
   this->timeThresholdOnRenderCompleteSoundEdit->setValidator(uintValidator);
   this->consoleMaxLinesEdit->setValidator(uintValidator);
   this->lineEditCharacterThreshold->setValidator(validator1);
@@ -452,6 +455,13 @@ void Preferences::on_polysetCacheSizeMBEdit_textChanged(const QString& text)
   GeometryCache::instance()->setMaxSizeMB(text.toULong());
 }
 
+void Preferences::on_threadsEdit_textChanged(const QString& text)
+{
+  QSettingsCached settings;
+  settings.setValue("advanced/threads", text);
+  set_parallel_threads(text.toUInt());
+}
+
 void Preferences::on_opencsgLimitEdit_textChanged(const QString& text)
 {
   QSettingsCached settings;
@@ -510,6 +520,20 @@ void Preferences::on_checkBoxMouseSwapButtons_toggled(bool val)
   emit updateMouseSwapButtons(val);
 }
 
+void Preferences::on_checkBoxAdaptiveResolution_toggled(bool val)
+{
+  Settings::Settings::adaptiveResolution.setValue(val);
+  writeSettings();
+  emit updateAdaptiveResolution(val);
+}
+
+void Preferences::on_checkBoxHideEdgesWhileMoving_toggled(bool val)
+{
+  Settings::Settings::hideEdgesWhileMoving.setValue(val);
+  writeSettings();
+  emit updateHideEdgesWhileMoving(val);
+}
+
 void Preferences::on_spinBoxIndentationWidth_valueChanged(int val)
 {
   Settings::Settings::indentationWidth.setValue(val);
@@ -958,6 +982,7 @@ void Preferences::updateGUI()
   BlockSignals<QLineEdit *>(this->cgalCacheSizeMBEdit)->setText(getValue("advanced/cgalCacheSizeMB").toString());
   BlockSignals<QLineEdit *>(this->polysetCacheSizeMBEdit)->setText(getValue("advanced/polysetCacheSizeMB").toString());
   BlockSignals<QLineEdit *>(this->opencsgLimitEdit)->setText(getValue("advanced/openCSGLimit").toString());
+  BlockSignals<QLineEdit *>(this->threadsEdit)->setText(getValue("advanced/threads").toString());
   BlockSignals<QCheckBox *>(this->localizationCheckBox)->setChecked(getValue("advanced/localization").toBool());
   BlockSignals<QCheckBox *>(this->autoReloadRaiseCheckBox)->setChecked(getValue("advanced/autoReloadRaise").toBool());
   BlockSignals<QCheckBox *>(this->forceGoldfeatherBox)->setChecked(getValue("advanced/forceGoldfeather").toBool());
@@ -1028,6 +1053,8 @@ void Preferences::updateGUI()
   initUpdateCheckBox(this->checkBoxShowWarningsIn3dView, Settings::Settings::showWarningsIn3dView);
   initUpdateCheckBox(this->checkBoxMouseCentricZoom, Settings::Settings::mouseCentricZoom);
   initUpdateCheckBox(this->checkBoxMouseSwapButtons, Settings::Settings::mouseSwapButtons);
+  initUpdateCheckBox(this->checkBoxAdaptiveResolution, Settings::Settings::adaptiveResolution);
+  initUpdateCheckBox(this->checkBoxHideEdgesWhileMoving, Settings::Settings::hideEdgesWhileMoving);
   initUpdateCheckBox(this->checkBoxEnableLineNumbers, Settings::Settings::enableLineNumbers);
 
 
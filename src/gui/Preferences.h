@@ -36,6 +36,7 @@ public slots:
   void on_cgalCacheSizeMBEdit_textChanged(const QString&);
   void on_polysetCacheSizeMBEdit_textChanged(const QString&);
   void on_opencsgLimitEdit_textChanged(const QString&);
+  void on_threadsEdit_textChanged(const QString&);
   void on_forceGoldfeatherBox_toggled(bool);
   void on_mouseWheelZoomBox_toggled(bool);
   void on_localizationCheckBox_toggled(bool);
@@ -62,6 +63,8 @@ public slots:
   void on_checkBoxShowWarningsIn3dView_toggled(bool);
   void on_checkBoxMouseCentricZoom_toggled(bool);
   void on_checkBoxMouseSwapButtons_toggled(bool);
+  void on_checkBoxAdaptiveResolution_toggled(bool);
+  void on_checkBoxHideEdgesWhileMoving_toggled(bool);
   void on_timeThresholdOnRenderCompleteSoundEdit_textChanged(const QString&);
   void on_enableClearConsoleCheckBox_toggled(bool);
   void on_consoleMaxLinesEdit_textChanged(const QString&);
@@ -122,6 +125,8 @@ signals:
   void ExperimentalChanged() const;
   void updateMouseCentricZoom(bool state) const;
   void updateMouseSwapButtons(bool state) const;
+  void updateAdaptiveResolution(bool state) const;
+  void updateHideEdgesWhileMoving(bool state) const;
   void autocompleteChanged(bool status) const;
   void characterThresholdChanged(int val) const;
   void stepSizeChanged(int val) const;
@@ -37,9 +37,22 @@ void ProgressWidget::setRange(int minimum, int maximum)
   this->progressBar->setRange(minimum, maximum);
 }
 
+/*!
+   Sets the progress, and shows the time left once it can be extrapolated
+   from the time elapsed.
+ */
 void ProgressWidget::setValue(int progress)
 {
   this->progressBar->setValue(progress);
+  const auto done = progress - this->progressBar->minimum();
+  const auto range = this->progressBar->maximum() - this->progressBar->minimum();
+  const auto elapsed = elapsedTime();
+  if (done > 0 && done < range && elapsed > 2000) {
+    const auto left = static_cast<int>(double(elapsed) * (range - done) / done / 1000);
+    this->progressBar->setFormat(QString(_("%v / %m, about %1 left")).arg(left < 60 ? QString(_("%1 s")).arg(left) : QString(_("%1 min")).arg((left + 30) / 60)));
+  } else {
+    this->progressBar->setFormat("%v / %m");
+  }
 }
 
 int ProgressWidget::value() const
@@ -29,6 +29,7 @@
 #include "Preferences.h"
 #include "Renderer.h"
 #include "degree_trig.h"
+#include "fbo.h"
 #if defined(USE_GLEW) || defined(OPENCSG_GLEW)
 #include "glew-utils.h"
 #endif
@@ -49,6 +50,7 @@
 #endif
 #include "OpenCSGWarningDialog.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <sstream>
 
@@ -58,6 +60,11 @@
 
 #include "qt-obsolete.h"
 
+// Time without camera changes after which the view counts as still
+static const int movingSettleMS = 150;
+// Reduction of the width and height of frames painted while moving
+static const int reducedResolutionFactor = 2;
+
 QGLView::QGLView(QWidget *parent) : QOpenGLWidget(parent)
 {
   init();
@@ -70,9 +77,27 @@ void QGLView::init()
   this->mouse_drag_active = false;
   this->statusLabel = nullptr;
 
+  this->movingTimer = new QTimer(this);
+  this->movingTimer->setSingleShot(true);
+  this->movingTimer->setInterval(movingSettleMS);
+  connect(this->movingTimer, SIGNAL(timeout()), this, SLOT(movingStopped()));
+
+  // Keep the frame in the framebuffer after it's composed, so repaints can reuse it
+  setUpdateBehavior(QOpenGLWidget::PartialUpdate);
   setMouseTracking(true);
 }
 
+/*!
+   Everything changing the scene, the camera or the view settings asks for
+   a new frame with this, while the repaints Qt does on its own, e.g. when
+   the window is exposed or the console scrolls, leave the frame as it is.
+ */
+void QGLView::update()
+{
+  this->frame_valid = false;
+  QOpenGLWidget::update();
+}
+
 void QGLView::resetView()
 {
   cam.resetView();
@@ -106,6 +131,7 @@ void QGLView::initializeGL()
   PRINTDB("GLAD: Loaded OpenGL %d.%d", GLAD_VERSION_MAJOR(version) % GLAD_VERSION_MINOR(version));
 #endif // ifdef USE_GLAD
   GLView::initializeGL();
+  this->frame_valid = false;
 }
 
 std::string QGLView::getRendererInfo() const
@@ -165,12 +191,19 @@ void QGLView::display_opencsg_warning_dialog()
 void QGLView::resizeGL(int w, int h)
 {
   GLView::resizeGL(w, h);
+  // The framebuffer was recreated
+  this->frame_valid = false;
   emit resized();
 }
 
 void QGLView::paintGL()
 {
-  GLView::paintGL();
+  if (this->frame_valid) return;
+
+  const bool edges = this->showedges;
+  if (this->moving && this->hideEdgesWhileMoving) this->showedges = false;
+  if (!this->moving || !paintReduced()) GLView::paintGL();
+  this->showedges = edges;
 
   if (statusLabel) {
     auto status = QString("%1 (%2x%3)")
@@ -179,6 +212,66 @@ void QGLView::paintGL()
       .arg(size().rheight());
     statusLabel->setText(status);
   }
+  this->frame_valid = true;
+}
+
+/*!
+   Paints the view into a framebuffer with a fraction of the widget's
+   resolution, and scales it up to the widget. Returns false if this isn't
+   supported, so the view is painted as usual.
+ */
+bool QGLView::paintReduced()
+{
+  if (!this->adaptiveResolution || this->format().samples() > 0 || !hasGLExtension(ARB_framebuffer_object)) return false;
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  const int width = std::max(1, viewport[2] / reducedResolutionFactor);
+  const int height = std::max(1, viewport[3] / reducedResolutionFactor);
+  if (!this->reduced_fbo) {
+    this->reduced_fbo = fbo_new();
+    if (!fbo_init(this->reduced_fbo, width, height)) {
+      fbo_delete(this->reduced_fbo);
+      this->reduced_fbo = nullptr;
+      // Don't try again until the preference is set again
+      this->adaptiveResolution = false;
+      glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+      return false;
+    }
+  } else if (width != this->reduced_width || height != this->reduced_height) {
+    if (!fbo_resize(this->reduced_fbo, width, height)) return false;
+  }
+  this->reduced_width = width;
+  this->reduced_height = height;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, this->reduced_fbo->fbo_id);
+  glViewport(0, 0, width, height);
+  this->render_scale = reducedResolutionFactor;
+  GLView::paintGL();
+  this->render_scale = 1.0f;
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, this->reduced_fbo->fbo_id);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, defaultFramebufferObject());
+  glBlitFramebuffer(0, 0, width, height,
+                    viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+                    GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  return true;
+}
+
+// Called on every camera change, the full frame is painted once the view is still
+void QGLView::viewMoved()
+{
+  if (!this->adaptiveResolution && !this->hideEdgesWhileMoving) return;
+  this->moving = true;
+  this->movingTimer->start();
+}
+
+void QGLView::movingStopped()
+{
+  this->moving = false;
+  update();
 }
 
 void QGLView::mousePressEvent(QMouseEvent *event)
@@ -271,6 +364,7 @@ void QGLView::mouseDoubleClickEvent(QMouseEvent *event) {
 
   if (success == GL_TRUE) {
     cam.object_trans -= Vector3d(px, py, pz);
+    viewMoved();
     update();
     emit cameraChanged();
   }
@@ -386,6 +480,7 @@ void QGLView::ZoomOut()
 void QGLView::zoom(double v, bool relative)
 {
   this->cam.zoom(v, relative);
+  viewMoved();
   update();
   emit cameraChanged();
 }
@@ -393,6 +488,7 @@ void QGLView::zoom(double v, bool relative)
 void QGLView::zoomFov(double v)
 {
   this->cam.setVpf( this->cam.fovValue () * pow(0.9, v / 120.0));
+  viewMoved();
   update();
   emit cameraChanged();
 }
@@ -447,6 +543,7 @@ void QGLView::translate(double x, double y, double z, bool relative, bool viewPo
   cam.object_trans.x() = f * cam.object_trans.x() + tm(0, 3);
   cam.object_trans.y() = f * cam.object_trans.y() + tm(1, 3);
   cam.object_trans.z() = f * cam.object_trans.z() + tm(2, 3);
+  viewMoved();
   update();
   emit cameraChanged();
 }
@@ -460,6 +557,7 @@ void QGLView::rotate(double x, double y, double z, bool relative)
   normalizeAngle(cam.object_rot.x());
   normalizeAngle(cam.object_rot.y());
   normalizeAngle(cam.object_rot.z());
+  viewMoved();
   update();
   emit cameraChanged();
 }
@@ -507,6 +605,7 @@ void QGLView::rotate2(double x, double y, double z)
   normalizeAngle(cam.object_rot.y());
   normalizeAngle(cam.object_rot.z());
 
+  viewMoved();
   update();
   emit cameraChanged();
 }
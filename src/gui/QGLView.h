@@ -9,6 +9,9 @@
 #include <Eigen/Geometry>
 #include "GLView.h"
 
+struct fbo_t;
+class QTimer;
+
 class QGLView : public QOpenGLWidget, public GLView
 {
   Q_OBJECT
@@ -30,7 +33,7 @@ public:
   bool showScaleProportional() const { return this->showscale; }
   void setShowScaleProportional(bool enabled) { this->showscale = enabled; }
   std::string getRendererInfo() const override;
-  float getDPI() override { return this->devicePixelRatio(); }
+  float getDPI() override { return this->devicePixelRatio() / this->render_scale; }
 
   const QImage& grabFrame();
   bool save(const char *filename) const override;
@@ -38,6 +41,8 @@ public:
   void viewAll();
 
 public slots:
+  // Paints a new frame, unlike the paint events from Qt, e.g. on expose, which show the last one
+  void update();
   void ZoomIn();
   void ZoomOut();
   void setMouseCentricZoom(bool var){
@@ -46,6 +51,12 @@ public slots:
   void setMouseSwapButtons(bool var){
     this->mouseSwapButtons = var;
   }
+  void setAdaptiveResolution(bool var){
+    this->adaptiveResolution = var;
+  }
+  void setHideEdgesWhileMoving(bool var){
+    this->hideEdgesWhileMoving = var;
+  }
 
 public:
   QLabel *statusLabel;
@@ -59,6 +70,8 @@ public:
 
 private:
   void init();
+  void viewMoved();
+  bool paintReduced();
 
   bool mouse_drag_active;
   bool mouse_drag_moved = true;
@@ -66,6 +79,18 @@ private:
   bool mouseSwapButtons = false;
   QPoint last_mouse;
   QImage frame; // Used by grabFrame() and save()
+  // The widget's framebuffer holds the frame for the current scene, camera and settings
+  bool frame_valid = false;
+
+  // While the view moves, frames may be painted at a reduced resolution
+  bool adaptiveResolution = true;
+  bool hideEdgesWhileMoving = false;
+  bool moving = false;
+  float render_scale = 1.0f;
+  QTimer *movingTimer;
+  fbo_t *reduced_fbo = nullptr;
+  int reduced_width = 0;
+  int reduced_height = 0;
 
   void wheelEvent(QWheelEvent *event) override;
   void mousePressEvent(QMouseEvent *event) override;
@@ -84,6 +109,8 @@ private:
 private slots:
   void display_opencsg_warning_dialog();
 #endif
+private slots:
+  void movingStopped();
 
 signals:
   void cameraChanged();
@@ -49,7 +49,7 @@ QStringList getSorted(const QFileInfoList& list, C cond) {
 
 ScadApi::ScadApi(ScintillaEditor *editor, QsciLexer *lexer) : QsciAbstractAPIs(lexer), editor(editor)
 {
-  for (const auto& iter : Builtins::keywordList) {
+  for (const auto& iter : Builtins::keywords()) {
     QStringList calltipList;
     for (const auto& it : iter.second)
       calltipList.append(QString::fromStdString(it));
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <string>
+#include <vector>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/split.hpp>
 
@@ -190,17 +192,27 @@ void Lex::lex_results(const std::string& input, int start, LexInterface *const o
 #endif
   lexertl::smatch results(input.begin(), input.end());
 
-  //The editor can ask to only lex from a starting point.
-  //This can be faster the lexing the whole text,
-  //but requires the lexer to try to restore the lexer state.
-  //We currently handle comments (COMMENT State) pretty well.
-  //We currently do not handle include/use (PATH State).
-  int isstyle = obj->getStyleAt(start - 1);
-  if (isstyle == ecomment) results.state = rules_.state("COMMENT");
+  //The editor asks to only lex from the start of the first line changed,
+  //so the lexer state is restored from the end of the line before, as
+  //kept by the last pass. Without one, comments are recognized by style.
+  int line = obj->lineFromPosition(start);
+  const int state = line > 0 ? obj->getLineState(line - 1) : 0;
+  if (state >= 0) {
+    results.state = state;
+  } else if (obj->getStyleAt(start - 1) == ecomment) {
+    results.state = rules_.state("COMMENT");
+  }
 
   lexertl::lookup(sm, results);
   while (results.id != eEOF) {
     obj->highlighting(start, input, results);
+    // Lines ending inside a token, e.g. a string, can't be lexed from their end,
+    // except inside a multiline comment
+    for (auto it = results.first; it != results.second; ++it) {
+      if (*it != '\n') continue;
+      const bool known = it + 1 == results.second || results.id == ecomment;
+      obj->setLineState(line++, known ? static_cast<int>(results.state) : -1);
+    }
     lexertl::lookup(sm, results);
   }
 }
@@ -223,23 +235,21 @@ void ScadLexer2::styleText(int start, int end)
 #if DEBUG_LEXERTL
   std::cout << "start: " << start << std::endl;
 #endif
-  if (!editor()) return;
+  if (!editor() || end <= start) return;
 
-  char *data = new char[end - start + 1];
-  editor()->SendScintilla(QsciScintilla::SCI_GETTEXTRANGE, start, end, data);
-  QString source(data);
-  const std::string input(source.toStdString());
+  // Positions are in bytes, so the text is lexed as is
+  std::vector<char> data(end - start + 1);
+  editor()->SendScintilla(QsciScintilla::SCI_GETTEXTRANGE, start, end, data.data());
+  const std::string input(data.data(), end - start);
 
 #if DEBUG_LEXERTL
   auto pos = editor()->SendScintilla(QsciScintilla::SCI_GETCURRENTPOS);
   std::cout << "its being called" << std::endl;
 #endif
 
+  styles.assign(input.size(), OtherText);
   my_lexer->lex_results(input, start, this);
-  this->fold(start, end);
-
-  delete [] data;
-  if (source.isEmpty()) return;
+  this->fold(start, input);
 }
 
 void ScadLexer2::autoScroll(int error_pos)
@@ -248,20 +258,23 @@ void ScadLexer2::autoScroll(int error_pos)
   editor()->SendScintilla(QsciScintilla::SCI_SCROLLCARET);
 }
 
-void ScadLexer2::fold(int start, int end)
+// Uses the text and styles of the pass instead of asking the editor for each character
+void ScadLexer2::fold(int start, const std::string& input)
 {
-  char chNext = editor()->SendScintilla(QsciScintilla::SCI_GETCHARAT, start);
+  const int end = start + static_cast<int>(input.size());
   int lineCurrent = editor()->SendScintilla(QsciScintilla::SCI_LINEFROMPOSITION, start);
   int levelPrev = editor()->SendScintilla(QsciScintilla::SCI_GETFOLDLEVEL, lineCurrent) & QsciScintilla::SC_FOLDLEVELNUMBERMASK;
   int levelCurrent = levelPrev;
+  int prevStyle = getStyleAt(start - 1);
   for (int i = start; i < end; i++) {
-    char ch = chNext;
-    chNext = editor()->SendScintilla(QsciScintilla::SCI_GETCHARAT, i + 1);
+    const size_t offset = i - start;
+    char ch = input[offset];
+    char chNext = offset + 1 < input.size() ? input[offset + 1] : static_cast<char>(editor()->SendScintilla(QsciScintilla::SCI_GETCHARAT, end));
 
     bool atEOL = ((ch == '\r' && chNext != '\n') || (ch == '\n'));
 
-    int prevStyle = editor()->SendScintilla(QsciScintilla::SCI_GETSTYLEAT, i - 1);
-    int currStyle = editor()->SendScintilla(QsciScintilla::SCI_GETSTYLEAT, i);
+    if (offset > 0) prevStyle = styles[offset - 1];
+    int currStyle = styles[offset];
 
     bool currStyleIsOtherText = (currStyle == OtherText);
     if (currStyleIsOtherText) {
@@ -312,18 +325,37 @@ int ScadLexer2::getStyleAt(int pos)
   return sstyle;
 }
 
-void ScadLexer2::highlighting(int start, const std::string& input, lexertl::smatch results)
+int ScadLexer2::lineFromPosition(int pos)
 {
-  std::string token = results.str();
+  return editor()->SendScintilla(QsciScintilla::SCI_LINEFROMPOSITION, pos);
+}
+
+// Line states of lines never lexed are 0, so states are kept plus one
+int ScadLexer2::getLineState(int line)
+{
+  return static_cast<int>(editor()->SendScintilla(QsciScintilla::SCI_GETLINESTATE, line)) - 1;
+}
+
+void ScadLexer2::setLineState(int line, int state)
+{
+  editor()->SendScintilla(QsciScintilla::SCI_SETLINESTATE, line, state + 1);
+}
+
+void ScadLexer2::highlighting(int start, const std::string& input, const lexertl::smatch& results)
+{
+  const auto offset = std::distance(input.begin(), results.first);
+  const auto length = std::distance(results.first, results.second);
   int style = results.id;
 
 #if DEBUG_LEXERTL
+  std::string token = results.str();
   QString glyphs = QString::fromStdString(token);
   std::cout << "highlighting ( " << style << " ):" << token << " [ " << token.length() << " bytes, " << glyphs.length() << " glyphs ]" << std::endl;
 #endif
 
-  startStyling(start + std::distance(input.begin(), results.first));
-  setStyling(token.length(), style);
+  startStyling(start + offset);
+  setStyling(length, style);
+  std::fill(styles.begin() + offset, styles.begin() + offset + length, static_cast<char>(style));
 }
 
 QColor ScadLexer2::defaultColor(int style) const
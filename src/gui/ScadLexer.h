@@ -3,6 +3,7 @@
 #include <QObject>
 #include <Qsci/qsciglobal.h>
 #include <string>
+#include <vector>
 
 #define ENABLE_LEXERTL  1
 
@@ -49,8 +50,12 @@ private:
 class LexInterface
 {
 public:
-  virtual void highlighting(int start, const std::string& input, lexertl::smatch results) = 0;
+  virtual void highlighting(int start, const std::string& input, const lexertl::smatch& results) = 0;
   virtual int getStyleAt(int position) = 0;
+  virtual int lineFromPosition(int position) = 0;
+  // The lexer state at the end of line kept from the last pass, -1 if unknown
+  virtual int getLineState(int line) = 0;
+  virtual void setLineState(int line, int state) = 0;
 };
 
 class Lex
@@ -113,11 +118,14 @@ public:
   void styleText(int start, int end) override;
   void autoScroll(int error_pos);
   int getStyleAt(int pos) override;
-  void fold(int start, int end);
+  int lineFromPosition(int pos) override;
+  int getLineState(int line) override;
+  void setLineState(int line, int state) override;
+  void fold(int start, const std::string& input);
 
   QColor defaultColor(int style) const override;
 
-  void highlighting(int start, const std::string& input, lexertl::smatch results) override;
+  void highlighting(int start, const std::string& input, const lexertl::smatch& results) override;
   QString description(int style) const override;
   QStringList autoCompletionWordSeparators() const override;
 
@@ -128,6 +136,8 @@ public:
     my_lexer->finalize_rules();
   }
 
+private:
+  std::vector<char> styles; // Of the text being styled, for folding
 };
 
 #endif // if ENABLE_LEXERTL
@@ -160,6 +160,8 @@ public:
   static SettingsEntryBool showWarningsIn3dView;
   static SettingsEntryBool mouseCentricZoom;
   static SettingsEntryBool mouseSwapButtons;
+  static SettingsEntryBool adaptiveResolution;
+  static SettingsEntryBool hideEdgesWhileMoving;
   static SettingsEntryInt indentationWidth;
   static SettingsEntryInt tabWidth;
   static SettingsEntryEnum lineWrap;
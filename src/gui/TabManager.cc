@@ -17,6 +17,7 @@
 #include "ScintillaEditor.h"
 #include "Preferences.h"
 #include "MainWindow.h"
+#include "CacheOwners.h"
 
 TabManager::TabManager(MainWindow *o, const QString& filename)
 {
@@ -111,6 +112,7 @@ void TabManager::closeTabRequested(int x)
   tabWidget->removeTab(x);
   tabWidget->fireTabCountChanged();
 
+  CacheOwners::instance()->remove(temp->cacheOwner);
   delete temp->parameterWidget;
   delete temp;
 }
@@ -165,8 +167,10 @@ void TabManager::createTab(const QString& filename)
   assert(par != nullptr);
 
   editor = new ScintillaEditor(tabWidget);
+  editor->cacheOwner = CacheOwners::instance()->add();
   par->activeEditor = editor;
   editor->parameterWidget = new ParameterWidget(par->parameterDock);
+  connect(editor->parameterWidget, SIGNAL(parametersChanged()), par, SLOT(clearPrefetchedFrames()));
   connect(editor->parameterWidget, SIGNAL(parametersChanged()), par, SLOT(actionRenderPreview()));
   par->parameterDock->setWidget(editor->parameterWidget);
 
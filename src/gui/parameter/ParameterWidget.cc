@@ -34,13 +34,34 @@
 #include "ParameterCheckBox.h"
 #include "ParameterText.h"
 #include "ParameterVector.h"
+#include "SourceFile.h"
+#include "Expression.h"
 
+#include <sstream>
 #include <boost/filesystem.hpp>
 
 #include <QInputDialog>
 #include <QMessageBox>
 #include <utility>
 
+namespace {
+
+// The assignments and annotations the parameters are made from
+std::string parameterSignature(const SourceFile *sourceFile)
+{
+  std::ostringstream stream;
+  for (const auto& assignment : sourceFile->scope.assignments) {
+    if (!assignment->annotation("Parameter")) continue;
+    stream << assignment->getName() << '=' << *assignment->getExpr() << '\n';
+    for (const char *name : {"Parameter", "Description", "Group"}) {
+      if (const auto annotation = assignment->annotation(name)) stream << name << ':' << *annotation->getExpr() << '\n';
+    }
+  }
+  return stream.str();
+}
+
+} // namespace
+
 ParameterWidget::ParameterWidget(QWidget *parent) : QWidget(parent)
 {
   setupUi(this);
@@ -118,6 +139,12 @@ void ParameterWidget::setParameters(const SourceFile *sourceFile, const std::str
     return;
   }
   this->source = source;
+  // Edits outside the parameters keep the widgets and the values being edited
+  auto signature = parameterSignature(sourceFile);
+  if (signature == this->signature) {
+    return;
+  }
+  this->signature = std::move(signature);
 
   this->parameters = ParameterObjects::fromSourceFile(sourceFile);
   rebuildWidgets();
@@ -40,6 +40,7 @@ class ParameterWidget : public QWidget, public Ui::ParameterWidget
 private:
   ParameterSets sets;
   std::string source;
+  std::string signature; // Of the parameters of source
   ParameterObjects parameters;
   std::map<ParameterObject *, std::vector<ParameterVirtualWidget *>> widgets;
 
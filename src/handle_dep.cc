@@ -19,7 +19,12 @@ const char *make_command = nullptr;
 void handle_dep(const std::string& filename)
 {
   fs::path filepath(filename);
-  std::string dep = boost::regex_replace(filepath.generic_string(), boost::regex("\\ "), "\\\\ ");
+  // Spaces are escaped for make
+  std::string dep;
+  for (const char c : filepath.generic_string()) {
+    if (c == ' ') dep += '\\';
+    dep += c;
+  }
   if (dependencies.find(dep) != dependencies.end()) {
     return; // included and used files are very likely to be added many times by the parser
   }
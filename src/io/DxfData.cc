@@ -33,17 +33,22 @@
 #include "printutils.h"
 #include "calc.h"
 
+#include <charconv>
 #include <fstream>
 #include <cassert>
+#include <mutex>
+#include <set>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
 #include <algorithm>
 #include <sstream>
-#include <map>
 
 #include "Value.h"
+#include "Cache.h"
+#include "ImportCache.h"
 #include "boost-utils.h"
 #include "Polygon2d.h"
 #include "printutils.h"
@@ -66,6 +71,68 @@ namespace fs = boost::filesystem;
 
  */
 
+namespace {
+
+// Reads the rest of the stream at once, for tokenizing without copying lines
+std::string read_file(std::ifstream& stream)
+{
+  std::string text;
+  stream.seekg(0, std::ios::end);
+  const auto size = stream.tellg();
+  stream.seekg(0, std::ios::beg);
+  if (size > 0) {
+    text.resize(static_cast<size_t>(size));
+    stream.read(&text[0], size);
+    text.resize(stream.gcount());
+  }
+  return text;
+}
+
+// Returns the next line of text, without surrounding white space
+std::string_view next_line(std::string_view text, size_t& pos)
+{
+  size_t end = text.find('\n', pos);
+  if (end == std::string_view::npos) end = text.size();
+  auto line = text.substr(pos, end - pos);
+  pos = end + 1;
+  const auto begin = line.find_first_not_of(" \t\r\f\v");
+  if (begin == std::string_view::npos) return {};
+  return line.substr(begin, line.find_last_not_of(" \t\r\f\v") - begin + 1);
+}
+
+template <typename T>
+bool parse_number(std::string_view token, T& value)
+{
+  if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  constexpr bool use_from_chars = true;
+#else
+  constexpr bool use_from_chars = std::is_integral_v<T>;
+#endif
+  if constexpr (use_from_chars) {
+    auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+    return result.ec == std::errc() && result.ptr == token.data() + token.size();
+  } else {
+    try {
+      value = boost::lexical_cast<T>(token.data(), token.size());
+      return true;
+    } catch (const boost::bad_lexical_cast&) {
+      return false;
+    }
+  }
+}
+
+// Throws like boost::lexical_cast, so bad values are reported as before
+template <typename T>
+T to_number(std::string_view token)
+{
+  T value;
+  if (!parse_number(token, value)) throw boost::bad_lexical_cast();
+  return value;
+}
+
+} // namespace
+
 struct Line {
   int idx[2]; // indices into DxfData::points
   bool disabled{false};
@@ -133,40 +200,38 @@ DxfData::DxfData(double fn, double fs, double fa,
   //
   // Parse DXF file. Will populate this->points, this->dims, lines and blockdata
   //
-  while (!stream.eof()) {
-    std::string id_str, data;
-    std::getline(stream, id_str);
-    boost::trim(id_str);
-    std::getline(stream, data);
-    boost::trim(data);
+  const std::string text = read_file(stream);
+  size_t pos = 0;
+  std::string data;
+  while (pos < text.size()) {
+    const auto id_str = next_line(text, pos);
+    data.assign(next_line(text, pos));
 
     int id;
-    try {
-      id = boost::lexical_cast<int>(id_str);
-    } catch (const boost::bad_lexical_cast& blc) {
-      if (!stream.eof()) {
-        LOG(message_group::Warning, "Illegal ID '%1$s' in `%2$s'", id_str, filename);
+    if (!parse_number(id_str, id)) {
+      if (pos < text.size()) {
+        LOG(message_group::Warning, "Illegal ID '%1$s' in `%2$s'", std::string(id_str), filename);
       }
       break;
     }
     try {
       if (id >= 10 && id <= 16) {
         if (in_blocks_section) {
-          coords[id - 10][0] = boost::lexical_cast<double>(data);
+          coords[id - 10][0] = to_number<double>(data);
         } else if (id == 11 || id == 12 || id == 16) {
-          coords[id - 10][0] = boost::lexical_cast<double>(data) * scale;
+          coords[id - 10][0] = to_number<double>(data) * scale;
         } else {
-          coords[id - 10][0] = (boost::lexical_cast<double>(data) - xorigin) * scale;
+          coords[id - 10][0] = (to_number<double>(data) - xorigin) * scale;
         }
       }
 
       if (id >= 20 && id <= 26) {
         if (in_blocks_section) {
-          coords[id - 20][1] = boost::lexical_cast<double>(data);
+          coords[id - 20][1] = to_number<double>(data);
         } else if (id == 21 || id == 22 || id == 26) {
-          coords[id - 20][1] = boost::lexical_cast<double>(data) * scale;
+          coords[id - 20][1] = to_number<double>(data) * scale;
         } else {
-          coords[id - 20][1] = (boost::lexical_cast<double>(data) - yorigin) * scale;
+          coords[id - 20][1] = (to_number<double>(data) - yorigin) * scale;
         }
       }
 
@@ -324,49 +389,49 @@ DxfData::DxfData(double fn, double fs, double fa,
       case 10: [[fallthrough]];
       case 11:
         if (in_blocks_section) {
-          xverts.push_back((boost::lexical_cast<double>(data)));
+          xverts.push_back((to_number<double>(data)));
         } else {
-          xverts.push_back((boost::lexical_cast<double>(data) - xorigin) * scale);
+          xverts.push_back((to_number<double>(data) - xorigin) * scale);
         }
         break;
       case 20: [[fallthrough]];
       case 21:
         if (in_blocks_section) {
-          yverts.push_back((boost::lexical_cast<double>(data)));
+          yverts.push_back((to_number<double>(data)));
         } else {
-          yverts.push_back((boost::lexical_cast<double>(data) - yorigin) * scale);
+          yverts.push_back((to_number<double>(data) - yorigin) * scale);
         }
         break;
       case 40:
         // CIRCLE, ARC: radius
         // ELLIPSE: minor to major ratio
         // DIMENSION (radial, diameter): Leader length
-        radius = boost::lexical_cast<double>(data);
+        radius = to_number<double>(data);
         if (!in_blocks_section) radius *= scale;
         break;
       case 41:
         // ELLIPSE: start_angle
         // INSERT: X scale
-        ellipse_start_angle = boost::lexical_cast<double>(data);
+        ellipse_start_angle = to_number<double>(data);
         break;
       case 50:
         // ARC: start_angle
         // INSERT: rot angle
         // DIMENSION: linear and rotated: angle
-        arc_start_angle = boost::lexical_cast<double>(data);
+        arc_start_angle = to_number<double>(data);
         break;
       case 42:
         // ELLIPSE: stop_angle
         // INSERT: Y scale
-        ellipse_stop_angle = boost::lexical_cast<double>(data);
+        ellipse_stop_angle = to_number<double>(data);
         break;
       case 51: // ARC
-        arc_stop_angle = boost::lexical_cast<double>(data);
+        arc_stop_angle = to_number<double>(data);
         break;
       case 70:
         // LWPOLYLINE: polyline flag
         // DIMENSION: dimension type
-        dimtype = boost::lexical_cast<int>(data);
+        dimtype = to_number<int>(data);
         break;
       }
     } catch (boost::bad_lexical_cast& blc) {
@@ -388,113 +453,80 @@ DxfData::DxfData(double fn, double fs, double fa,
 
   // Extract paths from parsed data
 
-  using LineMap = std::map<int, int>;
-  LineMap enabled_lines;
-  for (size_t i = 0; i < lines.size(); ++i) {
-    enabled_lines[i] = i;
-  }
-
-  // extract all open paths
-  while (enabled_lines.size() > 0) {
-    int current_line, current_point;
-
-    for (const auto& l : enabled_lines) {
-      int idx = l.second;
-      for (int j = 0; j < 2; ++j) {
-        auto lv = grid.data(this->points[lines[idx].idx[j]][0], this->points[lines[idx].idx[j]][1]);
-        for (int k : lv) {
-          if (k < 0 || static_cast<unsigned int>(k) >= lines.size()) {
-            LOG(message_group::Warning,
-                "Bad DXF line index in %1$s.", QuotedString(boostfs_uncomplete(filename, fs::current_path()).generic_string()));
-            continue;
-          }
-          if (k == idx || lines[k].disabled) continue;
-          goto next_open_path_j;
-        }
-        current_line = idx;
-        current_point = j;
-        goto create_open_path;
-next_open_path_j:;
-      }
+  auto bad_index = [&](int k) {
+    if (k >= 0 && static_cast<size_t>(k) < lines.size()) return false;
+    LOG(message_group::Warning,
+        "Bad DXF line index in %1$s.", QuotedString(boostfs_uncomplete(filename, fs::current_path()).generic_string()));
+    return true;
+  };
+  // An end of an open path, which no other enabled line touches
+  auto is_open_end = [&](int idx, int j) {
+    const auto& point = this->points[lines[idx].idx[j]];
+    for (int k : grid.data(point[0], point[1])) {
+      if (bad_index(k)) continue;
+      if (k != idx && !lines[k].disabled) return false;
     }
-
-    break;
-
-create_open_path:
-    this->paths.emplace_back();
-    Path *this_path = &this->paths.back();
-
-    this_path->indices.push_back(lines[current_line].idx[current_point]);
+    return true;
+  };
+  // Follows the enabled lines from the given end of a line, disabling them
+  auto follow_path = [&](Path& path, int current_line, int current_point) {
+    path.indices.push_back(lines[current_line].idx[current_point]);
     while (true) {
-      this_path->indices.push_back(lines[current_line].idx[!current_point]);
+      path.indices.push_back(lines[current_line].idx[!current_point]);
       const auto& ref_point = this->points[lines[current_line].idx[!current_point]];
       lines[current_line].disabled = true;
-      enabled_lines.erase(current_line);
-      auto lv = grid.data(ref_point[0], ref_point[1]);
-      for (int k : lv) {
-        if (k < 0 || static_cast<unsigned int>(k) >= lines.size()) {
-          LOG(message_group::Warning,
-              "Bad DXF line index in %1$s.", QuotedString(boostfs_uncomplete(filename, fs::current_path()).generic_string()));
-          continue;
-        }
+      bool found = false;
+      for (int k : grid.data(ref_point[0], ref_point[1])) {
+        if (bad_index(k)) continue;
         if (lines[k].disabled) continue;
         auto idk0 = lines[k].idx[0]; // make it easier to read and debug
         auto idk1 = lines[k].idx[1];
         if (grid.eq(ref_point[0], ref_point[1], this->points[idk0][0], this->points[idk0][1])) {
           current_line = k;
           current_point = 0;
-          goto found_next_line_in_open_path;
+          found = true;
+          break;
         }
         if (grid.eq(ref_point[0], ref_point[1], this->points[idk1][0], this->points[idk1][1])) {
           current_line = k;
           current_point = 1;
-          goto found_next_line_in_open_path;
+          found = true;
+          break;
         }
       }
-      break;
-found_next_line_in_open_path:;
+      if (!found) break;
+    }
+  };
+
+  // extract all open paths, starting from the lowest line with an open end.
+  // Lines only get disabled, so an open end stays open and the candidates
+  // only need to be updated around the lines of each extracted path.
+  std::set<int> open_lines;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (is_open_end(i, 0) || is_open_end(i, 1)) open_lines.insert(i);
+  }
+  while (!open_lines.empty()) {
+    const int current_line = *open_lines.begin();
+    this->paths.emplace_back();
+    auto& this_path = this->paths.back();
+    follow_path(this_path, current_line, is_open_end(current_line, 0) ? 0 : 1);
+    for (const int index : this_path.indices) {
+      const auto& point = this->points[index];
+      for (int k : grid.data(point[0], point[1])) {
+        if (k < 0 || static_cast<size_t>(k) >= lines.size()) continue;
+        if (lines[k].disabled) open_lines.erase(k);
+        else if (is_open_end(k, 0) || is_open_end(k, 1)) open_lines.insert(k);
+      }
     }
   }
 
   // extract all closed paths
-  while (enabled_lines.size() > 0) {
-    int current_line = enabled_lines.begin()->second;
-    int current_point = 0;
-
+  for (size_t current_line = 0; current_line < lines.size(); ++current_line) {
+    if (lines[current_line].disabled) continue;
     this->paths.emplace_back();
     auto& this_path = this->paths.back();
     this_path.is_closed = true;
-
-    this_path.indices.push_back(lines[current_line].idx[current_point]);
-    while (true) {
-      this_path.indices.push_back(lines[current_line].idx[!current_point]);
-      const auto& ref_point = this->points[lines[current_line].idx[!current_point]];
-      lines[current_line].disabled = true;
-      enabled_lines.erase(current_line);
-      auto lv = grid.data(ref_point[0], ref_point[1]);
-      for (int k : lv) {
-        if (k < 0 || static_cast<unsigned int>(k) >= lines.size()) {
-          LOG(message_group::Warning,
-              "Bad DXF line index in %1$s.", QuotedString(boostfs_uncomplete(filename, fs::current_path()).generic_string()));
-          continue;
-        }
-        if (lines[k].disabled) continue;
-        auto idk0 = lines[k].idx[0]; // make it easier to read and debug
-        auto idk1 = lines[k].idx[1];
-        if (grid.eq(ref_point[0], ref_point[1], this->points[idk0][0], this->points[idk0][1])) {
-          current_line = k;
-          current_point = 0;
-          goto found_next_line_in_closed_path;
-        }
-        if (grid.eq(ref_point[0], ref_point[1], this->points[idk1][0], this->points[idk1][1])) {
-          current_line = k;
-          current_point = 1;
-          goto found_next_line_in_closed_path;
-        }
-      }
-      break;
-found_next_line_in_closed_path:;
-    }
+    follow_path(this_path, current_line, 0);
   }
 
   fixup_path_direction();
@@ -511,6 +543,51 @@ found_next_line_in_closed_path:;
 #endif
 }
 
+namespace {
+
+struct DxfCacheEntry {
+  std::shared_ptr<const DxfData> data;
+  DxfCacheEntry(std::shared_ptr<const DxfData> data) : data(std::move(data)) {}
+};
+
+Cache<std::string, DxfCacheEntry> dxf_data_cache(64ul * 1024ul * 1024ul);
+std::mutex dxf_data_cache_mutex;
+
+size_t memsize(const DxfData& dxf)
+{
+  size_t size = sizeof(dxf) + dxf.points.size() * sizeof(Vector2d) + dxf.dims.size() * sizeof(DxfData::Dim);
+  for (const auto& path : dxf.paths) size += sizeof(path) + path.indices.size() * sizeof(int);
+  return size;
+}
+
+} // namespace
+
+std::shared_ptr<const DxfData> DxfData::load(double fn, double fs, double fa,
+                                             const std::string& filename, const std::string& layername,
+                                             double xorigin, double yorigin, double scale)
+{
+  std::ostringstream parameters;
+  parameters.precision(17);
+  parameters << "dxf " << fn << " " << fs << " " << fa << " " << xorigin << " " << yorigin << " " << scale << " " << layername;
+  const std::string key = ImportCache::key(filename, parameters.str());
+  if (!key.empty()) {
+    std::lock_guard<std::mutex> lock(dxf_data_cache_mutex);
+    if (const auto entry = dxf_data_cache[key]) return entry->data;
+  }
+  auto dxf = std::make_shared<const DxfData>(fn, fs, fa, filename, layername, xorigin, yorigin, scale);
+  if (!key.empty()) {
+    std::lock_guard<std::mutex> lock(dxf_data_cache_mutex);
+    dxf_data_cache.insert(key, new DxfCacheEntry(dxf), key.size() + memsize(*dxf));
+  }
+  return dxf;
+}
+
+void DxfData::clearCache()
+{
+  std::lock_guard<std::mutex> lock(dxf_data_cache_mutex);
+  dxf_data_cache.clear();
+}
+
 /*!
    Ensures that all paths have the same vertex ordering.
    FIXME: CW or CCW?
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include <vector>
 #include "linalg.h"
 
@@ -38,6 +40,15 @@ public:
           const std::string& filename, const std::string& layername = "",
           double xorigin = 0.0, double yorigin = 0.0, double scale = 1.0);
 
+  /*!
+     Like the constructor, but the data of unchanged files is shared by all
+     uses with the same arguments, e.g. by import() and dxf_dim().
+   */
+  static std::shared_ptr<const DxfData> load(double fn, double fs, double fa,
+                                             const std::string& filename, const std::string& layername = "",
+                                             double xorigin = 0.0, double yorigin = 0.0, double scale = 1.0);
+  static void clearCache();
+
   int addPoint(double x, double y);
 
   void fixup_path_direction();
@@ -0,0 +1,478 @@
+#include "GeometryFile.h"
+#include "export.h"
+#include "import.h"
+#include "printutils.h"
+#include "Geometry.h"
+#include "IndexedMesh.h"
+#include "PolySet.h"
+#include "Polygon2d.h"
+#ifdef ENABLE_CGAL
+#include "CGAL_Nef_polyhedron.h"
+#include "CGALHybridPolyhedron.h"
+#include "cgalutils.h"
+#include <CGAL/IO/Nef_polyhedron_iostream_3.h>
+#endif
+#ifdef ENABLE_MANIFOLD
+#include "ManifoldGeometry.h"
+#include "manifoldutils.h"
+#include "manifold.h"
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <streambuf>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace GeometryFile {
+
+const char *extension = ".geom";
+
+}
+
+namespace {
+
+const char entry_magic[8] = {'O', 'S', 'C', 'G', 'E', 'O', 'M', '\0'};
+// Version 2 stores meshes indexed
+const uint32_t entry_format_version = 2;
+
+enum class EntryType : uint8_t {
+  POLYSET = 1,
+  POLYGON2D = 2,
+  NEF = 3,
+  MANIFOLD = 4,
+  LIST = 5,
+};
+
+// All platforms we build for are little endian, as is the format
+template <typename T>
+void write_value(std::ostream& out, const T& value)
+{
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+void write_array(std::ostream& out, const std::vector<T>& values)
+{
+  out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+/*!
+   Reads values out of the mapped data, with bounds checks but no alignment
+   requirements.
+ */
+class Reader
+{
+public:
+  Reader(const char *data, size_t size) : pos(data), end(data + size) {}
+
+  template <typename T>
+  bool read(T& value) {
+    if (size_t(end - pos) < sizeof(T)) return false;
+    std::memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+  }
+
+  template <typename T>
+  bool read(std::vector<T>& values, uint64_t count) {
+    if (count > size_t(end - pos) / sizeof(T)) return false;
+    values.resize(count);
+    std::memcpy(values.data(), pos, count * sizeof(T));
+    pos += count * sizeof(T);
+    return true;
+  }
+
+  const char *pos;
+  const char *end;
+};
+
+// Wraps the remaining data for the stream reader of Nef polyhedra
+class MemoryBuffer : public std::streambuf
+{
+public:
+  MemoryBuffer(const char *begin, const char *end) {
+    auto *p = const_cast<char *>(begin);
+    setg(p, p, const_cast<char *>(end));
+  }
+  [[nodiscard]] const char *position() const { return gptr(); }
+};
+
+/*!
+   A mesh is its welded vertices, then the faces as indices each terminated
+   by -1, like IndexedMesh. The manifold flag is 2 if unknown; the bounding
+   box is for tools listing files without reading them.
+ */
+struct MeshHeader {
+  int8_t convex;
+  int8_t manifold;
+  uint64_t numvertices;
+  uint64_t numindices;
+  double bbox[6];
+};
+
+void write_mesh(std::ostream& out, boost::tribool convex, int8_t manifold,
+                const std::vector<double>& coordinates, const std::vector<int32_t>& indices)
+{
+  BoundingBox bbox;
+  for (size_t i = 0; i + 2 < coordinates.size(); i += 3) {
+    bbox.extend(Vector3d(coordinates[i], coordinates[i + 1], coordinates[i + 2]));
+  }
+  MeshHeader header{static_cast<int8_t>(boost::indeterminate(convex) ? 2 : (convex ? 1 : 0)), manifold,
+                    coordinates.size() / 3, indices.size(), {0, 0, 0, 0, 0, 0}};
+  if (!bbox.isEmpty()) {
+    for (int i = 0; i < 3; ++i) {
+      header.bbox[i] = bbox.min()[i];
+      header.bbox[i + 3] = bbox.max()[i];
+    }
+  }
+  write_value(out, header.convex);
+  write_value(out, header.manifold);
+  write_value(out, header.numvertices);
+  write_value(out, header.numindices);
+  write_value(out, header.bbox);
+  write_array(out, coordinates);
+  write_array(out, indices);
+}
+
+void write_polyset(std::ostream& out, const PolySet& ps)
+{
+  const auto mesh = ps.getIndexedMesh();
+  const auto vertices = mesh->vertices.toVector();
+  std::vector<double> coordinates;
+  coordinates.reserve(vertices.size() * 3);
+  for (const auto& v : vertices) coordinates.insert(coordinates.end(), {v[0], v[1], v[2]});
+  const std::vector<int32_t> indices(mesh->indices.begin(), mesh->indices.end());
+  write_mesh(out, ps.convexValue(), ps.isManifold() ? 1 : 0, coordinates, indices);
+}
+
+bool read_mesh(Reader& in, MeshHeader& header, std::vector<double>& coordinates, std::vector<int32_t>& indices)
+{
+  if (!in.read(header.convex) || !in.read(header.manifold) || !in.read(header.numvertices) ||
+      !in.read(header.numindices) || !in.read(header.bbox)) return false;
+  if (header.numvertices > uint64_t(in.end - in.pos) / (3 * sizeof(double))) return false;
+  if (!in.read(coordinates, header.numvertices * 3) || !in.read(indices, header.numindices)) return false;
+  for (const auto i : indices) {
+    if (i < -1 || i >= int64_t(header.numvertices)) return false;
+  }
+  return indices.empty() || indices.back() == -1;
+}
+
+std::unique_ptr<PolySet> read_polyset(Reader& in)
+{
+  MeshHeader header;
+  std::vector<double> coordinates;
+  std::vector<int32_t> indices;
+  if (!read_mesh(in, header, coordinates, indices)) return nullptr;
+  auto ps = std::make_unique<PolySet>(3, header.convex == 2 ? boost::tribool(boost::indeterminate) : boost::tribool(header.convex == 1));
+  ps->reserve(std::count(indices.begin(), indices.end(), -1));
+  Polygon poly;
+  for (const auto i : indices) {
+    if (i == -1) {
+      ps->append_poly(std::move(poly));
+      poly = Polygon();
+    } else {
+      poly.emplace_back(coordinates[3 * i], coordinates[3 * i + 1], coordinates[3 * i + 2]);
+    }
+  }
+  if (header.manifold != 2) ps->setManifold(header.manifold == 1);
+  return ps;
+}
+
+#ifdef ENABLE_MANIFOLD
+void write_manifold(std::ostream& out, const ManifoldGeometry& mani)
+{
+  const manifold::Mesh mesh = mani.getManifold().GetMesh();
+  std::vector<double> coordinates;
+  coordinates.reserve(mesh.vertPos.size() * 3);
+  for (const auto& v : mesh.vertPos) coordinates.insert(coordinates.end(), {v.x, v.y, v.z});
+  std::vector<int32_t> indices;
+  indices.reserve(mesh.triVerts.size() * 4);
+  for (const auto& t : mesh.triVerts) indices.insert(indices.end(), {t[0], t[1], t[2], -1});
+  write_mesh(out, boost::indeterminate, 1, coordinates, indices);
+}
+
+/*!
+   Builds the Manifold straight from the stored triangles. Falls back to the
+   repairing conversion if Manifold rejects them.
+ */
+std::unique_ptr<Geometry> read_manifold(Reader& in)
+{
+  const auto begin = in.pos;
+  MeshHeader header;
+  std::vector<double> coordinates;
+  std::vector<int32_t> indices;
+  if (!read_mesh(in, header, coordinates, indices)) return nullptr;
+  manifold::Mesh mesh;
+  mesh.vertPos.reserve(header.numvertices);
+  for (size_t i = 0; i < coordinates.size(); i += 3) {
+    mesh.vertPos.emplace_back((float) coordinates[i], (float) coordinates[i + 1], (float) coordinates[i + 2]);
+  }
+  mesh.triVerts.reserve(indices.size() / 4);
+  for (size_t i = 0; i + 3 < indices.size(); i += 4) {
+    if (indices[i + 3] != -1) return nullptr;
+    mesh.triVerts.emplace_back(indices[i], indices[i + 1], indices[i + 2]);
+  }
+  auto mani = make_shared<manifold::Manifold>(std::move(mesh));
+  if (mani->Status() == manifold::Manifold::Error::NoError) return std::make_unique<ManifoldGeometry>(mani);
+  Reader again(begin, in.end - begin);
+  const auto ps = read_polyset(again);
+  if (!ps) return nullptr;
+  const auto repaired = ManifoldUtils::createMutableManifoldFromPolySet(*ps);
+  return repaired ? std::unique_ptr<Geometry>(repaired->copy()) : nullptr;
+}
+#endif
+
+/*!
+   Serializes the supported geometry types. Anything else (e.g. 2D PolySets)
+   is not written, leaving success() false.
+ */
+class EntryWriter : public GeometryVisitor
+{
+public:
+  EntryWriter(std::ostream& out, bool lists = false) : out(out), lists(lists) {}
+
+  void visit(const GeometryList& list) override {
+    if (!lists) return;
+    writeHeader(EntryType::LIST, list);
+    write_value<uint64_t>(out, list.getChildren().size());
+    for (const auto& item : list.getChildren()) {
+      EntryWriter writer(out);
+      if (!item.second) return;
+      item.second->accept(writer);
+      if (!writer.success()) return;
+    }
+    ok = true;
+  }
+
+  void visit(const PolySet& ps) override {
+    if (ps.getDimension() != 3) return;
+    writeHeader(EntryType::POLYSET, ps);
+    write_polyset(out, ps);
+    ok = true;
+  }
+
+  void visit(const Polygon2d& poly) override {
+    writeHeader(EntryType::POLYGON2D, poly);
+    write_value<uint8_t>(out, poly.isSanitized());
+    write_value<uint64_t>(out, poly.outlines().size());
+    for (const auto& outline : poly.outlines()) {
+      write_value<uint8_t>(out, outline.positive);
+      write_value<uint64_t>(out, outline.vertices.size());
+      for (const auto& v : outline.vertices) {
+        write_value(out, v[0]);
+        write_value(out, v[1]);
+      }
+    }
+    ok = true;
+  }
+
+#ifdef ENABLE_CGAL
+  void visit(const CGAL_Nef_polyhedron& N) override {
+    writeHeader(EntryType::NEF, N);
+    write_value<uint8_t>(out, N.p3 ? 1 : 0);
+    if (N.p3) out << const_cast<CGAL_Nef_polyhedron3&>(*N.p3);
+    ok = bool(out);
+  }
+
+  void visit(const CGALHybridPolyhedron& hybrid) override {
+    // Store as Nef polyhedron to retain exact coordinates
+    auto N = CGALUtils::createNefPolyhedronFromHybrid(hybrid);
+    N->setConvexity(hybrid.getConvexity());
+    visit(*N);
+  }
+#endif
+
+#ifdef ENABLE_MANIFOLD
+  void visit(const ManifoldGeometry& mani) override {
+    writeHeader(EntryType::MANIFOLD, mani);
+    write_manifold(out, mani);
+    ok = true;
+  }
+#endif
+
+  [[nodiscard]] bool success() const { return ok && bool(out); }
+
+private:
+  void writeHeader(EntryType type, const Geometry& geom) {
+    out.write(entry_magic, sizeof(entry_magic));
+    write_value(out, entry_format_version);
+    write_value(out, type);
+    write_value<int32_t>(out, geom.getConvexity());
+  }
+
+  std::ostream& out;
+  bool lists;
+  bool ok{false};
+};
+
+std::unique_ptr<Geometry> read_entry(Reader& in)
+{
+  char magic[sizeof(entry_magic)];
+  uint32_t version;
+  EntryType type;
+  int32_t convexity;
+  if (!in.read(magic) || std::memcmp(magic, entry_magic, sizeof(magic)) != 0) return nullptr;
+  if (!in.read(version) || version != entry_format_version) return nullptr;
+  if (!in.read(type) || !in.read(convexity)) return nullptr;
+
+  std::unique_ptr<Geometry> geom;
+  switch (type) {
+  case EntryType::POLYSET:
+    geom = read_polyset(in);
+    break;
+  case EntryType::POLYGON2D: {
+    uint8_t sanitized;
+    uint64_t numoutlines;
+    if (!in.read(sanitized) || !in.read(numoutlines)) return nullptr;
+    auto poly = std::make_unique<Polygon2d>();
+    for (uint64_t i = 0; i < numoutlines; ++i) {
+      Outline2d outline;
+      uint8_t positive;
+      uint64_t numvertices;
+      std::vector<double> coordinates;
+      if (!in.read(positive) || !in.read(numvertices)) return nullptr;
+      if (numvertices > uint64_t(in.end - in.pos) / (2 * sizeof(double))) return nullptr;
+      if (!in.read(coordinates, numvertices * 2)) return nullptr;
+      outline.positive = positive;
+      outline.vertices.reserve(numvertices);
+      for (size_t j = 0; j < coordinates.size(); j += 2) outline.vertices.emplace_back(coordinates[j], coordinates[j + 1]);
+      poly->addOutline(std::move(outline));
+    }
+    poly->setSanitized(sanitized);
+    geom = std::move(poly);
+    break;
+  }
+#ifdef ENABLE_CGAL
+  case EntryType::NEF: {
+    uint8_t hasp3;
+    if (!in.read(hasp3)) return nullptr;
+    if (!hasp3) {
+      geom = std::make_unique<CGAL_Nef_polyhedron>();
+      break;
+    }
+    try {
+      MemoryBuffer buffer(in.pos, in.end);
+      std::istream stream(&buffer);
+      auto nef = make_shared<CGAL_Nef_polyhedron3>();
+      stream >> *nef;
+      if (!stream) return nullptr;
+      in.pos = buffer.position();
+      geom = std::make_unique<CGAL_Nef_polyhedron>(nef);
+    } catch (const CGAL::Failure_exception& e) {
+      LOG(message_group::Warning, "Failed to read Nef polyhedron: %1$s", e.what());
+      return nullptr;
+    }
+    break;
+  }
+#endif
+  case EntryType::MANIFOLD:
+#ifdef ENABLE_MANIFOLD
+    geom = read_manifold(in);
+#else
+    // Same mesh layout, so builds without Manifold can still read it
+    geom = read_polyset(in);
+#endif
+    break;
+  case EntryType::LIST: {
+    uint64_t numchildren;
+    if (!in.read(numchildren)) return nullptr;
+    Geometry::Geometries children;
+    for (uint64_t i = 0; i < numchildren; ++i) {
+      auto child = read_entry(in);
+      if (!child) return nullptr;
+      children.emplace_back(nullptr, std::move(child));
+    }
+    geom = std::make_unique<GeometryList>(children);
+    break;
+  }
+  default:
+    // Unknown, or written by a build with different backends
+    return nullptr;
+  }
+  if (geom) geom->setConvexity(convexity);
+  return geom;
+}
+
+} // namespace
+
+namespace GeometryFile {
+
+bool write(std::ostream& out, const Geometry& geom, bool lists)
+{
+  EntryWriter writer(out, lists);
+  geom.accept(writer);
+  return writer.success();
+}
+
+std::unique_ptr<Geometry> read(const char *data, size_t size)
+{
+  Reader in(data, size);
+  return read_entry(in);
+}
+
+std::unique_ptr<Geometry> read(const std::string& data)
+{
+  return read(data.data(), data.size());
+}
+
+std::unique_ptr<Geometry> load(const std::string& filename)
+{
+  boost::interprocess::mapped_region region;
+  try {
+    boost::interprocess::file_mapping file(filename.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region(file, boost::interprocess::read_only).swap(region);
+  } catch (const boost::interprocess::interprocess_exception&) {
+    // Not mappable, e.g. empty
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in.good()) return nullptr;
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return read(data);
+  }
+  return read(static_cast<const char *>(region.get_address()), region.get_size());
+}
+
+} // namespace GeometryFile
+
+/*!
+   Saves the geometry in the native format, e.g. to import() precomputed
+   parts without evaluating or parsing them again.
+ */
+void export_geom(const shared_ptr<const Geometry>& geom, std::ostream& output)
+{
+  if (!GeometryFile::write(output, *geom, true)) {
+    LOG(message_group::Export_Error, "Export failed, unsupported geometry.");
+  }
+}
+
+/*!
+   Reads a file written by export_geom() or the disk cache. Lists of objects
+   are merged into one PolySet, as their parts have no nodes of their own.
+ */
+Geometry *import_geom(const std::string& filename, const Location& loc)
+{
+  auto geom = GeometryFile::load(filename);
+  if (!geom) {
+    LOG(message_group::Warning, "Can't read import file '%1$s', import() at line %2$d", filename, loc.firstLine());
+    return new PolySet(3);
+  }
+  const auto list = dynamic_cast<const GeometryList *>(geom.get());
+  if (!list) return geom.release();
+
+  auto merged = std::make_unique<PolySet>(3);
+  for (const auto& item : list->getChildren()) {
+#ifdef ENABLE_CGAL
+    const auto ps = CGALUtils::getGeometryAsPolySet(item.second);
+#else
+    const auto ps = dynamic_pointer_cast<const PolySet>(item.second);
+#endif
+    if (ps) merged->append(*ps);
+    else LOG(message_group::Warning, "Ignoring unsupported object in import file '%1$s', import() at line %2$d", filename, loc.firstLine());
+  }
+  return merged.release();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include "memory.h"
+
+class Geometry;
+
+/*!
+   OpenSCAD's native binary geometry format, used by the geometry disk cache
+   and by export and import of .geom files.
+
+   Meshes are stored indexed: the welded vertices as doubles, then the faces
+   as vertex indices, with a known manifold flag and the bounding box. Reading
+   copies those arrays out of the (memory mapped) file, without parsing or
+   welding vertices again. Nef polyhedra are stored in CGAL's exact format.
+ */
+namespace GeometryFile {
+
+// GeometryLists are only written when allowed, as their children lose their nodes when read back
+bool write(std::ostream& out, const Geometry& geom, bool lists = false);
+// Returns nullptr if the data is truncated, of another version, or of a backend this build lacks
+std::unique_ptr<Geometry> read(const char *data, size_t size);
+std::unique_ptr<Geometry> read(const std::string& data);
+// Maps the file into memory, if possible, and reads it
+std::unique_ptr<Geometry> load(const std::string& filename);
+
+extern const char *extension;
+
+} // namespace GeometryFile
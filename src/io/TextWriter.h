@@ -0,0 +1,59 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/*!
+   Collects text exports in a buffer, which is handed to the stream in large
+   blocks. Numbers are formatted like the default ostream formatting, i.e.
+   printf("%g"), independent of the locale.
+ */
+class TextWriter
+{
+public:
+  TextWriter(std::ostream& output) : output(output) { buffer.reserve(bufferSize + 512); }
+  ~TextWriter() { flush(); }
+  TextWriter(const TextWriter&) = delete;
+  TextWriter& operator=(const TextWriter&) = delete;
+
+  TextWriter& operator<<(std::string_view s) {
+    buffer.insert(buffer.end(), s.begin(), s.end());
+    if (buffer.size() >= bufferSize) flush();
+    return *this;
+  }
+  TextWriter& operator<<(const char *s) { return *this << std::string_view(s); }
+  TextWriter& operator<<(char c) { return *this << std::string_view(&c, 1); }
+  TextWriter& operator<<(double v) {
+    char text[32];
+    return *this << std::string_view(text, format(text, sizeof(text), v));
+  }
+  template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+  TextWriter& operator<<(T v) {
+    char text[24];
+    return *this << std::string_view(text, std::to_chars(text, text + sizeof(text), v).ptr - text);
+  }
+
+  void flush() {
+    output.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+
+  static size_t format(char *out, size_t size, double v) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    return std::to_chars(out, out + size, v, std::chars_format::general, 6).ptr - out;
+#else
+    return std::min<size_t>(snprintf(out, size, "%g", v), size - 1);
+#endif
+  }
+
+private:
+  static constexpr size_t bufferSize = 1 << 16;
+
+  std::ostream& output;
+  std::vector<char> buffer;
+};
@@ -79,18 +79,20 @@ Value builtin_dxf_dim(Arguments arguments, const Location& loc)
     LOG(message_group::Warning, loc, parameters.documentRoot(), "Can't open DXF file '%1$s'!", rawFilename);
     return Value::undefined.clone();
   }
+  parameters.session()->addExternalInput();
   std::string key = STR(filename, "|", layername, "|", name, "|", xorigin,
                         "|", yorigin, "|", scale, "|", lastwritetime,
                         "|", filesize);
   auto result = dxf_dim_cache.find(key);
   if (result != dxf_dim_cache.end()) return {result->second};
   handle_dep(filepath.string());
-  DxfData dxf(36, 0, 0, filename, layername, xorigin, yorigin, scale);
+  const auto dxf_data = DxfData::load(36, 0, 0, filename, layername, xorigin, yorigin, scale);
+  const DxfData& dxf = *dxf_data;
 
-  for (auto& dim : dxf.dims) {
+  for (const auto& dim : dxf.dims) {
     if (!name.empty() && dim.name != name) continue;
 
-    DxfData::Dim *d = &dim;
+    const DxfData::Dim *d = &dim;
     int type = d->type & 7;
 
     if (type == 0) {
@@ -176,6 +178,7 @@ Value builtin_dxf_cross(Arguments arguments, const Location& loc)
     return Value::undefined.clone();
   }
 
+  parameters.session()->addExternalInput();
   std::string key = STR(filename, "|", layername, "|", xorigin, "|", yorigin,
                         "|", scale, "|", lastwritetime,
                         "|", filesize);
@@ -190,7 +193,8 @@ Value builtin_dxf_cross(Arguments arguments, const Location& loc)
     return {std::move(ret)};
   }
   handle_dep(filepath.string());
-  DxfData dxf(36, 0, 0, filename, layername, xorigin, yorigin, scale);
+  const auto dxf_data = DxfData::load(36, 0, 0, filename, layername, xorigin, yorigin, scale);
+  const DxfData& dxf = *dxf_data;
 
   double coords[4][2];
 
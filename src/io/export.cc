@@ -27,9 +27,18 @@
 #include "export.h"
 #include "PolySet.h"
 #include "printutils.h"
+#include "TimingCounters.h"
+#ifdef ENABLE_MANIFOLD
+#include "ManifoldGeometry.h"
+#include "manifold.h"
+#endif
 #include "Geometry.h"
+#include "IndexedMesh.h"
+#include "parallel.h"
 
+#include <cstring>
 #include <fstream>
+#include <numeric>
 
 #ifdef _WIN32
 #include <io.h>
@@ -45,11 +54,41 @@ bool canPreview(const FileFormat format) {
           format == FileFormat::PARAM ||
           format == FileFormat::ECHO ||
           format == FileFormat::TERM ||
-          format == FileFormat::PNG);
+          isImage(format));
+}
+
+bool isImage(const FileFormat format) {
+  return format == FileFormat::PNG || format == FileFormat::RGBA;
 }
 
-void exportFile(const shared_ptr<const Geometry>& root_geom, std::ostream& output, const ExportInfo& exportInfo)
+#ifdef ENABLE_CGAL
+/*!
+   Decimates each object of geom on its own, so lists keep their objects.
+ */
+static shared_ptr<const Geometry> decimate(const shared_ptr<const Geometry>& geom, const DecimationOptions& options)
+{
+  if (const auto geomlist = dynamic_pointer_cast<const GeometryList>(geom)) {
+    Geometry::Geometries children;
+    for (const auto& item : geomlist->getChildren()) children.emplace_back(item.first, decimate(item.second, options));
+    return make_shared<GeometryList>(children);
+  }
+  if (geom->getDimension() != 3 || geom->isEmpty()) return geom;
+  const auto mesh = IndexedMesh::fromGeometry(geom);
+  auto ps = MeshDecimation::decimate(*mesh, options);
+  ps->setConvexity(geom->getConvexity());
+  LOG("Decimated mesh from %1$d to %2$d faces", mesh->numfaces, ps->numFacets());
+  return ps;
+}
+#endif
+
+void exportFile(const shared_ptr<const Geometry>& geom, std::ostream& output, const ExportInfo& exportInfo)
 {
+  auto root_geom = geom;
+#ifdef ENABLE_CGAL
+  if (exportInfo.decimation.enabled() && exportInfo.format != FileFormat::NEF3 && exportInfo.format != FileFormat::NEFDBG) {
+    root_geom = decimate(geom, exportInfo.decimation);
+  }
+#endif
   switch (exportInfo.format) {
   case FileFormat::ASCIISTL:
     export_stl(root_geom, output, false);
@@ -72,6 +111,12 @@ void exportFile(const shared_ptr<const Geometry>& root_geom, std::ostream& outpu
   case FileFormat::_3MF:
     export_3mf(root_geom, output);
     break;
+  case FileFormat::GLB:
+    export_glb(root_geom, output);
+    break;
+  case FileFormat::GEOM:
+    export_geom(root_geom, output);
+    break;
   case FileFormat::DXF:
     export_dxf(root_geom, output);
     break;
@@ -104,7 +149,7 @@ bool exportFileByNameStdout(const shared_ptr<const Geometry>& root_geom, const E
 bool exportFileByNameStream(const shared_ptr<const Geometry>& root_geom, const ExportInfo& exportInfo)
 {
   std::ios::openmode mode = std::ios::out | std::ios::trunc;
-  if (exportInfo.format == FileFormat::_3MF || exportInfo.format == FileFormat::STL || exportInfo.format == FileFormat::PDF) {
+  if (exportInfo.format == FileFormat::_3MF || exportInfo.format == FileFormat::GLB || exportInfo.format == FileFormat::GEOM || exportInfo.format == FileFormat::STL || exportInfo.format == FileFormat::PDF) {
     mode |= std::ios::binary;
   }
   std::ofstream fstream(exportInfo.name2open, mode);
@@ -133,6 +178,7 @@ bool exportFileByNameStream(const shared_ptr<const Geometry>& root_geom, const E
 
 bool exportFileByName(const shared_ptr<const Geometry>& root_geom, const ExportInfo& exportInfo)
 {
+  TimingCounters::Scope timer(TimingCounters::EXPORT);
   bool exportResult = false;
   if (exportInfo.useStdOut) {
     exportResult = exportFileByNameStdout(root_geom, exportInfo);
@@ -142,6 +188,26 @@ bool exportFileByName(const shared_ptr<const Geometry>& root_geom, const ExportI
   return exportResult;
 }
 
+/*!
+   The file only appears under its name once completely written, so nobody
+   sees a partial export while the caller goes on with its next job.
+ */
+std::future<bool> exportFileByNameInBackground(const shared_ptr<const Geometry>& root_geom, const ExportInfo& exportInfo)
+{
+  return std::async(std::launch::async, [root_geom, exportInfo]() {
+    ExportInfo partial = exportInfo;
+    partial.name2open = exportInfo.name2open + ".part";
+    boost::system::error_code ec;
+    if (exportFileByNameStream(root_geom, partial)) {
+      fs::rename(partial.name2open, exportInfo.name2open, ec);
+      if (!ec) return true;
+      LOG(message_group::Error, _("Can't rename \"%1$s\" to \"%2$s\""), partial.name2open, exportInfo.name2display);
+    }
+    fs::remove(partial.name2open, ec);
+    return false;
+  });
+}
+
 namespace Export {
 
 double normalize(double x) {
@@ -152,31 +218,82 @@ ExportMesh::Vertex vectorToVertex(const Vector3d& pt) {
   return {normalize(pt.x()), normalize(pt.y()), normalize(pt.z())};
 }
 
+namespace {
+
+// An integer of the same order as the (non-NaN) double, so vertices compare without floating point
+uint64_t orderedBits(double x) {
+  uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return (bits >> 63) ? ~bits : bits | (uint64_t(1) << 63);
+}
+
+} // namespace
+
 ExportMesh::ExportMesh(const PolySet& ps)
 {
-  std::map<Vertex, int> vertexMap;
-  std::vector<std::array<int, 3>> triangleIndices;
-
-  for (const auto& pts : ps.polygons) {
-    auto pos1 = vertexMap.emplace(std::make_pair(vectorToVertex(pts[0]), vertexMap.size()));
-    auto pos2 = vertexMap.emplace(std::make_pair(vectorToVertex(pts[1]), vertexMap.size()));
-    auto pos3 = vertexMap.emplace(std::make_pair(vectorToVertex(pts[2]), vertexMap.size()));
-    triangleIndices.push_back({pos1.first->second, pos2.first->second, pos3.first->second});
-  }
+  addTriangles(ps.getPolygons().size(), [&ps](size_t i) -> std::array<Vector3d, 3> {
+    const auto& pts = ps.getPolygons()[i];
+    return {pts[0], pts[1], pts[2]};
+  });
+}
+
+#ifdef ENABLE_MANIFOLD
+ExportMesh::ExportMesh(const ManifoldGeometry& mani)
+{
+  const manifold::Mesh mesh = mani.getManifold().GetMesh();
+  addTriangles(mesh.triVerts.size(), [&mesh](size_t i) -> std::array<Vector3d, 3> {
+    const auto& tv = mesh.triVerts[i];
+    std::array<Vector3d, 3> pts;
+    for (int j = 0; j < 3; ++j) {
+      const auto& v = mesh.vertPos[tv[j]];
+      pts[j] = {v.x, v.y, v.z};
+    }
+    return pts;
+  });
+}
+#endif
+
+/*!
+   Indexes the vertices in sorted order, and starts each triangle with its
+   smallest index, so the output only depends on the geometry.
+ */
+void ExportMesh::addTriangles(size_t count, const std::function<std::array<Vector3d, 3>(size_t)>& triangle)
+{
+  std::vector<size_t> indices(3 * count);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::vector<std::array<Vertex, 3>> points(count);
+  parallelizable_transform(indices.begin(), indices.begin() + count, points.begin(), [&triangle](size_t i) {
+    const auto pts = triangle(i);
+    return std::array<Vertex, 3>{vectorToVertex(pts[0]), vectorToVertex(pts[1]), vectorToVertex(pts[2])};
+  });
+  const auto corner = [&points](size_t i) -> const Vertex& { return points[i / 3][i % 3]; };
 
-  std::vector<size_t> indexTranslationMap(vertexMap.size());
-  vertices.reserve(vertexMap.size());
+  // Sorting the corners by the integer images of their coordinates gives the
+  // lexicographic order of the vertices, in which equal ones are adjacent
+  struct Corner {
+    std::array<uint64_t, 3> key;
+    size_t index;
+  };
+  std::vector<Corner> sorted(indices.size());
+  parallelizable_transform(indices.begin(), indices.end(), sorted.begin(), [&corner](size_t i) {
+    const auto& v = corner(i);
+    return Corner{{orderedBits(v[0]), orderedBits(v[1]), orderedBits(v[2])}, i};
+  });
+  parallelizable_sort(sorted.begin(), sorted.end(), [](const Corner& c1, const Corner& c2) {
+    return c1.key < c2.key;
+  });
 
-  size_t index = 0;
-  for (const auto& e : vertexMap) {
-    vertices.push_back(e.first);
-    indexTranslationMap[e.second] = index++;
+  std::vector<int> cornerVertex(sorted.size());
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    if (i == 0 || sorted[i].key != sorted[i - 1].key) vertices.push_back(corner(sorted[i].index));
+    cornerVertex[sorted[i].index] = vertices.size() - 1;
   }
 
-  for (const auto& i : triangleIndices) {
-    triangles.emplace_back(indexTranslationMap[i[0]], indexTranslationMap[i[1]], indexTranslationMap[i[2]]);
+  triangles.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    triangles.emplace_back(cornerVertex[3 * i], cornerVertex[3 * i + 1], cornerVertex[3 * i + 2]);
   }
-  std::sort(triangles.begin(), triangles.end(), [](const Triangle& t1, const Triangle& t2) -> bool {
+  parallelizable_sort(triangles.begin(), triangles.end(), [](const Triangle& t1, const Triangle& t2) -> bool {
       return t1.key < t2.key;
     });
 }
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <functional>
+#include <future>
 #include <array>
 
 #include <boost/range/algorithm.hpp>
@@ -10,8 +11,11 @@
 #include "Tree.h"
 #include "Camera.h"
 #include "memory.h"
+#include "MeshDecimation.h"
 
 class PolySet;
+class Polygon2d;
+class ManifoldGeometry;
 
 enum class FileFormat {
   ASCIISTL,
@@ -21,6 +25,8 @@ enum class FileFormat {
   WRL,
   AMF,
   _3MF,
+  GLB,
+  GEOM,
   DXF,
   SVG,
   NEFDBG,
@@ -30,6 +36,7 @@ enum class FileFormat {
   TERM,
   ECHO,
   PNG,
+  RGBA,
   PDF,
   PARAM
 };
@@ -91,15 +98,26 @@ struct ExportInfo {
   std::string sourceFileName;
   bool useStdOut;
   ExportPdfOptions *options=nullptr;
+  // Applied to the 3D meshes of formats other than NEF3 and NEFDBG
+  DecimationOptions decimation;
 };
 
 
 bool canPreview(const FileFormat format);
+// Formats drawn by the offscreen renderer
+bool isImage(const FileFormat format);
 bool exportFileByName(const shared_ptr<const class Geometry>& root_geom, const ExportInfo& exportInfo);
+// Writes the export on another thread, to a temporary file renamed once complete
+std::future<bool> exportFileByNameInBackground(const shared_ptr<const class Geometry>& root_geom, const ExportInfo& exportInfo);
+// Writes the export to a stream, e.g. into memory for an upload
+void exportFile(const shared_ptr<const class Geometry>& root_geom, std::ostream& output, const ExportInfo& exportInfo);
 
 void export_stl(const shared_ptr<const Geometry>& geom, std::ostream& output,
                 bool binary = true);
 void export_3mf(const shared_ptr<const Geometry>& geom, std::ostream& output);
+void export_glb(const shared_ptr<const Geometry>& geom, std::ostream& output);
+// The native format, see GeometryFile.h
+void export_geom(const shared_ptr<const Geometry>& geom, std::ostream& output);
 void export_obj(const shared_ptr<const Geometry>& geom, std::ostream& output);
 void export_off(const shared_ptr<const Geometry>& geom, std::ostream& output);
 void export_wrl(const shared_ptr<const Geometry>& geom, std::ostream& output);
@@ -109,21 +127,28 @@ void export_svg(const shared_ptr<const Geometry>& geom, std::ostream& output);
 void export_pdf(const shared_ptr<const Geometry>& geom, std::ostream& output, const ExportInfo& exportInfo);
 void export_nefdbg(const shared_ptr<const Geometry>& geom, std::ostream& output);
 void export_nef3(const shared_ptr<const Geometry>& geom, std::ostream& output);
+// Named 2D layers in one file, e.g. the cross sections of --slice-layers
+using ExportLayers = std::vector<std::pair<std::string, shared_ptr<const Polygon2d>>>;
+void export_svg_layers(const ExportLayers& layers, std::ostream& output);
+void export_dxf_layers(const ExportLayers& layers, std::ostream& output);
 
 
 enum class Previewer { OPENCSG, THROWNTOGETHER };
-enum class RenderType { GEOMETRY, CGAL, OPENCSG, THROWNTOGETHER };
+// QUICK is GEOMETRY evaluated with Manifold in float precision only
+enum class RenderType { GEOMETRY, CGAL, QUICK, OPENCSG, THROWNTOGETHER };
 
 struct ExportFileFormatOptions {
   const std::map<const std::string, FileFormat> exportFileFormats{
     {"asciistl", FileFormat::ASCIISTL},
     {"binstl", FileFormat::STL},
-    {"stl", FileFormat::ASCIISTL}, // Deprecated.  Later to FileFormat::STL
+    {"stl", FileFormat::STL},
     {"obj", FileFormat::OBJ},
     {"off", FileFormat::OFF},
     {"wrl", FileFormat::WRL},
     {"amf", FileFormat::AMF},
     {"3mf", FileFormat::_3MF},
+    {"glb", FileFormat::GLB},
+    {"geom", FileFormat::GEOM},
     {"dxf", FileFormat::DXF},
     {"svg", FileFormat::SVG},
     {"nefdbg", FileFormat::NEFDBG},
@@ -134,6 +159,7 @@ struct ExportFileFormatOptions {
     {"term", FileFormat::TERM},
     {"echo", FileFormat::ECHO},
     {"png", FileFormat::PNG},
+    {"rgba", FileFormat::RGBA},
     {"pdf", FileFormat::PDF},
   };
 };
@@ -171,11 +197,18 @@ struct ViewOptions {
 
 };
 
-class OffscreenView;
-
-std::unique_ptr<OffscreenView> prepare_preview(Tree& tree, const ViewOptions& options, Camera& camera);
-bool export_png(const shared_ptr<const class Geometry>& root_geom, const ViewOptions& options, Camera& camera, std::ostream& output);
-bool export_png(const OffscreenView& glview, std::ostream& output);
+class Renderer;
+
+// The renderer draws the geometry, or the preview of tree, for any number of views of the camera's image size
+std::unique_ptr<Renderer> prepare_png(const shared_ptr<const class Geometry>& root_geom, const Camera& camera);
+std::unique_ptr<Renderer> prepare_preview(Tree& tree, const ViewOptions& options, const Camera& camera);
+bool export_png(Renderer& renderer, const ViewOptions& options, Camera& camera, std::ostream& output);
+// Writes the image to the file once encoded in the background, see wait_png_exports()
+bool export_png(Renderer& renderer, const ViewOptions& options, Camera& camera, const std::string& filename);
+// Waits until the images are written, false if any failed
+bool wait_png_exports();
+// Writes the pixels as is, 8 bit RGBA from the top row, e.g. as video frames for ffmpeg
+bool export_rgba(Renderer& renderer, const ViewOptions& options, Camera& camera, std::ostream& output);
 bool export_param(SourceFile *root, const fs::path& path, std::ostream& output);
 
 namespace Export {
@@ -210,12 +243,18 @@ public:
   using Vertex = std::array<double, 3>;
 
   ExportMesh(const PolySet& ps);
+#ifdef ENABLE_MANIFOLD
+  // Reads the triangles from the Manifold mesh, without a PolySet in between
+  ExportMesh(const ManifoldGeometry& mani);
+#endif
 
   bool foreach_vertex(const std::function<bool(const Vertex&)>& callback) const;
   bool foreach_indexed_triangle(const std::function<bool(const std::array<int, 3>&)>& callback) const;
   bool foreach_triangle(const std::function<bool(const std::array<Vertex, 3>&)>& callback) const;
 
 private:
+  void addTriangles(size_t count, const std::function<std::array<Vector3d, 3>(size_t)>& triangle);
+
   std::vector<Vertex> vertices;
   std::vector<Triangle> triangles;
 };
@@ -25,268 +25,392 @@
  */
 
 #include "export.h"
+
+#ifdef ENABLE_CGAL
+
 #include "PolySet.h"
 #include "PolySetUtils.h"
 #include "printutils.h"
+#include "parallel.h"
 #include "CGALHybridPolyhedron.h"
+#include "CGAL_Nef_polyhedron.h"
+#include "cgalutils.h"
 #ifdef ENABLE_MANIFOLD
 #include "ManifoldGeometry.h"
 #endif
 
-#ifdef ENABLE_LIB3MF
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <zlib.h>
 
-static uint32_t lib3mf_write_callback(const char *data, uint32_t bytes, std::ostream *stream)
+namespace {
+
+void put16(std::string& out, uint16_t v)
 {
-  stream->write(data, bytes);
-  return !(*stream);
+  for (int i = 0; i < 2; ++i) out += static_cast<char>((v >> (8 * i)) & 0xff);
 }
 
-static uint32_t lib3mf_seek_callback(uint64_t pos, std::ostream *stream)
+void put32(std::string& out, uint32_t v)
 {
-  stream->seekp(pos);
-  return !(*stream);
+  for (int i = 0; i < 4; ++i) out += static_cast<char>((v >> (8 * i)) & 0xff);
 }
 
-#ifndef LIB3MF_API_2
-#include <Model/COM/NMR_DLLInterfaces.h>
-#undef BOOL
-using namespace NMR;
-
-#include <algorithm>
-
-#ifdef ENABLE_CGAL
+void put64(std::string& out, uint64_t v)
+{
+  for (int i = 0; i < 8; ++i) out += static_cast<char>((v >> (8 * i)) & 0xff);
+}
 
-#include "cgal.h"
-#include "cgalutils.h"
-#include "CGAL_Nef_polyhedron.h"
+struct DeflatedChunk {
+  std::string data;
+  uLong crc;
+  size_t size;
+};
 
-static void export_3mf_error(std::string msg, PLib3MFModel *& model)
+/*!
+   Compresses text as raw deflate data. Unless it is the last chunk of an
+   entry, the stream ends on a byte boundary without a final block, so
+   independently compressed chunks concatenate to one valid stream.
+ */
+DeflatedChunk deflate_chunk(const std::string& text, bool last)
 {
-  LOG(message_group::Export_Error, std::move(msg));
-  if (model) {
-    lib3mf_release(model);
-    model = nullptr;
-  }
+  DeflatedChunk chunk;
+  chunk.size = text.size();
+  chunk.crc = crc32(0, reinterpret_cast<const Bytef *>(text.data()), text.size());
+
+  z_stream stream{};
+  deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+  // Space for the sync flush marker on top of the bound
+  chunk.data.resize(deflateBound(&stream, text.size()) + 16);
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(text.data()));
+  stream.avail_in = text.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&chunk.data[0]);
+  stream.avail_out = chunk.data.size();
+  deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  chunk.data.resize(stream.total_out);
+  deflateEnd(&stream);
+  return chunk;
 }
 
-/*
- * PolySet must be triangulated.
+/*!
+   Writes a ZIP archive to a stream, one entry after the other. The data of
+   an entry is compressed in chunks, which write_chunks() formats and
+   compresses in parallel. Sizes and checksums follow each entry in a data
+   descriptor, so nothing needs to be seeked back to.
  */
-static bool append_polyset(const PolySet& ps, PLib3MFModelMeshObject *& model)
+class ZipWriter
 {
-  PLib3MFModelMeshObject *mesh;
-  if (lib3mf_model_addmeshobject(model, &mesh) != LIB3MF_OK) {
-    export_3mf_error("Can't add mesh to 3MF model.", model);
-    return false;
-  }
-  if (lib3mf_object_setnameutf8(mesh, "OpenSCAD Model") != LIB3MF_OK) {
-    export_3mf_error("Can't set name for 3MF model.", model);
-    return false;
+public:
+  ZipWriter(std::ostream& output) : output(output) {
+    const std::time_t now = std::time(nullptr);
+    const std::tm *t = std::localtime(&now);
+    dostime = (t->tm_hour << 11) | (t->tm_min << 5) | (t->tm_sec / 2);
+    dosdate = (std::max(t->tm_year - 80, 0) << 9) | ((t->tm_mon + 1) << 5) | t->tm_mday;
   }
 
-  auto vertexFunc = [&](const std::array<double, 3>& coords) -> bool {
-      MODELMESHVERTEX v{(FLOAT)coords[0], (FLOAT)coords[1], (FLOAT)coords[2]};
-      return lib3mf_meshobject_addvertex(mesh, &v, nullptr) == LIB3MF_OK;
-    };
-
-  auto triangleFunc = [&](const std::array<int, 3>& indices) -> bool {
-      MODELMESHTRIANGLE t{(DWORD)indices[0], (DWORD)indices[1], (DWORD)indices[2]};
-      return lib3mf_meshobject_addtriangle(mesh, &t, nullptr) == LIB3MF_OK;
-    };
-
-  Export::ExportMesh exportMesh{ps};
-
-  if (!exportMesh.foreach_vertex(vertexFunc)) {
-    export_3mf_error("Can't add vertex to 3MF model.", model);
-    return false;
+  void begin_entry(const std::string& name) {
+    entries.push_back({name, offset, 0, 0, 0});
+    std::string header;
+    put32(header, 0x04034b50);
+    put16(header, 20);     // Version needed
+    put16(header, 0x0008); // Sizes in the data descriptor
+    put16(header, 8);      // Deflate
+    put16(header, dostime);
+    put16(header, dosdate);
+    put32(header, 0);
+    put32(header, 0);
+    put32(header, 0);
+    put16(header, name.size());
+    put16(header, 0);
+    header += name;
+    emit(header);
   }
 
-  if (!exportMesh.foreach_indexed_triangle(triangleFunc)) {
-    export_3mf_error("Can't add triangle to 3MF model.", model);
-    return false;
+  // Adds text to the current entry, compressed once enough has been collected
+  void write(const std::string& text) {
+    pending += text;
+    if (pending.size() >= chunkSize) flush(false);
   }
 
-  PLib3MFModelBuildItem *builditem;
-  if (lib3mf_model_addbuilditem(model, mesh, nullptr, &builditem) != LIB3MF_OK) {
-    export_3mf_error("Can't add build item to 3MF model.", model);
-    return false;
+  // Adds the texts format(0) to format(count - 1) to the current entry
+  void write_chunks(size_t count, const std::function<std::string(size_t)>& format) {
+    flush(false);
+    for (size_t begin = 0; begin < count; begin += maxParallelChunks) {
+      std::vector<size_t> indices;
+      for (size_t i = begin; i < std::min(count, begin + maxParallelChunks); ++i) indices.push_back(i);
+      std::vector<DeflatedChunk> chunks(indices.size());
+      parallelizable_transform(indices.begin(), indices.end(), chunks.begin(), [&format](size_t i) {
+        return deflate_chunk(format(i), false);
+      });
+      for (const auto& chunk : chunks) append(chunk);
+    }
   }
 
-  return true;
-}
-
-static bool append_nef(const CGAL_Nef_polyhedron& root_N, PLib3MFModelMeshObject *& model)
-{
-  if (!root_N.p3) {
-    LOG(message_group::Export_Error, "Export failed, empty geometry.");
-    return false;
+  void end_entry() {
+    flush(true);
+    const auto& entry = entries.back();
+    std::string descriptor;
+    put32(descriptor, 0x08074b50);
+    put32(descriptor, entry.crc);
+    if (entry.compressed_size >= 0xffffffff || entry.size >= 0xffffffff) {
+      put64(descriptor, entry.compressed_size);
+      put64(descriptor, entry.size);
+    } else {
+      put32(descriptor, entry.compressed_size);
+      put32(descriptor, entry.size);
+    }
+    emit(descriptor);
   }
 
-  if (!root_N.p3->is_simple()) {
-    LOG(message_group::Export_Warning, "Exported object may not be a valid 2-manifold and may need repair");
+  // Writes the central directory, with ZIP64 records where sizes or offsets need them
+  void finish() {
+    const uint64_t directory_offset = offset;
+    for (const auto& entry : entries) {
+      std::string extra;
+      if (entry.size >= 0xffffffff || entry.compressed_size >= 0xffffffff || entry.offset >= 0xffffffff) {
+        put16(extra, 0x0001);
+        put16(extra, 24);
+        put64(extra, entry.size);
+        put64(extra, entry.compressed_size);
+        put64(extra, entry.offset);
+      }
+      const bool zip64 = !extra.empty();
+      std::string header;
+      put32(header, 0x02014b50);
+      put16(header, zip64 ? 45 : 20); // Version made by
+      put16(header, zip64 ? 45 : 20); // Version needed
+      put16(header, 0x0008);
+      put16(header, 8);
+      put16(header, dostime);
+      put16(header, dosdate);
+      put32(header, entry.crc);
+      put32(header, zip64 ? 0xffffffff : entry.compressed_size);
+      put32(header, zip64 ? 0xffffffff : entry.size);
+      put16(header, entry.name.size());
+      put16(header, extra.size());
+      put16(header, 0); // Comment
+      put16(header, 0); // Disk
+      put16(header, 0); // Internal attributes
+      put32(header, 0); // External attributes
+      put32(header, zip64 ? 0xffffffff : entry.offset);
+      header += entry.name;
+      header += extra;
+      emit(header);
+    }
+    const uint64_t directory_size = offset - directory_offset;
+
+    std::string end;
+    if (directory_offset >= 0xffffffff) {
+      const uint64_t zip64_end_offset = offset;
+      put32(end, 0x06064b50);
+      put64(end, 44);
+      put16(end, 45);
+      put16(end, 45);
+      put32(end, 0);
+      put32(end, 0);
+      put64(end, entries.size());
+      put64(end, entries.size());
+      put64(end, directory_size);
+      put64(end, directory_offset);
+      put32(end, 0x07064b50);
+      put32(end, 0);
+      put64(end, zip64_end_offset);
+      put32(end, 1);
+    }
+    put32(end, 0x06054b50);
+    put16(end, 0);
+    put16(end, 0);
+    put16(end, entries.size());
+    put16(end, entries.size());
+    put32(end, directory_size);
+    put32(end, std::min<uint64_t>(directory_offset, 0xffffffff));
+    put16(end, 0);
+    emit(end);
   }
 
-  PolySet ps{3};
-  const bool err = CGALUtils::createPolySetFromNefPolyhedron3(*root_N.p3, ps);
-  if (err) {
-    export_3mf_error("Error converting NEF Polyhedron.", model);
-    return false;
+private:
+  struct Entry {
+    std::string name;
+    uint64_t offset;
+    uLong crc;
+    uint64_t compressed_size;
+    uint64_t size;
+  };
+
+  void flush(bool last) {
+    if (pending.empty() && !last) return;
+    append(deflate_chunk(pending, last));
+    pending.clear();
   }
 
-  return append_polyset(ps, model);
-}
-
-static bool append_3mf(const shared_ptr<const Geometry>& geom, PLib3MFModelMeshObject *& model)
-{
-  if (const auto geomlist = dynamic_pointer_cast<const GeometryList>(geom)) {
-    for (const auto& item : geomlist->getChildren()) {
-      if (!append_3mf(item.second, model)) return false;
-    }
-  } else if (const auto N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
-    return append_nef(*N, model);
-  } else if (const auto hybrid = dynamic_pointer_cast<const CGALHybridPolyhedron>(geom)) {
-    return append_polyset(*hybrid->toPolySet(), model);
-#ifdef ENABLE_MANIFOLD
-  } else if (const auto mani = dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
-    return append_polyset(*mani->toPolySet(), model);
-#endif
-  } else if (const auto ps = dynamic_pointer_cast<const PolySet>(geom)) {
-    PolySet triangulated(3);
-    PolySetUtils::tessellate_faces(*ps, triangulated);
-    return append_polyset(triangulated, model);
-  } else if (dynamic_pointer_cast<const Polygon2d>(geom)) { // NOLINT(bugprone-branch-clone)
-    assert(false && "Unsupported file format");
-  } else { // NOLINT(bugprone-branch-clone)
-    assert(false && "Not implemented");
+  void append(const DeflatedChunk& chunk) {
+    auto& entry = entries.back();
+    entry.crc = crc32_combine(entry.crc, chunk.crc, chunk.size);
+    entry.compressed_size += chunk.data.size();
+    entry.size += chunk.size;
+    emit(chunk.data);
   }
 
-  return true;
-}
-
-/*!
-    Saves the current 3D Geometry as 3MF to the given file.
-    The file must be open.
- */
-void export_3mf(const shared_ptr<const Geometry>& geom, std::ostream& output)
-{
-  DWORD interfaceVersionMajor, interfaceVersionMinor, interfaceVersionMicro;
-  HRESULT result = lib3mf_getinterfaceversion(&interfaceVersionMajor, &interfaceVersionMinor, &interfaceVersionMicro);
-  if (result != LIB3MF_OK) {
-    LOG(message_group::Export_Error, "Error reading 3MF library version");
-    return;
+  void emit(const std::string& data) {
+    output.write(data.data(), data.size());
+    offset += data.size();
   }
 
-  if ((interfaceVersionMajor != NMR_APIVERSION_INTERFACE_MAJOR)) {
-    LOG(message_group::Export_Error, "Invalid 3MF library major version %1$d.%2$d.%3$d, expected %4$d.%5$d.%6$d", interfaceVersionMajor, interfaceVersionMinor, interfaceVersionMicro, NMR_APIVERSION_INTERFACE_MAJOR, NMR_APIVERSION_INTERFACE_MINOR, NMR_APIVERSION_INTERFACE_MICRO);
-    return;
-  }
+  // Uncompressed bytes collected by write() before compressing them
+  static constexpr size_t chunkSize = 1 << 20;
+  // Chunks formatted at once by write_chunks(), which bounds the memory used
+  static constexpr size_t maxParallelChunks = 64;
 
-  PLib3MFModel *model;
-  result = lib3mf_createmodel(&model);
-  if (result != LIB3MF_OK) {
-    LOG(message_group::Export_Error, "Can't create 3MF model.");
-    return;
-  }
+  std::ostream& output;
+  uint64_t offset{0};
+  uint16_t dostime, dosdate;
+  std::vector<Entry> entries;
+  std::string pending;
+};
 
-  if (!append_3mf(geom, model)) {
-    if (model) lib3mf_release(model);
-    return;
-  }
+// Vertices or triangles formatted per chunk
+constexpr size_t itemsPerChunk = 1 << 14;
 
-  PLib3MFModelWriter *writer;
-  if (lib3mf_model_querywriter(model, "3mf", &writer) != LIB3MF_OK) {
-    export_3mf_error("Can't get writer for 3MF model.", model);
+// Coordinates are written as floats with six decimals, as lib3mf does
+void append_coordinate(std::string& out, double v)
+{
+  if (v == 0) {
+    out += '0';
     return;
   }
-
-  result = lib3mf_writer_writetocallback(writer, (void *)lib3mf_write_callback, (void *)lib3mf_seek_callback, &output);
-  output.flush();
-  lib3mf_release(writer);
-  lib3mf_release(model);
-  if (result != LIB3MF_OK) {
-    LOG(message_group::Export_Error, "Error writing 3MF model.");
-  }
-
-
+  char buf[64];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  out.append(buf, std::to_chars(buf, buf + sizeof(buf), static_cast<float>(v), std::chars_format::fixed, 6).ptr - buf);
+#else
+  out.append(buf, std::min<size_t>(snprintf(buf, sizeof(buf), "%f", static_cast<float>(v)), sizeof(buf) - 1));
+#endif
 }
 
-#endif // ENABLE_CGAL
-
-#else // LIB3MF_API_2
-
-#include "lib3mf_implicit.hpp"
-
-#include <algorithm>
-
-#ifdef ENABLE_CGAL
-
-#include "cgal.h"
-#include "cgalutils.h"
-#include "CGAL_Nef_polyhedron.h"
-
-static void export_3mf_error(std::string msg)
+void append_index(std::string& out, int v)
 {
-  LOG(message_group::Export_Error, std::move(msg));
+  char buf[16];
+  out.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr - buf);
 }
 
-/*
- * PolySet must be triangulated.
- */
-static bool append_polyset(const PolySet& ps, Lib3MF::PWrapper& wrapper, Lib3MF::PModel& model)
+class ModelWriter
 {
-  try {
-    auto mesh = model->AddMeshObject();
-    if (!mesh) return false;
-    mesh->SetName("OpenSCAD Model");
-
-    auto vertexFunc = [&](const std::array<double, 3>& coords) -> bool {
-        try {
-          Lib3MF::sPosition v{(Lib3MF_single)coords[0], (Lib3MF_single)coords[1], (Lib3MF_single)coords[2]};
-          mesh->AddVertex(v);
-        } catch (Lib3MF::ELib3MFException& e) {
-          export_3mf_error(e.what());
-          return false;
-        }
-        return true;
-      };
-
-    auto triangleFunc = [&](const std::array<int, 3>& indices) -> bool {
-        try {
-          Lib3MF::sTriangle t{(Lib3MF_uint32)indices[0], (Lib3MF_uint32)indices[1], (Lib3MF_uint32)indices[2]};
-          mesh->AddTriangle(t);
-        } catch (Lib3MF::ELib3MFException& e) {
-          export_3mf_error(e.what());
-          return false;
-        }
-        return true;
-      };
-
-    Export::ExportMesh exportMesh{ps};
-
-    if (!exportMesh.foreach_vertex(vertexFunc)) {
-      export_3mf_error("Can't add vertex to 3MF model.");
-      return false;
-    }
+public:
+  ModelWriter(std::ostream& output) : zip(output), random(std::random_device{}()) {}
+
+  void begin() {
+    zip.begin_entry("[Content_Types].xml");
+    zip.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+              "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+              "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\" />"
+              "<Default Extension=\"model\" ContentType=\"application/vnd.ms-package.3dmanufacturing-3dmodel+xml\" />"
+              "</Types>");
+    zip.end_entry();
+    zip.begin_entry("_rels/.rels");
+    zip.write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+              "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+              "<Relationship Target=\"/3D/3dmodel.model\" Id=\"rel0\" Type=\"http://schemas.microsoft.com/3dmanufacturing/2013/01/3dmodel\" />"
+              "</Relationships>");
+    zip.end_entry();
+
+    zip.begin_entry("3D/3dmodel.model");
+    zip.write("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+              "<model xmlns=\"http://schemas.microsoft.com/3dmanufacturing/core/2015/02\" unit=\"millimeter\" xml:lang=\"en-US\""
+              " xmlns:m=\"http://schemas.microsoft.com/3dmanufacturing/material/2015/02\""
+              " xmlns:p=\"http://schemas.microsoft.com/3dmanufacturing/production/2015/06\""
+              " xmlns:b=\"http://schemas.microsoft.com/3dmanufacturing/beamlattice/2017/02\""
+              " xmlns:s=\"http://schemas.microsoft.com/3dmanufacturing/slice/2015/07\">\n"
+              "\t<resources>\n");
+  }
 
-    if (!exportMesh.foreach_indexed_triangle(triangleFunc)) {
-      export_3mf_error("Can't add triangle to 3MF model.");
-      return false;
+  // Adds the PolySet as one object, it must be triangulated
+  void append(const PolySet& ps) { append(Export::ExportMesh{ps}); }
+
+  void append(const Export::ExportMesh& exportMesh) {
+    std::vector<Export::ExportMesh::Vertex> vertices;
+    std::vector<std::array<int, 3>> triangles;
+    exportMesh.foreach_vertex([&](const Export::ExportMesh::Vertex& v) {
+      vertices.push_back(v);
+      return true;
+    });
+    exportMesh.foreach_indexed_triangle([&](const std::array<int, 3>& t) {
+      triangles.push_back(t);
+      return true;
+    });
+
+    objects.push_back(objects.size() + 1);
+    zip.write("\t\t<object id=\"" + std::to_string(objects.back()) + "\" name=\"OpenSCAD Model\" type=\"model\" p:UUID=\"" + uuid() + "\">\n"
+              "\t\t\t<mesh>\n"
+              "\t\t\t\t<vertices>\n");
+    zip.write_chunks((vertices.size() + itemsPerChunk - 1) / itemsPerChunk, [&vertices](size_t chunk) {
+      std::string out;
+      const size_t end = std::min(vertices.size(), (chunk + 1) * itemsPerChunk);
+      for (size_t i = chunk * itemsPerChunk; i < end; ++i) {
+        out += "\t\t\t\t\t<vertex x=\"";
+        append_coordinate(out, vertices[i][0]);
+        out += "\" y=\"";
+        append_coordinate(out, vertices[i][1]);
+        out += "\" z=\"";
+        append_coordinate(out, vertices[i][2]);
+        out += "\" />\n";
+      }
+      return out;
+    });
+    zip.write("\t\t\t\t</vertices>\n"
+              "\t\t\t\t<triangles>\n");
+    zip.write_chunks((triangles.size() + itemsPerChunk - 1) / itemsPerChunk, [&triangles](size_t chunk) {
+      std::string out;
+      const size_t end = std::min(triangles.size(), (chunk + 1) * itemsPerChunk);
+      for (size_t i = chunk * itemsPerChunk; i < end; ++i) {
+        out += "\t\t\t\t\t<triangle v1=\"";
+        append_index(out, triangles[i][0]);
+        out += "\" v2=\"";
+        append_index(out, triangles[i][1]);
+        out += "\" v3=\"";
+        append_index(out, triangles[i][2]);
+        out += "\" />\n";
+      }
+      return out;
+    });
+    zip.write("\t\t\t\t</triangles>\n"
+              "\t\t\t</mesh>\n"
+              "\t\t</object>\n");
+  }
+
+  void end() {
+    zip.write("\t</resources>\n"
+              "\t<build p:UUID=\"" + uuid() + "\">\n");
+    for (const auto id : objects) {
+      zip.write("\t\t<item objectid=\"" + std::to_string(id) + "\" p:UUID=\"" + uuid() + "\" />\n");
     }
+    zip.write("\t</build>\n"
+              "</model>\n");
+    zip.end_entry();
+    zip.finish();
+  }
 
-    Lib3MF::PBuildItem builditem;
-    try {
-      model->AddBuildItem(mesh.get(), wrapper->GetIdentityTransform());
-    } catch (Lib3MF::ELib3MFException& e) {
-      export_3mf_error(e.what());
+private:
+  // Random version 4 UUID, as the production extension requires for objects and items
+  std::string uuid() {
+    std::uniform_int_distribution<int> digit(0, 15);
+    std::string result = "xxxxxxxx-xxxx-4xxx-yxxx-xxxxxxxxxxxx";
+    for (auto& c : result) {
+      if (c == 'x') c = "0123456789abcdef"[digit(random)];
+      else if (c == 'y') c = "89ab"[digit(random) & 3];
     }
-  } catch (Lib3MF::ELib3MFException& e) {
-    export_3mf_error(e.what());
-    return false;
+    return result;
   }
-  return true;
-}
 
-static bool append_nef(const CGAL_Nef_polyhedron& root_N, Lib3MF::PWrapper& wrapper, Lib3MF::PModel& model)
+  ZipWriter zip;
+  std::mt19937 random;
+  std::vector<int> objects;
+};
+
+bool append_nef(const CGAL_Nef_polyhedron& root_N, ModelWriter& writer)
 {
   if (!root_N.p3) {
     LOG(message_group::Export_Error, "Export failed, empty geometry.");
@@ -300,114 +424,59 @@ static bool append_nef(const CGAL_Nef_polyhedron& root_N, Lib3MF::PWrapper& wrap
   PolySet ps{3};
   const bool err = CGALUtils::createPolySetFromNefPolyhedron3(*root_N.p3, ps);
   if (err) {
-    export_3mf_error("Error converting NEF Polyhedron.");
+    LOG(message_group::Export_Error, "Error converting NEF Polyhedron.");
     return false;
   }
 
-  return append_polyset(ps, wrapper, model);
+  writer.append(ps);
+  return true;
 }
 
-static bool append_3mf(const shared_ptr<const Geometry>& geom, Lib3MF::PWrapper& wrapper, Lib3MF::PModel& model)
+// Each object of a geometry list, e.g. the top level objects of a lazy union, is kept as an object of its own
+bool append_3mf(const shared_ptr<const Geometry>& geom, ModelWriter& writer)
 {
   if (const auto geomlist = dynamic_pointer_cast<const GeometryList>(geom)) {
     for (const auto& item : geomlist->getChildren()) {
-      if (!append_3mf(item.second, wrapper, model)) return false;
+      if (!append_3mf(item.second, writer)) return false;
     }
   } else if (const auto N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
-    return append_nef(*N, wrapper, model);
+    return append_nef(*N, writer);
   } else if (const auto hybrid = dynamic_pointer_cast<const CGALHybridPolyhedron>(geom)) {
-    return append_polyset(*hybrid->toPolySet(), wrapper, model);
+    writer.append(*hybrid->toPolySet());
 #ifdef ENABLE_MANIFOLD
   } else if (const auto mani = dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
-    return append_polyset(*mani->toPolySet(), wrapper, model);
+    writer.append(Export::ExportMesh{*mani});
 #endif
   } else if (const auto ps = dynamic_pointer_cast<const PolySet>(geom)) {
     PolySet triangulated(3);
     PolySetUtils::tessellate_faces(*ps, triangulated);
-    return append_polyset(triangulated, wrapper, model);
-  } else if (dynamic_pointer_cast<const Polygon2d>(geom)) {
+    writer.append(triangulated);
+  } else if (dynamic_pointer_cast<const Polygon2d>(geom)) { // NOLINT(bugprone-branch-clone)
     assert(false && "Unsupported file format");
-  } else {
+  } else { // NOLINT(bugprone-branch-clone)
     assert(false && "Not implemented");
   }
 
   return true;
 }
 
+} // namespace
+
 /*!
     Saves the current 3D Geometry as 3MF to the given file.
     The file must be open.
- */
 
+    The model XML is written straight from the meshes into the ZIP container,
+    compressing chunks of vertices and triangles in parallel.
+ */
 void export_3mf(const shared_ptr<const Geometry>& geom, std::ostream& output)
 {
-  Lib3MF_uint32 interfaceVersionMajor, interfaceVersionMinor, interfaceVersionMicro;
-  Lib3MF::PWrapper wrapper;
-
-  try {
-    wrapper = Lib3MF::CWrapper::loadLibrary();
-    wrapper->GetLibraryVersion(interfaceVersionMajor, interfaceVersionMinor, interfaceVersionMicro);
-    if (interfaceVersionMajor != LIB3MF_VERSION_MAJOR) {
-      LOG(message_group::Error, "Invalid 3MF library major version %1$d.%2$d.%3$d, expected %4$d.%5$d.%6$d",
-          interfaceVersionMajor, interfaceVersionMinor, interfaceVersionMicro,
-          LIB3MF_VERSION_MAJOR, LIB3MF_VERSION_MINOR, LIB3MF_VERSION_MICRO);
-      return;
-    }
-  } catch (Lib3MF::ELib3MFException& e) {
-    LOG(message_group::Export_Error, e.what());
-    return;
-  }
-
-  if ((interfaceVersionMajor != LIB3MF_VERSION_MAJOR)) {
-    LOG(message_group::Export_Error, "Invalid 3MF library major version %1$d.%2$d.%3$d, expected %4$d.%5$d.%6$d", interfaceVersionMajor, interfaceVersionMinor, interfaceVersionMicro, LIB3MF_VERSION_MAJOR, LIB3MF_VERSION_MINOR, LIB3MF_VERSION_MICRO);
-    return;
-  }
-
-  Lib3MF::PModel model;
-  try {
-    model = wrapper->CreateModel();
-    if (!model) {
-      LOG(message_group::Export_Error, "Can't create 3MF model.");
-      return;
-    }
-  } catch (Lib3MF::ELib3MFException& e) {
-    LOG(message_group::Export_Error, e.what());
-    return;
-  }
-
-  if (!append_3mf(geom, wrapper, model)) {
-    return;
-  }
-
-  Lib3MF::PWriter writer;
-  try {
-    writer = model->QueryWriter("3mf");
-    if (!writer) {
-      export_3mf_error("Can't get writer for 3MF model.");
-      return;
-    }
-  } catch (Lib3MF::ELib3MFException& e) {
-    export_3mf_error("Can't get writer for 3MF model.");
-    return;
-  }
-
-  try {
-    writer->WriteToCallback((Lib3MF::WriteCallback)lib3mf_write_callback, (Lib3MF::SeekCallback)lib3mf_seek_callback, &output);
-  } catch (Lib3MF::ELib3MFException& e) {
-    LOG(message_group::Export_Error, e.what());
-  }
+  ModelWriter writer(output);
+  writer.begin();
+  // On failure the archive is still completed, the error has been reported
+  append_3mf(geom, writer);
+  writer.end();
   output.flush();
 }
 
 #endif // ENABLE_CGAL
-
-#endif // LIB3MF_API_2
-
-#else // ENABLE_LIB3MF
-
-void export_3mf(const shared_ptr<const Geometry>&, std::ostream&)
-{
-  LOG("Export to 3MF format was not enabled when building the application.");
-}
-
-#endif // ENABLE_LIB3MF
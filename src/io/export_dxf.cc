@@ -26,12 +26,19 @@
 
 #include "export.h"
 #include "PolySet.h"
+#include "TextWriter.h"
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
 
 /*!
     Saves the current Polygon2d as DXF to the given absolute filename.
  */
 
-void export_dxf_header(std::ostream& output, double xMin, double yMin, double xMax, double yMax) {
+static void export_dxf_header(TextWriter& output, double xMin, double yMin, double xMax, double yMax,
+                              const std::vector<std::string>& layers) {
 
   // https://dxfwrite.readthedocs.io/en/latest/headervars.html
   // http://paulbourke.net/dataformats/dxf/min3d.html
@@ -120,14 +127,18 @@ void export_dxf_header(std::ostream& output, double xMin, double yMin, double xM
   output
     << "  0\n" << "TABLE\n"
     << "  2\n" << "LAYER\n"
-    << " 70\n" << "6\n"
-
-    << "  0\n" << "LAYER\n"
-    << "  2\n" << "0\n"         // layer name
-    << " 70\n" << "64\n"
-    << " 62\n" << "7\n"         // color
-    << "  6\n" << "CONTINUOUS\n"
+    << " 70\n" << std::max<size_t>(6, layers.size()) << "\n";
+
+  for (const auto& layer : layers) {
+    output
+      << "  0\n" << "LAYER\n"
+      << "  2\n" << layer << "\n"       // layer name
+      << " 70\n" << "64\n"
+      << " 62\n" << "7\n"         // color
+      << "  6\n" << "CONTINUOUS\n";
+  }
 
+  output
     << "  0\n" << "ENDTAB\n";
 
   /* --- STYLE --- */
@@ -152,14 +163,8 @@ void export_dxf_header(std::ostream& output, double xMin, double yMin, double xM
 
 }
 
-void export_dxf(const Polygon2d& poly, std::ostream& output)
+static void extend_limits(const Polygon2d& poly, double& xMin, double& yMin, double& xMax, double& yMax)
 {
-  setlocale(LC_NUMERIC, "C"); // Ensure radix is . (not ,) in output
-
-  // find limits
-  double xMin, yMin, xMax, yMax;
-  xMin = yMin = std::numeric_limits<double>::max(),
-  xMax = yMax = std::numeric_limits<double>::min();
   for (const auto& o : poly.outlines()) {
     for (const auto& p : o.vertices) {
       if (xMin > p[0]) xMin = p[0];
@@ -168,22 +173,10 @@ void export_dxf(const Polygon2d& poly, std::ostream& output)
       if (yMax < p[1]) yMax = p[1];
     }
   }
+}
 
-  export_dxf_header(output, xMin, yMin, xMax, yMax);
-
-  // REFERENCE:
-  // DXF (AutoCAD Drawing Interchange Format) Family, ASCII variant
-  //    https://www.loc.gov/preservation/digital/formats/fdd/fdd000446.shtml#specs
-  // About the DXF Format (DXF)
-  //    https://help.autodesk.com/view/ACD/2017/ENU/?guid=GUID-235B22E0-A567-4CF6-92D3-38A2306D73F3
-  // About ASCII DXF Files
-  //    https://help.autodesk.com/view/ACD/2017/ENU/?guid=GUID-20172853-157D-4024-8E64-32F3BD64F883
-  // DXF Format
-  //    https://documentation.help/AutoCAD-DXF/WSfacf1429558a55de185c428100849a0ab7-5f35.htm
-
-  output << "  0\n" << "SECTION\n"
-         << "  2\n" << "ENTITIES\n";
-
+static void append_dxf_entities(const Polygon2d& poly, const std::string& layer, TextWriter& output)
+{
   for (const auto& o : poly.outlines()) {
     switch (o.vertices.size() ) {
     case 1: {
@@ -191,7 +184,7 @@ void export_dxf(const Polygon2d& poly, std::ostream& output)
       const Vector2d& p = o.vertices[0];
       output << "  0\n" << "POINT\n"
              << "100\n" << "AcDbEntity\n"
-             << "  8\n" << "0\n" // layer 0
+             << "  8\n" << layer << "\n"
              << "100\n" << "AcDbPoint\n"
              << " 10\n" << p[0] << "\n" // x
              << " 20\n" << p[1] << "\n"; // y
@@ -204,7 +197,7 @@ void export_dxf(const Polygon2d& poly, std::ostream& output)
       const Vector2d& p2 = o.vertices[1];
       output << "  0\n" << "LINE\n"
              << "100\n" << "AcDbEntity\n"
-             << "  8\n" << "0\n" // layer 0
+             << "  8\n" << layer << "\n"
              << "100\n" << "AcDbLine\n"
              << " 10\n" << p1[0] << "\n" // x1
              << " 20\n" << p1[1] << "\n" // y1
@@ -215,7 +208,7 @@ void export_dxf(const Polygon2d& poly, std::ostream& output)
       // LWPOLYLINE
       output << "  0\n" << "LWPOLYLINE\n"
              << "100\n" << "AcDbEntity\n"
-             << "  8\n" << "0\n"      // layer 0
+             << "  8\n" << layer << "\n"
              << "100\n" << "AcDbPolyline\n"
              << " 90\n" << o.vertices.size() << "\n" // number of vertices
              << " 70\n" << "1\n";         // closed = 1
@@ -226,13 +219,56 @@ void export_dxf(const Polygon2d& poly, std::ostream& output)
       break;
     }
   }
+}
+
+/*!
+   Writes the named layers, each with the entities of its polygon.
+ */
+void export_dxf_layers(const ExportLayers& layers, std::ostream& stream)
+{
+  setlocale(LC_NUMERIC, "C"); // Ensure radix is . (not ,) in output
+  TextWriter output(stream);
+
+  // find limits
+  double xMin, yMin, xMax, yMax;
+  xMin = yMin = std::numeric_limits<double>::max(),
+  xMax = yMax = std::numeric_limits<double>::min();
+  std::vector<std::string> names;
+  for (const auto& layer : layers) {
+    extend_limits(*layer.second, xMin, yMin, xMax, yMax);
+    names.push_back(layer.first);
+  }
+
+  export_dxf_header(output, xMin, yMin, xMax, yMax, names);
+
+  // REFERENCE:
+  // DXF (AutoCAD Drawing Interchange Format) Family, ASCII variant
+  //    https://www.loc.gov/preservation/digital/formats/fdd/fdd000446.shtml#specs
+  // About the DXF Format (DXF)
+  //    https://help.autodesk.com/view/ACD/2017/ENU/?guid=GUID-235B22E0-A567-4CF6-92D3-38A2306D73F3
+  // About ASCII DXF Files
+  //    https://help.autodesk.com/view/ACD/2017/ENU/?guid=GUID-20172853-157D-4024-8E64-32F3BD64F883
+  // DXF Format
+  //    https://documentation.help/AutoCAD-DXF/WSfacf1429558a55de185c428100849a0ab7-5f35.htm
+
+  output << "  0\n" << "SECTION\n"
+         << "  2\n" << "ENTITIES\n";
+
+  for (const auto& layer : layers) append_dxf_entities(*layer.second, layer.first, output);
 
   output << "  0\n" << "ENDSEC\n";
   output << "  0\n" << "EOF\n";
+  output.flush();
 
   setlocale(LC_NUMERIC, ""); // set default locale
 }
 
+void export_dxf(const Polygon2d& poly, std::ostream& stream)
+{
+  // Layer 0 always exists in DXF, the entities of single polygons go there
+  export_dxf_layers(ExportLayers{{"0", shared_ptr<const Polygon2d>(shared_ptr<const Polygon2d>(), &poly)}}, stream);
+}
+
 void export_dxf(const shared_ptr<const Geometry>& geom, std::ostream& output)
 {
   if (const auto geomlist = dynamic_pointer_cast<const GeometryList>(geom)) {
@@ -0,0 +1,285 @@
+/*
+ *  OpenSCAD (www.openscad.org)
+ *  Copyright (C) 2009-2011 Clifford Wolf <clifford@clifford.at> and
+ *                          Marius Kintel <marius@kintel.net>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  As a special exception, you have permission to link this program
+ *  with the CGAL library and distribute executables, as long as you
+ *  follow the requirements of the GNU GPL in regard to all of the
+ *  software in the executable aside from CGAL.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "export.h"
+
+#ifdef ENABLE_CGAL
+
+#include "Feature.h"
+#include "PolySet.h"
+#include "PolySetUtils.h"
+#include "printutils.h"
+#include "CGALHybridPolyhedron.h"
+#include "CGAL_Nef_polyhedron.h"
+#include "cgalutils.h"
+#ifdef ENABLE_MANIFOLD
+#include "ManifoldGeometry.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include <json.hpp>
+
+namespace {
+
+// glTF constants
+constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+constexpr int GL_SHORT = 5122;
+constexpr int GL_UNSIGNED_SHORT = 5123;
+constexpr int GL_UNSIGNED_INT = 5125;
+constexpr int GL_FLOAT = 5126;
+constexpr int GL_ARRAY_BUFFER = 34962;
+constexpr int GL_ELEMENT_ARRAY_BUFFER = 34963;
+constexpr int GL_TRIANGLES = 4;
+
+class GlbWriter
+{
+public:
+  GlbWriter() : quantize(Feature::ExperimentalGlbQuantization.is_enabled()) {}
+
+  // Adds one mesh with its own node, the PolySet must be triangulated
+  void append(const PolySet& ps) { append(Export::ExportMesh{ps}); }
+
+  void append(const Export::ExportMesh& exportMesh) {
+    std::vector<Export::ExportMesh::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    exportMesh.foreach_vertex([&](const Export::ExportMesh::Vertex& v) {
+      vertices.push_back(v);
+      return true;
+    });
+    exportMesh.foreach_indexed_triangle([&](const std::array<int, 3>& t) {
+      indices.insert(indices.end(), t.begin(), t.end());
+      return true;
+    });
+    if (indices.empty()) return;
+
+    std::array<double, 3> min, max;
+    min.fill(std::numeric_limits<double>::infinity());
+    max.fill(-std::numeric_limits<double>::infinity());
+    for (const auto& v : vertices) {
+      for (int i = 0; i < 3; ++i) {
+        min[i] = std::min(min[i], v[i]);
+        max[i] = std::max(max[i], v[i]);
+      }
+    }
+
+    nlohmann::json node = {{"mesh", meshes.size()}};
+    nlohmann::json position;
+    if (quantize) {
+      // KHR_mesh_quantization: 16 bit positions, mapped back by the node transform
+      std::array<double, 3> center, scale;
+      for (int i = 0; i < 3; ++i) {
+        center[i] = (min[i] + max[i]) / 2;
+        scale[i] = max[i] > min[i] ? (max[i] - min[i]) / 2 / 32767 : 1;
+      }
+      const size_t offset = begin_view(8);
+      std::array<int, 3> qmin{32767, 32767, 32767}, qmax{-32767, -32767, -32767};
+      for (const auto& v : vertices) {
+        int16_t q[4] = {0, 0, 0, 0}; // Padded to the 4 byte alignment
+        for (int i = 0; i < 3; ++i) {
+          q[i] = static_cast<int16_t>(std::lround((v[i] - center[i]) / scale[i]));
+          qmin[i] = std::min<int>(qmin[i], q[i]);
+          qmax[i] = std::max<int>(qmax[i], q[i]);
+        }
+        write(q, sizeof(q));
+      }
+      position = add_accessor(end_view(offset, GL_ARRAY_BUFFER, 8), GL_SHORT, vertices.size(), "VEC3");
+      position["min"] = qmin;
+      position["max"] = qmax;
+      node["translation"] = center;
+      node["scale"] = scale;
+    } else {
+      const size_t offset = begin_view(4);
+      for (const auto& v : vertices) {
+        const float f[3] = {static_cast<float>(v[0]), static_cast<float>(v[1]), static_cast<float>(v[2])};
+        write(f, sizeof(f));
+      }
+      position = add_accessor(end_view(offset, GL_ARRAY_BUFFER), GL_FLOAT, vertices.size(), "VEC3");
+      std::array<float, 3> fmin, fmax;
+      for (int i = 0; i < 3; ++i) {
+        fmin[i] = static_cast<float>(min[i]);
+        fmax[i] = static_cast<float>(max[i]);
+      }
+      position["min"] = fmin;
+      position["max"] = fmax;
+    }
+    accessors.push_back(position);
+    const size_t position_accessor = accessors.size() - 1;
+
+    // The smallest index type holding all vertices
+    const size_t offset = begin_view(4);
+    int type = GL_UNSIGNED_INT;
+    if (vertices.size() <= std::numeric_limits<uint16_t>::max()) {
+      type = GL_UNSIGNED_SHORT;
+      for (const auto i : indices) {
+        const auto s = static_cast<uint16_t>(i);
+        write(&s, sizeof(s));
+      }
+    } else {
+      write(indices.data(), indices.size() * sizeof(uint32_t));
+    }
+    accessors.push_back(add_accessor(end_view(offset, GL_ELEMENT_ARRAY_BUFFER), type, indices.size(), "SCALAR"));
+
+    const nlohmann::json primitive = {
+      {"attributes", {{"POSITION", position_accessor}}},
+      {"indices", accessors.size() - 1},
+      {"mode", GL_TRIANGLES},
+    };
+    meshes.push_back({{"name", "OpenSCAD Model"}, {"primitives", nlohmann::json::array({primitive})}});
+    nodes.push_back(node);
+  }
+
+  void write_to(std::ostream& output) {
+    // A root node turns the Z up design into glTF's Y up coordinates
+    nlohmann::json children = nlohmann::json::array();
+    for (size_t i = 0; i < nodes.size(); ++i) children.push_back(i + 1);
+    nlohmann::json root = {{"name", "OpenSCAD"}, {"rotation", {-M_SQRT1_2, 0.0, 0.0, M_SQRT1_2}}};
+    if (!children.empty()) root["children"] = children;
+    nodes.insert(nodes.begin(), root);
+
+    begin_view(4);
+    nlohmann::json gltf = {
+      {"asset", {{"version", "2.0"}, {"generator", "OpenSCAD"}}},
+      {"scene", 0},
+      {"scenes", nlohmann::json::array({{{"nodes", nlohmann::json::array({0})}}})},
+      {"nodes", nodes},
+    };
+    // glTF doesn't allow empty buffers
+    if (!buffer.empty()) {
+      gltf["meshes"] = meshes;
+      gltf["accessors"] = accessors;
+      gltf["bufferViews"] = views;
+      gltf["buffers"] = nlohmann::json::array({{{"byteLength", buffer.size()}}});
+    }
+    if (quantize) {
+      gltf["extensionsUsed"] = nlohmann::json::array({"KHR_mesh_quantization"});
+      gltf["extensionsRequired"] = nlohmann::json::array({"KHR_mesh_quantization"});
+    }
+    std::string json = gltf.dump();
+    json.resize((json.size() + 3) & ~size_t(3), ' ');
+
+    const uint32_t length = 12 + 8 + json.size() + (buffer.empty() ? 0 : 8 + buffer.size());
+    const uint32_t header[5] = {GLB_MAGIC, 2, length, static_cast<uint32_t>(json.size()), GLB_CHUNK_JSON};
+    output.write(reinterpret_cast<const char *>(header), sizeof(header));
+    output.write(json.data(), json.size());
+    if (!buffer.empty()) {
+      const uint32_t bin[2] = {static_cast<uint32_t>(buffer.size()), GLB_CHUNK_BIN};
+      output.write(reinterpret_cast<const char *>(bin), sizeof(bin));
+      output.write(buffer.data(), buffer.size());
+    }
+  }
+
+private:
+  // glTF is little endian, as are all platforms we build for
+  void write(const void *data, size_t size) {
+    const auto *bytes = static_cast<const char *>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+  }
+
+  size_t begin_view(size_t alignment) {
+    buffer.resize((buffer.size() + alignment - 1) / alignment * alignment, 0);
+    return buffer.size();
+  }
+
+  size_t end_view(size_t offset, int target, size_t stride = 0) {
+    nlohmann::json view = {{"buffer", 0}, {"byteOffset", offset}, {"byteLength", buffer.size() - offset}, {"target", target}};
+    if (stride) view["byteStride"] = stride;
+    views.push_back(view);
+    return views.size() - 1;
+  }
+
+  static nlohmann::json add_accessor(size_t view, int componentType, size_t count, const char *type) {
+    return {{"bufferView", view}, {"componentType", componentType}, {"count", count}, {"type", type}};
+  }
+
+  bool quantize;
+  std::vector<char> buffer;
+  nlohmann::json nodes = nlohmann::json::array();
+  nlohmann::json meshes = nlohmann::json::array();
+  nlohmann::json accessors = nlohmann::json::array();
+  nlohmann::json views = nlohmann::json::array();
+};
+
+bool append_glb(const shared_ptr<const Geometry>& geom, GlbWriter& writer)
+{
+  if (const auto geomlist = dynamic_pointer_cast<const GeometryList>(geom)) {
+    for (const auto& item : geomlist->getChildren()) {
+      if (!append_glb(item.second, writer)) return false;
+    }
+  } else if (const auto N = dynamic_pointer_cast<const CGAL_Nef_polyhedron>(geom)) {
+    if (!N->p3) {
+      LOG(message_group::Export_Error, "Export failed, empty geometry.");
+      return false;
+    }
+    if (!N->p3->is_simple()) {
+      LOG(message_group::Export_Warning, "Exported object may not be a valid 2-manifold and may need repair");
+    }
+    PolySet ps(3);
+    if (CGALUtils::createPolySetFromNefPolyhedron3(*N->p3, ps)) {
+      LOG(message_group::Export_Error, "Error converting NEF Polyhedron.");
+      return false;
+    }
+    writer.append(ps);
+  } else if (const auto hybrid = dynamic_pointer_cast<const CGALHybridPolyhedron>(geom)) {
+    writer.append(*hybrid->toPolySet());
+#ifdef ENABLE_MANIFOLD
+  } else if (const auto mani = dynamic_pointer_cast<const ManifoldGeometry>(geom)) {
+    writer.append(Export::ExportMesh{*mani});
+#endif
+  } else if (const auto ps = dynamic_pointer_cast<const PolySet>(geom)) {
+    PolySet triangulated(3);
+    PolySetUtils::tessellate_faces(*ps, triangulated);
+    writer.append(triangulated);
+  } else if (dynamic_pointer_cast<const Polygon2d>(geom)) { // NOLINT(bugprone-branch-clone)
+    assert(false && "Unsupported file format");
+  } else { // NOLINT(bugprone-branch-clone)
+    assert(false && "Not implemented");
+  }
+  return true;
+}
+
+} // namespace
+
+/*!
+   Saves the 3D geometry as binary glTF, with one indexed mesh per object of
+   the geometry. Vertex positions are 32 bit floats, or 16 bit integers with
+   KHR_mesh_quantization if the glb-quantization feature is enabled.
+ */
+void export_glb(const shared_ptr<const Geometry>& geom, std::ostream& output)
+{
+  GlbWriter writer;
+  if (!append_glb(geom, writer)) return;
+  writer.write_to(output);
+}
+
+#endif // ENABLE_CGAL
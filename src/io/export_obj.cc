@@ -33,24 +33,23 @@
 
 void export_obj(const shared_ptr<const Geometry>& geom, std::ostream& output)
 {
-  IndexedMesh mesh;
-  mesh.append_geometry(geom);
+  const auto mesh = IndexedMesh::fromGeometry(geom);
 
   output << "# OpenSCAD obj exporter\n";
 
-  size_t numverts = mesh.vertices.size();
-  const auto& v = mesh.vertices.getArray();
+  size_t numverts = mesh->vertices.size();
+  const auto& v = mesh->vertices.getArray();
   for (size_t i = 0; i < numverts; ++i) {
     output << "v " << v[i][0] << " " << v[i][1] << " " << v[i][2] << "\n";
   }
 
   size_t i = 0;
-  for (size_t j = 0; j < mesh.numfaces; ++j) {
+  for (size_t j = 0; j < mesh->numfaces; ++j) {
 
     output << "f ";
 
     while (true) {
-      auto index = mesh.indices[i++];
+      auto index = mesh->indices[i++];
       if (index < 0) {
         break;
       }
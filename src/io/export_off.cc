@@ -30,29 +30,95 @@
 #ifdef ENABLE_CGAL
 
 #include "IndexedMesh.h"
+#include "parallel.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Vertices or faces per task when formatting in parallel
+constexpr size_t itemsPerChunk = 1 << 14;
+
+// Appends v as ostream's default format writes it, six significant digits
+void append_double(std::string& out, double v)
+{
+  char buf[32];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  const size_t len = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, 6).ptr - buf;
+#else
+  const size_t len = std::min<size_t>(snprintf(buf, sizeof(buf), "%g", v), sizeof(buf) - 1);
+#endif
+  out.append(buf, len);
+}
+
+void append_int(std::string& out, size_t v)
+{
+  char buf[24];
+  out.append(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr - buf);
+}
+
+} // namespace
+
+/*!
+   Vertices and faces are formatted into strings in parallel chunks, which
+   are then written in order. The output is the same as written serially.
+ */
 void export_off(const shared_ptr<const Geometry>& geom, std::ostream& output)
 {
-  IndexedMesh mesh;
-  mesh.append_geometry(geom);
-
-  output << "OFF " << mesh.vertices.size() << " " << mesh.numfaces << " 0\n";
-  const auto& v = mesh.vertices.getArray();
-  size_t numverts = mesh.vertices.size();
-  for (size_t i = 0; i < numverts; ++i) {
-    output << v[i][0] << " " << v[i][1] << " " << v[i][2] << " " << "\n";
-  }
-  size_t cnt = 0;
-  for (size_t i = 0; i < mesh.numfaces; ++i) {
-    size_t nverts = 0;
-    while (mesh.indices[cnt++] != -1) nverts++;
-    output << nverts;
-    cnt -= nverts + 1;
-    for (size_t n = 0; n < nverts; ++n) output << " " << mesh.indices[cnt++];
-    output << "\n";
-    cnt++; // Skip the -1 marker
+  const auto mesh = IndexedMesh::fromGeometry(geom);
+
+  const auto& v = mesh->vertices.getArray();
+  const size_t numverts = mesh->vertices.size();
+
+  // Where each face starts in the -1 terminated indices
+  std::vector<size_t> face_starts;
+  face_starts.reserve(mesh->numfaces + 1);
+  face_starts.push_back(0);
+  for (size_t i = 0; i < mesh->indices.size(); ++i) {
+    if (mesh->indices[i] == -1) face_starts.push_back(i + 1);
   }
+  const size_t numfaces = face_starts.size() - 1;
+
+  const size_t vertex_chunks = (numverts + itemsPerChunk - 1) / itemsPerChunk;
+  const size_t face_chunks = (numfaces + itemsPerChunk - 1) / itemsPerChunk;
+  std::vector<size_t> chunks(vertex_chunks + face_chunks);
+  for (size_t i = 0; i < chunks.size(); ++i) chunks[i] = i;
+  std::vector<std::string> text(chunks.size());
+  parallelizable_transform(chunks.begin(), chunks.end(), text.begin(), [&](size_t chunk) {
+    std::string out;
+    if (chunk < vertex_chunks) {
+      const size_t end = std::min(numverts, (chunk + 1) * itemsPerChunk);
+      out.reserve((end - chunk * itemsPerChunk) * 48);
+      for (size_t i = chunk * itemsPerChunk; i < end; ++i) {
+        append_double(out, v[i][0]);
+        out += ' ';
+        append_double(out, v[i][1]);
+        out += ' ';
+        append_double(out, v[i][2]);
+        out += " \n";
+      }
+    } else {
+      chunk -= vertex_chunks;
+      const size_t end = std::min(numfaces, (chunk + 1) * itemsPerChunk);
+      out.reserve((end - chunk * itemsPerChunk) * 24);
+      for (size_t i = chunk * itemsPerChunk; i < end; ++i) {
+        append_int(out, face_starts[i + 1] - face_starts[i] - 1);
+        for (size_t n = face_starts[i]; n + 1 < face_starts[i + 1]; ++n) {
+          out += ' ';
+          append_int(out, mesh->indices[n]);
+        }
+        out += '\n';
+      }
+    }
+    return out;
+  });
 
+  output << "OFF " << numverts << " " << numfaces << " 0\n";
+  for (const auto& chunk : text) output.write(chunk.data(), chunk.size());
 }
 
 #endif // ENABLE_CGAL
@@ -1,113 +1,201 @@
 #include "export.h"
 #include "printutils.h"
 #include "OffscreenView.h"
+#include "Renderer.h"
 #include "CsgInfo.h"
+#include "imageutils.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <fstream>
 #include <memory>
+#include <vector>
 #include "RenderSettings.h"
 
+#ifdef ENABLE_TBB
+#include <tbb/task_group.h>
+#endif
+
 #ifndef NULLGL
 
 #ifdef ENABLE_CGAL
 #include "CGALRenderer.h"
+#ifdef ENABLE_OPENCSG
+#include "OpenCSGRenderer.h"
+#include <opencsg.h>
+#endif
+#include "ThrownTogetherRenderer.h"
 
-static void setupCamera(Camera& cam, const BoundingBox& bbox)
-{
-  if (cam.viewall) cam.viewAll(bbox);
-}
+namespace {
 
-bool export_png(const shared_ptr<const Geometry>& root_geom, const ViewOptions& options, Camera& camera, std::ostream& output)
+// Exports of the same image size share one view, so the GL context, the framebuffer
+// and the shader program are only set up once for animation frames, several views
+// and render server jobs.
+std::unique_ptr<OffscreenView> shared_view;
+
+OffscreenView *get_offscreen_view(const Camera& camera)
 {
-  PRINTD("export_png geom");
-  std::unique_ptr<OffscreenView> glview;
+  if (shared_view && shared_view->ctx->width() == camera.pixel_width &&
+      shared_view->ctx->height() == camera.pixel_height) {
+    return shared_view.get();
+  }
+  shared_view.reset();
+  Renderer::shareShaders(false);
   try {
-    glview = std::make_unique<OffscreenView>(camera.pixel_width, camera.pixel_height);
-  } catch (const OffscreenViewException &ex) {
-    fprintf(stderr, "Can't create OffscreenView: %s.\n", ex.what());
-    return false;
+    shared_view = std::make_unique<OffscreenView>(camera.pixel_width, camera.pixel_height);
+  } catch (const OffscreenViewException& ex) {
+    LOG("Can't create OffscreenView: %1$s.", ex.what());
+    return nullptr;
   }
-  CGALRenderer cgalRenderer(root_geom);
+  Renderer::shareShaders(true);
+  return shared_view.get();
+}
 
-  BoundingBox bbox = cgalRenderer.getBoundingBox();
-  setupCamera(camera, bbox);
+// Draws the renderer with the export options into the shared view
+OffscreenView *draw_png(Renderer& renderer, const ViewOptions& options, Camera& camera)
+{
+  OffscreenView *glview = get_offscreen_view(camera);
+  if (!glview) return nullptr;
 
+  if (camera.viewall) camera.viewAll(renderer.getBoundingBox());
   glview->setCamera(camera);
-  glview->setRenderer(&cgalRenderer);
+  glview->setRenderer(&renderer);
+#ifdef ENABLE_OPENCSG
+  OpenCSG::setContext(0);
+  OpenCSG::setOption(OpenCSG::OffscreenSetting, OpenCSG::FrameBufferObject);
+#endif
   glview->setColorScheme(RenderSettings::inst()->colorscheme);
-  glview->setShowFaces(!options["wireframe"]);
-  glview->setShowCrosshairs(options["crosshairs"]);
+  // Previews are always drawn with faces and without crosshairs
+  const bool preview = options.renderer == RenderType::OPENCSG || options.renderer == RenderType::THROWNTOGETHER;
+  glview->setShowFaces(preview || !options["wireframe"]);
+  glview->setShowCrosshairs(!preview && options["crosshairs"]);
   glview->setShowAxes(options["axes"]);
   glview->setShowScaleProportional(options["scales"]);
   glview->setShowEdges(options["edges"]);
   glview->paintGL();
-  glview->save(output);
-  return true;
+  glview->setRenderer(nullptr);
+  return glview;
 }
 
-#ifdef ENABLE_OPENCSG
-#include "OpenCSGRenderer.h"
-#include <opencsg.h>
+bool encode_png(const std::vector<uint8_t>& pixels, int width, int height, const std::string& filename)
+{
+  std::vector<uint8_t> flipped(pixels.size());
+  flip_image(pixels.data(), flipped.data(), 4, width, height);
+  std::ofstream output(filename, std::ios::out | std::ios::binary);
+  return output.is_open() && write_png(output, flipped.data(), width, height);
+}
+
+#ifdef ENABLE_TBB
+// Images encoded in the background, while the next ones are drawn
+tbb::task_group png_encoders;
+std::atomic<unsigned> png_pending{0};
+std::atomic<unsigned> png_failed{0};
 #endif
-#include "ThrownTogetherRenderer.h"
 
-std::unique_ptr<OffscreenView> prepare_preview(Tree& tree, const ViewOptions& options, Camera& camera)
+} // namespace
+
+std::unique_ptr<Renderer> prepare_png(const shared_ptr<const Geometry>& root_geom, const Camera& camera)
+{
+  PRINTD("prepare_png geom");
+  if (!get_offscreen_view(camera)) return nullptr;
+  return std::make_unique<CGALRenderer>(root_geom);
+}
+
+std::unique_ptr<Renderer> prepare_preview(Tree& tree, const ViewOptions& options, const Camera& camera)
 {
   PRINTD("prepare_preview_common");
   CsgInfo csgInfo = CsgInfo();
   csgInfo.compile_products(tree);
 
-  std::unique_ptr<OffscreenView> glview;
-  try {
-    glview = std::make_unique<OffscreenView>(camera.pixel_width, camera.pixel_height);
-  } catch (const OffscreenViewException &ex) {
-    LOG("Can't create OffscreenView: %1$s.", ex.what());
-    return nullptr;
-  }
-
-#ifdef ENABLE_OPENCSG
-  OpenCSGRenderer openCSGRenderer(csgInfo.root_products, csgInfo.highlights_products, csgInfo.background_products);
-#endif
-  ThrownTogetherRenderer thrownTogetherRenderer(csgInfo.root_products, csgInfo.highlights_products, csgInfo.background_products);
+  if (!get_offscreen_view(camera)) return nullptr;
 
   if (options.previewer == Previewer::OPENCSG) {
 #ifdef ENABLE_OPENCSG
-    glview->setRenderer(&openCSGRenderer);
+    auto renderer = std::make_unique<OpenCSGRenderer>(csgInfo.root_products, csgInfo.highlights_products, csgInfo.background_products);
+    const size_t limit = RenderSettings::inst()->openCSGTermLimit;
+    if (csgInfo.root_products && csgInfo.root_products->size() > limit) renderer->setBatchSize(limit);
+    return renderer;
 #else
     fprintf(stderr, "This openscad was built without OpenCSG support\n");
-    return 0;
+    return nullptr;
 #endif
-  } else {
-    glview->setRenderer(&thrownTogetherRenderer);
   }
-#ifdef ENABLE_OPENCSG
-  BoundingBox bbox = glview->getRenderer()->getBoundingBox();
-  setupCamera(camera, bbox);
+  return std::make_unique<ThrownTogetherRenderer>(csgInfo.root_products, csgInfo.highlights_products, csgInfo.background_products);
+}
 
-  glview->setCamera(camera);
-  OpenCSG::setContext(0);
-  OpenCSG::setOption(OpenCSG::OffscreenSetting, OpenCSG::FrameBufferObject);
+bool export_png(Renderer& renderer, const ViewOptions& options, Camera& camera, std::ostream& output)
+{
+  PRINTD("export_png");
+  OffscreenView *glview = draw_png(renderer, options, camera);
+  return glview && glview->save(output);
+}
+
+/*!
+   Only the drawing and reading back of the image use the OpenGL context, so
+   the image is encoded and written on a worker thread. The number of images
+   waiting to be encoded is bounded to limit the memory used.
+ */
+bool export_png(Renderer& renderer, const ViewOptions& options, Camera& camera, const std::string& filename)
+{
+  PRINTD("export_png async");
+  OffscreenView *glview = draw_png(renderer, options, camera);
+  if (!glview) return false;
+  const int width = glview->ctx->width();
+  const int height = glview->ctx->height();
+#ifdef ENABLE_TBB
+  if (png_pending >= 2 * parallel_threads()) png_encoders.wait();
+  png_pending++;
+  png_encoders.run([pixels = glview->ctx->getFramebuffer(), width, height, filename]() {
+    if (!encode_png(pixels, width, height, filename)) png_failed++;
+    png_pending--;
+  });
+  return true;
+#else
+  if (encode_png(glview->ctx->getFramebuffer(), width, height, filename)) return true;
+  LOG("Can't write PNG image \"%1$s\"", filename);
+  return false;
 #endif
-  glview->setColorScheme(RenderSettings::inst()->colorscheme);
-  glview->setShowAxes(options["axes"]);
-  glview->setShowScaleProportional(options["scales"]);
-  glview->setShowEdges(options["edges"]);
-  glview->paintGL();
-  return glview;
 }
 
-bool export_png(const OffscreenView& glview, std::ostream& output)
+bool export_rgba(Renderer& renderer, const ViewOptions& options, Camera& camera, std::ostream& output)
 {
-  PRINTD("export_png_preview_common");
-  glview.save(output);
+  PRINTD("export_rgba");
+  OffscreenView *glview = draw_png(renderer, options, camera);
+  if (!glview) return false;
+  const auto pixels = glview->ctx->getFramebuffer();
+  std::vector<uint8_t> flipped(pixels.size());
+  flip_image(pixels.data(), flipped.data(), 4, glview->ctx->width(), glview->ctx->height());
+  output.write(reinterpret_cast<const char *>(flipped.data()), flipped.size());
+  return output.good();
+}
+
+bool wait_png_exports()
+{
+#ifdef ENABLE_TBB
+  png_encoders.wait();
+  if (const unsigned failed = png_failed.exchange(0)) {
+    LOG("Failed to write %1$d PNG images", failed);
+    return false;
+  }
+#endif
   return true;
 }
 
+#else // ENABLE_CGAL
+
+bool wait_png_exports() { return true; }
+bool export_rgba(Renderer& renderer, const ViewOptions& options, Camera& camera, std::ostream& output) { return false; }
+
 #endif // ENABLE_CGAL
 
 #else // NULLGL
 
-bool export_png(const shared_ptr<const Geometry>& root_geom, const ViewOptions& options, Camera& camera, std::ostream& output) { return false; }
-std::unique_ptr<OffscreenView> prepare_preview(Tree& tree, const ViewOptions& options, Camera& camera) { return nullptr; }
-bool export_png(const OffscreenView& glview, std::ostream& output) { return false; }
+std::unique_ptr<Renderer> prepare_png(const shared_ptr<const Geometry>& root_geom, const Camera& camera) { return nullptr; }
+std::unique_ptr<Renderer> prepare_preview(Tree& tree, const ViewOptions& options, const Camera& camera) { return nullptr; }
+bool export_png(Renderer& renderer, const ViewOptions& options, Camera& camera, std::ostream& output) { return false; }
+bool export_png(Renderer& renderer, const ViewOptions& options, Camera& camera, const std::string& filename) { return false; }
+bool wait_png_exports() { return true; }
+bool export_rgba(Renderer& renderer, const ViewOptions& options, Camera& camera, std::ostream& output) { return false; }
 
 #endif // NULLGL
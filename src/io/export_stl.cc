@@ -27,8 +27,16 @@
 #include "export.h"
 #include "PolySet.h"
 #include "PolySetUtils.h"
+#include "parallel.h"
+#include <algorithm>
+#include <charconv>
+#include <sstream>
+#include <cstring>
+#include <string_view>
+#include <boost/predef.h>
 #ifdef ENABLE_MANIFOLD
 #include "ManifoldGeometry.h"
+#include "manifold.h"
 #endif
 
 #ifdef ENABLE_CGAL
@@ -39,123 +47,222 @@
 
 namespace {
 
-std::string toString(const Vector3d& v)
+/*!
+   Writes STL facets through a buffer, which is handed to the stream in large
+   blocks instead of a few bytes or a formatted number at a time.
+ */
+class StlWriter
 {
-  return STR(v[0], " ", v[1], " ", v[2]);
-}
+public:
+  StlWriter(std::ostream& output, bool binary) : output(output), binary(binary) {
+    buffer.reserve(bufferSize + 512);
+  }
+  ~StlWriter() { flush(); }
+  StlWriter(const StlWriter&) = delete;
+  StlWriter& operator=(const StlWriter&) = delete;
+
+  void triangle(const std::array<Vector3d, 3>& p) {
+    ++count;
+    if (binary) {
+      char facet[facetSize];
+      encodeBinary(p, facet);
+      put(facet, facetSize);
+    } else {
+      writeAscii(p);
+    }
+    if (buffer.size() >= bufferSize) flush();
+  }
 
-Vector3d toVector(const std::array<double, 3>& pt) {
-  return {pt[0], pt[1], pt[2]};
-}
+  /*!
+     Writes triangles get(0) to get(n - 1). Binary facets have a fixed size,
+     so blocks of them are encoded in parallel straight into the buffer.
+   */
+  template <typename Get>
+  void triangles(size_t n, const Get& get) {
+    if (!binary) {
+      for (size_t i = 0; i < n; ++i) triangle(get(i));
+      return;
+    }
+    flush();
+    std::vector<size_t> indices;
+    for (size_t begin = 0; begin < n; begin += facetsPerBlock) {
+      const size_t end = std::min(n, begin + facetsPerBlock);
+      indices.resize(end - begin);
+      for (size_t i = begin; i < end; ++i) indices[i - begin] = i;
+      buffer.resize(indices.size() * facetSize);
+      char *out = buffer.data();
+      std::vector<char> done(indices.size());
+      parallelizable_transform(indices.begin(), indices.end(), done.begin(), [&](size_t i) {
+        encodeBinary(get(i), out + (i - begin) * facetSize);
+        return char(1);
+      });
+      count += indices.size();
+      flush();
+    }
+  }
 
-Vector3d fromString(const std::string& vertexString)
-{
-  Vector3d v;
-  std::istringstream stream{vertexString};
-  stream >> v[0] >> v[1] >> v[2];
-  return v;
-}
+  void flush() {
+    output.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+
+  [[nodiscard]] uint64_t triangleCount() const { return count; }
+
+private:
+  static constexpr size_t bufferSize = 1 << 16;
+  static constexpr size_t facetSize = 50;
+  static constexpr size_t facetsPerBlock = 1 << 16;
+
+  void put(const char *s, size_t n) { buffer.insert(buffer.end(), s, s + n); }
+  void put(std::string_view s) { put(s.data(), s.size()); }
 
-void write_vector(std::ostream& output, const Vector3f& v) {
-  for (int i = 0; i < 3; ++i) {
+  static char *putFloats(const Vector3f& v, char *out) {
     static_assert(sizeof(float) == 4, "Need 32 bit float");
-    float f = v[i];
-    char *fbeg = reinterpret_cast<char *>(&f);
-    char data[4];
+    for (int i = 0; i < 3; ++i) {
+      std::memcpy(out, &v[i], 4);
+#if BOOST_ENDIAN_BIG_BYTE
+      std::reverse(out, out + 4);
+#endif
+      out += 4;
+    }
+    return out;
+  }
 
-    uint16_t test = 0x0001;
-    if (*reinterpret_cast<char *>(&test) == 1) {
-      std::copy(fbeg, fbeg + 4, data);
-    } else {
-      std::reverse_copy(fbeg, fbeg + 4, data);
+  // Same digits as the default ostream formatting, i.e. printf("%g")
+  static size_t format(char *out, size_t size, double v) {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    return std::to_chars(out, out + size, v, std::chars_format::general, 6).ptr - out;
+#else
+    return std::min<size_t>(snprintf(out, size, "%g", v), size - 1);
+#endif
+  }
+
+  static std::string_view formatVertex(char *out, size_t size, const Vector3d& v) {
+    size_t n = format(out, size, v[0]);
+    out[n++] = ' ';
+    n += format(out + n, size - n, v[1]);
+    out[n++] = ' ';
+    n += format(out + n, size - n, v[2]);
+    return {out, n};
+  }
+
+  static double parse(std::string_view s) {
+    double v = 0;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    std::from_chars(s.data(), s.data() + s.size(), v);
+#else
+    v = std::strtod(std::string(s).c_str(), nullptr);
+#endif
+    return v;
+  }
+
+  // The printed coordinates, read back as they would be on import
+  static Vector3d roundTrip(std::string_view vertex) {
+    Vector3d v;
+    for (int i = 0; i < 3; ++i) {
+      size_t end = std::min(vertex.find(' '), vertex.size());
+      v[i] = parse(vertex.substr(0, end));
+      vertex.remove_prefix(std::min(end + 1, vertex.size()));
     }
-    output.write(data, 4);
+    return v;
   }
-}
 
+  // Writes the 50 bytes of a binary facet to out
+  static void encodeBinary(const std::array<Vector3d, 3>& p, char *out) {
+    Vector3f p0 = p[0].cast<float>();
+    Vector3f p1 = p[1].cast<float>();
+    Vector3f p2 = p[2].cast<float>();
+
+    Vector3f normal(0, 0, 0);
+    // Ensure 3 distinct vertices.
+    if ((p0 != p1) && (p0 != p2) && (p1 != p2)) {
+      normal = (p1 - p0).cross(p2 - p0);
+      normal.normalize();
+      if (!is_finite(normal) || is_nan(normal)) {
+        // Collinear vertices.
+        normal << 0, 0, 0;
+      }
+    }
+    out = putFloats(normal, out);
+    out = putFloats(p0, out);
+    out = putFloats(p1, out);
+    out = putFloats(p2, out);
+    out[0] = out[1] = 0; // Attribute byte count
+  }
+
+  void writeAscii(const std::array<Vector3d, 3>& p) {
+    char text[3][128];
+    std::array<std::string_view, 3> vertexStrings;
+    for (int i = 0; i < 3; ++i) vertexStrings[i] = formatVertex(text[i], sizeof(text[i]), p[i]);
+
+    if (vertexStrings[0] != vertexStrings[1] &&
+        vertexStrings[0] != vertexStrings[2] &&
+        vertexStrings[1] != vertexStrings[2]) {
+
+      // The above condition ensures that there are 3 distinct
+      // vertices, but they may be collinear. If they are, the unit
+      // normal is meaningless so the default value of "0 0 0" can
+      // be used. If the vertices are not collinear then the unit
+      // normal must be calculated from the components.
+      put("  facet normal ");
+
+      Vector3d p0 = roundTrip(vertexStrings[0]);
+      Vector3d p1 = roundTrip(vertexStrings[1]);
+      Vector3d p2 = roundTrip(vertexStrings[2]);
+
+      Vector3d normal = (p1 - p0).cross(p2 - p0);
+      normal.normalize();
+      if (is_finite(normal) && !is_nan(normal)) {
+        char normalString[128];
+        put(formatVertex(normalString, sizeof(normalString), normal));
+        put("\n");
+      } else {
+        put("0 0 0\n");
+      }
+      put("    outer loop\n");
+
+      for (const auto& vertexString : vertexStrings) {
+        put("      vertex ");
+        put(vertexString);
+        put("\n");
+      }
+      put("    endloop\n");
+      put("  endfacet\n");
+    }
+  }
+
+  std::ostream& output;
+  bool binary;
+  std::vector<char> buffer;
+  uint64_t count{0};
+};
+
+Vector3d toVector(const std::array<double, 3>& pt) {
+  return {pt[0], pt[1], pt[2]};
+}
 
 uint64_t append_stl(const PolySet& ps, std::ostream& output, bool binary)
 {
-  uint64_t triangle_count = 0;
+  StlWriter writer(output, binary);
   PolySet triangulated(3);
   PolySetUtils::tessellate_faces(ps, triangulated);
 
-  auto processTriangle = [&](const std::array<Vector3d, 3>& p) {
-      triangle_count++;
-
-      if (binary) {
-        Vector3f p0 = p[0].cast<float>();
-        Vector3f p1 = p[1].cast<float>();
-        Vector3f p2 = p[2].cast<float>();
-
-        // Ensure 3 distinct vertices.
-        if ((p0 != p1) && (p0 != p2) && (p1 != p2)) {
-          Vector3f normal = (p1 - p0).cross(p2 - p0);
-          normal.normalize();
-          if (!is_finite(normal) || is_nan(normal)) {
-            // Collinear vertices.
-            normal << 0, 0, 0;
-          }
-          write_vector(output, normal);
-        }
-        write_vector(output, p0);
-        write_vector(output, p1);
-        write_vector(output, p2);
-        char attrib[2] = {0, 0};
-        output.write(attrib, 2);
-      } else { // ascii
-        std::array<std::string, 3> vertexStrings;
-        std::transform(p.cbegin(), p.cend(), vertexStrings.begin(),
-                       toString);
-
-        if (vertexStrings[0] != vertexStrings[1] &&
-            vertexStrings[0] != vertexStrings[2] &&
-            vertexStrings[1] != vertexStrings[2]) {
-
-          // The above condition ensures that there are 3 distinct
-          // vertices, but they may be collinear. If they are, the unit
-          // normal is meaningless so the default value of "0 0 0" can
-          // be used. If the vertices are not collinear then the unit
-          // normal must be calculated from the components.
-          output << "  facet normal ";
-
-          Vector3d p0 = fromString(vertexStrings[0]);
-          Vector3d p1 = fromString(vertexStrings[1]);
-          Vector3d p2 = fromString(vertexStrings[2]);
-
-          Vector3d normal = (p1 - p0).cross(p2 - p0);
-          normal.normalize();
-          if (is_finite(normal) && !is_nan(normal)) {
-            output << normal[0] << " " << normal[1] << " " << normal[2]
-                   << "\n";
-          } else {
-            output << "0 0 0\n";
-          }
-          output << "    outer loop\n";
-
-          for (const auto& vertexString : vertexStrings) {
-            output << "      vertex " << vertexString << "\n";
-          }
-          output << "    endloop\n";
-          output << "  endfacet\n";
-        }
-      }
-    };
-
   if (Feature::ExperimentalPredictibleOutput.is_enabled()) {
     Export::ExportMesh exportMesh { triangulated };
     exportMesh.foreach_triangle([&](const auto& pts) {
-        processTriangle({ toVector(pts[0]), toVector(pts[1]), toVector(pts[2]) });
+        writer.triangle({ toVector(pts[0]), toVector(pts[1]), toVector(pts[2]) });
         return true;
       });
   } else {
-    for (const auto& p : triangulated.polygons) {
+    const auto& polygons = triangulated.getPolygons();
+    writer.triangles(polygons.size(), [&polygons](size_t i) -> std::array<Vector3d, 3> {
+      const auto& p = polygons[i];
       assert(p.size() == 3); // STL only allows triangles
-      processTriangle({ p[0], p[1], p[2] });
-    }
+      return { p[0], p[1], p[2] };
+    });
   }
 
-  return triangle_count;
+  return writer.triangleCount();
 }
 
 /*!
@@ -210,19 +317,31 @@ uint64_t append_stl(const CGALHybridPolyhedron& hybrid, std::ostream& output,
 uint64_t append_stl(const ManifoldGeometry& mani, std::ostream& output,
                     bool binary)
 {
-  uint64_t triangle_count = 0;
   if (!mani.isManifold()) {
     LOG(message_group::Export_Warning, "Exported object may not be a valid 2-manifold and may need repair");
   }
 
-  auto ps = mani.toPolySet();
-  if (ps) {
-    triangle_count += append_stl(*ps, output, binary);
-  } else {
-    LOG(message_group::Export_Error, "Manifold->PolySet failed");
+  if (Feature::ExperimentalPredictibleOutput.is_enabled()) {
+    StlWriter writer(output, binary);
+    Export::ExportMesh exportMesh{mani};
+    exportMesh.foreach_triangle([&](const auto& pts) {
+        writer.triangle({ toVector(pts[0]), toVector(pts[1]), toVector(pts[2]) });
+        return true;
+      });
+    return writer.triangleCount();
   }
 
-  return triangle_count;
+  // Manifold meshes are triangulated already, so they can be written directly
+  const manifold::Mesh mesh = mani.getManifold().GetMesh();
+  StlWriter writer(output, binary);
+  writer.triangles(mesh.triVerts.size(), [&mesh](size_t i) -> std::array<Vector3d, 3> {
+    const auto& tv = mesh.triVerts[i];
+    return {
+      vector_convert<Vector3d>(mesh.vertPos[tv[0]]),
+      vector_convert<Vector3d>(mesh.vertPos[tv[1]]),
+      vector_convert<Vector3d>(mesh.vertPos[tv[2]]) };
+  });
+  return writer.triangleCount();
 }
 #endif
 
@@ -259,6 +378,15 @@ uint64_t append_stl(const shared_ptr<const Geometry>& geom, std::ostream& output
 void export_stl(const shared_ptr<const Geometry>& geom, std::ostream& output,
                 bool binary)
 {
+  // The triangle count is filled in at the start, so a binary STL to e.g. stdout is assembled in memory
+  if (binary && output.tellp() == std::ostream::pos_type(-1)) {
+    output.clear();
+    std::stringstream buffered;
+    export_stl(geom, buffered, binary);
+    output << buffered.rdbuf();
+    return;
+  }
+
   if (binary) {
     char header[80] = "OpenSCAD Model\n";
     output.write(header, sizeof(header));
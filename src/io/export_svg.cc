@@ -25,16 +25,110 @@
  */
 
 #include "export.h"
+#include "Feature.h"
 #include "PolySet.h"
+#include "TextWriter.h"
+#include "Grid.h"
 
-static void append_svg(const Polygon2d& poly, std::ostream& output)
+#include <charconv>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Wraps an angle difference into [-pi, pi]
+double wrap(double angle)
 {
+  return std::remainder(angle, 2 * M_PI);
+}
+
+/*!
+   Removes the points of an outline which are within GRID_FINE of the line
+   between the points kept before and after them. The first point is kept.
+   The directions from the last point kept which pass all points skipped
+   since are narrowed down as points are skipped, so the deviation doesn't
+   add up along gentle curves.
+ */
+std::vector<Vector2d> without_collinear(const std::vector<Vector2d>& vertices)
+{
+  const size_t n = vertices.size();
+  if (n <= 3) return vertices;
+  std::vector<Vector2d> result;
+  result.reserve(n);
+  result.push_back(vertices[0]);
+  double base = 0, low = 0, high = 0;
+  bool skipping = false;
+  for (size_t i = 1; i < n; ++i) {
+    const Vector2d d = vertices[i] - result.back();
+    const Vector2d next = vertices[(i + 1) % n] - result.back();
+    if (!skipping) {
+      base = std::atan2(d.y(), d.x());
+      low = -M_PI;
+      high = M_PI;
+    }
+    const double r = d.norm();
+    if (r > GRID_FINE) {
+      const double angle = wrap(std::atan2(d.y(), d.x()) - base);
+      const double spread = std::asin(GRID_FINE / r);
+      low = std::max(low, angle - spread);
+      high = std::min(high, angle + spread);
+    }
+    const double next_angle = wrap(std::atan2(next.y(), next.x()) - base);
+    // Only points on the way to the next one are skipped, keeping spikes
+    skipping = n - i + result.size() > 3 && low <= next_angle && next_angle <= high &&
+               next.norm() > r && d.dot(next - d) > 0;
+    if (!skipping) result.push_back(vertices[i]);
+  }
+  return result;
+}
+
+double parse(const char *begin, const char *end)
+{
+  double v = 0;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  std::from_chars(begin, end, v);
+#else
+  v = std::strtod(std::string(begin, end).c_str(), nullptr);
+#endif
+  return v;
+}
+
+/*!
+   Writes an outline with coordinates relative to the previous point. Each
+   offset is taken from where the offsets printed so far lead to, so their
+   rounding doesn't add up.
+ */
+void append_relative(const std::vector<Vector2d>& vertices, TextWriter& output)
+{
+  Vector2d pos(0, 0);
+  char text[32];
+  for (size_t idx = 0; idx < vertices.size(); ++idx) {
+    const Vector2d p(vertices[idx].x(), -vertices[idx].y());
+    output << (idx == 0 ? "M" : idx == 1 ? " l" : " ");
+    for (int i = 0; i < 2; ++i) {
+      const size_t len = TextWriter::format(text, sizeof(text), p[i] - pos[i] + 0.0); // No -0
+      pos[i] += parse(text, text + len);
+      if (i == 1) output << ',';
+      output << std::string_view(text, len);
+    }
+    if ((idx % 12) == 11) output << "\n";
+  }
+  output << " z\n";
+}
+
+void append_svg(const Polygon2d& poly, TextWriter& output)
+{
+  const bool compact = Feature::ExperimentalSvgCompact.is_enabled();
   output << "<path d=\"\n";
   for (const auto& o : poly.outlines()) {
     if (o.vertices.empty()) {
       continue;
     }
 
+    if (compact) {
+      append_relative(without_collinear(o.vertices), output);
+      continue;
+    }
     const Eigen::Vector2d& p0 = o.vertices[0];
     output << "M " << p0.x() << "," << -p0.y();
     for (unsigned int idx = 1; idx < o.vertices.size(); ++idx) {
@@ -50,7 +144,7 @@ static void append_svg(const Polygon2d& poly, std::ostream& output)
 
 }
 
-static void append_svg(const shared_ptr<const Geometry>& geom, std::ostream& output)
+void append_svg(const shared_ptr<const Geometry>& geom, TextWriter& output)
 {
   if (const auto geomlist = dynamic_pointer_cast<const GeometryList>(geom)) {
     for (const auto& item : geomlist->getChildren()) {
@@ -65,11 +159,11 @@ static void append_svg(const shared_ptr<const Geometry>& geom, std::ostream& out
   }
 }
 
-void export_svg(const shared_ptr<const Geometry>& geom, std::ostream& output)
+template <typename F>
+void write_svg(const BoundingBox& bbox, std::ostream& stream, F append)
 {
   setlocale(LC_NUMERIC, "C"); // Ensure radix is . (not ,) in output
 
-  BoundingBox bbox = geom->getBoundingBox();
   int minx = (int)floor(bbox.min().x());
   int miny = (int)floor(-bbox.max().y());
   int maxx = (int)ceil(bbox.max().x());
@@ -77,16 +171,42 @@ void export_svg(const shared_ptr<const Geometry>& geom, std::ostream& output)
   int width = maxx - minx;
   int height = maxy - miny;
 
-  output
-    << "<?xml version=\"1.0\" standalone=\"no\"?>\n"
-    << "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\" \"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n"
-    << "<svg width=\"" << width << "mm\" height=\"" << height
-    << "mm\" viewBox=\"" << minx << " " << miny << " " << width << " " << height
-    << "\" xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"
-    << "<title>OpenSCAD Model</title>\n";
+  {
+    TextWriter output(stream);
+    output
+      << "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+      << "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\" \"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n"
+      << "<svg width=\"" << width << "mm\" height=\"" << height
+      << "mm\" viewBox=\"" << minx << " " << miny << " " << width << " " << height
+      << "\" xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"
+      << "<title>OpenSCAD Model</title>\n";
 
-  append_svg(geom, output);
+    append(output);
 
-  output << "</svg>\n";
+    output << "</svg>\n";
+  }
   setlocale(LC_NUMERIC, ""); // Set default locale
 }
+
+} // namespace
+
+void export_svg(const shared_ptr<const Geometry>& geom, std::ostream& stream)
+{
+  write_svg(geom->getBoundingBox(), stream, [&geom](TextWriter& output) { append_svg(geom, output); });
+}
+
+/*!
+   Writes each layer as a group of its own, with the layer name as its id.
+ */
+void export_svg_layers(const ExportLayers& layers, std::ostream& stream)
+{
+  BoundingBox bbox;
+  for (const auto& layer : layers) bbox.extend(layer.second->getBoundingBox());
+  write_svg(bbox, stream, [&layers](TextWriter& output) {
+    for (const auto& layer : layers) {
+      output << "<g id=\"" << layer.first << "\">\n";
+      append_svg(*layer.second, output);
+      output << "</g>\n";
+    }
+  });
+}
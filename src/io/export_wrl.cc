@@ -31,8 +31,7 @@
 
 void export_wrl(const shared_ptr<const Geometry>& geom, std::ostream& output)
 {
-  IndexedMesh mesh;
-  mesh.append_geometry(geom);
+  const auto mesh = IndexedMesh::fromGeometry(geom);
 
   output << "#VRML V2.0 utf8\n\n";
 
@@ -50,8 +49,8 @@ void export_wrl(const shared_ptr<const Geometry>& geom, std::ostream& output)
   output << "creaseAngle 0.5\n\n";
 
   output << "coord Coordinate { point [\n";
-  const auto& v = mesh.vertices.getArray();
-  const size_t numverts = mesh.vertices.size();
+  const auto& v = mesh->vertices.getArray();
+  const size_t numverts = mesh->vertices.size();
   for (size_t i = 0; i < numverts; ++i) {
     output << v[i][0] << " " << v[i][1] << " " << v[i][2];
     if (i < numverts - 1) {
@@ -62,13 +61,13 @@ void export_wrl(const shared_ptr<const Geometry>& geom, std::ostream& output)
   output << "] }\n\n";
 
   output << "coordIndex [\n";
-  const size_t numindices = mesh.indices.size();
+  const size_t numindices = mesh->indices.size();
   for (size_t i = 0; i < numindices; ++i) {
-    output << mesh.indices[i];
+    output << mesh->indices[i];
     if (i < numindices - 1) {
       output << ",";
     }
-    if (mesh.indices[i] == -1) {
+    if (mesh->indices[i] == -1) {
       output << "\n";
     }
   }
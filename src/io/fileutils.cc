@@ -1,5 +1,6 @@
 #include "fileutils.h"
 #include "printutils.h"
+#include "StatCache.h"
 
 #include <boost/filesystem.hpp>
 namespace fs = boost::filesystem;
@@ -12,21 +13,20 @@ namespace fs = boost::filesystem;
 std::string lookup_file(const std::string& filename,
                         const std::string& path, const std::string& fallbackpath)
 {
-  std::string resultfile;
-  if (!filename.empty() && !fs::path(filename).is_absolute()) {
-    fs::path absfile;
-    if (!path.empty()) absfile = fs::absolute(fs::path(path) / filename);
+  if (filename.empty() || fs::path(filename).is_absolute()) return filename;
+
+  fs::path absfile;
+  if (!path.empty()) absfile = fs::absolute(fs::path(path) / filename);
+  const auto key = "lookup_file\n" + filename + "\n" + path + "\n" + fallbackpath;
+  const auto resultfile = StatCache::resolve(key, [&]() {
     fs::path absfile_fallback;
     if (!fallbackpath.empty()) absfile_fallback = fs::absolute(fs::path(fallbackpath) / filename);
-
-    if (!fs::exists(absfile) && fs::exists(absfile_fallback)) {
-      resultfile = absfile_fallback.string();
-      LOG(message_group::Deprecated, "Imported file (%1$s) found in document root instead of relative to the importing module. This behavior is deprecated", std::string(filename));
-    } else {
-      resultfile = absfile.string();
-    }
-  } else {
-    resultfile = filename;
+    if (!fs::exists(absfile) && fs::exists(absfile_fallback)) return absfile_fallback.string();
+    return absfile.string();
+  });
+  // Repeated for cached results too
+  if (resultfile != absfile.string()) {
+    LOG(message_group::Deprecated, "Imported file (%1$s) found in document root instead of relative to the importing module. This behavior is deprecated", std::string(filename));
   }
   return resultfile;
 }
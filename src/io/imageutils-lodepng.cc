@@ -1,4 +1,5 @@
 #include "imageutils.h"
+#include "Feature.h"
 #include "ext/lodepng/lodepng.h"
 #include <cstdio>
 #include <cstdlib>
@@ -14,6 +15,12 @@ bool write_png(std::ostream& output, unsigned char *pixels, int width, int heigh
   // some png renderers have different interpretations of alpha, so don't use it
   state.info_png.color.colortype = LCT_RGB;
   state.info_png.color.bitdepth = 8;
+  if (Feature::ExperimentalPngFast.is_enabled()) {
+    // Shorter matches in a smaller window, at the cost of larger files
+    state.encoder.zlibsettings.windowsize = 512;
+    state.encoder.zlibsettings.lazymatching = 0;
+    state.encoder.zlibsettings.nicematch = 32;
+  }
   unsigned err = lodepng::encode(dataout, pixels, width, height, state);
   if (err) return false;
   output.write(reinterpret_cast<const char *>(&dataout[0]), dataout.size());
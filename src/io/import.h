@@ -9,11 +9,15 @@ class PolySet *import_stl(const std::string& filename, const Location& loc);
 class PolySet *import_obj(const std::string& filename, const Location& loc);
 
 PolySet *import_off(const std::string& filename, const Location& loc);
+// The native format, see GeometryFile.h
+class Geometry *import_geom(const std::string& filename, const Location& loc);
 
 class Polygon2d *import_svg(double fn, double fs, double fa,
                             const std::string& filename,
                             const boost::optional<std::string>& id, const boost::optional<std::string>& layer,
                             const double dpi, const bool center, const Location& loc);
+// Drops the parsed SVG files kept by import_svg()
+void flush_svg_cache();
 
 #ifdef ENABLE_CGAL
 class CGAL_Nef_polyhedron *import_nef3(const std::string& filename, const Location& loc);
@@ -31,6 +31,49 @@
 #include "AST.h"
 
 #ifdef ENABLE_LIB3MF
+
+#ifdef ENABLE_CGAL
+#include "cgalutils.h"
+#endif
+
+#include <memory>
+#include <vector>
+
+using polysets_t = std::vector<std::unique_ptr<PolySet>>;
+
+/*!
+   Combines the objects of a file. The objects of a plate usually don't touch,
+   so only those with overlapping bounding boxes are united, the others are
+   concatenated.
+ */
+static Geometry *merge_3mf_objects(polysets_t& meshes)
+{
+  if (meshes.empty()) return new PolySet(3);
+  if (meshes.size() == 1) return meshes.front().release();
+
+  std::vector<BoundingBox> boxes;
+  boxes.reserve(meshes.size());
+  for (const auto& mesh : meshes) boxes.push_back(mesh->getBoundingBox());
+
+  auto *p = new PolySet(3);
+  for (const auto& cluster : GeometryUtils::clusterByBoundingBox(boxes)) {
+    if (cluster.size() == 1) {
+      p->append(std::move(*meshes[cluster.front()]));
+      continue;
+    }
+#ifdef ENABLE_CGAL
+    Geometry::Geometries children;
+    for (const auto i : cluster) {
+      children.push_back(std::make_pair(std::shared_ptr<const AbstractNode>(), std::shared_ptr<const Geometry>(std::move(meshes[i]))));
+    }
+    if (auto ps = CGALUtils::getGeometryAsPolySet(CGALUtils::applyUnion3D(children.begin(), children.end()))) {
+      p->append(*ps);
+    }
+#endif // ifdef ENABLE_CGAL
+  }
+  return p;
+}
+
 #ifndef LIB3MF_API_2
 #include <Model/COM/NMR_DLLInterfaces.h>
 #undef BOOL
@@ -50,12 +93,6 @@ const std::string get_lib3mf_version() {
   return OpenSCAD::get_version_string(header_version, runtime_version);
 }
 
-#ifdef ENABLE_CGAL
-#include "cgalutils.h"
-#endif
-
-using polysets_t = std::list<std::shared_ptr<PolySet>>;
-
 static Geometry *import_3mf_error(PLib3MFModel *model = nullptr, PLib3MFModelResourceIterator *object_it = nullptr, PolySet *mesh = nullptr, PolySet *mesh2 = nullptr)
 {
   if (model) {
@@ -175,7 +212,7 @@ Geometry *import_3mf(const std::string& filename, const Location& loc)
     }
 
     if (first_mesh) {
-      meshes.push_back(std::shared_ptr<PolySet>(p));
+      meshes.emplace_back(p);
     } else {
       first_mesh = p;
     }
@@ -185,28 +222,8 @@ Geometry *import_3mf(const std::string& filename, const Location& loc)
   lib3mf_release(object_it);
   lib3mf_release(model);
 
-  if (first_mesh == nullptr) {
-    return new PolySet(3);
-  } else if (meshes.empty()) {
-    return first_mesh;
-  } else {
-    PolySet *p = nullptr;
-#ifdef ENABLE_CGAL
-    Geometry::Geometries children;
-    children.push_back(std::make_pair(std::shared_ptr<AbstractNode>(), shared_ptr<const Geometry>(first_mesh)));
-    for (auto& meshe : meshes) {
-      children.push_back(std::make_pair(std::shared_ptr<AbstractNode>(), shared_ptr<const Geometry>(meshe)));
-    }
-    if (auto ps = CGALUtils::getGeometryAsPolySet(CGALUtils::applyUnion3D(children.begin(), children.end()))) {
-      p = new PolySet(*ps);
-    } else {
-      p = new PolySet(3);
-    }
-#else
-    p = new PolySet(3);
-#endif // ifdef ENABLE_CGAL
-    return p;
-  }
+  if (first_mesh) meshes.emplace(meshes.begin(), first_mesh);
+  return merge_3mf_objects(meshes);
 }
 
 #else // LIB3MF_API_2
@@ -234,23 +251,39 @@ const std::string get_lib3mf_version() {
   return OpenSCAD::get_version_string(header_version, runtime_version);
 }
 
-#ifdef ENABLE_CGAL
-#include "cgalutils.h"
-#endif
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "parallel.h"
+
+namespace {
 
-using polysets_t = std::list<std::shared_ptr<PolySet>>;
+// The file as seen by the reader's callbacks, which copy from the mapping as lib3mf reads
+struct MappedStream {
+  const char *data;
+  size_t size;
+  size_t pos;
+};
 
-static Geometry *import_3mf_error(PolySet *mesh = nullptr, PolySet *mesh2 = nullptr)
+void read_mapped(Lib3MF_uint64 buffer, Lib3MF_uint64 count, Lib3MF_pvoid user)
 {
-  if (mesh) {
-    delete mesh;
-  }
-  if (mesh2) {
-    delete mesh2;
-  }
-  return new PolySet(3);
+  auto *stream = static_cast<MappedStream *>(user);
+  const size_t n = std::min<size_t>(count, stream->size - stream->pos);
+  memcpy(reinterpret_cast<void *>(buffer), stream->data + stream->pos, n);
+  stream->pos += n;
+}
+
+void seek_mapped(Lib3MF_uint64 position, Lib3MF_pvoid user)
+{
+  auto *stream = static_cast<MappedStream *>(user);
+  stream->pos = std::min<size_t>(position, stream->size);
 }
 
+} // namespace
+
 Geometry *import_3mf(const std::string& filename, const Location& loc)
 {
   Lib3MF_uint32 interfaceVersionMajor, interfaceVersionMinor, interfaceVersionMicro;
@@ -294,8 +327,18 @@ Geometry *import_3mf(const std::string& filename, const Location& loc)
     return new PolySet(3);
   }
 
+  // Read from a memory map instead of a copy of the package, which would add to the model's memory
+  boost::interprocess::mapped_region region;
   try {
-    reader->ReadFromFile(filename);
+    boost::interprocess::file_mapping file(filename.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region(file, boost::interprocess::read_only).swap(region);
+  } catch (const boost::interprocess::interprocess_exception& e) {
+    LOG(message_group::Warning, "Could not read file '%1$s', import() at line %2$d: %3$s", filename.c_str(), loc.firstLine(), e.what());
+    return new PolySet(3);
+  }
+  MappedStream stream{static_cast<const char *>(region.get_address()), region.get_size(), 0};
+  try {
+    reader->ReadFromCallback(read_mapped, stream.size, seek_mapped, &stream);
   } catch (const Lib3MF::ELib3MFException& e) {
     LOG(message_group::Warning, "Could not read file '%1$s', import() at line %2$d: %3$s", filename.c_str(), loc.firstLine(), e.what());
     return new PolySet(3);
@@ -307,80 +350,64 @@ Geometry *import_3mf(const std::string& filename, const Location& loc)
     return new PolySet(3);
   }
 
-  PolySet *first_mesh = 0;
-  polysets_t meshes;
-  unsigned int mesh_idx = 0;
-  bool has_next = object_it->MoveNext();
-  while (has_next) {
-    Lib3MF::PMeshObject object;
-    try {
-      object = object_it->GetCurrentMeshObject();
-      if (!object) {
-        return import_3mf_error(first_mesh);
+  std::vector<Lib3MF::PMeshObject> objects;
+  try {
+    while (object_it->MoveNext()) {
+      Lib3MF::PMeshObject object = object_it->GetCurrentMeshObject();
+      if (!object || !object->GetVertexCount() || !object->GetTriangleCount()) {
+        return new PolySet(3);
       }
-    } catch (const Lib3MF::ELib3MFException& e) {
-      LOG(message_group::Error, e.what());
-      return import_3mf_error(first_mesh);
-    }
-
-    Lib3MF_uint64 vertex_count = object->GetVertexCount();
-    if (!vertex_count) {
-      return import_3mf_error(first_mesh);
+      PRINTDB("%s: mesh %d, vertex count: %lu, triangle count: %lu", filename.c_str() % objects.size() % object->GetVertexCount() % object->GetTriangleCount());
+      objects.push_back(object);
     }
-    Lib3MF_uint64 triangle_count = object->GetTriangleCount();
-    if (!triangle_count) {
-      return import_3mf_error(first_mesh);
-    }
-
-    PRINTDB("%s: mesh %d, vertex count: %lu, triangle count: %lu", filename.c_str() % mesh_idx % vertex_count % triangle_count);
-
-    PolySet *p = new PolySet(3);
-    p->reserve(triangle_count);
-    for (Lib3MF_uint64 idx = 0; idx < triangle_count; ++idx) {
-      Lib3MF::sTriangle triangle = object->GetTriangle(idx);
-      Lib3MF::sPosition vertex1, vertex2, vertex3;
-
-      vertex1 = object->GetVertex(triangle.m_Indices[0]);
-      vertex2 = object->GetVertex(triangle.m_Indices[1]);
-      vertex3 = object->GetVertex(triangle.m_Indices[2]);
+  } catch (const Lib3MF::ELib3MFException& e) {
+    LOG(message_group::Error, e.what());
+    return new PolySet(3);
+  }
 
-      p->append_poly(3);
-      p->append_vertex(vertex1.m_Coordinates[0], vertex1.m_Coordinates[1], vertex1.m_Coordinates[2]);
-      p->append_vertex(vertex2.m_Coordinates[0], vertex2.m_Coordinates[1], vertex2.m_Coordinates[2]);
-      p->append_vertex(vertex3.m_Coordinates[0], vertex3.m_Coordinates[1], vertex3.m_Coordinates[2]);
+  // Objects are converted in parallel. The model isn't safe to use from several
+  // threads, so only copying out its arrays in bulk is serialized.
+  std::mutex model_mutex;
+  std::atomic<bool> failed{false};
+  polysets_t meshes(objects.size());
+  std::vector<size_t> indices(objects.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::vector<char> done(indices.size());
+  parallelizable_transform(indices.begin(), indices.end(), done.begin(), [&](size_t i) {
+    std::vector<Lib3MF::sPosition> vertices;
+    std::vector<Lib3MF::sTriangle> triangles;
+    try {
+      std::lock_guard<std::mutex> lock(model_mutex);
+      objects[i]->GetVertices(vertices);
+      objects[i]->GetTriangleIndices(triangles);
+    } catch (const Lib3MF::ELib3MFException&) {
+      failed = true;
+      return 0;
     }
 
-    if (first_mesh) {
-      meshes.push_back(std::shared_ptr<PolySet>(p));
-    } else {
-      first_mesh = p;
+    auto p = std::make_unique<PolySet>(3);
+    p->reserve(triangles.size());
+    auto vertex = [&vertices](Lib3MF_uint32 index) {
+      const auto& coordinates = vertices[index].m_Coordinates;
+      return Vector3d(coordinates[0], coordinates[1], coordinates[2]);
+    };
+    for (const auto& triangle : triangles) {
+      const auto *v = triangle.m_Indices;
+      if (std::max({v[0], v[1], v[2]}) >= vertices.size()) {
+        failed = true;
+        return 0;
+      }
+      p->append_triangle(vertex(v[0]), vertex(v[1]), vertex(v[2]));
     }
-    mesh_idx++;
-    has_next = object_it->MoveNext();
-  }
-
-  if (first_mesh == 0) {
+    meshes[i] = std::move(p);
+    return 1;
+  });
+  if (failed) {
+    LOG(message_group::Error, "Invalid mesh in 3MF file '%1$s', import() at line %2$d", filename, loc.firstLine());
     return new PolySet(3);
-  } else if (meshes.empty()) {
-    return first_mesh;
-  } else {
-    PolySet *p = nullptr;
-#ifdef ENABLE_CGAL
-    Geometry::Geometries children;
-    children.push_back(std::make_pair(std::shared_ptr<const AbstractNode>(), shared_ptr<const Geometry>(first_mesh)));
-    for (polysets_t::iterator it = meshes.begin(); it != meshes.end(); ++it) {
-      children.push_back(std::make_pair(std::shared_ptr<const AbstractNode>(), shared_ptr<const Geometry>(*it)));
-    }
-    if (auto ps = CGALUtils::getGeometryAsPolySet(CGALUtils::applyUnion3D(children.begin(), children.end()))) {
-      p = new PolySet(*ps);
-    } else {
-      p = new PolySet(3);
-    }
-#else
-    p = new PolySet(3);
-#endif // ifdef ENABLE_CGAL
-    return p;
   }
+
+  return merge_3mf_objects(meshes);
 }
 
 #endif // LIB3MF_API_2
@@ -27,57 +27,115 @@
 #include "PolySet.h"
 #include "printutils.h"
 #include "AST.h"
+#include "parallel.h"
 
 #ifdef ENABLE_CGAL
 #include "cgalutils.h"
 #endif
 
 #include <sys/types.h>
-#include <map>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
 #include <fstream>
 #include <cassert>
+#include <string_view>
 #include <libxml/xmlreader.h>
 #include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
 
-static const std::string text_node("#text");
-static const std::string object("/amf/object");
-static const std::string coordinates("/amf/object/mesh/vertices/vertex/coordinates");
-static const std::string coordinates_x = coordinates + "/x";
-static const std::string coordinates_y = coordinates + "/y";
-static const std::string coordinates_z = coordinates + "/z";
-static const std::string triangle("/amf/object/mesh/volume/triangle");
-static const std::string triangle_v1 = triangle + "/v1";
-static const std::string triangle_v2 = triangle + "/v2";
-static const std::string triangle_v3 = triangle + "/v3";
+namespace {
+
+// The elements we read, all others are skipped with their content
+enum class Element {
+  Other, Amf, Object, Mesh, Vertices, Vertex, Coordinates, X, Y, Z, Volume, Triangle, V1, V2, V3
+};
+
+Element child_element(Element parent, std::string_view name)
+{
+  switch (parent) {
+  case Element::Other:       return Element::Other;
+  case Element::Amf:         if (name == "object") return Element::Object; break;
+  case Element::Object:      if (name == "mesh") return Element::Mesh; break;
+  case Element::Mesh:
+    if (name == "vertices") return Element::Vertices;
+    if (name == "volume") return Element::Volume;
+    break;
+  case Element::Vertices:    if (name == "vertex") return Element::Vertex; break;
+  case Element::Vertex:      if (name == "coordinates") return Element::Coordinates; break;
+  case Element::Coordinates:
+    if (name == "x") return Element::X;
+    if (name == "y") return Element::Y;
+    if (name == "z") return Element::Z;
+    break;
+  case Element::Volume:      if (name == "triangle") return Element::Triangle; break;
+  case Element::Triangle:
+    if (name == "v1") return Element::V1;
+    if (name == "v2") return Element::V2;
+    if (name == "v3") return Element::V3;
+    break;
+  default:
+    break;
+  }
+  return Element::Other;
+}
+
+std::string_view trim(std::string_view text)
+{
+  const auto begin = text.find_first_not_of(" \t\r\n");
+  if (begin == std::string_view::npos) return {};
+  return text.substr(begin, text.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+// Parses a whole number in place, like boost::lexical_cast
+bool parse_double(std::string_view token, double& value)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+  auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+  return result.ec == std::errc() && result.ptr == token.data() + token.size();
+#else
+  try {
+    value = boost::lexical_cast<double>(token.data(), token.size());
+    return true;
+  } catch (const boost::bad_lexical_cast&) {
+    return false;
+  }
+#endif
+}
+
+bool parse_index(std::string_view token, int& value)
+{
+  if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+  auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+  return result.ec == std::errc() && result.ptr == token.data() + token.size();
+}
+
+// Triangles per task when building the polygons of an object
+constexpr size_t trianglesPerChunk = 1 << 14;
+
+} // namespace
 
 class AmfImporter
 {
 private:
-  std::string xpath; // element nesting stack
-
-  using cb_func = void (*)(AmfImporter *, const xmlChar *);
+  std::vector<Element> elements; // element nesting stack
 
-  PolySet *polySet{nullptr};
   std::vector<PolySet *> polySets;
 
-  double x{0}, y{0}, z{0};
-  int idx_v1{0}, idx_v2{0}, idx_v3{0};
-  std::vector<Eigen::Vector3d> vertex_list;
-
-  std::map<const std::string, cb_func> funcs;
-  std::map<const std::string, cb_func> start_funcs;
-  std::map<const std::string, cb_func> end_funcs;
-
-  static void set_x(AmfImporter *importer, const xmlChar *value);
-  static void set_y(AmfImporter *importer, const xmlChar *value);
-  static void set_z(AmfImporter *importer, const xmlChar *value);
-  static void set_v1(AmfImporter *importer, const xmlChar *value);
-  static void set_v2(AmfImporter *importer, const xmlChar *value);
-  static void set_v3(AmfImporter *importer, const xmlChar *value);
-  static void start_object(AmfImporter *importer, const xmlChar *value);
-  static void end_object(AmfImporter *importer, const xmlChar *value);
-  static void end_triangle(AmfImporter *importer, const xmlChar *vlue);
-  static void end_vertex(AmfImporter *importer, const xmlChar *value);
+  // The indexed mesh of the object being read
+  std::vector<Vector3d> vertices;
+  std::vector<std::array<int, 3>> triangles;
+  Vector3d vertex;
+  std::array<int, 3> triangle;
+  size_t invalid_indices{0};
+  bool failed{false};
+
+  void start_element(Element element);
+  void end_element(Element element);
+  void text(Element element, std::string_view value);
+  void end_object();
 
   int streamFile(const char *filename);
   void processNode(xmlTextReaderPtr reader);
@@ -99,115 +157,130 @@ AmfImporter::AmfImporter(const Location& loc) : loc(loc)
 
 AmfImporter::~AmfImporter()
 {
-  delete polySet;
-}
-
-void AmfImporter::set_x(AmfImporter *importer, const xmlChar *value)
-{
-  importer->x = boost::lexical_cast<double>(std::string((const char *)value));
-}
-
-void AmfImporter::set_y(AmfImporter *importer, const xmlChar *value)
-{
-  importer->y = boost::lexical_cast<double>(std::string((const char *)value));
+  for (auto *ps : polySets) delete ps;
 }
 
-void AmfImporter::set_z(AmfImporter *importer, const xmlChar *value)
+void AmfImporter::start_element(Element element)
 {
-  importer->z = boost::lexical_cast<double>(std::string((const char *)value));
-}
-
-void AmfImporter::set_v1(AmfImporter *importer, const xmlChar *value)
-{
-  importer->idx_v1 = boost::lexical_cast<int>(std::string((const char *)value));
-}
-
-void AmfImporter::set_v2(AmfImporter *importer, const xmlChar *value)
-{
-  importer->idx_v2 = boost::lexical_cast<int>(std::string((const char *)value));
-}
-
-void AmfImporter::set_v3(AmfImporter *importer, const xmlChar *value)
-{
-  importer->idx_v3 = boost::lexical_cast<int>(std::string((const char *)value));
-}
-
-void AmfImporter::start_object(AmfImporter *importer, const xmlChar *)
-{
-  importer->polySet = new PolySet(3);
+  switch (element) {
+  case Element::Object:
+    vertices.clear();
+    triangles.clear();
+    break;
+  case Element::Coordinates:
+    vertex = Vector3d::Zero();
+    break;
+  case Element::Triangle:
+    triangle = {0, 0, 0};
+    break;
+  default:
+    break;
+  }
 }
 
-void AmfImporter::end_object(AmfImporter *importer, const xmlChar *)
+void AmfImporter::end_element(Element element)
 {
-  PRINTDB("AMF: add object %d", importer->polySets.size());
-  importer->polySets.push_back(importer->polySet);
-  importer->vertex_list.clear();
-  importer->polySet = nullptr;
+  switch (element) {
+  case Element::Object:
+    end_object();
+    break;
+  case Element::Coordinates:
+    vertices.push_back(vertex);
+    break;
+  case Element::Triangle:
+    triangles.push_back(triangle);
+    break;
+  default:
+    break;
+  }
 }
 
-void AmfImporter::end_vertex(AmfImporter *importer, const xmlChar *)
+void AmfImporter::text(Element element, std::string_view value)
 {
-  PRINTDB("AMF: add vertex %d - (%.2f, %.2f, %.2f)", importer->vertex_list.size() % importer->x % importer->y % importer->z);
-  importer->vertex_list.emplace_back(importer->x, importer->y, importer->z);
+  bool ok = true;
+  value = trim(value);
+  switch (element) {
+  case Element::X:  ok = parse_double(value, vertex[0]); break;
+  case Element::Y:  ok = parse_double(value, vertex[1]); break;
+  case Element::Z:  ok = parse_double(value, vertex[2]); break;
+  case Element::V1: ok = parse_index(value, triangle[0]); break;
+  case Element::V2: ok = parse_index(value, triangle[1]); break;
+  case Element::V3: ok = parse_index(value, triangle[2]); break;
+  default:
+    break;
+  }
+  if (!ok) failed = true;
 }
 
-void AmfImporter::end_triangle(AmfImporter *importer, const xmlChar *)
+/*!
+   The triangles of the object are resolved into polygons in parallel, and the
+   indexed mesh is released before the next object is read.
+ */
+void AmfImporter::end_object()
 {
-  int idx_v1 = importer->idx_v1;
-  int idx_v2 = importer->idx_v2;
-  int idx_v3 = importer->idx_v3;
-  PRINTDB("AMF: add triangle %d - (%.2f, %.2f, %.2f)", importer->vertex_list.size() % idx_v1 % idx_v2 % idx_v3);
-
-  std::vector<Eigen::Vector3d>& v = importer->vertex_list;
-
-  importer->polySet->append_poly(3);
-  importer->polySet->append_vertex(v[idx_v1].x(), v[idx_v1].y(), v[idx_v1].z());
-  importer->polySet->append_vertex(v[idx_v2].x(), v[idx_v2].y(), v[idx_v2].z());
-  importer->polySet->append_vertex(v[idx_v3].x(), v[idx_v3].y(), v[idx_v3].z());
+  PRINTDB("AMF: add object %d", polySets.size());
+  auto *ps = new PolySet(3);
+  auto& polygons = ps->mutablePolygons();
+  polygons.resize(triangles.size());
+  std::vector<size_t> chunks;
+  for (size_t i = 0; i < triangles.size(); i += trianglesPerChunk) chunks.push_back(i);
+  std::vector<size_t> invalid(chunks.size());
+  parallelizable_transform(chunks.begin(), chunks.end(), invalid.begin(), [&](size_t begin) {
+    size_t n = 0;
+    const size_t end = std::min(begin + trianglesPerChunk, triangles.size());
+    for (size_t i = begin; i < end; ++i) {
+      auto& poly = polygons[i];
+      for (const int index : triangles[i]) {
+        if (index >= 0 && index < static_cast<int>(vertices.size())) poly.push_back(vertices[index]);
+        else n++;
+      }
+    }
+    return n;
+  });
+  for (const auto n : invalid) invalid_indices += n;
+  // Drop the triangles which lost vertices
+  polygons.erase(std::remove_if(polygons.begin(), polygons.end(), [](const Polygon& poly) {
+    return poly.size() < 3;
+  }), polygons.end());
+  polySets.push_back(ps);
+  std::vector<Vector3d>().swap(vertices);
+  std::vector<std::array<int, 3>>().swap(triangles);
 }
 
 void AmfImporter::processNode(xmlTextReaderPtr reader)
 {
-  const char *name = reinterpret_cast<const char *>(xmlTextReaderName(reader));
-  if (name == nullptr) name = reinterpret_cast<const char *>(xmlStrdup(BAD_CAST "--"));
-  xmlChar *value = xmlTextReaderValue(reader);
-  int node_type = xmlTextReaderNodeType(reader);
-  switch (node_type) {
+  // The const accessors return strings owned by the reader, nothing is copied
+  switch (xmlTextReaderNodeType(reader)) {
   case XML_READER_TYPE_ELEMENT:
   {
-    xpath += '/';
-    xpath += name;
-    cb_func startFunc = start_funcs[xpath];
-    if (startFunc) {
-      PRINTDB("AMF: start %s", xpath);
-      startFunc(this, nullptr);
+    const auto *name = reinterpret_cast<const char *>(xmlTextReaderConstLocalName(reader));
+    const std::string_view local_name = name ? name : "";
+    const Element element = elements.empty()
+      ? (local_name == "amf" ? Element::Amf : Element::Other)
+      : child_element(elements.back(), local_name);
+    elements.push_back(element);
+    start_element(element);
+    // Empty elements like <x/> have no end element node
+    if (xmlTextReaderIsEmptyElement(reader)) {
+      end_element(element);
+      elements.pop_back();
     }
   }
   break;
   case XML_READER_TYPE_END_ELEMENT:
-  {
-    cb_func endFunc = end_funcs[xpath];
-    if (endFunc) {
-      PRINTDB("AMF: end   %s", xpath);
-      endFunc(this, value);
+    if (!elements.empty()) {
+      end_element(elements.back());
+      elements.pop_back();
     }
-    size_t pos = xpath.find_last_of('/');
-    if (pos != std::string::npos) xpath.erase(pos);
-  }
-  break;
+    break;
   case XML_READER_TYPE_TEXT:
-  {
-    cb_func textFunc = funcs[xpath];
-    if (textFunc) {
-      PRINTDB("AMF: text  %s - '%s'", xpath % value);
-      textFunc(this, value);
+  case XML_READER_TYPE_CDATA:
+    if (!elements.empty()) {
+      const auto *value = reinterpret_cast<const char *>(xmlTextReaderConstValue(reader));
+      if (value) text(elements.back(), value);
     }
+    break;
   }
-  break;
-  }
-
-  xmlFree(value);
-  xmlFree((void *) (name));
 }
 
 xmlTextReaderPtr AmfImporter::createXmlReader(const char *filename)
@@ -226,17 +299,14 @@ int AmfImporter::streamFile(const char *filename)
     return 1;
   }
 
-  try {
-    xmlTextReaderSetParserProp(reader, XML_PARSER_SUBST_ENTITIES, 1);
+  xmlTextReaderSetParserProp(reader, XML_PARSER_SUBST_ENTITIES, 1);
+  ret = xmlTextReaderRead(reader);
+  while (ret == 1 && !failed) {
+    processNode(reader);
     ret = xmlTextReaderRead(reader);
-    while (ret == 1) {
-      processNode(reader);
-      ret = xmlTextReaderRead(reader);
-    }
-    xmlFreeTextReader(reader);
-  } catch (boost::bad_lexical_cast&) {
-    ret = -1;
   }
+  xmlFreeTextReader(reader);
+  if (failed) ret = -1;
   if (ret != 0) {
     LOG(message_group::Warning, "Failed to parse file '%1$s', import() at line %2$d", filename, this->loc.firstLine());
   }
@@ -245,18 +315,10 @@ int AmfImporter::streamFile(const char *filename)
 
 PolySet *AmfImporter::read(const std::string& filename)
 {
-  funcs[coordinates_x] = set_x;
-  funcs[coordinates_y] = set_y;
-  funcs[coordinates_z] = set_z;
-  funcs[triangle_v1] = set_v1;
-  funcs[triangle_v2] = set_v2;
-  funcs[triangle_v3] = set_v3;
-  start_funcs[object] = start_object;
-  end_funcs[coordinates] = end_vertex;
-  end_funcs[triangle] = end_triangle;
-  end_funcs[object] = end_object;
   streamFile(filename.c_str());
-  vertex_list.clear();
+  if (invalid_indices) {
+    LOG(message_group::Warning, "%1$d triangle vertex indices out of range in AMF file '%2$s'", invalid_indices, filename);
+  }
 
   PolySet *p = nullptr;
 #ifdef ENABLE_CGAL
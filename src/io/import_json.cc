@@ -25,58 +25,117 @@
  */
 
 #include <fstream>
+#include <map>
+#include <vector>
 #include <json.hpp>
 
 #include "Value.h"
 #include "printutils.h"
 #include "EvaluationSession.h"
+#include "ImportCache.h"
 
 using json = nlohmann::json;
 
 namespace {
 
-ObjectType to_obj(const json& j, EvaluationSession *session);
-
-Value to_value(const json& j, EvaluationSession *session)
+/*!
+   Builds the Value directly from the parser events, without a json document.
+   Object members are sorted by key, the last of duplicate keys winning, as
+   they were when converting from the document.
+ */
+class ValueBuilder : public json::json_sax_t
 {
-  if (j.is_string()) {
-    return Value{j.get<std::string>()};
-  } else if (j.is_number()) {
-    return Value{j.get<double>()};
-  } else if (j.is_boolean()) {
-    return Value{j.get<bool>()};
-  } else if (j.is_object()) {
-    return Value{to_obj(j, session)};
-  } else if (j.is_array()) {
-    Value::VectorType vec{session};
-    for (const auto& elem : j) {
-      vec.emplace_back(to_value(elem, session));
-    }
-    return std::move(vec);
+public:
+  ValueBuilder(EvaluationSession *session) : session(session) {}
+
+  bool null() override { return add(Value::undefined.clone()); }
+  bool boolean(bool val) override { return add(Value{val}); }
+  bool number_integer(json::number_integer_t val) override { return add(Value{static_cast<double>(val)}); }
+  bool number_unsigned(json::number_unsigned_t val) override { return add(Value{static_cast<double>(val)}); }
+  bool number_float(json::number_float_t val, const json::string_t& /*s*/) override { return add(Value{val}); }
+  bool string(json::string_t& val) override { return add(Value{val}); }
+  bool binary(json::binary_t& /*val*/) override { return add(Value::undefined.clone()); }
+
+  bool start_object(std::size_t /*elements*/) override {
+    frames.emplace_back(session, true);
+    return true;
+  }
+  bool key(json::string_t& val) override {
+    frames.back().key = std::move(val);
+    return true;
+  }
+  bool end_object() override {
+    ObjectType obj{session};
+    for (auto& member : frames.back().members) obj.set(member.first, std::move(member.second));
+    frames.pop_back();
+    return add(Value{std::move(obj)});
   }
-  return Value::undefined.clone();
-}
 
-ObjectType to_obj(const json& j, EvaluationSession *session)
-{
-  ObjectType obj{session};
-  for (const auto& item : j.items()) {
-    obj.set(item.key(), to_value(item.value(), session));
+  bool start_array(std::size_t /*elements*/) override {
+    frames.emplace_back(session, false);
+    return true;
+  }
+  bool end_array() override {
+    Value vec{std::move(frames.back().vec)};
+    frames.pop_back();
+    return add(std::move(vec));
   }
-  return obj;
-}
+
+  bool parse_error(std::size_t /*position*/, const std::string& /*last_token*/, const json::exception& ex) override {
+    error = ex.what();
+    return false;
+  }
+
+  Value result = Value::undefined.clone();
+  std::string error;
+
+private:
+  struct Frame {
+    Frame(EvaluationSession *session, bool object) : object(object), vec(session) {}
+    bool object;
+    Value::VectorType vec;
+    std::string key;
+    std::map<std::string, Value> members;
+  };
+
+  bool add(Value&& value) {
+    if (frames.empty()) {
+      result = std::move(value);
+    } else if (frames.back().object) {
+      frames.back().members.insert_or_assign(frames.back().key, std::move(value));
+    } else {
+      frames.back().vec.emplace_back(std::move(value));
+    }
+    return true;
+  }
+
+  EvaluationSession *session;
+  std::vector<Frame> frames;
+};
 
 } // namespace
 
+/*!
+   The file is parsed as a stream into Values. Unchanged files are imported
+   once per evaluation session.
+ */
 Value import_json(const std::string& filename, EvaluationSession *session, const Location& loc)
 {
+  const std::string key = ImportCache::key(filename, "json");
+  if (!key.empty()) {
+    if (const auto cached = session->try_lookup_import(key)) return cached->clone();
+  }
+
   std::ifstream i(filename);
 
   try {
     if (i) {
-      json j;
-      i >> j;
-      return Value{to_value(j, session)};
+      ValueBuilder builder(session);
+      if (json::sax_parse(i, &builder)) {
+        if (!key.empty()) session->insert_import(key, builder.result.clone());
+        return std::move(builder.result);
+      }
+      LOG(message_group::Warning, loc, "", "Failed to parse file '%1$s': %s", filename, builder.error);
     } else {
       LOG(message_group::Warning, loc, "", "Could not read file '%1$s'", filename);
     }
@@ -85,4 +144,4 @@ Value import_json(const std::string& filename, EvaluationSession *session, const
   }
 
   return Value::undefined.clone();
-}
\ No newline at end of file
+}
@@ -1,92 +1,234 @@
 #include "import.h"
 #include "PolySet.h"
+#include "printutils.h"
+#include "AST.h"
+#include "parallel.h"
+
+#include <charconv>
 #include <fstream>
+#include <string_view>
 #include <vector>
-#include <boost/regex.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string.hpp>
-#include <boost/algorithm/string/split.hpp>
 
+namespace {
+
+// Parses a whole token as a double, like boost::lexical_cast
+bool parse_double(std::string_view token, double& value)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+  auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+  return result.ec == std::errc() && result.ptr == token.data() + token.size();
+#else
+  try {
+    value = boost::lexical_cast<double>(token.data(), token.size());
+    return true;
+  } catch (const boost::bad_lexical_cast&) {
+    return false;
+  }
+#endif
+}
+
+bool parse_int(std::string_view token, long& value)
+{
+  if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+  auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+  return result.ec == std::errc() && result.ptr == token.data() + token.size();
+}
+
+bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// Removes and returns the next whitespace separated token of line
+std::string_view next_token(std::string_view& line)
+{
+  size_t begin = 0;
+  while (begin < line.size() && is_space(line[begin])) ++begin;
+  size_t end = begin;
+  while (end < line.size() && !is_space(line[end])) ++end;
+  auto token = line.substr(begin, end - begin);
+  line.remove_prefix(end);
+  return token;
+}
+
+// Statements without geometry, or with geometry we don't import
+bool is_ignored(std::string_view keyword)
+{
+  return keyword == "vt" || keyword == "vn" || keyword == "vp" || keyword == "l" ||
+         keyword == "mtllib" || keyword == "usemtl" || keyword == "o" || keyword == "s" || keyword == "g";
+}
+
+struct Message {
+  size_t line; // Within the chunk, from 0
+  bool error;
+  std::string text;
+};
+
+struct FaceIndex {
+  long index; // Into all vertices if absolute, else into the vertices of the chunk
+  bool absolute;
+};
+
+// A run of whole lines, with vertex references resolved once all chunks are read
+struct Chunk {
+  std::string_view text;
+  std::vector<Vector3d> vertices;
+  std::vector<FaceIndex> indices;
+  std::vector<size_t> faces; // End of each face in indices
+  std::vector<Message> messages;
+  size_t lines{0};
+  bool failed{false};
+};
+
+void parse_chunk(Chunk& chunk)
+{
+  size_t pos = 0;
+  const auto& text = chunk.text;
+  while (pos < text.size() && !chunk.failed) {
+    size_t end = std::min(text.find('\n', pos), text.size());
+    auto line = text.substr(pos, end - pos);
+    pos = end + 1;
+    const size_t lineno = chunk.lines++;
+
+    auto rest = line;
+    const auto keyword = next_token(rest);
+    if (keyword.empty() || keyword[0] == '#') {
+      continue;
+    } else if (keyword == "v") {
+      // Optional w or vertex colors follow the coordinates
+      Vector3d v;
+      for (int i = 0; i < 3; ++i) {
+        if (!parse_double(next_token(rest), v[i])) {
+          chunk.messages.push_back({lineno, true, "can't parse vertex line '" + std::string(line) + "'"});
+          chunk.failed = true;
+          break;
+        }
+      }
+      chunk.vertices.push_back(v);
+    } else if (keyword == "f") {
+      for (auto word = next_token(rest); !word.empty(); word = next_token(rest)) {
+        // Only the vertex of v/vt/vn is used
+        long index;
+        if (!parse_int(word.substr(0, word.find('/')), index) || index == 0) {
+          chunk.messages.push_back({lineno, false, "Invalid face index '" + std::string(word) + "'"});
+          continue;
+        }
+        // Negative indices count back from the last vertex read
+        if (index > 0) chunk.indices.push_back({index - 1, true});
+        else chunk.indices.push_back({static_cast<long>(chunk.vertices.size()) + index, false});
+      }
+      chunk.faces.push_back(chunk.indices.size());
+    } else if (!is_ignored(keyword)) {
+      chunk.messages.push_back({lineno, false, "Unrecognized line '" + std::string(line) + "'"});
+    }
+  }
+}
+
+// Bytes per chunk parsed in parallel
+constexpr size_t bytesPerChunk = 1 << 22;
+
+} // namespace
+
+/*!
+   The file is memory mapped and split into chunks of whole lines, which are
+   parsed in parallel without copying lines. As faces may refer to vertices
+   relative to the last one read, the vertex indices are resolved once the
+   number of vertices in each chunk is known. Faces keep the file order.
+ */
 PolySet *import_obj(const std::string& filename, const Location& loc) {
   std::unique_ptr<PolySet> p = std::make_unique<PolySet>(3);
 
-  
-  std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary );
+  std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
   if (!f.good()) {
     LOG(message_group::Warning,
         "Can't open import file '%1$s', import() at line %2$d",
         filename, loc.firstLine());
     return p.release();
   }
-  std::vector<Vector3d> pts;
-  boost::regex ex_comment(R"(^\s*#)");
-  boost::regex ex_v( R"(^\s*v\s+([^\s]+)\s+([^\s]+)\s+([^\s]+)\s*$)");
-  boost::regex ex_f( R"(^\s*f\s+(.*)$)");
-  boost::regex ex_vt( R"(^\s*vt)");
-  boost::regex ex_vn( R"(^\s*vn)");
-  boost::regex ex_mtllib( R"(^\s*mtllib)");
-  boost::regex ex_usemtl( R"(^\s*usemtl)");
-  boost::regex ex_o( R"(^\s*o)");
-  boost::regex ex_s( R"(^\s*s)");
-  boost::regex ex_g( R"(^\s*g)");
-  int lineno = 1;
-  std::string line;
-
-  auto AsciiError = [&](const auto& errstr){
-    LOG(message_group::Error, loc, "",
-    "OBJ File line %1$s, %2$s line '%3$s' importing file '%4$s'",
-    lineno, errstr, line, filename);
-  };
-
-  while (!f.eof()) {
-    lineno++;
-    std::getline(f, line);
-    boost::trim(line);
-
-    boost::smatch results;
-    if (line.length() == 0 || boost::regex_search(line, ex_comment)) {
-      continue;
-    } else if (boost::regex_search(line, results, ex_v) && results.size() >= 4) {
-      try {
-	Vector3d v;
-        for (int i = 0; i < 3; i++) {
-          v[i]= boost::lexical_cast<double>(results[i + 1]); 
-        }
-        pts.push_back(v);
-      } catch (const boost::bad_lexical_cast& blc) {
-        AsciiError("can't parse vertex");
-        return new PolySet(3);
-      }
-    } else if (boost::regex_search(line, results, ex_f) && results.size() >= 2) {
-      std::string args=results[1];
-      std::vector<std::string> words;
-      boost::split(words, results[1], boost::is_any_of(" \t"));
-      p->append_poly(words.size());
-      for (const std::string& word : words) {
-        std::vector<std::string> wordindex;
-        boost::split(wordindex, word, boost::is_any_of("/"));
-	if(wordindex.size() < 1)
-          LOG(message_group::Warning, "Invalid Face index in File %1$s in Line %2$d", filename, lineno);
-	else {
-	  int ind=boost::lexical_cast<int>(wordindex[0]);
-          if(ind >= 1 && ind  <= pts.size()) {
-            p->append_vertex(pts[ind-1][0], pts[ind-1][1], pts[ind-1][2]);
-	  } else {  
-            LOG(message_group::Warning, "Index %1$d out of range in Line %2$d", filename, lineno);
-	  }
-	} 
+  const size_t file_size = f.tellg();
+  f.close();
+  if (file_size == 0) return p.release();
+
+  boost::interprocess::mapped_region region;
+  try {
+    boost::interprocess::file_mapping file(filename.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region(file, boost::interprocess::read_only).swap(region);
+  } catch (const boost::interprocess::interprocess_exception& e) {
+    LOG(message_group::Warning,
+        "Can't open import file '%1$s', import() at line %2$d",
+        filename, loc.firstLine());
+    return p.release();
+  }
+  const std::string_view text(static_cast<const char *>(region.get_address()), region.get_size());
+
+  std::vector<Chunk> chunks;
+  for (size_t begin = 0; begin < text.size();) {
+    size_t end = begin + bytesPerChunk < text.size() ? text.find('\n', begin + bytesPerChunk) : text.size();
+    end = end == std::string_view::npos ? text.size() : end + 1;
+    chunks.emplace_back();
+    chunks.back().text = text.substr(begin, end - begin);
+    begin = end;
+  }
+  std::vector<size_t> indices(chunks.size());
+  for (size_t i = 0; i < chunks.size(); ++i) indices[i] = i;
+  std::vector<char> done(chunks.size());
+  parallelizable_transform(indices.begin(), indices.end(), done.begin(), [&chunks](size_t i) {
+    parse_chunk(chunks[i]);
+    return char(1);
+  });
+
+  size_t lineno = 1, numvertices = 0, numfaces = 0;
+  std::vector<size_t> vertex_offsets, face_offsets;
+  for (const auto& chunk : chunks) {
+    for (const auto& message : chunk.messages) {
+      if (message.error) {
+        LOG(message_group::Error, loc, "", "OBJ File line %1$d, %2$s importing file '%3$s'",
+            lineno + message.line, message.text, filename);
+      } else {
+        LOG(message_group::Warning, "%1$s in line %2$d of OBJ file '%3$s'", message.text, lineno + message.line, filename);
       }
+    }
+    if (chunk.failed) return new PolySet(3);
+    lineno += chunk.lines;
+    vertex_offsets.push_back(numvertices);
+    face_offsets.push_back(numfaces);
+    numvertices += chunk.vertices.size();
+    numfaces += chunk.faces.size();
+  }
 
-    } else if (boost::regex_search(line, results, ex_vt)) { // ignore texture coords
-    } else if (boost::regex_search(line, results, ex_vn)) { // ignore normal coords
-    } else if (boost::regex_search(line, results, ex_mtllib)) { // ignore material lib
-    } else if (boost::regex_search(line, results, ex_usemtl)) { // ignore usemtl
-    } else if (boost::regex_search(line, results, ex_o)) { // ignore object name
-    } else if (boost::regex_search(line, results, ex_s)) { // ignore smooting
-    } else if (boost::regex_search(line, results, ex_g)) { // ignore group name
-    } else {
-      LOG(message_group::Warning, "Unrecognized Line  %1$s in line Line %2$d", line, lineno);
+  std::vector<Vector3d> vertices;
+  vertices.reserve(numvertices);
+  for (const auto& chunk : chunks) vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+
+  PolySet mesh(3);
+  auto& polygons = mesh.mutablePolygons();
+  polygons.resize(numfaces);
+  std::vector<size_t> out_of_range(chunks.size());
+  parallelizable_transform(indices.begin(), indices.end(), out_of_range.begin(), [&](size_t i) {
+    const auto& chunk = chunks[i];
+    size_t invalid = 0, begin = 0;
+    for (size_t face = 0; face < chunk.faces.size(); ++face) {
+      auto& poly = polygons[face_offsets[i] + face];
+      poly.reserve(chunk.faces[face] - begin);
+      for (size_t j = begin; j < chunk.faces[face]; ++j) {
+        const auto& index = chunk.indices[j];
+        const long vertex = index.absolute ? index.index : static_cast<long>(vertex_offsets[i]) + index.index;
+        if (vertex >= 0 && vertex < static_cast<long>(vertices.size())) poly.push_back(vertices[vertex]);
+        else invalid++;
+      }
+      begin = chunk.faces[face];
     }
+    return invalid;
+  });
+  size_t invalid = 0;
+  for (const auto n : out_of_range) invalid += n;
+  if (invalid) {
+    LOG(message_group::Warning, "%1$d face indices out of range in OBJ file '%2$s'", invalid, filename);
   }
+  p->append(std::move(mesh));
   return p.release();
 }
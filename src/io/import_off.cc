@@ -2,26 +2,216 @@
 #include "PolySet.h"
 #include "printutils.h"
 #include "AST.h"
-#ifdef ENABLE_CGAL
-#include "cgalutils.h"
+#include "parallel.h"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace {
+
+bool parse_double(std::string_view token, double& value)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+  auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+  return result.ec == std::errc() && result.ptr == token.data() + token.size();
+#else
+  try {
+    value = boost::lexical_cast<double>(token.data(), token.size());
+    return true;
+  } catch (const boost::bad_lexical_cast&) {
+    return false;
+  }
 #endif
+}
+
+bool parse_size(std::string_view token, size_t& value)
+{
+  auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+  return result.ec == std::errc() && result.ptr == token.data() + token.size();
+}
+
+bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// Removes and returns the next whitespace separated token of line
+std::string_view next_token(std::string_view& line)
+{
+  size_t begin = 0;
+  while (begin < line.size() && is_space(line[begin])) ++begin;
+  size_t end = begin;
+  while (end < line.size() && !is_space(line[end])) ++end;
+  auto token = line.substr(begin, end - begin);
+  line.remove_prefix(end);
+  return token;
+}
+
+/*!
+   Iterates over the lines with data, i.e. without comments and blank lines.
+ */
+class LineReader
+{
+public:
+  LineReader(std::string_view text, size_t pos = 0, size_t lineno = 0) : text(text), pos(pos), lineno(lineno) {}
+
+  bool next(std::string_view& line) {
+    while (pos < text.size()) {
+      const char *newline = static_cast<const char *>(std::memchr(text.data() + pos, '\n', text.size() - pos));
+      const size_t end = newline ? newline - text.data() : text.size();
+      line = text.substr(pos, end - pos);
+      pos = end + 1;
+      ++lineno;
+      line = line.substr(0, line.find('#'));
+      auto rest = line;
+      if (!next_token(rest).empty()) return true;
+    }
+    return false;
+  }
+
+  [[nodiscard]] size_t position() const { return std::min(pos, text.size()); }
+  [[nodiscard]] size_t line() const { return lineno; }
+
+private:
+  std::string_view text;
+  size_t pos;
+  size_t lineno;
+};
 
+// Data lines per task when parsing in parallel
+constexpr size_t linesPerChunk = 1 << 15;
+
+struct Chunk {
+  size_t pos;    // Byte offset of the chunk
+  size_t lineno; // Lines before the chunk
+  size_t first;  // Index of the first vertex or face
+  size_t count;
+};
+
+struct ChunkError {
+  size_t lineno{0};
+  std::string message;
+};
+
+} // namespace
+
+/*!
+   The file is memory mapped. After the header, one pass finds where each run
+   of vertex and face lines starts, and the runs are then parsed in parallel,
+   the vertices first. Face polygons are built directly from the vertices.
+
+   Colors or other data after the vertex coordinates and the face indices
+   are ignored.
+ */
 PolySet *import_off(const std::string& filename, const Location& loc)
 {
-  auto *p = new PolySet(3);
-#ifdef ENABLE_CGAL
-  CGAL_Polyhedron poly;
-  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
-  if (!file.good()) {
+  std::unique_ptr<PolySet> p = std::make_unique<PolySet>(3);
+
+  std::ifstream f(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+  if (!f.good()) {
     LOG(message_group::Warning, "Can't open import file '%1$s', import() at line %2$d", filename, loc.firstLine());
-  } else {
-    file >> poly;
-    file.close();
-    CGALUtils::createPolySetFromPolyhedron(poly, *p);
+    return p.release();
   }
-#else
-  LOG(message_group::Warning, "OFF import requires CGAL, import() at line %2$d", filename, loc.firstLine());
-#endif // ifdef ENABLE_CGAL
-  return p;
-}
+  const size_t file_size = f.tellg();
+  f.close();
+
+  boost::interprocess::mapped_region region;
+  if (file_size > 0) {
+    try {
+      boost::interprocess::file_mapping file(filename.c_str(), boost::interprocess::read_only);
+      boost::interprocess::mapped_region(file, boost::interprocess::read_only).swap(region);
+    } catch (const boost::interprocess::interprocess_exception& e) {
+      LOG(message_group::Warning, "Can't open import file '%1$s', import() at line %2$d", filename, loc.firstLine());
+      return p.release();
+    }
+  }
+  const std::string_view text(static_cast<const char *>(region.get_address()), region.get_size());
+
+  LineReader reader(text);
+  std::string_view line;
+  auto error = [&](size_t lineno, const std::string& message) {
+    LOG(message_group::Error, loc, "", "OFF File line %1$d, %2$s importing file '%3$s'", lineno, message, filename);
+    return new PolySet(3);
+  };
 
+  // Header: optional keyword (OFF, COFF, NOFF, STOFF...), then vertex, face and edge counts
+  if (!reader.next(line)) return error(reader.line(), "missing header");
+  auto rest = line;
+  auto token = next_token(rest);
+  if (token.size() >= 3 && token.substr(token.size() - 3) == "OFF") {
+    if (token.find_first_of("4n") != std::string_view::npos) return error(reader.line(), "only 3D OFF files are supported");
+    token = next_token(rest);
+    if (token.empty()) {
+      if (!reader.next(line)) return error(reader.line(), "missing vertex and face counts");
+      rest = line;
+      token = next_token(rest);
+    }
+  }
+  size_t numvertices, numfaces;
+  if (!parse_size(token, numvertices) || !parse_size(next_token(rest), numfaces)) {
+    return error(reader.line(), "can't parse vertex and face counts");
+  }
+  // Each vertex and face takes a line of its own
+  if (numvertices + numfaces > text.size() / 2) return error(reader.line(), "vertex and face counts exceed the file size");
+
+  // Find the runs of lines to parse in parallel, split where the faces start
+  std::vector<Chunk> vertex_chunks, face_chunks;
+  for (size_t n = 0; n < numvertices + numfaces; ++n) {
+    const size_t vertex_end = numvertices;
+    if (n < vertex_end && n % linesPerChunk == 0) vertex_chunks.push_back({reader.position(), reader.line(), n, std::min(linesPerChunk, vertex_end - n)});
+    if (n >= vertex_end && (n - vertex_end) % linesPerChunk == 0) face_chunks.push_back({reader.position(), reader.line(), n - vertex_end, std::min(linesPerChunk, numfaces - (n - vertex_end))});
+    if (!reader.next(line)) return error(reader.line(), n < numvertices ? "missing vertices" : "missing faces");
+  }
+
+  std::vector<Vector3d> vertices(numvertices);
+  std::vector<ChunkError> errors(vertex_chunks.size());
+  parallelizable_transform(vertex_chunks.begin(), vertex_chunks.end(), errors.begin(), [&](const Chunk& chunk) {
+    LineReader chunk_reader(text, chunk.pos, chunk.lineno);
+    std::string_view line;
+    for (size_t i = chunk.first; i < chunk.first + chunk.count; ++i) {
+      chunk_reader.next(line);
+      for (int j = 0; j < 3; ++j) {
+        if (!parse_double(next_token(line), vertices[i][j])) return ChunkError{chunk_reader.line(), "can't parse vertex"};
+      }
+    }
+    return ChunkError{};
+  });
+  for (const auto& e : errors) {
+    if (!e.message.empty()) return error(e.lineno, e.message);
+  }
+
+  PolySet mesh(3);
+  auto& polygons = mesh.mutablePolygons();
+  polygons.resize(numfaces);
+  errors.resize(face_chunks.size());
+  parallelizable_transform(face_chunks.begin(), face_chunks.end(), errors.begin(), [&](const Chunk& chunk) {
+    LineReader chunk_reader(text, chunk.pos, chunk.lineno);
+    std::string_view line;
+    for (size_t i = chunk.first; i < chunk.first + chunk.count; ++i) {
+      chunk_reader.next(line);
+      size_t count, index;
+      if (!parse_size(next_token(line), count)) return ChunkError{chunk_reader.line(), "can't parse face"};
+      auto& poly = polygons[i];
+      poly.resize(count);
+      for (size_t j = 0; j < count; ++j) {
+        if (!parse_size(next_token(line), index)) return ChunkError{chunk_reader.line(), "can't parse face"};
+        if (index >= vertices.size()) return ChunkError{chunk_reader.line(), "face index out of range"};
+        poly[j] = vertices[index];
+      }
+    }
+    return ChunkError{};
+  });
+  for (const auto& e : errors) {
+    if (!e.message.empty()) return error(e.lineno, e.message);
+  }
+
+  p->append(std::move(mesh));
+  return p.release();
+}
@@ -2,12 +2,17 @@
 #include "PolySet.h"
 #include "printutils.h"
 #include "AST.h"
+#include "parallel.h"
 
+#include <array>
+#include <charconv>
+#include <cstring>
 #include <fstream>
+#include <string_view>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/predef.h>
-#include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
-#include <boost/algorithm/string.hpp>
 
 #if !defined(BOOST_ENDIAN_BIG_BYTE_AVAILABLE) && !defined(BOOST_ENDIAN_LITTLE_BYTE_AVAILABLE)
 #error Byte order undefined or unknown. Currently only BOOST_ENDIAN_BIG_BYTE and BOOST_ENDIAN_LITTLE_BYTE are supported.
@@ -50,11 +55,8 @@ static void uint32_byte_swap(uint32_t& x) {
 }
 #endif // if BOOST_ENDIAN_BIG_BYTE
 
-static void read_stl_facet(std::ifstream& f, stl_facet& facet) {
-  f.read((char *)facet.data8, STL_FACET_NUMBYTES);
-  if (f.gcount() < STL_FACET_NUMBYTES) {
-    throw std::ios_base::failure("facet data truncated");
-  }
+static void read_stl_facet(const char *data, stl_facet& facet) {
+  memcpy(facet.data8, data, STL_FACET_NUMBYTES);
 #if BOOST_ENDIAN_BIG_BYTE
   for (int i = 0; i < 12; ++i) {
     uint32_byte_swap(facet.data8 + i * 4);
@@ -63,6 +65,67 @@ static void read_stl_facet(std::ifstream& f, stl_facet& facet) {
 #endif
 }
 
+namespace {
+
+// Parses a whole token as a double, like boost::lexical_cast
+bool parse_double(std::string_view token, double& value)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+  auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+  return result.ec == std::errc() && result.ptr == token.data() + token.size();
+#else
+  try {
+    value = boost::lexical_cast<double>(token.data(), token.size());
+    return true;
+  } catch (const boost::bad_lexical_cast&) {
+    return false;
+  }
+#endif
+}
+
+bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+std::string_view trim(std::string_view s)
+{
+  while (!s.empty() && is_space(s.front())) s.remove_prefix(1);
+  while (!s.empty() && is_space(s.back())) s.remove_suffix(1);
+  return s;
+}
+
+bool starts_with(std::string_view s, std::string_view prefix)
+{
+  return s.substr(0, prefix.size()) == prefix;
+}
+
+// Splits "vertex x y z" into the coordinate tokens. Fails unless there are exactly three.
+bool split_vertex(std::string_view line, std::array<std::string_view, 3>& tokens)
+{
+  line.remove_prefix(6); // "vertex"
+  if (line.empty() || !is_space(line.front())) return false;
+  for (auto& token : tokens) {
+    line = trim(line);
+    size_t end = 0;
+    while (end < line.size() && !is_space(line[end])) ++end;
+    if (end == 0) return false;
+    token = line.substr(0, end);
+    line.remove_prefix(end);
+  }
+  return trim(line).empty();
+}
+
+// Facets per task when reading binary files in parallel
+constexpr size_t facetsPerChunk = 1 << 14;
+
+} // namespace
+
+/*!
+   The file is memory mapped. Binary facets are read in place, in parallel
+   chunks, and ASCII files are parsed without a copy of each line.
+ */
 PolySet *import_stl(const std::string& filename, const Location& loc) {
   std::unique_ptr<PolySet> p = std::make_unique<PolySet>(3);
 
@@ -74,121 +137,115 @@ PolySet *import_stl(const std::string& filename, const Location& loc) {
         filename, loc.firstLine());
     return p.release();
   }
+  const size_t file_size = f.tellg();
+  f.close();
 
-  boost::regex ex_sfe(R"(^\s*solid|^\s*facet|^\s*endfacet)");
-  boost::regex ex_outer("^\\s*outer loop$");
-  boost::regex ex_loopend("^\\s*endloop$");
-  boost::regex ex_vertex("^\\s*vertex");
-  boost::regex ex_vertices(
-    R"(^\s*vertex\s+([^\s]+)\s+([^\s]+)\s+([^\s]+)\s*$)");
-  boost::regex ex_endsolid("^\\s*endsolid");
+  boost::interprocess::mapped_region region;
+  if (file_size > 0) {
+    try {
+      boost::interprocess::file_mapping file(filename.c_str(), boost::interprocess::read_only);
+      boost::interprocess::mapped_region(file, boost::interprocess::read_only).swap(region);
+    } catch (const boost::interprocess::interprocess_exception& e) {
+      LOG(message_group::Warning,
+          "Can't open import file '%1$s', import() at line %2$d",
+          filename, loc.firstLine());
+      return p.release();
+    }
+  }
+  const char *data = static_cast<const char *>(region.get_address());
+  const size_t size = region.get_size();
 
   bool binary = false;
-  std::streampos file_size = f.tellg();
-  f.seekg(80);
-  if (f.good() && !f.eof()) {
-    uint32_t facenum = 0;
-    f.read((char *)&facenum, sizeof(uint32_t));
+  uint32_t facenum = 0;
+  if (size >= 84) {
+    memcpy(&facenum, data + 80, sizeof(uint32_t));
 #if BOOST_ENDIAN_BIG_BYTE
     uint32_byte_swap(facenum);
 #endif
-    if (file_size == static_cast<std::streamoff>(80ul + 4ul + 50ul * facenum)) {
-      binary = true;
-      p->reserve(facenum);
-    }
+    binary = size == 80ul + 4ul + 50ul * facenum;
   }
-  f.seekg(0);
 
-  char data[5];
-  f.read(data, 5);
-  if (!binary && !f.eof() && f.good() && !memcmp(data, "solid", 5)) {
+  if (!binary && size >= 5 && !memcmp(data, "solid", 5)) {
     int i = 0;
     int lineno = 1;
     std::array<std::array<double, 3>, 3> vdata;
-    std::string line;
+    std::string_view line;
 
     auto AsciiError = [&](const auto& errstr){
         LOG(message_group::Error, loc, "",
             "STL line %1$s, %2$s line '%3$s' importing file '%4$s'",
-            lineno, errstr, line, filename);
+            lineno, errstr, std::string(line), filename);
       };
 
-    std::getline(f, line);
+    const std::string_view text(data, size);
+    // Skip the "solid" line
+    size_t pos = std::min(text.find('\n'), text.size());
     bool reached_end = false;
-    while (!f.eof()) {
+    while (pos < text.size()) {
+      ++pos;
+      size_t end = std::min(text.find('\n', pos), text.size());
       lineno++;
-      std::getline(f, line);
-      boost::trim(line);
-      boost::smatch results;
+      line = trim(text.substr(pos, end - pos));
+      pos = end;
 
-      if (line.length() == 0 || boost::regex_search(line, ex_sfe)) {
+      if (line.length() == 0 || starts_with(line, "solid") || starts_with(line, "facet") || starts_with(line, "endfacet")) {
         continue;
-      } else if (boost::regex_search(line, ex_outer)) {
+      } else if (line == "outer loop") {
         i = 0;
         continue;
-      } else if (boost::regex_search(line, ex_loopend)) {
+      } else if (line == "endloop") {
         if (i < 3) {
           AsciiError("missing vertex");
         }
         continue;
-      } else if (boost::regex_search(line, ex_endsolid)) {
+      } else if (starts_with(line, "endsolid")) {
         reached_end = true;
         break;
       } else if (i >= 3) {
         AsciiError("extra vertex");
         return new PolySet(3);
-      } else if (boost::regex_search(line, results, ex_vertices) &&
-                 results.size() >= 4) {
-        try {
-          for (int v = 0; v < 3; ++v) {
-            vdata.at(i).at(v) =
-              boost::lexical_cast<double>(results[v + 1]);
-          }
-          if (++i == 3) {
-            p->append_poly(3);
-            p->append_vertex(vdata[0][0], vdata[0][1], vdata[0][2]);
-            p->append_vertex(vdata[1][0], vdata[1][1], vdata[1][2]);
-            p->append_vertex(vdata[2][0], vdata[2][1], vdata[2][2]);
+      } else if (starts_with(line, "vertex")) {
+        std::array<std::string_view, 3> tokens;
+        if (!split_vertex(line, tokens)) continue;
+        for (int v = 0; v < 3; ++v) {
+          if (!parse_double(tokens[v], vdata[i][v])) {
+            AsciiError("can't parse vertex");
+            return new PolySet(3);
           }
-        } catch (const boost::bad_lexical_cast& blc) {
-          AsciiError("can't parse vertex");
-          return new PolySet(3);
+        }
+        if (++i == 3) {
+          p->append_poly(3);
+          p->append_vertex(vdata[0][0], vdata[0][1], vdata[0][2]);
+          p->append_vertex(vdata[1][0], vdata[1][1], vdata[1][2]);
+          p->append_vertex(vdata[2][0], vdata[2][1], vdata[2][2]);
         }
       }
     }
     if (!reached_end) {
       AsciiError("file incomplete");
     }
-  } else if (binary && !f.eof() && f.good()) {
-    try {
-      f.ignore(80 - 5 + 4);
-      while (!f.eof() ) {
-        stl_facet facet;
-        try {
-          read_stl_facet(f, facet);
-        } catch (const std::ios_base::failure& ex) {
-          if (f.eof()) break;
-          throw;
-        }
-        p->append_poly(3);
-        p->append_vertex(facet.data.x1, facet.data.y1, facet.data.z1);
-        p->append_vertex(facet.data.x2, facet.data.y2, facet.data.z2);
-        p->append_vertex(facet.data.x3, facet.data.y3, facet.data.z3);
+  } else if (binary) {
+    const char *facets = data + 84;
+    PolySet mesh(3);
+    auto& polygons = mesh.mutablePolygons();
+    polygons.resize(facenum);
+    std::vector<size_t> chunks;
+    for (size_t begin = 0; begin < facenum; begin += facetsPerChunk) chunks.push_back(begin);
+    std::vector<char> done(chunks.size());
+    parallelizable_transform(chunks.begin(), chunks.end(), done.begin(), [&](size_t begin) {
+      const size_t end = std::min<size_t>(begin + facetsPerChunk, facenum);
+      stl_facet facet;
+      for (size_t n = begin; n < end; ++n) {
+        read_stl_facet(facets + n * STL_FACET_NUMBYTES, facet);
+        polygons[n] = {
+          Vector3d(facet.data.x1, facet.data.y1, facet.data.z1),
+          Vector3d(facet.data.x2, facet.data.y2, facet.data.z2),
+          Vector3d(facet.data.x3, facet.data.y3, facet.data.z3)
+        };
       }
-    } catch (const std::ios_base::failure& ex) {
-      int64_t offset = -1;
-      try { offset = f.tellg(); } catch (...) {}
-      if (offset < 0) {
-        LOG(message_group::Error, loc, "",
-            "Binary STL '%1$s' error: %3$s",
-            filename, ex.what());
-      } else {
-        LOG(message_group::Error, loc, "",
-            "Binary STL '%1$s' error at byte %2$s: %3$s",
-            filename, offset, ex.what());
-      }
-      return new PolySet(3);
-    }
+      return char(1);
+    });
+    p->append(std::move(mesh));
   } else {
     LOG(message_group::Error, loc, "",
         "STL format not recognized in '%1$s'.", filename);
@@ -33,7 +33,13 @@
 #include "libsvg/libsvg.h"
 #include "libsvg/svgpage.h"
 #include "ClipperUtils.h"
+#include "ImportCache.h"
+#include "Cache.h"
 #include "AST.h"
+#include "parallel.h"
+
+#include <mutex>
+#include <sstream>
 
 namespace {
 
@@ -80,8 +86,36 @@ double calc_alignment(const libsvg::align_t alignment, double page_mm, double sc
   }
 }
 
+/*!
+   The shapes parsed from a file, with their paths flattened for the given
+   $fn, $fs and $fa, and excluded according to the id and layer selection.
+ */
+struct ParsedSvg {
+  shared_ptr<const libsvg::shapes_list_t> shapes;
+  bool matched;
+};
+
+// Parsed files, shared by the imports of a file differing only in dpi or center
+Cache<std::string, ParsedSvg> parsed_cache(32ul * 1024ul * 1024ul);
+std::mutex parsed_cache_mutex;
+
+size_t parsed_cost(const libsvg::shapes_list_t& shapes)
+{
+  size_t cost = sizeof(libsvg::shapes_list_t);
+  for (const auto& shape : shapes) {
+    cost += sizeof(libsvg::shape);
+    for (const auto& p : shape->get_path_list()) cost += p.size() * sizeof(Eigen::Vector3d);
+  }
+  return cost;
+}
+
 } // namespace
 
+void flush_svg_cache()
+{
+  std::lock_guard<std::mutex> lock(parsed_cache_mutex);
+  parsed_cache.clear();
+}
 
 Polygon2d *import_svg(double fn, double fs, double fa,
                       const std::string& filename,
@@ -124,8 +158,29 @@ Polygon2d *import_svg(double fn, double fs, double fa,
       match_args += "layer = \"" + layer.get() + "\"";
     }
 
-    const auto shapes = libsvg::libsvg_read_file(filename.c_str(), (void *) &scadContext);
-    if (!match_args.empty() && !scadContext.has_matches()) {
+    std::ostringstream parameters;
+    parameters.precision(17);
+    parameters << "svg " << fn << " " << fs << " " << fa << " " << id.value_or("") << " " << layer.value_or("");
+    const std::string key = ImportCache::key(filename, parameters.str());
+    ParsedSvg parsed;
+    bool cached = false;
+    if (!key.empty()) {
+      std::lock_guard<std::mutex> lock(parsed_cache_mutex);
+      if (const auto entry = parsed_cache[key]) {
+        parsed = *entry;
+        cached = true;
+      }
+    }
+    if (!cached) {
+      parsed.shapes.reset(libsvg::libsvg_read_file(filename.c_str(), (void *) &scadContext), libsvg::libsvg_free);
+      parsed.matched = scadContext.has_matches();
+      if (!key.empty()) {
+        std::lock_guard<std::mutex> lock(parsed_cache_mutex);
+        parsed_cache.insert(key, new ParsedSvg(parsed), key.size() + parsed_cost(*parsed.shapes));
+      }
+    }
+    const auto& shapes = parsed.shapes;
+    if (!match_args.empty() && !parsed.matched) {
       LOG(message_group::Warning, loc, "", "import() filter %2$s did not match anything", filename, match_args);
     }
 
@@ -188,26 +243,37 @@ Polygon2d *import_svg(double fn, double fs, double fa,
     double cx = center ? bbox.center().x() : -align.x();
     double cy = center ? bbox.center().y() : height_mm - align.y();
 
-    std::vector<const Polygon2d *> polygons;
+    std::vector<const libsvg::shape *> included;
     for (const auto& shape_ptr : *shapes) {
-      if (!shape_ptr->is_excluded()) {
-        auto *poly = new Polygon2d();
-        const auto& s = *shape_ptr;
-        for (const auto& p : s.get_path_list()) {
-          Outline2d outline;
-          for (const auto& v : p) {
-            double x = scale.x() * (-viewbox.x() + v.x()) - cx;
-            double y = scale.y() * (-viewbox.y() - v.y()) + cy;
-            outline.vertices.push_back(Vector2d(x, y));
-            outline.positive = true;
-          }
-          poly->addOutline(outline);
+      if (!shape_ptr->is_excluded()) included.push_back(shape_ptr.get());
+    }
+    std::vector<Polygon2d> polygons(included.size());
+    parallelizable_transform(included.begin(), included.end(), polygons.begin(), [&](const libsvg::shape *s) {
+      Polygon2d poly;
+      for (const auto& p : s->get_path_list()) {
+        Outline2d outline;
+        outline.vertices.reserve(p.size());
+        for (const auto& v : p) {
+          double x = scale.x() * (-viewbox.x() + v.x()) - cx;
+          double y = scale.y() * (-viewbox.y() - v.y()) + cy;
+          outline.vertices.emplace_back(x, y);
         }
-        polygons.push_back(poly);
+        poly.addOutline(outline);
       }
-    }
-    libsvg_free(shapes);
-    return ClipperUtils::apply(polygons, ClipperLib::ctUnion);
+      return poly;
+    });
+
+    // Shapes are sanitized in parallel at a common scale, then united at once
+    BoundingBox bounds;
+    for (const auto& poly : polygons) bounds.extend(poly.getBoundingBox());
+    const int pow2 = ClipperUtils::getScalePow2(bounds);
+    std::vector<ClipperLib::Paths> pathsvector(polygons.size());
+    parallelizable_transform(polygons.begin(), polygons.end(), pathsvector.begin(), [pow2](const Polygon2d& poly) {
+      ClipperLib::Paths paths;
+      ClipperLib::PolyTreeToPaths(ClipperUtils::sanitize(ClipperUtils::fromPolygon2d(poly, pow2)), paths);
+      return paths;
+    });
+    return ClipperUtils::apply(pathsvector, ClipperLib::ctUnion, pow2);
   } catch (const std::exception& e) {
     LOG(message_group::Error, "%1$s, import() at line %2$d", e.what(), loc.firstLine());
     return new Polygon2d();
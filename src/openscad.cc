@@ -41,12 +41,37 @@
 #include "LibraryInfo.h"
 #include "StackCheck.h"
 #include "FontCache.h"
+#include "StatCache.h"
+#include "progress.h"
+#include "parallel.h"
+#ifdef ENABLE_MICROBENCHMARKS
+#include "MicroBenchmark.h"
+#endif
 #include "OffscreenView.h"
+#include "Renderer.h"
 #include "GeometryEvaluator.h"
+#include "GeometryDiskCache.h"
+#include "GeometryRemoteCache.h"
+#include "SourceFileDiskCache.h"
 #include "RenderStatistic.h"
+#include "NodeProfiler.h"
+#include "CacheMissRecorder.h"
+#include "MemoryLimit.h"
+#include "EvalProfiler.h"
+#include "BackendBenchmark.h"
+#include "SubtreeDistribution.h"
 #include "ParameterObject.h"
 #include "ParameterSet.h"
+#include "PolySetUtils.h"
+#include "Polygon2d.h"
 #include "openscad_mimalloc.h"
+#include "OffscreenContextFactory.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <fstream>
@@ -62,6 +87,7 @@
 
 #include "Camera.h"
 #include <chrono>
+#include <json.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/bind/bind.hpp>
@@ -70,6 +96,11 @@
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
 
+#ifdef ENABLE_TBB
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#endif
+
 #ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
@@ -105,6 +136,21 @@ using boost::is_any_of;
 std::string commandline_commands;
 static bool arg_info = false;
 static std::string arg_colorscheme;
+static std::string arg_profile_trace;
+static std::string arg_profile_eval;
+static bool arg_benchmark_backends = false;
+static std::string arg_benchmark_backends_file;
+static std::vector<std::string> arg_distribute;
+static double arg_distribute_min_cost = 1000;
+static bool arg_export_split = false;
+static bool arg_deps_only = false;
+static std::vector<double> arg_slice_heights;
+static bool arg_slice_single_file = false;
+static DecimationOptions arg_decimation;
+// Set by the batch mode, which waits for the exports of a job while running the next one
+static bool background_exports = false;
+static std::vector<std::future<bool>> pending_exports;
+static std::mutex pending_exports_mutex;
 
 class Echostream
 {
@@ -202,50 +248,70 @@ void localization_init() {
   }
 }
 
-Camera get_camera(const po::variables_map& vm)
+// Sets up the camera from one view of --camera
+void setup_camera(Camera& camera, const std::string& view)
 {
-  Camera camera;
-
-  if (vm.count("camera")) {
-    vector<string> strs;
-    vector<double> cam_parameters;
-    boost::split(strs, vm["camera"].as<string>(), is_any_of(","));
-    if (strs.size() == 6 || strs.size() == 7) {
-      try {
-        for (const auto& s : strs) {
-          cam_parameters.push_back(lexical_cast<double>(s));
-        }
-        camera.setup(cam_parameters);
-      } catch (bad_lexical_cast&) {
-        LOG("Camera setup requires numbers as parameters");
+  vector<string> strs;
+  vector<double> cam_parameters;
+  boost::split(strs, view, is_any_of(","));
+  if (strs.size() == 6 || strs.size() == 7) {
+    try {
+      for (const auto& s : strs) {
+        cam_parameters.push_back(lexical_cast<double>(s));
       }
-    } else {
-      LOG("Camera setup requires either 7 numbers for Gimbal Camera or 6 numbers for Vector Camera");
-      exit(1);
+      camera.setup(cam_parameters);
+    } catch (bad_lexical_cast&) {
+      LOG("Camera setup requires numbers as parameters");
     }
   } else {
-    camera.viewall = true;
-    camera.autocenter = true;
+    LOG("Camera setup requires either 7 numbers for Gimbal Camera or 6 numbers for Vector Camera");
+    exit(1);
   }
+}
 
-  if (vm.count("viewall")) {
-    camera.viewall = true;
+/*!
+   Returns the cameras of image exports, one for each view given to --camera
+   separated by ';', or a single one fitting the whole design.
+ */
+std::vector<Camera> get_cameras(const po::variables_map& vm)
+{
+  std::vector<Camera> cameras;
+
+  if (vm.count("camera")) {
+    vector<string> views;
+    boost::split(views, vm["camera"].as<string>(), is_any_of(";"));
+    for (const auto& view : views) {
+      cameras.emplace_back();
+      setup_camera(cameras.back(), view);
+    }
+  } else {
+    cameras.emplace_back();
+    cameras.back().viewall = true;
+    cameras.back().autocenter = true;
   }
 
-  if (vm.count("autocenter")) {
-    camera.autocenter = true;
+  for (auto& camera : cameras) {
+    if (vm.count("viewall")) {
+      camera.viewall = true;
+    }
+
+    if (vm.count("autocenter")) {
+      camera.autocenter = true;
+    }
   }
 
   if (vm.count("projection")) {
     auto proj = vm["projection"].as<string>();
+    auto projection = Camera::ProjectionType::PERSPECTIVE;
     if (proj == "o" || proj == "ortho" || proj == "orthogonal") {
-      camera.projection = Camera::ProjectionType::ORTHOGONAL;
+      projection = Camera::ProjectionType::ORTHOGONAL;
     } else if (proj == "p" || proj == "perspective") {
-      camera.projection = Camera::ProjectionType::PERSPECTIVE;
+      projection = Camera::ProjectionType::PERSPECTIVE;
     } else {
       LOG("projection needs to be 'o' or 'p' for ortho or perspective\n");
       exit(1);
     }
+    for (auto& camera : cameras) camera.projection = projection;
   }
 
   auto w = RenderSettings::inst()->img_width;
@@ -265,10 +331,12 @@ Camera get_camera(const po::variables_map& vm)
       }
     }
   }
-  camera.pixel_width = w;
-  camera.pixel_height = h;
+  for (auto& camera : cameras) {
+    camera.pixel_width = w;
+    camera.pixel_height = h;
+  }
 
-  return camera;
+  return cameras;
 }
 
 #ifndef OPENSCAD_NOGUI
@@ -276,7 +344,8 @@ Camera get_camera(const po::variables_map& vm)
 #define OPENSCAD_QTGUI 1
 #endif
 static bool checkAndExport(const shared_ptr<const Geometry>& root_geom, unsigned nd,
-                           FileFormat format, const bool is_stdout, const std::string& filename)
+                           FileFormat format, const bool is_stdout, const std::string& filename,
+                           bool background = false)
 {
   if (root_geom->getDimension() != nd) {
     LOG("Current top level object is not a %1$dD object.", nd);
@@ -292,7 +361,14 @@ static bool checkAndExport(const shared_ptr<const Geometry>& root_geom, unsigned
   exportInfo.name2open = filename;
   exportInfo.name2display = filename;
   exportInfo.useStdOut = is_stdout;
+  exportInfo.decimation = arg_decimation;
 
+  if (background && !is_stdout) {
+    auto written = exportFileByNameInBackground(root_geom, exportInfo);
+    std::lock_guard<std::mutex> lock(pending_exports_mutex);
+    pending_exports.push_back(std::move(written));
+    return true;
+  }
   exportFileByName(root_geom, exportInfo);
   return true;
 }
@@ -327,11 +403,17 @@ struct CommandLine
   const std::string& parameterFile;
   const std::string& setName;
   const ViewOptions& viewOptions;
-  const Camera& camera;
+  // One for each image to export, the first one goes to output_file
+  const std::vector<Camera>& cameras;
   const boost::optional<FileFormat> export_format;
   unsigned animate_frames;
+  unsigned jobs;
   const std::vector<std::string> summaryOptions;
   const std::string summaryFile;
+  // Further outputs written from the same evaluation, see export_geometry()
+  std::vector<std::string> more_output_files{};
+  // Keys of the subtrees a worker evaluates into the caches instead of exporting, see SubtreeDistribution
+  std::vector<std::string> subtrees{};
 };
 
 struct RenderVariables
@@ -341,47 +423,122 @@ struct RenderVariables
 };
 
 int do_export(const CommandLine& cmd, const RenderVariables& render_variables, FileFormat curFormat, SourceFile *root_file);
+int export_design(const CommandLine& cmd, FileFormat export_format, SourceFile *root_file);
+std::shared_ptr<const AbstractNode> instantiate_root(const CommandLine& cmd, const RenderVariables& render_variables, SourceFile *root_file, Camera& camera);
+int export_geometry(const CommandLine& cmd, FileFormat curFormat, Tree& tree, Camera camera);
+int export_parameter_sets(const CommandLine& cmd, const std::vector<const ParameterSet *>& sets, FileFormat export_format, SourceFile *root_file);
+bool collects_statistics(const CommandLine& cmd);
+#ifdef ENABLE_TBB
+bool can_export_frames_in_parallel(FileFormat curFormat, const ViewOptions& viewOptions);
+int export_in_parallel(const std::vector<CommandLine>& exports, const std::function<RenderVariables(size_t)>& prepare, FileFormat curFormat, SourceFile *root_file, unsigned jobs);
+#endif
 
-int cmdline(const CommandLine& cmd)
+/*!
+   Selects the parameter sets named by the -P argument: a single name, a comma
+   separated list of names, or "*" for all sets in the file.
+ */
+std::vector<const ParameterSet *> select_parameter_sets(const ParameterSets& sets, const std::string& names)
 {
-  ExportFileFormatOptions exportFileFormatOptions;
-  FileFormat export_format;
+  std::vector<const ParameterSet *> selected;
+  for (const auto& set : sets) {
+    if (set.name() == names) return {&set};
+  }
+  if (names == "*") {
+    for (const auto& set : sets) selected.push_back(&set);
+    return selected;
+  }
+  std::vector<std::string> list;
+  boost::split(list, names, boost::is_any_of(","));
+  if (list.size() < 2) return selected;
+  for (const auto& name : list) {
+    auto it = std::find_if(sets.begin(), sets.end(), [&name](const ParameterSet& set) { return set.name() == name; });
+    if (it != sets.end()) selected.push_back(&*it);
+    else LOG(message_group::Warning, "Parameter set '%1$s' not found", name);
+  }
+  return selected;
+}
 
-  // Determine output file format and assign it to formatName
-  if (cmd.export_format.is_initialized()) {
-    export_format = cmd.export_format.get();
-  } else {
-    // else extract format from file extension
-    const auto path = fs::path(cmd.output_file);
-    std::string suffix = path.has_extension() ? path.extension().generic_string().substr(1) : "";
-    boost::algorithm::to_lower(suffix);
-    const auto format_iter = exportFileFormatOptions.exportFileFormats.find(suffix);
-    if (format_iter != exportFileFormatOptions.exportFileFormats.end()) {
-      export_format = format_iter->second;
-    } else {
-      LOG("Either add a valid suffix or specify one using the --export-format option.");
-      return 1;
-    }
-  }
+/*!
+   Returns the format given by --export-format, or else the one for the suffix
+   of output_file.
+ */
+boost::optional<FileFormat> output_format(const boost::optional<FileFormat>& export_format, const std::string& output_file)
+{
+  if (export_format.is_initialized()) return export_format;
+  ExportFileFormatOptions exportFileFormatOptions;
+  const auto path = fs::path(output_file);
+  std::string suffix = path.has_extension() ? path.extension().generic_string().substr(1) : "";
+  boost::algorithm::to_lower(suffix);
+  const auto format_iter = exportFileFormatOptions.exportFileFormats.find(suffix);
+  if (format_iter == exportFileFormatOptions.exportFileFormats.end()) return boost::none;
+  return format_iter->second;
+}
 
-  // Do some minimal checking of output directory before rendering (issue #432)
-  auto output_dir = fs::path(cmd.output_file).parent_path();
-  if (output_dir.empty()) {
-    // If output_file_str has no directory prefix, set output directory to current directory.
-    output_dir = fs::current_path();
-  }
-  if (!fs::is_directory(output_dir)) {
-    LOG("\n'%1$s' is not a directory for output file %2$s - Skipping\n", output_dir.generic_string(), cmd.output_file);
-    return 1;
+/*!
+   Returns the dimension of the geometry written to files of format, or 0 if
+   it isn't a geometry format.
+ */
+unsigned geometry_dimension(FileFormat format)
+{
+  switch (format) {
+  case FileFormat::ASCIISTL:
+  case FileFormat::STL:
+  case FileFormat::OBJ:
+  case FileFormat::OFF:
+  case FileFormat::WRL:
+  case FileFormat::AMF:
+  case FileFormat::_3MF:
+  case FileFormat::GLB:
+  case FileFormat::GEOM:
+  case FileFormat::NEFDBG:
+  case FileFormat::NEF3:
+    return 3;
+  case FileFormat::DXF:
+  case FileFormat::SVG:
+  case FileFormat::PDF:
+    return 2;
+  default:
+    return 0;
   }
+}
 
-  set_render_color_scheme(arg_colorscheme, true);
-
-  shared_ptr<Echostream> echostream;
-  if (export_format == FileFormat::ECHO) {
-    echostream.reset(cmd.is_stdout ? new Echostream(std::cout) : new Echostream(cmd.output_file));
+/*!
+   Returns true if outputs of format can be written by export_geometry() from
+   the geometry evaluated for another output.
+ */
+bool shares_evaluation(FileFormat format, const ViewOptions& viewOptions)
+{
+  switch (format) {
+  case FileFormat::ASCIISTL:
+  case FileFormat::STL:
+  case FileFormat::OBJ:
+  case FileFormat::OFF:
+  case FileFormat::WRL:
+  case FileFormat::AMF:
+  case FileFormat::_3MF:
+  case FileFormat::GLB:
+  case FileFormat::GEOM:
+  case FileFormat::NEFDBG:
+  case FileFormat::NEF3:
+  case FileFormat::DXF:
+  case FileFormat::SVG:
+  case FileFormat::PDF:
+    return true;
+  case FileFormat::PNG:
+  case FileFormat::RGBA:
+    // A preview is instantiated with $preview = true, so it's a different design
+    return viewOptions.renderer != RenderType::OPENCSG && viewOptions.renderer != RenderType::THROWNTOGETHER;
+  default:
+    return false;
   }
+}
 
+/*!
+   Reads and parses the input file of cmd and handles its dependencies.
+   Returns nullptr on errors.
+ */
+SourceFile *parse_design(const CommandLine& cmd)
+{
   std::string text;
   if (cmd.is_stdin) {
     text = std::string((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
@@ -389,7 +546,7 @@ int cmdline(const CommandLine& cmd)
     std::ifstream ifs(cmd.filename);
     if (!ifs.is_open()) {
       LOG("Can't open input file '%1$s'!\n", cmd.filename);
-      return 1;
+      return nullptr;
     }
     handle_dep(cmd.filename);
     text = std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
@@ -420,26 +577,74 @@ int cmdline(const CommandLine& cmd)
   }
   if (!root_file) {
     LOG("Can't parse file '%1$s'!\n", cmd.filename);
-    return 1;
+    return nullptr;
   }
 
   // add parameter to AST
   CommentParser::collectParameters(text.c_str(), root_file);
+  root_file->handleDependencies();
+  return root_file;
+}
+
+int cmdline(const CommandLine& cmd)
+{
+  FileFormat export_format;
+
+  // Determine output file format and assign it to formatName
+  if (auto format = output_format(cmd.export_format, cmd.output_file)) {
+    export_format = *format;
+  } else {
+    LOG("Either add a valid suffix or specify one using the --export-format option.");
+    return 1;
+  }
+
+  // Do some minimal checking of output directory before rendering (issue #432)
+  std::vector<std::string> output_files{cmd.output_file};
+  output_files.insert(output_files.end(), cmd.more_output_files.begin(), cmd.more_output_files.end());
+  for (const auto& output_file : output_files) {
+    auto output_dir = fs::path(output_file).parent_path();
+    if (output_dir.empty()) {
+      // If output_file_str has no directory prefix, set output directory to current directory.
+      output_dir = fs::current_path();
+    }
+    if (!fs::is_directory(output_dir)) {
+      LOG("\n'%1$s' is not a directory for output file %2$s - Skipping\n", output_dir.generic_string(), output_file);
+      return 1;
+    }
+  }
+
+  set_render_color_scheme(arg_colorscheme, true);
+
+  shared_ptr<Echostream> echostream;
+  if (export_format == FileFormat::ECHO && !arg_deps_only) {
+    echostream.reset(cmd.is_stdout ? new Echostream(std::cout) : new Echostream(cmd.output_file));
+  }
+
+  SourceFile *root_file = parse_design(cmd);
+  if (!root_file) return 1;
+
   if (!cmd.parameterFile.empty() && !cmd.setName.empty()) {
-    ParameterObjects parameters = ParameterObjects::fromSourceFile(root_file);
     ParameterSets sets;
     sets.readFile(cmd.parameterFile);
-    for (const auto& set : sets) {
-      if (set.name() == cmd.setName) {
-        parameters.importValues(set);
-        parameters.apply(root_file);
-        break;
-      }
+    const auto selected = select_parameter_sets(sets, cmd.setName);
+    if (selected.size() > 1 || (selected.size() == 1 && selected.front()->name() != cmd.setName)) {
+      return export_parameter_sets(cmd, selected, export_format, root_file);
+    }
+    if (!selected.empty()) {
+      ParameterObjects parameters = ParameterObjects::fromSourceFile(root_file);
+      parameters.importValues(*selected.front());
+      parameters.apply(root_file);
     }
   }
 
-  root_file->handleDependencies();
+  return export_design(cmd, export_format, root_file);
+}
 
+/*!
+   Exports the parsed design, either once or as the requested animation frames.
+ */
+int export_design(const CommandLine& cmd, FileFormat export_format, SourceFile *root_file)
+{
   RenderVariables render_variables;
   render_variables.preview = canPreview(export_format) ? (cmd.viewOptions.renderer == RenderType::OPENCSG || cmd.viewOptions.renderer == RenderType::THROWNTOGETHER) : false;
 
@@ -448,9 +653,8 @@ int cmdline(const CommandLine& cmd)
     return do_export(cmd, render_variables, export_format, root_file);
   } else {
     // export the requested number of animated frames
+    std::vector<CommandLine> frames;
     for (unsigned frame = 0; frame < cmd.animate_frames; ++frame) {
-      render_variables.time = frame * (1.0 / cmd.animate_frames);
-
       std::ostringstream oss;
       oss << std::setw(5) << std::setfill('0') << frame;
 
@@ -459,28 +663,394 @@ int cmdline(const CommandLine& cmd)
       frame_file.replace_extension();
       frame_file += oss.str();
       frame_file.replace_extension(extension);
-      string frame_str = frame_file.generic_string();
 
-      LOG("Exporting %1$s...", cmd.filename);
+      frames.push_back(cmd);
+      frames.back().output_file = frame_file.generic_string();
+    }
+
+    if (cmd.jobs > 1 && !arg_deps_only) {
+#ifdef ENABLE_TBB
+      if (collects_statistics(cmd)) {
+        LOG(message_group::Warning, "Exporting frames serially, --summary, --summary-file and --profile-trace describe one evaluation at a time.");
+      } else if (can_export_frames_in_parallel(export_format, cmd.viewOptions)) {
+        return export_in_parallel(frames, [&](size_t frame) {
+          render_variables.time = frame * (1.0 / frames.size());
+          return render_variables;
+        }, export_format, root_file, cmd.jobs);
+      } else {
+        LOG(message_group::Warning, "Exporting frames serially, --jobs needs the manifold feature and a 2D or 3D geometry export format.");
+      }
+#else
+      LOG(message_group::Warning, "Exporting frames serially, --jobs is not supported by this build.");
+#endif
+    }
 
-      CommandLine frame_cmd = cmd;
-      frame_cmd.output_file = frame_str;
+    for (unsigned frame = 0; frame < cmd.animate_frames; ++frame) {
+      render_variables.time = frame * (1.0 / cmd.animate_frames);
 
-      int r = do_export(frame_cmd, render_variables, export_format, root_file);
+      LOG("Exporting %1$s...", cmd.filename);
+
+      int r = do_export(frames[frame], render_variables, export_format, root_file);
       if (r != 0) {
+        wait_png_exports();
         return r;
       }
     }
 
-    return 0;
+    return wait_png_exports() ? 0 : 1;
   }
 }
 
-int do_export(const CommandLine& cmd, const RenderVariables& render_variables, FileFormat curFormat, SourceFile *root_file)
+/*!
+   Exports the design for each of the parameter sets, parsing it only once and
+   sharing the caches between the sets. The output file name is a template, in
+   which %P is replaced by the set name. Without %P, the set name is appended
+   to the file name before the extension.
+ */
+int export_parameter_sets(const CommandLine& cmd, const std::vector<const ParameterSet *>& sets, FileFormat export_format, SourceFile *root_file)
 {
-  auto filename_str = fs::path(cmd.output_file).generic_string();
-  auto fpath = fs::absolute(fs::path(cmd.filename));
-  auto fparent = fpath.parent_path();
+  ParameterObjects parameters = ParameterObjects::fromSourceFile(root_file);
+  std::vector<CommandLine> exports;
+  for (const auto set : sets) {
+    const auto set_file = [&set](std::string& output_file) {
+      if (output_file.find("%P") != std::string::npos) {
+        boost::replace_all(output_file, "%P", set->name());
+      } else {
+        auto path = fs::path(output_file);
+        auto extension = path.extension();
+        path.replace_extension();
+        path += "-" + set->name();
+        path.replace_extension(extension);
+        output_file = path.generic_string();
+      }
+    };
+    exports.push_back(cmd);
+    if (!cmd.is_stdout) set_file(exports.back().output_file);
+    for (auto& output_file : exports.back().more_output_files) set_file(output_file);
+  }
+
+  const auto apply = [&](size_t i) {
+    LOG("Using parameter set '%1$s'", sets[i]->name());
+    parameters.importValues(*sets[i]);
+    parameters.apply(root_file);
+  };
+
+  if (cmd.jobs > 1 && cmd.animate_frames == 0 && !arg_deps_only) {
+#ifdef ENABLE_TBB
+    if (collects_statistics(cmd)) {
+      LOG(message_group::Warning, "Exporting parameter sets serially, --summary, --summary-file and --profile-trace describe one evaluation at a time.");
+    } else if (can_export_frames_in_parallel(export_format, cmd.viewOptions)) {
+      // The formats exported in parallel are always rendered, not previewed
+      RenderVariables render_variables{false, 0};
+      return export_in_parallel(exports, [&](size_t i) {
+        apply(i);
+        return render_variables;
+      }, export_format, root_file, cmd.jobs);
+    } else {
+      LOG(message_group::Warning, "Exporting parameter sets serially, --jobs needs the manifold feature and a 2D or 3D geometry export format.");
+    }
+#else
+    LOG(message_group::Warning, "Exporting parameter sets serially, --jobs is not supported by this build.");
+#endif
+  }
+
+  for (size_t i = 0; i < exports.size(); ++i) {
+    apply(i);
+    int r = export_design(exports[i], export_format, root_file);
+    if (r != 0) return r;
+  }
+  return 0;
+}
+
+/*!
+   A render job of the server and batch modes, read from one JSON line.
+
+   Job fields: "input" and "output" (required), "format" (as --export-format),
+   "D" (list of var=val assignments), "p" and "P" (customizer parameter file
+   and set), "summary-file", and "id" which is passed back in the result.
+   With "subtrees", a list of subtree keys sent by --distribute, only those
+   subtrees are evaluated into the caches and no output is written.
+ */
+struct RenderJob
+{
+  nlohmann::json id;
+  std::string input;
+  std::string output;
+  boost::optional<FileFormat> export_format;
+  std::vector<std::string> assignments;
+  std::string parameterFile;
+  std::string parameterSet;
+  std::string summaryFile;
+  std::vector<std::string> subtrees;
+};
+
+/*!
+   Reads a job from a JSON line. Returns an error message if the job is invalid.
+ */
+std::string read_job(const std::string& line, RenderJob& job)
+{
+  try {
+    const auto json = nlohmann::json::parse(line);
+    if (json.contains("id")) job.id = json["id"];
+    job.input = json.value("input", "");
+    job.output = json.value("output", "");
+    if (json.contains("format")) {
+      ExportFileFormatOptions exportFileFormatOptions;
+      const auto format_iter = exportFileFormatOptions.exportFileFormats.find(json["format"].get<std::string>());
+      if (format_iter == exportFileFormatOptions.exportFileFormats.end()) return "Unknown format";
+      job.export_format.emplace(format_iter->second);
+    }
+    if (job.input.empty() || job.output.empty() || job.input == "-" || job.output == "-") {
+      return "Jobs need an input and an output file, stdin and stdout are reserved for the server";
+    }
+    job.assignments = json.value("D", std::vector<std::string>{});
+    job.parameterFile = json.value("p", "");
+    job.parameterSet = json.value("P", "");
+    job.summaryFile = json.value("summary-file", "");
+    job.subtrees = json.value("subtrees", std::vector<std::string>{});
+  } catch (const nlohmann::json::exception& e) {
+    return e.what();
+  }
+  return "";
+}
+
+CommandLine job_command(const RenderJob& job, const fs::path& original_path, const ViewOptions& viewOptions,
+                        const std::vector<Camera>& cameras, const std::vector<std::string>& summaryOptions)
+{
+  return CommandLine{
+    false,
+    job.input,
+    false,
+    job.output,
+    original_path,
+    job.parameterFile,
+    job.parameterSet,
+    viewOptions,
+    cameras,
+    job.export_format,
+    0,
+    1,
+    summaryOptions,
+    job.summaryFile,
+    {},
+    job.subtrees
+  };
+}
+
+// Adds the job's -D assignments to those given on the command line
+void set_job_commands(const RenderJob& job, const std::string& global_commands)
+{
+  commandline_commands = global_commands;
+  for (const auto& assignment : job.assignments) {
+    commandline_commands += assignment + ";\n";
+  }
+}
+
+/*!
+   Runs a job of the server or batch mode and returns its JSON result line.
+ */
+nlohmann::json run_job(const std::string& line, const fs::path& original_path, const ViewOptions& viewOptions,
+                       const std::vector<Camera>& cameras, const std::vector<std::string>& summaryOptions,
+                       const std::string& global_commands)
+{
+  nlohmann::json result;
+  int rc = 1;
+  RenderJob job;
+  StatCache::invalidateAll(); // Files may have changed since the last job
+  const auto error = read_job(line, job);
+  if (!job.id.is_null()) result["id"] = job.id;
+  if (!error.empty()) {
+    result["error"] = error;
+  } else {
+    try {
+      set_job_commands(job, global_commands);
+      rc = cmdline(job_command(job, original_path, viewOptions, cameras, summaryOptions));
+    } catch (const HardWarningException& e) {
+      result["error"] = e.what();
+    } catch (const MemoryLimitException& e) {
+      result["error"] = e.what();
+    } catch (const std::exception& e) {
+      // A failing job must not take the server and the following jobs down
+      result["error"] = e.what();
+    } catch (...) {
+      result["error"] = "Unknown error";
+    }
+  }
+  fs::current_path(original_path);
+  result["rc"] = rc;
+  return result;
+}
+
+/*!
+   Render server mode: reads render jobs as JSON objects, one per line, from
+   stdin and writes one JSON result line per job to stdout. Since the process
+   stays alive, the font cache, the source file cache and the geometry caches
+   are reused by all following jobs. See RenderJob for the job fields.
+   Files are stat()ed once per job.
+ */
+int server(const fs::path& original_path, const ViewOptions& viewOptions, const std::vector<Camera>& cameras,
+           const std::vector<std::string>& summaryOptions)
+{
+  FontCache::instance()->init_fontconfig(); // Pay for the font scan once, before the first job
+  StatCache::keepAll(true);
+  const std::string global_commands = commandline_commands;
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (boost::algorithm::trim_copy(line).empty()) continue;
+    std::cout << run_job(line, original_path, viewOptions, cameras, summaryOptions, global_commands).dump() << std::endl;
+  }
+  commandline_commands = global_commands;
+  return 0;
+}
+
+/*!
+   Batch mode: runs the jobs of a manifest file, in the JSON lines format of the
+   server mode, in one process sharing the caches, and writes one JSON result
+   line per job to stdout. Returns 1 if any job failed.
+
+   With jobs > 1, up to that many consecutive jobs exporting a mesh or 2D format
+   without customizer parameters are prepared one after the other, parsing and
+   instantiation not being thread-safe, then their geometry is evaluated and
+   exported concurrently. Other jobs run one at a time, their mesh files being
+   written while the next job evaluates. Their results are reported once the
+   files are complete, so jobs must not import the output of the previous job.
+ */
+int batch(const std::string& manifest, const fs::path& original_path, const ViewOptions& viewOptions,
+          const std::vector<Camera>& cameras, const std::vector<std::string>& summaryOptions, unsigned jobs)
+{
+  std::ifstream ifs(manifest);
+  if (!ifs.is_open()) {
+    LOG("Can't open manifest file '%1$s'!\n", manifest);
+    return 1;
+  }
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (!boost::algorithm::trim_copy(line).empty()) lines.push_back(line);
+  }
+
+  FontCache::instance()->init_fontconfig(); // Pay for the font scan once, before the first job
+  StatCache::keepAll(true);
+  const std::string global_commands = commandline_commands;
+  int rc = 0;
+  const auto report = [&rc](const nlohmann::json& result) {
+    if (result["rc"] != 0) rc = 1;
+    std::cout << result.dump() << std::endl;
+  };
+
+#ifdef ENABLE_TBB
+  if (jobs > 1 && (!summaryOptions.empty() || !arg_profile_trace.empty())) {
+    LOG(message_group::Warning, "Running batch jobs serially, --summary and --profile-trace describe one evaluation at a time.");
+  } else if (jobs > 1) {
+    tbb::task_arena arena(static_cast<int>(jobs));
+    for (size_t first = 0; first < lines.size(); first += jobs) {
+      const size_t count = std::min<size_t>(jobs, lines.size() - first);
+      StatCache::invalidateAll();
+      std::vector<RenderJob> chunk(count);
+      std::vector<nlohmann::json> results(count);
+      std::vector<std::unique_ptr<SourceFile>> files(count);
+      std::vector<std::unique_ptr<Tree>> trees(count);
+      std::vector<Camera> job_cameras(count, cameras.front());
+      std::vector<FileFormat> formats(count);
+      for (size_t i = 0; i < count; ++i) {
+        const auto error = read_job(lines[first + i], chunk[i]);
+        const auto& job = chunk[i];
+        const auto format = output_format(job.export_format, job.output);
+        // Jobs writing a summary file run alone as well, see collects_statistics()
+        if (!error.empty() || !format || !job.parameterFile.empty() || !job.summaryFile.empty() ||
+            !can_export_frames_in_parallel(*format, viewOptions)) {
+          results[i] = run_job(lines[first + i], original_path, viewOptions, cameras, summaryOptions, global_commands);
+          continue;
+        }
+        formats[i] = *format;
+        if (!job.id.is_null()) results[i]["id"] = job.id;
+        results[i]["rc"] = 1;
+        try {
+          set_job_commands(job, global_commands);
+          const auto cmd = job_command(job, original_path, viewOptions, cameras, summaryOptions);
+          files[i].reset(parse_design(cmd));
+          if (files[i]) {
+            auto root_node = instantiate_root(cmd, RenderVariables{false, 0}, files[i].get(), job_cameras[i]);
+            trees[i] = std::make_unique<Tree>(root_node, fs::absolute(fs::path(job.input)).parent_path().string());
+          }
+        } catch (const HardWarningException& e) {
+          results[i]["error"] = e.what();
+        } catch (const std::exception& e) {
+          results[i]["error"] = e.what();
+        } catch (...) {
+          results[i]["error"] = "Unknown error";
+        }
+        fs::current_path(original_path);
+      }
+
+      arena.execute([&]() {
+        tbb::task_group group;
+        const auto export_job = [&](size_t i) {
+          const auto cmd = job_command(chunk[i], original_path, viewOptions, cameras, summaryOptions);
+          try {
+            results[i]["rc"] = export_geometry(cmd, formats[i], *trees[i], job_cameras[i]);
+          } catch (const HardWarningException& e) {
+            results[i]["error"] = e.what();
+          } catch (const MemoryLimitException& e) {
+            results[i]["error"] = e.what();
+          } catch (const std::exception& e) {
+            results[i]["error"] = e.what();
+          } catch (...) {
+            results[i]["error"] = "Unknown error";
+          }
+        };
+        std::vector<size_t> serial;
+        for (size_t i = 0; i < count; ++i) {
+          if (!trees[i]) continue;
+          if (GeometryEvaluator::isThreadSafe(*trees[i]->root())) group.run([&, i]() { export_job(i); });
+          else serial.push_back(i);
+        }
+        // Jobs needing exact CGAL numerics are exported one at a time
+        for (size_t i : serial) export_job(i);
+        group.wait();
+      });
+      for (const auto& result : results) report(result);
+    }
+    commandline_commands = global_commands;
+    return rc;
+  }
+#else
+  if (jobs > 1) LOG(message_group::Warning, "Running batch jobs serially, --jobs is not supported by this build.");
+#endif
+
+  // The files of each job are written while the next job is evaluated, only
+  // one job's exports being pending at a time
+  background_exports = true;
+  nlohmann::json previous;
+  std::vector<std::future<bool>> previous_exports;
+  const auto finish_previous = [&]() {
+    for (auto& written : previous_exports) {
+      if (!written.get() && previous["rc"] == 0) previous["rc"] = 1;
+    }
+    previous_exports.clear();
+    if (!previous.is_null()) report(previous);
+  };
+  for (const auto& line : lines) {
+    auto result = run_job(line, original_path, viewOptions, cameras, summaryOptions, global_commands);
+    finish_previous();
+    previous = std::move(result);
+    previous_exports = std::move(pending_exports);
+    pending_exports.clear();
+  }
+  finish_previous();
+  background_exports = false;
+  commandline_commands = global_commands;
+  return rc;
+}
+
+/*!
+   Instantiates the root node of root_file for one export, using the given
+   render variables. The camera is updated from the $vp* variables of the file.
+ */
+std::shared_ptr<const AbstractNode> instantiate_root(const CommandLine& cmd, const RenderVariables& render_variables, SourceFile *root_file, Camera& camera)
+{
+  auto fparent = fs::absolute(fs::path(cmd.filename)).parent_path();
 
   // set CWD relative to source file
   fs::current_path(fparent);
@@ -501,13 +1071,15 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
     else
 #endif	    
   absolute_root_node = root_file->instantiate(*builtin_context, &file_context);
-  Camera camera = cmd.camera;
   if (file_context) {
     camera.updateView(file_context, true);
   }
 
   // restore CWD after module instantiation finished
   fs::current_path(cmd.original_path);
+  if (!arg_profile_eval.empty()) {
+    EvalProfiler::instance()->writeSpeedscope(arg_profile_eval);
+  }
 
   // Do we have an explicit root node (! modifier)?
   std::shared_ptr<const AbstractNode> root_node;
@@ -518,6 +1090,441 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
   if (nextLocation) {
     LOG(message_group::Warning, *nextLocation, builtin_context->documentRoot(), "More than one Root Modifier (!)");
   }
+  return root_node;
+}
+
+/*!
+   Parses the heights of --slice-layers, either start:step:end with both ends
+   included, or a comma separated list.
+ */
+static bool parse_slice_heights(const std::string& spec, std::vector<double>& heights)
+{
+  std::vector<std::string> parts;
+  try {
+    if (spec.find(':') != std::string::npos) {
+      boost::split(parts, spec, boost::is_any_of(":"));
+      if (parts.size() != 3) return false;
+      const double start = std::stod(parts[0]), step = std::stod(parts[1]), end = std::stod(parts[2]);
+      if (!(step > 0) || end < start) return false;
+      // Tolerates the rounding of the step, so the end is included as given
+      const auto count = static_cast<size_t>(std::floor((end - start) / step + 1e-9)) + 1;
+      for (size_t i = 0; i < count; ++i) heights.push_back(start + i * step);
+    } else {
+      boost::split(parts, spec, boost::is_any_of(","));
+      for (const auto& part : parts) heights.push_back(std::stod(part));
+    }
+  } catch (const std::logic_error&) {
+    return false;
+  }
+  return !heights.empty();
+}
+
+#ifdef ENABLE_CGAL
+/*!
+   Has the workers of --distribute evaluate expensive subtrees of the design
+   into the shared cache, by sending them a server job for the same design.
+ */
+void distribute_subtrees(const CommandLine& cmd, const Tree& tree)
+{
+  if (cmd.is_stdin || cmd.is_stdout || cmd.animate_frames > 0) {
+    LOG(message_group::Warning, "Not distributing subtrees of animations or when using stdin or stdout.");
+    return;
+  }
+  nlohmann::json job;
+  job["input"] = fs::absolute(cmd.filename).generic_string();
+  job["output"] = fs::absolute(cmd.output_file).generic_string();
+  if (!commandline_commands.empty()) job["D"] = std::vector<std::string>{commandline_commands};
+  if (!cmd.parameterFile.empty()) job["p"] = fs::absolute(cmd.parameterFile).generic_string();
+  if (!cmd.setName.empty()) job["P"] = cmd.setName;
+  if (cmd.export_format) {
+    ExportFileFormatOptions exportFileFormatOptions;
+    for (const auto& format : exportFileFormatOptions.exportFileFormats) {
+      if (format.second == *cmd.export_format) job["format"] = format.first;
+    }
+  }
+  GeometryEvaluator evaluator(tree, cmd.viewOptions.renderer == RenderType::QUICK ?
+                              GeometryEvaluator::Precision::Approximate : GeometryEvaluator::Precision::Exact);
+  SubtreeDistribution::run(*tree.root(), evaluator, arg_distribute, job, arg_distribute_min_cost);
+}
+
+/*!
+   Adds the top-level objects of the design below node to list, looking
+   through the root and list nodes which would otherwise be united.
+ */
+static void collect_top_level_objects(const std::shared_ptr<const AbstractNode>& node, std::vector<std::shared_ptr<const AbstractNode>>& list)
+{
+  if (!dynamic_cast<const RootNode *>(node.get()) && !dynamic_cast<const ListNode *>(node.get())) {
+    list.push_back(node);
+    return;
+  }
+  for (const auto& child : node->getChildren()) {
+    if (!child->modinst->isBackground()) collect_top_level_objects(child, list);
+  }
+}
+
+/*!
+   Exports each top-level object of tree to a file of its own, numbered from 1
+   like the files of extra camera views, instead of uniting them. The objects
+   are evaluated and written concurrently where that's thread safe.
+ */
+int export_split(const CommandLine& cmd, FileFormat curFormat, const Tree& tree, GeometryEvaluator::Precision precision)
+{
+  std::vector<std::pair<FileFormat, fs::path>> outputs{{curFormat, fs::path(cmd.output_file)}};
+  for (const auto& output_file : cmd.more_output_files) {
+    outputs.emplace_back(output_format(cmd.export_format, output_file).get(), fs::path(output_file));
+  }
+  for (const auto& output : outputs) {
+    if (cmd.is_stdout || !geometry_dimension(output.first)) {
+      LOG("--export-split needs geometry file formats, and can't write to stdout.");
+      return 1;
+    }
+  }
+
+  std::vector<std::shared_ptr<const AbstractNode>> objects;
+  collect_top_level_objects(tree.root(), objects);
+  if (objects.empty()) {
+    LOG("Current top level object is empty.");
+    return 1;
+  }
+  // Builds the id cache of the tree before any concurrent lookups
+  tree.getIdHash(*tree.root());
+
+  std::vector<char> written(objects.size(), false);
+  auto export_object = [&](size_t i) {
+    GeometryEvaluator evaluator(tree, precision);
+    const auto geom = evaluator.evaluateGeometry(*objects[i], true);
+    if (!geom) return;
+    bool ok = true;
+    for (const auto& output : outputs) {
+      auto object_file = output.second;
+      const auto extension = object_file.extension();
+      object_file.replace_extension();
+      object_file += "-" + std::to_string(i + 1);
+      object_file.replace_extension(extension);
+      ok = checkAndExport(geom, geometry_dimension(output.first), output.first, false, object_file.generic_string()) && ok;
+    }
+    written[i] = ok;
+  };
+
+#ifdef ENABLE_TBB
+  tbb::task_group group;
+  for (size_t i = 0; i < objects.size(); ++i) {
+    if (GeometryEvaluator::isThreadSafe(*objects[i])) group.run([&export_object, i]() { export_object(i); });
+  }
+#endif
+  for (size_t i = 0; i < objects.size(); ++i) {
+#ifdef ENABLE_TBB
+    if (GeometryEvaluator::isThreadSafe(*objects[i])) continue;
+#endif
+    export_object(i);
+  }
+#ifdef ENABLE_TBB
+  group.wait();
+#endif
+  LOG("Exported %1$d top-level objects", objects.size());
+  return std::find(written.begin(), written.end(), false) == written.end() ? 0 : 1;
+}
+
+/*!
+   Writes the cross sections of the 3D geometry at the heights of --slice-layers,
+   each to a numbered SVG or DXF file (out-1.svg, out-2.svg, ...) or, with
+   --slice-single-file, all as layers of one file. The mesh is sliced once for
+   all heights, instead of one projection(cut = true) evaluation per height.
+ */
+int export_slices(const CommandLine& cmd, FileFormat curFormat, const shared_ptr<const Geometry>& root_geom)
+{
+  if (curFormat != FileFormat::SVG && curFormat != FileFormat::DXF) {
+    LOG("--slice-layers needs SVG or DXF output.");
+    return 1;
+  }
+  if (root_geom->getDimension() != 3) {
+    LOG("Current top level object is not a 3D object.");
+    return 1;
+  }
+  auto ps = make_shared<PolySet>(3);
+  if (auto geomlist = dynamic_pointer_cast<const GeometryList>(root_geom)) {
+    for (const auto& item : geomlist->flatten()) {
+      if (auto chps = CGALUtils::getGeometryAsPolySet(item.second)) ps->append(*chps);
+    }
+  } else if (auto chps = CGALUtils::getGeometryAsPolySet(root_geom)) {
+    ps->append(*chps);
+  }
+
+  const auto slices = PolySetUtils::slice(*ps, arg_slice_heights);
+  ExportLayers layers;
+  size_t empty = 0;
+  for (size_t i = 0; i < slices.size(); ++i) {
+    std::ostringstream name;
+    name << "Z" << arg_slice_heights[i];
+    if (!slices[i]) {
+      LOG(message_group::Warning, "The cross section at z = %1$g isn't closed, the object may not be a valid 2-manifold", arg_slice_heights[i]);
+    }
+    if (!slices[i] || slices[i]->isEmpty()) ++empty;
+    layers.emplace_back(name.str(), slices[i] ? slices[i] : make_shared<const Polygon2d>());
+  }
+  if (empty == layers.size()) {
+    LOG("Current top level object is empty at all slice heights.");
+    return 1;
+  }
+
+  if (arg_slice_single_file) {
+    const bool wrote = with_output(cmd.is_stdout, cmd.output_file, [&layers, curFormat](std::ostream& stream) {
+      if (curFormat == FileFormat::SVG) export_svg_layers(layers, stream);
+      else export_dxf_layers(layers, stream);
+    });
+    if (!wrote) return 1;
+  } else {
+    if (cmd.is_stdout) {
+      LOG("--slice-layers can't write separate files to stdout, use --slice-single-file.");
+      return 1;
+    }
+    const auto path = fs::path(cmd.output_file);
+    for (size_t i = 0; i < layers.size(); ++i) {
+      // Nothing to cut above or below the object
+      if (layers[i].second->isEmpty()) continue;
+      auto layer_file = path;
+      layer_file.replace_extension();
+      layer_file += "-" + std::to_string(i + 1);
+      layer_file.replace_extension(path.extension());
+      if (!checkAndExport(layers[i].second, 2, curFormat, false, layer_file.generic_string())) return 1;
+    }
+  }
+  LOG("Exported %1$d slice layers, %2$d of them empty", layers.size(), empty);
+  return 0;
+}
+#endif // ENABLE_CGAL
+
+/*!
+   Evaluates the geometry of tree and exports it to a geometry file format or PNG.
+ */
+int export_geometry(const CommandLine& cmd, FileFormat curFormat, Tree& tree, Camera camera)
+{
+  auto filename_str = fs::path(cmd.output_file).generic_string();
+
+#ifdef ENABLE_CGAL
+
+  if (arg_benchmark_backends && !BackendBenchmark::run(tree, arg_benchmark_backends_file)) return 1;
+  if (!arg_distribute.empty() && cmd.subtrees.empty()) distribute_subtrees(cmd, tree);
+
+  // start measuring render time
+  RenderStatistic renderStatistic;
+  GeometryEvaluator geomevaluator(tree, cmd.viewOptions.renderer == RenderType::QUICK ?
+                                  GeometryEvaluator::Precision::Approximate : GeometryEvaluator::Precision::Exact);
+  unique_ptr<Renderer> renderer;
+  shared_ptr<const Geometry> root_geom;
+  if ((curFormat == FileFormat::ECHO || isImage(curFormat)) && (cmd.viewOptions.renderer == RenderType::OPENCSG || cmd.viewOptions.renderer == RenderType::THROWNTOGETHER)) {
+    // OpenCSG or throwntogether png -> just render a preview
+    renderer = prepare_preview(tree, cmd.viewOptions, camera);
+    if (!renderer) return 1;
+  } else if (!cmd.subtrees.empty()) {
+    return SubtreeDistribution::evaluateSubtrees(*tree.root(), geomevaluator, cmd.subtrees) == 0 ? 0 : 1;
+  } else if (arg_export_split) {
+    return export_split(cmd, curFormat, tree, cmd.viewOptions.renderer == RenderType::QUICK ?
+                        GeometryEvaluator::Precision::Approximate : GeometryEvaluator::Precision::Exact);
+  } else {
+    // Force creation of CGAL objects (for testing)
+    root_geom = geomevaluator.evaluateGeometry(*tree.root(), true);
+    if (root_geom) {
+      if (cmd.viewOptions.renderer == RenderType::CGAL && root_geom->getDimension() == 3) {
+        if (auto geomlist = dynamic_pointer_cast<const GeometryList>(root_geom)) {
+          auto flatlist = geomlist->flatten();
+          for (auto& child : flatlist) {
+            if (child.second->getDimension() == 3) {
+              child.second = CGALUtils::getNefPolyhedronFromGeometry(child.second);
+            }
+          }
+          root_geom.reset(new GeometryList(flatlist));
+        } else {
+          root_geom = CGALUtils::getNefPolyhedronFromGeometry(root_geom);
+        }
+        LOG("Converted to Nef polyhedron");
+      }
+    } else {
+      root_geom.reset(new CGAL_Nef_polyhedron());
+    }
+    if (!arg_slice_heights.empty()) return export_slices(cmd, curFormat, root_geom);
+  }
+  // Meshes of Manifold are safe to write while the next job evaluates
+  const bool background = background_exports && GeometryEvaluator::isThreadSafe(*tree.root());
+  // Writes one output from the evaluated geometry
+  const auto write_output = [&](FileFormat format, const std::string& output_file, bool is_stdout) {
+    if (const auto dim = geometry_dimension(format)) {
+      return checkAndExport(root_geom, dim, format, is_stdout, output_file,
+                            background && can_export_frames_in_parallel(format, cmd.viewOptions));
+    }
+    if (isImage(format)) {
+      if (!renderer) renderer = prepare_png(root_geom, camera);
+      if (!renderer) return false;
+      // All views are drawn from this evaluation, the extra ones to numbered files
+      std::vector<Camera> views{camera};
+      views.insert(views.end(), cmd.cameras.begin() + 1, cmd.cameras.end());
+      for (size_t i = 0; i < views.size(); ++i) {
+        auto view_file = fs::path(output_file);
+        if (i > 0) {
+          auto extension = view_file.extension();
+          view_file.replace_extension();
+          view_file += "-" + std::to_string(i);
+          view_file.replace_extension(extension);
+        }
+        // Files are encoded in the background while the next images are drawn
+        if (format == FileFormat::PNG && !is_stdout) {
+          if (!export_png(*renderer, cmd.viewOptions, views[i], view_file.generic_string())) return false;
+          continue;
+        }
+        bool success = true;
+        bool wrote = with_output(is_stdout, view_file.generic_string(), [&success, &renderer, &cmd, &views, i, format](std::ostream& stream) {
+          if (format == FileFormat::RGBA) success = export_rgba(*renderer, cmd.viewOptions, views[i], stream);
+          else success = export_png(*renderer, cmd.viewOptions, views[i], stream);
+        }, std::ios::out | std::ios::binary);
+        if (!success || !wrote) return false;
+      }
+    }
+    return true;
+  };
+
+  if (!write_output(curFormat, filename_str, cmd.is_stdout)) {
+    wait_png_exports();
+    return 1;
+  }
+
+  // The other outputs were only grouped with this one if they share its geometry,
+  // see shares_evaluation(). Those written from the mesh alone can be written
+  // concurrently, PNG export needs the OpenGL context of this thread.
+  std::vector<std::pair<FileFormat, std::string>> more_outputs;
+  for (const auto& output_file : cmd.more_output_files) {
+    more_outputs.emplace_back(output_format(cmd.export_format, output_file).get(), fs::path(output_file).generic_string());
+  }
+  std::vector<char> written(more_outputs.size(), false);
+#ifdef ENABLE_TBB
+  tbb::task_group group;
+  for (size_t i = 0; i < more_outputs.size(); ++i) {
+    if (!isImage(more_outputs[i].first) && can_export_frames_in_parallel(more_outputs[i].first, cmd.viewOptions)) {
+      group.run([&, i]() { written[i] = write_output(more_outputs[i].first, more_outputs[i].second, false); });
+    }
+  }
+#endif
+  for (size_t i = 0; i < more_outputs.size(); ++i) {
+#ifdef ENABLE_TBB
+    if (!isImage(more_outputs[i].first) && can_export_frames_in_parallel(more_outputs[i].first, cmd.viewOptions)) continue;
+#endif
+    written[i] = write_output(more_outputs[i].first, more_outputs[i].second, false);
+  }
+#ifdef ENABLE_TBB
+  group.wait();
+#endif
+  // Animation frames are encoded while the next frames are drawn, see export_design()
+  if (cmd.animate_frames == 0 && !wait_png_exports()) return 1;
+  if (std::find(written.begin(), written.end(), false) != written.end()) return 1;
+
+  renderStatistic.printAll(root_geom, camera, cmd.summaryOptions, cmd.summaryFile);
+  if (!arg_profile_trace.empty()) {
+    NodeProfiler::instance()->writeChromeTrace(arg_profile_trace);
+  }
+#else
+  LOG("OpenSCAD has been compiled without CGAL support!\n");
+  return 1;
+#endif // ifdef ENABLE_CGAL
+  return 0;
+}
+
+/*!
+   Whether the export reports render statistics. These are gathered in global
+   recorders which each evaluation resets, and written to a single summary file
+   and trace, so such exports can't run concurrently.
+ */
+bool collects_statistics(const CommandLine& cmd)
+{
+  return !cmd.summaryOptions.empty() || !cmd.summaryFile.empty() || !arg_profile_trace.empty();
+}
+
+/*!
+   Frames can be exported concurrently if they are written from the evaluated
+   geometry alone (PNG export needs an OpenGL context) and evaluated by Manifold.
+ */
+bool can_export_frames_in_parallel(FileFormat curFormat, const ViewOptions& viewOptions)
+{
+  if (viewOptions.renderer == RenderType::CGAL) return false;
+  if (!Feature::ExperimentalManifold.is_enabled() && viewOptions.renderer != RenderType::QUICK) return false;
+  switch (curFormat) {
+  case FileFormat::ASCIISTL:
+  case FileFormat::STL:
+  case FileFormat::OBJ:
+  case FileFormat::OFF:
+  case FileFormat::WRL:
+  case FileFormat::AMF:
+  case FileFormat::_3MF:
+  case FileFormat::GLB:
+  case FileFormat::GEOM:
+  case FileFormat::DXF:
+  case FileFormat::SVG:
+  case FileFormat::PDF:
+    return true;
+  default:
+    return false;
+  }
+}
+
+#ifdef ENABLE_TBB
+/*!
+   Exports animation frames or parameter sets, evaluating the geometry of up to
+   jobs exports concurrently. prepare(i) sets up the design for export i and
+   returns its render variables. Instantiation stays on this thread since it
+   depends on the current directory and on the stack check of the main thread.
+   The first export runs alone, so the shared geometry cache already holds all
+   subtrees which don't differ between them when the others start.
+ */
+int export_in_parallel(const std::vector<CommandLine>& frames, const std::function<RenderVariables(size_t)>& prepare, FileFormat curFormat, SourceFile *root_file, unsigned jobs)
+{
+  const auto fparent = fs::absolute(fs::path(frames.front().filename)).parent_path().string();
+  tbb::task_arena arena(static_cast<int>(jobs));
+  for (size_t first = 0; first < frames.size();) {
+    const size_t count = first == 0 ? 1 : std::min<size_t>(jobs, frames.size() - first);
+    std::vector<std::unique_ptr<Tree>> trees;
+    std::vector<Camera> cameras;
+    for (size_t i = first; i < first + count; ++i) {
+      const auto render_variables = prepare(i);
+      LOG("Exporting %1$s...", frames[i].filename);
+      cameras.push_back(frames[i].cameras.front());
+      auto root_node = instantiate_root(frames[i], render_variables, root_file, cameras.back());
+      trees.push_back(std::make_unique<Tree>(root_node, fparent));
+    }
+
+    std::vector<int> results(count, 0);
+    arena.execute([&]() {
+      tbb::task_group group;
+      std::vector<size_t> serial;
+      for (size_t i = 0; i < count; ++i) {
+        if (GeometryEvaluator::isThreadSafe(*trees[i]->root())) {
+          group.run([&, i]() { results[i] = export_geometry(frames[first + i], curFormat, *trees[i], cameras[i]); });
+        } else {
+          serial.push_back(i);
+        }
+      }
+      // Frames needing exact CGAL numerics are exported one at a time
+      for (size_t i : serial) {
+        results[i] = export_geometry(frames[first + i], curFormat, *trees[i], cameras[i]);
+      }
+      group.wait();
+    });
+    for (int r : results) {
+      if (r != 0) return r;
+    }
+    first += count;
+  }
+  return 0;
+}
+#endif // ifdef ENABLE_TBB
+
+int do_export(const CommandLine& cmd, const RenderVariables& render_variables, FileFormat curFormat, SourceFile *root_file)
+{
+  auto filename_str = fs::path(cmd.output_file).generic_string();
+  auto fpath = fs::absolute(fs::path(cmd.filename));
+  auto fparent = fpath.parent_path();
+
+  Camera camera = cmd.cameras.front();
+  auto root_node = instantiate_root(cmd, render_variables, root_file, camera);
+  // Imported and included files are all known once the design is instantiated
+  if (arg_deps_only) return 0;
   Tree tree(root_node, fparent.string());
 
   if (curFormat == FileFormat::CSG) {
@@ -528,7 +1535,8 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
     // the output.
     fs::current_path(fparent); // Force exported filenames to be relative to document path
     with_output(cmd.is_stdout, filename_str, [&tree, root_node](std::ostream& stream) {
-      stream << tree.getString(*root_node, "\t") << "\n";
+      tree.writeString(*root_node, "\t", stream);
+      stream << "\n";
     });
     fs::current_path(cmd.original_path);
   } else if (curFormat == FileFormat::AST) {
@@ -554,79 +1562,7 @@ int do_export(const CommandLine& cmd, const RenderVariables& render_variables, F
   } else if (curFormat == FileFormat::ECHO) {
     // echo -> don't need to evaluate any geometry
   } else {
-#ifdef ENABLE_CGAL
-
-    // start measuring render time
-    RenderStatistic renderStatistic;
-    GeometryEvaluator geomevaluator(tree);
-    unique_ptr<OffscreenView> glview;
-    shared_ptr<const Geometry> root_geom;
-    if ((curFormat == FileFormat::ECHO || curFormat == FileFormat::PNG) && (cmd.viewOptions.renderer == RenderType::OPENCSG || cmd.viewOptions.renderer == RenderType::THROWNTOGETHER)) {
-      // OpenCSG or throwntogether png -> just render a preview
-      glview = prepare_preview(tree, cmd.viewOptions, camera);
-      if (!glview) return 1;
-    } else {
-      // Force creation of CGAL objects (for testing)
-      root_geom = geomevaluator.evaluateGeometry(*tree.root(), true);
-      if (root_geom) {
-        if (cmd.viewOptions.renderer == RenderType::CGAL && root_geom->getDimension() == 3) {
-          if (auto geomlist = dynamic_pointer_cast<const GeometryList>(root_geom)) {
-            auto flatlist = geomlist->flatten();
-            for (auto& child : flatlist) {
-              if (child.second->getDimension() == 3) {
-                child.second = CGALUtils::getNefPolyhedronFromGeometry(child.second);
-              }
-            }
-            root_geom.reset(new GeometryList(flatlist));
-          } else {
-            root_geom = CGALUtils::getNefPolyhedronFromGeometry(root_geom);
-          }
-          LOG("Converted to Nef polyhedron");
-        }
-      } else {
-        root_geom.reset(new CGAL_Nef_polyhedron());
-      }
-    }
-    if (curFormat == FileFormat::ASCIISTL ||
-        curFormat == FileFormat::STL ||
-        curFormat == FileFormat::OBJ ||
-        curFormat == FileFormat::OFF ||
-        curFormat == FileFormat::WRL ||
-        curFormat == FileFormat::AMF ||
-        curFormat == FileFormat::_3MF ||
-        curFormat == FileFormat::NEFDBG ||
-        curFormat == FileFormat::NEF3) {
-      if (!checkAndExport(root_geom, 3, curFormat, cmd.is_stdout, filename_str)) {
-        return 1;
-      }
-    }
-
-    if (curFormat == FileFormat::DXF || curFormat == FileFormat::SVG || curFormat == FileFormat::PDF) {
-      if (!checkAndExport(root_geom, 2, curFormat, cmd.is_stdout, filename_str)) {
-        return 1;
-      }
-    }
-
-    if (curFormat == FileFormat::PNG) {
-      bool success = true;
-      bool wrote = with_output(cmd.is_stdout, filename_str, [&success, &root_geom, &cmd, &camera, &glview](std::ostream& stream) {
-        if (cmd.viewOptions.renderer == RenderType::CGAL || cmd.viewOptions.renderer == RenderType::GEOMETRY) {
-          success = export_png(root_geom, cmd.viewOptions, camera, stream);
-        } else {
-          success = export_png(*glview, stream);
-        }
-      }, std::ios::out | std::ios::binary);
-      if (!success || !wrote) {
-        return 1;
-      }
-    }
-
-    renderStatistic.printAll(root_geom, camera, cmd.summaryOptions, cmd.summaryFile);
-#else
-    LOG("OpenSCAD has been compiled without CGAL support!\n");
-    return 1;
-#endif // ifdef ENABLE_CGAL
-
+    return export_geometry(cmd, curFormat, tree, camera);
   }
   return 0;
 }
@@ -912,6 +1848,19 @@ bool flagConvert(const std::string& str){
   return false;
 }
 
+#ifdef __EMSCRIPTEN__
+#include <emscripten.h>
+
+/*!
+   Called from JavaScript, e.g. a worker's message handler, to stop the
+   running render. The command line returns 1 as with other failures.
+ */
+extern "C" EMSCRIPTEN_KEEPALIVE void openscad_cancel()
+{
+  progress_cancel();
+}
+#endif
+
 // OpenSCAD
 int main(int argc, char **argv)
 {
@@ -947,7 +1896,6 @@ int main(int argc, char **argv)
   CGAL::set_error_behaviour(CGAL::THROW_EXCEPTION);
   CGAL::set_warning_behaviour(CGAL::THROW_EXCEPTION);
 #endif
-  Builtins::instance()->initialize();
 
   auto original_path = fs::current_path();
 
@@ -958,11 +1906,11 @@ int main(int argc, char **argv)
   ViewOptions viewOptions{};
   po::options_description desc("Allowed options");
   desc.add_options()
-    ("export-format", po::value<string>(), "overrides format of exported scad file when using option '-o', arg can be any of its supported file extensions.  For ascii stl export, specify 'asciistl', and for binary stl export, specify 'binstl'.  Ascii export is the current stl default, but binary stl is planned as the future default so asciistl should be explicitly specified in scripts when needed.\n")
-    ("o,o", po::value<vector<string>>(), "output specified file instead of running the GUI, the file extension specifies the type: stl, off, wrl, amf, 3mf, csg, dxf, svg, pdf, png, echo, ast, term, nef3, nefdbg (May be used multiple time for different exports). Use '-' for stdout\n")
+    ("export-format", po::value<string>(), "overrides format of exported scad file when using option '-o', arg can be any of its supported file extensions.  Stl files are binary by default, for ascii stl export specify 'asciistl'.\n")
+    ("o,o", po::value<vector<string>>(), "output specified file instead of running the GUI, the file extension specifies the type: stl, off, wrl, amf, 3mf, glb, geom, csg, dxf, svg, pdf, png, rgba, echo, ast, term, nef3, nefdbg (May be used multiple time for different exports). Use '-' for stdout\n")
     ("D,D", po::value<vector<string>>(), "var=val -pre-define variables")
     ("p,p", po::value<string>(), "customizer parameter file")
-    ("P,P", po::value<string>(), "customizer parameter set")
+    ("P,P", po::value<string>(), "customizer parameter set, several separated by ',' or * for all sets, exported to files named after the output file with %P replaced by the set name")
 #ifdef ENABLE_EXPERIMENTAL
   ("enable", po::value<vector<string>>(), ("enable experimental features (specify 'all' for enabling all available features): " +
                                            str_join(boost::make_iterator_range(Feature::begin(), Feature::end()), " | ",
@@ -975,18 +1923,40 @@ int main(int argc, char **argv)
     ("version,v", "print the version")
     ("info", "print information about the build process\n")
 
-    ("camera", po::value<string>(), "camera parameters when exporting png: =translate_x,y,z,rot_x,y,z,dist or =eye_x,y,z,center_x,y,z")
+    ("camera", po::value<string>(), "camera parameters when exporting png: =translate_x,y,z,rot_x,y,z,dist or =eye_x,y,z,center_x,y,z, several views separated by ';' are exported to numbered files")
     ("autocenter", "adjust camera to look at object's center")
     ("viewall", "adjust camera to fit object")
     ("imgsize", po::value<string>(), "=width,height of exported png")
-    ("render", po::value<string>()->implicit_value(""), "for full geometry evaluation when exporting png")
+    ("render", po::value<string>()->implicit_value(""), "[=cgal|quick] -for full geometry evaluation when exporting png, quick evaluates everything with Manifold in float precision")
     ("preview", po::value<string>()->implicit_value(""), "[=throwntogether] -for ThrownTogether preview png")
     ("animate", po::value<unsigned>(), "export N animated frames")
+    ("jobs", po::value<unsigned>(), "=n, export up to n animated frames or parameter sets concurrently (requires the manifold feature)")
+    ("threads", po::value<unsigned>(), "=n, use up to n threads for parallel operations, shared by concurrent exports (default 0, one per core)")
+    ("server", "render server mode: read render jobs as JSON lines from stdin and write one JSON result line per job to stdout, keeping caches between jobs")
+    ("batch", po::value<string>(), "=manifest, run the render jobs of a file in the JSON lines format of --server in one process, up to --jobs of them concurrently")
     ("view", po::value<CommaSeparatedVector>(), ("=view options: " + boost::algorithm::join(viewOptions.names(), " | ")).c_str())
     ("projection", po::value<string>(), "=(o)rtho or (p)erspective when exporting png")
+    ("gpu", po::value<string>(), "=n|auto, the EGL device rendering png images: its index, or auto to spread the renders of this process, e.g. the jobs of --server or --batch, and of concurrent processes over all devices")
     ("csglimit", po::value<unsigned int>(), "=n -stop rendering at n CSG elements when exporting png")
-    ("summary", po::value<vector<string>>(), "enable additional render summary and statistics: all | cache | time | camera | geometry | bounding-box | area")
+    ("summary", po::value<vector<string>>(), "enable additional render summary and statistics: all | cache | time | camera | geometry | bounding-box | area | profile | gc | memory | cache-misses")
     ("summary-file", po::value<string>(), "output summary information in JSON format to the given file, using '-' outputs to stdout")
+    ("profile-trace", po::value<string>(), "=file, write the time spent evaluating each node as a Chrome trace (chrome://tracing, Perfetto)")
+    ("profile-eval", po::value<string>(), "=file, write the time and allocations of function calls and module instantiations as a speedscope profile (https://www.speedscope.app)")
+    ("benchmark-backends", po::value<string>()->implicit_value(""), "[=file] before exporting, evaluate the design with each geometry backend and compare time, memory, facets and results, also as JSON to file if given")
+    ("distribute", po::value<vector<string>>(), "=command, a shell command starting a render server worker, e.g. \"ssh host openscad --server --cache-dir=dir\", which evaluates expensive subtrees into the --cache-dir shared with it (may be used several times)")
+    ("distribute-min-cost", po::value<double>(), "=n, estimated cost from which subtrees are worth distributing (default 1000)")
+    ("decimate-faces", po::value<size_t>(), "=n, decimate exported meshes to about n triangles, by quadric error edge collapses")
+    ("decimate-error", po::value<double>(), "=d, decimate exported meshes as long as the surface moves by less than about d")
+    ("slice-layers", po::value<string>(), "=start:step:end or =z1,z2,..., export the cross sections of the 3D result at these heights as numbered SVG or DXF files, e.g. out-1.svg, out-2.svg")
+    ("slice-single-file", "with --slice-layers, write all cross sections as the layers of one SVG or DXF file")
+    ("deps-only", "with -d, only write the dependency file: the design is instantiated, but nothing is evaluated or exported")
+    ("export-split", "write each top-level object to its own numbered file instead of uniting them, e.g. out-1.stl, out-2.stl; objects are evaluated concurrently where possible")
+    ("cache-dir", po::value<string>(), "=path, directory for a persistent geometry, library and font cache shared across runs")
+    ("cache-dir-size", po::value<size_t>(), "=n, size limit of the persistent geometry cache in MB (default 1024)")
+    ("max-memory", po::value<size_t>(), "=n, limit for the geometry held in memory in MB, evicting cached results as needed")
+    ("remote-cache", po::value<string>(), "=path, directory shared by several machines, e.g. a network share, which the --cache-dir falls back to and publishes costly results to")
+    ("remote-cache-min-time", po::value<double>(), "=seconds, evaluation time from which results are published to the --remote-cache (default 1)")
+    ("spill-dir", po::value<string>(), "=path, directory receiving the results evicted under --max-memory, unless --cache-dir is given")
     ("colorscheme", po::value<string>(), ("=colorscheme: " +
                                           str_join(ColorMap::inst()->colorSchemeNames(), " | ",
                                                    [](const std::string& colorScheme) {
@@ -1006,6 +1976,9 @@ int main(int argc, char **argv)
     ("x,x", po::value<string>(), "dxf_file deprecated, use -o")
 #ifdef ENABLE_PYTHON
   ("trust-python",  "Trust python")
+#endif
+#ifdef ENABLE_MICROBENCHMARKS
+  ("microbenchmark", po::value<string>()->implicit_value(""), "[=filter] time evaluator operations whose name contains filter, reporting ns and allocations per operation")
 #endif
   ;
 
@@ -1076,6 +2049,7 @@ int main(int argc, char **argv)
     if (vm["preview"].as<string>() == "throwntogether") viewOptions.renderer = RenderType::THROWNTOGETHER;
   } else if (vm.count("render")) {
     if (vm["render"].as<string>() == "cgal") viewOptions.renderer = RenderType::CGAL;
+    else if (vm["render"].as<string>() == "quick") viewOptions.renderer = RenderType::QUICK;
     else viewOptions.renderer = RenderType::GEOMETRY;
   }
 
@@ -1132,6 +2106,31 @@ int main(int argc, char **argv)
     }
   }
 
+  // Note: Must come after enabling features, since cache entries are specific to them
+  if (vm.count("cache-dir-size")) {
+    GeometryDiskCache::instance()->setMaxSizeMB(vm["cache-dir-size"].as<size_t>());
+  }
+  if (vm.count("cache-dir")) {
+    GeometryDiskCache::instance()->setDirectory(vm["cache-dir"].as<string>());
+    SourceFileDiskCache::instance()->setDirectory(vm["cache-dir"].as<string>());
+    FontCache::setIndexDirectory(vm["cache-dir"].as<string>());
+  } else if (vm.count("spill-dir")) {
+    GeometryDiskCache::instance()->setDirectory(vm["spill-dir"].as<string>(), false);
+  }
+  if (vm.count("remote-cache-min-time")) {
+    GeometryRemoteCache::instance()->setMinComputeTime(vm["remote-cache-min-time"].as<double>());
+  }
+  if (vm.count("remote-cache")) {
+    if (!vm.count("cache-dir")) {
+      LOG(message_group::Warning, "--remote-cache requires --cache-dir, ignoring it");
+    } else {
+      GeometryRemoteCache::instance()->setStore(std::make_unique<DirectoryStore>(vm["remote-cache"].as<string>()));
+    }
+  }
+  if (vm.count("max-memory")) {
+    MemoryLimit::instance()->setLimitMB(vm["max-memory"].as<size_t>());
+  }
+
   string parameterFile;
   if (vm.count("p")) {
     if (!parameterFile.empty()) {
@@ -1157,6 +2156,54 @@ int main(int argc, char **argv)
     arg_colorscheme = vm["colorscheme"].as<string>();
   }
 
+  if (vm.count("profile-trace")) {
+    arg_profile_trace = vm["profile-trace"].as<string>();
+    NodeProfiler::instance()->setEnabled(true);
+  }
+  if (vm.count("profile-eval")) {
+    arg_profile_eval = vm["profile-eval"].as<string>();
+    EvalProfiler::instance()->setEnabled(true);
+  }
+  if (vm.count("distribute")) {
+    arg_distribute = vm["distribute"].as<vector<string>>();
+  }
+  if (vm.count("distribute-min-cost")) {
+    arg_distribute_min_cost = vm["distribute-min-cost"].as<double>();
+  }
+  if (vm.count("export-split")) {
+    arg_export_split = true;
+  }
+  if (vm.count("deps-only")) {
+    if (!deps_output_file) {
+      LOG("--deps-only needs a dependency file given with -d.");
+      return 1;
+    }
+    arg_deps_only = true;
+  }
+  if (vm.count("slice-layers") && !parse_slice_heights(vm["slice-layers"].as<string>(), arg_slice_heights)) {
+    LOG("Invalid --slice-layers heights '%1$s', use start:step:end or a comma separated list.", vm["slice-layers"].as<string>());
+    return 1;
+  }
+  if (vm.count("decimate-faces")) {
+    arg_decimation.targetFaces = vm["decimate-faces"].as<size_t>();
+  }
+  if (vm.count("decimate-error")) {
+    arg_decimation.maxError = vm["decimate-error"].as<double>();
+  }
+  if (vm.count("slice-single-file")) {
+    arg_slice_single_file = true;
+  }
+  if (vm.count("benchmark-backends")) {
+    arg_benchmark_backends = true;
+    arg_benchmark_backends_file = vm["benchmark-backends"].as<string>();
+  }
+  if (vm.count("summary")) {
+    for (const auto& option : vm["summary"].as<vector<string>>()) {
+      if (option == RenderStatistic::PROFILE || option == RenderStatistic::MEMORY || option == "all") NodeProfiler::instance()->setEnabled(true);
+      if (option == RenderStatistic::CACHE_MISSES || option == "all") CacheMissRecorder::instance()->setEnabled(true);
+    }
+  }
+
   ExportFileFormatOptions exportFileFormatOptions;
   if (vm.count("export-format")) {
     const auto format = vm["export-format"].as<string>();
@@ -1173,13 +2220,35 @@ int main(int argc, char **argv)
   if (vm.count("animate")) {
     animate_frames = vm["animate"].as<unsigned>();
   }
+  unsigned jobs = 1;
+  if (vm.count("jobs")) {
+    jobs = std::max(vm["jobs"].as<unsigned>(), 1u);
+  }
+  if (vm.count("threads")) {
+    set_parallel_threads(vm["threads"].as<unsigned>());
+  }
+  if (vm.count("gpu")) {
+    const auto gpu = vm["gpu"].as<string>();
+    if (gpu == "auto") {
+      OffscreenContextFactory::selectDevicesRoundRobin();
+    } else {
+      try {
+        OffscreenContextFactory::selectDevice(lexical_cast<unsigned>(gpu));
+      } catch (const bad_lexical_cast&) {
+        LOG("Invalid --gpu option '%1$s', expected a device index or auto", gpu);
+        return 1;
+      }
+    }
+  }
 
-  Camera camera = get_camera(vm);
+  const auto cameras = get_cameras(vm);
 
   if (animate_frames) {
+    // Images are written one after another, e.g. to pipe them to a video encoder
     for (const auto& filename : output_files) {
-      if (filename == "-") {
-        LOG("Option --animate is not supported when exporting to stdout.");
+      const auto format = output_format(export_format, filename);
+      if (filename == "-" && !(format && isImage(*format))) {
+        LOG("Option --animate only supports png and rgba images when exporting to stdout.");
         return 1;
       }
     }
@@ -1188,6 +2257,46 @@ int main(int argc, char **argv)
     }
   }
 
+  if (cameras.size() > 1) {
+    for (const auto& filename : output_files) {
+      if (filename == "-") {
+        LOG("Several camera views are not supported when exporting to stdout.");
+        return 1;
+      }
+    }
+  }
+
+  if (vm.count("server")) {
+    if (!output_files.empty() || !inputFiles.empty() || animate_frames) help(argv[0], desc, true);
+    parser_init();
+    localization_init();
+    rc = server(original_path, viewOptions, cameras,
+                vm.count("summary") ? vm["summary"].as<std::vector<std::string>>() : std::vector<std::string>{});
+    GeometryRemoteCache::instance()->flush();
+    Builtins::instance(true);
+    return rc;
+  }
+
+#ifdef ENABLE_MICROBENCHMARKS
+  if (vm.count("microbenchmark")) {
+    parser_init();
+    rc = MicroBenchmark::run(vm["microbenchmark"].as<string>());
+    Builtins::instance(true);
+    return rc;
+  }
+#endif
+
+  if (vm.count("batch")) {
+    if (!output_files.empty() || !inputFiles.empty() || animate_frames) help(argv[0], desc, true);
+    parser_init();
+    localization_init();
+    rc = batch(vm["batch"].as<string>(), original_path, viewOptions, cameras,
+               vm.count("summary") ? vm["summary"].as<std::vector<std::string>>() : std::vector<std::string>{}, jobs);
+    GeometryRemoteCache::instance()->flush();
+    Builtins::instance(true);
+    return rc;
+  }
+
   auto cmdlinemode = false;
   if (!output_files.empty()) { // cmd-line mode
     cmdlinemode = true;
@@ -1196,13 +2305,28 @@ int main(int argc, char **argv)
 
   if (arg_info || cmdlinemode) {
     if (inputFiles.size() > 1) help(argv[0], desc, true);
+    StatCache::keepAll(true); // Nothing watches for changes while exporting
     try {
       parser_init();
       localization_init();
       if (arg_info) {
         rc = info();
       } else {
+        // Outputs sharing their geometry are all written from the evaluation for the first one
+        std::vector<std::vector<std::string>> exports;
+        std::vector<std::string> shared;
         for (const auto& filename : output_files) {
+          auto format = output_format(export_format, filename);
+          if (filename != "-" && !animate_frames && format && shares_evaluation(*format, viewOptions)) {
+            shared.push_back(filename);
+          } else {
+            exports.push_back({filename});
+          }
+        }
+        if (!shared.empty()) exports.push_back(shared);
+
+        for (const auto& filenames : exports) {
+          const auto& filename = filenames.front();
           const bool is_stdin = inputFiles[0] == "-";
           const std::string input_file = is_stdin ? "<stdin>" : inputFiles[0];
           const bool is_stdout = filename == "-";
@@ -1216,17 +2340,24 @@ int main(int argc, char **argv)
             parameterFile,
             parameterSet,
             viewOptions,
-            camera,
+            cameras,
             export_format,
             animate_frames,
+            jobs,
             vm.count("summary") ? vm["summary"].as<std::vector<std::string>>() : std::vector<std::string>{},
-            vm.count("summary-file") ? vm["summary-file"].as<std::string>() : ""
+            vm.count("summary-file") ? vm["summary-file"].as<std::string>() : "",
+            std::vector<std::string>(filenames.begin() + 1, filenames.end())
           };
           rc |= cmdline(cmd);
         }
       }
     } catch (const HardWarningException&) {
       rc = 1;
+    } catch (const MemoryLimitException&) {
+      rc = 1;
+    } catch (const ProgressCancelException&) {
+      LOG("Rendering cancelled.");
+      rc = 1;
     }
 
     if (deps_output_file) {
@@ -1248,6 +2379,8 @@ int main(int argc, char **argv)
     return 1;
   }
 
+  // Results still being published
+  GeometryRemoteCache::instance()->flush();
   Builtins::instance(true);
 
   return rc;
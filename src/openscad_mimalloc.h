@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 #ifdef USE_MIMALLOC
 
 #if 0 // defined(_WIN32) && defined(MI_LINK_SHARED)
@@ -12,6 +14,8 @@
 
 #if defined(ENABLE_CGAL)
 // gmp requires function signature with extra oldsize parameters for some reason.
+// mi_malloc() allocates from the calling thread's heap, so the numbers of
+// parallel evaluations don't contend for one heap.
 inline void *gmp_realloc(void *ptr, size_t /*oldsize*/, size_t newsize) { return mi_realloc(ptr, newsize); }
 inline void gmp_free(void *ptr, size_t /*oldsize*/) { mi_free(ptr); }
   #include <gmp.h>
@@ -19,3 +23,34 @@ inline void init_mimalloc() { mp_set_memory_functions(mi_malloc, gmp_realloc, gm
 #endif // ENABLE_CGAL
 
 #endif // USE_MIMALLOC
+
+struct AllocatorStatistics {
+  size_t committed{0};      // Bytes
+  size_t peak_committed{0}; // Bytes
+  size_t page_faults{0};
+};
+
+/*!
+   Returns the memory freed on the calling thread's heap, e.g. by the
+   temporaries of a finished subtree, to the system in bulk. The results
+   allocated on the thread stay valid, unlike with a heap of its own which is
+   destroyed.
+ */
+inline void release_thread_memory()
+{
+#ifdef USE_MIMALLOC
+  mi_collect(false);
+#endif
+}
+
+// Returns false without mimalloc
+inline bool get_allocator_statistics(AllocatorStatistics& statistics)
+{
+#ifdef USE_MIMALLOC
+  size_t elapsed, user, system, rss, peak_rss;
+  mi_process_info(&elapsed, &user, &system, &rss, &peak_rss, &statistics.committed, &statistics.peak_committed, &statistics.page_faults);
+  return true;
+#else
+  return false;
+#endif
+}
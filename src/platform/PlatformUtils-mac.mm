@@ -3,6 +3,7 @@
 #include <sstream>
 
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <sys/sysctl.h>
 #include <sys/utsname.h>
 #include <boost/lexical_cast.hpp>
@@ -53,6 +54,13 @@ unsigned long PlatformUtils::stackLimit()
   return STACK_LIMIT_DEFAULT;
 }
 
+uint64_t PlatformUtils::peakMemoryUsage()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return usage.ru_maxrss; // bytes, unlike on Linux
+}
+
 const std::string PlatformUtils::user_agent()
 {
   std::ostringstream result;
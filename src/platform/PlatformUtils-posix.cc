@@ -120,6 +120,13 @@ std::string PlatformUtils::userConfigPath()
   return "";
 }
 
+uint64_t PlatformUtils::peakMemoryUsage()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kilobytes
+}
+
 unsigned long PlatformUtils::stackLimit()
 {
   struct rlimit limit;
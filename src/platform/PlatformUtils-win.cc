@@ -18,6 +18,7 @@
 #define __IPreviewHandlerVisuals_INTERFACE_DEFINED__
 #define __IVisualProperties_INTERFACE_DEFINED__
 #include <shlobj.h>
+#include <psapi.h>
 
 #include "version.h"
 
@@ -115,6 +116,13 @@ unsigned long PlatformUtils::stackLimit()
   return STACK_LIMIT_DEFAULT;
 }
 
+uint64_t PlatformUtils::peakMemoryUsage()
+{
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+  return counters.PeakWorkingSetSize;
+}
+
 typedef BOOL (WINAPI *LPFN_ISWOW64PROCESS)(HANDLE, PBOOL);
 
 // see http://msdn.microsoft.com/en-us/library/windows/desktop/ms684139%28v=vs.85%29.aspx
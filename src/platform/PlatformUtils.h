@@ -96,6 +96,13 @@ int setenv(const char *name, const char *value, int overwrite);
  */
 unsigned long stackLimit();
 
+/**
+ * Peak resident memory of the process so far, 0 if unknown.
+ *
+ * @return peak memory use in bytes.
+ */
+uint64_t peakMemoryUsage();
+
 /**
  * Single character separating path specifications in a list
  * (e.g. OPENSCADPATH). On Windows that's ';' and on most other
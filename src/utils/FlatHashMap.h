@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+/*!
+   Hash map with open addressing and linear probing, for the many small keys
+   of vertex welding. The entries are stored inline in one array, so a lookup
+   usually touches a single cache line, where std::unordered_map follows a
+   pointer to a separately allocated node. Entries can't be erased.
+
+   The hash of a key can be computed ahead of time with hash(), e.g. in
+   parallel for a batch of keys, and passed to find() and emplace().
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class FlatHashMap
+{
+public:
+  using value_type = std::pair<K, V>;
+
+private:
+  struct Slot {
+    value_type entry;
+    bool used{false};
+  };
+
+public:
+  class const_iterator
+  {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename FlatHashMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const value_type *;
+    using reference = const value_type&;
+
+    const_iterator(const Slot *slot, const Slot *end) : slot(slot), end(end) { skip(); }
+    reference operator*() const { return slot->entry; }
+    pointer operator->() const { return &slot->entry; }
+    const_iterator& operator++() { ++slot; skip(); return *this; }
+    bool operator==(const const_iterator& other) const { return slot == other.slot; }
+    bool operator!=(const const_iterator& other) const { return slot != other.slot; }
+
+private:
+    void skip() { while (slot != end && !slot->used) ++slot; }
+    const Slot *slot;
+    const Slot *end;
+  };
+
+  FlatHashMap() = default;
+
+  [[nodiscard]] size_t size() const { return this->count; }
+  [[nodiscard]] bool empty() const { return this->count == 0; }
+  void clear() { this->slots.clear(); this->count = 0; }
+  void reserve(size_t n) { if (n * 2 > this->slots.size()) rehash(n * 2); }
+
+  // Mixes the bits of the key's hash, as the slot is taken from its low bits
+  static size_t hash(const K& key) {
+    uint64_t h = Hash()(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  const value_type *find(const K& key, size_t h) const {
+    if (this->slots.empty()) return nullptr;
+    const size_t mask = this->slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+      const Slot& slot = this->slots[i];
+      if (!slot.used) return nullptr;
+      if (slot.entry.first == key) return &slot.entry;
+    }
+  }
+  const value_type *find(const K& key) const { return find(key, hash(key)); }
+
+  /*!
+     Inserts the entry unless the key is already there. Returns the entry for
+     the key, and whether it was inserted. Earlier pointers to entries may be
+     invalidated by an insertion.
+   */
+  std::pair<value_type *, bool> emplace(const K& key, V value, size_t h) {
+    if ((this->count + 1) * 2 > this->slots.size()) rehash(std::max<size_t>(16, this->slots.size() * 2));
+    const size_t mask = this->slots.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+      Slot& slot = this->slots[i];
+      if (!slot.used) {
+        slot.entry = value_type(key, std::move(value));
+        slot.used = true;
+        ++this->count;
+        return {&slot.entry, true};
+      }
+      if (slot.entry.first == key) return {&slot.entry, false};
+    }
+  }
+  std::pair<value_type *, bool> emplace(const K& key, V value) { return emplace(key, std::move(value), hash(key)); }
+
+  V& operator[](const K& key) { return emplace(key, V()).first->second; }
+
+  [[nodiscard]] const_iterator begin() const { return {this->slots.data(), this->slots.data() + this->slots.size()}; }
+  [[nodiscard]] const_iterator end() const { return {this->slots.data() + this->slots.size(), this->slots.data() + this->slots.size()}; }
+
+private:
+  // Capacity is kept at a power of two, at most half full
+  void rehash(size_t capacity) {
+    size_t n = 16;
+    while (n < capacity) n *= 2;
+    std::vector<Slot> old(n);
+    old.swap(this->slots);
+    this->count = 0;
+    for (auto& slot : old) {
+      if (slot.used) emplace(slot.entry.first, std::move(slot.entry.second));
+    }
+  }
+
+  std::vector<Slot> slots;
+  size_t count{0};
+};
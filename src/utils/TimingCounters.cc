@@ -0,0 +1,51 @@
+#include "TimingCounters.h"
+
+std::array<TimingCounters::Totals, TimingCounters::NUM_COUNTERS> TimingCounters::counters;
+
+namespace {
+
+thread_local std::array<int, TimingCounters::NUM_COUNTERS> depth{};
+
+} // namespace
+
+TimingCounters::Scope::Scope(Counter counter) : counter(counter), outermost(depth[counter]++ == 0)
+{
+  if (this->outermost) this->start = std::chrono::steady_clock::now();
+}
+
+TimingCounters::Scope::~Scope()
+{
+  --depth[this->counter];
+  if (!this->outermost) return;
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count();
+  auto& totals = counters[this->counter];
+  totals.ns.fetch_add(ns, std::memory_order_relaxed);
+  totals.calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+const char *TimingCounters::name(Counter counter)
+{
+  switch (counter) {
+  case PARSE: return "parse";
+  case INSTANTIATE: return "instantiate";
+  case CSG_TREE: return "csg_tree";
+  case NORMALIZE: return "normalize";
+  case GEOMETRY: return "geometry";
+  case NEF_CONVERSION: return "nef_conversion";
+  case COREFINEMENT: return "corefinement";
+  case MANIFOLD: return "manifold";
+  case CLIPPER: return "clipper";
+  case TESSELLATION: return "tessellation";
+  case QUANTIZE: return "quantize";
+  case EXPORT: return "export";
+  default: return "unknown";
+  }
+}
+
+void TimingCounters::clear()
+{
+  for (auto& totals : counters) {
+    totals.ns.store(0, std::memory_order_relaxed);
+    totals.calls.store(0, std::memory_order_relaxed);
+  }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/*!
+   Always-on timers for the main stages of a job and the geometry kernels,
+   reported by --summary time.
+
+   A Scope adds the time until it is destroyed to its counter. Only the
+   outermost Scope of a counter on each thread counts, so recursive calls
+   aren't counted twice. Counters are summed over all threads, and kernels
+   nest in the stages (and in each other, e.g. a Nef conversion tessellates),
+   so the totals don't add up to the wall time.
+ */
+class TimingCounters
+{
+public:
+  enum Counter {
+    // Stages
+    PARSE,
+    INSTANTIATE,
+    CSG_TREE,
+    NORMALIZE,
+    GEOMETRY,
+    // Kernels
+    NEF_CONVERSION,
+    COREFINEMENT,
+    MANIFOLD,
+    CLIPPER,
+    TESSELLATION,
+    QUANTIZE,
+    EXPORT,
+    NUM_COUNTERS
+  };
+
+  class Scope
+  {
+public:
+    Scope(Counter counter);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+private:
+    Counter counter;
+    bool outermost;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  static const char *name(Counter counter);
+  static bool isStage(Counter counter) { return counter < NEF_CONVERSION; }
+  static int64_t nanoseconds(Counter counter) { return counters[counter].ns.load(std::memory_order_relaxed); }
+  static uint64_t calls(Counter counter) { return counters[counter].calls.load(std::memory_order_relaxed); }
+  static void clear();
+
+private:
+  struct Totals {
+    std::atomic<int64_t> ns{0};
+    std::atomic<uint64_t> calls{0};
+  };
+  static std::array<Totals, NUM_COUNTERS> counters;
+};
@@ -68,3 +68,9 @@ class HardWarningException : public EvaluationException
 public:
   HardWarningException(const std::string& what_arg) : EvaluationException(what_arg) {}
 };
+
+class MemoryLimitException : public EvaluationException
+{
+public:
+  MemoryLimitException(const std::string& what_arg) : EvaluationException(what_arg) {}
+};
@@ -1,5 +1,99 @@
 #include "hash.h"
 #include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix64(uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+const uint64_t c1 = 0x87c37b91114253d5ULL;
+const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+inline uint64_t mixk1(uint64_t k1)
+{
+  k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2;
+  return k1;
+}
+
+inline uint64_t mixk2(uint64_t k2)
+{
+  k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1;
+  return k2;
+}
+
+} // namespace
+
+std::string Hash128::toString() const
+{
+  std::ostringstream stream;
+  stream << *this;
+  return stream.str();
+}
+
+std::ostream& operator<<(std::ostream& stream, const Hash128& hash)
+{
+  const auto flags = stream.flags();
+  const auto fill = stream.fill();
+  stream << std::hex << std::setfill('0') << std::setw(16) << hash.h1 << std::setw(16) << hash.h2;
+  stream.flags(flags);
+  stream.fill(fill);
+  return stream;
+}
+
+/*!
+   MurmurHash3 x64_128 by Austin Appleby (public domain).
+   Note: Blocks are read in native byte order, so hashes are only comparable
+   between machines of the same endianness.
+ */
+Hash128 hash128(const void *data, size_t len, uint64_t seed)
+{
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  const size_t nblocks = len / 16;
+  uint64_t h1 = seed;
+  uint64_t h2 = seed;
+
+  for (size_t i = 0; i < nblocks; ++i) {
+    uint64_t k1, k2;
+    std::memcpy(&k1, bytes + i * 16, sizeof(k1));
+    std::memcpy(&k2, bytes + i * 16 + 8, sizeof(k2));
+
+    h1 ^= mixk1(k1);
+    h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+    h2 ^= mixk2(k2);
+    h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+  }
+
+  const uint8_t *tail = bytes + nblocks * 16;
+  const size_t rem = len & 15;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  for (size_t i = rem; i > 8; --i) k2 ^= uint64_t(tail[i - 1]) << ((i - 9) * 8);
+  if (rem > 8) h2 ^= mixk2(k2);
+  for (size_t i = std::min<size_t>(rem, 8); i > 0; --i) k1 ^= uint64_t(tail[i - 1]) << ((i - 1) * 8);
+  if (rem > 0) h1 ^= mixk1(k1);
+
+  h1 ^= len; h2 ^= len;
+  h1 += h2; h2 += h1;
+  h1 = fmix64(h1); h2 = fmix64(h2);
+  h1 += h2; h2 += h1;
+  return {h1, h2};
+}
 
 namespace std {
 std::size_t hash<Vector3f>::operator()(const Vector3f& s) const {
@@ -1,13 +1,38 @@
 #pragma once
 
+#include <cstdint>
+#include <ostream>
+#include <string>
 #include "linalg.h"
 
 using Vector3l = Eigen::Matrix<int64_t, 3, 1>;
 
+/*!
+   A 128-bit hash value.
+
+   Used as a compact key for data which would otherwise be identified
+   by a (potentially very large) string, e.g. node subtrees in the geometry caches.
+ */
+struct Hash128
+{
+  uint64_t h1{0};
+  uint64_t h2{0};
+
+  bool operator==(const Hash128& other) const { return h1 == other.h1 && h2 == other.h2; }
+  bool operator!=(const Hash128& other) const { return !(*this == other); }
+  [[nodiscard]] std::string toString() const;
+};
+
+std::ostream& operator<<(std::ostream& stream, const Hash128& hash);
+
+// MurmurHash3 (x64, 128-bit variant)
+Hash128 hash128(const void *data, size_t len, uint64_t seed = 0);
+
 namespace std {
 template <> struct hash<Vector3f> { std::size_t operator()(const Vector3f& s) const; };
 template <> struct hash<Vector3d> { std::size_t operator()(const Vector3d& s) const; };
 template <> struct hash<Vector3l> { std::size_t operator()(const Vector3l& s) const; };
+template <> struct hash<Hash128> { std::size_t operator()(const Hash128& s) const { return s.h1; } };
 }
 
 namespace Eigen {
@@ -0,0 +1,45 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+#ifdef ENABLE_TBB
+#include <tbb/global_control.h>
+#include <tbb/task_arena.h>
+#endif
+
+namespace {
+
+#ifdef ENABLE_TBB
+std::unique_ptr<tbb::global_control> thread_limit;
+#endif
+
+} // namespace
+
+bool parallel_enabled()
+{
+  static const bool enabled = !getenv("OPENSCAD_NO_PARALLEL");
+  return enabled;
+}
+
+void set_parallel_threads(unsigned threads)
+{
+#ifdef ENABLE_TBB
+  thread_limit.reset();
+  if (threads > 0) {
+    thread_limit = std::make_unique<tbb::global_control>(tbb::global_control::max_allowed_parallelism, threads);
+  }
+#endif
+}
+
+unsigned parallel_threads()
+{
+#ifdef ENABLE_TBB
+  if (!parallel_enabled()) return 1;
+  return std::max(1, std::min(tbb::this_task_arena::max_concurrency(),
+                              static_cast<int>(tbb::global_control::active_value(tbb::global_control::max_allowed_parallelism))));
+#else
+  return 1;
+#endif
+}
@@ -1,11 +1,27 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+
 #ifdef ENABLE_TBB
 #include <thrust/transform.h>
+#include <thrust/sort.h>
 #include <thrust/functional.h>
 #include <thrust/execution_policy.h>
+#include <thrust/iterator/counting_iterator.h>
 #endif
 
+/*!
+   The parallel operations all run on the TBB thread pool of the process, so
+   nested ones share its threads instead of oversubscribing the cores.
+   Setting OPENSCAD_NO_PARALLEL runs them serially.
+ */
+bool parallel_enabled();
+// Limits the threads of the pool, 0 for one per core
+void set_parallel_threads(unsigned threads);
+// The number of threads parallel operations may use
+unsigned parallel_threads();
+
 template <class InputIterator, class OutputIterator, class Operation>
 void parallelizable_transform(
   const InputIterator begin1, const InputIterator end1,
@@ -13,7 +29,7 @@ void parallelizable_transform(
   const Operation &op)
 {
 #ifdef ENABLE_TBB
-  if (!getenv("OPENSCAD_NO_PARALLEL")) {
+  if (parallel_enabled()) {
     thrust::transform(begin1, end1, out, op);
   }
   else
@@ -23,6 +39,7 @@ void parallelizable_transform(
   }
 }
 
+// The pairs are indexed from the random access containers, in row-major order
 template <class Container1, class Container2, class OutputIterator, class Operation>
 void parallelizable_cross_product_transform(
   const Container1 &cont1,
@@ -31,21 +48,10 @@ void parallelizable_cross_product_transform(
   const Operation &op)
 {
 #ifdef ENABLE_TBB
-  if (!getenv("OPENSCAD_NO_PARALLEL")) {
-    struct ReferencePair {
-      decltype(*cont1.begin()) first;
-      decltype(*cont2.begin()) second;
-      ReferencePair(decltype(*cont1.begin()) first, decltype(*cont2.begin()) second) : first(first), second(second) {}
-    };
-    std::vector<ReferencePair> pairs;
-    pairs.reserve(cont1.size() * cont2.size());
-    for (const auto &v1 : cont1) {
-      for (const auto &v2 : cont2) {
-        pairs.emplace_back(v1, v2);
-      }
-    }
-    thrust::transform(pairs.begin(), pairs.end(), out, [&](const auto &pair) {
-      return op(pair.first, pair.second);
+  if (parallel_enabled()) {
+    const size_t columns = cont2.size();
+    thrust::transform(thrust::counting_iterator<size_t>(0), thrust::counting_iterator<size_t>(cont1.size() * columns), out, [&](size_t i) {
+      return op(cont1.begin()[i / columns], cont2.begin()[i % columns]);
     });
   }
   else
@@ -57,4 +63,20 @@ void parallelizable_cross_product_transform(
       }
     }
   }
-}
\ No newline at end of file
+}
+
+template <class RandomAccessIterator, class Compare>
+void parallelizable_sort(
+  const RandomAccessIterator begin, const RandomAccessIterator end,
+  const Compare &comp)
+{
+#ifdef ENABLE_TBB
+  if (parallel_enabled()) {
+    thrust::sort(begin, end, comp);
+  }
+  else
+#endif
+  {
+    std::sort(begin, end, comp);
+  }
+}
@@ -1,6 +1,7 @@
 #include "printutils.h"
 #include <sstream>
 #include <cstdio>
+#include <mutex>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/circular_buffer.hpp>
@@ -12,6 +13,7 @@ namespace fs = boost::filesystem;
 
 std::set<std::string> printedDeprecations;
 std::list<std::string> print_messages_stack;
+size_t print_message_count = 0;
 std::list<struct Message> log_messages_stack;
 OutputHandlerFunc *outputhandler = nullptr;
 OutputHandlerFunc2 *outputhandler2 = nullptr;
@@ -32,6 +34,8 @@ int count = 0;
 namespace {
 bool no_throw;
 bool deferred;
+// Messages may be printed from several geometry evaluation threads
+std::recursive_mutex print_mutex;
 }
 
 void set_output_handler(OutputHandlerFunc *newhandler, OutputHandlerFunc2 *newhandler2, void *userdata)
@@ -75,6 +79,8 @@ void print_messages_pop()
 void PRINT(const Message& msgObj)
 {
   if (msgObj.msg.empty() && msgObj.group != message_group::Echo) return;
+  std::lock_guard<std::recursive_mutex> lock(print_mutex);
+  ++print_message_count;
 
   if (print_messages_stack.size() > 0) {
     if (!print_messages_stack.back().empty()) {
@@ -96,6 +102,7 @@ void PRINT(const Message& msgObj)
 void PRINT_NOCACHE(const Message& msgObj)
 {
   if (msgObj.msg.empty() && msgObj.group != message_group::Echo) return;
+  std::lock_guard<std::recursive_mutex> lock(print_mutex);
 
   const auto msg = msgObj.str();
 
@@ -110,7 +117,8 @@ void PRINT_NOCACHE(const Message& msgObj)
   if (!deferred)
     if (!OpenSCAD::quiet || msgObj.group == message_group::Error) {
       if (!outputhandler) {
-        std::cerr << msg << "\n";
+        // std::cerr is unbuffered, so write each message at once
+        std::cerr << msg + "\n";
       } else {
         outputhandler(msgObj, outputhandler_data);
       }
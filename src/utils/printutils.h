@@ -96,6 +96,8 @@ void no_exceptions_for_warnings();
 bool would_have_thrown();
 
 extern std::list<std::string> print_messages_stack;
+// Number of messages passed to PRINT so far, used to detect side effects of evaluations
+extern size_t print_message_count;
 void print_messages_push();
 void print_messages_pop();
 void resetSuppressedMessages();
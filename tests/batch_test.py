@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+
+# Batch mode test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Write a manifest of jobs exporting the input file with different -D assignments and formats.
+# step 2. Run OpenSCAD with --batch on the manifest, and check that every job reports success.
+# step 3. Export each job on its own, and check that the batch wrote the same files.
+# step 4. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD in all runs, e.g. --jobs=<n>
+# for the batch run of jobs in parallel.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse, json
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('batch_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting batch_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = os.path.abspath(remaining_args[0])
+outputfile = os.path.abspath(remaining_args[-1])
+openscad_args = remaining_args[1:-1]
+# --jobs only applies to the batch run
+single_args = [arg for arg in openscad_args if not arg.startswith('--jobs')]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+# Output suffix, export format and assignments of each job
+jobs = [
+    ('stl', 'asciistl', ['size=1']),
+    ('stl', 'asciistl', ['size=2']),
+    ('off', None, ['size=3']),
+    ('stl', 'asciistl', ['size=2', 'offset=5']),
+    ('echo', None, ['size=4']),
+]
+manifest = basename + '-manifest.json'
+with open(manifest, 'w') as f:
+    for i, (suffix, format, assignments) in enumerate(jobs):
+        job = {'id': i, 'input': inputfile, 'output': '%s-%d-batch.%s' % (basename, i, suffix), 'D': assignments}
+        if format: job['format'] = format
+        f.write(json.dumps(job) + '\n')
+
+cmd = [args.openscad, '--batch=' + manifest] + openscad_args
+print(' '.join(cmd), file=sys.stderr)
+sys.stderr.flush()
+proc = subprocess.Popen(cmd, stdout=subprocess.PIPE)
+stdout, _ = proc.communicate()
+if proc.returncode != 0:
+    failquit('OpenSCAD failed with return code ' + str(proc.returncode))
+results = [json.loads(line) for line in stdout.decode('utf-8').splitlines() if line.startswith('{')]
+if sorted(result.get('id') for result in results) != list(range(len(jobs))):
+    failquit('expected one result per job, got: ' + str(results))
+for result in results:
+    if result['rc'] != 0 or 'error' in result:
+        failquit('batch job failed: ' + str(result))
+
+for i, (suffix, format, assignments) in enumerate(jobs):
+    batchfile = '%s-%d-batch.%s' % (basename, i, suffix)
+    singlefile = '%s-%d-single.%s' % (basename, i, suffix)
+    single_cmd = [args.openscad, inputfile, '-o', singlefile]
+    if format: single_cmd += ['--export-format', format]
+    for assignment in assignments: single_cmd += ['-D', assignment]
+    run(single_cmd + single_args)
+    if not os.path.exists(batchfile):
+        failquit('batch job %d wrote no output' % i)
+    with open(batchfile) as b, open(singlefile) as s:
+        if b.read() != s.read():
+            failquit('batch job %d wrote different output than a single run' % i)
+    os.unlink(batchfile)
+    os.unlink(singlefile)
+os.unlink(manifest)
+
+with open(outputfile, 'w') as f:
+    f.write('%d jobs match\n' % len(jobs))
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+
+# Performance regression test
+#
+# Usage: benchmark.py --openscad=<executable-path> --baseline-dir=<dir>
+#                     [--output-dir=<dir>] [--runs=<n>] [--tolerance=<fraction>]
+#                     [--max-time-ms=<ms>] [-s <suffix>] [-t <testname>] <inputfile> [openscad args]
+#
+# Exports the input file, and records the wall time, the peak memory use of
+# the OpenSCAD process and the cache statistics from --summary-file. The fastest
+# of the runs is compared against the baseline <testname>.json in the baseline
+# dir, the test fails if time or memory grew by more than the tolerance.
+#
+# If no baseline exists, or the -g option is given, or the TEST_GENERATE
+# environment variable is set to 1, the results are stored as the new baseline.
+# Timings depend on the machine, so baselines are kept per build rather than
+# in the source tree.
+#
+# With --max-time-ms, the test also fails if the fastest run took longer, with
+# or without a baseline, e.g. for a budget on the startup time checked in CI.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, json, time, subprocess, argparse
+
+try:
+    import resource
+except ImportError:
+    resource = None # Windows, peak memory isn't recorded
+
+def failquit(*args):
+    if len(args)!=0: print(*args)
+    print('benchmark.py args:', str(sys.argv))
+    print('exiting benchmark.py with failure')
+    sys.exit(1)
+
+def peak_rss_kb(rusage):
+    # ru_maxrss is in bytes on macOS, in kilobytes elsewhere
+    return rusage.ru_maxrss // 1024 if sys.platform == 'darwin' else rusage.ru_maxrss
+
+def run_once(cmd, summaryfile):
+    if os.path.exists(summaryfile): os.remove(summaryfile)
+    start = time.perf_counter()
+    proc = subprocess.Popen(cmd)
+    if resource is not None and hasattr(os, 'wait4'):
+        _, status, rusage = os.wait4(proc.pid, 0)
+        proc.returncode = os.waitstatus_to_exitcode(status) if hasattr(os, 'waitstatus_to_exitcode') else status >> 8
+        rss = peak_rss_kb(rusage)
+    else:
+        proc.wait()
+        rss = None
+    elapsed = time.perf_counter() - start
+    if proc.returncode != 0:
+        failquit('OpenSCAD failed with return code ' + str(proc.returncode))
+
+    result = {'time_ms': round(elapsed * 1000), 'peak_rss_kb': rss}
+    try:
+        with open(summaryfile) as f:
+            summary = json.load(f)
+        if 'cache' in summary: result['cache'] = summary['cache']
+        if 'time' in summary: result['render_time'] = summary['time']
+    except (OSError, ValueError) as e:
+        print('Could not read summary file ' + summaryfile + ': ' + str(e))
+    return result
+
+def compare(name, actual, expected, tolerance, unit):
+    if actual is None or expected is None or expected <= 0:
+        return True
+    ratio = actual / expected
+    print('%-12s %10d %s, baseline %10d %s (%+.1f%%)' % (name, actual, unit, expected, unit, (ratio - 1) * 100))
+    if ratio > 1 + tolerance:
+        print('  regression: more than %d%% above the baseline' % round(tolerance * 100))
+        return False
+    if ratio < 1 - tolerance:
+        print('  improvement: consider updating the baseline with TEST_GENERATE=1')
+    return True
+
+#
+# Parse arguments
+#
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+parser.add_argument('--baseline-dir', required=True, help='Directory of the baseline results')
+parser.add_argument('--output-dir', default='.', help='Directory for the exported and result files')
+parser.add_argument('--runs', type=int, default=3, help='Number of runs, the fastest is compared')
+parser.add_argument('--tolerance', type=float, default=0.25, help='Allowed increase, as a fraction of the baseline')
+parser.add_argument('--max-time-ms', type=int, help='Fail if the fastest run takes longer, regardless of the baseline')
+parser.add_argument('-s', dest='suffix', default='stl', help='Suffix of openscad export filetype')
+parser.add_argument('-t', dest='testname', help='Name of the test, default to the input file name')
+parser.add_argument('-g', '--generate', action='store_true', help='Store the results as the new baseline')
+
+args, remaining_args = parser.parse_known_args()
+if not remaining_args: failquit('no input file given')
+
+inputfile = remaining_args[0]
+openscad_args = remaining_args[1:]
+generate = args.generate or bool(os.getenv("TEST_GENERATE"))
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+testname = args.testname or os.path.splitext(os.path.basename(inputfile))[0]
+os.makedirs(args.output_dir, exist_ok=True)
+outputfile = os.path.join(args.output_dir, testname + '.' + args.suffix)
+summaryfile = os.path.join(args.output_dir, testname + '-summary.json')
+actualfile = os.path.join(args.output_dir, testname + '-actual.json')
+baselinefile = os.path.join(args.baseline_dir, testname + '.json')
+
+# Use the fonts shipped with the tests, like test_cmdline_tool.py
+fontdir = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'data', 'ttf')
+os.environ.setdefault('OPENSCAD_FONT_PATH', fontdir)
+
+cmd = [args.openscad, inputfile, '-o', outputfile, '--summary', 'cache', '--summary', 'time', '--summary-file', summaryfile] + openscad_args
+print('Running OpenSCAD %d times:' % args.runs)
+print(' '.join(cmd))
+sys.stdout.flush()
+
+runs = [run_once(cmd, summaryfile) for i in range(max(1, args.runs))]
+actual = min(runs, key=lambda r: r['time_ms'])
+rss = [r['peak_rss_kb'] for r in runs if r['peak_rss_kb'] is not None]
+actual['peak_rss_kb'] = max(rss) if rss else None
+actual['runs'] = [r['time_ms'] for r in runs]
+with open(actualfile, 'w') as f:
+    json.dump(actual, f, indent=2)
+
+within_budget = True
+if args.max_time_ms is not None:
+    print('%-12s %10d ms, budget   %10d ms' % ('wall time', actual['time_ms'], args.max_time_ms))
+    within_budget = actual['time_ms'] <= args.max_time_ms
+    if not within_budget: print('  over budget')
+
+if generate or not os.path.exists(baselinefile):
+    os.makedirs(args.baseline_dir, exist_ok=True)
+    with open(baselinefile, 'w') as f:
+        json.dump(actual, f, indent=2)
+    print('Stored baseline ' + baselinefile + ': %d ms, %s kB' % (actual['time_ms'], actual['peak_rss_kb']))
+    if not within_budget: failquit('wall time over the budget of %d ms, see %s' % (args.max_time_ms, actualfile))
+    sys.exit(0)
+
+with open(baselinefile) as f:
+    expected = json.load(f)
+
+ok = compare('wall time', actual['time_ms'], expected.get('time_ms'), args.tolerance, 'ms')
+ok = compare('peak memory', actual['peak_rss_kb'], expected.get('peak_rss_kb'), args.tolerance, 'kB') and ok
+
+# Cache statistics are only reported, they explain a change rather than being one
+for cache, stats in sorted(actual.get('cache', {}).items()):
+    before = expected.get('cache', {}).get(cache, {})
+    print('%-16s %s' % (cache, ', '.join('%s %s (baseline %s)' % (k, v, before.get(k, '-')) for k, v in sorted(stats.items()))))
+
+if not within_budget: failquit('wall time over the budget of %d ms, see %s' % (args.max_time_ms, actualfile))
+if not ok: failquit('performance regression, see ' + actualfile + ' and ' + baselinefile)
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+
+# Mesh decimation test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [--decimate-faces=<n>] [--decimate-error=<d>] [<openscad args>] file.txt
+#
+# step 1. Export the input file to ASCII STL, without and with the given decimation.
+# step 2. Check that the decimated mesh is closed, has no more than the target faces
+#         and that its vertices are within about the error bound of the original mesh.
+# step 3. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD in both exports.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse
+from validatestl import read_stl, validateSTL
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('decimate_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting decimate_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+def sub(a, b): return [a[0] - b[0], a[1] - b[1], a[2] - b[2]]
+def dot(a, b): return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+def mad(a, b, s): return [a[0] + b[0] * s, a[1] + b[1] * s, a[2] + b[2] * s]
+
+def closest_point(p, a, b, c):
+    # Closest point on triangle abc, by its Voronoi regions (Ericson, Real-Time Collision Detection)
+    ab, ac, ap = sub(b, a), sub(c, a), sub(p, a)
+    d1, d2 = dot(ab, ap), dot(ac, ap)
+    if d1 <= 0 and d2 <= 0: return a
+    bp = sub(p, b)
+    d3, d4 = dot(ab, bp), dot(ac, bp)
+    if d3 >= 0 and d4 <= d3: return b
+    vc = d1 * d4 - d3 * d2
+    if vc <= 0 and d1 >= 0 and d3 <= 0: return mad(a, ab, d1 / (d1 - d3))
+    cp = sub(p, c)
+    d5, d6 = dot(ab, cp), dot(ac, cp)
+    if d6 >= 0 and d5 <= d6: return c
+    vb = d5 * d2 - d1 * d6
+    if vb <= 0 and d2 >= 0 and d6 <= 0: return mad(a, ac, d2 / (d2 - d6))
+    va = d3 * d6 - d5 * d4
+    if va <= 0 and d4 - d3 >= 0 and d5 - d6 >= 0:
+        return mad(b, sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6)))
+    denom = 1.0 / (va + vb + vc)
+    return mad(mad(a, ab, vb * denom), ac, vc * denom)
+
+def distance_to_mesh(p, triangles, limit):
+    # Only triangles with a bounding box near the point can be closer than the limit
+    best = float('inf')
+    for t, lo, hi in triangles:
+        if any(p[i] < lo[i] - limit or p[i] > hi[i] + limit for i in range(3)):
+            continue
+        q = sub(p, closest_point(p, *t))
+        best = min(best, dot(q, q) ** 0.5)
+    return best
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+parser.add_argument('--decimate-faces', dest='faces', type=int, default=0)
+parser.add_argument('--decimate-error', dest='error', type=float, default=0)
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+if args.faces == 0 and args.error == 0:
+    failquit('needs --decimate-faces or --decimate-error')
+
+decimate_args = []
+if args.faces > 0: decimate_args.append('--decimate-faces=%d' % args.faces)
+if args.error > 0: decimate_args.append('--decimate-error=%g' % args.error)
+
+basename = os.path.splitext(outputfile)[0]
+originalfile = basename + '-original.stl'
+decimatedfile = basename + '-decimated.stl'
+run([args.openscad, inputfile, '-o', originalfile, '--export-format', 'asciistl'] + openscad_args)
+run([args.openscad, inputfile, '-o', decimatedfile, '--export-format', 'asciistl'] + decimate_args + openscad_args)
+
+if not validateSTL(decimatedfile):
+    failquit('decimated mesh is not closed')
+original = read_stl(originalfile)
+decimated = read_stl(decimatedfile)
+if len(decimated.triangles) >= len(original.triangles):
+    failquit('decimation kept all %d faces' % len(original.triangles))
+if args.faces > 0 and len(decimated.triangles) > args.faces:
+    failquit('decimated mesh has %d faces, more than the target %d' % (len(decimated.triangles), args.faces))
+
+if args.error > 0:
+    # The quadric error bounds the distance to the planes of the merged faces,
+    # which is about the distance to the original surface
+    limit = 2 * args.error
+    triangles = []
+    for t in original.triangles:
+        corners = [original.points[i] for i in t]
+        triangles.append((corners, [min(c[i] for c in corners) for i in range(3)],
+                          [max(c[i] for c in corners) for i in range(3)]))
+    for p in decimated.points:
+        d = distance_to_mesh(p, triangles, limit)
+        if d > limit:
+            failquit('decimated vertex %s is %g from the original mesh, more than %g' % (str(p), d, limit))
+
+os.unlink(originalfile)
+os.unlink(decimatedfile)
+
+with open(outputfile, 'w') as f:
+    f.write('decimated mesh is closed and within its bounds\n')
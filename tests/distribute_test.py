@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+
+# Subtree distribution test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Export the input file to ASCII STL serially.
+# step 2. Export it with --distribute to two local render server workers sharing a new cache directory.
+# step 3. Export it with --distribute to a worker which fails without writing any results,
+#         so all subtrees are evaluated locally instead.
+# step 4. Check that both distributed exports hold the same triangles as the serial export.
+# step 5. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD and the workers.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse, shlex, shutil, tempfile
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('distribute_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting distribute_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+def read_triangles(filename):
+    # Triangles as sorted tuples of their rotated vertex lines, to compare regardless of order
+    triangles, triangle = [], []
+    with open(filename) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith('vertex'):
+                triangle.append(line)
+            elif line.startswith('endfacet'):
+                first = triangle.index(min(triangle))
+                triangles.append(tuple(triangle[first:] + triangle[:first]))
+                triangle = []
+    return sorted(triangles)
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = os.path.abspath(remaining_args[0])
+outputfile = os.path.abspath(remaining_args[-1])
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+serialfile = basename + '-serial.stl'
+run([args.openscad, inputfile, '-o', serialfile, '--export-format', 'asciistl'] + openscad_args)
+serial = read_triangles(serialfile)
+
+lines = []
+for name, broken in [('workers', False), ('failing-worker', True)]:
+    cachedir = tempfile.mkdtemp(prefix='distribute-')
+    distributedfile = '%s-%s.stl' % (basename, name)
+    worker = ' '.join(shlex.quote(arg) for arg in [args.openscad, '--server', '--cache-dir=' + cachedir] + openscad_args)
+    workers = ['false'] if broken else [worker, worker]
+    cmd = [args.openscad, inputfile, '-o', distributedfile, '--export-format', 'asciistl',
+           '--cache-dir=' + cachedir, '--distribute-min-cost=5'] + ['--distribute=' + w for w in workers] + openscad_args
+    run(cmd)
+    if read_triangles(distributedfile) != serial:
+        failquit('export with %s differs from the serial export' % name)
+    lines.append('%s: same as serial' % name)
+    os.unlink(distributedfile)
+    shutil.rmtree(cachedir, ignore_errors=True)
+os.unlink(serialfile)
+
+with open(outputfile, 'w') as f:
+    f.write('\n'.join(lines) + '\n')
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+
+# Streaming 3MF export test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Export the input file to 3MF, and to ASCII STL.
+# step 2. Check the 3MF archive: the CRCs and sizes of all entries, which are written
+#         in data descriptors, and that the model XML of the concatenated deflate chunks parses.
+# step 3. Check that the objects of the model have as many triangles and the same volume as the STL.
+# step 4. (done in CTest) - compare the written result to the expected output.
+#
+# Use inputs with more vertices and triangles than fit in one compressed chunk (16384)
+# to cover the parallel compression. All the optional openscad args are passed on to
+# OpenSCAD in both exports.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse, zipfile
+import xml.etree.ElementTree as ET
+
+NS = '{http://schemas.microsoft.com/3dmanufacturing/core/2015/02}'
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('export_3mf_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting export_3mf_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+def signed_volume(triangles):
+    total = 0.0
+    for a, b, c in triangles:
+        total += (a[0] * (b[1] * c[2] - b[2] * c[1]) -
+                  a[1] * (b[0] * c[2] - b[2] * c[0]) +
+                  a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0
+    return total
+
+def read_stl_triangles(filename):
+    # validatestl.read_stl welds vertices by list lookups, too slow for large meshes
+    triangles, triangle = [], []
+    with open(filename) as f:
+        for line in f:
+            parts = line.split()
+            if parts and parts[0] == 'vertex':
+                triangle.append([float(x) for x in parts[1:4]])
+            elif parts and parts[0] == 'endfacet':
+                triangles.append(triangle)
+                triangle = []
+    return triangles
+
+def read_3mf_triangles(filename):
+    with zipfile.ZipFile(filename) as archive:
+        bad = archive.testzip()
+        if bad is not None:
+            failquit('corrupt entry %s in %s' % (bad, filename))
+        names = archive.namelist()
+        for name in ['[Content_Types].xml', '_rels/.rels', '3D/3dmodel.model']:
+            if name not in names:
+                failquit('missing entry %s in %s' % (name, filename))
+        model = ET.fromstring(archive.read('3D/3dmodel.model'))
+    objects = {}
+    for obj in model.iter(NS + 'object'):
+        vertices = [[float(v.get(c)) for c in 'xyz'] for v in obj.iter(NS + 'vertex')]
+        triangles = []
+        for t in obj.iter(NS + 'triangle'):
+            indices = [int(t.get(k)) for k in ('v1', 'v2', 'v3')]
+            if any(i < 0 or i >= len(vertices) for i in indices):
+                failquit('triangle index out of range in object ' + obj.get('id'))
+            triangles.append([vertices[i] for i in indices])
+        objects[obj.get('id')] = triangles
+    items = [item.get('objectid') for item in model.iter(NS + 'item')]
+    if sorted(items) != sorted(objects.keys()):
+        failquit('build items %s differ from the objects %s' % (items, list(objects.keys())))
+    return [t for id in items for t in objects[id]], len(items)
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+threemffile = basename + '.3mf'
+stlfile = basename + '.stl'
+run([args.openscad, inputfile, '-o', threemffile] + openscad_args)
+run([args.openscad, inputfile, '-o', stlfile, '--export-format', 'asciistl'] + openscad_args)
+
+triangles, count = read_3mf_triangles(threemffile)
+stl = read_stl_triangles(stlfile)
+if len(triangles) != len(stl):
+    failquit('3MF export has %d triangles, the STL export has %d' % (len(triangles), len(stl)))
+volume = signed_volume(triangles)
+stl_volume = signed_volume(stl)
+# 3MF coordinates are written as floats with 6 decimals, STL with 6 significant digits
+if abs(volume - stl_volume) > 1e-3 * max(1.0, abs(stl_volume)):
+    failquit('volume of the 3MF export %g differs from the STL export %g' % (volume, stl_volume))
+
+os.unlink(threemffile)
+os.unlink(stlfile)
+
+with open(outputfile, 'w') as f:
+    f.write('objects: %d, triangles and volume match\n' % count)
@@ -6,7 +6,7 @@
 # Usage: <script> <inputfile> [--openscad=<executable-path>] --format=<format> --require-manifold [<openscad args>] file.png
 #
 # step 1. If the input file is _not_ an .scad file, create a temporary .scad file importing the input file.
-# step 2. Run OpenSCAD on the .scad file, output an export format (csg, stl, off, dxf, svg, amf, 3mf)
+# step 2. Run OpenSCAD on the .scad file, output an export format (csg, stl, off, dxf, svg, amf, 3mf, geom)
 # step 3. If the export format is _not_ .csg, create a temporary new .scad file importing the exported file
 # step 4. Run OpenSCAD on the .csg or .scad file, export to the given .png file
 # step 5. (done in CTest) - compare the generated .png file to expected output
@@ -51,7 +51,7 @@ def createImport(inputfile, scadfile):
 #
 # Parse arguments
 #
-formats = ['csg', 'asciistl', 'binstl', 'stl', 'off', 'amf', '3mf', 'dxf', 'svg']
+formats = ['csg', 'asciistl', 'binstl', 'stl', 'off', 'amf', '3mf', 'geom', 'dxf', 'svg']
 parser = argparse.ArgumentParser()
 parser.add_argument('--openscad', required=False, default=os.environ["OPENSCAD_BINARY"],
     help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
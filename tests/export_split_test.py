@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+
+# Split export test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Export the input file with --export-split to numbered ASCII STL files.
+# step 2. Check that one file is written per top-level object, and none more.
+# step 3. Export each object alone, selected by -D part=<number>, and check that
+#         it encloses the same volume and bounding box as its numbered file.
+# step 4. (done in CTest) - compare the written result to the expected output.
+#
+# The input file must have a variable part, which selects one top-level object
+# when set to its number and all of them when 0.
+# All the optional openscad args are passed on to OpenSCAD in all exports.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, re, subprocess, argparse, glob
+from validatestl import read_stl
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('export_split_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting export_split_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+def summary(filename):
+    mesh = read_stl(filename)
+    volume = 0.0
+    for t in mesh.triangles:
+        a, b, c = [mesh.points[i] for i in t]
+        volume += (a[0] * (b[1] * c[2] - b[2] * c[1]) -
+                   a[1] * (b[0] * c[2] - b[2] * c[0]) +
+                   a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0
+    bbox = [min(p[i] for p in mesh.points) for i in range(3)] + [max(p[i] for p in mesh.points) for i in range(3)]
+    return volume, bbox
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+for old in glob.glob(basename + '-*.stl'):
+    os.unlink(old)
+splitfile = basename + '.stl'
+run([args.openscad, inputfile, '-o', splitfile, '--export-format', 'asciistl', '--export-split'] + openscad_args)
+if os.path.exists(splitfile):
+    failquit('--export-split wrote the united objects to ' + splitfile)
+
+numbers = sorted(int(re.search(r'-([0-9]+)\.stl$', f).group(1))
+                 for f in glob.glob(basename + '-*.stl') if re.search(r'-[0-9]+\.stl$', f))
+if numbers != list(range(1, len(numbers) + 1)):
+    failquit('split files are not numbered from 1: ' + str(numbers))
+
+lines = ['%d files' % len(numbers)]
+for i in numbers:
+    objectfile = '%s-%d.stl' % (basename, i)
+    singlefile = '%s-single-%d.stl' % (basename, i)
+    run([args.openscad, inputfile, '-o', singlefile, '--export-format', 'asciistl', '-D', 'part=%d' % i] + openscad_args)
+    volume, bbox = summary(objectfile)
+    single_volume, single_bbox = summary(singlefile)
+    # Both files are written with 6 significant digits
+    tolerance = 1e-3 * max(1.0, abs(single_volume))
+    if abs(volume - single_volume) > tolerance or any(abs(a - b) > 1e-3 * max(1.0, abs(b)) for a, b in zip(bbox, single_bbox)):
+        failquit('object %d differs from its single export: volume %g, %g, bounding box %s, %s' %
+                 (i, volume, single_volume, str(bbox), str(single_bbox)))
+    lines.append('object %d matches' % i)
+    os.unlink(objectfile)
+    os.unlink(singlefile)
+
+with open(outputfile, 'w') as f:
+    f.write('\n'.join(lines) + '\n')
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+
+# Extrusion bounding box test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Export the input file to ASCII STL, with the geometry summary in JSON.
+# step 2. Check that the bounding box of the summary is the one of the exported
+#         vertices. Extrusions are put together from parts built in parallel,
+#         and must not lose the bounding box of those parts.
+# step 3. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, json, subprocess, argparse
+from validatestl import read_stl
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('extrude_bbox_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting extrude_bbox_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+stlfile = basename + '.stl'
+summaryfile = basename + '.json'
+run([args.openscad, inputfile, '-o', stlfile, '--export-format', 'asciistl',
+     '--summary', 'geometry', '--summary', 'bounding-box', '--summary-file', summaryfile] + openscad_args)
+
+with open(summaryfile) as f:
+    geometry = json.load(f).get('geometry', {})
+bbox = geometry.get('bounding_box')
+if not bbox or bbox.get('min') is None or bbox.get('max') is None:
+    failquit('summary has no bounding box: ' + str(geometry))
+
+mesh = read_stl(stlfile)
+if not mesh.points:
+    failquit('exported mesh is empty')
+expected_min = [min(p[i] for p in mesh.points) for i in range(3)]
+expected_max = [max(p[i] for p in mesh.points) for i in range(3)]
+for name, got, expected in (('min', bbox['min'], expected_min), ('max', bbox['max'], expected_max)):
+    if any(v is None or abs(v - e) > 1e-3 for v, e in zip(got, expected)):
+        failquit('bounding box %s %s differs from the exported vertices %s' % (name, got, expected))
+
+with open(outputfile, 'w') as f:
+    f.write('bounding box matches\n')
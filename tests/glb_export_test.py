@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+
+# GLB export test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Export the input file to GLB.
+# step 2. Check the GLB header and chunks, and decode the meshes with their node transforms.
+# step 3. Export it to ASCII STL and check that both exports enclose the same volume.
+# step 4. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD in both exports,
+# e.g. --enable=glb-quantization to test the 16 bit positions.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse, json, struct
+from validatestl import read_stl
+
+GL_SHORT = 5122
+GL_UNSIGNED_SHORT = 5123
+GL_UNSIGNED_INT = 5125
+GL_FLOAT = 5126
+GL_TRIANGLES = 4
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('glb_export_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting glb_export_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+def signed_volume(triangles):
+    total = 0.0
+    for a, b, c in triangles:
+        total += (a[0] * (b[1] * c[2] - b[2] * c[1]) -
+                  a[1] * (b[0] * c[2] - b[2] * c[0]) +
+                  a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0
+    return total
+
+def read_accessor(gltf, binary, index):
+    accessor = gltf['accessors'][index]
+    view = gltf['bufferViews'][accessor['bufferView']]
+    formats = {GL_SHORT: 'h', GL_UNSIGNED_SHORT: 'H', GL_UNSIGNED_INT: 'I', GL_FLOAT: 'f'}
+    if accessor['componentType'] not in formats:
+        failquit('unexpected component type %d' % accessor['componentType'])
+    fmt = '<' + formats[accessor['componentType']]
+    components = {'SCALAR': 1, 'VEC3': 3}[accessor['type']]
+    size = struct.calcsize(fmt) * components
+    stride = view.get('byteStride', size)
+    offset = view.get('byteOffset', 0) + accessor.get('byteOffset', 0)
+    if offset + stride * (accessor['count'] - 1) + size > view.get('byteOffset', 0) + view['byteLength']:
+        failquit('accessor %d exceeds its buffer view' % index)
+    values = []
+    for i in range(accessor['count']):
+        item = struct.unpack_from(fmt[0] + fmt[1] * components, binary, offset + i * stride)
+        values.append(item if components > 1 else item[0])
+    return values
+
+def read_glb(filename):
+    with open(filename, 'rb') as f:
+        data = f.read()
+    magic, version, length = struct.unpack_from('<III', data, 0)
+    if magic != 0x46546C67 or version != 2:
+        failquit('not a glTF 2.0 binary file: ' + filename)
+    if length != len(data):
+        failquit('GLB header length %d differs from the file size %d' % (length, len(data)))
+    json_length, json_type = struct.unpack_from('<II', data, 12)
+    if json_type != 0x4E4F534A or json_length % 4 != 0:
+        failquit('invalid JSON chunk')
+    gltf = json.loads(data[20:20 + json_length].decode('utf-8'))
+    binary = b''
+    offset = 20 + json_length
+    if offset < len(data):
+        bin_length, bin_type = struct.unpack_from('<II', data, offset)
+        if bin_type != 0x004E4942:
+            failquit('invalid BIN chunk')
+        binary = data[offset + 8:offset + 8 + bin_length]
+        if len(binary) != bin_length or bin_length != gltf['buffers'][0]['byteLength']:
+            failquit('BIN chunk length differs from the buffer length')
+
+    # The root rotation (Z up to Y up) keeps the volume, the mesh nodes are
+    # translated and scaled when the positions are quantized
+    triangles = []
+    nodes = gltf['nodes']
+    for child in nodes[gltf['scenes'][gltf['scene']]['nodes'][0]].get('children', []):
+        node = nodes[child]
+        translation = node.get('translation', [0.0, 0.0, 0.0])
+        scale = node.get('scale', [1.0, 1.0, 1.0])
+        for primitive in gltf['meshes'][node['mesh']]['primitives']:
+            if primitive.get('mode', GL_TRIANGLES) != GL_TRIANGLES:
+                failquit('unexpected primitive mode %d' % primitive['mode'])
+            positions = [[p[i] * scale[i] + translation[i] for i in range(3)]
+                         for p in read_accessor(gltf, binary, primitive['attributes']['POSITION'])]
+            indices = read_accessor(gltf, binary, primitive['indices'])
+            if len(indices) % 3 != 0 or any(i >= len(positions) for i in indices):
+                failquit('invalid triangle indices')
+            for i in range(0, len(indices), 3):
+                triangles.append([positions[j] for j in indices[i:i + 3]])
+    return triangles
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+glbfile = basename + '.glb'
+stlfile = basename + '.stl'
+run([args.openscad, inputfile, '-o', glbfile] + openscad_args)
+run([args.openscad, inputfile, '-o', stlfile, '--export-format', 'asciistl'] + openscad_args)
+
+mesh = read_stl(stlfile)
+triangles = read_glb(glbfile)
+if len(triangles) != len(mesh.triangles):
+    failquit('GLB export has %d triangles, the STL export has %d' % (len(triangles), len(mesh.triangles)))
+glb = signed_volume(triangles)
+stl = signed_volume([[mesh.points[i] for i in t] for t in mesh.triangles])
+# Positions are stored as floats, or with 16 bits over the bounding box when quantized
+if abs(glb - stl) > 5e-3 * max(1.0, abs(stl)):
+    failquit('volume of the GLB export %g differs from the STL export %g' % (glb, stl))
+
+os.unlink(glbfile)
+os.unlink(stlfile)
+
+with open(outputfile, 'w') as f:
+    f.write('volumes match\n')
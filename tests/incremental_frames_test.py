@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+# Incremental evaluation test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [--frames=<n>] [<openscad args>] file.txt
+#
+# step 1. Export the animation frames of the input file, each evaluated from scratch.
+# step 2. Export them with --enable=incremental-eval, which reuses the nodes of
+#         top-level instantiations not depending on $t from the previous frame.
+# step 3. Export them incrementally with --jobs, so reused nodes are shared by trees
+#         which are exported concurrently.
+# step 4. Check that all runs wrote the same frames.
+# step 5. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD in all exports.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('incremental_frames_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting incremental_frames_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+parser.add_argument('--frames', type=int, default=4, help='Number of frames to export.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+animate = ['--animate=' + str(args.frames), '--export-format=asciistl']
+runs = {
+    'fresh': [],
+    'incremental': ['--enable=incremental-eval'],
+    'jobs': ['--enable=incremental-eval', '--jobs=' + str(args.frames)],
+}
+for name, extra in runs.items():
+    run([args.openscad, inputfile, '-o', basename + '-' + name + '.stl'] + animate + extra + openscad_args)
+
+def frame(name, i):
+    with open('%s-%s%05d.stl' % (basename, name, i)) as f:
+        return f.read()
+
+for i in range(args.frames):
+    fresh = frame('fresh', i)
+    for name in ('incremental', 'jobs'):
+        if frame(name, i) != fresh:
+            failquit('frame %d of the %s export differs from a fresh evaluation' % (i, name))
+
+for name in runs:
+    for i in range(args.frames):
+        os.unlink('%s-%s%05d.stl' % (basename, name, i))
+
+with open(outputfile, 'w') as f:
+    f.write('%d frames match\n' % args.frames)
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+
+# Indexed mesh export test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Export the input file to OBJ, which is written from the shared indexed mesh of the result.
+# step 2. Export it to ASCII STL, which is written from the polygons of the result.
+# step 3. Check that both exports enclose the same volume, i.e. that the indexed mesh is up to date.
+# step 4. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD in both exports.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse
+from validatestl import read_stl
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('indexed_export_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting indexed_export_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+def signed_volume(faces):
+    total = 0.0
+    for face in faces:
+        a = face[0]
+        for b, c in zip(face[1:-1], face[2:]):
+            total += (a[0] * (b[1] * c[2] - b[2] * c[1]) -
+                      a[1] * (b[0] * c[2] - b[2] * c[0]) +
+                      a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0
+    return total
+
+def read_obj(filename):
+    vertices, faces = [], []
+    with open(filename) as f:
+        for line in f:
+            parts = line.split()
+            if not parts:
+                continue
+            if parts[0] == 'v':
+                vertices.append([float(x) for x in parts[1:4]])
+            elif parts[0] == 'f':
+                faces.append([vertices[int(i) - 1] for i in parts[1:]])
+    return faces
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+objfile = basename + '.obj'
+stlfile = basename + '.stl'
+run([args.openscad, inputfile, '-o', objfile] + openscad_args)
+run([args.openscad, inputfile, '-o', stlfile, '--export-format', 'asciistl'] + openscad_args)
+
+mesh = read_stl(stlfile)
+indexed = signed_volume(read_obj(objfile))
+polygons = signed_volume([[mesh.points[i] for i in t] for t in mesh.triangles])
+# Both files are written with 6 significant digits
+if abs(indexed - polygons) > 1e-3 * max(1.0, abs(polygons)):
+    failquit('volume of the OBJ export %g differs from the STL export %g' % (indexed, polygons))
+
+os.unlink(objfile)
+os.unlink(stlfile)
+
+with open(outputfile, 'w') as f:
+    f.write('volumes match\n')
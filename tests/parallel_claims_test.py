@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+
+# Parallel claims test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Export the input file to ASCII STL, with the node profile in JSON.
+# step 2. Check that the instances of module shared() were evaluated once, the
+#         others being cache hits. The input file uses the module in several
+#         branches, which parallel-eval evaluates concurrently and which must
+#         wait for each other instead of evaluating the subtree again.
+# step 3. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, json, subprocess, argparse
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('parallel_claims_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting parallel_claims_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+stlfile = basename + '.stl'
+summaryfile = basename + '.json'
+run([args.openscad, inputfile, '-o', stlfile, '--export-format', 'asciistl',
+     '--summary', 'profile', '--summary-file', summaryfile] + openscad_args)
+
+with open(summaryfile) as f:
+    profile = json.load(f).get('profile')
+if not profile:
+    failquit('summary has no profile')
+
+instances = [entry for entry in profile if entry['name'] == 'module shared']
+count = sum(entry['count'] for entry in instances)
+evaluated = sum(entry['count'] - entry['cached'] for entry in instances)
+if count < 2:
+    failquit('module shared() is not used more than once: ' + str(profile))
+if evaluated != 1:
+    failquit('%d instances of module shared() were evaluated %d times' % (count, evaluated))
+
+with open(outputfile, 'w') as f:
+    f.write('%d instances, evaluated once\n' % count)
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+# Rounding of exact coordinates test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.txt
+#
+# step 1. Export the input file to STL, once as is and once with --enable=round-exact.
+# step 2. Check that the rounded export is a valid closed mesh.
+# step 3. Check that both exports enclose the same volume.
+# step 4. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD in both exports.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse
+from validatestl import read_stl, validateSTL
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('roundexact_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting roundexact_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+def volume(mesh):
+    total = 0.0
+    for t in mesh.triangles:
+        a, b, c = (mesh.points[i] for i in t)
+        total += (a[0] * (b[1] * c[2] - b[2] * c[1]) -
+                  a[1] * (b[0] * c[2] - b[2] * c[0]) +
+                  a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0
+    return total
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+exactfile = basename + '-exact.stl'
+roundedfile = basename + '-rounded.stl'
+run([args.openscad, inputfile, '-o', exactfile] + openscad_args)
+run([args.openscad, inputfile, '-o', roundedfile, '--enable=round-exact'] + openscad_args)
+
+if not validateSTL(roundedfile):
+    failquit('rounded export is not a valid mesh')
+
+exact = volume(read_stl(exactfile))
+rounded = volume(read_stl(roundedfile))
+# Both exports are written with float precision
+if abs(exact - rounded) > 1e-4 * abs(exact):
+    failquit('volume changed by rounding: %g vs. %g' % (exact, rounded))
+
+os.unlink(exactfile)
+os.unlink(roundedfile)
+
+with open(outputfile, 'w') as f:
+    f.write('rounded volume matches\n')
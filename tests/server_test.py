@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+
+# Render server test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.echo
+#
+# step 1. Start OpenSCAD with --server and write render jobs to its stdin: the input file
+#         exported to echo, requests which are malformed or fail, and the export again.
+# step 2. Check that the server answers every request with one JSON line, errors included,
+#         and keeps serving the requests after the failing ones.
+# step 3. (done in CTest) - compare the echo output of the last job to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse, json
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('server_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting server_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = os.path.abspath(remaining_args[0])
+outputfile = os.path.abspath(remaining_args[-1])
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+firstfile = os.path.splitext(outputfile)[0] + '-first.echo'
+missingfile = os.path.join(os.path.dirname(inputfile), 'server-test-missing.scad')
+# Request lines, and whether each must fail with an error message
+requests = [
+    (json.dumps({'id': 1, 'input': inputfile, 'output': firstfile}), False),
+    ('{"id": 2, "input": ', True),
+    (json.dumps({'id': 3, 'input': inputfile}), True),
+    (json.dumps({'id': 4, 'input': inputfile, 'output': firstfile, 'format': 'nonsense'}), True),
+    (json.dumps({'id': 5, 'input': missingfile, 'output': firstfile}), False),
+    (json.dumps({'id': 6, 'input': inputfile, 'output': outputfile}), False),
+]
+
+cmd = [args.openscad, '--server'] + openscad_args
+print(' '.join(cmd), file=sys.stderr)
+sys.stderr.flush()
+proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+stdout, _ = proc.communicate(''.join(line + '\n' for line, _ in requests).encode('utf-8'))
+if proc.returncode != 0:
+    failquit('OpenSCAD failed with return code ' + str(proc.returncode))
+
+results = [json.loads(line) for line in stdout.decode('utf-8').splitlines() if line.startswith('{')]
+if len(results) != len(requests):
+    failquit('expected %d results, got %d: %s' % (len(requests), len(results), stdout))
+for (line, fails), result in zip(requests, results):
+    if fails and 'error' not in result:
+        failquit('no error reported for request: ' + line)
+    if fails and result['rc'] == 0:
+        failquit('malformed request succeeded: ' + line)
+if results[0]['rc'] != 0 or results[-1]['rc'] != 0:
+    failquit('valid requests failed: ' + str(results))
+if results[4]['rc'] == 0:
+    failquit('request of a missing file succeeded')
+
+with open(firstfile) as first, open(outputfile) as last:
+    if first.read() != last.read():
+        failquit('the server exported different output after failed requests')
+os.unlink(firstfile)
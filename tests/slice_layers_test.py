@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+
+# Slice layers export test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] --slice-layers=<heights> [<openscad args>] file.txt
+#
+# step 1. Export the cross sections of the input file to numbered SVG files.
+# step 2. Export them again with --slice-single-file, as the groups of one SVG file.
+# step 3. Write the area of each numbered file and each group to the given file.
+# step 4. (done in CTest) - compare the written result to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD in both exports.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, re, subprocess, argparse, glob
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('slice_layers_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting slice_layers_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+def path_area(d):
+    # Outlines are written as "M x,y L x,y ... z"
+    total = 0.0
+    for outline in d.split('z'):
+        points = [[float(c) for c in p.split(',')] for p in re.findall(r'[-+0-9.e]+,[-+0-9.e]+', outline)]
+        for a, b in zip(points, points[1:] + points[:1]):
+            total += (a[0] * b[1] - b[0] * a[1]) / 2.0
+    return abs(total)
+
+def svg_area(text):
+    return sum(path_area(d) for d in re.findall(r'<path d="([^"]*)"', text))
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+outputfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+basename = os.path.splitext(outputfile)[0]
+for old in glob.glob(basename + '-*.svg'):
+    os.unlink(old)
+layersfile = basename + '.svg'
+singlefile = basename + '-all.svg'
+run([args.openscad, inputfile, '-o', layersfile] + openscad_args)
+run([args.openscad, inputfile, '-o', singlefile, '--slice-single-file'] + openscad_args)
+
+lines = []
+# Layers without a cross section are not written, so their numbers are missing
+layerfiles = [f for f in glob.glob(basename + '-*.svg') if re.match(r'.*-[0-9]+\.svg$', f)]
+if not layerfiles:
+    failquit('no slice layer files written for ' + layersfile)
+for f in sorted(layerfiles, key=lambda f: int(re.search(r'-([0-9]+)\.svg$', f).group(1))):
+    with open(f) as svg:
+        area = svg_area(svg.read())
+    lines.append('layer %s: area %.3f' % (re.search(r'-([0-9]+)\.svg$', f).group(1), area))
+    os.unlink(f)
+
+with open(singlefile) as svg:
+    text = svg.read()
+groups = re.findall(r'<g id="([^"]*)">(.*?)</g>', text, re.S)
+if not groups:
+    failquit('no layer groups in ' + singlefile)
+for name, group in groups:
+    lines.append('group %s: area %.3f' % (name, svg_area(group)))
+os.unlink(singlefile)
+
+with open(outputfile, 'w') as f:
+    f.write('\n'.join(lines) + '\n')
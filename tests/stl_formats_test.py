@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+
+# Binary/ASCII STL comparison test
+#
+# Usage: <script> <inputfile> [--openscad=<executable-path>] [<openscad args>] file.stl
+#
+# step 1. Export the input file to STL without a format, which must give a binary STL file.
+# step 2. Export it again with --export-format asciistl to the given .stl file.
+# step 3. Compare the triangles of both files, which must describe the same geometry.
+# step 4. (done in CTest) - compare the ASCII .stl file to the expected output.
+#
+# All the optional openscad args are passed on to OpenSCAD in both exports.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, os, subprocess, argparse
+from validatestl import read_stl
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('stl_formats_test args:', str(sys.argv), file=sys.stderr)
+    print('exiting stl_formats_test.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+def run(cmd):
+    print(' '.join(cmd), file=sys.stderr)
+    sys.stderr.flush()
+    result = subprocess.call(cmd)
+    if result != 0:
+        failquit('OpenSCAD failed with return code ' + str(result))
+
+def triangles(mesh):
+    return [[tuple(mesh.points[i]) for i in t] for t in mesh.triangles]
+
+# ASCII export skips triangles whose printed vertices coincide
+def distinct(triangle):
+    printed = ['%g %g %g' % p for p in triangle]
+    return len(set(printed)) == 3
+
+def close(a, b):
+    return all(abs(x - y) <= 1e-5 * max(1.0, abs(x)) for x, y in zip(a, b))
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--openscad', required=False, default=os.environ.get("OPENSCAD_BINARY"),
+    help='Specify OpenSCAD executable, default to env["OPENSCAD_BINARY"] if absent.')
+args, remaining_args = parser.parse_known_args()
+
+inputfile = remaining_args[0]
+stlfile = remaining_args[-1]
+openscad_args = remaining_args[1:-1]
+
+if not os.path.exists(inputfile):
+    failquit('cant find input file named: ' + inputfile)
+if not args.openscad or not os.path.exists(args.openscad):
+    failquit('cant find openscad executable named: ' + str(args.openscad))
+
+binaryfile = os.path.splitext(stlfile)[0] + '-binary.stl'
+run([args.openscad, inputfile, '-o', binaryfile] + openscad_args)
+run([args.openscad, inputfile, '-o', stlfile, '--export-format', 'asciistl'] + openscad_args)
+
+with open(binaryfile, 'rb') as f:
+    data = f.read()
+if data.startswith(b'solid'):
+    failquit('STL export without a format is not binary: ' + binaryfile)
+count = int.from_bytes(data[80:84], byteorder='little')
+if len(data) != 84 + 50 * count:
+    failquit('Binary STL size %d does not match its %d triangles' % (len(data), count))
+
+binary = [t for t in triangles(read_stl(binaryfile)) if distinct(t)]
+ascii = triangles(read_stl(stlfile))
+if len(binary) != len(ascii):
+    failquit('Binary STL has %d triangles, ASCII STL has %d' % (len(binary), len(ascii)))
+for i, (b, a) in enumerate(zip(binary, ascii)):
+    if not all(close(p, q) for p, q in zip(a, b)):
+        failquit('Triangle %d differs: binary %s, ASCII %s' % (i, b, a))
@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+
+# Summary check
+#
+# Usage: <script> <summary.json> <key>[.<key>...]
+#
+# Checks that the value at the dotted key path of a --summary-file written by
+# an earlier test is a positive number, e.g. cache.library_cache.hits to check
+# that the run loaded something from a cache.
+#
+# This script should return 0 on success, not-0 on error.
+#
+
+import sys, json
+
+def failquit(*args):
+    if len(args)!=0: print(*args, file=sys.stderr)
+    print('summary_check args:', str(sys.argv), file=sys.stderr)
+    print('exiting summary_check.py with failure', file=sys.stderr)
+    sys.exit(1)
+
+if len(sys.argv) != 3:
+    failquit('expected a summary file and a key path')
+
+try:
+    with open(sys.argv[1]) as f:
+        value = json.load(f)
+except (OSError, ValueError) as e:
+    failquit('cant read summary file: ' + str(e))
+
+for key in sys.argv[2].split('.'):
+    if not isinstance(value, dict) or key not in value:
+        failquit('summary has no ' + sys.argv[2])
+    value = value[key]
+
+if not isinstance(value, (int, float)) or value <= 0:
+    failquit('%s is %s, expected a positive number' % (sys.argv[2], value))
+print('%s: %s' % (sys.argv[2], value))